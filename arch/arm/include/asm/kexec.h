@@ -17,8 +17,30 @@
 #define KEXEC_ARM_ATAGS_OFFSET  0x1000
 #define KEXEC_ARM_ZIMAGE_OFFSET 0x8000
 
+/* Order of the control pages holding the merged copy-run table */
+#define KEXEC_ARM_COPY_RUN_ORDER	2
+
 #ifndef __ASSEMBLY__
 
+struct page;
+
+/*
+ * Physically contiguous source/destination run, copied as one block by
+ * relocate_new_kernel.  A zero length terminates the table.
+ */
+struct kexec_copy_run {
+	unsigned long dst;
+	unsigned long src;
+	unsigned long len;
+};
+
+#define ARCH_HAS_KIMAGE_ARCH
+
+struct kimage_arch {
+	struct page *copy_runs;		/* struct kexec_copy_run table */
+	struct page *copy_pgd;		/* cacheable identity map for the copy */
+};
+
 /**
  * crash_setup_regs() - save registers for the panic kernel
  * @newregs: registers are saved here
@@ -53,6 +75,15 @@ static inline void crash_setup_regs(struct pt_regs *newregs,
 /* Function pointer to optional machine-specific reinitialization */
 extern void (*kexec_reinit)(void);
 
+struct tag;
+extern int kexec_add_handoff_tag(const struct tag *tag);
+
+#ifdef CONFIG_KEXEC_TIMELINE
+extern void kexec_timeline_handoff(void);
+#else
+static inline void kexec_timeline_handoff(void) { }
+#endif
+
 #endif /* __ASSEMBLY__ */
 
 #endif /* CONFIG_KEXEC */
@@ -0,0 +1,43 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+/*
+ * Copies and fills below this many bytes stay on the LDM/STM routines:
+ * saving the user's VFP/NEON context costs more than NEON wins on them.
+ */
+#define NEON_MEMCPY_THRESHOLD	2048
+
+/*
+ * Checksums from this many bytes up use NEON.  The copy-and-checksum
+ * variants become two passes, which only pays off for full sized packets.
+ */
+#define NEON_CSUM_THRESHOLD	512
+
+#ifndef __ASSEMBLY__
+
+#include <linux/types.h>
+
+/*
+ * kernel_neon_begin - claim the NEON unit for kernel use
+ *
+ * Saves the VFP/NEON state of the current owner, if any, and disables
+ * preemption until kernel_neon_end().  Must not be called from interrupt
+ * context.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+extern void __memcpy_neon(void *dest, const void *src, size_t n);
+extern void __memset_neon(void *s, int c, size_t n);
+extern u32 __csum_partial_neon(const void *buf, int len);
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* __ASM_ARM_NEON_H */
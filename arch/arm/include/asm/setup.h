@@ -143,6 +143,41 @@ struct tag_memclk {
 	__u32 fmemclk;
 };
 
+/*
+ * State handed over by a kernel that booted us through kexec.  The
+ * whole 0x4b5848xx range is rewritten by machine_kexec(), so stale
+ * copies from /proc/atags never reach the next kernel.
+ */
+#define ATAG_KEXEC_BASE		0x4b584800
+#define ATAG_KEXEC_MASK		0xffffff00
+
+#define ATAG_KEXEC_HANDOFF	0x4b584801
+
+struct tag_kexec_handoff {
+	__u32 flags;
+};
+
+/* display, IOMMUs and remote cores were quiesced before the jump */
+#define KEXEC_HANDOFF_HW_QUIESCED	(1 << 0)
+
+/* 32k counter stamps of the previous kernel's way down (see kexec.h) */
+#define ATAG_KEXEC_TIMELINE	0x4b584803
+
+struct tag_kexec_timeline {
+	__u32 stamp[8];
+};
+
+/* a log buffer left in RAM by the previous kernel, one tag per log */
+#define ATAG_KEXEC_LOG		0x4b584802
+
+struct tag_kexec_log {
+	__u32 start;		/* physical address of the buffer */
+	__u32 size;		/* in bytes */
+	__u32 w_off;		/* logger write head */
+	__u32 head;		/* logger reader start */
+	char name[16];		/* e.g. "log_main", "ram_console" */
+};
+
 #ifdef CONFIG_BOOTINFO
 
 /* Powerup Reason */
@@ -201,6 +236,13 @@ struct tag {
 		 * DC21285 specific
 		 */
 		struct tag_memclk	memclk;
+
+		/*
+		 * kexec handoff
+		 */
+		struct tag_kexec_handoff kexec_handoff;
+		struct tag_kexec_log	kexec_log;
+		struct tag_kexec_timeline kexec_timeline;
 #ifdef CONFIG_BOOTINFO
 		/*
 		 * Motorola specific ATAGs
@@ -253,6 +295,15 @@ struct meminfo {
 
 extern struct meminfo meminfo;
 
+/* flags from ATAG_KEXEC_HANDOFF, 0 on a cold boot */
+extern unsigned int kexec_handoff_flags;
+
+/* logs from ATAG_KEXEC_LOG; size is 0 if the buffer could not be kept */
+#define KEXEC_HANDOFF_MAX_LOGS	8
+extern struct tag_kexec_log kexec_handoff_logs[KEXEC_HANDOFF_MAX_LOGS];
+extern unsigned int kexec_handoff_nr_logs;
+extern struct tag_kexec_log *kexec_handoff_find_log(const char *name);
+
 #define for_each_bank(iter,mi)				\
 	for (iter = 0; iter < (mi)->nr_banks; iter++)
 
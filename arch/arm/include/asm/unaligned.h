@@ -1,8 +1,18 @@
 #ifndef _ASM_ARM_UNALIGNED_H
 #define _ASM_ARM_UNALIGNED_H
 
+/*
+ * ARMv7 handles unaligned LDR/STR/LDRH/STRH in hardware, as the kernel
+ * runs with SCTLR.A clear there.  LDM/STM and LDRD/STRD still trap, so
+ * go through packed structures rather than plain dereferences.
+ */
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && !defined(__ARMEB__)
+#include <linux/unaligned/le_struct.h>
+#include <linux/unaligned/be_byteshift.h>
+#else
 #include <linux/unaligned/le_byteshift.h>
 #include <linux/unaligned/be_byteshift.h>
+#endif
 #include <linux/unaligned/generic.h>
 
 /*
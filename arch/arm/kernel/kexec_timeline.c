@@ -0,0 +1,120 @@
+/*
+ * kexec_timeline.c - time the steps of a kexec reboot
+ *
+ * The old kernel stamps its way down and hands the stamps over in an
+ * ATAG; the new kernel adds its own and shows the whole timeline in
+ * /sys/kernel/kexec_timeline.  The platform provides the clock, which
+ * must keep counting across the reboot.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/kexec.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/string.h>
+#include <asm/div64.h>
+#include <asm/setup.h>
+
+u32 (*kexec_timeline_clock)(void);
+
+static u32 kexec_timeline[KEXEC_TL_NR];
+
+static const char * const kexec_timeline_names[KEXEC_TL_NR] = {
+	[KEXEC_TL_KEXEC]		= "kexec",
+	[KEXEC_TL_SHUTDOWN]		= "shutdown",
+	[KEXEC_TL_MACHINE_SHUTDOWN]	= "machine_shutdown",
+	[KEXEC_TL_RELOCATE]		= "relocate",
+	[KEXEC_TL_DECOMPRESS]		= "decompress",
+	[KEXEC_TL_SETUP_ARCH]		= "setup_arch",
+	[KEXEC_TL_EARLY_INITCALL]	= "early_initcall",
+	[KEXEC_TL_LATE_INITCALL]	= "late_initcall",
+};
+
+void kexec_timeline_record(enum kexec_timeline_event event, u32 stamp)
+{
+	kexec_timeline[event] = stamp;
+}
+
+void kexec_timeline_stamp(enum kexec_timeline_event event)
+{
+	if (kexec_timeline_clock)
+		kexec_timeline_record(event, kexec_timeline_clock());
+}
+
+/*
+ * Called by machine_kexec() with the handoff tag list still open.
+ */
+void kexec_timeline_handoff(void)
+{
+	struct tag tag;
+	int i;
+
+	kexec_timeline_stamp(KEXEC_TL_RELOCATE);
+
+	tag.hdr.tag = ATAG_KEXEC_TIMELINE;
+	tag.hdr.size = tag_size(tag_kexec_timeline);
+	memset(&tag.u.kexec_timeline, 0, sizeof(tag.u.kexec_timeline));
+	for (i = 0; i <= KEXEC_TL_RELOCATE; i++)
+		tag.u.kexec_timeline.stamp[i] = kexec_timeline[i];
+	kexec_add_handoff_tag(&tag);
+}
+
+static int __init parse_tag_kexec_timeline(const struct tag *tag)
+{
+	int i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(tag->u.kexec_timeline.stamp) < KEXEC_TL_NR);
+
+	for (i = 0; i <= KEXEC_TL_RELOCATE; i++)
+		kexec_timeline[i] = tag->u.kexec_timeline.stamp[i];
+	return 0;
+}
+
+__tagtable(ATAG_KEXEC_TIMELINE, parse_tag_kexec_timeline);
+
+/*
+ * One line per recorded event: name, raw stamp and microseconds since
+ * the first recorded event.  The clock is assumed to run at 32768 Hz.
+ */
+static ssize_t kexec_timeline_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	u32 first = 0;
+	bool found = false;
+	u64 us;
+	int i;
+
+	for (i = 0; i < KEXEC_TL_NR; i++) {
+		if (!kexec_timeline[i])
+			continue;
+		if (!found) {
+			first = kexec_timeline[i];
+			found = true;
+		}
+		us = (u64)(kexec_timeline[i] - first) * USEC_PER_SEC;
+		do_div(us, 32768);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%-16s %10u %10llu\n",
+				 kexec_timeline_names[i], kexec_timeline[i],
+				 (unsigned long long)us);
+	}
+	return len;
+}
+
+static struct kobj_attribute kexec_timeline_attr =
+	__ATTR(kexec_timeline, 0444, kexec_timeline_show, NULL);
+
+static int __init kexec_timeline_early(void)
+{
+	kexec_timeline_stamp(KEXEC_TL_EARLY_INITCALL);
+	return 0;
+}
+early_initcall(kexec_timeline_early);
+
+static int __init kexec_timeline_init(void)
+{
+	kexec_timeline_stamp(KEXEC_TL_LATE_INITCALL);
+	return sysfs_create_file(kernel_kobj, &kexec_timeline_attr.attr);
+}
+late_initcall_sync(kexec_timeline_init);
@@ -7,11 +7,16 @@
 #include <linux/delay.h>
 #include <linux/reboot.h>
 #include <linux/io.h>
+#include <linux/memblock.h>
+#include <linux/highmem.h>
 #include <asm/pgtable.h>
 #include <asm/pgalloc.h>
 #include <asm/mmu_context.h>
 #include <asm/cacheflush.h>
 #include <asm/mach-types.h>
+#include <asm/sections.h>
+#include <asm/setup.h>
+#include <asm/sizes.h>
 
 extern const unsigned char relocate_new_kernel[];
 extern const unsigned int relocate_new_kernel_size;
@@ -22,9 +27,16 @@ extern unsigned long kexec_start_address;
 extern unsigned long kexec_indirection_page;
 extern unsigned long kexec_mach_type;
 extern unsigned long kexec_boot_atags;
+extern unsigned long kexec_copy_runs;
+extern unsigned long kexec_copy_pgd;
 
 static atomic_t waiting_for_crash_ipi;
 
+/* Tags queued by kexec_add_handoff_tag() for the next kernel */
+#define KEXEC_HANDOFF_WORDS	256
+static u32 kexec_handoff_tags[KEXEC_HANDOFF_WORDS];
+static unsigned int kexec_handoff_words;
+
 /*
  * Provide a dummy crash_notes definition while crash dump arrives to arm.
  * This prevents breakage of crash_notes attribute in kernel/ksysfs.c.
@@ -32,6 +44,28 @@ static atomic_t waiting_for_crash_ipi;
 
 int machine_kexec_prepare(struct kimage *image)
 {
+	image->arch.copy_runs = NULL;
+	image->arch.copy_pgd = NULL;
+
+	/*
+	 * The cached copy path needs its run table and page directory in
+	 * pages that are guaranteed not to be overwritten by the copy
+	 * itself, so grab them as control pages now.  Failing to get them
+	 * is not fatal; relocate_new_kernel falls back to the uncached
+	 * indirection walk.
+	 */
+#if __LINUX_ARM_ARCH__ >= 7
+	if (image->type != KEXEC_TYPE_DEFAULT)
+		return 0;
+
+	image->arch.copy_runs = kimage_alloc_control_pages(image,
+						KEXEC_ARM_COPY_RUN_ORDER);
+	if (image->arch.copy_runs)
+		image->arch.copy_pgd = kimage_alloc_control_pages(image,
+				get_order(PTRS_PER_PGD * sizeof(pgd_t)));
+	if (!image->arch.copy_pgd)
+		image->arch.copy_runs = NULL;
+#endif
 	return 0;
 }
 
@@ -75,6 +109,269 @@ void machine_crash_shutdown(struct pt_regs *regs)
 	printk(KERN_INFO "Loading crashdump kernel...\n");
 }
 
+/*
+ * Collapse the kimage indirection list into runs whose source and
+ * destination are both physically contiguous.  Pages that kexec_load
+ * already placed at their destination are dropped altogether.
+ * Returns the number of runs, or -ENOSPC if the table is too small.
+ */
+static int kexec_build_copy_runs(struct kimage *image,
+				 struct kexec_copy_run *run, int max)
+{
+	kimage_entry_t *ptr, entry;
+	unsigned long dest = 0, src;
+	int nr = 0;
+
+	for (ptr = &image->head; (entry = *ptr) && !(entry & IND_DONE);
+	     ptr = (entry & IND_INDIRECTION) ?
+		     phys_to_virt(entry & PAGE_MASK) : ptr + 1) {
+		if (entry & IND_DESTINATION) {
+			dest = entry & PAGE_MASK;
+			continue;
+		}
+		if (!(entry & IND_SOURCE))
+			continue;
+
+		src = entry & PAGE_MASK;
+		if (src == dest) {
+			/* already in place */
+		} else if (nr && run[nr - 1].dst + run[nr - 1].len == dest &&
+			   run[nr - 1].src + run[nr - 1].len == src) {
+			run[nr - 1].len += PAGE_SIZE;
+		} else {
+			if (nr == max)
+				return -ENOSPC;
+			run[nr].dst = dest;
+			run[nr].src = src;
+			run[nr].len = PAGE_SIZE;
+			nr++;
+		}
+		dest += PAGE_SIZE;
+	}
+	run[nr].len = 0;
+
+	return nr;
+}
+
+/*
+ * Build a flat 1:1 section map of all RAM with normal write-back
+ * attributes, so relocate_new_kernel can copy with the D-cache on.
+ */
+static void kexec_build_copy_pgd(pgd_t *pgd)
+{
+	unsigned long *table = (unsigned long *)pgd;
+	unsigned long prot = PMD_TYPE_SECT | PMD_SECT_AP_WRITE | PMD_SECT_WBWA;
+	struct memblock_region *reg;
+	unsigned long i, last;
+
+	memset(pgd, 0, PTRS_PER_PGD * sizeof(pgd_t));
+
+	for_each_memblock(memory, reg) {
+		i = reg->base >> SECTION_SHIFT;
+		last = (reg->base + reg->size - 1) >> SECTION_SHIFT;
+		for (; i <= last; i++)
+			table[i] = (i << SECTION_SHIFT) | prot;
+	}
+}
+
+/*
+ * Set up the cached copy path.  Returns non-zero when relocate_new_kernel
+ * will do the copy with the MMU and D-cache still enabled.
+ */
+static int kexec_setup_copy_runs(struct kimage *image)
+{
+	int max, nr;
+
+	kexec_copy_runs = 0;
+	kexec_copy_pgd = 0;
+
+	if (!image->arch.copy_runs)
+		return 0;
+
+	max = ((PAGE_SIZE << KEXEC_ARM_COPY_RUN_ORDER) /
+	       sizeof(struct kexec_copy_run)) - 1;
+	nr = kexec_build_copy_runs(image,
+			page_address(image->arch.copy_runs), max);
+	if (nr < 0) {
+		printk(KERN_INFO "kexec: too many copy runs, "
+		       "using uncached relocation\n");
+		return 0;
+	}
+	if (!nr)
+		return 0;	/* pre-staged image, nothing to copy */
+
+	kexec_build_copy_pgd(page_address(image->arch.copy_pgd));
+
+	kexec_copy_runs = page_to_phys(image->arch.copy_runs);
+	kexec_copy_pgd = page_to_phys(image->arch.copy_pgd);
+
+	return 1;
+}
+
+/**
+ * kexec_add_handoff_tag() - pass a tag on to the kernel we kexec into
+ * @tag: tag in the ATAG_KEXEC_BASE range
+ *
+ * Meant to be called from kexec_reinit or a reboot notifier, i.e. once
+ * the system is going down.  The tag is appended to the new kernel's
+ * ATAG list by machine_kexec().
+ */
+int kexec_add_handoff_tag(const struct tag *tag)
+{
+	if ((tag->hdr.tag & ATAG_KEXEC_MASK) != ATAG_KEXEC_BASE)
+		return -EINVAL;
+	if (kexec_handoff_words + tag->hdr.size > KEXEC_HANDOFF_WORDS)
+		return -ENOSPC;
+
+	memcpy(&kexec_handoff_tags[kexec_handoff_words], tag,
+	       tag->hdr.size << 2);
+	kexec_handoff_words += tag->hdr.size;
+	return 0;
+}
+
+/*
+ * Return the page whose contents will end up at physical address @dest
+ * once relocate_new_kernel is done.
+ */
+static struct page *kexec_dest_page(struct kimage *image, unsigned long dest)
+{
+	kimage_entry_t *ptr, entry;
+	unsigned long addr = 0;
+
+	if (image->type == KEXEC_TYPE_CRASH || image->prestaged)
+		return pfn_valid(dest >> PAGE_SHIFT) ?
+			pfn_to_page(dest >> PAGE_SHIFT) : NULL;
+
+	dest &= PAGE_MASK;
+	for (ptr = &image->head; (entry = *ptr) && !(entry & IND_DONE);
+	     ptr = (entry & IND_INDIRECTION) ?
+		     phys_to_virt(entry & PAGE_MASK) : ptr + 1) {
+		if (entry & IND_DESTINATION) {
+			addr = entry & PAGE_MASK;
+		} else if (entry & IND_SOURCE) {
+			if (addr == dest)
+				return pfn_to_page(entry >> PAGE_SHIFT);
+			addr += PAGE_SIZE;
+		}
+	}
+
+	return NULL;
+}
+
+/* what the decompressor needs past its image for bss, stack and heap */
+#define KEXEC_DECOMP_SCRATCH	SZ_128K
+/* how much larger than the zImage the decompressed kernel is taken to be */
+#define KEXEC_DECOMP_RATIO	4
+
+/*
+ * The physical range that booting the new zImage writes to besides its
+ * segments: the page directories 16K below the kernel, the decompressed
+ * kernel, the decompressor relocated past it and its bss, stack and heap.
+ * The next kernel is assumed to run at the same address as this one, and
+ * to be no larger than this one or KEXEC_DECOMP_RATIO times its zImage.
+ */
+static void kexec_boot_scratch(struct kimage *image, unsigned long *start,
+			       unsigned long *end)
+{
+	unsigned long i, mem, zsize = 0, zend = 0, ksize;
+
+	for (i = 0; i < image->nr_segments; i++) {
+		mem = image->segment[i].mem;
+		if (image->start >= mem &&
+		    image->start < mem + image->segment[i].memsz) {
+			zsize = image->segment[i].memsz;
+			zend = mem + zsize;
+		}
+	}
+
+	ksize = max_t(unsigned long, KEXEC_DECOMP_RATIO * zsize,
+		      _end - _text);
+	*start = __pa(swapper_pg_dir);
+	*end = max(__pa(_text) + ksize + zsize, zend) + KEXEC_DECOMP_SCRATCH;
+}
+
+/*
+ * A log buffer is only worth handing over if neither the new image's
+ * segments nor the boot of the new kernel will write on top of it.
+ */
+static int kexec_log_clobbered(struct kimage *image,
+			       const struct tag_kexec_log *log)
+{
+	unsigned long i, mstart, mend;
+
+	for (i = 0; i < image->nr_segments; i++) {
+		mstart = image->segment[i].mem;
+		mend = mstart + image->segment[i].memsz;
+		if (mstart < log->start + log->size && log->start < mend) {
+			printk(KERN_WARNING "kexec: %s overwritten by segment %lu\n",
+			       log->name, i);
+			return 1;
+		}
+	}
+
+	kexec_boot_scratch(image, &mstart, &mend);
+	if (mstart < log->start + log->size && log->start < mend) {
+		printk(KERN_WARNING "kexec: %s overwritten by the new kernel "
+		       "at %#lx-%#lx\n", log->name, mstart, mend);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Rewrite the new kernel's ATAG list: drop any handoff tags inherited
+ * from /proc/atags and append the ones queued for this kexec.  The list
+ * is only touched if it is an ATAG list and ends within its page.
+ */
+static void kexec_append_handoff_tags(struct kimage *image)
+{
+	struct page *page;
+	struct tag *t, *d;
+	u32 *base, *limit, size;
+	unsigned int i;
+
+	page = kexec_dest_page(image, kexec_boot_atags);
+	if (!page)
+		return;
+
+	base = kmap(page);
+	limit = base + PAGE_SIZE / sizeof(u32);
+	t = (struct tag *)(base + ((kexec_boot_atags & ~PAGE_MASK) >> 2));
+	if (t->hdr.tag != ATAG_CORE)
+		goto out;
+
+	for (d = t; (u32 *)d + 2 <= limit && d->hdr.size; d = tag_next(d))
+		;
+	if ((u32 *)d + 2 > limit)
+		goto out;
+
+	for (d = t; (size = t->hdr.size); t = (struct tag *)((u32 *)t + size)) {
+		if ((t->hdr.tag & ATAG_KEXEC_MASK) == ATAG_KEXEC_BASE)
+			continue;
+		if (d != t)
+			memmove(d, t, size << 2);
+		d = (struct tag *)((u32 *)d + size);
+	}
+
+	for (i = 0; i < kexec_handoff_words; i += size) {
+		t = (struct tag *)&kexec_handoff_tags[i];
+		size = t->hdr.size;
+		if (t->hdr.tag == ATAG_KEXEC_LOG &&
+		    kexec_log_clobbered(image, &t->u.kexec_log))
+			continue;
+		if ((u32 *)d + size + 2 > limit) {
+			printk(KERN_WARNING "kexec: no room for handoff tags\n");
+			break;
+		}
+		memcpy(d, t, size << 2);
+		d = (struct tag *)((u32 *)d + size);
+	}
+	d->hdr.tag = ATAG_NONE;
+	d->hdr.size = 0;
+out:
+	kunmap(page);
+}
+
 /*
  * Function pointer to optional machine-specific reinitialization
  */
@@ -85,7 +382,7 @@ void machine_kexec(struct kimage *image)
 	unsigned long page_list;
 	unsigned long reboot_code_buffer_phys;
 	void *reboot_code_buffer;
-
+	int cached_copy;
 
 	page_list = image->head & PAGE_MASK;
 
@@ -99,6 +396,7 @@ void machine_kexec(struct kimage *image)
 	kexec_indirection_page = page_list;
 	kexec_mach_type = machine_arch_type;
 	kexec_boot_atags = image->start - KEXEC_ARM_ZIMAGE_OFFSET + KEXEC_ARM_ATAGS_OFFSET;
+	cached_copy = kexec_setup_copy_runs(image);
 
 	/* copy our kernel relocation code to the control code page */
 	memcpy(reboot_code_buffer,
@@ -111,13 +409,21 @@ void machine_kexec(struct kimage *image)
 
 	if (kexec_reinit)
 		kexec_reinit();
+	kexec_timeline_handoff();
+	kexec_append_handoff_tags(image);
 	local_irq_disable();
 	local_fiq_disable();
 	setup_mm_for_reboot(0); /* mode is not used, so just pass 0*/
 	flush_cache_all();
 	outer_flush_all();
 	outer_disable();
-	cpu_proc_fin();
+	/*
+	 * With a copy-run table, relocate_new_kernel switches to its own
+	 * cacheable identity map, does the copy and only then cleans and
+	 * disables the caches itself.
+	 */
+	if (!cached_copy)
+		cpu_proc_fin();
 	outer_inv_all();
 	flush_cache_all();
 	cpu_reset(reboot_code_buffer_phys);
@@ -685,6 +685,53 @@ static int __init parse_tag_cmdline(const struct tag *tag)
 
 __tagtable(ATAG_CMDLINE, parse_tag_cmdline);
 
+unsigned int kexec_handoff_flags;
+
+static int __init parse_tag_kexec_handoff(const struct tag *tag)
+{
+	kexec_handoff_flags = tag->u.kexec_handoff.flags;
+	printk(KERN_INFO "kexec handoff flags 0x%08x\n", kexec_handoff_flags);
+	return 0;
+}
+
+__tagtable(ATAG_KEXEC_HANDOFF, parse_tag_kexec_handoff);
+
+struct tag_kexec_log kexec_handoff_logs[KEXEC_HANDOFF_MAX_LOGS];
+unsigned int kexec_handoff_nr_logs;
+
+static int __init parse_tag_kexec_log(const struct tag *tag)
+{
+	struct tag_kexec_log *log;
+
+	if (kexec_handoff_nr_logs == KEXEC_HANDOFF_MAX_LOGS)
+		return 0;
+
+	log = &kexec_handoff_logs[kexec_handoff_nr_logs++];
+	*log = tag->u.kexec_log;
+	log->name[sizeof(log->name) - 1] = '\0';
+	return 0;
+}
+
+__tagtable(ATAG_KEXEC_LOG, parse_tag_kexec_log);
+
+/**
+ * kexec_handoff_find_log() - look up a log kept by the previous kernel
+ * @name: name it was handed over as
+ *
+ * Returns NULL if there is no such log or it could not be preserved.
+ */
+struct tag_kexec_log *kexec_handoff_find_log(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < kexec_handoff_nr_logs; i++)
+		if (kexec_handoff_logs[i].size &&
+		    !strcmp(kexec_handoff_logs[i].name, name))
+			return &kexec_handoff_logs[i];
+	return NULL;
+}
+EXPORT_SYMBOL(kexec_handoff_find_log);
+
 #ifdef CONFIG_BOOTINFO
 
 static int __init parse_tag_powerup_reason(const struct tag *tag)
@@ -848,6 +895,48 @@ static void __init reserve_crashkernel(void)
 static inline void reserve_crashkernel(void) {}
 #endif /* CONFIG_KEXEC */
 
+#ifdef CONFIG_KEXEC_PRESTAGE
+/*
+ * Pick up the "kexec_prestage=size@start" region; it is removed from
+ * the allocator by arm_memblock_init().
+ */
+static int __init early_kexec_prestage(char *p)
+{
+	unsigned long size, start;
+
+	size = memparse(p, &p);
+	if (*p != '@')
+		return -EINVAL;
+	start = memparse(p + 1, &p);
+
+	if (!size || (start & ~PAGE_MASK) || (size & ~PAGE_MASK)) {
+		printk(KERN_WARNING "kexec_prestage: region must be page "
+		       "aligned\n");
+		return -EINVAL;
+	}
+
+	kexec_prestage_res.start = start;
+	kexec_prestage_res.end = start + size - 1;
+	return 0;
+}
+early_param("kexec_prestage", early_kexec_prestage);
+
+static void __init reserve_kexec_prestage(void)
+{
+	if (kexec_prestage_res.end == kexec_prestage_res.start)
+		return;
+
+	printk(KERN_INFO "Reserving %ldMB of memory at %ldMB "
+	       "for pre-staged kexec images\n",
+	       (unsigned long)(resource_size(&kexec_prestage_res) >> 20),
+	       (unsigned long)(kexec_prestage_res.start >> 20));
+
+	insert_resource(&iomem_resource, &kexec_prestage_res);
+}
+#else
+static inline void reserve_kexec_prestage(void) {}
+#endif /* CONFIG_KEXEC_PRESTAGE */
+
 static void __init squash_mem_tags(struct tag *tag)
 {
 	for (; tag->hdr.size; tag = tag_next(tag))
@@ -978,6 +1067,7 @@ void __init setup_arch(char **cmdline_p)
 		smp_init_cpus();
 #endif
 	reserve_crashkernel();
+	reserve_kexec_prestage();
 
 	cpu_init();
 	tcm_init();
@@ -997,6 +1087,7 @@ void __init setup_arch(char **cmdline_p)
 
 	if (mdesc->init_early)
 		mdesc->init_early();
+	kexec_timeline_stamp(KEXEC_TL_SETUP_ARCH);
 }
 
 
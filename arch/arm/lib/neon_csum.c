@@ -0,0 +1,103 @@
+/*
+ *  linux/arch/arm/lib/neon_csum.c
+ *
+ *  Runtime selection of the NEON csum_partial() and copy-and-checksum
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/hardirq.h>
+#include <linux/irqflags.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <net/checksum.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+
+/* The scalar routines, past the size check in csumpartial*.S */
+extern __wsum __csum_partial_arm(const void *buff, int len, __wsum sum);
+extern __wsum __csum_partial_copy_nocheck_arm(const void *src, void *dst,
+					      int len, __wsum sum);
+extern __wsum __csum_partial_copy_from_user_arm(const void __user *src,
+						void *dst, int len,
+						__wsum sum, int *err_ptr);
+
+/* keeps the 32-bit lanes of __csum_partial_neon() from overflowing */
+#define NEON_CSUM_CHUNK		(1 << 20)
+
+/*
+ * Same rules as neon_string.c: no NEON before vfp_init() has set
+ * HWCAP_NEON, in interrupt context or with IRQs off.  Most receive
+ * checksums are computed in softirq context and stay scalar; socket
+ * sends and checksums done on behalf of a process take the NEON path.
+ */
+static inline int neon_csum_usable(void)
+{
+	return (elf_hwcap & HWCAP_NEON) && !in_interrupt() &&
+		!irqs_disabled();
+}
+
+/*
+ * Whole 64-byte blocks go through NEON, the tail through the scalar code.
+ * Block sizes are even, so the tail keeps the byte lanes of the buffer.
+ */
+static __wsum neon_csum(const void *buff, int len, __wsum sum)
+{
+	int block;
+
+	kernel_neon_begin();
+	while (len >= 64) {
+		block = min(len, NEON_CSUM_CHUNK) & ~63;
+		sum = csum_add(sum,
+			       (__force __wsum)__csum_partial_neon(buff, block));
+		buff += block;
+		len -= block;
+	}
+	kernel_neon_end();
+
+	return __csum_partial_arm(buff, len, sum);
+}
+
+__wsum neon_csum_partial(const void *buff, int len, __wsum sum)
+{
+	if (!neon_csum_usable())
+		return __csum_partial_arm(buff, len, sum);
+
+	return neon_csum(buff, len, sum);
+}
+
+/*
+ * The copy variants copy first, with the NEON memcpy() when it applies,
+ * and then checksum the destination while it is still in the L1 cache.
+ * User faults have to be taken outside kernel_neon_begin().
+ */
+__wsum neon_csum_partial_copy_nocheck(const void *src, void *dst, int len,
+				      __wsum sum)
+{
+	if (!neon_csum_usable())
+		return __csum_partial_copy_nocheck_arm(src, dst, len, sum);
+
+	memcpy(dst, src, len);
+	return neon_csum(dst, len, sum);
+}
+
+__wsum neon_csum_partial_copy_from_user(const void __user *src, void *dst,
+					int len, __wsum sum, int *err_ptr)
+{
+	unsigned long left;
+
+	if (!neon_csum_usable())
+		return __csum_partial_copy_from_user_arm(src, dst, len, sum,
+							 err_ptr);
+
+	left = __copy_from_user(dst, src, len);
+	if (left) {
+		memset(dst + len - left, 0, left);
+		*err_ptr = -EFAULT;
+	}
+
+	return neon_csum(dst, len, sum);
+}
@@ -0,0 +1,56 @@
+/*
+ *  linux/arch/arm/lib/neon_string.c
+ *
+ *  Runtime selection of the NEON memcpy() and memset()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/hardirq.h>
+#include <linux/irqflags.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+
+/* The LDM/STM routines, past the size check in memcpy.S and memset.S */
+extern void *__memcpy_arm(void *dest, const void *src, size_t n);
+extern void *__memset_arm(void *s, int c, size_t n);
+
+/*
+ * memcpy() and memset() branch here for large sizes.  HWCAP_NEON is set
+ * by vfp_init() once the unit is usable on all CPUs, so early boot falls
+ * through to the scalar code.  Interrupt context and IRQs-off sections
+ * (the low power and hotplug paths among them) are left alone as well,
+ * as the VFP context cannot be safely switched there.
+ */
+static inline int neon_string_usable(void)
+{
+	return (elf_hwcap & HWCAP_NEON) && !in_interrupt() &&
+		!irqs_disabled();
+}
+
+void *neon_memcpy(void *dest, const void *src, size_t n)
+{
+	if (!neon_string_usable())
+		return __memcpy_arm(dest, src, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(dest, src, n);
+	kernel_neon_end();
+
+	return dest;
+}
+
+void *neon_memset(void *s, int c, size_t n)
+{
+	if (!neon_string_usable())
+		return __memset_arm(s, c, n);
+
+	kernel_neon_begin();
+	__memset_neon(s, c, n);
+	kernel_neon_end();
+
+	return s;
+}
@@ -19,6 +19,17 @@
 #include <linux/gfp.h>
 #include <asm/current.h>
 #include <asm/page.h>
+#include <asm/neon.h>
+
+/*
+ * Below this size the pinning overhead is not worth it.  The NEON
+ * memcpy() only kicks in for large buffers, so follow its threshold.
+ */
+#ifdef CONFIG_NEON_MEMCPY
+#define UACCESS_MEMCPY_THRESHOLD	NEON_MEMCPY_THRESHOLD
+#else
+#define UACCESS_MEMCPY_THRESHOLD	64
+#endif
 
 static int
 pin_page_for_write(const void __user *_addr, pte_t **ptep, spinlock_t **ptlp)
@@ -55,6 +66,47 @@ pin_page_for_write(const void __user *_addr, pte_t **ptep, spinlock_t **ptlp)
 	return 1;
 }
 
+#ifdef CONFIG_NEON_MEMCPY
+static int
+pin_page_for_read(const void __user *_addr, pte_t **ptep, spinlock_t **ptlp)
+{
+	unsigned long addr = (unsigned long)_addr;
+	pgd_t *pgd;
+	pmd_t *pmd;
+	pte_t *pte;
+	pud_t *pud;
+	spinlock_t *ptl;
+
+	pgd = pgd_offset(current->mm, addr);
+	if (unlikely(pgd_none(*pgd) || pgd_bad(*pgd)))
+		return 0;
+
+	pud = pud_offset(pgd, addr);
+	if (unlikely(pud_none(*pud) || pud_bad(*pud)))
+		return 0;
+
+	pmd = pmd_offset(pud, addr);
+	if (unlikely(pmd_none(*pmd) || pmd_bad(*pmd)))
+		return 0;
+
+	/*
+	 * PROT_NONE ptes are present and young but not user accessible:
+	 * leave those to __get_user() so the copy faults as it should.
+	 */
+	pte = pte_offset_map_lock(current->mm, pmd, addr, &ptl);
+	if (unlikely(!pte_present(*pte) || !pte_young(*pte) ||
+	    !(pte_val(*pte) & L_PTE_USER))) {
+		pte_unmap_unlock(pte, ptl);
+		return 0;
+	}
+
+	*ptep = pte;
+	*ptlp = ptl;
+
+	return 1;
+}
+#endif
+
 static unsigned long noinline
 __copy_to_user_memcpy(void __user *to, const void *from, unsigned long n)
 {
@@ -112,11 +164,82 @@ __copy_to_user(void __user *to, const void *from, unsigned long n)
 	 * With frame pointer disabled, tail call optimization kicks in
 	 * as well making this test almost invisible.
 	 */
-	if (n < 64)
+	if (n < UACCESS_MEMCPY_THRESHOLD)
 		return __copy_to_user_std(to, from, n);
 	return __copy_to_user_memcpy(to, from, n);
 }
 	
+#ifdef CONFIG_NEON_MEMCPY
+static unsigned long noinline
+__copy_from_user_memcpy(void *to, const void __user *from, unsigned long n)
+{
+	int atomic;
+
+	if (unlikely(segment_eq(get_fs(), KERNEL_DS))) {
+		memcpy(to, (const void *)from, n);
+		return 0;
+	}
+
+	/*
+	 * The mmap semaphore is taken only if not in an atomic context.
+	 * Unlike copy_to_user(), copy_from_user() is often called with it
+	 * already held, so only try it and leave the copy to the standard
+	 * routine if it is contended.
+	 */
+	atomic = in_atomic();
+
+	if (!atomic && !down_read_trylock(&current->mm->mmap_sem))
+		return __copy_from_user_std(to, from, n);
+	while (n) {
+		pte_t *pte;
+		spinlock_t *ptl;
+		int tocopy;
+		char temp;
+
+		while (!pin_page_for_read(from, &pte, &ptl)) {
+			if (!atomic)
+				up_read(&current->mm->mmap_sem);
+			if (__get_user(temp, (char __user *)from)) {
+				/* zero the tail like __copy_from_user_std() */
+				memset(to, 0, n);
+				goto out;
+			}
+			if (!atomic && !down_read_trylock(&current->mm->mmap_sem))
+				return __copy_from_user_std(to, from, n);
+		}
+
+		tocopy = (~(unsigned long)from & ~PAGE_MASK) + 1;
+		if (tocopy > n)
+			tocopy = n;
+
+		memcpy(to, (const void *)from, tocopy);
+		to += tocopy;
+		from += tocopy;
+		n -= tocopy;
+
+		pte_unmap_unlock(pte, ptl);
+	}
+	if (!atomic)
+		up_read(&current->mm->mmap_sem);
+
+out:
+	return n;
+}
+
+unsigned long
+__copy_from_user(void *to, const void __user *from, unsigned long n)
+{
+	/*
+	 * See rational in __copy_to_user() above.  This one is also used
+	 * as __copy_from_user_inatomic(), e.g. for user stack walks from
+	 * interrupts: the page table lock must not be taken there.
+	 */
+	if (n < UACCESS_MEMCPY_THRESHOLD || in_interrupt())
+		return __copy_from_user_std(to, from, n);
+	return __copy_from_user_memcpy(to, from, n);
+}
+#endif
+
 static unsigned long noinline
 __clear_user_memset(void __user *addr, unsigned long n)
 {
@@ -157,7 +280,7 @@ out:
 unsigned long __clear_user(void __user *addr, unsigned long n)
 {
 	/* See rational for this in __copy_to_user() above. */
-	if (n < 64)
+	if (n < UACCESS_MEMCPY_THRESHOLD)
 		return __clear_user_std(addr, n);
 	return __clear_user_memset(addr, n);
 }
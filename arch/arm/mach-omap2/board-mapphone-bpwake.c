@@ -15,6 +15,8 @@
 #include <linux/wakelock.h>
 #include <linux/gpio_mapping.h>
 #include <linux/gpio.h>
+#include <linux/notifier.h>
+#include <linux/radio_ctrl/mdm6600_ctrl.h>
 
 #include <mach/hardware.h>
 #include <asm/prom.h>
@@ -28,6 +30,28 @@ static struct wake_lock baseband_wakeup_wakelock;
 
 #define MAPPHONE_AP_UART 0
 
+static ATOMIC_NOTIFIER_HEAD(mapphone_bpwake_chain);
+
+/**
+ * mapphone_bpwake_register_notifier - hook the BP -> AP wake trigger
+ * @nb: called from hard irq context with the trigger level
+ *
+ * Lets the IPC driver prepare its handshake as soon as the BP asks,
+ * instead of when the wakelock taken here lets the system finish
+ * resuming.
+ */
+int mapphone_bpwake_register_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&mapphone_bpwake_chain, nb);
+}
+EXPORT_SYMBOL(mapphone_bpwake_register_notifier);
+
+int mapphone_bpwake_unregister_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&mapphone_bpwake_chain, nb);
+}
+EXPORT_SYMBOL(mapphone_bpwake_unregister_notifier);
+
 static irqreturn_t mapphone_bpwake_irqhandler(int irq, void *unused)
 {
 #ifdef CONFIG_PM
@@ -38,6 +62,8 @@ static irqreturn_t mapphone_bpwake_irqhandler(int irq, void *unused)
 	 * prevent suspend for 1 sec to be safe
 	 */
 	wake_lock_timeout(&baseband_wakeup_wakelock, HZ);
+	atomic_notifier_call_chain(&mapphone_bpwake_chain,
+				   gpio_get_value(irq_to_gpio(irq)), NULL);
 	return IRQ_HANDLED;
 }
 
@@ -0,0 +1,155 @@
+/*
+ * linux/arch/arm/mach-omap2/board-mapphone-deferred.c
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Deferred probe of the devices the first frame does not need.
+ *
+ * The board code registers the boot critical devices (display, eMMC,
+ * keypad, touch) as usual, so they probe from their driver's initcall.
+ * The others are queued here and registered at late_initcall, once the
+ * drivers are loaded and the root filesystem is there: each of them from
+ * its own async thread, so the probes with long hardware delays, mostly
+ * sensors on I2C, run in parallel with each other and with init.
+ *
+ * mapphone_defer.enable=0 on the command line registers everything
+ * synchronously again.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/async.h>
+#include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/moduleparam.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+
+#include "board-mapphone.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "mapphone_defer."
+
+static bool enable = true;
+module_param(enable, bool, S_IRUGO);
+
+struct deferred_device {
+	struct list_head node;
+	struct platform_device *pdev;
+	int bus;
+	struct i2c_board_info info;
+};
+
+static LIST_HEAD(deferred_devices);
+static LIST_HEAD(deferred_domain);
+static bool deferred_started;
+
+static struct deferred_device * __init deferred_alloc(void)
+{
+	struct deferred_device *dd;
+
+	if (!enable || deferred_started)
+		return NULL;
+
+	dd = kzalloc(sizeof(*dd), GFP_KERNEL);
+	if (dd)
+		list_add_tail(&dd->node, &deferred_devices);
+
+	return dd;
+}
+
+/**
+ * mapphone_defer_platform_device - register a platform device late
+ * @pdev: device, must not be __initdata
+ *
+ * Falls back to registering @pdev right away when deferral is disabled.
+ */
+int __init mapphone_defer_platform_device(struct platform_device *pdev)
+{
+	struct deferred_device *dd = deferred_alloc();
+
+	if (!dd)
+		return platform_device_register(pdev);
+
+	dd->pdev = pdev;
+	return 0;
+}
+
+/**
+ * mapphone_defer_i2c_device - create an I2C device late
+ * @bus: I2C bus number
+ * @info: board info, copied
+ *
+ * Returns 0 if the device was queued.  Otherwise the caller has to
+ * register @info with the bus as usual.
+ */
+int __init mapphone_defer_i2c_device(int bus, struct i2c_board_info *info)
+{
+	struct deferred_device *dd = deferred_alloc();
+
+	if (!dd)
+		return -EINVAL;
+
+	dd->bus = bus;
+	dd->info = *info;
+	return 0;
+}
+
+static int deferred_register(struct deferred_device *dd)
+{
+	struct i2c_adapter *adap;
+	struct i2c_client *client;
+
+	if (dd->pdev)
+		return platform_device_register(dd->pdev);
+
+	adap = i2c_get_adapter(dd->bus);
+	if (!adap)
+		return -ENODEV;
+
+	client = i2c_new_device(adap, &dd->info);
+	i2c_put_adapter(adap);
+
+	return client ? 0 : -ENODEV;
+}
+
+/* in process context, not __init: it may still run after free_initmem */
+static void deferred_probe(void *data, async_cookie_t cookie)
+{
+	struct deferred_device *dd = data;
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = deferred_register(dd);
+	if (ret)
+		pr_err("%s: %s failed: %d\n", __func__,
+		       dd->pdev ? dd->pdev->name : dd->info.type, ret);
+	else
+		pr_info("%s: %s in %lld us\n", __func__,
+			dd->pdev ? dd->pdev->name : dd->info.type,
+			ktime_to_us(ktime_sub(ktime_get(), start)));
+
+	kfree(dd);
+}
+
+static int __init mapphone_deferred_init(void)
+{
+	struct deferred_device *dd, *n;
+
+	deferred_started = true;
+
+	list_for_each_entry_safe(dd, n, &deferred_devices, node) {
+		list_del(&dd->node);
+		async_schedule_domain(deferred_probe, dd, &deferred_domain);
+	}
+
+	return 0;
+}
+late_initcall(mapphone_deferred_init);
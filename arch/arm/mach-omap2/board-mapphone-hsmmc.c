@@ -255,7 +255,8 @@ static struct omap2_hsmmc_info mmc_controllers[] = {
 	},
 	/* [2]->wifi controller: set the controller id according to devtree */
 	{	.mmc		= 0,
-		.caps		= MMC_CAP_4_BIT_DATA | MMC_CAP_POWER_OFF_CARD,
+		.caps		= MMC_CAP_4_BIT_DATA | MMC_CAP_POWER_OFF_CARD |
+				  MMC_CAP_SDIO_IRQ,
 		.gpio_cd	= -EINVAL,
 		.gpio_wp	= -EINVAL,
 		.ocr_mask	= MMC_VDD_165_195,
@@ -0,0 +1,106 @@
+/*
+ * arch/arm/mach-omap2/board-mapphone-kexec.c
+ *
+ * Mapphone kexec handoff support
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/kexec.h>
+#include <linux/remoteproc.h>
+
+#include <asm/setup.h>
+
+#include <plat/common.h>
+#include <plat/iommu.h>
+#include <plat/serial.h>
+#include <plat/dsscomp.h>
+#include <plat/omap_hwmod.h>
+
+#include "board-mapphone.h"
+
+/*
+ * IPs that are left idle by mapphone_kexec_reinit() and therefore do
+ * not need the (slow) softreset at hwmod setup time in the next kernel.
+ * The DSS, IPU and DSP hwmods are never reset at setup anyway.
+ */
+static const char * const mapphone_kexec_no_reset[] __initconst = {
+	"iva",
+	"sl2if",
+	"iss",
+	"fdif",
+};
+
+#ifdef CONFIG_KEXEC
+/*
+ * Runs from machine_kexec() right before the jump: keep it bounded,
+ * every step below gives up rather than wait on a busy lock.
+ */
+static void mapphone_kexec_reinit(void)
+{
+	struct tag tag;
+
+#ifdef CONFIG_DSSCOMP
+	if (dsscomp_park())
+		pr_warn("kexec: display busy, not parked\n");
+#endif
+#ifdef CONFIG_REMOTE_PROC
+	rproc_stop_all();
+#endif
+#ifdef CONFIG_OMAP_IOMMU
+	iommu_quiesce_all();
+#endif
+
+	tag.hdr.tag = ATAG_KEXEC_HANDOFF;
+	tag.hdr.size = tag_size(tag_kexec_handoff);
+	tag.u.kexec_handoff.flags = KEXEC_HANDOFF_HW_QUIESCED;
+	kexec_add_handoff_tag(&tag);
+}
+#endif
+
+#ifdef CONFIG_KEXEC_TIMELINE
+/* pick up the stamp that the uncompress code left for us */
+static void __init mapphone_kexec_timeline_init(void)
+{
+	u32 *stamp = phys_to_virt(OMAP_DECOMP_STAMP);
+
+	kexec_timeline_clock = omap_32k_read_raw;
+	if (stamp[0] == OMAP_DECOMP_STAMP_MAGIC)
+		kexec_timeline_record(KEXEC_TL_DECOMPRESS, stamp[1]);
+	stamp[0] = 0;
+}
+#endif
+
+/*
+ * Called from init_early: hwmods are registered but not yet set up.
+ */
+void __init mapphone_kexec_init(void)
+{
+	struct omap_hwmod *oh;
+	int i;
+
+#ifdef CONFIG_KEXEC
+	kexec_reinit = mapphone_kexec_reinit;
+#endif
+#ifdef CONFIG_KEXEC_TIMELINE
+	mapphone_kexec_timeline_init();
+#endif
+
+	if (!(kexec_handoff_flags & KEXEC_HANDOFF_HW_QUIESCED))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(mapphone_kexec_no_reset); i++) {
+		oh = omap_hwmod_lookup(mapphone_kexec_no_reset[i]);
+		if (oh)
+			omap_hwmod_no_setup_reset(oh);
+	}
+}
@@ -109,6 +109,8 @@ static struct omapfb_platform_data mapphone_fb_pdata = {
 
 static int mapphone_panel_enable(struct omap_dss_device *dssdev);
 static void mapphone_panel_disable(struct omap_dss_device *dssdev);
+static int mapphone_panel_power_up(struct omap_dss_device *dssdev);
+static void mapphone_panel_release_reset(struct omap_dss_device *dssdev);
 
 static struct omap_video_timings mapphone_panel_timings = {
 	.x_res          = 480,
@@ -136,6 +138,8 @@ static struct mapphone_dsi_panel_data mapphone_panel_data = {
 	.use_ext_te		= false,
 	.use_esd_check		= true,
 	.set_backlight		= NULL,
+	.power_on		= mapphone_panel_power_up,
+	.release_reset		= mapphone_panel_release_reset,
 	.te_support		= true,
 	.te_scan_line		= 300,
 	.te_type		= OMAP_DSI_TE_MIPI_PHY,
@@ -322,21 +326,34 @@ static int mapphone_panel_hdmi_5v_disable(void)
 
 static void mapphone_panel_reset(bool enable)
 {
-	if (enable) { /* enable panel */
+	if (enable) { /* assert reset on a freshly powered panel */
 		if (!first_boot) {
 			gpio_set_value(mapphone_panel_data.reset_gpio, 0);
 			msleep(mapphone_panel_data.rst_delay_after_pwr);
-
-			gpio_set_value(mapphone_panel_data.reset_gpio, 1);
-			msleep(mapphone_panel_data.rst_delay_after_high);
-		} else
-			first_boot = false;
+		}
 	} else { /* disable panel */
 		gpio_set_value(mapphone_panel_data.reset_gpio, 0);
 		msleep(1);
 	}
 }
 
+static void mapphone_panel_release_reset(struct omap_dss_device *dssdev)
+{
+	/*
+	 * Change the DSS power state to INACTIVE with LCD on.  Done here
+	 * rather than in power_up, which may run while the DSI link is
+	 * brought up and must not reprogram the DSS power domain then.
+	 */
+	if (dss_pwrdm)
+		omap_set_pwrdm_state(dss_pwrdm, PWRDM_POWER_INACTIVE);
+
+	if (!first_boot) {
+		gpio_set_value(mapphone_panel_data.reset_gpio, 1);
+		msleep(mapphone_panel_data.rst_delay_after_high);
+	} else
+		first_boot = false;
+}
+
 static int mapphone_panel_regulator_enable(void)
 {
 	int i;
@@ -428,13 +445,14 @@ static void mapphone_panel_lvds_mipi_vm_1007_1280_800_enable(bool enable)
 		gpio_set_value(mapphone_displ_lcd_bl_pwm,  enable ? 0 : 1);
 }
 
-static int mapphone_panel_enable(struct omap_dss_device *dssdev)
+/*
+ * Supplies and reset assertion only, may run while the DSI link is
+ * being brought up.
+ */
+static int mapphone_panel_power_up(struct omap_dss_device *dssdev)
 {
 	int ret;
 
-	/* change the DSS power state to INACTIVE with LCD on */
-	if (dss_pwrdm)
-		omap_set_pwrdm_state(dss_pwrdm, PWRDM_POWER_INACTIVE);
 	/*
 	 * TODO:
 	 * 1. mapphone_panel_regulator_enable() and mapphone_panel_reset() are
@@ -459,6 +477,17 @@ static int mapphone_panel_enable(struct omap_dss_device *dssdev)
 	return ret;
 }
 
+static int mapphone_panel_enable(struct omap_dss_device *dssdev)
+{
+	int ret;
+
+	ret = mapphone_panel_power_up(dssdev);
+	if (!ret)
+		mapphone_panel_release_reset(dssdev);
+
+	return ret;
+}
+
 static void mapphone_panel_disable(struct omap_dss_device *dssdev)
 {
 	if (!dssdev->phy.dsi.d2l_use_ulps)
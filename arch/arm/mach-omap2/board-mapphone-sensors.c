@@ -45,6 +45,7 @@
 #include <plat/keypad.h>
 #include <plat/mux.h>
 
+#include "board-mapphone.h"
 #include "dt_path.h"
 #include <linux/of.h>
 
@@ -303,7 +304,7 @@ static void vibrator_init(void)
 			vib_pwm_period, vib_pwm_duty,
 			vib_pwm_timer_id, vib_pwm_enable_regulator);
 
-		platform_device_register(&vib_pwm);
+		mapphone_defer_platform_device(&vib_pwm);
 		of_node_put(node);
 	}
 
@@ -311,7 +312,7 @@ static void vibrator_init(void)
 	if (node != NULL) {
 		pr_info("Vibrator enabled as GPIO\n");
 		gpio_vibrator_init();
-		platform_device_register(&vib_gpio);
+		mapphone_defer_platform_device(&vib_gpio);
 	}
 }
 
@@ -370,7 +371,7 @@ static int __init lis3dh_init(struct device_node *node)
 {
 	const void *prop;
 	int len = 0;
-	struct i2c_board_info i2c_info;
+	struct i2c_board_info i2c_info = {};
 	u8 i2c_bus;
 	int err;
 
@@ -407,6 +408,9 @@ static int __init lis3dh_init(struct device_node *node)
 	else
 		i2c_bus = LIS3DH_I2C_DEFAULT_BUS;
 
+	if (!mapphone_defer_i2c_device(i2c_bus, &i2c_info))
+		return 0;
+
 	err = i2c_register_board_info(i2c_bus, &i2c_info, 1);
 	if (err) {
 		pr_err("i2c_register_board_info failed for lis3dh: %d\n", err);
@@ -1658,7 +1662,7 @@ static void __init hall_effect_init(void)
 			case 0x00170000:
 				pr_info("Rohm,BU52014HFV found!\n");
 				if (!bu52014hfv_init(node))
-					platform_device_register(
+					mapphone_defer_platform_device(
 						&mp_bu52014hfv);
 				else
 					pr_err("bu52014hfv error\n");
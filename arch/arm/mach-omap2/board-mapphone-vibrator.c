@@ -30,6 +30,7 @@
 
 #include <plat/dmtimer.h>
 
+#include "board-mapphone.h"
 #include "dt_path.h"
 #include <linux/of.h>
 
@@ -867,6 +868,6 @@ void __init mapphone_vibrator_init(void)
 	}
 	if (count) {
 		vib_timed_pdata.count = count;
-		platform_device_register(&vib_timed_dev);
+		mapphone_defer_platform_device(&vib_timed_dev);
 	}
 }
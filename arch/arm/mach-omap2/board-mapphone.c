@@ -79,6 +79,7 @@
 #include "prm-regbits-44xx.h"
 #include "prm44xx.h"
 #include "omap_ram_console.h"
+#include "smartreflex.h"
 /* for TI WiLink devices */
 #include <linux/skbuff.h>
 #include <linux/ti_wilink_st.h>
@@ -100,7 +101,6 @@
 
 char *bp_model = "CDMA";
 static unsigned long mapphone_wifi_pmena_gpio;
-static unsigned long mapphone_wifi_irq_gpio;
 
 static char boot_mode[BOOT_MODE_MAX_LEN+1];
 
@@ -193,7 +193,7 @@ static int plat_uart_enable(void)
 }
 
 static struct wl12xx_platform_data omap4_mapphone_wlan_data __initdata = {
-	.irq = -1, /* OMAP_GPIO_IRQ(GPIO_WIFI_IRQ),*/
+	.irq = 0, /* in-band SDIO interrupt, not the wlan_irqena line */
 	.board_ref_clock = WL12XX_REFCLOCK_26,
 	.board_tcxo_clock = 1,
 };
@@ -220,12 +220,10 @@ static void omap4_mapphone_wifi_init(void)
 {
 	int ret;
 	mapphone_wifi_pmena_gpio = get_gpio_by_name("wlan_pmena");
-	mapphone_wifi_irq_gpio = get_gpio_by_name("wlan_irqena");
 	ret = gpio_request(mapphone_wifi_pmena_gpio, "wifi_pmena");
 	if (ret < 0)
 		goto out;
 	gpio_direction_output(mapphone_wifi_pmena_gpio, 0);
-	omap4_mapphone_wlan_data.irq = OMAP_GPIO_IRQ(mapphone_wifi_irq_gpio);
 	if (wl12xx_set_platform_data(&omap4_mapphone_wlan_data))
 		pr_err("Error setting wl12xx data\n");
 out:
@@ -282,6 +280,7 @@ static void __init mapphone_bp_model_init(void)
 static void __init mapphone_init_early(void)
 {
 	omap2_init_common_infrastructure();
+	mapphone_kexec_init();
 	omap2_init_common_devices(NULL, NULL);
 #ifdef CONFIG_OMAP_32K_TIMER
 	omap2_gp_clockevent_set_gptimer(1);
@@ -1361,12 +1360,17 @@ static void __init mapphone_reserve(void)
 	mapphone_android_display_setup(NULL);
 #endif
 
-	if (omap_total_ram_size() <= SZ_512M)
+	if (omap_total_ram_size() <= SZ_512M) {
 		omap_ram_console_init(OMAP_RAM_CONSOLE_START_DEFAULT,
 				OMAP_RAM_CONSOLE_SIZE_DEFAULT);
-	else
+		omap_sr_class1p5_persist_init(OMAP_RAM_CONSOLE_START_DEFAULT +
+				OMAP_RAM_CONSOLE_SIZE_DEFAULT, SZ_4K);
+	} else {
 		omap_ram_console_init(OMAP_RAM_CONSOLE_1GB_START_DEFAULT,
 				OMAP_RAM_CONSOLE_1GB_SIZE_DEFAULT);
+		omap_sr_class1p5_persist_init(OMAP_RAM_CONSOLE_1GB_START_DEFAULT +
+				OMAP_RAM_CONSOLE_1GB_SIZE_DEFAULT, SZ_4K);
+	}
 
 	/* do the static reservations first */
 	memblock_remove(PHYS_ADDR_SMC_MEM, PHYS_ADDR_SMC_SIZE);
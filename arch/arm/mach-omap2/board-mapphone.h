@@ -45,6 +45,11 @@ extern void __init mapphone_usb_init(void);
 extern void __init mapphone_gadget_init(char *boot_mode);
 extern void __init mapphone_usbhost_init(void);
 extern int __init mapphone_mdm_ctrl_init(void);
+void __init mapphone_kexec_init(void);
+
+struct platform_device;
+int __init mapphone_defer_platform_device(struct platform_device *pdev);
+int __init mapphone_defer_i2c_device(int bus, struct i2c_board_info *info);
 extern struct attribute_group *mapphone_touch_vkey_prop_attr_group;
 
 struct omap_ion_platform_data;
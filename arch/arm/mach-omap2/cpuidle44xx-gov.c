@@ -0,0 +1,321 @@
+/*
+ * OMAP4 predictive cpuidle governor
+ *
+ * Many of our wakeups are periodic: modem wakes, display vsync, sensor
+ * polling.  The generic governors only see the next timer and a short
+ * residency history, so they keep entering CSWR/OSWR right before one
+ * of those interrupts and pay the full exit latency for nothing.
+ *
+ * This governor remembers, per cpu, the recent wakeup interrupts and
+ * their intervals.  An interrupt that keeps recurring at a stable
+ * interval is expected again one interval after its last occurrence,
+ * and the next wakeup is predicted as the earliest of that, the next
+ * timer and the typical recent residency.  A state is only picked if
+ * the prediction covers its target residency and the exit latency
+ * measured on this silicon: on wakeups by the timer, the time past the
+ * programmed expiry is the exit latency of the state that was entered.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos_params.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/time.h>
+
+#include "pm.h"
+
+#define OMAP4_GOV_IRQS		8	/* wakeup interrupts tracked per cpu */
+#define OMAP4_GOV_INTERVALS	8	/* residency history per cpu */
+#define OMAP4_GOV_MIN_HITS	4	/* intervals before trusting an irq */
+#define OMAP4_GOV_MAX_PERIOD	(2 * USEC_PER_SEC)
+#define OMAP4_GOV_STDDEV_THRESH	400	/* us, residency history */
+
+struct omap4_gov_irq {
+	unsigned int irq;
+	unsigned int hits;
+	ktime_t last;
+	u32 interval_us;	/* running average of the intervals */
+	u32 deviation_us;	/* running average of the deviation */
+};
+
+struct omap4_gov_device {
+	int last_state_idx;
+	bool needs_update;
+	unsigned int expected_us;
+	unsigned int predicted_us;
+
+	/* set from the idle path, irqs off */
+	unsigned int wake_irq;
+	ktime_t wake_time;
+
+	struct omap4_gov_irq irqs[OMAP4_GOV_IRQS];
+	u32 exit_us[CPUIDLE_STATE_MAX];
+	u32 intervals[OMAP4_GOV_INTERVALS];
+	int interval_ptr;
+};
+
+static DEFINE_PER_CPU(struct omap4_gov_device, omap4_gov_devices);
+
+/* use the recurring interrupts in the prediction */
+static bool predict_irqs = true;
+module_param(predict_irqs, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(predict_irqs,
+	"Predict the next wakeup from recurring interrupts");
+
+/**
+ * omap4_idle_gov_note_wakeup - record the interrupt that ended an idle
+ * @irq: GIC interrupt id pending at wakeup, 1023 for none
+ * @now: time of the wakeup
+ *
+ * Called by the OMAP4 idle code with irqs still off.
+ */
+void omap4_idle_gov_note_wakeup(unsigned int irq, ktime_t now)
+{
+	struct omap4_gov_device *data = &__get_cpu_var(omap4_gov_devices);
+
+	data->wake_irq = irq;
+	data->wake_time = now;
+}
+
+static void omap4_gov_update_irq(struct omap4_gov_device *data)
+{
+	struct omap4_gov_irq *e, *victim = NULL;
+	unsigned int irq = data->wake_irq;
+	s64 delta;
+	int i;
+
+	/* IPIs and local timers, the latter being predicted anyway */
+	if (irq < 32 || irq >= 1020)
+		return;
+
+	for (i = 0; i < OMAP4_GOV_IRQS; i++) {
+		e = &data->irqs[i];
+		if (e->hits && e->irq == irq)
+			goto found;
+		if (!victim || !e->hits ||
+		    (victim->hits && ktime_to_ns(e->last) <
+				     ktime_to_ns(victim->last)))
+			victim = e;
+	}
+
+	memset(victim, 0, sizeof(*victim));
+	victim->irq = irq;
+	victim->hits = 1;
+	victim->last = data->wake_time;
+	return;
+
+found:
+	delta = ktime_to_us(ktime_sub(data->wake_time, e->last));
+	e->last = data->wake_time;
+	if (delta <= 0 || delta > OMAP4_GOV_MAX_PERIOD) {
+		e->hits = 1;
+		return;
+	}
+
+	if (e->hits == 1) {
+		e->interval_us = delta;
+		e->deviation_us = 0;
+	} else {
+		e->deviation_us = (e->deviation_us * 3 +
+				   abs((s32)delta - (s32)e->interval_us)) / 4;
+		e->interval_us = (e->interval_us * 3 + delta) / 4;
+	}
+	if (e->hits < UINT_MAX)
+		e->hits++;
+}
+
+/*
+ * Earliest expected occurrence of a recurring interrupt, in us from
+ * now.  Interrupts that stopped coming are forgotten.
+ */
+static unsigned int omap4_gov_predict_irqs(struct omap4_gov_device *data,
+					   ktime_t now)
+{
+	unsigned int predicted = UINT_MAX;
+	int i;
+
+	for (i = 0; i < OMAP4_GOV_IRQS; i++) {
+		struct omap4_gov_irq *e = &data->irqs[i];
+		s64 elapsed;
+		u32 next;
+
+		if (e->hits < OMAP4_GOV_MIN_HITS ||
+		    e->deviation_us > e->interval_us / 8)
+			continue;
+
+		elapsed = ktime_to_us(ktime_sub(now, e->last));
+		if (elapsed < 0)
+			elapsed = 0;
+		if (elapsed > 4 * (s64)e->interval_us) {
+			e->hits = 0;
+			continue;
+		}
+
+		/* next occurrence after now, allowing for missed ones */
+		next = e->interval_us - (u32)elapsed % e->interval_us;
+		if (next > e->deviation_us)
+			next -= e->deviation_us;
+		predicted = min(predicted, next);
+	}
+
+	return predicted;
+}
+
+/* average of the recent residencies, if they are consistent */
+static unsigned int omap4_gov_typical(struct omap4_gov_device *data)
+{
+	u64 avg = 0, variance = 0;
+	int i;
+
+	for (i = 0; i < OMAP4_GOV_INTERVALS; i++)
+		avg += data->intervals[i];
+	avg /= OMAP4_GOV_INTERVALS;
+
+	for (i = 0; i < OMAP4_GOV_INTERVALS; i++) {
+		s64 diff = (s64)data->intervals[i] - avg;
+
+		variance += diff * diff;
+	}
+	variance /= OMAP4_GOV_INTERVALS;
+
+	if (avg && variance < OMAP4_GOV_STDDEV_THRESH * OMAP4_GOV_STDDEV_THRESH)
+		return avg;
+	return UINT_MAX;
+}
+
+/**
+ * omap4_gov_update - learn from the idle period that just ended
+ * @dev: the CPU
+ */
+static void omap4_gov_update(struct cpuidle_device *dev)
+{
+	struct omap4_gov_device *data = &__get_cpu_var(omap4_gov_devices);
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+	int idx = dev->last_state ? dev->last_state - dev->states :
+				    data->last_state_idx;
+
+	if (idx < 0 || idx >= dev->state_count)
+		idx = data->last_state_idx;
+
+	/*
+	 * Woken at or after the timer: the time past its expiry is what
+	 * this state took to exit.  Ignore the odd outlier, e.g. an
+	 * interrupt handler that ran before we got to take the stamp.
+	 */
+	if (measured_us >= data->expected_us) {
+		u32 overshoot = measured_us - data->expected_us;
+
+		if (overshoot < 4 * dev->states[idx].exit_latency + 1000)
+			data->exit_us[idx] = (data->exit_us[idx] * 7 +
+					      overshoot) / 8;
+	}
+
+	omap4_gov_update_irq(data);
+	data->wake_irq = 1023;
+
+	data->intervals[data->interval_ptr++] = measured_us;
+	if (data->interval_ptr >= OMAP4_GOV_INTERVALS)
+		data->interval_ptr = 0;
+}
+
+/**
+ * omap4_gov_select - selects the next idle state to enter
+ * @dev: the CPU
+ */
+static int omap4_gov_select(struct cpuidle_device *dev)
+{
+	struct omap4_gov_device *data = &__get_cpu_var(omap4_gov_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	struct timespec t;
+	ktime_t now;
+	int i;
+
+	if (data->needs_update) {
+		omap4_gov_update(dev);
+		data->needs_update = false;
+	}
+
+	data->last_state_idx = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	now = ktime_get();
+	t = ktime_to_timespec(tick_nohz_get_sleep_length());
+	data->expected_us = t.tv_sec * USEC_PER_SEC + t.tv_nsec / NSEC_PER_USEC;
+
+	data->predicted_us = min(data->expected_us, omap4_gov_typical(data));
+	if (predict_irqs)
+		data->predicted_us = min(data->predicted_us,
+					 omap4_gov_predict_irqs(data, now));
+
+	/* states are ordered from the shallowest to the deepest */
+	for (i = 0; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->flags & CPUIDLE_FLAG_IGNORE)
+			continue;
+		if (s->target_residency > data->predicted_us)
+			continue;
+		/* the table has the worst case, which is what QoS wants */
+		if (s->exit_latency > latency_req)
+			continue;
+		if (data->exit_us[i] >= data->predicted_us)
+			continue;
+
+		data->last_state_idx = i;
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * omap4_gov_reflect - records that data structures need update
+ * @dev: the CPU
+ */
+static void omap4_gov_reflect(struct cpuidle_device *dev)
+{
+	struct omap4_gov_device *data = &__get_cpu_var(omap4_gov_devices);
+
+	data->needs_update = true;
+}
+
+/**
+ * omap4_gov_enable_device - scans a CPU's states and does setup
+ * @dev: the CPU
+ */
+static int omap4_gov_enable_device(struct cpuidle_device *dev)
+{
+	struct omap4_gov_device *data = &per_cpu(omap4_gov_devices, dev->cpu);
+	int i;
+
+	memset(data, 0, sizeof(struct omap4_gov_device));
+	data->wake_irq = 1023;
+	for (i = 0; i < dev->state_count; i++)
+		data->exit_us[i] = dev->states[i].exit_latency;
+
+	return 0;
+}
+
+static struct cpuidle_governor omap4_governor = {
+	.name =		"omap4",
+	.rating =	30,
+	.enable =	omap4_gov_enable_device,
+	.select =	omap4_gov_select,
+	.reflect =	omap4_gov_reflect,
+	.owner =	THIS_MODULE,
+};
+
+static int __init omap4_gov_init(void)
+{
+	return cpuidle_register_governor(&omap4_governor);
+}
+module_init(omap4_gov_init);
@@ -20,6 +20,8 @@
 #include <linux/delay.h>
 #include <linux/cpu_pm.h>
 #include <linux/pm_qos_params.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/cacheflush.h>
 #include <asm/proc-fns.h>
@@ -29,6 +31,7 @@
 #include <mach/omap-wakeupgen.h>
 
 #include <plat/gpio.h>
+#include <plat/common.h>
 
 #include "clockdomain.h"
 #include "pm.h"
@@ -99,6 +102,16 @@ struct omap4_processor_cx {
 struct omap4_processor_cx omap4_power_states[OMAP4_MAX_STATES];
 static struct powerdomain *mpu_pd, *cpu1_pd, *core_pd;
 static struct omap4_processor_cx *omap4_idle_requested_cx[NR_CPUS];
+/*
+ * Coupled idle: each cpu posts its request in omap4_idle_requested_cx and
+ * sleeps.  The last one in sets omap4_idle_cluster_cx and the cpus commit
+ * to it by bumping omap4_idle_ready_count; the cluster goes down once all
+ * online cpus did, and omap4_idle_exiting holds off the next round until
+ * cpu0 is back out.  A pending interrupt cancels before that point.
+ */
+static struct omap4_processor_cx *omap4_idle_cluster_cx;
+static unsigned int omap4_idle_seq;
+static bool omap4_idle_exiting;
 static int omap4_idle_ready_count;
 static DEFINE_SPINLOCK(omap4_idle_lock);
 static struct clockdomain *cpu1_cd;
@@ -149,6 +162,198 @@ static void dwork_timer(struct work_struct *work)
 }
 
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Measured latencies, on the 32k sync counter:
+ * entry     - from omap4_enter_idle() until the cpu starts its low power
+ *	       entry (omap4_enter_sleep() or omap4_enter_lowpower()), which
+ *	       includes waiting for the other cpu in the coupled states
+ * residency - the low power entry itself, PRCM transition and ROM
+ *	       restore included
+ * exit	     - from its return until omap4_enter_idle() returns
+ * Histogram buckets double from 32us up.
+ */
+#define OMAP4_IDLE_HIST_BUCKETS	12
+#define OMAP4_IDLE_HIST_SHIFT	5
+
+struct omap4_idle_hist {
+	u32 count[OMAP4_IDLE_HIST_BUCKETS];
+	u32 max;
+	u64 total;
+};
+
+struct omap4_idle_state_stats {
+	u32 entered;
+	/* state the hardware reached, by cx type */
+	u32 reached[OMAP4_MAX_STATES];
+	struct omap4_idle_hist entry;
+	struct omap4_idle_hist residency;
+	struct omap4_idle_hist exit;
+};
+
+struct omap4_idle_stamps {
+	u32 enter;
+	u32 sleep;
+	u32 wake;
+	int reached;
+};
+
+static DEFINE_PER_CPU(struct omap4_idle_stamps, omap4_idle_stamps);
+static DEFINE_PER_CPU(struct omap4_idle_state_stats [OMAP4_MAX_STATES],
+		      omap4_idle_stats);
+
+static void omap4_idle_hist_add(struct omap4_idle_hist *h, u32 ticks)
+{
+	u32 us = ((u64)ticks * USEC_PER_SEC) >> 15;
+	int b = fls(us >> OMAP4_IDLE_HIST_SHIFT);
+
+	h->count[min(b, OMAP4_IDLE_HIST_BUCKETS - 1)]++;
+	h->max = max(h->max, us);
+	h->total += us;
+}
+
+static inline void omap4_idle_stamp_enter(void)
+{
+	struct omap4_idle_stamps *s = &__get_cpu_var(omap4_idle_stamps);
+
+	s->enter = omap_32k_read_raw();
+	s->sleep = 0;
+}
+
+static inline void omap4_idle_stamp_sleep(void)
+{
+	/* 0 means we never got that far */
+	__get_cpu_var(omap4_idle_stamps).sleep = omap_32k_read_raw() ? : 1;
+}
+
+/* @reached: cx type the hardware reached, -1 for the one requested */
+static inline void omap4_idle_stamp_wake(int reached)
+{
+	struct omap4_idle_stamps *s = &__get_cpu_var(omap4_idle_stamps);
+
+	s->wake = omap_32k_read_raw();
+	s->reached = reached;
+}
+
+/* account the idle period that just ended, irqs off */
+static void omap4_idle_account(struct omap4_processor_cx *cx)
+{
+	struct omap4_idle_stamps *s = &__get_cpu_var(omap4_idle_stamps);
+	struct omap4_idle_state_stats *st =
+		&__get_cpu_var(omap4_idle_stats)[cx->type];
+	u32 now = omap_32k_read_raw();
+
+	st->entered++;
+	if (!s->sleep) {
+		/* wfi, or aborted before the low power entry */
+		st->reached[OMAP4_STATE_C1]++;
+		omap4_idle_hist_add(&st->residency, now - s->enter);
+		return;
+	}
+
+	st->reached[s->reached < 0 ? cx->type : s->reached]++;
+	omap4_idle_hist_add(&st->entry, s->sleep - s->enter);
+	omap4_idle_hist_add(&st->residency, s->wake - s->sleep);
+	omap4_idle_hist_add(&st->exit, now - s->wake);
+}
+
+/* deepest cx the MPU subsystem actually reached, read after wakeup */
+static int omap4_idle_reached_state(void)
+{
+	int mpu = pwrdm_read_prev_pwrst(mpu_pd);
+
+	if (mpu == PWRDM_POWER_INACTIVE)
+		return OMAP4_STATE_C2;
+	if (mpu == PWRDM_POWER_RET)
+		return pwrdm_read_prev_logic_pwrst(mpu_pd) == PWRDM_POWER_OFF ?
+			OMAP4_STATE_C4 : OMAP4_STATE_C3;
+	return OMAP4_STATE_C1;
+}
+
+static void omap4_idle_show_hist(struct seq_file *s, const char *name,
+				 struct omap4_idle_hist *h, u32 n)
+{
+	int i;
+
+	seq_printf(s, "  %-9s avg %6llu max %6u us:", name,
+		   n ? div_u64(h->total, n) : 0, h->max);
+	for (i = 0; i < OMAP4_IDLE_HIST_BUCKETS; i++)
+		seq_printf(s, " %u", h->count[i]);
+	seq_printf(s, "\n");
+}
+
+static int omap4_idle_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap4_idle_state_stats *stats =
+		per_cpu(omap4_idle_stats, (long)s->private);
+	int i, j;
+
+	seq_printf(s, "buckets: <%uus, then doubling\n",
+		   1 << OMAP4_IDLE_HIST_SHIFT);
+	for (i = 0; i < OMAP4_MAX_STATES; i++) {
+		struct omap4_idle_state_stats *st = &stats[i];
+		u32 slept = st->entered - st->reached[OMAP4_STATE_C1];
+
+		if (!omap4_power_states[i].valid)
+			continue;
+		seq_printf(s, "C%d: entered %u reached", i + 1, st->entered);
+		for (j = 0; j < OMAP4_MAX_STATES; j++)
+			seq_printf(s, " C%d:%u", j + 1, st->reached[j]);
+		seq_printf(s, "\n");
+		omap4_idle_show_hist(s, "entry", &st->entry, slept);
+		omap4_idle_show_hist(s, "residency", &st->residency,
+				     st->entered);
+		omap4_idle_show_hist(s, "exit", &st->exit, slept);
+	}
+
+	return 0;
+}
+
+static int omap4_idle_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap4_idle_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap4_idle_stats_fops = {
+	.open		= omap4_idle_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init omap4_idle_debugfs_init(void)
+{
+	struct dentry *d;
+	char name[8];
+	long cpu;
+
+	if (!cpu_is_omap44xx())
+		return 0;
+
+	d = debugfs_create_dir("cpuidle44xx", NULL);
+	if (IS_ERR_OR_NULL(d))
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		snprintf(name, sizeof(name), "cpu%ld", cpu);
+		(void) debugfs_create_file(name, S_IRUGO, d, (void *)cpu,
+					   &omap4_idle_stats_fops);
+	}
+
+	return 0;
+}
+late_initcall(omap4_idle_debugfs_init);
+#else
+static inline void omap4_idle_stamp_enter(void) { }
+static inline void omap4_idle_stamp_sleep(void) { }
+static inline void omap4_idle_stamp_wake(int reached) { }
+static inline void omap4_idle_account(struct omap4_processor_cx *cx) { }
+static inline int omap4_idle_reached_state(void)
+{
+	return 0;
+}
+#endif
+
 static void omap4_update_actual_state(struct cpuidle_device *dev,
 	struct omap4_processor_cx *cx)
 {
@@ -169,6 +374,15 @@ static bool omap4_gic_interrupt_pending(void)
 	return (__raw_readl(gic_cpu + GIC_CPU_HIGHPRI) != 0x3FF);
 }
 
+/* tell the governor which interrupt ended the idle period */
+static void omap4_idle_note_wakeup(ktime_t postidle)
+{
+	void __iomem *gic_cpu = omap4_get_gic_cpu_base();
+
+	omap4_idle_gov_note_wakeup(__raw_readl(gic_cpu + GIC_CPU_HIGHPRI) &
+				   0x3FF, postidle);
+}
+
 /**
  * omap4_wfi_until_interrupt
  *
@@ -253,10 +467,13 @@ static int omap4_enter_idle_wfi(struct cpuidle_device *dev,
 	local_fiq_disable();
 
 	preidle = ktime_get();
+	omap4_idle_stamp_enter();
 
 	omap4_wfi_until_interrupt();
 
 	postidle = ktime_get();
+	omap4_idle_note_wakeup(postidle);
+	omap4_idle_account(&omap4_power_states[OMAP4_STATE_C1]);
 
 	local_fiq_enable();
 	local_irq_enable();
@@ -302,12 +519,15 @@ static void omap4_cpu_poke_others(int cpu)
 			omap4_poke_cpu(i);
 }
 
+/*
+ * Posting or withdrawing a request does not wake the other cpus: only
+ * the cluster decision and its cancellation do.
+ */
 static void omap4_cpu_update_state(int cpu, struct omap4_processor_cx *cx)
 {
 	assert_spin_locked(&omap4_idle_lock);
 
 	omap4_idle_requested_cx[cpu] = cx;
-	omap4_cpu_poke_others(cpu);
 }
 
 /**
@@ -353,10 +573,12 @@ static void omap4_enter_idle_primary(struct omap4_processor_cx *cx)
 
 	pr_debug("%s: cpu0 down\n", __func__);
 
+	omap4_idle_stamp_sleep();
 	if (cx->type == OMAP4_STATE_C2)
 		omap4_enter_sleep(0, PWRDM_POWER_INACTIVE, false);
 	else
 		omap4_enter_sleep(0, PWRDM_POWER_OFF, false);
+	omap4_idle_stamp_wake(omap4_idle_reached_state());
 
 	pr_debug("%s: cpu0 up\n", __func__);
 
@@ -415,8 +637,13 @@ static void omap4_enter_idle_secondary(int cpu)
 	omap_wakeupgen_irqmask_all(cpu, 1);
 	gic_cpu_disable();
 
-	if (!skip_off)
+	if (!skip_off) {
+		omap4_idle_stamp_sleep();
 		omap4_enter_lowpower(cpu, PWRDM_POWER_OFF);
+		/* cpu1 only sees its own domain, assume the cluster decision */
+		omap4_idle_stamp_wake(pwrdm_read_prev_pwrst(cpu1_pd) ==
+				      PWRDM_POWER_OFF ? -1 : OMAP4_STATE_C1);
+	}
 
 	omap_wakeupgen_irqmask_all(cpu, 0);
 	gic_cpu_enable();
@@ -428,6 +655,18 @@ static void omap4_enter_idle_secondary(int cpu)
 	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &cpu);
 }
 
+/* A soft offline cpu has no work coming, it only waits to be unparked */
+static struct omap4_processor_cx *omap4_deepest_state(void)
+{
+	int i;
+
+	for (i = OMAP4_MAX_STATES - 1; i > OMAP4_STATE_C1; i--)
+		if (omap4_power_states[i].valid)
+			break;
+
+	return &omap4_power_states[i];
+}
+
 /**
  * omap4_enter_idle - Programs OMAP4 to enter the specified state
  * @dev: cpuidle device
@@ -444,7 +683,8 @@ static int omap4_enter_idle(struct cpuidle_device *dev,
 	struct omap4_processor_cx *cx = cpuidle_get_statedata(state);
 	struct omap4_processor_cx *actual_cx;
 	ktime_t preidle, postidle;
-	bool idle = true;
+	bool idle = true, committed = false;
+	unsigned int seq = 0;
 	int cpu = dev->cpu;
 
 	/*
@@ -454,6 +694,9 @@ static int omap4_enter_idle(struct cpuidle_device *dev,
 	if (dev->cpu != 0 && disallow_smp_idle)
 		return omap4_enter_idle_wfi(dev, state);
 
+	if (cpu_is_soft_offline(cpu))
+		cx = omap4_deepest_state();
+
 	/* Clamp the power state at max_state */
 	if (max_state > 0 && (cx->type > max_state - 1))
 		cx = &omap4_power_states[max_state - 1];
@@ -473,6 +716,7 @@ static int omap4_enter_idle(struct cpuidle_device *dev,
 		return omap4_enter_idle_wfi(dev, state);
 
 	preidle = ktime_get();
+	omap4_idle_stamp_enter();
 
 	local_fiq_disable();
 
@@ -481,139 +725,95 @@ static int omap4_enter_idle(struct cpuidle_device *dev,
 	spin_lock(&omap4_idle_lock);
 	omap4_cpu_update_state(cpu, cx);
 
-	/* Wait for both cpus to be idle, exiting if an interrupt occurs */
-	while (idle && !omap4_all_cpus_idle()) {
+	for (;;) {
+		if (omap4_idle_exiting) {
+			if (committed && seq == omap4_idle_seq)
+				break;
+			/* cpu0 is still coming out of the previous round */
+			if (omap4_gic_interrupt_pending()) {
+				omap4_cpu_update_state(cpu, NULL);
+				spin_unlock(&omap4_idle_lock);
+				goto out;
+			}
+		} else if (!omap4_idle_cluster_cx && omap4_all_cpus_idle()) {
+			/*
+			 * The last cpu to post its request makes the decision
+			 * for the cluster and wakes the others to commit to it.
+			 */
+			omap4_idle_cluster_cx = omap4_get_idle_state();
+			omap4_idle_ready_count = 0;
+			omap4_idle_seq++;
+			omap4_cpu_poke_others(cpu);
+			continue;
+		} else if (!omap4_idle_cluster_cx) {
+			committed = false;
+		} else if (omap4_gic_interrupt_pending()) {
+			/*
+			 * If we go to sleep with an IPI pending, we will lose
+			 * it: cancel the decision, the others go back to
+			 * sleep with their request still posted.
+			 */
+			pr_debug("%s: cpu%d aborted: %d\n", __func__, cpu,
+				 omap4_idle_ready_count);
+			omap4_idle_cluster_cx = NULL;
+			omap4_idle_ready_count = 0;
+			omap4_cpu_update_state(cpu, NULL);
+			omap4_cpu_poke_others(cpu);
+			spin_unlock(&omap4_idle_lock);
+			goto out;
+		} else if (!committed || seq != omap4_idle_seq) {
+			committed = true;
+			seq = omap4_idle_seq;
+			if (++omap4_idle_ready_count == num_online_cpus()) {
+				/* everybody committed: no way back */
+				omap4_idle_exiting = true;
+				omap4_cpu_poke_others(cpu);
+				break;
+			}
+		}
+
 		spin_unlock(&omap4_idle_lock);
 		idle = omap4_idle_wait();
 		spin_lock(&omap4_idle_lock);
-	}
-
-	/*
-	 * If we waited for longer than a millisecond, pop out to the governor
-	 * to let it recalculate the desired state.
-	 */
-	if (ktime_to_us(ktime_sub(preidle, ktime_get())) > 1000)
-		idle = false;
-
-	if (!idle) {
-		omap4_cpu_update_state(cpu, NULL);
-		spin_unlock(&omap4_idle_lock);
-		goto out;
-	}
-
-	/*
-	 * If we go to sleep with an IPI pending, we will lose it.  Once we
-	 * reach this point, the other cpu is either already idle or will
-	 * shortly abort idle.  If it is already idle it can't send us an IPI,
-	 * so it is safe to check for pending IPIs here.  If it aborts idle
-	 * we will abort as well, and any future IPIs will be processed.
-	 */
-	if (omap4_gic_interrupt_pending()) {
-		omap4_cpu_update_state(cpu, NULL);
-		spin_unlock(&omap4_idle_lock);
-		goto out;
-	}
 
-	/*
-	 * Both cpus are probably idle.  There is a small chance the other cpu
-	 * just became active.  cpu 0 will set omap4_idle_ready_count to 1,
-	 * then each other cpu will increment it.  Once a cpu has incremented
-	 * the count, it cannot abort idle and must spin until either the count
-	 * has hit num_online_cpus(), or is reset to 0 by an aborting cpu.
-	 */
-	if (cpu == 0) {
-		BUG_ON(omap4_idle_ready_count != 0);
-		/* cpu0 requests shared-OFF */
-		omap4_idle_ready_count = 1;
-		/* cpu0 can no longer abort shared-OFF, but cpu1 can */
-
-		/* wait for cpu1 to ack shared-OFF, or leave idle */
-		while (omap4_idle_ready_count != num_online_cpus() &&
-		    omap4_idle_ready_count != 0 && omap4_all_cpus_idle()) {
-			spin_unlock(&omap4_idle_lock);
-			cpu_relax();
-			spin_lock(&omap4_idle_lock);
-		}
-
-		if (omap4_idle_ready_count != num_online_cpus() ||
-		    !omap4_all_cpus_idle()) {
-			pr_debug("%s: cpu1 aborted: %d %p\n", __func__,
-				omap4_idle_ready_count,
-				omap4_idle_requested_cx[1]);
-			omap4_idle_ready_count = 0;
+		/* woken by an interrupt before anything was decided */
+		if (!idle && !omap4_idle_cluster_cx) {
 			omap4_cpu_update_state(cpu, NULL);
 			spin_unlock(&omap4_idle_lock);
 			goto out;
 		}
+	}
 
-		actual_cx = omap4_get_idle_state();
-		spin_unlock(&omap4_idle_lock);
+	actual_cx = omap4_idle_cluster_cx;
+	spin_unlock(&omap4_idle_lock);
 
+	if (cpu == 0) {
 		/* cpu1 is turning itself off, continue with turning cpu0 off */
-
 		omap4_enter_idle_primary(actual_cx);
 
 		spin_lock(&omap4_idle_lock);
+		omap4_idle_cluster_cx = NULL;
 		omap4_idle_ready_count = 0;
+		omap4_idle_exiting = false;
 		omap4_cpu_update_state(cpu, NULL);
 		spin_unlock(&omap4_idle_lock);
 	} else {
-		/* wait for cpu0 to request the shared-OFF, or leave idle */
-		while ((omap4_idle_ready_count == 0) && omap4_all_cpus_idle()) {
-			spin_unlock(&omap4_idle_lock);
-			cpu_relax();
-			spin_lock(&omap4_idle_lock);
-		}
-
-		if (!omap4_all_cpus_idle()) {
-			pr_debug("%s: cpu0 aborted: %d %p\n", __func__,
-				omap4_idle_ready_count,
-				omap4_idle_requested_cx[0]);
-			omap4_cpu_update_state(cpu, NULL);
-			spin_unlock(&omap4_idle_lock);
-			goto out;
-		}
-
 		pr_debug("%s: cpu1 acks\n", __func__);
-		/* ack shared-OFF */
-		if (omap4_idle_ready_count > 0)
-			omap4_idle_ready_count++;
-		BUG_ON(omap4_idle_ready_count > num_online_cpus());
-
-		while (omap4_idle_ready_count != num_online_cpus() &&
-		    omap4_idle_ready_count != 0) {
-			spin_unlock(&omap4_idle_lock);
-			cpu_relax();
-			spin_lock(&omap4_idle_lock);
-		}
-
-		if (omap4_idle_ready_count == 0) {
-			pr_debug("%s: cpu0 aborted: %d %p\n", __func__,
-				omap4_idle_ready_count,
-				omap4_idle_requested_cx[0]);
-			omap4_cpu_update_state(cpu, NULL);
-			spin_unlock(&omap4_idle_lock);
-			goto out;
-		}
-
-		/* cpu1 can no longer abort shared-OFF */
-
-		actual_cx = omap4_get_idle_state();
-		spin_unlock(&omap4_idle_lock);
-
 		omap4_enter_idle_secondary(cpu);
 
+		/* releases cpu0, see omap4_enter_idle_primary() */
 		spin_lock(&omap4_idle_lock);
 		omap4_idle_ready_count = 0;
 		omap4_cpu_update_state(cpu, NULL);
 		spin_unlock(&omap4_idle_lock);
 
 		clkdm_allow_idle(cpu1_cd);
-
 	}
 
 out:
 	postidle = ktime_get();
+	omap4_idle_note_wakeup(postidle);
+	omap4_idle_account(actual_cx);
 
 	omap4_update_actual_state(dev, actual_cx);
 
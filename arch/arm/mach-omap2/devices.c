@@ -429,6 +429,18 @@ static struct platform_device omap_pcm = {
 	.id	= -1,
 };
 
+/* Large SDRAM buffers and long periods for low power playback */
+static struct platform_device omap_pcm_deep = {
+	.name	= "omap-pcm-audio-deep",
+	.id	= -1,
+};
+
+/* Short periods and high priority DMA for interactive playback */
+static struct platform_device omap_pcm_ll = {
+	.name	= "omap-pcm-audio-ll",
+	.id	= -1,
+};
+
 /*
  * Device for the ASoC OMAP4 HDMI machine driver
  */
@@ -486,6 +498,10 @@ static void omap_init_audio(void)
 		platform_device_register(&omap_mcbsp5);
 
 	platform_device_register(&omap_pcm);
+	if (cpu_is_omap44xx()) {
+		platform_device_register(&omap_pcm_deep);
+		platform_device_register(&omap_pcm_ll);
+	}
 }
 
 #else
@@ -19,6 +19,8 @@
 #include <linux/clk.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <trace/events/power.h>
 #include <plat/common.h>
 #include <plat/omap_device.h>
 #include <plat/omap_hwmod.h>
@@ -177,6 +179,8 @@ struct omap_vdd_user_list {
  * @vdd_user_list: The vdd user list
  * @voltdm:	Voltage domains for which dvfs info stored
  * @dev_list:	Device list maintained per domain
+ * @cache_volt:	last voltage looked up for the domain's first device
+ * @cache_freq:	rate of the domain's first device at cache_volt
  *
  * This is a fundamental structure used to store all the required
  * DVFS related information for a vdd.
@@ -188,11 +192,47 @@ struct omap_vdd_dvfs_info {
 	struct plist_head vdd_user_list;
 	struct voltagedomain *voltdm;
 	struct list_head dev_list;
+
+	unsigned long cache_volt;
+	unsigned long cache_freq;
+
+	/* timing of the last _dvfs_scale(), in us */
+	unsigned int last_volt_us;
+	unsigned int last_clk_us;
+};
+
+/**
+ * struct omap_dvfs_request - A pending omap_device_scale() call
+ * @node:	entry in omap_dvfs_pending
+ * @req_dev:	device requesting the scale
+ * @target_dev:	device to be scaled
+ * @rate:	requested rate
+ * @tdvfs_info:	dvfs info of target_dev once the request is added
+ * @ret:	result of the request
+ * @scaled:	the domain has been scaled with this request in
+ * @done:	the request has been processed, ret is final
+ *
+ * Requests are queued before taking omap_dvfs_lock, so that whoever
+ * holds it next adds all those that queued up during the previous
+ * transition and scales each of their domains just once.
+ */
+struct omap_dvfs_request {
+	struct list_head node;
+	struct device *req_dev;
+	struct device *target_dev;
+	unsigned long rate;
+	struct omap_vdd_dvfs_info *tdvfs_info;
+	int ret;
+	bool scaled;
+	bool done;
 };
 
 static LIST_HEAD(omap_dvfs_info_list);
 DEFINE_MUTEX(omap_dvfs_lock);
 
+static LIST_HEAD(omap_dvfs_pending);
+static DEFINE_SPINLOCK(omap_dvfs_pending_lock);
+
 /* Dvfs scale helper function */
 static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 		struct omap_vdd_dvfs_info *tdvfs_info);
@@ -517,6 +557,54 @@ static int _remove_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
 	return ret;
 }
 
+/**
+ * _dep_resolve() - Resolve the dependent domain of a dependency table
+ * @dev:	device requesting the dependency scan (req_dev)
+ * @dep_info:	dependency information to resolve
+ *
+ * Looks up the voltage domain and dvfs info of the dependent domain and
+ * allocates the per entry rate cache.  Done once: domains are registered
+ * at init and never go away.
+ *
+ * Returns 0 if all went well.
+ */
+static int _dep_resolve(struct device *dev, struct omap_vdd_dep_info *dep_info)
+{
+	struct omap_vdd_dvfs_info *tdvfs_info;
+
+	/* populate voltdm if it is not present */
+	if (!dep_info->_dep_voltdm) {
+		dep_info->_dep_voltdm = voltdm_lookup(dep_info->name);
+		if (!dep_info->_dep_voltdm) {
+			dev_warn(dev, "%s: unable to get vdm%s\n",
+				__func__, dep_info->name);
+			return -ENODEV;
+		}
+	}
+
+	tdvfs_info = _voltdm_to_dvfs_info(dep_info->_dep_voltdm);
+	if (!tdvfs_info) {
+		dev_warn(dev, "%s: no dvfs_info\n",
+				__func__);
+		return -ENODEV;
+	}
+	if (!_dvfs_info_to_dev(tdvfs_info)) {
+		dev_warn(dev, "%s: no target_dev\n",
+			__func__);
+		return -ENODEV;
+	}
+
+	if (!dep_info->_dep_freq) {
+		dep_info->_dep_freq = kcalloc(dep_info->nr_dep_entries,
+					sizeof(unsigned long), GFP_KERNEL);
+		if (!dep_info->_dep_freq)
+			return -ENOMEM;
+	}
+
+	dep_info->_dep_dvfs_info = tdvfs_info;
+	return 0;
+}
+
 /**
  * _dep_scan_table() - Scan a dependency table and mark for scaling
  * @dev:	device requesting the dependency scan (req_dev)
@@ -525,7 +613,9 @@ static int _remove_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
  *
  * This runs down the table provided to find the match for main_volt
  * provided and sets up a scale request for the dependent domain
- * for the dependent voltage.
+ * for the dependent voltage.  The dependent domain and the rate for
+ * each entry are only looked up the first time and cached in dep_info,
+ * which assumes the OPP tables are final by the time anyone scales.
  *
  * Returns 0 if all went well.
  */
@@ -558,43 +648,31 @@ static int _dep_scan_table(struct device *dev,
 		return -EINVAL;
 	}
 
-	/* populate voltdm if it is not present */
-	if (!dep_info->_dep_voltdm) {
-		dep_info->_dep_voltdm = voltdm_lookup(dep_info->name);
-		if (!dep_info->_dep_voltdm) {
-			dev_warn(dev, "%s: unable to get vdm%s\n",
-				__func__, dep_info->name);
-			return -ENODEV;
-		}
+	if (!dep_info->_dep_dvfs_info) {
+		ret = _dep_resolve(dev, dep_info);
+		if (ret)
+			return ret;
 	}
+	tdvfs_info = dep_info->_dep_dvfs_info;
+	target_dev = _dvfs_info_to_dev(tdvfs_info);
 
 	/* See if dep_volt is possible for the vdd*/
-	ret = _add_vdd_user(_voltdm_to_dvfs_info(dep_info->_dep_voltdm),
-			dev, dep_volt);
+	ret = _add_vdd_user(tdvfs_info, dev, dep_volt);
 	if (ret)
 		dev_err(dev, "%s: Failed to add dep to domain %s volt=%ld\n",
 				__func__, dep_info->name, dep_volt);
 
 	/* And also add corresponding freq request */
-	tdvfs_info = _voltdm_to_dvfs_info(dep_info->_dep_voltdm);
-	if (!tdvfs_info) {
-		dev_warn(dev, "%s: no dvfs_info\n",
-				__func__);
-		return -ENODEV;
-	}
-	target_dev = _dvfs_info_to_dev(tdvfs_info);
-	if (!target_dev) {
-		dev_warn(dev, "%s: no target_dev\n",
-			__func__);
-		return -ENODEV;
+	new_freq = dep_info->_dep_freq[i];
+	if (!new_freq) {
+		rcu_read_lock();
+		opp = _volt_to_opp(target_dev, dep_volt);
+		if (!IS_ERR(opp))
+			new_freq = opp_get_freq(opp);
+		rcu_read_unlock();
+		dep_info->_dep_freq[i] = new_freq;
 	}
 
-	rcu_read_lock();
-	opp = _volt_to_opp(target_dev, dep_volt);
-	if (!IS_ERR(opp))
-		new_freq = opp_get_freq(opp);
-	rcu_read_unlock();
-
 	if (new_freq) {
 		ret = _add_freq_request(tdvfs_info, dev, target_dev, new_freq);
 		if (ret) {
@@ -680,7 +758,8 @@ static int _dep_scale_domains(struct device *req_dev,
 		if (tvoltdm) {
 			struct omap_vdd_dvfs_info *tdvfs_info;
 			struct device *target_dev;
-			tdvfs_info = _voltdm_to_dvfs_info(tvoltdm);
+			tdvfs_info = dep_info->_dep_dvfs_info ? :
+					_voltdm_to_dvfs_info(tvoltdm);
 			if (!tdvfs_info) {
 				dev_warn(req_dev, "%s: no dvfs_info\n",
 						__func__);
@@ -732,6 +811,8 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 	struct omap_vdd_info *vdd;
 	struct omap_volt_data *new_vdata;
 	struct omap_volt_data *curr_vdata;
+	ktime_t start;
+	s64 volt_us = 0, clk_us;
 
 	voltdm = tdvfs_info->voltdm;
 	if (IS_ERR_OR_NULL(voltdm)) {
@@ -767,6 +848,7 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 	if (curr_nom_volt == new_nom_volt) {
 		volt_scale_dir = DVFS_VOLT_SCALE_NONE;
 	} else if (curr_nom_volt < new_nom_volt) {
+		start = ktime_get();
 
 		ret = _dep_scale_domains(target_dev, vdd);
 		if (ret) {
@@ -784,9 +866,11 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 			goto fail;
 		}
 		volt_scale_dir = DVFS_VOLT_SCALE_UP;
+		volt_us = ktime_us_delta(ktime_get(), start);
 	}
 
 	/* Move all devices in list to the required frequencies */
+	start = ktime_get();
 	list_for_each_entry(temp_dev, &tdvfs_info->dev_list, node) {
 		struct device *dev;
 		struct opp *opp;
@@ -831,12 +915,19 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 
 	if (ret)
 		goto fail;
+	clk_us = ktime_us_delta(ktime_get(), start);
 
 	if (DVFS_VOLT_SCALE_DOWN == volt_scale_dir) {
+		start = ktime_get();
 		voltdm_scale(voltdm, new_vdata);
 		_dep_scale_domains(target_dev, vdd);
+		volt_us = ktime_us_delta(ktime_get(), start);
 	}
 
+	tdvfs_info->last_volt_us = volt_us;
+	tdvfs_info->last_clk_us = clk_us;
+	trace_dvfs_scale(voltdm->name, new_volt, volt_us, clk_us);
+
 	/* All clear.. go out gracefully */
 	goto out;
 
@@ -850,55 +941,25 @@ out:
 	return ret;
 }
 
-/* Public functions */
-
 /**
- * omap_device_scale() - Set a new rate at which the device is to operate
- * @req_dev:	pointer to the device requesting the scaling.
- * @target_dev:	pointer to the device that is to be scaled
- * @rate:	the rnew rate for the device.
+ * _dvfs_add_request() - Add the frequency and voltage requests of a scale
+ * @r:		the request
  *
- * This API gets the device opp table associated with this device and
- * tries putting the device to the requested rate and the voltage domain
- * associated with the device to the voltage corresponding to the
- * requested rate. Since multiple devices can be assocciated with a
- * voltage domain this API finds out the possible voltage the
- * voltage domain can enter and then decides on the final device
- * rate.
+ * Adds the rate requested for r->target_dev and the matching voltage
+ * to its domain, as well as to the dependent domains, ready for the
+ * domain to be scaled.  Sets r->tdvfs_info on success.
  *
- * Return 0 on success else the error value
+ * Returns 0 on success else the error value.
  */
-int omap_device_scale(struct device *req_dev, struct device *target_dev,
-			unsigned long rate)
+static int _dvfs_add_request(struct omap_dvfs_request *r)
 {
+	struct device *req_dev = r->req_dev, *target_dev = r->target_dev;
 	struct opp *opp;
-	unsigned long volt, freq = rate, new_freq = 0;
+	unsigned long volt, freq = r->rate, new_freq = 0;
 	struct omap_vdd_dvfs_info *tdvfs_info;
-	struct platform_device *pdev;
-	struct omap_device *od;
 	struct device *dev;
 	int ret = 0;
 
-	pdev = container_of(target_dev, struct platform_device, dev);
-	if (IS_ERR_OR_NULL(pdev)) {
-		pr_err("%s: pdev is null!\n", __func__);
-		return -EINVAL;
-	}
-
-	od = container_of(pdev, struct omap_device, pdev);
-	if (IS_ERR_OR_NULL(od)) {
-		pr_err("%s: od is null!\n", __func__);
-		return -EINVAL;
-	}
-
-	if (!omap_pm_is_ready()) {
-		dev_dbg(target_dev, "%s: pm is not ready yet\n", __func__);
-		return -EBUSY;
-	}
-
-	/* Lock me to ensure cross domain scaling is secure */
-	mutex_lock(&omap_dvfs_lock);
-
 	rcu_read_lock();
 	opp = opp_find_freq_ceil(target_dev, &freq);
 	/* If we dont find a max, try a floor at least */
@@ -907,9 +968,8 @@ int omap_device_scale(struct device *req_dev, struct device *target_dev,
 	if (IS_ERR(opp)) {
 		rcu_read_unlock();
 		dev_err(target_dev, "%s: Unable to find OPP for freq%ld\n",
-			__func__, rate);
-		ret = -ENODEV;
-		goto out;
+			__func__, r->rate);
+		return -ENODEV;
 	}
 	volt = opp_get_voltage(opp);
 	rcu_read_unlock();
@@ -918,15 +978,14 @@ int omap_device_scale(struct device *req_dev, struct device *target_dev,
 	if (IS_ERR_OR_NULL(tdvfs_info)) {
 		dev_err(target_dev, "%s: (req=%s) no vdd![f=%ld, v=%ld]\n",
 			__func__, dev_name(req_dev), freq, volt);
-		ret = -ENODEV;
-		goto out;
+		return -ENODEV;
 	}
 
 	ret = _add_freq_request(tdvfs_info, req_dev, target_dev, freq);
 	if (ret) {
 		dev_err(target_dev, "%s: freqadd(%s) failed %d[f=%ld, v=%ld]\n",
 			__func__, dev_name(req_dev), ret, freq, volt);
-		goto out;
+		return ret;
 	}
 
 	ret = _add_vdd_user(tdvfs_info, req_dev, volt);
@@ -935,7 +994,7 @@ int omap_device_scale(struct device *req_dev, struct device *target_dev,
 			__func__, dev_name(req_dev), ret, freq, volt);
 		_remove_freq_request(tdvfs_info, req_dev,
 			target_dev);
-		goto out;
+		return ret;
 	}
 
 	/* Check for any dep domains and add the user request */
@@ -944,23 +1003,30 @@ int omap_device_scale(struct device *req_dev, struct device *target_dev,
 		dev_err(target_dev,
 			"%s: Error in scan domains for vdd_%s\n",
 			__func__, tdvfs_info->voltdm->name);
-		goto out;
+		return ret;
 	}
 
 	dev = _dvfs_info_to_dev(tdvfs_info);
 	if (!dev) {
 		dev_warn(dev, "%s: no target_dev\n",
 			__func__);
-		ret = -ENODEV;
-		goto out;
+		return -ENODEV;
 	}
 
 	if (dev != target_dev) {
-		rcu_read_lock();
-		opp = _volt_to_opp(dev, volt);
-		if (!IS_ERR(opp))
-			new_freq = opp_get_freq(opp);
-		rcu_read_unlock();
+		if (tdvfs_info->cache_volt == volt) {
+			new_freq = tdvfs_info->cache_freq;
+		} else {
+			rcu_read_lock();
+			opp = _volt_to_opp(dev, volt);
+			if (!IS_ERR(opp))
+				new_freq = opp_get_freq(opp);
+			rcu_read_unlock();
+			if (new_freq) {
+				tdvfs_info->cache_volt = volt;
+				tdvfs_info->cache_freq = new_freq;
+			}
+		}
 		if (new_freq) {
 			ret = _add_freq_request(tdvfs_info, req_dev, dev,
 						new_freq);
@@ -968,28 +1034,153 @@ int omap_device_scale(struct device *req_dev, struct device *target_dev,
 				dev_err(target_dev, "%s: freqadd(%s) failed %d"
 					"[f=%ld, v=%ld]\n", __func__,
 					dev_name(req_dev), ret, freq, volt);
-				goto out;
+				return ret;
 			}
 		}
 	}
 
+	r->tdvfs_info = tdvfs_info;
+	return 0;
+}
+
+/**
+ * _dvfs_process_requests() - Add and scale all the pending requests
+ *
+ * All requests that queued up are added first, then each domain they
+ * target is scaled once, to the result of all of them.  If that fails,
+ * the requests of every device that took part are dropped again.
+ *
+ * Must be called with omap_dvfs_lock held.
+ */
+static void _dvfs_process_requests(void)
+{
+	struct omap_dvfs_request *r, *t;
+	LIST_HEAD(batch);
+	int ret;
+
+	spin_lock(&omap_dvfs_pending_lock);
+	list_splice_init(&omap_dvfs_pending, &batch);
+	spin_unlock(&omap_dvfs_pending_lock);
+
+	list_for_each_entry(r, &batch, node)
+		r->ret = _dvfs_add_request(r);
+
 	/* Do the actual scaling */
-	ret = _dvfs_scale(req_dev, target_dev, tdvfs_info);
-	if (ret) {
-		dev_err(target_dev, "%s: scale by %s failed %d[f=%ld, v=%ld]\n",
-			__func__, dev_name(req_dev), ret, freq, volt);
-		_remove_freq_request(tdvfs_info, req_dev,
-			target_dev);
-		_remove_vdd_user(tdvfs_info, target_dev);
-		/* Fall through */
+	list_for_each_entry(r, &batch, node) {
+		if (r->ret || r->scaled)
+			continue;
+
+		ret = _dvfs_scale(r->req_dev, r->target_dev, r->tdvfs_info);
+
+		t = r;
+		list_for_each_entry_from(t, &batch, node) {
+			if (t->ret || t->tdvfs_info != r->tdvfs_info)
+				continue;
+			t->scaled = true;
+			if (!ret)
+				continue;
+			t->ret = ret;
+			dev_err(t->target_dev, "%s: scale by %s failed %d"
+				"[f=%ld]\n", __func__, dev_name(t->req_dev),
+				ret, t->rate);
+			_remove_freq_request(t->tdvfs_info, t->req_dev,
+				t->target_dev);
+			_remove_vdd_user(t->tdvfs_info, t->target_dev);
+		}
 	}
-	/* Fall through */
-out:
+
+	list_for_each_entry(r, &batch, node)
+		r->done = true;
+}
+
+/* Public functions */
+
+/**
+ * omap_device_scale() - Set a new rate at which the device is to operate
+ * @req_dev:	pointer to the device requesting the scaling.
+ * @target_dev:	pointer to the device that is to be scaled
+ * @rate:	the rnew rate for the device.
+ *
+ * This API gets the device opp table associated with this device and
+ * tries putting the device to the requested rate and the voltage domain
+ * associated with the device to the voltage corresponding to the
+ * requested rate. Since multiple devices can be assocciated with a
+ * voltage domain this API finds out the possible voltage the
+ * voltage domain can enter and then decides on the final device
+ * rate.
+ *
+ * Requests made while another scale is in progress are merged: the
+ * next caller to get omap_dvfs_lock does a single transition for all
+ * of them and the others return its result.
+ *
+ * Return 0 on success else the error value
+ */
+int omap_device_scale(struct device *req_dev, struct device *target_dev,
+			unsigned long rate)
+{
+	struct omap_dvfs_request req = {
+		.req_dev = req_dev,
+		.target_dev = target_dev,
+		.rate = rate,
+	};
+	struct platform_device *pdev;
+	struct omap_device *od;
+
+	pdev = container_of(target_dev, struct platform_device, dev);
+	if (IS_ERR_OR_NULL(pdev)) {
+		pr_err("%s: pdev is null!\n", __func__);
+		return -EINVAL;
+	}
+
+	od = container_of(pdev, struct omap_device, pdev);
+	if (IS_ERR_OR_NULL(od)) {
+		pr_err("%s: od is null!\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!omap_pm_is_ready()) {
+		dev_dbg(target_dev, "%s: pm is not ready yet\n", __func__);
+		return -EBUSY;
+	}
+
+	spin_lock(&omap_dvfs_pending_lock);
+	list_add_tail(&req.node, &omap_dvfs_pending);
+	spin_unlock(&omap_dvfs_pending_lock);
+
+	/* Lock me to ensure cross domain scaling is secure */
+	mutex_lock(&omap_dvfs_lock);
+	if (!req.done)
+		_dvfs_process_requests();
 	mutex_unlock(&omap_dvfs_lock);
-	return ret;
+
+	return req.ret;
 }
 EXPORT_SYMBOL(omap_device_scale);
 
+/**
+ * omap_dvfs_get_timing() - timing of the last scaling of a device's domain
+ * @target_dev:	device that was scaled
+ * @volt_us:	returns the time spent scaling and settling the voltage
+ * @clk_us:	returns the time spent switching the clocks
+ *
+ * Meant to be called right after omap_device_scale() by the requester,
+ * e.g. for cpufreq transition statistics.
+ */
+void omap_dvfs_get_timing(struct device *target_dev, unsigned int *volt_us,
+			  unsigned int *clk_us)
+{
+	struct omap_vdd_dvfs_info *tdvfs_info;
+
+	*volt_us = *clk_us = 0;
+	mutex_lock(&omap_dvfs_lock);
+	tdvfs_info = _dev_to_dvfs_info(target_dev);
+	if (!IS_ERR_OR_NULL(tdvfs_info)) {
+		*volt_us = tdvfs_info->last_volt_us;
+		*clk_us = tdvfs_info->last_clk_us;
+	}
+	mutex_unlock(&omap_dvfs_lock);
+}
+
 #ifdef CONFIG_PM_DEBUG
 static int dvfs_dump_vdd(struct seq_file *sf, void *unused)
 {
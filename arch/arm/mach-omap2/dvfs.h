@@ -23,6 +23,8 @@ int omap_dvfs_register_device(struct device *dev, char *voltdm_name,
 		char *clk_name);
 int omap_device_scale(struct device *req_dev, struct device *target_dev,
 		unsigned long rate);
+void omap_dvfs_get_timing(struct device *target_dev, unsigned int *volt_us,
+		unsigned int *clk_us);
 
 static inline bool omap_dvfs_is_any_dev_scaling(void)
 {
@@ -39,6 +41,11 @@ static inline int omap_device_scale(struct device *req_dev,
 {
 	return -EINVAL;
 }
+static inline void omap_dvfs_get_timing(struct device *target_dev,
+		unsigned int *volt_us, unsigned int *clk_us)
+{
+	*volt_us = *clk_us = 0;
+}
 static inline bool omap_dvfs_is_any_dev_scaling(void)
 {
 	return false;
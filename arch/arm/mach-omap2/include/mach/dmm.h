@@ -138,6 +138,16 @@ struct dmm *dmm_pat_init(u32 id);
  */
 s32 dmm_pat_refill(struct dmm *dmm, struct pat *desc, enum pat_mode mode);
 
+/**
+ * Program the physical address translator from a descriptor chain.
+ * The engine fetches the descriptors itself; each next pointer holds
+ * the physical address of the following descriptor (NULL ends the chain).
+ * @param dmm      Device data
+ * @param desc_pa  physical address of the first descriptor (16 aligned)
+ * @return an error status, -ENODEV if chained refill is not available.
+ */
+s32 dmm_pat_refill_chain(struct dmm *dmm, u32 desc_pa);
+
 /**
  * Clean up the physical address translator.
  * @param dmm    Device data
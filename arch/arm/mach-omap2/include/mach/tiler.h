@@ -487,6 +487,14 @@ s32 tiler_memsize(enum tiler_fmt fmt, u32 width, u32 height, u32 *alloc_pages,
  */
 u32 tiler_backpages(enum tiler_fmt fmt, u32 width, u32 height);
 
+/**
+ * Returns the size of the largest 1D (page mode) block that could
+ * currently be allocated, to tell fragmentation of the container
+ *
+ * @return Size in bytes
+ */
+u32 tiler_max_free_1d(void);
+
 /**
  * Returns virtual stride of a tiler block
  *
@@ -108,6 +108,7 @@ int omap_cpufreq_scale(struct device *req_dev, unsigned int target_freq)
 #endif
 
 	ret = omap_device_scale(req_dev, mpu_dev, freqs.new * 1000);
+	omap_dvfs_get_timing(mpu_dev, &freqs.volt_us, &freqs.clk_us);
 
 	freqs.new = omap_getspeed(0);
 
@@ -213,6 +214,40 @@ out:
 	mutex_unlock(&omap_cpufreq_lock);
 }
 
+/*
+ * Give back one OPP of a thermal throttle, for callers that would rather
+ * ramp up than jump straight back to the full speed.
+ */
+void omap_thermal_step_up(void)
+{
+	unsigned int next = max_freq;
+	int i;
+
+	if (!omap_cpufreq_ready)
+		return;
+
+	mutex_lock(&omap_cpufreq_lock);
+
+	if (max_thermal == max_freq)
+		goto out;
+
+	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (freq_table[i].frequency > max_thermal &&
+		    freq_table[i].frequency < next)
+			next = freq_table[i].frequency;
+
+	max_thermal = next;
+
+	pr_warn("%s: temperature falling, cpu throttle at max %u\n",
+		__func__, max_thermal);
+
+	if (!omap_cpufreq_suspended)
+		omap_cpufreq_scale(mpu_dev, current_target_freq);
+
+out:
+	mutex_unlock(&omap_cpufreq_lock);
+}
+
 static int omap_verify_speed(struct cpufreq_policy *policy)
 {
 	if (!freq_table)
@@ -52,6 +52,7 @@
 #include <asm/irq.h>
 #include <asm/hardware/gic.h>
 #include <asm/hardware/cache-l2x0.h>
+#include <asm/pmu.h>
 
 #include <plat/omap44xx.h>
 #include <mach/omap4-common.h>
@@ -471,6 +472,114 @@ static inline void restore_l3instr_regs(void)
 		__raw_writel(l3instr_reg[i].val, l3instr_reg[i].addr);
 }
 
+#ifdef CONFIG_PMU_DEP_CTI
+/*
+ * The Cortex-A9 PMU is part of the CPU logic and its CTI routing is lost
+ * with the EMU domain, so a perf session running across CPUx OFF would
+ * come back with stopped counters and no overflow interrupt.  Save them
+ * on the way down when the PMU is enabled and put them back only if the
+ * context was actually lost.
+ */
+#define PMU_NR_COUNTERS		6
+#define PMNC_E			(1 << 0)
+#define PMNC_N_SHIFT		11
+#define PMNC_N_MASK		0x1f
+
+struct omap4_pmu_context {
+	bool saved;
+	u32 pmnc;
+	u32 cnten;
+	u32 inten;
+	u32 userenr;
+	u32 ccnt;
+	u32 evtype[PMU_NR_COUNTERS];
+	u32 evcnt[PMU_NR_COUNTERS];
+};
+
+static DEFINE_PER_CPU(struct omap4_pmu_context, omap4_pmu_ctx);
+
+static unsigned int pmu_nr_counters(u32 pmnc)
+{
+	return min_t(unsigned int, (pmnc >> PMNC_N_SHIFT) & PMNC_N_MASK,
+		     PMU_NR_COUNTERS);
+}
+
+static void pmu_save_context(unsigned int cpu)
+{
+	struct omap4_pmu_context *ctx = &per_cpu(omap4_pmu_ctx, cpu);
+	unsigned int i;
+	u32 pmnc;
+
+	asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmnc));
+	ctx->saved = pmnc & PMNC_E;
+	if (!ctx->saved)
+		return;
+
+	/* stop the counters so the snapshot is consistent */
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmnc & ~PMNC_E));
+	isb();
+
+	ctx->pmnc = pmnc;
+	asm volatile("mrc p15, 0, %0, c9, c12, 1" : "=r" (ctx->cnten));
+	asm volatile("mrc p15, 0, %0, c9, c14, 1" : "=r" (ctx->inten));
+	asm volatile("mrc p15, 0, %0, c9, c14, 0" : "=r" (ctx->userenr));
+	asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r" (ctx->ccnt));
+
+	for (i = 0; i < pmu_nr_counters(pmnc); i++) {
+		asm volatile("mcr p15, 0, %0, c9, c12, 5" : : "r" (i));
+		isb();
+		asm volatile("mrc p15, 0, %0, c9, c13, 1"
+			     : "=r" (ctx->evtype[i]));
+		asm volatile("mrc p15, 0, %0, c9, c13, 2"
+			     : "=r" (ctx->evcnt[i]));
+	}
+
+	/* keep counting until the low power state is actually reached */
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmnc));
+	isb();
+}
+
+static void pmu_restore_context(unsigned int cpu)
+{
+	struct omap4_pmu_context *ctx = &per_cpu(omap4_pmu_ctx, cpu);
+	unsigned int i;
+	u32 pmnc;
+
+	if (!ctx->saved)
+		return;
+	ctx->saved = false;
+
+	asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmnc));
+	if (pmnc & PMNC_E)
+		return;
+
+	for (i = 0; i < pmu_nr_counters(ctx->pmnc); i++) {
+		asm volatile("mcr p15, 0, %0, c9, c12, 5" : : "r" (i));
+		isb();
+		asm volatile("mcr p15, 0, %0, c9, c13, 1"
+			     : : "r" (ctx->evtype[i]));
+		asm volatile("mcr p15, 0, %0, c9, c13, 2"
+			     : : "r" (ctx->evcnt[i]));
+	}
+
+	asm volatile("mcr p15, 0, %0, c9, c13, 0" : : "r" (ctx->ccnt));
+	asm volatile("mcr p15, 0, %0, c9, c14, 0" : : "r" (ctx->userenr));
+	asm volatile("mcr p15, 0, %0, c9, c14, 1" : : "r" (ctx->inten));
+	asm volatile("mcr p15, 0, %0, c9, c12, 1" : : "r" (ctx->cnten));
+
+	/* device OFF also lost the EMU clock setup the CTI needs */
+	if (!cpu && omap4_device_prev_state_off())
+		pmu_l3clk_init();
+	pmu_cti_init(cpu);
+
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" : : "r" (ctx->pmnc));
+	isb();
+}
+#else
+static inline void pmu_save_context(unsigned int cpu) { }
+static inline void pmu_restore_context(unsigned int cpu) { }
+#endif
+
 /*
  * OMAP4 MPUSS Low Power Entry Function
  *
@@ -618,6 +727,9 @@ cpu_prepare:
 	 */
 	gic_mask_ppi();
 
+	if (save_state)
+		pmu_save_context(cpu);
+
 	clear_cpu_prev_pwrst(cpu);
 	cpu_clear_prev_logic_pwrst(cpu);
 	set_cpu_next_pwrst(cpu, power_state);
@@ -652,6 +764,8 @@ cpu_prepare:
 	else
 		gic_unmask_ppi();
 
+	pmu_restore_context(wakeup_cpu);
+
 	/*
 	 * If !master cpu return to hotplug-path.
 	 *
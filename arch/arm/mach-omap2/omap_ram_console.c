@@ -17,6 +17,10 @@
 #include <linux/platform_device.h>
 #include <linux/platform_data/ram_console.h>
 #include <linux/memblock.h>
+#include <linux/reboot.h>
+#include <linux/string.h>
+#include <asm/kexec.h>
+#include <asm/setup.h>
 #include <plat/cpu.h>
 #include "resetreason.h"
 #include "omap_ram_console.h"
@@ -44,6 +48,36 @@ static struct platform_device ram_console_device = {
 
 static __initdata bool omap_ramconsole_inited;
 
+#ifdef CONFIG_KEXEC
+/*
+ * The buffer is away from the kernel's map; tell the kernel we kexec into
+ * where it is, so that it reads the old log from the same place.
+ */
+static int omap_ram_console_kexec_notify(struct notifier_block *nb,
+					 unsigned long event, void *unused)
+{
+	struct tag tag;
+
+	if (event != SYS_RESTART)
+		return NOTIFY_DONE;
+
+	memset(&tag, 0, sizeof(tag));
+	tag.hdr.tag = ATAG_KEXEC_LOG;
+	tag.hdr.size = tag_size(tag_kexec_log);
+	tag.u.kexec_log.start = ram_console_resources[0].start;
+	tag.u.kexec_log.size = resource_size(&ram_console_resources[0]);
+	strlcpy(tag.u.kexec_log.name, "ram_console",
+		sizeof(tag.u.kexec_log.name));
+	kexec_add_handoff_tag(&tag);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block omap_ram_console_kexec_nb = {
+	.notifier_call = omap_ram_console_kexec_notify,
+};
+#endif
+
 /**
  * omap_ram_console_register() - device_initcall to register ramconsole device
  */
@@ -63,8 +97,12 @@ static int __init omap_ram_console_register(void)
 		memblock_add(ram_console_resources[0].start,
 			(ram_console_resources[0].end -
 			 ram_console_resources[0].start + 1));
+		return ret;
 	}
 
+#ifdef CONFIG_KEXEC
+	register_reboot_notifier(&omap_ram_console_kexec_nb);
+#endif
 	return ret;
 }
 device_initcall(omap_ram_console_register);
@@ -84,8 +122,19 @@ device_initcall(omap_ram_console_register);
 
 int __init omap_ram_console_init(phys_addr_t phy_addr, size_t size)
 {
+	struct tag_kexec_log *log;
 	int ret;
 
+	/* After kexec, keep reading the buffer the previous kernel wrote */
+	log = kexec_handoff_find_log("ram_console");
+	if (log && (log->start != phy_addr || log->size != size)) {
+		pr_info("%s: using region handed over by kexec:"
+			"start=0x%08x, size=0x%08x\n",
+			__func__, log->start, log->size);
+		phy_addr = log->start;
+		size = log->size;
+	}
+
 	/* Remove the ram console region from kernel's map */
 	ret = memblock_remove(phy_addr, size);
 	if (ret) {
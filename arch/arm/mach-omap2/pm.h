@@ -12,6 +12,7 @@
 #define __ARCH_ARM_MACH_OMAP2_PM_H
 
 #include <linux/err.h>
+#include <linux/ktime.h>
 
 #include "powerdomain.h"
 
@@ -22,6 +23,14 @@ extern int omap3_can_sleep(void);
 extern int omap_set_pwrdm_state(struct powerdomain *pwrdm, u32 state);
 extern int omap3_idle_init(void);
 extern int omap4_idle_init(void);
+
+#ifdef CONFIG_OMAP4_IDLE_GOVERNOR
+extern void omap4_idle_gov_note_wakeup(unsigned int irq, ktime_t now);
+#else
+static inline void omap4_idle_gov_note_wakeup(unsigned int irq, ktime_t now)
+{
+}
+#endif
 extern void omap4_enter_sleep(unsigned int cpu, unsigned int power_state,
 				bool suspend);
 extern void omap4_trigger_ioctrl(void);
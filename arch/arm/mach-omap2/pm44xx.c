@@ -12,6 +12,7 @@
 
 #include <linux/pm.h>
 #include <linux/suspend.h>
+#include <linux/suspend_time.h>
 #include <linux/module.h>
 #include <linux/clk.h>
 #include <linux/list.h>
@@ -59,12 +60,20 @@
 #include "vc.h"
 #include "control.h"
 
+/* power_state flags, worked out once from the powerdomain name */
+#define PWRST_CPU		(1 << 0)	/* cpu0/cpu1, left to mpuss */
+#define PWRST_PARENT		(1 << 1)	/* core/mpu/iva */
+#define PWRST_L3INIT		(1 << 2)
+
 struct power_state {
 	struct powerdomain *pwrdm;
 	u32 next_state;
+	u32 flags;
 #ifdef CONFIG_SUSPEND
 	u32 saved_state;
 	u32 saved_logic_state;
+	/* set when suspend reprogrammed the domain, so resume must restore */
+	bool changed;
 #endif
 	struct list_head node;
 };
@@ -263,7 +272,9 @@ void omap4_enter_sleep(unsigned int cpu, unsigned int power_state, bool suspend)
 			OMAP4430_PRM_DEVICE_INST, OMAP4_PRM_IO_PMCTRL_OFFSET);
 	}
 
+	omap4_sched_clock_save();
 	omap4_enter_lowpower(cpu, power_state);
+	omap4_sched_clock_restore();
 
 	if (omap4_device_prev_state_off()) {
 		/* Reconfigure the trim settings as well */
@@ -561,15 +572,12 @@ static int _set_pwrdm_state(struct power_state *pwrst, u32 state,
 			    u32 logic_state)
 {
 	u32 als;
-	bool parent_power_domain = false;
+	bool parent_power_domain = pwrst->flags & PWRST_PARENT;
 	int ret = 0;
 
 	pwrst->saved_state = pwrdm_read_next_pwrst(pwrst->pwrdm);
 	pwrst->saved_logic_state = pwrdm_read_logic_retst(pwrst->pwrdm);
-	if (!strcmp(pwrst->pwrdm->name, "core_pwrdm") ||
-		!strcmp(pwrst->pwrdm->name, "mpu_pwrdm") ||
-		!strcmp(pwrst->pwrdm->name, "iva_pwrdm"))
-			parent_power_domain = true;
+	pwrst->changed = false;
 	/*
 	 * Write only to registers which are writable! Don't touch
 	 * read-only/reserved registers. If pwrdm->pwrsts_logic_ret or
@@ -581,19 +589,23 @@ static int _set_pwrdm_state(struct power_state *pwrst, u32 state,
 		als =
 		   get_achievable_state(pwrst->pwrdm->pwrsts_logic_ret,
 				logic_state, parent_power_domain);
-		if (als < pwrst->saved_logic_state)
+		if (als < pwrst->saved_logic_state) {
 			ret = pwrdm_set_logic_retst(pwrst->pwrdm, als);
+			pwrst->changed = true;
+		}
 	}
 
 	if (pwrst->pwrdm->pwrsts) {
 		pwrst->next_state =
 		   get_achievable_state(pwrst->pwrdm->pwrsts, state,
 						parent_power_domain);
-		if (pwrst->next_state < pwrst->saved_state)
+		if (pwrst->next_state < pwrst->saved_state) {
 			ret |= omap_set_pwrdm_state(pwrst->pwrdm,
 					     pwrst->next_state);
-		else
+			pwrst->changed = true;
+		} else {
 			pwrst->next_state = pwrst->saved_state;
+		}
 	}
 
 	return ret;
@@ -630,9 +642,8 @@ static void omap4_configure_pwrst(bool is_off_mode)
 #endif
 
 	list_for_each_entry(pwrst, &pwrst_list, node) {
-		if ((!strcmp(pwrst->pwrdm->name, "cpu0_pwrdm")) ||
-			(!strcmp(pwrst->pwrdm->name, "cpu1_pwrdm")))
-				continue;
+		if (pwrst->flags & PWRST_CPU)
+			continue;
 
 		ret |= _set_pwrdm_state(pwrst, state, logic_state);
 		if (ret)
@@ -640,10 +651,14 @@ static void omap4_configure_pwrst(bool is_off_mode)
 	}
 }
 
+/* Log every domain's state on resume, not just those that missed target */
+static bool dump_pwrdm_states;
+module_param(dump_pwrdm_states, bool, 0644);
+
 /**
  * omap4_restore_pwdms_after_suspend() - Restore powerdomains after suspend
  *
- * Re-program all powerdomains to saved power domain states.
+ * Re-program the powerdomains changed for suspend to their saved states.
  *
  * returns 0 if all power domains hit targeted power state, -1 if any domain
  * failed to hit targeted power state (status related to the actual restore
@@ -653,51 +668,47 @@ static int omap4_restore_pwdms_after_suspend(void)
 {
 	struct power_state *pwrst;
 	int cstate, pstate, state, ret = 0;
-
-
-	/* Print the previous power domain states */
-	pr_info("Read Powerdomain states as ...\n");
-	pr_info("0 : OFF, 1 : RETENTION, 2 : ON-INACTIVE, 3 : ON-ACTIVE\n");
+	bool header = false;
 
 	/* Restore next powerdomain state */
 	list_for_each_entry(pwrst, &pwrst_list, node) {
 		cstate = pwrdm_read_pwrst(pwrst->pwrdm);
 		pstate = pwrdm_read_prev_pwrst(pwrst->pwrdm);
+		state = (pstate == -EINVAL) ? cstate : pstate;
 
-		if (pstate == -EINVAL) {
-			state = cstate;
-			pr_info("Powerdomain (%s) is in state %d\n",
-				pwrst->pwrdm->name, state);
-		} else {
-			state = pstate;
-			pr_info("Powerdomain (%s) entered state %d\n",
-				pwrst->pwrdm->name, state);
-		}
-
-		if (state > pwrst->next_state) {
-#if 0
-			pr_info("Powerdomain (%s) didn't enter "
-			       "target state %d Vs achieved state %d. "
-			       "current state %d\n",
-			       pwrst->pwrdm->name, pwrst->next_state,
-			       pstate, cstate);
-#endif
+		if (state > pwrst->next_state)
 			ret = -1;
+
+		/* Print the previous power domain states */
+		if (dump_pwrdm_states || state > pwrst->next_state) {
+			if (!header) {
+				pr_info("Read Powerdomain states as ...\n");
+				pr_info("0 : OFF, 1 : RETENTION, "
+					"2 : ON-INACTIVE, 3 : ON-ACTIVE\n");
+				header = true;
+			}
+			pr_info("Powerdomain (%s) %s state %d\n",
+				pwrst->pwrdm->name,
+				(pstate == -EINVAL) ? "is in" : "entered",
+				state);
 		}
 
-		if (!strcmp(pwrst->pwrdm->name, "l3init_pwrdm")) {
+		if (pwrst->flags & PWRST_L3INIT) {
 			pwrdm_set_logic_retst(pwrst->pwrdm, PWRDM_POWER_RET);
 			continue;
 		}
 
+		/* Suspend left this domain as it was, nothing to undo */
+		if (!pwrst->changed)
+			continue;
+
 		/* If we have already achieved saved state, nothing to do */
 		if (cstate == pwrst->saved_state)
 			continue;
 
 		/* mpuss code takes care of this */
-		if ((!strcmp(pwrst->pwrdm->name, "cpu0_pwrdm")) ||
-			(!strcmp(pwrst->pwrdm->name, "cpu1_pwrdm")))
-				continue;
+		if (pwrst->flags & PWRST_CPU)
+			continue;
 
 		/*
 		 * Skip pd program if saved state higher than current state
@@ -724,6 +735,7 @@ static int omap4_restore_pwdms_after_suspend(void)
 static int omap4_pm_suspend(void)
 {
 	int ret = 0;
+	u64 start = local_clock(), restore;
 
 	/*
 	 * If any device was in the middle of a scale operation
@@ -757,7 +769,9 @@ static int omap4_pm_suspend(void)
 	 * domain CSWR is not supported by hardware.
 	 * More details can be found in OMAP4430 TRM section 4.3.4.2.
 	 */
+	suspend_time_record(start, "%s", __func__);
 	omap4_enter_sleep(0, PWRDM_POWER_OFF, true);
+	start = local_clock();
 	omap4_print_wakeirq();
 	prcmdebug_dump(PRCMDEBUG_LASTSLEEP);
 
@@ -765,7 +779,9 @@ static int omap4_pm_suspend(void)
 	if (off_mode_enabled)
 		omap4_device_set_state_off(0);
 
+	restore = local_clock();
 	ret = omap4_restore_pwdms_after_suspend();
+	suspend_time_record(restore, "omap4_restore_pwdms_after_suspend");
 
 	if (ret)
 		pr_err("Could not enter target state in pm_suspend\n");
@@ -784,6 +800,9 @@ static int omap4_pm_suspend(void)
 		need_sar_restore)
 		omap4_usb_sar_restore();
 
+	/* everything from wakeup on, the restore above included */
+	suspend_time_record(start, "omap4_pm_resume");
+
 	return 0;
 }
 
@@ -913,12 +932,22 @@ static int __init pwrdms_setup(struct powerdomain *pwrdm, void *unused)
 #endif
 
 	pwrst->pwrdm = pwrdm;
+	pwrst->flags = 0;
+	if (!strcmp(pwrdm->name, "cpu0_pwrdm") ||
+	    !strcmp(pwrdm->name, "cpu1_pwrdm"))
+		pwrst->flags |= PWRST_CPU;
+	if (!strcmp(pwrdm->name, "core_pwrdm") ||
+	    !strcmp(pwrdm->name, "mpu_pwrdm") ||
+	    !strcmp(pwrdm->name, "iva_pwrdm"))
+		pwrst->flags |= PWRST_PARENT;
+	if (!strcmp(pwrdm->name, "l3init_pwrdm"))
+		pwrst->flags |= PWRST_L3INIT;
+
 	if ((!strcmp(pwrdm->name, "mpu_pwrdm")) ||
 			(!strcmp(pwrdm->name, "core_pwrdm")) ||
-			(!strcmp(pwrdm->name, "cpu0_pwrdm")) ||
-			(!strcmp(pwrdm->name, "cpu1_pwrdm")))
+			(pwrst->flags & PWRST_CPU))
 		pwrst->next_state = PWRDM_POWER_ON;
-	else if (!strcmp(pwrdm->name, "l3init_pwrdm"))
+	else if (pwrst->flags & PWRST_L3INIT)
 		/* REVISIT: Remove when EHCI IO wakeup is fixed */
 		ret = _set_pwrdm_state(pwrst, PWRDM_POWER_RET, PWRDM_POWER_RET);
 	else if (!strcmp(pwrdm->name, "dss_pwrdm"))
@@ -0,0 +1,272 @@
+/*
+ * OMAP4 high resolution sched_clock
+ *
+ * The 32k sync counter only gives sched_clock a 30.5us resolution.  The
+ * Cortex-A9 global timer is a 64 bit counter in the MPU subsystem running
+ * from PERIPHCLK (half the MPU clock), so it is a few ns per tick but it
+ * changes rate with cpufreq and stops, or is reset, when the MPU
+ * subsystem goes to a low power state.  The conversion is done from an
+ * epoch that is moved on every rate change, and re-synchronised against
+ * the 32k counter after low power states in which the counter stopped.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/clk.h>
+#include <linux/clocksource.h>
+#include <linux/cpufreq.h>
+#include <linux/err.h>
+#include <linux/io.h>
+#include <linux/jiffies.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+
+#include <plat/common.h>
+#include <plat/omap44xx.h>
+
+#define GT_COUNTER_LO		0x00
+#define GT_COUNTER_HI		0x04
+#define GT_CONTROL		0x08
+#define GT_CONTROL_ENABLE	(1 << 0)
+
+/* longest stretch converted at once, the epoch is moved at least this often */
+#define GT_MAX_SECS		600
+#define GT_REFRESH_SECS		(GT_MAX_SECS / 2)
+
+/* 32k counter ticks the global timer may lag before it is deemed stopped */
+#define GT_STOP_SLACK_32K	2
+
+static void __iomem *gt_base;
+static struct clk *gt_clk;
+static bool gt_ready;
+
+/* serialises the writers, which can run on different cpus */
+static DEFINE_RAW_SPINLOCK(gt_lock);
+
+static struct {
+	seqcount_t seq;
+	u64 epoch_cyc;
+	u64 epoch_ns;
+	u32 mult;
+	u32 shift;
+} gt_cd;
+
+/*
+ * Saved on low power entry and at the start of a cpufreq change, under
+ * gt_lock.
+ */
+static u64 gt_saved_ns;
+static u32 gt_saved_32k;
+static bool gt_changing;
+
+static struct timer_list gt_refresh_timer;
+
+static u64 notrace gt_read(void)
+{
+	u32 hi, lo;
+
+	do {
+		hi = __raw_readl(gt_base + GT_COUNTER_HI);
+		lo = __raw_readl(gt_base + GT_COUNTER_LO);
+	} while (hi != __raw_readl(gt_base + GT_COUNTER_HI));
+
+	return ((u64)hi << 32) | lo;
+}
+
+static u64 notrace gt_cyc_to_ns(u64 cyc)
+{
+	unsigned seq;
+	u64 ns;
+
+	do {
+		seq = read_seqcount_begin(&gt_cd.seq);
+		ns = gt_cd.epoch_ns;
+		/* a counter reset by OFF mode must not go back in time */
+		if (cyc > gt_cd.epoch_cyc)
+			ns += ((cyc - gt_cd.epoch_cyc) * gt_cd.mult) >>
+				gt_cd.shift;
+	} while (read_seqcount_retry(&gt_cd.seq, seq));
+
+	return ns;
+}
+
+static u64 notrace ns_32k_since(u32 then)
+{
+	return ((u64)(omap_32k_read_raw() - then) * NSEC_PER_SEC) >> 15;
+}
+
+/* gt_lock held */
+static void gt_set_epoch(u64 cyc, u64 ns, unsigned long rate)
+{
+	write_seqcount_begin(&gt_cd.seq);
+	gt_cd.epoch_cyc = cyc;
+	gt_cd.epoch_ns = ns;
+	if (rate)
+		clocks_calc_mult_shift(&gt_cd.mult, &gt_cd.shift, rate,
+				       NSEC_PER_SEC, GT_MAX_SECS);
+	write_seqcount_end(&gt_cd.seq);
+}
+
+unsigned long long notrace sched_clock(void)
+{
+	if (!gt_ready)
+		return omap_32k_sched_clock();
+
+	return gt_cyc_to_ns(gt_read());
+}
+
+static void gt_refresh(unsigned long data)
+{
+	unsigned long flags;
+	u64 cyc;
+
+	raw_spin_lock_irqsave(&gt_lock, flags);
+	cyc = gt_read();
+	gt_set_epoch(cyc, gt_cyc_to_ns(cyc), 0);
+	raw_spin_unlock_irqrestore(&gt_lock, flags);
+
+	mod_timer(&gt_refresh_timer,
+		  round_jiffies(jiffies + GT_REFRESH_SECS * HZ));
+}
+
+/**
+ * omap4_sched_clock_save - note the time before the MPU subsystem sleeps
+ *
+ * Called with irqs off, right before the low power entry.
+ */
+void omap4_sched_clock_save(void)
+{
+	if (!gt_ready)
+		return;
+
+	raw_spin_lock(&gt_lock);
+	gt_saved_ns = sched_clock();
+	gt_saved_32k = omap_32k_read_raw();
+	raw_spin_unlock(&gt_lock);
+}
+
+/**
+ * omap4_sched_clock_restore - re-synchronise after a low power state
+ *
+ * Called with irqs off, right after the wakeup.  If the global timer
+ * kept counting it is left alone; if it stopped or lost its context the
+ * epoch is moved to the time elapsed on the 32k counter.
+ */
+void omap4_sched_clock_restore(void)
+{
+	u64 cyc, ns, slept, counted;
+
+	if (!gt_ready)
+		return;
+
+	if (!(__raw_readl(gt_base + GT_CONTROL) & GT_CONTROL_ENABLE))
+		__raw_writel(GT_CONTROL_ENABLE, gt_base + GT_CONTROL);
+
+	raw_spin_lock(&gt_lock);
+	slept = ns_32k_since(gt_saved_32k);
+	cyc = gt_read();
+	ns = gt_cyc_to_ns(cyc);
+
+	counted = ns > gt_saved_ns ? ns - gt_saved_ns : 0;
+	if (counted + GT_STOP_SLACK_32K * (NSEC_PER_SEC >> 15) < slept)
+		gt_set_epoch(cyc, max(ns, gt_saved_ns + slept), 0);
+	raw_spin_unlock(&gt_lock);
+}
+
+static int gt_cpufreq_transition(struct notifier_block *nb,
+				 unsigned long state, void *data)
+{
+	unsigned long flags;
+	u64 cyc, ns;
+
+	raw_spin_lock_irqsave(&gt_lock, flags);
+	cyc = gt_read();
+	ns = gt_cyc_to_ns(cyc);
+
+	switch (state) {
+	case CPUFREQ_PRECHANGE:
+		/* notified once per cpu, the clock is shared */
+		if (gt_changing)
+			break;
+		gt_set_epoch(cyc, ns, 0);
+		gt_saved_ns = ns;
+		gt_saved_32k = omap_32k_read_raw();
+		gt_changing = true;
+		break;
+	case CPUFREQ_POSTCHANGE:
+	case CPUFREQ_RESUMECHANGE:
+		/* the dpll relock is timed by the 32k counter */
+		if (gt_changing)
+			ns = max(ns, gt_saved_ns + ns_32k_since(gt_saved_32k));
+		gt_set_epoch(cyc, ns, clk_get_rate(gt_clk));
+		gt_changing = false;
+		break;
+	}
+
+	raw_spin_unlock_irqrestore(&gt_lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block gt_cpufreq_nb = {
+	.notifier_call = gt_cpufreq_transition,
+};
+
+static int __init omap4_sched_clock_cpufreq_init(void)
+{
+	if (!gt_ready)
+		return 0;
+
+	return cpufreq_register_notifier(&gt_cpufreq_nb,
+					 CPUFREQ_TRANSITION_NOTIFIER);
+}
+arch_initcall(omap4_sched_clock_cpufreq_init);
+
+/**
+ * omap4_sched_clock_init - switch sched_clock to the global timer
+ *
+ * Called from the system timer init, once the 32k counter is set up.
+ * sched_clock carries on from the 32k value so it stays monotonic.
+ */
+void __init omap4_sched_clock_init(void)
+{
+	unsigned long rate, flags;
+	u64 cyc;
+
+	gt_clk = clk_get_sys("smp_twd", NULL);
+	if (IS_ERR(gt_clk)) {
+		pr_err("%s: no PERIPHCLK, staying on the 32k counter\n",
+		       __func__);
+		return;
+	}
+	rate = clk_get_rate(gt_clk);
+
+	gt_base = ioremap(OMAP44XX_GLOBAL_TIMER_BASE, SZ_256);
+	if (!gt_base) {
+		clk_put(gt_clk);
+		return;
+	}
+
+	if (!(__raw_readl(gt_base + GT_CONTROL) & GT_CONTROL_ENABLE))
+		__raw_writel(GT_CONTROL_ENABLE, gt_base + GT_CONTROL);
+
+	seqcount_init(&gt_cd.seq);
+
+	raw_spin_lock_irqsave(&gt_lock, flags);
+	cyc = gt_read();
+	gt_set_epoch(cyc, omap_32k_sched_clock(), rate);
+	smp_wmb();
+	gt_ready = true;
+	raw_spin_unlock_irqrestore(&gt_lock, flags);
+
+	setup_timer(&gt_refresh_timer, gt_refresh, 0);
+	mod_timer(&gt_refresh_timer, jiffies + GT_REFRESH_SECS * HZ);
+
+	pr_info("sched_clock: global timer at %luMHz, resolution %uns\n",
+		rate / 1000000, (u32)((1ULL * gt_cd.mult) >> gt_cd.shift));
+}
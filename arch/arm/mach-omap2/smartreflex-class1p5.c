@@ -26,6 +26,17 @@
 #include <linux/workqueue.h>
 #include <linux/slab.h>
 #include <linux/opp.h>
+#include <linux/memblock.h>
+#include <linux/reboot.h>
+#include <linux/crc32.h>
+#include <linux/time.h>
+#include <linux/moduleparam.h>
+
+#include <asm/setup.h>
+#include <asm/kexec.h>
+
+#include <plat/cpu.h>
+#include <plat/temperature_sensor.h>
 
 #include "smartreflex.h"
 #include "voltage.h"
@@ -69,6 +80,345 @@ struct sr_class1p5_work_data {
 static struct delayed_work recal_work;
 #endif
 
+#ifdef CONFIG_OMAP_SR_CLASS1P5_PERSIST
+/*
+ * Calibrated voltages are kept in a small reserved RAM area that is
+ * preserved over warm reset and handed over on kexec, so that the next
+ * boot starts at the calibrated voltages instead of nominal ones.  They
+ * are only reused on the same silicon revision, while they are younger
+ * than the recalibration delay, and for OPPs calibrated at a temperature
+ * close to the current one.
+ */
+#define SR1P5_PERSIST_MAGIC	0x53523135	/* "SR15" */
+#define SR1P5_PERSIST_VERSION	1
+#define SR1P5_PERSIST_MAX_OPPS	8
+#define SR1P5_PERSIST_NAME	"sr_class1p5"
+#define SR1P5_TEMP_UNKNOWN	INT_MIN
+
+struct sr1p5_persist_opp {
+	u32 volt_nominal;
+	u32 volt_calibrated;
+	s32 temp;		/* milli degrees C at calibration */
+};
+
+struct sr1p5_persist_vdd {
+	char name[16];
+	struct sr1p5_persist_opp opp[SR1P5_PERSIST_MAX_OPPS];
+};
+
+struct sr1p5_persist {
+	u32 magic;
+	u32 version;
+	u32 omap_rev;
+	u32 age;		/* seconds since the calibrations were reset */
+	struct sr1p5_persist_vdd vdd[MAX_VDDS];
+	u32 crc;
+};
+
+static phys_addr_t sr1p5_persist_phys;
+static size_t sr1p5_persist_size;
+static void __iomem *sr1p5_persist_base;
+static struct sr1p5_persist sr1p5_persist;
+/* age of the calibrations is sr1p5_persist_age0 + seconds since boot */
+static long sr1p5_persist_age0;
+static DEFINE_MUTEX(sr1p5_persist_lock);
+
+/* maximum temperature difference to reuse a calibration, milli deg C */
+static int sr1p5_persist_temp_delta = 15000;
+module_param_named(persist_temp_delta, sr1p5_persist_temp_delta, int, 0644);
+
+static long sr1p5_persist_now(void)
+{
+	struct timespec ts;
+
+	get_monotonic_boottime(&ts);
+	return ts.tv_sec;
+}
+
+static int sr1p5_persist_temp(void)
+{
+	int temp;
+
+	if (omap_temp_sensor_get_temp(&temp))
+		return SR1P5_TEMP_UNKNOWN;
+	return temp;
+}
+
+/* Locking: sr1p5_persist_lock */
+static void sr1p5_persist_sync(void)
+{
+	if (!sr1p5_persist_base)
+		return;
+
+	sr1p5_persist.age = max(sr1p5_persist_age0 + sr1p5_persist_now(), 0L);
+	sr1p5_persist.crc = crc32(0, &sr1p5_persist,
+				  offsetof(struct sr1p5_persist, crc));
+	memcpy_toio(sr1p5_persist_base, &sr1p5_persist,
+		    sizeof(sr1p5_persist));
+}
+
+/* Locking: sr1p5_persist_lock */
+static void sr1p5_persist_clear(void)
+{
+	memset(&sr1p5_persist, 0, sizeof(sr1p5_persist));
+	sr1p5_persist.magic = SR1P5_PERSIST_MAGIC;
+	sr1p5_persist.version = SR1P5_PERSIST_VERSION;
+	sr1p5_persist.omap_rev = omap_rev();
+	sr1p5_persist_age0 = -sr1p5_persist_now();
+}
+
+static bool __init sr1p5_persist_check(void)
+{
+	if (sr1p5_persist.magic != SR1P5_PERSIST_MAGIC ||
+	    sr1p5_persist.version != SR1P5_PERSIST_VERSION)
+		return false;
+	if (sr1p5_persist.crc != crc32(0, &sr1p5_persist,
+				       offsetof(struct sr1p5_persist, crc))) {
+		pr_warning("%s: bad crc, dropping calibrations\n", __func__);
+		return false;
+	}
+	if (sr1p5_persist.omap_rev != omap_rev())
+		return false;
+#if CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY
+	if (sr1p5_persist.age >=
+	    CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY / MSEC_PER_SEC) {
+		pr_info("%s: calibrations are %us old, recalibrating\n",
+			__func__, sr1p5_persist.age);
+		return false;
+	}
+#endif
+	return true;
+}
+
+/* read back what the previous boot left, called before registration */
+static void __init sr1p5_persist_load(void)
+{
+	if (!sr1p5_persist_size)
+		return;
+
+	sr1p5_persist_base = ioremap(sr1p5_persist_phys,
+				     sizeof(sr1p5_persist));
+	if (!sr1p5_persist_base) {
+		pr_err("%s: unable to map 0x%08x\n", __func__,
+		       (u32)sr1p5_persist_phys);
+		return;
+	}
+
+	mutex_lock(&sr1p5_persist_lock);
+	memcpy_fromio(&sr1p5_persist, sr1p5_persist_base,
+		      sizeof(sr1p5_persist));
+	if (sr1p5_persist_check())
+		sr1p5_persist_age0 = (long)sr1p5_persist.age -
+				     sr1p5_persist_now();
+	else
+		sr1p5_persist_clear();
+	sr1p5_persist_sync();
+	mutex_unlock(&sr1p5_persist_lock);
+}
+
+/* Locking: sr1p5_persist_lock */
+static struct sr1p5_persist_vdd *sr1p5_persist_vdd(
+		struct voltagedomain *voltdm, bool create)
+{
+	struct sr1p5_persist_vdd *pvdd;
+	int i;
+
+	for (i = 0; i < MAX_VDDS; i++) {
+		pvdd = &sr1p5_persist.vdd[i];
+		if (!strncmp(pvdd->name, voltdm->name, sizeof(pvdd->name)))
+			return pvdd;
+	}
+	if (!create)
+		return NULL;
+	for (i = 0; i < MAX_VDDS; i++) {
+		pvdd = &sr1p5_persist.vdd[i];
+		if (!pvdd->name[0]) {
+			strlcpy(pvdd->name, voltdm->name, sizeof(pvdd->name));
+			return pvdd;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * sr1p5_persist_apply() - reuse the stored calibrations of a domain
+ * @voltdm:	voltage domain being initialized
+ *
+ * OPPs marked calibrated here are never calibrated by this boot, until
+ * the next recalibration resets them.
+ */
+static void sr1p5_persist_apply(struct voltagedomain *voltdm)
+{
+	struct sr1p5_persist_vdd *pvdd;
+	struct omap_volt_data *vdata;
+	int i, temp, applied = 0;
+
+	if (!sr1p5_persist_base)
+		return;
+
+	mutex_lock(&sr1p5_persist_lock);
+	pvdd = sr1p5_persist_vdd(voltdm, false);
+	if (!pvdd)
+		goto out;
+
+	temp = sr1p5_persist_temp();
+	for (i = 0; i < SR1P5_PERSIST_MAX_OPPS; i++) {
+		struct sr1p5_persist_opp *popp = &pvdd->opp[i];
+
+		if (!popp->volt_calibrated)
+			continue;
+		vdata = omap_voltage_get_voltdata(voltdm, popp->volt_nominal);
+		if (IS_ERR_OR_NULL(vdata) ||
+		    popp->volt_calibrated > vdata->volt_nominal ||
+		    (temp != SR1P5_TEMP_UNKNOWN &&
+		     popp->temp != SR1P5_TEMP_UNKNOWN &&
+		     abs(temp - popp->temp) > sr1p5_persist_temp_delta)) {
+			memset(popp, 0, sizeof(*popp));
+			continue;
+		}
+		vdata->volt_calibrated = popp->volt_calibrated;
+		vdata->volt_dynamic_nominal = omap_get_dyn_nominal(vdata);
+		applied++;
+	}
+	sr1p5_persist_sync();
+
+	if (applied)
+		pr_info("%s: %s: reusing %d stored calibrations\n", __func__,
+			voltdm->name, applied);
+out:
+	mutex_unlock(&sr1p5_persist_lock);
+}
+
+/* store a calibration that just completed */
+static void sr1p5_persist_store(struct voltagedomain *voltdm,
+				struct omap_volt_data *vdata)
+{
+	struct sr1p5_persist_vdd *pvdd;
+	struct sr1p5_persist_opp *popp = NULL;
+	int i;
+
+	if (!sr1p5_persist_base)
+		return;
+
+	mutex_lock(&sr1p5_persist_lock);
+	pvdd = sr1p5_persist_vdd(voltdm, true);
+	if (!pvdd)
+		goto out;
+
+	for (i = 0; i < SR1P5_PERSIST_MAX_OPPS; i++) {
+		if (pvdd->opp[i].volt_nominal == vdata->volt_nominal) {
+			popp = &pvdd->opp[i];
+			break;
+		}
+		if (!popp && !pvdd->opp[i].volt_nominal)
+			popp = &pvdd->opp[i];
+	}
+	if (!popp)
+		goto out;
+
+	popp->volt_nominal = vdata->volt_nominal;
+	popp->volt_calibrated = vdata->volt_calibrated;
+	popp->temp = sr1p5_persist_temp();
+	sr1p5_persist_sync();
+out:
+	mutex_unlock(&sr1p5_persist_lock);
+}
+
+static void sr1p5_persist_reset(void)
+{
+	mutex_lock(&sr1p5_persist_lock);
+	sr1p5_persist_clear();
+	sr1p5_persist_sync();
+	mutex_unlock(&sr1p5_persist_lock);
+}
+
+/* seconds the stored calibrations have been in use */
+static unsigned long sr1p5_persist_age(void)
+{
+	return sr1p5_persist_base ?
+		max(sr1p5_persist_age0 + sr1p5_persist_now(), 0L) : 0;
+}
+
+static int sr1p5_persist_reboot_notify(struct notifier_block *nb,
+				       unsigned long event, void *unused)
+{
+#ifdef CONFIG_KEXEC
+	struct tag tag;
+#endif
+
+	mutex_lock(&sr1p5_persist_lock);
+	sr1p5_persist_sync();
+	mutex_unlock(&sr1p5_persist_lock);
+
+#ifdef CONFIG_KEXEC
+	if (event != SYS_RESTART)
+		return NOTIFY_DONE;
+
+	/* for kexec: the next kernel reserves the area where we had it */
+	memset(&tag, 0, sizeof(tag));
+	tag.hdr.tag = ATAG_KEXEC_LOG;
+	tag.hdr.size = tag_size(tag_kexec_log);
+	tag.u.kexec_log.start = sr1p5_persist_phys;
+	tag.u.kexec_log.size = sr1p5_persist_size;
+	strlcpy(tag.u.kexec_log.name, SR1P5_PERSIST_NAME,
+		sizeof(tag.u.kexec_log.name));
+	kexec_add_handoff_tag(&tag);
+#endif
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block sr1p5_persist_reboot_nb = {
+	.notifier_call = sr1p5_persist_reboot_notify,
+};
+
+/**
+ * omap_sr_class1p5_persist_init() - reserve RAM to keep calibrations in
+ * @phy_addr:	physical address of the area
+ * @size:	its size, at least a few hundred bytes
+ *
+ * Board files call this from their reserve callback with an area that
+ * the bootloader leaves alone and that is kept in self refresh over
+ * warm reset, usually next to the ram console.
+ */
+int __init omap_sr_class1p5_persist_init(phys_addr_t phy_addr, size_t size)
+{
+	struct tag_kexec_log *log;
+	int ret;
+
+	/* After kexec, keep using the area the previous kernel wrote */
+	log = kexec_handoff_find_log(SR1P5_PERSIST_NAME);
+	if (log) {
+		phy_addr = log->start;
+		size = log->size;
+	}
+
+	if (size < sizeof(struct sr1p5_persist))
+		return -EINVAL;
+
+	ret = memblock_remove(phy_addr, size);
+	if (ret) {
+		pr_err("%s: unable to remove memory: start=0x%08x, size=0x%08x,"
+		       " ret=%d\n", __func__, (u32)phy_addr, (u32)size, ret);
+		return ret;
+	}
+
+	sr1p5_persist_phys = phy_addr;
+	sr1p5_persist_size = size;
+	return 0;
+}
+#else
+static inline void sr1p5_persist_load(void) { }
+static inline void sr1p5_persist_apply(struct voltagedomain *voltdm) { }
+static inline void sr1p5_persist_store(struct voltagedomain *voltdm,
+				       struct omap_volt_data *vdata) { }
+static inline void sr1p5_persist_reset(void) { }
+static inline unsigned long sr1p5_persist_age(void)
+{
+	return 0;
+}
+#endif
+
 /**
  * sr_class1p5_notify() - isr notifier for status events
  * @voltdm:	voltage domain for which we were triggered
@@ -304,6 +654,7 @@ done_calib:
 	volt_data->volt_calibrated = u_volt_safe;
 	/* Setup my dynamic voltage for the next calibration for this opp */
 	volt_data->volt_dynamic_nominal = omap_get_dyn_nominal(volt_data);
+	sr1p5_persist_store(voltdm, volt_data);
 
 	/*
 	 * if the voltage we decided as safe is not the current voltage,
@@ -383,6 +734,7 @@ static void sr_class1p5_recal_work(struct work_struct *work)
 	mutex_lock(&omap_dvfs_lock);
 	if (voltdm_for_each(sr_class1p5_voltdm_recal, NULL))
 		pr_err("%s: Recalibration failed\n", __func__);
+	sr1p5_persist_reset();
 	mutex_unlock(&omap_dvfs_lock);
 	/* We come back again after time the usual delay */
 	schedule_delayed_work(&recal_work,
@@ -577,6 +929,8 @@ static int sr_class1p5_init(struct voltagedomain *voltdm,
 	INIT_DELAYED_WORK_DEFERRABLE(&work_data->work, sr_class1p5_calib_work);
 	*voltdm_cdata = (void *)work_data;
 
+	sr1p5_persist_apply(voltdm);
+
 	return 0;
 }
 
@@ -662,17 +1016,23 @@ static int __init sr_class1p5_driver_init(void)
 	if (!(cpu_is_omap3630() || cpu_is_omap44xx()))
 		return -EINVAL;
 
+	sr1p5_persist_load();
 	r = sr_register_class(&class1p5_data);
 	if (r) {
 		pr_err("SmartReflex class 1.5 driver: "
 		       "failed to register with %d\n", r);
 	} else {
 #if CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY
+		unsigned long delay = CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY;
+
+		/* stored calibrations are only good for what is left */
+		delay -= min(delay, sr1p5_persist_age() * MSEC_PER_SEC);
 		INIT_DELAYED_WORK_DEFERRABLE(&recal_work,
 					     sr_class1p5_recal_work);
-		schedule_delayed_work(&recal_work,
-			      msecs_to_jiffies
-			      (CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY));
+		schedule_delayed_work(&recal_work, msecs_to_jiffies(delay));
+#endif
+#ifdef CONFIG_OMAP_SR_CLASS1P5_PERSIST
+		register_reboot_notifier(&sr1p5_persist_reboot_nb);
 #endif
 		pr_info("SmartReflex class 1.5 driver: initialized (%dms)\n",
 			CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY);
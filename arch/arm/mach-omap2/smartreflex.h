@@ -287,4 +287,15 @@ static inline bool is_sr_enabled(struct voltagedomain *voltdm)
 }
 #endif
 
+#ifdef CONFIG_OMAP_SR_CLASS1P5_PERSIST
+/* Reserve RAM that keeps class 1.5 calibrations over reboot and kexec */
+int omap_sr_class1p5_persist_init(phys_addr_t phy_addr, size_t size);
+#else
+static inline int omap_sr_class1p5_persist_init(phys_addr_t phy_addr,
+						size_t size)
+{
+	return 0;
+}
+#endif
+
 #endif
@@ -257,6 +257,9 @@ static void __init omap2_gp_timer_init(void)
 
 	omap2_gp_clockevent_init();
 	omap2_gp_clocksource_init();
+
+	if (cpu_is_omap44xx())
+		omap4_sched_clock_init();
 }
 
 struct sys_timer omap_timer = {
@@ -255,13 +255,19 @@ struct omap_vdd_dep_volt {
  * struct omap_vdd_dep_info -  Dependent vdd info
  * @name		: Dependent vdd name
  * @_dep_voltdm		: internal structure meant to prevent multiple lookups
+ * @_dep_dvfs_info	: internal, dvfs info of the dependent vdd
+ * @_dep_freq		: internal, rate of the dependent vdd's device for
+ *			  each dep_table entry, resolved on first use
  * @dep_table		: Table containing the dependent vdd voltage
  *			  corresponding to every main vdd voltage.
  * @nr_dep_entries	: number of dependency voltage entries
  */
+struct omap_vdd_dvfs_info;
 struct omap_vdd_dep_info {
 	char *name;
 	struct voltagedomain *_dep_voltdm;
+	struct omap_vdd_dvfs_info *_dep_dvfs_info;
+	unsigned long *_dep_freq;
 	struct omap_vdd_dep_volt *dep_table;
 	int nr_dep_entries;
 };
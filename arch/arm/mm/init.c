@@ -20,6 +20,7 @@
 #include <linux/gfp.h>
 #include <linux/memblock.h>
 #include <linux/sort.h>
+#include <linux/kexec.h>
 
 #include <asm/mach-types.h>
 #include <asm/prom.h>
@@ -36,6 +37,9 @@
 
 static unsigned long phys_initrd_start __initdata = 0;
 static unsigned long phys_initrd_size __initdata = 0;
+#ifdef CONFIG_BLK_DEV_INITRD
+static int keep_initrd;
+#endif
 
 static int __init early_initrd(char *p)
 {
@@ -313,6 +317,70 @@ static int __init meminfo_cmp(const void *_a, const void *_b)
 	return cmp < 0 ? -1 : cmp > 0 ? 1 : 0;
 }
 
+#ifdef CONFIG_KEXEC_PRESTAGE
+/*
+ * Keep the kexec prestage area out of the page allocator.  When we were
+ * ourselves booted from it, our initrd sits inside the area and must
+ * not be handed back to the allocator once it has been unpacked.
+ */
+static void __init arm_kexec_prestage_reserve(void)
+{
+	phys_addr_t start = kexec_prestage_res.start;
+	phys_addr_t size = resource_size(&kexec_prestage_res);
+
+	if (kexec_prestage_res.end == kexec_prestage_res.start)
+		return;
+
+	if (!memblock_is_region_memory(start, size)) {
+		pr_err("kexec_prestage: 0x%08lx+0x%08lx is not a memory region - disabling\n",
+		       (unsigned long)start, (unsigned long)size);
+		kexec_prestage_res.start = kexec_prestage_res.end = 0;
+		return;
+	}
+
+	/* kernel text/data must not live in the area */
+	if (__pa(_end) > start && __pa(_stext) < start + size) {
+		pr_err("kexec_prestage: 0x%08lx+0x%08lx overlaps the kernel - disabling\n",
+		       (unsigned long)start, (unsigned long)size);
+		kexec_prestage_res.start = kexec_prestage_res.end = 0;
+		return;
+	}
+
+#ifdef CONFIG_BLK_DEV_INITRD
+	if (phys_initrd_size && phys_initrd_start < start + size &&
+	    phys_initrd_start + phys_initrd_size > start)
+		keep_initrd = 1;
+#endif
+	memblock_reserve(start, size);
+}
+#endif
+
+/*
+ * Keep the log buffers handed over by the kernel that kexec'd us.  The
+ * ram_console region is left to the board code, which already carves
+ * it out of memory.
+ */
+static void __init arm_kexec_logs_reserve(void)
+{
+	struct tag_kexec_log *log;
+	unsigned int i;
+
+	for (i = 0; i < kexec_handoff_nr_logs; i++) {
+		log = &kexec_handoff_logs[i];
+		if (!log->size || !strcmp(log->name, "ram_console"))
+			continue;
+
+		if (!memblock_is_region_memory(log->start, log->size) ||
+		    memblock_is_region_reserved(log->start, log->size)) {
+			pr_err("kexec: %s 0x%08x+0x%08x is in use - dropped\n",
+			       log->name, log->start, log->size);
+			log->size = 0;
+			continue;
+		}
+		memblock_reserve(log->start, log->size);
+	}
+}
+
 void __init arm_memblock_init(struct meminfo *mi, struct machine_desc *mdesc)
 {
 	int i;
@@ -350,6 +418,10 @@ void __init arm_memblock_init(struct meminfo *mi, struct machine_desc *mdesc)
 		initrd_end = initrd_start + phys_initrd_size;
 	}
 #endif
+#ifdef CONFIG_KEXEC_PRESTAGE
+	arm_kexec_prestage_reserve();
+#endif
+	arm_kexec_logs_reserve();
 
 	arm_mm_memblock_reserve();
 	arm_dt_memblock_reserve();
@@ -503,6 +575,17 @@ static void __init free_unused_memmap(struct meminfo *mi)
 #endif
 }
 
+#ifdef CONFIG_HIGHMEM
+/* leaves the pages to the deferred memmap threads if they take them */
+static unsigned long __init free_highmem(unsigned long start,
+					 unsigned long end)
+{
+	if (deferred_free_range(start, end))
+		return 0;
+	return free_area(start, end, NULL);
+}
+#endif
+
 static void __init free_highpages(void)
 {
 #ifdef CONFIG_HIGHMEM
@@ -538,8 +621,8 @@ static void __init free_highpages(void)
 			if (res_end > end)
 				res_end = end;
 			if (res_start != start)
-				totalhigh_pages += free_area(start, res_start,
-							     NULL);
+				totalhigh_pages += free_highmem(start,
+								res_start);
 			start = res_end;
 			if (start == end)
 				break;
@@ -547,7 +630,7 @@ static void __init free_highpages(void)
 
 		/* And now free anything which remains */
 		if (start < end)
-			totalhigh_pages += free_area(start, end, NULL);
+			totalhigh_pages += free_highmem(start, end);
 	}
 	totalram_pages += totalhigh_pages;
 #endif
@@ -724,8 +807,6 @@ void free_initmem(void)
 
 #ifdef CONFIG_BLK_DEV_INITRD
 
-static int keep_initrd;
-
 void free_initrd_mem(unsigned long start, unsigned long end)
 {
 	if (!keep_initrd)
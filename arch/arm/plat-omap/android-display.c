@@ -144,9 +144,12 @@ done:
 		*dsscomp = data;
 	dsscomp_set_platform_data(&data);
 
-	/* remember setting for ion carveouts */
+	/*
+	 * remember setting for ion carveouts, with one more slot's worth
+	 * for the buffers dsscomp keeps mapped between frames
+	 */
 	mem->tiler1d_mem =
-		NUM_ANDROID_TILER1D_SLOTS * data.tiler1d_slotsz;
+		(NUM_ANDROID_TILER1D_SLOTS + 1) * data.tiler1d_slotsz;
 	pr_info("android_display: tiler1d %u\n", mem->tiler1d_mem);
 }
 
@@ -90,6 +90,25 @@ static cycle_t notrace omap44xx_32k_read(struct clocksource *cs)
 #define omap44xx_32k_read	NULL
 #endif
 
+/**
+ * omap_32k_read_raw - read the 32k sync counter without the boot offset
+ *
+ * Usable as soon as the L4 is mapped. The counter is not reset by a
+ * warm reset or kexec, so values can be compared across kernels.
+ */
+u32 notrace omap_32k_read_raw(void)
+{
+#ifdef CONFIG_ARCH_OMAP3
+	if (cpu_is_omap34xx())
+		return omap_readl(OMAP3430_32KSYNCT_BASE + 0x10);
+#endif
+#ifdef CONFIG_ARCH_OMAP4
+	if (cpu_is_omap44xx())
+		return omap_readl(OMAP4430_32KSYNCT_BASE + 0x10);
+#endif
+	return 0;
+}
+
 /*
  * Kernel assumes that sched_clock can be called early but may not have
  * things ready yet.
@@ -126,7 +145,7 @@ static inline unsigned long long notrace _omap_32k_sched_clock(void)
 	return cyc_to_fixed_sched_clock(&cd, cyc, (u32)~0, SC_MULT, SC_SHIFT);
 }
 
-#ifndef CONFIG_OMAP_MPU_TIMER
+#if !defined(CONFIG_OMAP_MPU_TIMER) && !defined(CONFIG_OMAP4_HIRES_SCHED_CLOCK)
 unsigned long long notrace sched_clock(void)
 {
 	return _omap_32k_sched_clock();
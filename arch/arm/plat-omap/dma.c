@@ -35,6 +35,7 @@
 #include <linux/io.h>
 #include <linux/slab.h>
 #include <linux/delay.h>
+#include <linux/scatterlist.h>
 
 #include <asm/system.h>
 #include <mach/hardware.h>
@@ -1782,6 +1783,206 @@ int omap_get_dma_chain_src_pos(int chain_id)
 	return p->dma_read(CSAC, lch);
 }
 EXPORT_SYMBOL(omap_get_dma_chain_src_pos);
+
+/*
+ * Scatter-gather transfers over hardware linked channels.  Each segment
+ * gets a channel of its own, linked to the next through CLNK_CTRL, so the
+ * hardware moves from one segment to the next without the CPU.  Only the
+ * last channel of a batch raises the block interrupt; lists longer than
+ * the number of channels are refilled from there.
+ */
+struct omap_dma_sg {
+	spinlock_t lock;
+	struct omap_dma_sg_config cfg;
+	struct scatterlist *cur;	/* next segment to program */
+	int left;			/* segments not programmed yet */
+	void (*callback)(int lch, u16 ch_status, void *data);
+	void *data;
+	int nr_lch;
+	int lch[0];
+};
+
+static void omap_dma_sg_program(struct omap_dma_sg *dsg)
+{
+	const struct omap_dma_sg_config *cfg = &dsg->cfg;
+	int frame_bytes = cfg->elem_count << cfg->data_type;
+	int n = min(dsg->left, dsg->nr_lch);
+	int i, lch;
+	u32 l;
+
+	for (i = 0; i < n; i++) {
+		dma_addr_t addr = sg_dma_address(dsg->cur);
+
+		lch = dsg->lch[i];
+		if (cfg->to_device) {
+			omap_set_dma_src_params(lch, 0,
+				OMAP_DMA_AMODE_POST_INC, addr, 0, 0);
+			omap_set_dma_dest_params(lch, 0,
+				OMAP_DMA_AMODE_CONSTANT, cfg->dev_addr, 0, 0);
+		} else {
+			omap_set_dma_src_params(lch, 0,
+				OMAP_DMA_AMODE_CONSTANT, cfg->dev_addr, 0, 0);
+			omap_set_dma_dest_params(lch, 0,
+				OMAP_DMA_AMODE_POST_INC, addr, 0, 0);
+		}
+		omap_set_dma_transfer_params(lch, cfg->data_type,
+				cfg->elem_count,
+				sg_dma_len(dsg->cur) / frame_bytes,
+				cfg->sync_mode, cfg->dma_trigger,
+				cfg->to_device ? OMAP_DMA_DST_SYNC :
+						 OMAP_DMA_SRC_SYNC);
+		p->dma_write(0, CDAC, lch);
+
+		if (i < n - 1) {
+			dma_chan[lch].enabled_irqs &= ~OMAP_DMA_BLOCK_IRQ;
+			p->dma_write(dsg->lch[i + 1] | (1 << 15),
+				     CLNK_CTRL, lch);
+		} else {
+			dma_chan[lch].enabled_irqs |= OMAP_DMA_BLOCK_IRQ;
+			p->dma_write(0, CLNK_CTRL, lch);
+		}
+		omap_enable_channel_irq(lch);
+
+		/* linked channels are enabled by the hardware, not here */
+		if (IS_DMA_ERRATA(DMA_ERRATA_IFRAME_BUFFERING)) {
+			l = p->dma_read(CCR, lch);
+			l |= OMAP_DMA_CCR_BUFFERING_DISABLE;
+			p->dma_write(l, CCR, lch);
+		}
+		dma_chan[lch].flags |= OMAP_DMA_ACTIVE;
+
+		dsg->cur = sg_next(dsg->cur);
+	}
+	dsg->left -= n;
+
+	lch = dsg->lch[0];
+	l = p->dma_read(CCR, lch);
+	l |= OMAP_DMA_CCR_EN;
+	p->dma_write(l, CCR, lch);
+}
+
+static void omap_dma_sg_callback(int lch, u16 ch_status, void *data)
+{
+	struct omap_dma_sg *dsg = data;
+	int i;
+
+	spin_lock(&dsg->lock);
+	if (ch_status & OMAP_DMA_BLOCK_IRQ) {
+		for (i = 0; i < dsg->nr_lch; i++)
+			dma_chan[dsg->lch[i]].flags &= ~OMAP_DMA_ACTIVE;
+
+		if (dsg->left > 0) {
+			omap_dma_sg_program(dsg);
+			spin_unlock(&dsg->lock);
+			return;
+		}
+	}
+	spin_unlock(&dsg->lock);
+
+	/* the client may free dsg from here */
+	if (dsg->callback)
+		dsg->callback(dsg->lch[0], ch_status, dsg->data);
+}
+
+/**
+ * omap_request_dma_sg - request channels for scatter-gather transfers
+ * @dev_id: sync device
+ * @dev_name: name shown for the channels
+ * @nr_lch: segments in flight at a time; fewer channels may be granted
+ * @callback: called once per list, or on errors
+ * @data: passed to @callback
+ * @sg_out: the handle for omap_start_dma_sg()
+ *
+ * Returns 0 if at least one channel was free, -EBUSY if none was.
+ */
+int omap_request_dma_sg(int dev_id, const char *dev_name, int nr_lch,
+			void (*callback)(int lch, u16 ch_status, void *data),
+			void *data, struct omap_dma_sg **sg_out)
+{
+	struct omap_dma_sg *dsg;
+	int i;
+
+	if (nr_lch < 1)
+		return -EINVAL;
+
+	dsg = kzalloc(sizeof(*dsg) + nr_lch * sizeof(dsg->lch[0]),
+		      GFP_KERNEL);
+	if (!dsg)
+		return -ENOMEM;
+
+	spin_lock_init(&dsg->lock);
+	dsg->callback = callback;
+	dsg->data = data;
+
+	for (i = 0; i < nr_lch; i++)
+		if (omap_request_dma(dev_id, dev_name, omap_dma_sg_callback,
+				     dsg, &dsg->lch[i]))
+			break;
+	if (!i) {
+		kfree(dsg);
+		return -EBUSY;
+	}
+	dsg->nr_lch = i;
+
+	*sg_out = dsg;
+	return 0;
+}
+EXPORT_SYMBOL(omap_request_dma_sg);
+
+void omap_free_dma_sg(struct omap_dma_sg *dsg)
+{
+	int i;
+
+	/* break the links before a channel is stopped under its successor */
+	for (i = 0; i < dsg->nr_lch; i++)
+		p->dma_write(0, CLNK_CTRL, dsg->lch[i]);
+	for (i = 0; i < dsg->nr_lch; i++)
+		omap_free_dma(dsg->lch[i]);
+	kfree(dsg);
+}
+EXPORT_SYMBOL(omap_free_dma_sg);
+
+/**
+ * omap_start_dma_sg - start a scatter-gather transfer
+ * @dsg: handle from omap_request_dma_sg()
+ * @cfg: device side of the transfer, the same for every segment
+ * @sg: dma mapped list; each length a multiple of the frame size
+ * @sg_len: mapped entries in @sg
+ */
+int omap_start_dma_sg(struct omap_dma_sg *dsg,
+		      const struct omap_dma_sg_config *cfg,
+		      struct scatterlist *sg, int sg_len)
+{
+	unsigned long flags;
+
+	if (unlikely(sg_len < 1 || cfg->elem_count < 1))
+		return -EINVAL;
+
+	spin_lock_irqsave(&dsg->lock, flags);
+	dsg->cfg = *cfg;
+	dsg->cur = sg;
+	dsg->left = sg_len;
+	omap_dma_sg_program(dsg);
+	spin_unlock_irqrestore(&dsg->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(omap_start_dma_sg);
+
+void omap_stop_dma_sg(struct omap_dma_sg *dsg)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&dsg->lock, flags);
+	dsg->left = 0;
+	for (i = 0; i < dsg->nr_lch; i++)
+		p->dma_write(0, CLNK_CTRL, dsg->lch[i]);
+	for (i = 0; i < dsg->nr_lch; i++)
+		omap_stop_dma(dsg->lch[i]);
+	spin_unlock_irqrestore(&dsg->lock, flags);
+}
+EXPORT_SYMBOL(omap_stop_dma_sg);
 #endif	/* ifndef CONFIG_ARCH_OMAP1 */
 
 /*----------------------------------------------------------------------------*/
@@ -38,6 +38,17 @@ extern struct sys_timer omap_timer;
 extern bool omap_32k_timer_init(void);
 extern int __init omap_init_clocksource_32k(void);
 extern unsigned long long notrace omap_32k_sched_clock(void);
+extern u32 notrace omap_32k_read_raw(void);
+
+#ifdef CONFIG_OMAP4_HIRES_SCHED_CLOCK
+extern void omap4_sched_clock_init(void);
+extern void omap4_sched_clock_save(void);
+extern void omap4_sched_clock_restore(void);
+#else
+static inline void omap4_sched_clock_init(void) { }
+static inline void omap4_sched_clock_save(void) { }
+static inline void omap4_sched_clock_restore(void) { }
+#endif
 
 extern void omap_reserve(void);
 
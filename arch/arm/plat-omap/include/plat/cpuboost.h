@@ -0,0 +1,46 @@
+/*
+ * arch/arm/plat-omap/include/plat/cpuboost.h
+ *
+ * Copyright (C) 2011 Motorola Mobility Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __PLAT_OMAP_CPUBOOST_H
+#define __PLAT_OMAP_CPUBOOST_H
+
+#include <linux/errno.h>
+
+/**
+ * struct omap_boost_req - minimum speeds held for the length of a boost
+ * @mpu_khz:	minimum MPU speed
+ * @l3_khz:	minimum L3 interconnect speed, 0 for no constraint
+ * @iva_khz:	minimum IVA-HD speed, 0 for no constraint
+ */
+struct omap_boost_req {
+	unsigned int mpu_khz;
+	unsigned int l3_khz;
+	unsigned int iva_khz;
+};
+
+#ifdef CONFIG_OMAP_PM
+/*
+ * Hold the speeds in req for ms milliseconds.  Each owner has at most
+ * one request: a new one replaces it and ms == 0 drops it.  Requests of
+ * different owners overlap, each speed being the max of the live ones.
+ */
+extern int omap_cpuboost_request(const void *owner,
+				 const struct omap_boost_req *req,
+				 unsigned int ms);
+#else
+static inline int omap_cpuboost_request(const void *owner,
+					const struct omap_boost_req *req,
+					unsigned int ms)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif
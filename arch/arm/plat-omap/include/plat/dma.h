@@ -519,6 +519,33 @@ extern int omap_get_dma_chain_src_pos(int chain_id);
 extern int omap_modify_dma_chain_params(int chain_id,
 					struct omap_dma_channel_params params);
 extern int omap_dma_chain_status(int chain_id);
+
+/*
+ * Scatter-gather API: up to nr_lch segments of an sg list are programmed
+ * into hardware linked channels at a time and run back to back.  The
+ * callback sees OMAP_DMA_BLOCK_IRQ once, when the whole list is done.
+ */
+struct scatterlist;
+struct omap_dma_sg;
+
+struct omap_dma_sg_config {
+	dma_addr_t dev_addr;	/* device FIFO, not incremented */
+	int data_type;		/* OMAP_DMA_DATA_TYPE_S8/S16/S32 */
+	int elem_count;		/* elements per frame */
+	int sync_mode;		/* OMAP_DMA_SYNC_* */
+	int dma_trigger;
+	bool to_device;
+};
+
+extern int omap_request_dma_sg(int dev_id, const char *dev_name, int nr_lch,
+			       void (*callback)(int lch, u16 ch_status,
+						void *data),
+			       void *data, struct omap_dma_sg **sg_out);
+extern void omap_free_dma_sg(struct omap_dma_sg *dsg);
+extern int omap_start_dma_sg(struct omap_dma_sg *dsg,
+			     const struct omap_dma_sg_config *cfg,
+			     struct scatterlist *sg, int sg_len);
+extern void omap_stop_dma_sg(struct omap_dma_sg *dsg);
 #endif
 
 #if defined(CONFIG_ARCH_OMAP1) && defined(CONFIG_FB_OMAP)
@@ -21,6 +21,7 @@ int dsscomp_setup(dsscomp_t comp, enum dsscomp_setup_mode mode,
 			struct dss2_rect_t win);
 int dsscomp_delayed_apply(dsscomp_t comp);
 void dsscomp_drop(dsscomp_t c);
+int dsscomp_park(void);
 
 struct tiler_pa_info;
 int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
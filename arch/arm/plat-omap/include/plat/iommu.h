@@ -27,6 +27,15 @@ struct iotlb_entry {
 	};
 };
 
+/* a device address range kept locked in the TLB */
+struct iommu_lock_range {
+	u32 da;
+	u32 size;
+};
+
+/* number of OMAP_IOMMU_ERR_* bits */
+#define IOMMU_NR_ERRS	5
+
 struct iommu {
 	const char	*name;
 	struct module	*owner;
@@ -58,6 +67,14 @@ struct iommu {
 	struct pm_qos_request_list *qos_request;
 	void *secure_ttb;
 	bool secure_mode;
+
+	/* mappings stored in these ranges are locked in the TLB */
+	struct iommu_lock_range *lock_ranges;
+	int		nr_lock_ranges;
+	struct iotlb_entry *locked;
+	int		nr_locked;
+
+	unsigned long	faults[IOMMU_NR_ERRS];	/* per OMAP_IOMMU_ERR_* bit */
 };
 
 struct cr_regs {
@@ -176,12 +193,15 @@ extern size_t iopgtable_clear_entry(struct iommu *obj, u32 iova);
 extern int iommu_set_da_range(struct iommu *obj, u32 start, u32 end);
 extern struct iommu *iommu_get(const char *name);
 extern void iommu_put(struct iommu *obj);
+extern void iommu_quiesce_all(void);
 extern int iommu_set_isr(const char *name,
 			 int (*isr)(struct iommu *obj, u32 da, u32 iommu_errs,
 				    void *priv),
 			 void *isr_priv);
 
 extern int iommu_set_secure(const char *name, bool enable, void *data);
+extern int iommu_set_lock_ranges(const char *name,
+				 const struct iommu_lock_range *ranges, int n);
 
 extern void iommu_save_ctx(struct iommu *obj);
 extern void iommu_restore_ctx(struct iommu *obj);
@@ -14,10 +14,13 @@
 #ifndef _PLAT_OMAP_RPRES_H
 #define _PLAT_OMAP_RPRES_H
 
+#include <linux/workqueue.h>
+
 enum rpres_constraint {
 	RPRES_CONSTRAINT_SCALE,
 	RPRES_CONSTRAINT_LATENCY,
 	RPRES_CONSTRAINT_BANDWIDTH,
+	RPRES_CONSTRAINT_MAX,
 };
 
 enum {
@@ -43,12 +46,41 @@ struct rpres_platform_data {
 	struct device *(*get_dev)(void);
 };
 
+/**
+ * struct rpres_constraint_stat - state and accounting of one constraint
+ * @applied:	value last set through the platform ops
+ * @pending:	relaxation waiting for the end of the window
+ * @has_applied: @applied is valid
+ * @has_pending: @pending is valid
+ * @count:	calls into the platform ops
+ * @skipped:	requests for the value already applied
+ * @deferred:	relaxations delayed to the end of the window
+ * @coalesced:	deferred relaxations replaced before being applied
+ * @total_us:	time spent in the platform ops
+ * @max_us:	longest call into the platform ops
+ */
+struct rpres_constraint_stat {
+	long applied;
+	long pending;
+	bool has_applied;
+	bool has_pending;
+	unsigned long count;
+	unsigned long skipped;
+	unsigned long deferred;
+	unsigned long coalesced;
+	u64 total_us;
+	u32 max_us;
+};
+
 struct rpres {
 	struct list_head next;
 	const char *name;
 	struct platform_device *pdev;
 	int state;
 	struct mutex lock;
+	struct rpres_constraint_stat c[RPRES_CONSTRAINT_MAX];
+	struct delayed_work relax_work;
+	struct dentry *dbg;
 };
 
 struct rpres *rpres_get(const char *);
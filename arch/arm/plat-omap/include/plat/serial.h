@@ -29,6 +29,14 @@
  */
 #define OMAP_UART_INFO		(PLAT_PHYS_OFFSET + 0x3ffc)
 
+/*
+ * Two words below OMAP_UART_INFO where the uncompress code leaves the
+ * 32k sync counter value it started at, for the kexec boot timeline.
+ * The same limitations apply; the kernel picks it up in init_early.
+ */
+#define OMAP_DECOMP_STAMP	(PLAT_PHYS_OFFSET + 0x3ff4)
+#define OMAP_DECOMP_STAMP_MAGIC	0x32c0de5a
+
 /* OMAP1 serial ports */
 #define OMAP1_UART1_BASE	0xfffb0000
 #define OMAP1_UART2_BASE	0xfffb0800
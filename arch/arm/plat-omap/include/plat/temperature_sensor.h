@@ -23,6 +23,8 @@
 #ifndef __ARCH_ARM_PLAT_OMAP_INCLUDE_PLAT_TEMPERATURE_SENSOR_H
 #define __ARCH_ARM_PLAT_OMAP_INCLUDE_PLAT_TEMPERATURE_SENSOR_H
 
+#include <linux/errno.h>
+
 /*
  * Offsets from the base of temperature sensor registers
  */
@@ -63,4 +65,13 @@ void omap_temp_sensor_idle(int idle_state);
 static inline void omap_temp_sensor_idle(int idle_state) { }
 #endif
 
+#ifdef CONFIG_OMAP_DIE_TEMP_SENSOR
+int omap_temp_sensor_get_temp(int *temp);
+#else
+static inline int omap_temp_sensor_get_temp(int *temp)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif
@@ -24,6 +24,7 @@
 #include <asm/mach-types.h>
 
 #include <plat/serial.h>
+#include <plat/omap44xx.h>
 
 #define MDR1_MODE_MASK			0x07
 
@@ -177,6 +178,15 @@ static inline void __arch_decomp_setup(unsigned long arch_id)
 		DEBUG_LL_TI816X(3, ti8168evm);
 
 	} while (0);
+
+#ifdef CONFIG_KEXEC_TIMELINE
+	if (machine_is_mapphone()) {
+		volatile u32 *stamp = (volatile u32 *)OMAP_DECOMP_STAMP;
+
+		stamp[1] = *(volatile u32 *)(OMAP4430_32KSYNCT_BASE + 0x10);
+		stamp[0] = OMAP_DECOMP_STAMP_MAGIC;
+	}
+#endif
 }
 
 #define arch_decomp_setup()	__arch_decomp_setup(arch_id)
@@ -90,6 +90,24 @@ static ssize_t debug_read_tlb(struct file *file, char __user *userbuf,
 	return bytes;
 }
 
+static ssize_t debug_read_faults(struct file *file, char __user *userbuf,
+				 size_t count, loff_t *ppos)
+{
+	static const char * const names[IOMMU_NR_ERRS] = {
+		"tlb miss", "translation fault", "emu miss",
+		"table walk fault", "multi hit fault",
+	};
+	struct iommu *obj = file->private_data;
+	char buf[MAXCOLUMN * (IOMMU_NR_ERRS + 1)], *p = buf;
+	int i;
+
+	for (i = 0; i < IOMMU_NR_ERRS; i++)
+		p += sprintf(p, "%-18s %lu\n", names[i], obj->faults[i]);
+	p += sprintf(p, "%-18s %d\n", "locked entries", obj->nr_locked);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, p - buf);
+}
+
 static ssize_t debug_write_pagetable(struct file *file,
 		     const char __user *userbuf, size_t count, loff_t *ppos)
 {
@@ -341,6 +359,7 @@ static int debug_open_generic(struct inode *inode, struct file *file)
 DEBUG_FOPS_RO(ver);
 DEBUG_FOPS_RO(regs);
 DEBUG_FOPS_RO(tlb);
+DEBUG_FOPS_RO(faults);
 DEBUG_FOPS(pagetable);
 DEBUG_FOPS_RO(mmap);
 DEBUG_FOPS(mem);
@@ -379,6 +398,7 @@ static int iommu_debug_register(struct device *dev, void *data)
 	DEBUG_ADD_FILE_RO(ver);
 	DEBUG_ADD_FILE_RO(regs);
 	DEBUG_ADD_FILE_RO(tlb);
+	DEBUG_ADD_FILE_RO(faults);
 	DEBUG_ADD_FILE(pagetable);
 	DEBUG_ADD_FILE_RO(mmap);
 	DEBUG_ADD_FILE(mem);
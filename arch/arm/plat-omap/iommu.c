@@ -371,6 +371,91 @@ void flush_iotlb_all(struct iommu *obj)
 }
 EXPORT_SYMBOL_GPL(flush_iotlb_all);
 
+/*
+ *	TLB lock-down of the configured ranges
+ *
+ * Entries stored into a lock range are recorded and loaded into the
+ * preserved TLB slots, and reloaded whenever the iommu is enabled again.
+ * At most half of the TLB is used, the rest stays for the table walker.
+ * All of it is under iommu_lock.
+ */
+static bool iommu_da_in_lock_range(struct iommu *obj, u32 da)
+{
+	int i;
+
+	for (i = 0; i < obj->nr_lock_ranges; i++)
+		if (da - obj->lock_ranges[i].da < obj->lock_ranges[i].size)
+			return true;
+	return false;
+}
+
+static void iotlb_load_locked(struct iommu *obj)
+{
+	int i;
+
+	for (i = 0; i < obj->nr_locked; i++)
+		load_iotlb_entry(obj, &obj->locked[i]);
+}
+
+static void iotlb_lock_entry(struct iommu *obj, struct iotlb_entry *e)
+{
+	struct iotlb_entry *l;
+	int i;
+
+	if (!obj->nr_lock_ranges || !iommu_da_in_lock_range(obj, e->da))
+		return;
+
+	mutex_lock(&obj->iommu_lock);
+
+	for (i = 0; i < obj->nr_locked; i++)
+		if (obj->locked[i].da == e->da)
+			break;
+
+	if (i == obj->nr_tlb_entries / 2) {
+		dev_dbg(obj->dev, "%s: no lock slot for %08x\n",
+			__func__, e->da);
+		goto out;
+	}
+
+	l = &obj->locked[i];
+	*l = *e;
+	l->prsvd = MMU_CAM_P;
+	if (i == obj->nr_locked) {
+		obj->nr_locked++;
+		if (obj->refcount)
+			load_iotlb_entry(obj, l);
+	} else if (obj->refcount) {
+		/* replaced: the old slot cannot be given back one by one */
+		flush_iotlb_all(obj);
+		iotlb_load_locked(obj);
+	}
+out:
+	mutex_unlock(&obj->iommu_lock);
+}
+
+static void iotlb_unlock_entry(struct iommu *obj, u32 da)
+{
+	int i;
+
+	if (!obj->nr_locked)
+		return;
+
+	mutex_lock(&obj->iommu_lock);
+	for (i = 0; i < obj->nr_locked; i++) {
+		struct iotlb_entry *l = &obj->locked[i];
+
+		if (da - l->da < iopgsz_to_bytes(l->pgsz)) {
+			*l = obj->locked[--obj->nr_locked];
+			if (obj->refcount) {
+				flush_iotlb_all(obj);
+				iotlb_load_locked(obj);
+			}
+			break;
+		}
+	}
+	mutex_unlock(&obj->iommu_lock);
+}
+
 /**
  * iommu_set_twl - enable/disable table walking logic
  * @obj:	target iommu
@@ -638,6 +723,8 @@ int iopgtable_store_entry(struct iommu *obj, struct iotlb_entry *e)
 
 	flush_iotlb_page(obj, e->da);
 	err = iopgtable_store_entry_core(obj, e);
+	if (!err)
+		iotlb_lock_entry(obj, e);
 #ifdef PREFETCH_IOTLB
 	if (!err)
 		load_iotlb_entry(obj, e);
@@ -743,6 +830,8 @@ size_t iopgtable_clear_entry(struct iommu *obj, u32 da)
 
 	spin_unlock(&obj->page_table_lock);
 
+	iotlb_unlock_entry(obj, da);
+
 	return bytes;
 }
 EXPORT_SYMBOL_GPL(iopgtable_clear_entry);
@@ -783,6 +872,7 @@ static irqreturn_t iommu_fault_handler(int irq, void *data)
 	u32 da, errs;
 	u32 *iopgd, *iopte;
 	struct iommu *obj = data;
+	int i;
 
 	if (!obj->refcount)
 		return IRQ_NONE;
@@ -791,6 +881,10 @@ static irqreturn_t iommu_fault_handler(int irq, void *data)
 	if (errs == 0)
 		return IRQ_HANDLED;
 
+	for (i = 0; i < IOMMU_NR_ERRS; i++)
+		if (errs & (1 << i))
+			obj->faults[i]++;
+
 	/* Fault callback or TLB/PTE Dynamic loading */
 	if (obj->isr && !obj->isr(obj, da, errs, obj->isr_priv))
 		return IRQ_HANDLED;
@@ -894,6 +988,8 @@ struct iommu *iommu_get(const char *name)
 			goto err_enable;
 		}
 		flush_iotlb_all(obj);
+		if (!obj->secure_mode)
+			iotlb_load_locked(obj);
 	}
 
 	if (!try_module_get(obj->owner))
@@ -944,6 +1040,37 @@ void iommu_put(struct iommu *obj)
 }
 EXPORT_SYMBOL_GPL(iommu_put);
 
+static int __iommu_quiesce(struct device *dev, void *data)
+{
+	struct iommu *obj = to_iommu(dev);
+
+	if (!mutex_trylock(&obj->iommu_lock)) {
+		dev_warn(obj->dev, "%s: %s busy\n", __func__, obj->name);
+		return 0;
+	}
+
+	if (obj->refcount) {
+		flush_iotlb_all(obj);
+		iommu_disable(obj);
+	}
+
+	mutex_unlock(&obj->iommu_lock);
+	return 0;
+}
+
+/**
+ * iommu_quiesce_all - flush and disable every iommu in use
+ *
+ * For the reboot/kexec path, once the remote cores behind the iommus
+ * have been stopped.  Reference counts are left untouched.
+ **/
+void iommu_quiesce_all(void)
+{
+	driver_for_each_device(&omap_iommu_driver.driver, NULL, NULL,
+			       __iommu_quiesce);
+}
+EXPORT_SYMBOL_GPL(iommu_quiesce_all);
+
 int iommu_set_isr(const char *name,
 		  int (*isr)(struct iommu *obj, u32 da, u32 iommu_errs,
 			     void *priv),
@@ -995,6 +1122,59 @@ int iommu_set_secure(const char *name, bool enable, void *data)
 }
 EXPORT_SYMBOL_GPL(iommu_set_secure);
 
+/**
+ * iommu_set_lock_ranges - Keep mappings of hot ranges locked in the TLB
+ * @name:	target iommu name
+ * @ranges:	device address ranges, copied
+ * @n:		number of ranges, 0 to drop them
+ *
+ * Must be called before iommu_get. Entries stored into the ranges from
+ * then on occupy locked TLB slots while the iommu is enabled.
+ **/
+int iommu_set_lock_ranges(const char *name,
+			  const struct iommu_lock_range *ranges, int n)
+{
+	struct device *dev;
+	struct iommu *obj;
+	struct iommu_lock_range *r = NULL;
+	struct iotlb_entry *locked = NULL;
+
+	dev = driver_find_device(&omap_iommu_driver.driver, NULL, (void *)name,
+				device_match_by_alias);
+	if (!dev)
+		return -ENODEV;
+
+	obj = to_iommu(dev);
+	if (n) {
+		r = kmemdup(ranges, n * sizeof(*ranges), GFP_KERNEL);
+		locked = kcalloc(obj->nr_tlb_entries / 2, sizeof(*locked),
+				 GFP_KERNEL);
+		if (!r || !locked) {
+			kfree(r);
+			kfree(locked);
+			return -ENOMEM;
+		}
+	}
+
+	mutex_lock(&obj->iommu_lock);
+	if (obj->refcount) {
+		mutex_unlock(&obj->iommu_lock);
+		kfree(r);
+		kfree(locked);
+		return -EBUSY;
+	}
+	kfree(obj->lock_ranges);
+	kfree(obj->locked);
+	obj->lock_ranges = r;
+	obj->nr_lock_ranges = n;
+	obj->locked = locked;
+	obj->nr_locked = 0;
+	mutex_unlock(&obj->iommu_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(iommu_set_lock_ranges);
+
 /*
  *	OMAP Device MMU(IOMMU) detection
  */
@@ -1074,6 +1254,8 @@ static int __devexit omap_iommu_remove(struct platform_device *pdev)
 
 	pm_qos_remove_request(obj->qos_request);
 	kfree(obj->qos_request);
+	kfree(obj->lock_ranges);
+	kfree(obj->locked);
 
 	dev_info(&pdev->dev, "%s removed\n", obj->name);
 	kfree(obj);
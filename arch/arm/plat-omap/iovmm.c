@@ -283,8 +283,11 @@ static struct iovm_struct *alloc_iovm_area(struct iommu *obj, u32 da,
 		/* Don't map address 0 */
 		start = obj->da_start ? obj->da_start : alignment;
 
-		if (flags & IOVMF_LINEAR)
-			alignment = iopgsz_max(bytes);
+		/*
+		 * Align like a linear area, so that contiguous parts of an
+		 * sg list can go into superpages as well.
+		 */
+		alignment = iopgsz_max(bytes);
 		start = roundup(start, alignment);
 	} else if (start < obj->da_start || start > obj->da_end ||
 					obj->da_end - start < bytes) {
@@ -455,14 +458,19 @@ static inline void sgtable_drain_kmalloc(struct sg_table *sgt)
 	BUG_ON(!sgt);
 }
 
-/* create 'da' <-> 'pa' mapping from 'sgt' */
+/*
+ * create 'da' <-> 'pa' mapping from 'sgt'
+ *
+ * Physically contiguous sg entries are mapped as one run, with the
+ * largest iommu page size that the alignment of 'da' and 'pa' allows.
+ */
 static int map_iovm_area(struct iommu *obj, struct iovm_struct *new,
 			 const struct sg_table *sgt, u32 flags)
 {
-	int err;
-	unsigned int i, j;
-	struct scatterlist *sg;
-	u32 da = new->da_start;
+	int err = -EINVAL;
+	unsigned int i;
+	struct scatterlist *sg, *next;
+	u32 start, da = new->da_start;
 
 	if (!obj || !sgt)
 		return -EINVAL;
@@ -471,42 +479,60 @@ static int map_iovm_area(struct iommu *obj, struct iovm_struct *new,
 
 	for_each_sg(sgt->sgl, sg, sgt->nents, i) {
 		u32 pa;
-		int pgsz;
 		size_t bytes;
-		struct iotlb_entry e;
 
 		pa = sg_phys(sg);
 		bytes = sg_dma_len(sg);
 
-		flags &= ~IOVMF_PGSZ_MASK;
-		pgsz = bytes_to_iopgsz(bytes);
-		if (pgsz < 0)
-			goto err_out;
-		flags |= pgsz;
-
-		pr_debug("%s: [%d] %08x %08x(%x)\n", __func__,
-			 i, da, pa, bytes);
-
-		iotlb_init_entry(&e, da, pa, flags);
-		err = iopgtable_store_entry(obj, &e);
-		if (err)
-			goto err_out;
+		while (i + 1 < sgt->nents) {
+			next = sg_next(sg);
+			if (sg_phys(next) != pa + bytes)
+				break;
+			bytes += sg_dma_len(next);
+			sg = next;
+			i++;
+		}
 
-		da += bytes;
+		while (bytes) {
+			int pgsz;
+			size_t len;
+			struct iotlb_entry e;
+
+			len = max_alignment(da | pa);
+			len = min_t(size_t, len, iopgsz_max(bytes));
+
+			flags &= ~IOVMF_PGSZ_MASK;
+			pgsz = bytes_to_iopgsz(len);
+			if (pgsz < 0) {
+				err = -EINVAL;
+				goto err_out;
+			}
+			flags |= pgsz;
+
+			pr_debug("%s: [%d] %08x %08x(%x)\n", __func__,
+				 i, da, pa, len);
+
+			iotlb_init_entry(&e, da, pa, flags);
+			err = iopgtable_store_entry(obj, &e);
+			if (err)
+				goto err_out;
+
+			da += len;
+			pa += len;
+			bytes -= len;
+		}
 	}
 	return 0;
 
 err_out:
-	da = new->da_start;
-
-	for_each_sg(sgt->sgl, sg, i, j) {
+	for (start = new->da_start; start < da; ) {
 		size_t bytes;
 
-		bytes = iopgtable_clear_entry(obj, da);
+		bytes = iopgtable_clear_entry(obj, start);
 
 		BUG_ON(!iopgsz_ok(bytes));
 
-		da += bytes;
+		start += bytes;
 	}
 	return err;
 }
@@ -22,6 +22,7 @@
  */
 
 #include <linux/interrupt.h>
+#include <linux/workqueue.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
 #include <linux/delay.h>
@@ -35,6 +36,15 @@
 
 static struct omap_mbox **mboxes;
 
+/*
+ * The receive notifiers are blocking and end up in rpmsg callbacks
+ * that sleep, so they cannot run from a tasklet.  Keep them off the
+ * shared system workqueue, where they would queue up behind unrelated
+ * work, and never run one mailbox's work on two cpus at once so its
+ * messages stay in order.
+ */
+static struct workqueue_struct *mboxd;
+
 static int mbox_configured;
 static DEFINE_MUTEX(mbox_configured_lock);
 struct pm_qos_request_list mbox_qos_request;
@@ -77,6 +87,11 @@ static inline int is_mbox_irq(struct omap_mbox *mbox, omap_mbox_irq_t irq)
 
 /*
  * message sender
+ *
+ * Senders serialize on the queue lock, the tx tasklet is the only
+ * consumer and takes no lock.  A message stays in the kfifo until it
+ * has been written to the hardware, so the direct write of a sender
+ * that finds the kfifo empty can never overtake one still on its way.
  */
 static int __mbox_poll_for_space(struct omap_mbox *mbox)
 {
@@ -112,7 +127,11 @@ int omap_mbox_msg_send(struct omap_mbox *mbox, mbox_msg_t msg)
 	len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
 	WARN_ON(len != sizeof(msg));
 
-	tasklet_schedule(&mbox->txq->tasklet);
+	/* no point running the tasklet until the not-full interrupt */
+	if (mbox->ops->type == OMAP_MBOX_TYPE2 && mbox_fifo_full(mbox))
+		omap_mbox_enable_irq(mbox, IRQ_TX);
+	else
+		tasklet_schedule(&mbox->txq->tasklet);
 
 out:
 	spin_unlock_bh(&mq->lock);
@@ -133,11 +152,17 @@ static void mbox_tx_tasklet(unsigned long tx_data)
 			break;
 		}
 
-		ret = kfifo_out(&mq->fifo, (unsigned char *)&msg,
+		ret = kfifo_out_peek(&mq->fifo, (unsigned char *)&msg,
 								sizeof(msg));
 		WARN_ON(ret != sizeof(msg));
 
 		mbox_fifo_write(mbox, msg);
+
+		/* the hardware has it, let senders write directly again */
+		wmb();
+		ret = kfifo_out(&mq->fifo, (unsigned char *)&msg,
+								sizeof(msg));
+		WARN_ON(ret != sizeof(msg));
 	}
 }
 
@@ -201,7 +226,7 @@ static void __mbox_rx_interrupt(struct omap_mbox *mbox)
 	/* no more messages in the fifo. clear IRQ source. */
 	ack_mbox_irq(mbox, IRQ_RX);
 nomem:
-	schedule_work(&mbox->rxq->work);
+	queue_work(mboxd, &mbox->rxq->work);
 }
 
 static irqreturn_t mbox_interrupt(int irq, void *p)
@@ -427,6 +452,12 @@ static int __init omap_mbox_init(void)
 	mbox_kfifo_size = max_t(unsigned int, mbox_kfifo_size,
 							sizeof(mbox_msg_t));
 
+	mboxd = alloc_workqueue("mboxd", WQ_HIGHPRI | WQ_NON_REENTRANT, 0);
+	if (!mboxd) {
+		class_unregister(&omap_mbox_class);
+		return -ENOMEM;
+	}
+
 	pm_qos_add_request(&mbox_qos_request, PM_QOS_CPU_DMA_LATENCY,
 						PM_QOS_DEFAULT_VALUE);
 	return 0;
@@ -435,6 +466,7 @@ subsys_initcall(omap_mbox_init);
 
 static void __exit omap_mbox_exit(void)
 {
+	destroy_workqueue(mboxd);
 	class_unregister(&omap_mbox_class);
 	pm_qos_remove_request(&mbox_qos_request);
 }
@@ -21,6 +21,7 @@
 #include <linux/err.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/hash.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 
@@ -40,17 +41,22 @@ static DEFINE_MUTEX(bus_tput_mutex);
 static DEFINE_MUTEX(mpu_tput_mutex);
 static DEFINE_MUTEX(mpu_lat_mutex);
 
+#define TPUT_USERS_HASH_BITS	4
+
 /* Used to model a Interconnect Throughput */
 static struct interconnect_tput {
 	/* Total no of users at any point of interconnect */
 	u8 no_of_users;
-	/* List of all the current users for interconnect */
-	struct list_head users_list;
+	/* All the current users for interconnect, hashed by device */
+	struct hlist_head users_hash[1 << TPUT_USERS_HASH_BITS];
 	struct list_head node;
 	/* Protect interconnect throughput */
 	struct mutex throughput_mutex;
 	/* Target level for interconnect throughput */
 	unsigned long target_level;
+	/* Requests made, and how many of them changed the target level */
+	unsigned long requests;
+	unsigned long changes;
 
 } *bus_tput;
 
@@ -58,11 +64,18 @@ static struct interconnect_tput {
 struct users {
 	/* Device pointer used to uniquely identify the user */
 	struct device *dev;
-	struct list_head node;
+	struct hlist_node node;
 	/* Current level as requested for interconnect throughput by the user */
 	u32 level;
+	/* Number of requests made by this user */
+	unsigned long requests;
 };
 
+static struct hlist_head *user_bucket(struct device *dev)
+{
+	return &bus_tput->users_hash[hash_ptr(dev, TPUT_USERS_HASH_BITS)];
+}
+
 /* Private/Internal Functions */
 
 /**
@@ -75,17 +88,14 @@ struct users {
  */
 static struct users *user_lookup(struct device *dev)
 {
-	struct users *usr, *tmp_usr;
+	struct users *usr;
+	struct hlist_node *n;
 
-	usr = NULL;
-	list_for_each_entry(tmp_usr, &bus_tput->users_list, node) {
-		if (tmp_usr->dev == dev) {
-			usr = tmp_usr;
-			break;
-		}
-	}
+	hlist_for_each_entry(usr, n, user_bucket(dev), node)
+		if (usr->dev == dev)
+			return usr;
 
-	return usr;
+	return NULL;
 }
 
 /**
@@ -100,7 +110,7 @@ static struct users *get_user(void)
 {
 	struct users *user;
 
-	user = kmalloc(sizeof(struct users), GFP_KERNEL);
+	user = kzalloc(sizeof(struct users), GFP_KERNEL);
 	if (!user) {
 		pr_err("%s FATAL ERROR: kmalloc failed\n", __func__);
 		return ERR_PTR(-ENOMEM);
@@ -112,11 +122,18 @@ static struct users *get_user(void)
 static int pm_dbg_show_tput(struct seq_file *s, void *unused)
 {
 	struct users *usr;
+	struct hlist_node *n;
+	int i;
 
 	mutex_lock(&bus_tput->throughput_mutex);
-	list_for_each_entry(usr, &bus_tput->users_list, node)
-		seq_printf(s, "%s:	%u\n", dev_name(usr->dev),
-				usr->level);
+	seq_printf(s, "total:	%lu	%lu requests, %lu changes\n",
+		   bus_tput->target_level, bus_tput->requests,
+		   bus_tput->changes);
+	for (i = 0; i < ARRAY_SIZE(bus_tput->users_hash); i++)
+		hlist_for_each_entry(usr, n, &bus_tput->users_hash[i], node)
+			seq_printf(s, "%s:	%u	%lu requests\n",
+				   dev_name(usr->dev), usr->level,
+				   usr->requests);
 	mutex_unlock(&bus_tput->throughput_mutex);
 
 	return 0;
@@ -146,15 +163,12 @@ static const struct file_operations tputdebugfs_fops = {
  */
 static int __init omap_bus_tput_init(void)
 {
-	bus_tput = kmalloc(sizeof(struct interconnect_tput), GFP_KERNEL);
+	bus_tput = kzalloc(sizeof(struct interconnect_tput), GFP_KERNEL);
 	if (!bus_tput) {
-		pr_err("%s FATAL ERROR: kmalloc failed\n", __func__);
+		pr_err("%s FATAL ERROR: kzalloc failed\n", __func__);
 		return -EINVAL;
 	}
-	INIT_LIST_HEAD(&bus_tput->users_list);
 	mutex_init(&bus_tput->throughput_mutex);
-	bus_tput->no_of_users = 0;
-	bus_tput->target_level = 0;
 
 #ifdef CONFIG_PM_DEBUG
 	(void) debugfs_create_file("tput", S_IRUGO,
@@ -184,7 +198,7 @@ static unsigned long add_req_tput(struct device *dev, unsigned long level)
 
 	if (!dev) {
 		pr_err("Invalid dev pointer\n");
-		ret = 0;
+		return 0;
 	}
 	mutex_lock(&bus_tput->throughput_mutex);
 	user = user_lookup(dev);
@@ -199,13 +213,15 @@ static unsigned long add_req_tput(struct device *dev, unsigned long level)
 		bus_tput->target_level += level;
 		bus_tput->no_of_users++;
 		user->dev = dev;
-		list_add(&user->node, &bus_tput->users_list);
+		hlist_add_head(&user->node, user_bucket(dev));
 		user->level = level;
 	} else {
 		bus_tput->target_level -= user->level;
 		bus_tput->target_level += level;
 		user->level = level;
 	}
+	user->requests++;
+	bus_tput->requests++;
 	ret = bus_tput->target_level;
 unlock:
 	mutex_unlock(&bus_tput->throughput_mutex);
@@ -226,17 +242,11 @@ unlock:
 static unsigned long remove_req_tput(struct device *dev)
 {
 	struct users *user;
-	int found = 0;
 	int ret;
 
 	mutex_lock(&bus_tput->throughput_mutex);
-	list_for_each_entry(user, &bus_tput->users_list, node) {
-		if (user->dev == dev) {
-			found = 1;
-			break;
-		}
-	}
-	if (!found) {
+	user = user_lookup(dev);
+	if (!user) {
 		/* No such user exists */
 		pr_err("Invalid Device Structure\n");
 		ret = 0;
@@ -244,7 +254,8 @@ static unsigned long remove_req_tput(struct device *dev)
 	}
 	bus_tput->target_level -= user->level;
 	bus_tput->no_of_users--;
-	list_del(&user->node);
+	bus_tput->requests++;
+	hlist_del(&user->node);
 	kfree(user);
 	ret = bus_tput->target_level;
 unlock:
@@ -260,6 +271,8 @@ int omap_pm_set_min_bus_tput_helper(struct device *dev, u8 agent_id, long r)
 	static struct device dummy_l3_dev = {
 		.init_name = "omap_pm_set_min_bus_tput",
 	};
+	/* Level the l3 was last scaled for, -1 if unknown */
+	static long scaled_level = -1;
 	unsigned long target_level = 0;
 
 	mutex_lock(&bus_tput_mutex);
@@ -279,10 +292,19 @@ int omap_pm_set_min_bus_tput_helper(struct device *dev, u8 agent_id, long r)
 	/* Convert the throughput(in KiB/s) into Hz. */
 	target_level = (target_level * 1000) / 4;
 
+	/* Most requests leave the sum where it was; don't rescale for those */
+	if ((long)target_level == scaled_level)
+		goto unlock;
+	bus_tput->changes++;
+
 	ret = omap_device_scale(&dummy_l3_dev, l3_dev, target_level);
-	if (ret)
+	if (ret) {
 		pr_err("Failed: change interconnect bandwidth to %ld\n",
 		     target_level);
+		scaled_level = -1;
+	} else {
+		scaled_level = target_level;
+	}
 unlock:
 	mutex_unlock(&bus_tput_mutex);
 	return ret;
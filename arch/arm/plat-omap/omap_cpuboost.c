@@ -24,73 +24,291 @@
 #include <linux/kernel.h>
 #include <linux/jiffies.h>
 #include <linux/slab.h>
+#include <linux/input.h>
+#include <linux/workqueue.h>
+#include <linux/cpufreq.h>
 #include <plat/common.h>
+#include <plat/omap_device.h>
+#include <plat/cpuboost.h>
 #include "../mach-omap2/omap2plus-cpufreq.h"
+#include "../mach-omap2/dvfs.h"
 
 #define OMAP_CPUBOOST_TIME_MAX	10000		/* 10sec */
 #define OMAP_CPUBOOST_FREQ_MIN	300000		/* 300 MHz */
 #define OMAP_CPUBOOST_FREQ_MAX	1000000		/* 1 GHz */
+#define OMAP_CPUBOOST_MAX_REQS	16
 
-struct cpuboost_work_struct {
-	struct delayed_work work;
-};
-
-struct cpuboost_main_struct {
-	struct cpuboost_work_struct *work;
+/*
+ * Boost requests of all owners: touch input, the cpuboost_time and
+ * request parameters, and in-kernel users such as app launch.  Each
+ * speed is held at the max of the live requests; the work recomputes
+ * them when the earliest request expires.
+ */
+struct cpuboost_req {
+	const void *owner;
+	struct omap_boost_req req;
+	unsigned long expires;
 };
 
 static struct mutex lock;
 static struct device *device;
-static struct cpuboost_main_struct *cbs;
+static struct delayed_work cpuboost_work;
+static struct cpuboost_req reqs[OMAP_CPUBOOST_MAX_REQS];
+static struct omap_boost_req applied;
 static unsigned long cpuboost_time;
 
-static int cpuboost_time_set(const char *val, struct kernel_param *kp)
+/* 0 when off: boost for input_ms at input_khz on each touch */
+static unsigned int input_khz;
+static unsigned int input_ms;
+module_param(input_khz, uint, 0644);
+module_param(input_ms, uint, 0644);
+
+static void cpuboost_scale(struct device *target_dev, unsigned int khz)
 {
-	int ret = param_set_ulong(val, kp);
+	int ret;
 
-	mutex_lock(&lock);
+	if (!target_dev)
+		return;
+	ret = omap_device_scale(device, target_dev, khz * 1000UL);
+	if (ret)
+		pr_debug("cpuboost: %s to %u KHz failed %d\n",
+			 dev_name(target_dev), khz, ret);
+}
 
-	cpuboost_time = (cpuboost_time > OMAP_CPUBOOST_TIME_MAX) ?
-				 OMAP_CPUBOOST_TIME_MAX : cpuboost_time;
+/* Locking: lock */
+static void cpuboost_update(void)
+{
+	struct omap_boost_req max = { 0 };
+	unsigned long next = 0;
+	int i;
 
-	cancel_delayed_work(&(cbs->work->work));
-	printk(KERN_INFO "cpuboost_time_set = %ld\n", cpuboost_time);
-	if (cpuboost_time > 0) {
-		omap_cpufreq_scale(device, OMAP_CPUBOOST_FREQ_MAX);
-		schedule_delayed_work(&(cbs->work->work),
-					msecs_to_jiffies(cpuboost_time));
+	for (i = 0; i < OMAP_CPUBOOST_MAX_REQS; i++) {
+		struct cpuboost_req *r = &reqs[i];
+
+		if (!r->owner)
+			continue;
+		if (time_after_eq(jiffies, r->expires)) {
+			r->owner = NULL;
+			continue;
+		}
+		max.mpu_khz = max(max.mpu_khz, r->req.mpu_khz);
+		max.l3_khz = max(max.l3_khz, r->req.l3_khz);
+		max.iva_khz = max(max.iva_khz, r->req.iva_khz);
+		if (!next || time_before(r->expires, next))
+			next = r->expires;
 	}
 
-	if ((ret) || (cpuboost_time == 0)) {
-		omap_cpufreq_scale(device, OMAP_CPUBOOST_FREQ_MIN);
-		printk(KERN_INFO "cpuboost_time cleared\n");
+	if (max.mpu_khz != applied.mpu_khz)
+		omap_cpufreq_scale(device, max.mpu_khz ? :
+				   OMAP_CPUBOOST_FREQ_MIN);
+	/* a request for 0 settles on the lowest OPP, dropping the floor */
+	if (max.l3_khz != applied.l3_khz)
+		cpuboost_scale(omap2_get_l3_device(), max.l3_khz);
+	if (max.iva_khz != applied.iva_khz)
+		cpuboost_scale(omap2_get_iva_device(), max.iva_khz);
+	applied = max;
+
+	cancel_delayed_work(&cpuboost_work);
+	if (next)
+		schedule_delayed_work(&cpuboost_work,
+				      max_t(long, next - jiffies, 1));
+}
+
+int omap_cpuboost_request(const void *owner, const struct omap_boost_req *req,
+			  unsigned int ms)
+{
+	struct cpuboost_req *r, *free = NULL;
+	int i, ret = 0;
+
+	if (!device)
+		return -ENODEV;
+
+	mutex_lock(&lock);
+	for (i = 0; i < OMAP_CPUBOOST_MAX_REQS; i++) {
+		r = &reqs[i];
+		if (r->owner == owner)
+			break;
+		if (!r->owner && !free)
+			free = r;
+	}
+	if (i == OMAP_CPUBOOST_MAX_REQS)
+		r = ms ? free : NULL;
+
+	if (!ms) {
+		if (r)
+			r->owner = NULL;
+	} else if (!r) {
+		ret = -EBUSY;
+	} else {
+		ms = min_t(unsigned int, ms, OMAP_CPUBOOST_TIME_MAX);
+		r->owner = owner;
+		r->req = *req;
+		r->expires = jiffies + msecs_to_jiffies(ms);
+		if (req->mpu_khz)
+			cpufreq_hotplug_boost();
 	}
+	cpuboost_update();
 	mutex_unlock(&lock);
 
 	return ret;
 }
+EXPORT_SYMBOL(omap_cpuboost_request);
+
+static int cpuboost_time_set(const char *val, struct kernel_param *kp)
+{
+	struct omap_boost_req req = { .mpu_khz = OMAP_CPUBOOST_FREQ_MAX };
+	int ret = param_set_ulong(val, kp);
+
+	if (ret)
+		cpuboost_time = 0;
+	cpuboost_time = min_t(unsigned long, cpuboost_time,
+			      OMAP_CPUBOOST_TIME_MAX);
+	printk(KERN_INFO "cpuboost_time_set = %ld\n", cpuboost_time);
+
+	omap_cpuboost_request(&cpuboost_time, &req, cpuboost_time);
+
+	return ret;
+}
 
 module_param_call(cpuboost_time, cpuboost_time_set, param_get_uint,
 					&cpuboost_time, 0644);
 
+/* "<mpu_khz> <ms> [<l3_khz> [<iva_khz>]]", e.g. from the UI on app launch */
+static int cpuboost_request_set(const char *val, struct kernel_param *kp)
+{
+	struct omap_boost_req req = { 0 };
+	unsigned int ms;
+
+	if (sscanf(val, "%u %u %u %u", &req.mpu_khz, &ms, &req.l3_khz,
+		   &req.iva_khz) < 2)
+		return -EINVAL;
+
+	return omap_cpuboost_request(kp, &req, ms);
+}
+
+static int cpuboost_request_get(char *buffer, struct kernel_param *kp)
+{
+	int ret;
+
+	mutex_lock(&lock);
+	ret = sprintf(buffer, "%u %u %u", applied.mpu_khz, applied.l3_khz,
+		      applied.iva_khz);
+	mutex_unlock(&lock);
+
+	return ret;
+}
+
+module_param_call(request, cpuboost_request_set, cpuboost_request_get,
+		  NULL, 0644);
+
 static void cpuboost_process_work(struct work_struct *work)
 {
+	int i;
+
 	mutex_lock(&lock);
-	omap_cpufreq_scale(device, OMAP_CPUBOOST_FREQ_MIN);
-	printk(KERN_INFO "cpuboost_time cleared\n");
-	cpuboost_time = 0;
+	cpuboost_update();
+	for (i = 0; i < OMAP_CPUBOOST_MAX_REQS; i++)
+		if (reqs[i].owner == &cpuboost_time)
+			break;
+	if (i == OMAP_CPUBOOST_MAX_REQS && cpuboost_time) {
+		printk(KERN_INFO "cpuboost_time cleared\n");
+		cpuboost_time = 0;
+	}
 	mutex_unlock(&lock);
 }
 
+/* Input events come in atomic context: request from a work */
+static void cpuboost_input_work_fn(struct work_struct *work)
+{
+	struct omap_boost_req req = { .mpu_khz = input_khz };
+
+	omap_cpuboost_request(&input_khz, &req, input_ms);
+}
+
+static DECLARE_WORK(cpuboost_input_work, cpuboost_input_work_fn);
+
+static void cpuboost_input_event(struct input_handle *handle,
+				 unsigned int type, unsigned int code,
+				 int value)
+{
+	if (input_khz && input_ms && type == EV_SYN && code == SYN_REPORT)
+		schedule_work(&cpuboost_input_work);
+}
+
+static int cpuboost_input_connect(struct input_handler *handler,
+				  struct input_dev *dev,
+				  const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "omap_cpuboost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	input_unregister_handle(handle);
+err:
+	kfree(handle);
+	return error;
+}
+
+static void cpuboost_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id cpuboost_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	}, /* multi-touch touchscreen */
+	{ },
+};
+
+static struct input_handler cpuboost_input_handler = {
+	.event		= cpuboost_input_event,
+	.connect	= cpuboost_input_connect,
+	.disconnect	= cpuboost_input_disconnect,
+	.name		= "omap_cpuboost",
+	.id_table	= cpuboost_ids,
+};
+
 static int __init cpuboost_init_module(void)
 {
+	struct device *dev;
+
 	mutex_init(&lock);
-	cbs = kzalloc(sizeof(struct cpuboost_main_struct), GFP_KERNEL);
-	device = kzalloc(sizeof(struct device), GFP_KERNEL);
-	dev_set_name(device, "omap_cpuboost");
+	INIT_DELAYED_WORK(&cpuboost_work, cpuboost_process_work);
+
+	dev = kzalloc(sizeof(struct device), GFP_KERNEL);
+	if (!dev)
+		return -ENOMEM;
+	dev_set_name(dev, "omap_cpuboost");
+	device = dev;
 
-	cbs->work = kzalloc(sizeof(struct cpuboost_work_struct), GFP_KERNEL);
-	INIT_DELAYED_WORK(&(cbs->work->work), cpuboost_process_work);
+	if (input_register_handler(&cpuboost_input_handler))
+		pr_warn("%s: failed to register input handler\n", __func__);
 
 	return 0;
 }
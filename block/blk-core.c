@@ -1773,6 +1773,51 @@ static void blk_account_io_completion(struct request *req, unsigned int bytes)
 	}
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static void blk_lat_hist_add(struct request *rq, int phase, u64 start)
+{
+	unsigned int bytes = rq->dispatch_bytes;
+	u64 now = sched_clock();
+	u64 us;
+	int size, bucket;
+
+	if (bytes <= 4096)
+		size = BLK_LAT_SIZE_4K;
+	else if (bytes <= 65536)
+		size = BLK_LAT_SIZE_64K;
+	else
+		size = BLK_LAT_SIZE_LARGE;
+
+	us = now > start ? div_u64(now - start, NSEC_PER_USEC) : 0;
+	bucket = min_t(int, fls64(us >> BLK_LAT_HIST_SHIFT),
+		       BLK_LAT_HIST_BUCKETS - 1);
+
+	rq->q->lat_hist.count[phase][rq_data_dir(rq)][size][bucket]++;
+}
+
+/* requeued requests are only accounted for their first dispatch */
+static void blk_lat_hist_dispatch(struct request *rq)
+{
+	if (rq->cmd_type != REQ_TYPE_FS || rq_io_start_time_ns(rq))
+		return;
+
+	rq->dispatch_bytes = blk_rq_bytes(rq);
+	blk_lat_hist_add(rq, BLK_LAT_QUEUE, rq_start_time_ns(rq));
+}
+
+static void blk_lat_hist_done(struct request *rq)
+{
+	if (rq->cmd_type != REQ_TYPE_FS || !rq_io_start_time_ns(rq) ||
+	    (rq->cmd_flags & REQ_FLUSH_SEQ))
+		return;
+
+	blk_lat_hist_add(rq, BLK_LAT_SERVICE, rq_io_start_time_ns(rq));
+}
+#else
+static inline void blk_lat_hist_dispatch(struct request *rq) {}
+static inline void blk_lat_hist_done(struct request *rq) {}
+#endif
+
 static void blk_account_io_done(struct request *req)
 {
 	/*
@@ -1915,6 +1960,7 @@ void blk_dequeue_request(struct request *rq)
 	 */
 	if (blk_account_rq(rq)) {
 		q->in_flight[rq_is_sync(rq)]++;
+		blk_lat_hist_dispatch(rq);
 		set_io_start_time_ns(rq);
 	}
 }
@@ -2206,6 +2252,7 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_lat_hist_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
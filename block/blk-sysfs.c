@@ -266,6 +266,60 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * One line of bucket upper bounds in us, then a line per phase, direction
+ * and size class.  Writing anything clears the counts.
+ */
+static ssize_t queue_lat_hist_show(struct request_queue *q, char *page)
+{
+	static const char *phase[BLK_LAT_NR] = { "queue", "service" };
+	static const char *dir[2] = { "read", "write" };
+	static const char *size[BLK_LAT_SIZE_NR] = { "4k", "64k", "large" };
+	struct blk_latency_hist *hist;
+	ssize_t len;
+	int p, d, s, b;
+
+	hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	spin_lock_irq(q->queue_lock);
+	memcpy(hist, &q->lat_hist, sizeof(*hist));
+	spin_unlock_irq(q->queue_lock);
+
+	len = sprintf(page, "us");
+	for (b = 0; b < BLK_LAT_HIST_BUCKETS - 1; b++)
+		len += sprintf(page + len, " %u",
+			       1U << (BLK_LAT_HIST_SHIFT + b));
+	len += sprintf(page + len, " inf\n");
+
+	for (p = 0; p < BLK_LAT_NR; p++)
+		for (d = 0; d < 2; d++)
+			for (s = 0; s < BLK_LAT_SIZE_NR; s++) {
+				len += sprintf(page + len, "%s %s %s", phase[p],
+					       dir[d], size[s]);
+				for (b = 0; b < BLK_LAT_HIST_BUCKETS; b++)
+					len += sprintf(page + len, " %lu",
+						       hist->count[p][d][s][b]);
+				len += sprintf(page + len, "\n");
+			}
+
+	kfree(hist);
+	return len;
+}
+
+static ssize_t
+queue_lat_hist_store(struct request_queue *q, const char *page, size_t count)
+{
+	spin_lock_irq(q->queue_lock);
+	memset(&q->lat_hist, 0, sizeof(q->lat_hist));
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -380,6 +434,14 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static struct queue_sysfs_entry queue_lat_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_lat_hist_show,
+	.store = queue_lat_hist_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -402,6 +464,9 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+#ifdef CONFIG_BLK_LATENCY_HIST
+	&queue_lat_hist_entry.attr,
+#endif
 	NULL,
 };
 
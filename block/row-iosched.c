@@ -0,0 +1,431 @@
+/*
+ *  ROW (Read Over Write) i/o scheduler.
+ *
+ *  Meant for flash storage such as eMMC, where there is no seek to
+ *  optimise and a read stuck behind a stream of buffered writes is what
+ *  the user notices.  Requests are kept in three FIFO queues, by
+ *  priority:
+ *
+ *	reads, sync writes, async writes
+ *
+ *  and the queues are served round-robin, each one for at most its quota
+ *  of requests in a row.  On top of that:
+ *
+ *  - a read that has waited longer than read_expire ends the current
+ *    write batch, so reads keep a bounded latency behind big writes;
+ *  - async writes are held back while reads are queued, in flight, or
+ *    have completed less than read_idle ago (the next read of a
+ *    dependent chain, e.g. an app being loaded, is usually about to
+ *    come), unless the oldest of them has waited for async_write_expire.
+ *
+ *  See Documentation/block/row-iosched.txt
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/jiffies.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+
+enum row_queue_idx {
+	ROWQ_READ = 0,
+	ROWQ_SYNC_WRITE,
+	ROWQ_ASYNC_WRITE,
+	ROWQ_NR,
+};
+
+/* requests dispatched in a row from one queue */
+static const int read_quota = 100;
+static const int sync_write_quota = 10;
+static const int async_write_quota = 4;
+/* latency targets, in ms */
+static const int read_expire = 10;
+static const int sync_write_expire = 100;
+static const int async_write_expire = 500;
+/* async writes wait this long after the last read completed, in ms */
+static const int read_idle = 8;
+
+struct row_data {
+	struct request_queue *queue;
+
+	struct list_head fifo_list[ROWQ_NR];
+	int curr_queue;			/* queue of the current batch */
+	int batch;			/* dispatched in the current batch */
+	unsigned int reads_in_flight;
+	unsigned long last_read_done;	/* jiffies */
+
+	/* runs the queue again when the held async writes may go */
+	struct timer_list hold_timer;
+	struct work_struct kick_work;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int quota[ROWQ_NR];
+	int fifo_expire[ROWQ_NR];	/* jiffies */
+	int read_idle;			/* jiffies */
+};
+
+static inline int row_queue_idx(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return ROWQ_READ;
+	if (rq_is_sync(rq))
+		return ROWQ_SYNC_WRITE;
+	return ROWQ_ASYNC_WRITE;
+}
+
+static void row_add_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	int qi = row_queue_idx(rq);
+
+	rq_set_fifo_time(rq, jiffies + rd->fifo_expire[qi]);
+	list_add_tail(&rq->queuelist, &rd->fifo_list[qi]);
+}
+
+static void
+row_merged_requests(struct request_queue *q, struct request *req,
+		    struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	rq_fifo_clear(next);
+}
+
+/* a read and an async write may share the sync flag, keep them apart */
+static int row_allow_merge(struct request_queue *q, struct request *rq,
+			   struct bio *bio)
+{
+	if (rq_data_dir(rq) == READ)
+		return 1;
+	return rq_is_sync(rq) == !!(bio->bi_rw & REQ_SYNC);
+}
+
+static inline bool row_expired(struct row_data *rd, int qi)
+{
+	struct request *rq;
+
+	if (list_empty(&rd->fifo_list[qi]))
+		return false;
+	rq = rq_entry_fifo(rd->fifo_list[qi].next);
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+static inline bool row_reads_waiting(struct row_data *rd)
+{
+	return !list_empty(&rd->fifo_list[ROWQ_READ]) ||
+		rd->reads_in_flight ||
+		time_before(jiffies, rd->last_read_done + rd->read_idle);
+}
+
+static bool row_may_dispatch(struct row_data *rd, int qi)
+{
+	if (list_empty(&rd->fifo_list[qi]))
+		return false;
+	if (qi != ROWQ_ASYNC_WRITE)
+		return true;
+	return !row_reads_waiting(rd) || row_expired(rd, qi);
+}
+
+/*
+ * Return the queue to dispatch from next, -1 if there is nothing that
+ * may be dispatched now.
+ */
+static int row_select_queue(struct row_data *rd)
+{
+	int i, qi = rd->curr_queue;
+
+	/* a read over its latency target ends the current write batch */
+	if (qi != ROWQ_READ && row_expired(rd, ROWQ_READ)) {
+		qi = ROWQ_READ;
+		goto new_batch;
+	}
+
+	if (rd->batch < rd->quota[qi] && row_may_dispatch(rd, qi))
+		return qi;
+
+	for (i = 1; i <= ROWQ_NR; i++) {
+		qi = (rd->curr_queue + i) % ROWQ_NR;
+		if (row_may_dispatch(rd, qi))
+			goto new_batch;
+	}
+
+	/*
+	 * Only held async writes left.  Reads in flight run the queue again
+	 * when they complete; otherwise come back when the hold ends.
+	 */
+	if (!list_empty(&rd->fifo_list[ROWQ_ASYNC_WRITE]) &&
+	    !rd->reads_in_flight && list_empty(&rd->fifo_list[ROWQ_READ]))
+		mod_timer(&rd->hold_timer,
+			  max(rd->last_read_done + rd->read_idle, jiffies + 1));
+	return -1;
+
+new_batch:
+	rd->curr_queue = qi;
+	rd->batch = 0;
+	return qi;
+}
+
+static void row_dispatch_insert(struct row_data *rd, int qi)
+{
+	struct request *rq = rq_entry_fifo(rd->fifo_list[qi].next);
+
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(rd->queue, rq);
+	rd->batch++;
+}
+
+static int row_dispatch_requests(struct request_queue *q, int force)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	int qi, dispatched = 0;
+
+	if (unlikely(force)) {
+		for (qi = 0; qi < ROWQ_NR; qi++)
+			while (!list_empty(&rd->fifo_list[qi])) {
+				row_dispatch_insert(rd, qi);
+				dispatched++;
+			}
+		rd->batch = 0;
+		return dispatched;
+	}
+
+	qi = row_select_queue(rd);
+	if (qi < 0)
+		return 0;
+
+	row_dispatch_insert(rd, qi);
+	return 1;
+}
+
+static void row_activate_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	if (rq_data_dir(rq) == READ)
+		rd->reads_in_flight++;
+}
+
+static void row_deactivate_request(struct request_queue *q,
+				   struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	if (rq_data_dir(rq) == READ) {
+		WARN_ON(!rd->reads_in_flight);
+		rd->reads_in_flight--;
+	}
+}
+
+static void row_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	if (rq_data_dir(rq) != READ)
+		return;
+
+	WARN_ON(!rd->reads_in_flight);
+	rd->reads_in_flight--;
+	rd->last_read_done = jiffies;
+
+	if (!rd->reads_in_flight &&
+	    !list_empty(&rd->fifo_list[ROWQ_ASYNC_WRITE]))
+		mod_timer(&rd->hold_timer, jiffies + rd->read_idle);
+}
+
+static void row_kick_queue(struct work_struct *work)
+{
+	struct row_data *rd = container_of(work, struct row_data, kick_work);
+	struct request_queue *q = rd->queue;
+
+	spin_lock_irq(q->queue_lock);
+	__blk_run_queue(q);
+	spin_unlock_irq(q->queue_lock);
+}
+
+static void row_hold_timer(unsigned long data)
+{
+	struct row_data *rd = (struct row_data *) data;
+
+	kblockd_schedule_work(rd->queue, &rd->kick_work);
+}
+
+static void row_exit_queue(struct elevator_queue *e)
+{
+	struct row_data *rd = e->elevator_data;
+	int qi;
+
+	del_timer_sync(&rd->hold_timer);
+	cancel_work_sync(&rd->kick_work);
+
+	for (qi = 0; qi < ROWQ_NR; qi++)
+		BUG_ON(!list_empty(&rd->fifo_list[qi]));
+
+	kfree(rd);
+}
+
+/*
+ * initialize elevator private data (row_data).
+ */
+static void *row_init_queue(struct request_queue *q)
+{
+	struct row_data *rd;
+	int qi;
+
+	rd = kmalloc_node(sizeof(*rd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!rd)
+		return NULL;
+
+	rd->queue = q;
+	for (qi = 0; qi < ROWQ_NR; qi++)
+		INIT_LIST_HEAD(&rd->fifo_list[qi]);
+
+	rd->quota[ROWQ_READ] = read_quota;
+	rd->quota[ROWQ_SYNC_WRITE] = sync_write_quota;
+	rd->quota[ROWQ_ASYNC_WRITE] = async_write_quota;
+	rd->fifo_expire[ROWQ_READ] = msecs_to_jiffies(read_expire);
+	rd->fifo_expire[ROWQ_SYNC_WRITE] = msecs_to_jiffies(sync_write_expire);
+	rd->fifo_expire[ROWQ_ASYNC_WRITE] =
+		msecs_to_jiffies(async_write_expire);
+	rd->read_idle = msecs_to_jiffies(read_idle);
+	rd->last_read_done = jiffies - rd->read_idle;
+
+	setup_timer(&rd->hold_timer, row_hold_timer, (unsigned long) rd);
+	INIT_WORK(&rd->kick_work, row_kick_queue);
+	return rd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+row_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+row_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return row_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(row_read_quota_show, rd->quota[ROWQ_READ], 0);
+SHOW_FUNCTION(row_sync_write_quota_show, rd->quota[ROWQ_SYNC_WRITE], 0);
+SHOW_FUNCTION(row_async_write_quota_show, rd->quota[ROWQ_ASYNC_WRITE], 0);
+SHOW_FUNCTION(row_read_expire_show, rd->fifo_expire[ROWQ_READ], 1);
+SHOW_FUNCTION(row_sync_write_expire_show, rd->fifo_expire[ROWQ_SYNC_WRITE], 1);
+SHOW_FUNCTION(row_async_write_expire_show,
+	      rd->fifo_expire[ROWQ_ASYNC_WRITE], 1);
+SHOW_FUNCTION(row_read_idle_show, rd->read_idle, 1);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data;							\
+	int ret = row_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(row_read_quota_store, &rd->quota[ROWQ_READ], 1, INT_MAX, 0);
+STORE_FUNCTION(row_sync_write_quota_store, &rd->quota[ROWQ_SYNC_WRITE],
+	       1, INT_MAX, 0);
+STORE_FUNCTION(row_async_write_quota_store, &rd->quota[ROWQ_ASYNC_WRITE],
+	       1, INT_MAX, 0);
+STORE_FUNCTION(row_read_expire_store, &rd->fifo_expire[ROWQ_READ],
+	       0, INT_MAX, 1);
+STORE_FUNCTION(row_sync_write_expire_store, &rd->fifo_expire[ROWQ_SYNC_WRITE],
+	       0, INT_MAX, 1);
+STORE_FUNCTION(row_async_write_expire_store,
+	       &rd->fifo_expire[ROWQ_ASYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(row_read_idle_store, &rd->read_idle, 0, INT_MAX, 1);
+#undef STORE_FUNCTION
+
+#define ROW_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
+				      row_##name##_store)
+
+static struct elv_fs_entry row_attrs[] = {
+	ROW_ATTR(read_quota),
+	ROW_ATTR(sync_write_quota),
+	ROW_ATTR(async_write_quota),
+	ROW_ATTR(read_expire),
+	ROW_ATTR(sync_write_expire),
+	ROW_ATTR(async_write_expire),
+	ROW_ATTR(read_idle),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_row = {
+	.ops = {
+		.elevator_merge_req_fn =	row_merged_requests,
+		.elevator_allow_merge_fn =	row_allow_merge,
+		.elevator_dispatch_fn =		row_dispatch_requests,
+		.elevator_add_req_fn =		row_add_request,
+		.elevator_activate_req_fn =	row_activate_request,
+		.elevator_deactivate_req_fn =	row_deactivate_request,
+		.elevator_completed_req_fn =	row_completed_request,
+		.elevator_init_fn =		row_init_queue,
+		.elevator_exit_fn =		row_exit_queue,
+	},
+
+	.elevator_attrs = row_attrs,
+	.elevator_name = "row",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init row_init(void)
+{
+	elv_register(&iosched_row);
+
+	return 0;
+}
+
+static void __exit row_exit(void)
+{
+	elv_unregister(&iosched_row);
+}
+
+module_init(row_init);
+module_exit(row_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("ROW (Read Over Write) IO scheduler");
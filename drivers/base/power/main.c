@@ -27,6 +27,7 @@
 #include <linux/sched.h>
 #include <linux/async.h>
 #include <linux/suspend.h>
+#include <linux/suspend_time.h>
 #include <linux/timer.h>
 
 #include "../base.h"
@@ -161,6 +162,8 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
+static char *pm_verb(int event);
+
 static ktime_t initcall_debug_start(struct device *dev)
 {
 	ktime_t calltime = ktime_set(0, 0);
@@ -224,6 +227,7 @@ static int pm_op(struct device *dev,
 {
 	int error = 0;
 	ktime_t calltime;
+	u64 start = local_clock();
 
 	calltime = initcall_debug_start(dev);
 
@@ -275,6 +279,8 @@ static int pm_op(struct device *dev,
 	}
 
 	initcall_debug_report(dev, calltime, error);
+	suspend_time_record(start, "%s %s", pm_verb(state.event),
+			    dev_name(dev));
 
 	return error;
 }
@@ -294,6 +300,7 @@ static int pm_noirq_op(struct device *dev,
 {
 	int error = 0;
 	ktime_t calltime = ktime_set(0, 0), delta, rettime;
+	u64 start = local_clock();
 
 	if (initcall_debug) {
 		pr_info("calling  %s+ @ %i, parent: %s\n",
@@ -356,6 +363,8 @@ static int pm_noirq_op(struct device *dev,
 			dev_name(dev), error,
 			(unsigned long long)ktime_to_ns(delta) >> 10);
 	}
+	suspend_time_record(start, "%s_noirq %s", pm_verb(state.event),
+			    dev_name(dev));
 
 	return error;
 }
@@ -492,6 +501,7 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
 {
 	int error;
 	ktime_t calltime;
+	u64 start = local_clock();
 
 	calltime = initcall_debug_start(dev);
 
@@ -499,6 +509,7 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
+	suspend_time_record(start, "resume %s", dev_name(dev));
 
 	return error;
 }
@@ -670,7 +681,10 @@ void dpm_resume(pm_message_t state)
  */
 static void device_complete(struct device *dev, pm_message_t state)
 {
+	u64 start;
+
 	device_lock(dev);
+	start = local_clock();
 
 	if (dev->pwr_domain) {
 		pm_dev_dbg(dev, state, "completing power domain ");
@@ -690,6 +704,7 @@ static void device_complete(struct device *dev, pm_message_t state)
 			dev->bus->pm->complete(dev);
 	}
 
+	suspend_time_record(start, "complete %s", dev_name(dev));
 	device_unlock(dev);
 }
 
@@ -852,6 +867,7 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 {
 	int error;
 	ktime_t calltime;
+	u64 start = local_clock();
 
 	calltime = initcall_debug_start(dev);
 
@@ -859,6 +875,8 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
+	suspend_time_record(start, "%s %s", pm_verb(state.event),
+			    dev_name(dev));
 
 	return error;
 }
@@ -1025,8 +1043,10 @@ int dpm_suspend(pm_message_t state)
 static int device_prepare(struct device *dev, pm_message_t state)
 {
 	int error = 0;
+	u64 start;
 
 	device_lock(dev);
+	start = local_clock();
 
 	if (dev->pwr_domain) {
 		pm_dev_dbg(dev, state, "preparing power domain ");
@@ -1057,6 +1077,7 @@ static int device_prepare(struct device *dev, pm_message_t state)
 	}
 
  End:
+	suspend_time_record(start, "prepare %s", dev_name(dev));
 	device_unlock(dev);
 
 	return error;
@@ -221,6 +221,50 @@ static inline void adjust_jiffies(unsigned long val, struct cpufreq_freqs *ci)
 #endif
 
 
+/* Transition timing, see struct cpufreq_freqs */
+static DEFINE_PER_CPU(ktime_t, cpufreq_decision_time);
+static DEFINE_PER_CPU(ktime_t, cpufreq_prechange_time);
+static DEFINE_PER_CPU(ktime_t, cpufreq_postchange_time);
+
+/**
+ * cpufreq_mark_decision - note that a governor decided to change speed
+ * @policy: the policy to change
+ *
+ * The first decision since the last transition of @policy starts the
+ * decision_us of the next one.
+ */
+void cpufreq_mark_decision(struct cpufreq_policy *policy)
+{
+	unsigned int cpu = policy->cpu;
+
+	if (ktime_to_ns(per_cpu(cpufreq_decision_time, cpu)) <=
+	    ktime_to_ns(per_cpu(cpufreq_postchange_time, cpu)))
+		per_cpu(cpufreq_decision_time, cpu) = ktime_get();
+}
+EXPORT_SYMBOL_GPL(cpufreq_mark_decision);
+
+static void cpufreq_transition_timing(struct cpufreq_policy *policy,
+				      struct cpufreq_freqs *freqs)
+{
+	unsigned int cpu = policy ? policy->cpu : freqs->cpu;
+	ktime_t now = ktime_get();
+	ktime_t pre = per_cpu(cpufreq_prechange_time, freqs->cpu);
+	ktime_t decision = per_cpu(cpufreq_decision_time, cpu);
+
+	freqs->trans_us = ktime_to_us(ktime_sub(now, pre));
+	freqs->decision_us = 0;
+	/* only a decision taken since this cpu's previous transition */
+	if (ktime_to_ns(decision) >
+	    ktime_to_ns(per_cpu(cpufreq_postchange_time, freqs->cpu)) &&
+	    ktime_to_ns(decision) <= ktime_to_ns(pre))
+		freqs->decision_us = ktime_to_us(ktime_sub(pre, decision));
+	per_cpu(cpufreq_postchange_time, freqs->cpu) = now;
+
+	trace_cpu_frequency_latency(freqs->cpu, freqs->old, freqs->new,
+				    freqs->decision_us, freqs->trans_us,
+				    freqs->volt_us, freqs->clk_us);
+}
+
 /**
  * cpufreq_notify_transition - call notifier chain and adjust_jiffies
  * on frequency transition.
@@ -256,6 +300,8 @@ void cpufreq_notify_transition(struct cpufreq_freqs *freqs, unsigned int state)
 				freqs->old = policy->cur;
 			}
 		}
+		freqs->volt_us = freqs->clk_us = 0;
+		per_cpu(cpufreq_prechange_time, freqs->cpu) = ktime_get();
 		srcu_notifier_call_chain(&cpufreq_transition_notifier_list,
 				CPUFREQ_PRECHANGE, freqs);
 		adjust_jiffies(CPUFREQ_PRECHANGE, freqs);
@@ -267,6 +313,7 @@ void cpufreq_notify_transition(struct cpufreq_freqs *freqs, unsigned int state)
 			(unsigned long)freqs->cpu);
 		trace_power_frequency(POWER_PSTATE, freqs->new, freqs->cpu);
 		trace_cpu_frequency(freqs->new, freqs->cpu);
+		cpufreq_transition_timing(policy, freqs);
 		srcu_notifier_call_chain(&cpufreq_transition_notifier_list,
 				CPUFREQ_POSTCHANGE, freqs);
 		if (likely(policy) && likely(policy->cpu == freqs->cpu))
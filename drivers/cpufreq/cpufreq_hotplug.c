@@ -29,6 +29,7 @@
 #include <linux/sched.h>
 #include <linux/err.h>
 #include <linux/slab.h>
+#include <linux/math64.h>
 
 /* greater than 80% avg load across online CPUs increases frequency */
 #define DEFAULT_UP_FREQ_MIN_LOAD			(80)
@@ -48,6 +49,18 @@
 /* default number of sampling periods to average before hotplug-out decision */
 #define DEFAULT_HOTPLUG_OUT_SAMPLING_PERIODS		(20)
 
+/*
+ * more than 1.5 runnable threads on average (in hundredths) over the
+ * hotplug-in periods onlines the auxiliary CPU, and it is only offlined
+ * again once there are less than 0.8 over the hotplug-out periods
+ */
+#define DEFAULT_HOTPLUG_IN_NR_RUNNING			(150)
+#define DEFAULT_HOTPLUG_OUT_NR_RUNNING			(80)
+
+/* minimum time (mSec) to keep the auxiliary CPU online or offline */
+#define DEFAULT_HOTPLUG_MIN_ONLINE_TIME			(500)
+#define DEFAULT_HOTPLUG_MIN_OFFLINE_TIME		(200)
+
 static void do_dbs_timer(struct work_struct *work);
 static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
 		unsigned int event);
@@ -65,6 +78,8 @@ struct cpu_dbs_info_s {
 	cputime64_t prev_cpu_idle;
 	cputime64_t prev_cpu_wall;
 	cputime64_t prev_cpu_nice;
+	u64 prev_nr_running_sum;
+	u64 prev_nr_running_stamp;
 	struct cpufreq_policy *cur_policy;
 	struct delayed_work work;
 	struct cpufreq_frequency_table *freq_table;
@@ -88,6 +103,9 @@ static DEFINE_MUTEX(dbs_mutex);
 
 static struct workqueue_struct	*khotplug_wq;
 
+/* jiffies of the last auxiliary CPU online or offline */
+static unsigned long hotplug_last_change;
+
 static struct dbs_tuners {
 	unsigned int sampling_rate;
 	unsigned int up_threshold;
@@ -97,6 +115,12 @@ static struct dbs_tuners {
 	unsigned int hotplug_out_sampling_periods;
 	unsigned int hotplug_load_index;
 	unsigned int *hotplug_load_history;
+	unsigned int *hotplug_nr_history;
+	unsigned int hotplug_in_nr_running;
+	unsigned int hotplug_out_nr_running;
+	unsigned int hotplug_min_online_time;
+	unsigned int hotplug_min_offline_time;
+	unsigned int hotplug_soft_offline;
 	unsigned int ignore_nice;
 	unsigned int io_is_busy;
 } dbs_tuners_ins = {
@@ -107,6 +131,11 @@ static struct dbs_tuners {
 	.hotplug_in_sampling_periods =	DEFAULT_HOTPLUG_IN_SAMPLING_PERIODS,
 	.hotplug_out_sampling_periods =	DEFAULT_HOTPLUG_OUT_SAMPLING_PERIODS,
 	.hotplug_load_index =		0,
+	.hotplug_in_nr_running =	DEFAULT_HOTPLUG_IN_NR_RUNNING,
+	.hotplug_out_nr_running =	DEFAULT_HOTPLUG_OUT_NR_RUNNING,
+	.hotplug_min_online_time =	DEFAULT_HOTPLUG_MIN_ONLINE_TIME,
+	.hotplug_min_offline_time =	DEFAULT_HOTPLUG_MIN_OFFLINE_TIME,
+	.hotplug_soft_offline =		0,
 	.ignore_nice =			0,
 	.io_is_busy =			0,
 };
@@ -137,6 +166,42 @@ static inline cputime64_t get_cpu_idle_time(unsigned int cpu, cputime64_t *wall)
         return idle_time;
 }
 
+/* has the auxiliary CPU been in its current state for at least ms? */
+static inline bool hotplug_settled(unsigned int ms)
+{
+	return time_after_eq(jiffies, hotplug_last_change +
+			     msecs_to_jiffies(ms));
+}
+
+/* cpus taking work: online and not soft offline */
+static inline unsigned int hotplug_nr_cpus(void)
+{
+	return num_online_cpus() - num_soft_offline_cpus();
+}
+
+/*
+ * With hotplug_soft_offline the auxiliary CPU is only parked by the
+ * scheduler: it stays online in deep idle and comes back in an IPI,
+ * instead of the cpu_up() notifier chain and secondary boot.
+ */
+static int hotplug_cpu_up(void)
+{
+	if (cpu_is_soft_offline(1)) {
+		sched_cpu_soft_online(1);
+		return 0;
+	}
+
+	return cpu_up(1);
+}
+
+static int hotplug_cpu_down(void)
+{
+	if (dbs_tuners_ins.hotplug_soft_offline)
+		return sched_cpu_soft_offline(1);
+
+	return cpu_down(1);
+}
+
 /************************** sysfs interface ************************/
 
 /* XXX look at global sysfs macros in cpufreq.h, can those be used here? */
@@ -154,6 +219,11 @@ show_one(down_differential, down_differential);
 show_one(down_threshold, down_threshold);
 show_one(hotplug_in_sampling_periods, hotplug_in_sampling_periods);
 show_one(hotplug_out_sampling_periods, hotplug_out_sampling_periods);
+show_one(hotplug_in_nr_running, hotplug_in_nr_running);
+show_one(hotplug_out_nr_running, hotplug_out_nr_running);
+show_one(hotplug_min_online_time, hotplug_min_online_time);
+show_one(hotplug_min_offline_time, hotplug_min_offline_time);
+show_one(hotplug_soft_offline, hotplug_soft_offline);
 show_one(ignore_nice_load, ignore_nice);
 show_one(io_is_busy, io_is_busy);
 
@@ -226,11 +296,37 @@ static ssize_t store_down_threshold(struct kobject *a, struct attribute *b,
 	return count;
 }
 
+/* grow the history buffers to input periods, called with dbs_mutex held */
+static int dbs_resize_history(unsigned int input, unsigned int max_windows)
+{
+	unsigned int *load, *nr;
+
+	load = kmalloc((sizeof(unsigned int) * input), GFP_KERNEL);
+	nr = kmalloc((sizeof(unsigned int) * input), GFP_KERNEL);
+	if (!load || !nr) {
+		kfree(load);
+		kfree(nr);
+		return -ENOMEM;
+	}
+
+	memcpy(load, dbs_tuners_ins.hotplug_load_history,
+			(max_windows * sizeof(unsigned int)));
+	memcpy(nr, dbs_tuners_ins.hotplug_nr_history,
+			(max_windows * sizeof(unsigned int)));
+	kfree(dbs_tuners_ins.hotplug_load_history);
+	kfree(dbs_tuners_ins.hotplug_nr_history);
+
+	/* replace old buffers & old index */
+	dbs_tuners_ins.hotplug_load_history = load;
+	dbs_tuners_ins.hotplug_nr_history = nr;
+	dbs_tuners_ins.hotplug_load_index = max_windows;
+	return 0;
+}
+
 static ssize_t store_hotplug_in_sampling_periods(struct kobject *a,
 		struct attribute *b, const char *buf, size_t count)
 {
 	unsigned int input;
-	unsigned int *temp;
 	unsigned int max_windows;
 	int ret;
 	ret = sscanf(buf, "%u", &input);
@@ -254,21 +350,11 @@ static ssize_t store_hotplug_in_sampling_periods(struct kobject *a,
 	}
 
 	/* resize array */
-	temp = kmalloc((sizeof(unsigned int) * input), GFP_KERNEL);
-
-	if (!temp || IS_ERR(temp)) {
+	if (dbs_resize_history(input, max_windows)) {
 		ret = -ENOMEM;
 		goto out;
 	}
-
-	memcpy(temp, dbs_tuners_ins.hotplug_load_history,
-			(max_windows * sizeof(unsigned int)));
-	kfree(dbs_tuners_ins.hotplug_load_history);
-
-	/* replace old buffer, old number of sampling periods & old index */
-	dbs_tuners_ins.hotplug_load_history = temp;
 	dbs_tuners_ins.hotplug_in_sampling_periods = input;
-	dbs_tuners_ins.hotplug_load_index = max_windows;
 out:
 	mutex_unlock(&dbs_mutex);
 
@@ -279,7 +365,6 @@ static ssize_t store_hotplug_out_sampling_periods(struct kobject *a,
 		struct attribute *b, const char *buf, size_t count)
 {
 	unsigned int input;
-	unsigned int *temp;
 	unsigned int max_windows;
 	int ret;
 	ret = sscanf(buf, "%u", &input);
@@ -303,27 +388,102 @@ static ssize_t store_hotplug_out_sampling_periods(struct kobject *a,
 	}
 
 	/* resize array */
-	temp = kmalloc((sizeof(unsigned int) * input), GFP_KERNEL);
-
-	if (!temp || IS_ERR(temp)) {
+	if (dbs_resize_history(input, max_windows)) {
 		ret = -ENOMEM;
 		goto out;
 	}
-
-	memcpy(temp, dbs_tuners_ins.hotplug_load_history,
-			(max_windows * sizeof(unsigned int)));
-	kfree(dbs_tuners_ins.hotplug_load_history);
-
-	/* replace old buffer, old number of sampling periods & old index */
-	dbs_tuners_ins.hotplug_load_history = temp;
 	dbs_tuners_ins.hotplug_out_sampling_periods = input;
-	dbs_tuners_ins.hotplug_load_index = max_windows;
 out:
 	mutex_unlock(&dbs_mutex);
 
 	return ret;
 }
 
+static ssize_t store_hotplug_in_nr_running(struct kobject *a,
+		struct attribute *b, const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+
+	/* 0 disables the runqueue input, otherwise keep the hysteresis */
+	if (ret != 1 || (input &&
+			 input <= dbs_tuners_ins.hotplug_out_nr_running))
+		return -EINVAL;
+
+	mutex_lock(&dbs_mutex);
+	dbs_tuners_ins.hotplug_in_nr_running = input;
+	mutex_unlock(&dbs_mutex);
+
+	return count;
+}
+
+static ssize_t store_hotplug_out_nr_running(struct kobject *a,
+		struct attribute *b, const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+
+	if (ret != 1 || (dbs_tuners_ins.hotplug_in_nr_running &&
+			 input >= dbs_tuners_ins.hotplug_in_nr_running))
+		return -EINVAL;
+
+	mutex_lock(&dbs_mutex);
+	dbs_tuners_ins.hotplug_out_nr_running = input;
+	mutex_unlock(&dbs_mutex);
+
+	return count;
+}
+
+static ssize_t store_hotplug_min_online_time(struct kobject *a,
+		struct attribute *b, const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&dbs_mutex);
+	dbs_tuners_ins.hotplug_min_online_time = input;
+	mutex_unlock(&dbs_mutex);
+
+	return count;
+}
+
+static ssize_t store_hotplug_min_offline_time(struct kobject *a,
+		struct attribute *b, const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&dbs_mutex);
+	dbs_tuners_ins.hotplug_min_offline_time = input;
+	mutex_unlock(&dbs_mutex);
+
+	return count;
+}
+
+static ssize_t store_hotplug_soft_offline(struct kobject *a,
+		struct attribute *b, const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&dbs_mutex);
+	dbs_tuners_ins.hotplug_soft_offline = !!input;
+	mutex_unlock(&dbs_mutex);
+
+	return count;
+}
+
 static ssize_t store_ignore_nice_load(struct kobject *a, struct attribute *b,
 				      const char *buf, size_t count)
 {
@@ -384,6 +544,11 @@ define_one_global_rw(down_differential);
 define_one_global_rw(down_threshold);
 define_one_global_rw(hotplug_in_sampling_periods);
 define_one_global_rw(hotplug_out_sampling_periods);
+define_one_global_rw(hotplug_in_nr_running);
+define_one_global_rw(hotplug_out_nr_running);
+define_one_global_rw(hotplug_min_online_time);
+define_one_global_rw(hotplug_min_offline_time);
+define_one_global_rw(hotplug_soft_offline);
 define_one_global_rw(ignore_nice_load);
 define_one_global_rw(io_is_busy);
 
@@ -394,6 +559,11 @@ static struct attribute *dbs_attributes[] = {
 	&down_threshold.attr,
 	&hotplug_in_sampling_periods.attr,
 	&hotplug_out_sampling_periods.attr,
+	&hotplug_in_nr_running.attr,
+	&hotplug_out_nr_running.attr,
+	&hotplug_min_online_time.attr,
+	&hotplug_min_offline_time.attr,
+	&hotplug_soft_offline.attr,
 	&ignore_nice_load.attr,
 	&io_is_busy.attr,
 	NULL
@@ -419,6 +589,10 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	/* average load across multiple sampling periods for hotplug events */
 	unsigned int hotplug_in_avg_load = 0;
 	unsigned int hotplug_out_avg_load = 0;
+	/* runnable threads on all enabled CPUs, in hundredths */
+	unsigned int nr_running = 0;
+	unsigned int hotplug_in_avg_nr = 0;
+	unsigned int hotplug_out_avg_nr = 0;
 	/* number of sampling periods averaged for hotplug decisions */
 	unsigned int periods;
 
@@ -435,10 +609,21 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 		unsigned int load;
 		unsigned int idle_time, wall_time;
 		cputime64_t cur_wall_time, cur_idle_time;
+		u64 nr_sum, nr_stamp;
 		struct cpu_dbs_info_s *j_dbs_info;
 
 		j_dbs_info = &per_cpu(hp_cpu_dbs_info, j);
 
+		/* average runqueue depth since the last iteration */
+		nr_sum = sched_get_nr_running_sum(j, &nr_stamp);
+		if (nr_stamp > j_dbs_info->prev_nr_running_stamp)
+			nr_running += div64_u64((nr_sum -
+					j_dbs_info->prev_nr_running_sum) * 100,
+					nr_stamp -
+					j_dbs_info->prev_nr_running_stamp);
+		j_dbs_info->prev_nr_running_sum = nr_sum;
+		j_dbs_info->prev_nr_running_stamp = nr_stamp;
+
 		/* update both cur_idle_time and cur_wall_time */
 		cur_idle_time = get_cpu_idle_time(j, &cur_wall_time);
 
@@ -455,6 +640,10 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 		if (unlikely(!wall_time || wall_time < idle_time))
 			continue;
 
+		/* parked, its idle says nothing about the load */
+		if (cpu_is_soft_offline(j))
+			continue;
+
 		/* load is the percentage of time not spent in idle */
 		load = 100 * (wall_time - idle_time) / wall_time;
 
@@ -470,7 +659,7 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	max_load_freq = max_load * policy->cur;
 
 	/* calculate the average load across all related CPUs */
-	avg_load = total_load / num_online_cpus();
+	avg_load = total_load / hotplug_nr_cpus();
 
 
 	/*
@@ -485,16 +674,24 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	/* store avg_load in the circular buffer */
 	dbs_tuners_ins.hotplug_load_history[dbs_tuners_ins.hotplug_load_index]
 		= avg_load;
+	dbs_tuners_ins.hotplug_nr_history[dbs_tuners_ins.hotplug_load_index]
+		= nr_running;
 
 	/* compute average load across in & out sampling periods */
 	for (i = 0, j = dbs_tuners_ins.hotplug_load_index;
 			i < periods; i++, j--) {
-		if (i < dbs_tuners_ins.hotplug_in_sampling_periods)
+		if (i < dbs_tuners_ins.hotplug_in_sampling_periods) {
 			hotplug_in_avg_load +=
 				dbs_tuners_ins.hotplug_load_history[j];
-		if (i < dbs_tuners_ins.hotplug_out_sampling_periods)
+			hotplug_in_avg_nr +=
+				dbs_tuners_ins.hotplug_nr_history[j];
+		}
+		if (i < dbs_tuners_ins.hotplug_out_sampling_periods) {
 			hotplug_out_avg_load +=
 				dbs_tuners_ins.hotplug_load_history[j];
+			hotplug_out_avg_nr +=
+				dbs_tuners_ins.hotplug_nr_history[j];
+		}
 
 		if (j == 0)
 			j = periods;
@@ -506,21 +703,31 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	hotplug_out_avg_load = hotplug_out_avg_load /
 		dbs_tuners_ins.hotplug_out_sampling_periods;
 
+	hotplug_in_avg_nr = hotplug_in_avg_nr /
+		dbs_tuners_ins.hotplug_in_sampling_periods;
+
+	hotplug_out_avg_nr = hotplug_out_avg_nr /
+		dbs_tuners_ins.hotplug_out_sampling_periods;
+
 	/* return to first element if we're at the circular buffer's end */
 	if (++dbs_tuners_ins.hotplug_load_index == periods)
 		dbs_tuners_ins.hotplug_load_index = 0;
 
-	/* check if auxiliary CPU is needed based on avg_load */
-	if (avg_load > dbs_tuners_ins.up_threshold) {
+	/* check if auxiliary CPU is needed based on avg_load or runqueue */
+	if ((avg_load > dbs_tuners_ins.up_threshold &&
+	     hotplug_in_avg_load > dbs_tuners_ins.up_threshold) ||
+	    (dbs_tuners_ins.hotplug_in_nr_running &&
+	     hotplug_in_avg_nr > dbs_tuners_ins.hotplug_in_nr_running)) {
 		/* should we enable auxillary CPUs? */
-		if (num_online_cpus() < 2 && hotplug_in_avg_load >
-				dbs_tuners_ins.up_threshold) {
+		if (hotplug_nr_cpus() < 2 &&
+		    hotplug_settled(dbs_tuners_ins.hotplug_min_offline_time)) {
 			/* hotplug with cpufreq is nasty
 			 * a call to cpufreq_governor_dbs may cause a lockup.
 			 * wq is not running here so its safe.
 			 */
 			mutex_unlock(&this_dbs_info->timer_mutex);
-			cpu_up(1);
+			if (!hotplug_cpu_up())
+				hotplug_last_change = jiffies;
 			mutex_lock(&this_dbs_info->timer_mutex);
 			goto out;
 		}
@@ -540,11 +747,22 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	if (avg_load < dbs_tuners_ins.down_threshold) {
 		/* are we at the minimum frequency already? */
 		if (policy->cur == policy->min) {
-			/* should we disable auxillary CPUs? */
-			if (num_online_cpus() > 1 && hotplug_out_avg_load <
-					dbs_tuners_ins.down_threshold) {
+			/*
+			 * should we disable auxillary CPUs?  Not while the
+			 * scheduler packs tasks: idle they cost no more.
+			 */
+			if (hotplug_nr_cpus() > 1 &&
+			    !sched_pack_tasks_enabled() &&
+			    hotplug_out_avg_load <
+					dbs_tuners_ins.down_threshold &&
+			    (!dbs_tuners_ins.hotplug_in_nr_running ||
+			     hotplug_out_avg_nr <
+					dbs_tuners_ins.hotplug_out_nr_running) &&
+			    hotplug_settled(
+					dbs_tuners_ins.hotplug_min_online_time)) {
 				mutex_unlock(&this_dbs_info->timer_mutex);
-				cpu_down(1);
+				if (!hotplug_cpu_down())
+					hotplug_last_change = jiffies;
 				mutex_lock(&this_dbs_info->timer_mutex);
 			}
 			goto out;
@@ -588,6 +806,41 @@ static void do_dbs_timer(struct work_struct *work)
 	mutex_unlock(&dbs_info->timer_mutex);
 }
 
+#ifdef CONFIG_CPU_FREQ_GOV_HOTPLUG
+static void dbs_boost_work_fn(struct work_struct *work)
+{
+	if (dbs_enable && hotplug_nr_cpus() < 2 && !hotplug_cpu_up())
+		hotplug_last_change = jiffies;
+}
+
+static DECLARE_WORK(dbs_boost_work, dbs_boost_work_fn);
+
+/**
+ * cpufreq_hotplug_boost - online the auxiliary CPU ahead of a boost
+ *
+ * Called by the input/launch boost path, which knows of the load before
+ * the sampling windows do.  The CPU is onlined from a work, or unparked
+ * at once if soft offline, regardless of the minimum offline time, and
+ * then stays online for at least the minimum online time.  Only
+ * available when the governor is built in, as its callers are.
+ */
+void cpufreq_hotplug_boost(void)
+{
+	if (!dbs_enable || hotplug_nr_cpus() >= 2)
+		return;
+
+	/* a parked CPU comes back right here, no need for the work */
+	if (cpu_is_soft_offline(1)) {
+		sched_cpu_soft_online(1);
+		hotplug_last_change = jiffies;
+		return;
+	}
+
+	queue_work(khotplug_wq, &dbs_boost_work);
+}
+EXPORT_SYMBOL_GPL(cpufreq_hotplug_boost);
+#endif
+
 static inline void dbs_timer_init(struct cpu_dbs_info_s *dbs_info)
 {
 	/* We want all related CPUs to do sampling nearly on same jiffy */
@@ -638,12 +891,24 @@ static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
 			dbs_tuners_ins.hotplug_load_history = kmalloc(
 					(sizeof(unsigned int) * max_periods),
 					GFP_KERNEL);
-			if (!dbs_tuners_ins.hotplug_load_history) {
+			dbs_tuners_ins.hotplug_nr_history = kmalloc(
+					(sizeof(unsigned int) * max_periods),
+					GFP_KERNEL);
+			if (!dbs_tuners_ins.hotplug_load_history ||
+			    !dbs_tuners_ins.hotplug_nr_history) {
 				WARN_ON(1);
+				kfree(dbs_tuners_ins.hotplug_load_history);
+				kfree(dbs_tuners_ins.hotplug_nr_history);
+				mutex_unlock(&dbs_mutex);
 				return -ENOMEM;
 			}
-			for (i = 0; i < max_periods; i++)
+			for (i = 0; i < max_periods; i++) {
 				dbs_tuners_ins.hotplug_load_history[i] = 50;
+				dbs_tuners_ins.hotplug_nr_history[i] = 100;
+			}
+			j_dbs_info->prev_nr_running_sum =
+				sched_get_nr_running_sum(j,
+					&j_dbs_info->prev_nr_running_stamp);
 		}
 		this_dbs_info->cpu = cpu;
 		this_dbs_info->freq_table = cpufreq_frequency_get_table(cpu);
@@ -668,6 +933,10 @@ static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
 	case CPUFREQ_GOV_STOP:
 		dbs_timer_exit(this_dbs_info);
 
+		/* other governors know nothing of parked cpus */
+		if (cpu_is_soft_offline(1))
+			sched_cpu_soft_online(1);
+
 		mutex_lock(&dbs_mutex);
 		mutex_destroy(&this_dbs_info->timer_mutex);
 		dbs_enable--;
@@ -676,6 +945,7 @@ static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
 			sysfs_remove_group(cpufreq_global_kobject,
 					   &dbs_attr_group);
 		kfree(dbs_tuners_ins.hotplug_load_history);
+		kfree(dbs_tuners_ins.hotplug_nr_history);
 		/*
 		 * XXX BIG CAVEAT: Stopping the governor with CPU1 offline
 		 * will result in it remaining offline until the user onlines
@@ -29,6 +29,7 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/input.h>
+#include <linux/math64.h>
 #include <asm/cputime.h>
 
 #define CREATE_TRACE_POINTS
@@ -53,6 +54,10 @@ struct cpufreq_interactive_cpuinfo {
 	unsigned int floor_freq;
 	u64 floor_validate_time;
 	u64 hispeed_validate_time;
+	u64 nr_run_sum;
+	u64 nr_run_stamp;
+	u64 target_set_nr_run_sum;
+	u64 target_set_nr_run_stamp;
 	int governor_enabled;
 };
 
@@ -75,6 +80,23 @@ static u64 hispeed_freq;
 #define DEFAULT_GO_HISPEED_LOAD 85
 static unsigned long go_hispeed_load;
 
+/*
+ * Target load for each frequency range: "load freq:load freq:load ...",
+ * the load applying from its preceding freq up to the next one.
+ */
+#define DEFAULT_TARGET_LOAD 90
+static unsigned int default_target_loads[] = {DEFAULT_TARGET_LOAD};
+static spinlock_t target_loads_lock;
+static unsigned int *target_loads = default_target_loads;
+static int ntarget_loads = ARRAY_SIZE(default_target_loads);
+
+/*
+ * Non-zero means take load from the scheduler's runqueue length instead
+ * of idle time, so that tasks waiting to run count beyond 100%.
+ */
+static int sched_load_val;
+#define MAX_SCHED_LOAD 1000
+
 /*
  * The minimum amount of time to spend at a frequency before we can ramp down.
  */
@@ -126,6 +148,103 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 	.owner = THIS_MODULE,
 };
 
+/* Start a new short-term load sample for cpu */
+static void cpufreq_interactive_start_sample(
+	struct cpufreq_interactive_cpuinfo *pcpu, unsigned int cpu)
+{
+	pcpu->time_in_idle = get_cpu_idle_time_us(cpu, &pcpu->idle_exit_time);
+	if (sched_load_val)
+		pcpu->nr_run_sum = sched_get_nr_running_sum(cpu,
+						&pcpu->nr_run_stamp);
+}
+
+static unsigned int freq_to_targetload(unsigned int freq)
+{
+	int i;
+	unsigned int ret;
+	unsigned long flags;
+
+	spin_lock_irqsave(&target_loads_lock, flags);
+
+	for (i = 0; i < ntarget_loads - 1 && freq >= target_loads[i+1]; i += 2)
+		;
+
+	ret = target_loads[i];
+	spin_unlock_irqrestore(&target_loads_lock, flags);
+	return ret;
+}
+
+/*
+ * Find the lowest frequency at which the load, scaled from the current
+ * frequency, would not exceed that frequency's target load.  loadadjfreq
+ * is the load at the current frequency times that frequency.  Target
+ * loads need not be monotonic, so search until the choice is stable,
+ * narrowing [freqmin, freqmax] to keep from oscillating.
+ */
+static unsigned int choose_freq(struct cpufreq_interactive_cpuinfo *pcpu,
+				unsigned int loadadjfreq)
+{
+	unsigned int freq = pcpu->target_freq;
+	unsigned int prevfreq, freqmin = 0, freqmax = UINT_MAX;
+	unsigned int index;
+
+	do {
+		prevfreq = freq;
+
+		if (cpufreq_frequency_table_target(pcpu->policy,
+				pcpu->freq_table,
+				loadadjfreq / freq_to_targetload(freq),
+				CPUFREQ_RELATION_L, &index))
+			break;
+		freq = pcpu->freq_table[index].frequency;
+
+		if (freq > prevfreq) {
+			/* prevfreq is too slow */
+			freqmin = prevfreq;
+			if (freq >= freqmax) {
+				if (cpufreq_frequency_table_target(pcpu->policy,
+						pcpu->freq_table, freqmax - 1,
+						CPUFREQ_RELATION_H, &index))
+					break;
+				freq = pcpu->freq_table[index].frequency;
+				/* already tried the one below freqmax */
+				if (freq == freqmin) {
+					freq = freqmax;
+					break;
+				}
+			}
+		} else if (freq < prevfreq) {
+			/* prevfreq is fast enough */
+			freqmax = prevfreq;
+			if (freq <= freqmin) {
+				if (cpufreq_frequency_table_target(pcpu->policy,
+						pcpu->freq_table, freqmin + 1,
+						CPUFREQ_RELATION_L, &index))
+					break;
+				freq = pcpu->freq_table[index].frequency;
+				/* the one above freqmin is freqmax */
+				if (freq == freqmax)
+					break;
+			}
+		}
+	} while (freq != prevfreq);
+
+	return freq;
+}
+
+/* Average runqueue length of cpu since a sample, in percent */
+static int sched_load_since(unsigned int cpu, u64 nr_run_sum, u64 stamp)
+{
+	u64 now, sum = sched_get_nr_running_sum(cpu, &now);
+	u64 load;
+
+	if (now <= stamp)
+		return 0;
+
+	load = div64_u64((sum - nr_run_sum) * 100, now - stamp);
+	return min_t(u64, load, MAX_SCHED_LOAD);
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	unsigned int delta_idle;
@@ -138,6 +257,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 		&per_cpu(cpuinfo, data);
 	u64 now_idle;
 	unsigned int new_freq;
+	unsigned int loadadjfreq;
 	unsigned int index;
 	unsigned long flags;
 
@@ -195,14 +315,24 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 * started or timer function re-armed itself) or long-term load
 	 * (since last frequency change).
 	 */
+	if (sched_load_val) {
+		cpu_load = sched_load_since(data, pcpu->nr_run_sum,
+					    pcpu->nr_run_stamp);
+		load_since_change = sched_load_since(data,
+					pcpu->target_set_nr_run_sum,
+					pcpu->target_set_nr_run_stamp);
+	}
+
 	if (load_since_change > cpu_load)
 		cpu_load = load_since_change;
 
+	loadadjfreq = (unsigned int) cpu_load * pcpu->target_freq;
+
 	if (cpu_load >= go_hispeed_load || boost_val) {
 		if (pcpu->target_freq <= pcpu->policy->min) {
 			new_freq = hispeed_freq;
 		} else {
-			new_freq = pcpu->policy->max * cpu_load / 100;
+			new_freq = choose_freq(pcpu, loadadjfreq);
 
 			if (new_freq < hispeed_freq)
 				new_freq = hispeed_freq;
@@ -219,7 +349,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 			}
 		}
 	} else {
-		new_freq = pcpu->policy->max * cpu_load / 100;
+		new_freq = choose_freq(pcpu, loadadjfreq);
 	}
 
 	if (new_freq <= hispeed_freq)
@@ -262,6 +392,10 @@ static void cpufreq_interactive_timer(unsigned long data)
 					 new_freq);
 	pcpu->target_set_time_in_idle = now_idle;
 	pcpu->target_set_time = pcpu->timer_run_time;
+	cpufreq_mark_decision(pcpu->policy);
+	if (sched_load_val)
+		pcpu->target_set_nr_run_sum = sched_get_nr_running_sum(data,
+					&pcpu->target_set_nr_run_stamp);
 
 	if (new_freq < pcpu->target_freq) {
 		pcpu->target_freq = new_freq;
@@ -301,8 +435,7 @@ rearm:
 			pcpu->timer_idlecancel = 1;
 		}
 
-		pcpu->time_in_idle = get_cpu_idle_time_us(
-			data, &pcpu->idle_exit_time);
+		cpufreq_interactive_start_sample(pcpu, data);
 		mod_timer(&pcpu->cpu_timer,
 			  jiffies + usecs_to_jiffies(timer_rate));
 	}
@@ -335,8 +468,8 @@ static void cpufreq_interactive_idle_start(void)
 		 * the CPUFreq driver.
 		 */
 		if (!pending) {
-			pcpu->time_in_idle = get_cpu_idle_time_us(
-				smp_processor_id(), &pcpu->idle_exit_time);
+			cpufreq_interactive_start_sample(pcpu,
+							 smp_processor_id());
 			pcpu->timer_idlecancel = 0;
 			mod_timer(&pcpu->cpu_timer,
 				  jiffies + usecs_to_jiffies(timer_rate));
@@ -385,9 +518,7 @@ static void cpufreq_interactive_idle_end(void)
 	if (timer_pending(&pcpu->cpu_timer) == 0 &&
 	    pcpu->timer_run_time >= pcpu->idle_exit_time &&
 	    pcpu->governor_enabled) {
-		pcpu->time_in_idle =
-			get_cpu_idle_time_us(smp_processor_id(),
-					     &pcpu->idle_exit_time);
+		cpufreq_interactive_start_sample(pcpu, smp_processor_id());
 		pcpu->timer_idlecancel = 0;
 		mod_timer(&pcpu->cpu_timer,
 			  jiffies + usecs_to_jiffies(timer_rate));
@@ -646,6 +777,104 @@ static struct global_attr hispeed_freq_attr = __ATTR(hispeed_freq, 0644,
 		show_hispeed_freq, store_hispeed_freq);
 
 
+static ssize_t show_target_loads(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	int i;
+	ssize_t ret = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&target_loads_lock, flags);
+
+	for (i = 0; i < ntarget_loads; i++)
+		ret += sprintf(buf + ret, "%u%s", target_loads[i],
+			       i & 0x1 ? ":" : " ");
+
+	buf[ret - 1] = '\n';
+	spin_unlock_irqrestore(&target_loads_lock, flags);
+	return ret;
+}
+
+static ssize_t store_target_loads(struct kobject *kobj,
+				  struct attribute *attr, const char *buf,
+				  size_t count)
+{
+	const char *cp;
+	unsigned int *new_target_loads, *old_target_loads;
+	int ntokens = 1;
+	int i;
+	unsigned long flags;
+
+	for (cp = buf; (cp = strpbrk(cp + 1, " :")); ntokens++)
+		;
+
+	/* loads and frequencies alternate, starting and ending with a load */
+	if (!(ntokens & 0x1))
+		return -EINVAL;
+
+	new_target_loads = kmalloc(ntokens * sizeof(unsigned int), GFP_KERNEL);
+	if (!new_target_loads)
+		return -ENOMEM;
+
+	cp = buf;
+	for (i = 0; i < ntokens; i++) {
+		if (sscanf(cp, "%u", &new_target_loads[i]) != 1 ||
+		    (!(i & 0x1) && !new_target_loads[i])) {
+			kfree(new_target_loads);
+			return -EINVAL;
+		}
+
+		cp = strpbrk(cp, " :");
+		if (!cp)
+			break;
+		cp++;
+	}
+
+	spin_lock_irqsave(&target_loads_lock, flags);
+	old_target_loads = target_loads;
+	target_loads = new_target_loads;
+	ntarget_loads = ntokens;
+	spin_unlock_irqrestore(&target_loads_lock, flags);
+
+	if (old_target_loads != default_target_loads)
+		kfree(old_target_loads);
+	return count;
+}
+
+static struct global_attr target_loads_attr = __ATTR(target_loads, 0644,
+		show_target_loads, store_target_loads);
+
+static ssize_t show_sched_load(struct kobject *kobj, struct attribute *attr,
+			       char *buf)
+{
+	return sprintf(buf, "%d\n", sched_load_val);
+}
+
+static ssize_t store_sched_load(struct kobject *kobj, struct attribute *attr,
+				const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+	unsigned int j;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	/* restart the long-term samples in the new unit */
+	for_each_online_cpu(j) {
+		struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, j);
+
+		pcpu->nr_run_sum = pcpu->target_set_nr_run_sum =
+			sched_get_nr_running_sum(j, &pcpu->nr_run_stamp);
+		pcpu->target_set_nr_run_stamp = pcpu->nr_run_stamp;
+	}
+	sched_load_val = !!val;
+	return count;
+}
+
+define_one_global_rw(sched_load);
+
 static ssize_t show_go_hispeed_load(struct kobject *kobj,
 				     struct attribute *attr, char *buf)
 {
@@ -806,6 +1035,8 @@ static struct global_attr boostpulse =
 static struct attribute *interactive_attributes[] = {
 	&hispeed_freq_attr.attr,
 	&go_hispeed_load_attr.attr,
+	&target_loads_attr.attr,
+	&sched_load.attr,
 	&above_hispeed_delay.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
@@ -852,6 +1083,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 				pcpu->target_set_time;
 			pcpu->hispeed_validate_time =
 				pcpu->target_set_time;
+			pcpu->target_set_nr_run_sum =
+				sched_get_nr_running_sum(j,
+					&pcpu->target_set_nr_run_stamp);
 			pcpu->governor_enabled = 1;
 			smp_wmb();
 		}
@@ -975,6 +1209,7 @@ static int __init cpufreq_interactive_init(void)
 
 	spin_lock_init(&up_cpumask_lock);
 	spin_lock_init(&down_cpumask_lock);
+	spin_lock_init(&target_loads_lock);
 	mutex_init(&set_speed_lock);
 
 	idle_notifier_register(&cpufreq_interactive_idle_nb);
@@ -20,6 +20,12 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
 #include <asm/cputime.h>
 
 static spinlock_t cpufreq_stats_lock;
@@ -41,9 +47,27 @@ struct cpufreq_stats {
 	unsigned int *freq_table;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	unsigned int *trans_table;
+	struct cpufreq_trans_latency *trans_latency;
 #endif
 };
 
+#ifdef CONFIG_CPU_FREQ_STAT_DETAILS
+/* latency buckets: < 128us, < 256us, ... < 8192us, >= 8192us */
+#define CPUFREQ_LAT_BUCKETS	8
+#define CPUFREQ_LAT_SHIFT	7
+
+/* timing of the transitions between one pair of frequencies, in us */
+struct cpufreq_trans_latency {
+	unsigned int count;
+	unsigned int max_us;
+	u64 decision_us;
+	u64 trans_us;
+	u64 volt_us;
+	u64 clk_us;
+	unsigned int hist[CPUFREQ_LAT_BUCKETS];
+};
+#endif
+
 static DEFINE_PER_CPU(struct cpufreq_stats *, cpufreq_stats_table);
 
 struct cpufreq_stats_attribute {
@@ -51,6 +75,205 @@ struct cpufreq_stats_attribute {
 	ssize_t(*show) (struct cpufreq_stats *, char *);
 };
 
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+/*
+ * Per-UID time in state.  Every CPU charges the time since its last
+ * context switch or frequency change, at the frequency it ran at, to the
+ * UID of the task that ran.  The per-cpu state is only shared with the
+ * frequency transition notifier, so the hot path takes no global lock;
+ * the UID entries are never freed, so a task's entry can be cached in
+ * its user_struct.
+ */
+#define CPUFREQ_UID_MAX_FREQS	16
+#define CPUFREQ_UID_HASH_BITS	7
+#define CPUFREQ_UID_VERSION	1
+
+struct cpufreq_uid_stats {
+	struct hlist_node node;
+	uid_t uid;
+	atomic64_t time_in_state[CPUFREQ_UID_MAX_FREQS];	/* ns */
+};
+
+struct cpufreq_uid_cpu {
+	raw_spinlock_t lock;
+	struct cpufreq_uid_stats *cur;
+	u64 stamp;
+	int index;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_uid_cpu, cpufreq_uid_cpu) = {
+	.lock = __RAW_SPIN_LOCK_UNLOCKED(cpufreq_uid_cpu.lock),
+	.index = -1,
+};
+
+/* frequencies of all policies; only grows, under cpufreq_uid_mutex */
+static unsigned int cpufreq_uid_freqs[CPUFREQ_UID_MAX_FREQS];
+static unsigned int cpufreq_uid_nr_freqs;
+
+static struct hlist_head cpufreq_uid_hash[1 << CPUFREQ_UID_HASH_BITS];
+static DEFINE_MUTEX(cpufreq_uid_mutex);
+
+/**
+ * cpufreq_uid_stats_get - find or create the time in state entry of a UID
+ * @uid: the UID
+ *
+ * Called when the user_struct of @uid is created.  Returns NULL if out
+ * of memory, in which case the UID's time goes unaccounted.
+ */
+struct cpufreq_uid_stats *cpufreq_uid_stats_get(uid_t uid)
+{
+	struct hlist_head *head;
+	struct hlist_node *pos;
+	struct cpufreq_uid_stats *uid_stats;
+
+	head = &cpufreq_uid_hash[hash_32(uid, CPUFREQ_UID_HASH_BITS)];
+	mutex_lock(&cpufreq_uid_mutex);
+	hlist_for_each_entry(uid_stats, pos, head, node)
+		if (uid_stats->uid == uid)
+			goto out;
+
+	uid_stats = kzalloc(sizeof(*uid_stats), GFP_KERNEL);
+	if (uid_stats) {
+		uid_stats->uid = uid;
+		hlist_add_head(&uid_stats->node, head);
+	}
+out:
+	mutex_unlock(&cpufreq_uid_mutex);
+	return uid_stats;
+}
+
+static int cpufreq_uid_freq_index(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < cpufreq_uid_nr_freqs; i++)
+		if (cpufreq_uid_freqs[i] == freq)
+			return i;
+	return -1;
+}
+
+/* Locking: c->lock */
+static void cpufreq_uid_charge(struct cpufreq_uid_cpu *c, u64 now)
+{
+	if (c->cur && c->index >= 0 && now > c->stamp)
+		atomic64_add(now - c->stamp, &c->cur->time_in_state[c->index]);
+	c->stamp = now;
+}
+
+/**
+ * cpufreq_uid_task_switch - charge the outgoing task's UID
+ * @next: the task being switched in
+ *
+ * Called by the scheduler with the runqueue lock held and interrupts
+ * off.  The idle task is charged to nobody.
+ */
+void cpufreq_uid_task_switch(struct task_struct *next)
+{
+	struct cpufreq_uid_cpu *c = &__get_cpu_var(cpufreq_uid_cpu);
+	const struct cred *cred;
+
+	raw_spin_lock(&c->lock);
+	cpufreq_uid_charge(c, cpu_clock(smp_processor_id()));
+	/* next holds a reference to its own cred */
+	cred = rcu_dereference_protected(next->real_cred, 1);
+	c->cur = next->pid ? cred->user->cpufreq_stats : NULL;
+	raw_spin_unlock(&c->lock);
+}
+
+static void cpufreq_uid_freq_change(unsigned int cpu, unsigned int freq)
+{
+	struct cpufreq_uid_cpu *c = &per_cpu(cpufreq_uid_cpu, cpu);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&c->lock, flags);
+	cpufreq_uid_charge(c, cpu_clock(cpu));
+	c->index = cpufreq_uid_freq_index(freq);
+	raw_spin_unlock_irqrestore(&c->lock, flags);
+}
+
+static void cpufreq_uid_add_policy(struct cpufreq_policy *policy,
+				   struct cpufreq_stats *stat)
+{
+	unsigned int cpu;
+	int i;
+
+	mutex_lock(&cpufreq_uid_mutex);
+	for (i = 0; i < stat->state_num; i++) {
+		if (cpufreq_uid_freq_index(stat->freq_table[i]) >= 0)
+			continue;
+		if (cpufreq_uid_nr_freqs == CPUFREQ_UID_MAX_FREQS) {
+			pr_warn("cpufreq_stats: no uid slot for %u KHz\n",
+				stat->freq_table[i]);
+			continue;
+		}
+		cpufreq_uid_freqs[cpufreq_uid_nr_freqs] = stat->freq_table[i];
+		smp_wmb();
+		cpufreq_uid_nr_freqs++;
+	}
+	mutex_unlock(&cpufreq_uid_mutex);
+
+	for_each_cpu(cpu, policy->cpus)
+		cpufreq_uid_freq_change(cpu, policy->cur);
+}
+
+/*
+ * Binary, native endian: u32 version, u32 nr_freqs, u32 freqs[nr_freqs]
+ * in KHz, then for each UID u32 uid, u32 padding and u64 ns[nr_freqs].
+ */
+static int uid_time_in_state_show(struct seq_file *m, void *v)
+{
+	struct cpufreq_uid_stats *uid_stats;
+	struct hlist_node *pos;
+	u32 hdr[2], pad = 0;
+	u64 ns;
+	int i, j;
+
+	mutex_lock(&cpufreq_uid_mutex);
+	hdr[0] = CPUFREQ_UID_VERSION;
+	hdr[1] = cpufreq_uid_nr_freqs;
+	seq_write(m, hdr, sizeof(hdr));
+	seq_write(m, cpufreq_uid_freqs, hdr[1] * sizeof(u32));
+	for (i = 0; i < ARRAY_SIZE(cpufreq_uid_hash); i++) {
+		hlist_for_each_entry(uid_stats, pos, &cpufreq_uid_hash[i],
+				     node) {
+			seq_write(m, &uid_stats->uid, sizeof(u32));
+			seq_write(m, &pad, sizeof(pad));
+			for (j = 0; j < hdr[1]; j++) {
+				ns = atomic64_read(&uid_stats->time_in_state[j]);
+				seq_write(m, &ns, sizeof(ns));
+			}
+		}
+	}
+	mutex_unlock(&cpufreq_uid_mutex);
+	return 0;
+}
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_time_in_state_show, NULL);
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init cpufreq_uid_init(void)
+{
+	/* the only user_struct not created by alloc_uid() */
+	root_user.cpufreq_stats = cpufreq_uid_stats_get(0);
+	proc_create("uid_time_in_state", 0444, NULL, &uid_time_in_state_fops);
+}
+#else
+static inline void cpufreq_uid_freq_change(unsigned int cpu,
+					   unsigned int freq) { }
+static inline void cpufreq_uid_add_policy(struct cpufreq_policy *policy,
+					  struct cpufreq_stats *stat) { }
+static inline void cpufreq_uid_init(void) { }
+#endif
+
 static int cpufreq_stats_update(unsigned int cpu)
 {
 	struct cpufreq_stats *stat;
@@ -138,6 +361,75 @@ static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 	return len;
 }
 CPUFREQ_STATDEVICE_ATTR(trans_table, 0444, show_trans_table);
+
+static void cpufreq_stats_record_latency(struct cpufreq_trans_latency *lat,
+					 struct cpufreq_freqs *freq)
+{
+	unsigned int total = freq->decision_us + freq->trans_us;
+	int bucket = 0;
+
+	while (bucket < CPUFREQ_LAT_BUCKETS - 1 &&
+	       total >= (1U << (CPUFREQ_LAT_SHIFT + bucket)))
+		bucket++;
+
+	lat->count++;
+	lat->max_us = max(lat->max_us, total);
+	lat->decision_us += freq->decision_us;
+	lat->trans_us += freq->trans_us;
+	lat->volt_us += freq->volt_us;
+	lat->clk_us += freq->clk_us;
+	lat->hist[bucket]++;
+}
+
+static ssize_t show_trans_latency(struct cpufreq_policy *policy, char *buf)
+{
+	ssize_t len = 0;
+	int i, j, b;
+
+	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, policy->cpu);
+	if (!stat || !stat->trans_latency)
+		return 0;
+	len += snprintf(buf + len, PAGE_SIZE - len,
+			"from to count avg_decision avg_trans avg_volt "
+			"avg_clk max hist(<%u..>=%u)\n",
+			1U << CPUFREQ_LAT_SHIFT,
+			1U << (CPUFREQ_LAT_SHIFT + CPUFREQ_LAT_BUCKETS - 2));
+	spin_lock(&cpufreq_stats_lock);
+	for (i = 0; i < stat->state_num; i++) {
+		for (j = 0; j < stat->state_num; j++) {
+			struct cpufreq_trans_latency *lat =
+				&stat->trans_latency[i * stat->max_state + j];
+
+			if (!lat->count)
+				continue;
+			if (len >= PAGE_SIZE)
+				break;
+			len += snprintf(buf + len, PAGE_SIZE - len,
+					"%u %u %u %llu %llu %llu %llu %u",
+					stat->freq_table[i],
+					stat->freq_table[j], lat->count,
+					div_u64(lat->decision_us, lat->count),
+					div_u64(lat->trans_us, lat->count),
+					div_u64(lat->volt_us, lat->count),
+					div_u64(lat->clk_us, lat->count),
+					lat->max_us);
+			for (b = 0; b < CPUFREQ_LAT_BUCKETS; b++) {
+				if (len >= PAGE_SIZE)
+					break;
+				len += snprintf(buf + len, PAGE_SIZE - len,
+						" %u", lat->hist[b]);
+			}
+			if (len >= PAGE_SIZE)
+				break;
+			len += snprintf(buf + len, PAGE_SIZE - len, "\n");
+		}
+	}
+	spin_unlock(&cpufreq_stats_lock);
+	if (len >= PAGE_SIZE)
+		return PAGE_SIZE;
+	return len;
+}
+CPUFREQ_STATDEVICE_ATTR(trans_latency, 0444, show_trans_latency);
 #endif
 
 CPUFREQ_STATDEVICE_ATTR(total_trans, 0444, show_total_trans);
@@ -148,6 +440,7 @@ static struct attribute *default_attrs[] = {
 	&_attr_time_in_state.attr,
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	&_attr_trans_table.attr,
+	&_attr_trans_latency.attr,
 #endif
 	NULL
 };
@@ -172,6 +465,9 @@ static void cpufreq_stats_free_table(unsigned int cpu)
 {
 	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, cpu);
 	if (stat) {
+#ifdef CONFIG_CPU_FREQ_STAT_DETAILS
+		kfree(stat->trans_latency);
+#endif
 		kfree(stat->time_in_state);
 		kfree(stat);
 	}
@@ -239,6 +535,9 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stat->trans_table = stat->freq_table + count;
+	/* optional: the stats work without it */
+	stat->trans_latency = kzalloc(count * count *
+				sizeof(struct cpufreq_trans_latency), GFP_KERNEL);
 #endif
 	j = 0;
 	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
@@ -253,6 +552,7 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	stat->last_time = get_jiffies_64();
 	stat->last_index = freq_table_get_index(stat, policy->cur);
 	spin_unlock(&cpufreq_stats_lock);
+	cpufreq_uid_add_policy(data, stat);
 	cpufreq_cpu_put(data);
 	return 0;
 error_out:
@@ -291,6 +591,8 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	if (val != CPUFREQ_POSTCHANGE)
 		return 0;
 
+	cpufreq_uid_freq_change(freq->cpu, freq->new);
+
 	stat = per_cpu(cpufreq_stats_table, freq->cpu);
 	if (!stat)
 		return 0;
@@ -311,6 +613,9 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	stat->last_index = new_index;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stat->trans_table[old_index * stat->max_state + new_index]++;
+	if (stat->trans_latency)
+		cpufreq_stats_record_latency(&stat->trans_latency[old_index *
+					     stat->max_state + new_index], freq);
 #endif
 	stat->total_trans++;
 	spin_unlock(&cpufreq_stats_lock);
@@ -384,6 +689,7 @@ static int __init cpufreq_stats_init(void)
 	unsigned int cpu;
 
 	spin_lock_init(&cpufreq_stats_lock);
+	cpufreq_uid_init();
 	ret = cpufreq_register_notifier(&notifier_policy_block,
 				CPUFREQ_POLICY_NOTIFIER);
 	if (ret)
@@ -90,7 +90,11 @@ struct omap_aes_reqctx {
 	unsigned long mode;
 };
 
-#define OMAP_AES_QUEUE_LENGTH	1
+/*
+ * dm-crypt keeps issuing requests until one is backlogged and then waits
+ * for it, so a short queue serialises it on the engine.
+ */
+#define OMAP_AES_QUEUE_LENGTH	64
 #define OMAP_AES_CACHE_SIZE	0
 
 struct omap_aes_dev {
@@ -644,6 +648,8 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 static void omap_aes_done_task(unsigned long data)
 {
 	struct omap_aes_dev *dd = (struct omap_aes_dev *)data;
+	struct ablkcipher_request *req = dd->req;
+	unsigned long flags;
 	int err;
 
 	pr_debug("enter\n");
@@ -658,9 +664,19 @@ static void omap_aes_done_task(unsigned long data)
 			return; /* DMA started. Not fininishing. */
 	}
 
-	omap_aes_finish_req(dd, err);
+	/*
+	 * Start the next queued request before completing this one, so the
+	 * engine runs while the caller handles the completion, and the clock
+	 * stays enabled across back to back requests.
+	 */
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->flags &= ~FLAGS_BUSY;
+	spin_unlock_irqrestore(&dd->lock, flags);
 	omap_aes_handle_queue(dd, NULL);
 
+	clk_disable(dd->iclk);
+	req->base.complete(&req->base, err);
+
 	pr_debug("exit\n");
 }
 
@@ -22,6 +22,9 @@
 #include <linux/slab.h>
 #include <linux/pm_runtime.h>
 #include <linux/bitops.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <mach/hardware.h>
 #include <asm/irq.h>
@@ -59,6 +62,12 @@ struct gpio_regs {
 	u32 pad_set_wakeupenable;
 };
 
+struct gpio_irq_latency {
+	u32 count;
+	u32 max_ns;
+	u64 total_ns;
+};
+
 struct gpio_bank {
 	struct list_head node;
 	unsigned long pbase;
@@ -99,6 +108,10 @@ struct gpio_bank {
 	struct omap_gpio_reg_offs *regs;
 
 	struct omap_mux *mux[32];
+
+#ifdef CONFIG_GPIO_OMAP_IRQ_LATENCY
+	struct gpio_irq_latency irq_latency[32];
+#endif
 };
 
 #define OMAP4_IOMUX_WAKEUPEVENT_MASK	0x8000
@@ -647,24 +660,53 @@ static void omap_gpio_free(struct gpio_chip *chip, unsigned offset)
 	spin_unlock_irqrestore(&bank->lock, flags);
 }
 
+#ifdef CONFIG_GPIO_OMAP_IRQ_LATENCY
 /*
- * We need to unmask the GPIO bank interrupt as soon as possible to
- * avoid missing GPIO interrupts for other lines in the bank.
- * Then we need to mask-read-clear-unmask the triggered GPIO lines
- * in the bank to avoid missing nested interrupts for a GPIO line.
- * If we wait to unmask individual GPIO lines in the bank after the
- * line's interrupt handler has been run, we may miss some nested
- * interrupts.
+ * Time from bank interrupt entry to the dispatch of each GPIO's handler,
+ * per GPIO, in /sys/kernel/debug/omap_gpio_irq_latency.
+ */
+static inline void gpio_irq_latency_add(struct gpio_bank *bank, int index,
+					ktime_t entry)
+{
+	struct gpio_irq_latency *lat = &bank->irq_latency[index];
+	u32 ns = ktime_to_ns(ktime_sub(ktime_get(), entry));
+
+	lat->count++;
+	lat->total_ns += ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+}
+#else
+static inline void gpio_irq_latency_add(struct gpio_bank *bank, int index,
+					ktime_t entry)
+{
+}
+#endif
+
+/*
+ * The bank status is read once.  Edge sensitive lines are acked for the
+ * whole bank with a single write before their handlers run, so an edge
+ * arriving meanwhile latches again and re-raises the bank interrupt; no
+ * second pass over the status is needed and gpio_ack_irq() leaves them
+ * alone.  If the bank has only edge sensitive lines pending, the bank
+ * interrupt is unmasked right away.  Level sensitive lines are masked and
+ * cleared through their irq_chip after their handler has run, so the bank
+ * interrupt stays masked until then to avoid spurious bank interrupts.
  */
 static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 {
-	void __iomem *isr_reg = NULL;
-	u32 isr;
-	unsigned int gpio_irq, gpio_index;
+	struct irq_chip *chip = irq_desc_get_chip(desc);
 	struct gpio_bank *bank;
-	u32 retrigger = 0;
+	u32 isr, enabled, level_mask = 0;
+	unsigned int gpio_irq, gpio_index;
 	int unmasked = 0;
-	struct irq_chip *chip = irq_desc_get_chip(desc);
+	ktime_t entry;
+
+#ifdef CONFIG_GPIO_OMAP_IRQ_LATENCY
+	entry = ktime_get();
+#else
+	entry.tv64 = 0;
+#endif
 
 	chained_irq_enter(chip, desc);
 
@@ -672,71 +714,51 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 
 	pm_runtime_get_sync(bank->dev);
 
-	isr_reg = bank->base + bank->regs->irqstatus;
-
-	if (WARN_ON(!isr_reg))
+	if (WARN_ON(!bank->regs->irqstatus))
 		goto exit;
 
-	while(1) {
-		u32 isr_saved, level_mask = 0;
-		u32 enabled;
-
-		enabled = _get_gpio_irqbank_mask(bank);
-
-		if (bank->width == 32)
-			isr = __raw_readl(isr_reg) & enabled;
-		else if (bank->width == 16)
-			isr = (__raw_readw(isr_reg) & enabled) & 0x0000ffff;
-		isr_saved = isr;
-
-		if (bank->regs->leveldetect0)
-			level_mask = bank->level_mask & enabled;
-
-		/* clear edge sensitive interrupts before handler(s) are
-		called so that we don't miss any interrupt occurred while
-		executing them */
-		_disable_gpio_irqbank(bank, isr_saved & ~level_mask);
-		_clear_gpio_irqbank(bank, isr_saved & ~level_mask);
-		_enable_gpio_irqbank(bank, isr_saved & ~level_mask);
-
-		/* if there is only edge sensitive GPIO pin interrupts
-		configured, we could unmask GPIO bank interrupt immediately */
-		if (!level_mask && !unmasked) {
-			unmasked = 1;
-			chained_irq_exit(chip, desc);
-		}
+	enabled = _get_gpio_irqbank_mask(bank);
 
-		isr |= retrigger;
-		retrigger = 0;
-		if (!isr)
-			break;
+	if (bank->width == 32)
+		isr = __raw_readl(bank->base + bank->regs->irqstatus);
+	else
+		isr = __raw_readw(bank->base + bank->regs->irqstatus);
+	isr &= enabled;
 
-		gpio_irq = bank->virtual_irq_start;
-		for (; isr != 0; isr >>= 1, gpio_irq++) {
-			gpio_index = GPIO_INDEX(bank, irq_to_gpio(gpio_irq));
+	if (bank->regs->leveldetect0)
+		level_mask = bank->level_mask & enabled;
 
-			if (!(isr & 1))
-				continue;
+	if (isr & ~level_mask)
+		_clear_gpio_irqbank(bank, isr & ~level_mask);
+
+	if (!(isr & level_mask)) {
+		unmasked = 1;
+		chained_irq_exit(chip, desc);
+	}
+
+	while (isr) {
+		int bit = __ffs(isr);
+
+		isr &= ~(1 << bit);
+		gpio_irq = bank->virtual_irq_start + bit;
+		gpio_index = GPIO_INDEX(bank, irq_to_gpio(gpio_irq));
 
 #ifdef CONFIG_ARCH_OMAP1
-			/*
-			 * Some chips can't respond to both rising and falling
-			 * at the same time.  If this irq was requested with
-			 * both flags, we need to flip the ICR data for the IRQ
-			 * to respond to the IRQ for the opposite direction.
-			 * This will be indicated in the bank toggle_mask.
-			 */
-			if (bank->toggle_mask & (1 << gpio_index))
-				_toggle_gpio_edge_triggering(bank, gpio_index);
+		/*
+		 * Some chips can't respond to both rising and falling
+		 * at the same time.  If this irq was requested with
+		 * both flags, we need to flip the ICR data for the IRQ
+		 * to respond to the IRQ for the opposite direction.
+		 * This will be indicated in the bank toggle_mask.
+		 */
+		if (bank->toggle_mask & (1 << gpio_index))
+			_toggle_gpio_edge_triggering(bank, gpio_index);
 #endif
 
-			generic_handle_irq(gpio_irq);
-		}
+		gpio_irq_latency_add(bank, bit, entry);
+		generic_handle_irq(gpio_irq);
 	}
-	/* if bank has any level sensitive GPIO pin interrupt
-	configured, we must unmask the bank interrupt only after
-	handler(s) are executed in order to avoid spurious bank
-	interrupt */
+
 exit:
 	if (!unmasked)
 		chained_irq_exit(chip, desc);
@@ -760,6 +782,11 @@ static void gpio_ack_irq(struct irq_data *d)
 	unsigned int gpio = d->irq - IH_GPIO_BASE;
 	struct gpio_bank *bank = irq_data_get_irq_chip_data(d);
 
+	/* edge status was acked for the whole bank by gpio_irq_handler() */
+	if (bank->regs->leveldetect0 &&
+	    !(bank->level_mask & GPIO_BIT(bank, gpio)))
+		return;
+
 	_clear_gpio_irqstatus(bank, gpio);
 }
 
@@ -1802,3 +1829,47 @@ static int __init omap_gpio_drv_reg(void)
 }
 postcore_initcall(omap_gpio_drv_reg);
 
+#ifdef CONFIG_GPIO_OMAP_IRQ_LATENCY
+static int gpio_irq_latency_show(struct seq_file *s, void *unused)
+{
+	struct gpio_bank *bank;
+	int i;
+
+	seq_printf(s, "gpio       count     avg_ns     max_ns\n");
+	list_for_each_entry(bank, &omap_gpio_list, node) {
+		for (i = 0; i < bank->width; i++) {
+			struct gpio_irq_latency lat = bank->irq_latency[i];
+
+			if (!lat.count)
+				continue;
+			seq_printf(s, "%4d  %10u %10llu %10u\n",
+				   bank->chip.base + i, lat.count,
+				   div_u64(lat.total_ns, lat.count),
+				   lat.max_ns);
+		}
+	}
+
+	return 0;
+}
+
+static int gpio_irq_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gpio_irq_latency_show, NULL);
+}
+
+static const struct file_operations gpio_irq_latency_fops = {
+	.open		= gpio_irq_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init omap_gpio_irq_latency_init(void)
+{
+	debugfs_create_file("omap_gpio_irq_latency", S_IRUGO, NULL, NULL,
+			    &gpio_irq_latency_fops);
+	return 0;
+}
+late_initcall(omap_gpio_irq_latency_init);
+#endif
+
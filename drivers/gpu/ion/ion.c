@@ -89,16 +89,25 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	return buffer;
 }
 
+void ion_buffer_free(struct ion_buffer *buffer)
+{
+	buffer->heap->ops->free(buffer);
+	kfree(buffer);
+}
+
 static void ion_buffer_destroy(struct kref *kref)
 {
 	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
 	struct ion_device *dev = buffer->dev;
 
-	buffer->heap->ops->free(buffer);
 	mutex_lock(&dev->lock);
 	rb_erase(&buffer->node, &dev->buffers);
 	mutex_unlock(&dev->lock);
-	kfree(buffer);
+
+	if (buffer->heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		ion_heap_freelist_add(buffer->heap, buffer);
+	else
+		ion_buffer_free(buffer);
 }
 
 static void ion_buffer_get(struct ion_buffer *buffer)
@@ -238,6 +247,33 @@ static void ion_handle_add(struct ion_client *client, struct ion_handle *handle)
 	rb_insert_color(&handle->node, &client->handles);
 }
 
+static void ion_alloc_stats_add(struct ion_alloc_stats *stats, s64 us,
+				bool failed)
+{
+	int bucket = min_t(int, us > 0 ? fls64(us) : 0,
+			   ION_ALLOC_TIME_BUCKETS - 1);
+
+	spin_lock(&stats->lock);
+	if (failed)
+		stats->failures++;
+	else
+		stats->allocs++;
+	stats->time[bucket]++;
+	spin_unlock(&stats->lock);
+}
+
+void ion_alloc_account(struct ion_client *client, struct ion_heap *heap,
+		       ktime_t start, bool failed)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	if (client)
+		ion_alloc_stats_add(&client->stats, us, failed);
+	if (heap)
+		ion_alloc_stats_add(&heap->stats, us, failed);
+}
+EXPORT_SYMBOL(ion_alloc_account);
+
 struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 			     size_t align, unsigned int flags)
 {
@@ -245,6 +281,7 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 	struct ion_handle *handle;
 	struct ion_device *dev = client->dev;
 	struct ion_buffer *buffer = NULL;
+	ktime_t start = ktime_get(), heap_start;
 
 	/*
 	 * traverse the list of heaps available in this system in priority
@@ -261,12 +298,19 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 		/* if the caller didn't specify this heap ID */
 		if (!((1 << heap->id) & flags))
 			continue;
+		heap_start = ktime_get();
 		buffer = ion_buffer_create(heap, dev, len, align, flags);
+		if (len)
+			ion_alloc_account(NULL, heap, heap_start,
+					  IS_ERR_OR_NULL(buffer));
 		if (!IS_ERR_OR_NULL(buffer))
 			break;
 	}
 	mutex_unlock(&dev->lock);
 
+	if (len)
+		ion_alloc_account(client, NULL, start, IS_ERR_OR_NULL(buffer));
+
 	if (IS_ERR_OR_NULL(buffer))
 		return ERR_PTR(PTR_ERR(buffer));
 
@@ -585,6 +629,44 @@ end:
 }
 EXPORT_SYMBOL(ion_import_fd);
 
+/* Upper bound of the time under which pct percent of allocations took */
+static unsigned int ion_alloc_time_pct(u32 *time, u32 total, int pct)
+{
+	u64 n = 0;
+	int i;
+
+	for (i = 0; i < ION_ALLOC_TIME_BUCKETS - 1; i++) {
+		n += time[i];
+		if (n * 100 >= (u64)total * pct)
+			break;
+	}
+
+	return 1U << i;
+}
+
+static void ion_debug_alloc_stats_show(struct seq_file *s,
+				       struct ion_alloc_stats *stats)
+{
+	u32 time[ION_ALLOC_TIME_BUCKETS];
+	u32 allocs, failures, total;
+
+	spin_lock(&stats->lock);
+	allocs = stats->allocs;
+	failures = stats->failures;
+	memcpy(time, stats->time, sizeof(time));
+	spin_unlock(&stats->lock);
+
+	total = allocs + failures;
+	seq_printf(s, "%16.16s: %16u\n", "allocations", allocs);
+	seq_printf(s, "%16.16s: %16u\n", "failures", failures);
+	if (!total)
+		return;
+	seq_printf(s, "%16.16s: %13u us\n", "p50 time <",
+		   ion_alloc_time_pct(time, total, 50));
+	seq_printf(s, "%16.16s: %13u us\n", "p99 time <",
+		   ion_alloc_time_pct(time, total, 99));
+}
+
 static int ion_debug_client_show(struct seq_file *s, void *unused)
 {
 	struct ion_client *client = s->private;
@@ -612,6 +694,9 @@ static int ion_debug_client_show(struct seq_file *s, void *unused)
 		seq_printf(s, "%16.16s: %16u %d\n", names[i], sizes[i],
 			   atomic_read(&client->ref.refcount));
 	}
+
+	seq_printf(s, "\n");
+	ion_debug_alloc_stats_show(s, &client->stats);
 	return 0;
 }
 
@@ -694,6 +779,7 @@ struct ion_client *ion_client_create(struct ion_device *dev,
 	client->dev = dev;
 	client->handles = RB_ROOT;
 	mutex_init(&client->lock);
+	spin_lock_init(&client->stats.lock);
 	client->name = name;
 	client->heap_mask = heap_mask;
 	client->task = task;
@@ -1210,6 +1296,14 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 		seq_printf(s, "%16.s %16u %16u\n", client->name, client->pid,
 			   size);
 	}
+
+	seq_printf(s, "\n");
+	ion_debug_alloc_stats_show(s, &heap->stats);
+	if (heap->ops->largest_free)
+		seq_printf(s, "%16.16s: %16u\n", "largest free",
+			   heap->ops->largest_free(heap));
+	if (heap->ops->debug_show)
+		heap->ops->debug_show(heap, s);
 	return 0;
 }
 
@@ -1232,6 +1326,10 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 	struct ion_heap *entry;
 
 	heap->dev = dev;
+	spin_lock_init(&heap->stats.lock);
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		ion_heap_init_deferred_free(heap);
+
 	mutex_lock(&dev->lock);
 	while (*p) {
 		parent = *p;
@@ -16,11 +16,14 @@
 #include <linux/spinlock.h>
 
 #include <linux/err.h>
-#include <linux/genalloc.h>
 #include <linux/io.h>
 #include <linux/ion.h>
+#include <linux/log2.h>
 #include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/rbtree.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
@@ -28,24 +31,189 @@
 #include <asm/mach/map.h>
 #include <asm/cacheflush.h>
 
+/*
+ * Free space is kept as a list of free blocks per power of two size class
+ * for best-fit lookups, plus an rbtree by address so that a freed buffer
+ * merges with its neighbours.  Allocations the client marks as long lived
+ * are carved from the top of their block and short lived ones from the
+ * bottom, so buffers that stay around end up packed together instead of
+ * pinning small holes all over the carveout.
+ */
+#define ION_CARVEOUT_ORDERS	16	/* size classes, 4K up to 128M and up */
+
+struct ion_carveout_block {
+	struct rb_node node;
+	struct list_head list;
+	ion_phys_addr_t addr;
+	unsigned long size;
+};
+
 struct ion_carveout_heap {
 	struct ion_heap heap;
-	struct gen_pool *pool;
+	struct mutex lock;
+	struct rb_root free_root;
+	struct list_head free_list[ION_CARVEOUT_ORDERS];
+	unsigned long free_size;
+	unsigned long free_blocks;
+	unsigned long alloc_fail;
 	ion_phys_addr_t base;
+	unsigned long size;
 };
 
-ion_phys_addr_t ion_carveout_allocate(struct ion_heap *heap,
-				      unsigned long size,
-				      unsigned long align)
+static int ion_carveout_order(unsigned long size)
+{
+	int order = ilog2(size >> PAGE_SHIFT);
+
+	return min(order, ION_CARVEOUT_ORDERS - 1);
+}
+
+static void ion_carveout_list_block(struct ion_carveout_heap *carveout_heap,
+				    struct ion_carveout_block *block)
+{
+	list_add(&block->list,
+		 &carveout_heap->free_list[ion_carveout_order(block->size)]);
+}
+
+static void ion_carveout_insert_block(struct ion_carveout_heap *carveout_heap,
+				      struct ion_carveout_block *block)
+{
+	struct rb_node **p = &carveout_heap->free_root.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*p) {
+		struct ion_carveout_block *entry;
+
+		parent = *p;
+		entry = rb_entry(parent, struct ion_carveout_block, node);
+		if (block->addr < entry->addr)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+	rb_link_node(&block->node, parent, p);
+	rb_insert_color(&block->node, &carveout_heap->free_root);
+	ion_carveout_list_block(carveout_heap, block);
+	carveout_heap->free_blocks++;
+}
+
+static void ion_carveout_erase_block(struct ion_carveout_heap *carveout_heap,
+				     struct ion_carveout_block *block)
+{
+	list_del(&block->list);
+	rb_erase(&block->node, &carveout_heap->free_root);
+	carveout_heap->free_blocks--;
+	kfree(block);
+}
+
+/* where in @block an allocation would go, or false if it does not fit */
+static bool ion_carveout_fit(struct ion_carveout_block *block,
+			     unsigned long size, unsigned long align,
+			     bool long_lived, ion_phys_addr_t *addr)
+{
+	ion_phys_addr_t end = block->addr + block->size;
+
+	if (block->size < size)
+		return false;
+
+	if (long_lived) {
+		*addr = (end - size) & ~(align - 1);
+		return *addr >= block->addr;
+	}
+
+	*addr = ALIGN(block->addr, align);
+	return *addr + size <= end && *addr >= block->addr;
+}
+
+static ion_phys_addr_t __ion_carveout_allocate(struct ion_heap *heap,
+					       unsigned long size,
+					       unsigned long align,
+					       bool long_lived)
 {
 	struct ion_carveout_heap *carveout_heap =
 		container_of(heap, struct ion_carveout_heap, heap);
-	unsigned long offset = gen_pool_alloc(carveout_heap->pool, size);
+	struct ion_carveout_block *block, *best = NULL, *split;
+	ion_phys_addr_t addr, best_addr = 0, end;
+	int order;
+
+	size = PAGE_ALIGN(size);
+	if (!size)
+		return ION_CARVEOUT_ALLOCATE_FAIL;
+	if (align < PAGE_SIZE || !is_power_of_2(align))
+		align = PAGE_SIZE;
+
+	/* in case the block has to be cut in three */
+	split = kmalloc(sizeof(*split), GFP_KERNEL);
+	if (!split)
+		return ION_CARVEOUT_ALLOCATE_FAIL;
 
-	if (!offset)
+	mutex_lock(&carveout_heap->lock);
+	/*
+	 * The smallest block that fits wins; between blocks of the same size
+	 * the one nearest the end the allocation is placed at.  Only the
+	 * first class can hold blocks that are too small, so once a class
+	 * has a fit no larger one needs looking at.
+	 */
+	for (order = ion_carveout_order(size);
+	     order < ION_CARVEOUT_ORDERS && !best; order++) {
+		list_for_each_entry(block, &carveout_heap->free_list[order],
+				    list) {
+			if (!ion_carveout_fit(block, size, align, long_lived,
+					      &addr))
+				continue;
+			if (best && block->size > best->size)
+				continue;
+			if (best && block->size == best->size &&
+			    (long_lived ? block->addr < best->addr :
+					  block->addr > best->addr))
+				continue;
+			best = block;
+			best_addr = addr;
+		}
+	}
+
+	if (!best) {
+		carveout_heap->alloc_fail++;
+		mutex_unlock(&carveout_heap->lock);
+		kfree(split);
 		return ION_CARVEOUT_ALLOCATE_FAIL;
+	}
+
+	end = best->addr + best->size;
+	list_del(&best->list);
+	if (best_addr + size < end) {
+		if (best_addr > best->addr) {
+			/* keep the head in @best, the tail goes in @split */
+			split->addr = best_addr + size;
+			split->size = end - split->addr;
+			ion_carveout_insert_block(carveout_heap, split);
+			split = NULL;
+			best->size = best_addr - best->addr;
+		} else {
+			/* still sorts between the same neighbours */
+			best->addr = best_addr + size;
+			best->size = end - best->addr;
+		}
+		ion_carveout_list_block(carveout_heap, best);
+	} else if (best_addr > best->addr) {
+		best->size = best_addr - best->addr;
+		ion_carveout_list_block(carveout_heap, best);
+	} else {
+		rb_erase(&best->node, &carveout_heap->free_root);
+		carveout_heap->free_blocks--;
+		kfree(best);
+	}
+	carveout_heap->free_size -= size;
+	mutex_unlock(&carveout_heap->lock);
 
-	return offset;
+	kfree(split);
+	return best_addr;
+}
+
+ion_phys_addr_t ion_carveout_allocate(struct ion_heap *heap,
+				      unsigned long size,
+				      unsigned long align)
+{
+	return __ion_carveout_allocate(heap, size, align, false);
 }
 
 void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
@@ -53,10 +221,62 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
 {
 	struct ion_carveout_heap *carveout_heap =
 		container_of(heap, struct ion_carveout_heap, heap);
+	struct ion_carveout_block *prev = NULL, *next = NULL, *block;
+	struct rb_node *n;
 
 	if (addr == ION_CARVEOUT_ALLOCATE_FAIL)
 		return;
-	gen_pool_free(carveout_heap->pool, addr, size);
+	size = PAGE_ALIGN(size);
+
+	block = kmalloc(sizeof(*block), GFP_KERNEL);
+
+	mutex_lock(&carveout_heap->lock);
+	n = carveout_heap->free_root.rb_node;
+	while (n) {
+		struct ion_carveout_block *entry =
+			rb_entry(n, struct ion_carveout_block, node);
+
+		if (addr < entry->addr) {
+			next = entry;
+			n = n->rb_left;
+		} else {
+			prev = entry;
+			n = n->rb_right;
+		}
+	}
+	if (prev && prev->addr + prev->size != addr)
+		prev = NULL;
+	if (next && addr + size != next->addr)
+		next = NULL;
+
+	if (prev) {
+		list_del(&prev->list);
+		prev->size += size;
+		if (next) {
+			prev->size += next->size;
+			ion_carveout_erase_block(carveout_heap, next);
+		}
+		ion_carveout_list_block(carveout_heap, prev);
+	} else if (next) {
+		list_del(&next->list);
+		next->addr = addr;
+		next->size += size;
+		ion_carveout_list_block(carveout_heap, next);
+	} else if (block) {
+		block->addr = addr;
+		block->size = size;
+		ion_carveout_insert_block(carveout_heap, block);
+		block = NULL;
+	} else {
+		pr_err("%s: lost %lu bytes at %lx, out of memory\n",
+		       __func__, size, addr);
+		mutex_unlock(&carveout_heap->lock);
+		return;
+	}
+	carveout_heap->free_size += size;
+	mutex_unlock(&carveout_heap->lock);
+
+	kfree(block);
 }
 
 static int ion_carveout_heap_phys(struct ion_heap *heap,
@@ -73,7 +293,8 @@ static int ion_carveout_heap_allocate(struct ion_heap *heap,
 				      unsigned long size, unsigned long align,
 				      unsigned long flags)
 {
-	buffer->priv_phys = ion_carveout_allocate(heap, size, align);
+	buffer->priv_phys = __ion_carveout_allocate(heap, size, align,
+						    flags & ION_FLAG_LONG_LIVED);
 	return buffer->priv_phys == ION_CARVEOUT_ALLOCATE_FAIL ? -ENOMEM : 0;
 }
 
@@ -165,6 +386,71 @@ int ion_carveout_heap_inval_user(struct ion_buffer *buffer, size_t len,
 	return ion_carveout_heap_cache_operation(buffer, len,
 			vaddr, CACHE_INVALIDATE);
 }
+
+static unsigned long
+ion_carveout_largest_free(struct ion_carveout_heap *carveout_heap)
+{
+	struct ion_carveout_block *block;
+	unsigned long largest = 0;
+	int order;
+
+	for (order = ION_CARVEOUT_ORDERS - 1; order >= 0 && !largest; order--)
+		list_for_each_entry(block, &carveout_heap->free_list[order],
+				    list)
+			largest = max(largest, block->size);
+
+	return largest;
+}
+
+static size_t ion_carveout_heap_largest_free(struct ion_heap *heap)
+{
+	struct ion_carveout_heap *carveout_heap =
+		container_of(heap, struct ion_carveout_heap, heap);
+	unsigned long largest;
+
+	mutex_lock(&carveout_heap->lock);
+	largest = ion_carveout_largest_free(carveout_heap);
+	mutex_unlock(&carveout_heap->lock);
+
+	return largest;
+}
+
+static void ion_carveout_heap_debug_show(struct ion_heap *heap,
+					 struct seq_file *s)
+{
+	struct ion_carveout_heap *carveout_heap =
+		container_of(heap, struct ion_carveout_heap, heap);
+	unsigned long count[ION_CARVEOUT_ORDERS];
+	unsigned long free_size, free_blocks, largest, alloc_fail;
+	struct ion_carveout_block *block;
+	int order;
+
+	mutex_lock(&carveout_heap->lock);
+	for (order = 0; order < ION_CARVEOUT_ORDERS; order++) {
+		count[order] = 0;
+		list_for_each_entry(block, &carveout_heap->free_list[order],
+				    list)
+			count[order]++;
+	}
+	free_size = carveout_heap->free_size;
+	free_blocks = carveout_heap->free_blocks;
+	alloc_fail = carveout_heap->alloc_fail;
+	largest = ion_carveout_largest_free(carveout_heap);
+	mutex_unlock(&carveout_heap->lock);
+
+	seq_printf(s, "%16.16s: %16lu\n", "carveout size", carveout_heap->size);
+	seq_printf(s, "%16.16s: %16lu\n", "free", free_size);
+	seq_printf(s, "%16.16s: %16lu\n", "free blocks", free_blocks);
+	/* how much of the free space a single allocation cannot use */
+	seq_printf(s, "%16.16s: %15lu%%\n", "fragmentation",
+		   free_size ? 100 - largest * 100 / free_size : 0);
+	seq_printf(s, "%16.16s: %16lu\n", "alloc failures", alloc_fail);
+	for (order = 0; order < ION_CARVEOUT_ORDERS; order++)
+		if (count[order])
+			seq_printf(s, "%9luK blocks: %16lu\n",
+				   (PAGE_SIZE << order) / 1024, count[order]);
+}
+
 static struct ion_heap_ops carveout_heap_ops = {
 	.allocate = ion_carveout_heap_allocate,
 	.free = ion_carveout_heap_free,
@@ -174,24 +460,40 @@ static struct ion_heap_ops carveout_heap_ops = {
 	.inval_user = ion_carveout_heap_inval_user,
 	.map_kernel = ion_carveout_heap_map_kernel,
 	.unmap_kernel = ion_carveout_heap_unmap_kernel,
+	.largest_free = ion_carveout_heap_largest_free,
+	.debug_show = ion_carveout_heap_debug_show,
 };
 
 struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *heap_data)
 {
 	struct ion_carveout_heap *carveout_heap;
+	struct ion_carveout_block *block;
+	int i;
 
 	carveout_heap = kzalloc(sizeof(struct ion_carveout_heap), GFP_KERNEL);
 	if (!carveout_heap)
 		return ERR_PTR(-ENOMEM);
 
-	carveout_heap->pool = gen_pool_create(12, -1);
-	if (!carveout_heap->pool) {
+	block = kzalloc(sizeof(*block), GFP_KERNEL);
+	if (!block) {
 		kfree(carveout_heap);
 		return ERR_PTR(-ENOMEM);
 	}
+	mutex_init(&carveout_heap->lock);
+	carveout_heap->free_root = RB_ROOT;
+	for (i = 0; i < ION_CARVEOUT_ORDERS; i++)
+		INIT_LIST_HEAD(&carveout_heap->free_list[i]);
 	carveout_heap->base = heap_data->base;
-	gen_pool_add(carveout_heap->pool, carveout_heap->base, heap_data->size,
-		     -1);
+	carveout_heap->size = heap_data->size & PAGE_MASK;
+
+	if (carveout_heap->size) {
+		block->addr = carveout_heap->base;
+		block->size = carveout_heap->size;
+		ion_carveout_insert_block(carveout_heap, block);
+		carveout_heap->free_size = block->size;
+	} else {
+		kfree(block);
+	}
 	carveout_heap->heap.ops = &carveout_heap_ops;
 	carveout_heap->heap.type = ION_HEAP_TYPE_CARVEOUT;
 
@@ -202,8 +504,14 @@ void ion_carveout_heap_destroy(struct ion_heap *heap)
 {
 	struct ion_carveout_heap *carveout_heap =
 	     container_of(heap, struct  ion_carveout_heap, heap);
+	struct rb_node *n;
 
-	gen_pool_destroy(carveout_heap->pool);
+	while ((n = rb_first(&carveout_heap->free_root))) {
+		struct ion_carveout_block *block =
+			rb_entry(n, struct ion_carveout_block, node);
+
+		ion_carveout_erase_block(carveout_heap, block);
+	}
 	kfree(carveout_heap);
 	carveout_heap = NULL;
 }
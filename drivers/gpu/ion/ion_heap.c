@@ -15,7 +15,11 @@
  */
 
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
 #include "ion_priv.h"
 
 struct ion_heap *ion_heap_create(struct ion_platform_heap *heap_data)
@@ -70,3 +74,132 @@ void ion_heap_destroy(struct ion_heap *heap)
 		       heap->type);
 	}
 }
+
+/*
+ * The free thread runs at the lowest priority so that buffer teardown
+ * stays out of the way of the frames being produced. The shrinker only
+ * raises it to normal meanwhile and does not free on its own: a heap's
+ * free path can take locks that the allocation entering reclaim holds.
+ */
+#define ION_HEAP_FREE_NICE	19
+
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer)
+{
+	spin_lock(&heap->free_lock);
+	list_add_tail(&buffer->list, &heap->free_list);
+	heap->free_list_size += buffer->size;
+	spin_unlock(&heap->free_lock);
+	wake_up(&heap->waitqueue);
+}
+
+size_t ion_heap_freelist_size(struct ion_heap *heap)
+{
+	size_t size;
+
+	spin_lock(&heap->free_lock);
+	size = heap->free_list_size;
+	spin_unlock(&heap->free_lock);
+
+	return size;
+}
+
+static struct ion_buffer *ion_heap_freelist_get(struct ion_heap *heap)
+{
+	struct ion_buffer *buffer = NULL;
+
+	spin_lock(&heap->free_lock);
+	if (!list_empty(&heap->free_list)) {
+		buffer = list_first_entry(&heap->free_list, struct ion_buffer,
+					  list);
+		list_del(&buffer->list);
+		heap->free_list_size -= buffer->size;
+	}
+	spin_unlock(&heap->free_lock);
+
+	return buffer;
+}
+
+size_t ion_heap_drain_freelist(struct ion_heap *heap)
+{
+	struct ion_buffer *buffer;
+	size_t total = 0;
+
+	if (!(heap->flags & ION_HEAP_FLAG_DEFER_FREE))
+		return 0;
+
+	while ((buffer = ion_heap_freelist_get(heap))) {
+		total += buffer->size;
+		ion_buffer_free(buffer);
+	}
+
+	return total;
+}
+
+static int ion_heap_deferred_free(void *data)
+{
+	struct ion_heap *heap = data;
+	struct ion_buffer *buffer;
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(heap->waitqueue, kthread_should_stop() ||
+				     ion_heap_freelist_size(heap));
+
+		while ((buffer = ion_heap_freelist_get(heap)))
+			ion_buffer_free(buffer);
+
+		set_user_nice(current, ION_HEAP_FREE_NICE);
+	}
+
+	return 0;
+}
+
+static int ion_heap_shrink(struct shrinker *shrinker,
+			   struct shrink_control *sc)
+{
+	struct ion_heap *heap = container_of(shrinker, struct ion_heap,
+					     shrinker);
+	size_t size = ion_heap_freelist_size(heap);
+
+	if (sc->nr_to_scan && size) {
+		set_user_nice(heap->task, 0);
+		wake_up(&heap->waitqueue);
+	}
+
+	return size / PAGE_SIZE;
+}
+
+int ion_heap_init_deferred_free(struct ion_heap *heap)
+{
+	INIT_LIST_HEAD(&heap->free_list);
+	heap->free_list_size = 0;
+	spin_lock_init(&heap->free_lock);
+	init_waitqueue_head(&heap->waitqueue);
+
+	heap->task = kthread_run(ion_heap_deferred_free, heap,
+				 "ion_%s", heap->name);
+	if (IS_ERR(heap->task)) {
+		pr_err("%s: creating thread for deferred free failed\n",
+		       __func__);
+		heap->flags &= ~ION_HEAP_FLAG_DEFER_FREE;
+		return PTR_ERR(heap->task);
+	}
+	set_user_nice(heap->task, ION_HEAP_FREE_NICE);
+
+	heap->shrinker.shrink = ion_heap_shrink;
+	heap->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&heap->shrinker);
+
+	return 0;
+}
+
+void ion_heap_deinit_deferred_free(struct ion_heap *heap)
+{
+	if (!(heap->flags & ION_HEAP_FLAG_DEFER_FREE))
+		return;
+
+	unregister_shrinker(&heap->shrinker);
+	kthread_stop(heap->task);
+	ion_heap_drain_freelist(heap);
+}
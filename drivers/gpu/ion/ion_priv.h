@@ -18,13 +18,40 @@
 #define _ION_PRIV_H
 
 #include <linux/kref.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/mm.h>
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <linux/ion.h>
 #include <linux/miscdevice.h>
 
 struct ion_mapping;
+struct seq_file;
+
+/*
+ * Allocation times are kept as a histogram: bucket i counts allocations
+ * that took less than 2^i microseconds, the last one all slower ones.
+ */
+#define ION_ALLOC_TIME_BUCKETS	20
+
+/**
+ * struct ion_alloc_stats - allocation counters of a heap or a client
+ * @lock:		protects the counters
+ * @allocs:		successful allocations
+ * @failures:		failed allocations
+ * @time:		histogram of the time allocations took
+ */
+struct ion_alloc_stats {
+	spinlock_t lock;
+	u32 allocs;
+	u32 failures;
+	u32 time[ION_ALLOC_TIME_BUCKETS];
+};
 
 struct ion_dma_mapping {
 	struct kref ref;
@@ -66,6 +93,7 @@ struct ion_device {
  * @heap_mask:		mask of all supported heaps
  * @name:		used for debugging
  * @task:		used for debugging
+ * @stats:		allocation counters, shown in debugfs
  *
  * A client represents a list of buffers this client may access.
  * The mutex stored here is used to protect both handles tree
@@ -82,6 +110,7 @@ struct ion_client {
 	struct task_struct *task;
 	pid_t pid;
 	struct dentry *debug_root;
+	struct ion_alloc_stats stats;
 };
 
 /**
@@ -113,6 +142,7 @@ struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
  * struct ion_buffer - metadata for a particular buffer
  * @ref:		refernce count
  * @node:		node in the ion_device buffers tree
+ * @list:		element in the heap's deferred free list
  * @dev:		back pointer to the ion_device
  * @heap:		back pointer to the heap the buffer came from
  * @flags:		buffer specific flags
@@ -130,6 +160,7 @@ struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
 struct ion_buffer {
 	struct kref ref;
 	struct rb_node node;
+	struct list_head list;
 	struct ion_device *dev;
 	struct ion_heap *heap;
 	unsigned long flags;
@@ -159,6 +190,10 @@ struct ion_buffer {
  * @map_user		map memory to userspace
  * @flush_user		flush memory if mapped as cacheable
  * @inval_user		invalidate memory if mapped as cacheable
+ * @largest_free	size of the largest buffer that could currently be
+ *			allocated, for heaps that fragment (optional)
+ * @debug_show		print heap specific state to the heap's debugfs
+ *			file (optional)
  */
 struct ion_heap_ops {
 	int (*allocate) (struct ion_heap *heap,
@@ -178,6 +213,8 @@ struct ion_heap_ops {
 			unsigned long vaddr);
 	int (*inval_user) (struct ion_buffer *buffer, size_t len,
 			unsigned long vaddr);
+	size_t (*largest_free) (struct ion_heap *heap);
+	void (*debug_show) (struct ion_heap *heap, struct seq_file *s);
 };
 
 /**
@@ -190,6 +227,14 @@ struct ion_heap_ops {
  *			allocating.  These are specified by platform data and
  *			MUST be unique
  * @name:		used for debugging
+ * @flags:		ION_HEAP_FLAG_* flags, set by the heap at creation
+ * @free_list:		buffers waiting to be freed, with DEFER_FREE
+ * @free_list_size:	total size of the buffers on free_list
+ * @free_lock:		protects free_list and free_list_size
+ * @waitqueue:		wakes task when buffers are queued
+ * @task:		thread freeing the buffers on free_list
+ * @shrinker:		hurries task along under memory pressure
+ * @stats:		allocation counters, shown in debugfs
  *
  * Represents a pool of memory from which buffers can be made.  In some
  * systems the only heap is regular system memory allocated via vmalloc.
@@ -203,8 +248,22 @@ struct ion_heap {
 	struct ion_heap_ops *ops;
 	int id;
 	const char *name;
+	unsigned long flags;
+	struct list_head free_list;
+	size_t free_list_size;
+	spinlock_t free_lock;
+	wait_queue_head_t waitqueue;
+	struct task_struct *task;
+	struct shrinker shrinker;
+	struct ion_alloc_stats stats;
 };
 
+/*
+ * Buffers of heaps with this flag are freed by a kernel thread instead of
+ * in the context that dropped the last reference to them.
+ */
+#define ION_HEAP_FLAG_DEFER_FREE	(1 << 0)
+
 /**
  * ion_device_create - allocates and returns an ion device
  * @custom_ioctl:	arch specific ioctl function if applicable
@@ -238,6 +297,38 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap);
 struct ion_heap *ion_heap_create(struct ion_platform_heap *);
 void ion_heap_destroy(struct ion_heap *);
 
+/**
+ * ion_alloc_account - count an allocation in the heap and client stats
+ * @client:		the client that allocated, or NULL
+ * @heap:		the heap allocated from, or NULL
+ * @start:		when the allocation started
+ * @failed:		whether it failed
+ *
+ * ion_alloc() does this itself, except for zero-sized allocations: heaps
+ * that allocate through a custom ioctl and only get their handle from
+ * ion_alloc() account for themselves.
+ */
+void ion_alloc_account(struct ion_client *client, struct ion_heap *heap,
+		       ktime_t start, bool failed);
+
+/**
+ * ion_buffer_free - releases a buffer's memory and the buffer itself
+ * @buffer:		the buffer, which no one holds a reference to
+ */
+void ion_buffer_free(struct ion_buffer *buffer);
+
+/**
+ * functions for heaps with ION_HEAP_FLAG_DEFER_FREE. The device sets up
+ * the free thread when the heap is added; ion_heap_drain_freelist frees
+ * queued buffers right away and returns their total size, so that an
+ * allocation failing on space awaiting release can be retried.
+ */
+int ion_heap_init_deferred_free(struct ion_heap *heap);
+void ion_heap_deinit_deferred_free(struct ion_heap *heap);
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer);
+size_t ion_heap_freelist_size(struct ion_heap *heap);
+size_t ion_heap_drain_freelist(struct ion_heap *heap);
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *);
 void ion_system_heap_destroy(struct ion_heap *);
 
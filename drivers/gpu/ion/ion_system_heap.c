@@ -15,31 +15,187 @@
  */
 
 #include <linux/err.h>
+#include <linux/highmem.h>
 #include <linux/ion.h>
+#include <linux/jiffies.h>
 #include <linux/mm.h>
+#include <linux/module.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include "ion_priv.h"
 
+/*
+ * Pages are kept in a pool so that allocations, graphics buffers coming
+ * and going at every app transition in particular, need not go to the
+ * page allocator nor zero pages. Freed pages are zeroed again by a
+ * worker, which also tops the pool up to pool_refill pages unless the
+ * shrinker asked for memory back recently. Beyond ION_POOL_MAX pages,
+ * freed pages go straight back to the system.
+ */
+static int ion_pool_refill_pages;
+module_param_named(pool_refill, ion_pool_refill_pages, int, 0644);
+MODULE_PARM_DESC(pool_refill, "Zeroed pages to keep ready for allocations");
+
+#define ION_POOL_MAX		4096
+#define ION_POOL_REFILL_HOLDOFF	(5 * HZ)
+#define ION_POOL_GFP		(GFP_KERNEL | __GFP_HIGHMEM)
+
+struct ion_system_heap {
+	struct ion_heap heap;
+	spinlock_t lock;		/* protects the lists and counts */
+	struct list_head clean;		/* zeroed pages */
+	struct list_head dirty;		/* freed pages, to be zeroed */
+	int clean_count;
+	int dirty_count;
+	unsigned long last_shrink;	/* jiffies */
+	struct work_struct refill_work;
+	struct shrinker shrinker;
+};
+
+static struct page *ion_pool_get(struct ion_system_heap *sys_heap)
+{
+	struct page *page = NULL;
+
+	spin_lock(&sys_heap->lock);
+	if (sys_heap->clean_count) {
+		page = list_first_entry(&sys_heap->clean, struct page, lru);
+		list_del(&page->lru);
+		sys_heap->clean_count--;
+	}
+	spin_unlock(&sys_heap->lock);
+
+	return page;
+}
+
+static void ion_pool_put(struct ion_system_heap *sys_heap, struct page *page)
+{
+	spin_lock(&sys_heap->lock);
+	if (sys_heap->clean_count + sys_heap->dirty_count < ION_POOL_MAX) {
+		list_add_tail(&page->lru, &sys_heap->dirty);
+		sys_heap->dirty_count++;
+		page = NULL;
+	}
+	spin_unlock(&sys_heap->lock);
+
+	if (page)
+		__free_page(page);
+}
+
+static void ion_pool_add_clean(struct ion_system_heap *sys_heap,
+			       struct page *page)
+{
+	spin_lock(&sys_heap->lock);
+	list_add(&page->lru, &sys_heap->clean);
+	sys_heap->clean_count++;
+	spin_unlock(&sys_heap->lock);
+}
+
+static bool ion_pool_need_refill(struct ion_system_heap *sys_heap)
+{
+	return sys_heap->clean_count < ion_pool_refill_pages &&
+	       time_after(jiffies, sys_heap->last_shrink +
+				   ION_POOL_REFILL_HOLDOFF);
+}
+
+static void ion_pool_refill(struct work_struct *work)
+{
+	struct ion_system_heap *sys_heap =
+		container_of(work, struct ion_system_heap, refill_work);
+	struct page *page;
+
+	/* Zero what was freed first, then allocate the rest */
+	for (;;) {
+		spin_lock(&sys_heap->lock);
+		if (!sys_heap->dirty_count) {
+			spin_unlock(&sys_heap->lock);
+			break;
+		}
+		page = list_first_entry(&sys_heap->dirty, struct page, lru);
+		list_del(&page->lru);
+		sys_heap->dirty_count--;
+		spin_unlock(&sys_heap->lock);
+
+		clear_highpage(page);
+		ion_pool_add_clean(sys_heap, page);
+		cond_resched();
+	}
+
+	while (ion_pool_need_refill(sys_heap)) {
+		page = alloc_page(ION_POOL_GFP | __GFP_ZERO | __GFP_NORETRY |
+				  __GFP_NOWARN);
+		if (!page)
+			break;
+		ion_pool_add_clean(sys_heap, page);
+		cond_resched();
+	}
+}
+
+static int ion_pool_shrink(struct shrinker *shrinker,
+			   struct shrink_control *sc)
+{
+	struct ion_system_heap *sys_heap =
+		container_of(shrinker, struct ion_system_heap, shrinker);
+	int nr_to_scan = sc->nr_to_scan;
+	struct list_head *list;
+	struct page *page;
+	int *count;
+
+	if (!nr_to_scan)
+		goto out;
+
+	spin_lock(&sys_heap->lock);
+	sys_heap->last_shrink = jiffies;
+	while (nr_to_scan--) {
+		if (sys_heap->dirty_count) {
+			list = &sys_heap->dirty;
+			count = &sys_heap->dirty_count;
+		} else if (sys_heap->clean_count) {
+			list = &sys_heap->clean;
+			count = &sys_heap->clean_count;
+		} else {
+			break;
+		}
+		page = list_first_entry(list, struct page, lru);
+		list_del(&page->lru);
+		(*count)--;
+		__free_page(page);
+	}
+	spin_unlock(&sys_heap->lock);
+
+out:
+	return sys_heap->clean_count + sys_heap->dirty_count;
+}
+
 static int ion_system_heap_allocate(struct ion_heap *heap,
 				    struct ion_buffer *buffer,
 				    unsigned long size, unsigned long align,
 				    unsigned long flags)
 {
+	struct ion_system_heap *sys_heap =
+		container_of(heap, struct ion_system_heap, heap);
 	int n_pages = PAGE_ALIGN(size) / PAGE_SIZE;
 	struct page **page_list;
-	const int gfp_mask = GFP_KERNEL | __GFP_HIGHMEM | __GFP_ZERO;
+	const int gfp_mask = ION_POOL_GFP | __GFP_ZERO;
 	int i = 0;
 
 	page_list = kmalloc(n_pages * sizeof(void *), GFP_KERNEL);
+	if (!page_list)
+		return -ENOMEM;
 
 	for (i = 0; i < n_pages; i++) {
-		page_list[i] = alloc_page(gfp_mask);
+		page_list[i] = ion_pool_get(sys_heap);
+		if (!page_list[i])
+			page_list[i] = alloc_page(gfp_mask);
 		if (page_list[i] == NULL)
 			goto out;
 	}
 
+	if (ion_pool_need_refill(sys_heap))
+		schedule_work(&sys_heap->refill_work);
+
 	buffer->priv_virt = page_list;
 	return 0;
 
@@ -56,13 +212,17 @@ out:
 
 void ion_system_heap_free(struct ion_buffer *buffer)
 {
+	struct ion_system_heap *sys_heap =
+		container_of(buffer->heap, struct ion_system_heap, heap);
 	int i;
 	int n_pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
 	struct page **page_list = (struct page **)buffer->priv_virt;
 
 	for (i = 0; i < n_pages; i++)
-		__free_page(page_list[i]);
+		ion_pool_put(sys_heap, page_list[i]);
 	kfree(page_list);
+
+	schedule_work(&sys_heap->refill_work);
 }
 
 struct scatterlist *ion_system_heap_map_dma(struct ion_heap *heap,
@@ -108,31 +268,41 @@ void ion_system_heap_unmap_kernel(struct ion_heap *heap,
 	vm_unmap_ram(buffer->vaddr, n_pages);
 }
 
+/*
+ * The whole buffer is mapped up front so that the first CPU access does
+ * not take a fault per page.  Runs of physically consecutive pages go in
+ * with a single remap_pfn_range(), which also saves the per-page rmap
+ * and refcount work of vm_insert_page(); the pages stay owned by the
+ * buffer, which the mapping holds a reference to.
+ */
 int ion_system_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 			     struct vm_area_struct *vma)
 {
 	unsigned long uaddr = vma->vm_start;
-	unsigned long usize = vma->vm_end - vma->vm_start;
 	int n_pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
+	int vma_pages = (vma->vm_end - vma->vm_start) >> PAGE_SHIFT;
 	struct page **page_list = (struct page **)buffer->priv_virt;
-	int i;
+	int i, run, end;
 
-	if (usize /* + pgoff << PAGE_SHIFT */  > (n_pages << PAGE_SHIFT))
+	if (vma->vm_pgoff + vma_pages > n_pages)
 		return -EINVAL;
 
-	i = 0;
-	do {
+	end = vma->vm_pgoff + vma_pages;
+	for (i = vma->vm_pgoff; i < end; i += run) {
+		unsigned long pfn = page_to_pfn(page_list[i]);
 		int ret;
 
-		ret = vm_insert_page(vma, uaddr, page_list[i]);
+		for (run = 1; i + run < end; run++)
+			if (page_to_pfn(page_list[i + run]) != pfn + run)
+				break;
+
+		ret = remap_pfn_range(vma, uaddr, pfn, run << PAGE_SHIFT,
+				      vma->vm_page_prot);
 		if (ret)
 			return ret;
 
-		uaddr += PAGE_SIZE;
-		usize -= PAGE_SIZE;
-	} while (usize > 0);
-
-	vma->vm_flags |= VM_RESERVED;
+		uaddr += run << PAGE_SHIFT;
+	}
 
 	return 0;
 }
@@ -149,19 +319,43 @@ static struct ion_heap_ops vmalloc_ops = {
 
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
-	struct ion_heap *heap;
+	struct ion_system_heap *sys_heap;
 
-	heap = kzalloc(sizeof(struct ion_heap), GFP_KERNEL);
-	if (!heap)
+	sys_heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
+	if (!sys_heap)
 		return ERR_PTR(-ENOMEM);
-	heap->ops = &vmalloc_ops;
-	heap->type = ION_HEAP_TYPE_SYSTEM;
-	return heap;
+	sys_heap->heap.ops = &vmalloc_ops;
+	sys_heap->heap.type = ION_HEAP_TYPE_SYSTEM;
+
+	spin_lock_init(&sys_heap->lock);
+	INIT_LIST_HEAD(&sys_heap->clean);
+	INIT_LIST_HEAD(&sys_heap->dirty);
+	sys_heap->last_shrink = jiffies - ION_POOL_REFILL_HOLDOFF;
+	INIT_WORK(&sys_heap->refill_work, ion_pool_refill);
+	sys_heap->shrinker.shrink = ion_pool_shrink;
+	sys_heap->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&sys_heap->shrinker);
+
+	if (ion_pool_need_refill(sys_heap))
+		schedule_work(&sys_heap->refill_work);
+
+	return &sys_heap->heap;
 }
 
 void ion_system_heap_destroy(struct ion_heap *heap)
 {
-	kfree(heap);
+	struct ion_system_heap *sys_heap =
+		container_of(heap, struct ion_system_heap, heap);
+	struct page *page, *tmp;
+
+	unregister_shrinker(&sys_heap->shrinker);
+	cancel_work_sync(&sys_heap->refill_work);
+
+	list_for_each_entry_safe(page, tmp, &sys_heap->clean, lru)
+		__free_page(page);
+	list_for_each_entry_safe(page, tmp, &sys_heap->dirty, lru)
+		__free_page(page);
+	kfree(sys_heap);
 }
 
 static int ion_system_contig_heap_allocate(struct ion_heap *heap,
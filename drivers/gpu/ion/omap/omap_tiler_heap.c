@@ -17,13 +17,17 @@
 
 #include <linux/err.h>
 #include <linux/genalloc.h>
+#include <linux/highmem.h>
 #include <linux/io.h>
 #include <linux/ion.h>
 #include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/omap_ion.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <mach/tiler.h>
 #include <asm/cacheflush.h>
 #include <asm/mach/map.h>
@@ -37,10 +41,27 @@
 bool use_dynamic_pages;
 #define TILER_ENABLE_NON_PAGE_ALIGNED_ALLOCATIONS  1
 
+/*
+ * Freed blocks can be kept pinned, together with their pages, and handed
+ * back when the same process asks for the same geometry again.  Camera
+ * and video reallocate the same shapes over and over, and this keeps
+ * them off the container and the PAT.  Blocks are cleared on the way
+ * into the pool.  0 disables the pool.
+ */
+static unsigned int pool_ms;
+module_param(pool_ms, uint, 0644);
+MODULE_PARM_DESC(pool_ms, "Keep freed blocks for reuse this long (ms)");
+
+#define TILER_POOL_MAX_BLOCKS	32
+
 struct omap_ion_heap {
 	struct ion_heap heap;
 	struct gen_pool *pool;
 	ion_phys_addr_t base;
+	struct mutex block_lock;	/* protects the block pool */
+	struct list_head blocks;	/* pooled blocks, most recent first */
+	u32 n_blocks;
+	struct delayed_work expire_work;
 };
 
 struct omap_tiler_info {
@@ -54,6 +75,13 @@ struct omap_tiler_info {
 	u32 tiler_start;                /* start addr in tiler -- if not page
 					   aligned this may not equal the
 					   first entry onf tiler_addrs */
+	struct list_head pool;          /* entry in the heap's block pool */
+	unsigned long expires;          /* when a pooled block is released */
+	pid_t owner;                    /* pid of the allocating client */
+	size_t w, h;                    /* requested geometry, for reuse */
+	u32 align;
+	u32 offset;
+	u32 token;
 };
 
 static int omap_tiler_heap_allocate(struct ion_heap *heap,
@@ -164,6 +192,176 @@ static void omap_tiler_free_dynamicpages(struct omap_tiler_info *info)
 	return;
 }
 
+static void omap_tiler_release(struct ion_heap *heap,
+			       struct omap_tiler_info *info)
+{
+	tiler_unpin_block(info->tiler_handle);
+	tiler_free_block_area(info->tiler_handle);
+
+	if ((heap->id == OMAP_ION_HEAP_TILER) ||
+	    (heap->id == OMAP_ION_HEAP_NONSECURE_TILER)) {
+		if (use_dynamic_pages)
+			omap_tiler_free_dynamicpages(info);
+		else
+			omap_tiler_free_carveout(heap, info);
+	}
+
+	kfree(info);
+}
+
+static bool omap_tiler_pool_match(struct omap_tiler_info *info, pid_t owner,
+				  struct omap_ion_tiler_alloc_data *data)
+{
+	return info->owner == owner && info->fmt == data->fmt &&
+		info->w == data->w && info->h == data->h &&
+		info->align == data->out_align &&
+		info->offset == data->offset && info->token == data->token;
+}
+
+/* take a pooled block, still pinned, of the same owner and geometry */
+static struct omap_tiler_info *omap_tiler_pool_get(struct ion_heap *heap,
+		pid_t owner, struct omap_ion_tiler_alloc_data *data)
+{
+	struct omap_ion_heap *omap_heap = (struct omap_ion_heap *)heap;
+	struct omap_tiler_info *info;
+
+	mutex_lock(&omap_heap->block_lock);
+	list_for_each_entry(info, &omap_heap->blocks, pool) {
+		if (omap_tiler_pool_match(info, owner, data)) {
+			list_del(&info->pool);
+			omap_heap->n_blocks--;
+			mutex_unlock(&omap_heap->block_lock);
+			return info;
+		}
+	}
+	mutex_unlock(&omap_heap->block_lock);
+	return NULL;
+}
+
+static void omap_tiler_zero_carveout(u32 addr, size_t size)
+{
+	void __iomem *va = ioremap_wc(addr, size);
+
+	if (WARN_ON(!va))
+		return;
+	memset_io(va, 0, size);
+	wmb();
+	iounmap(va);
+}
+
+/*
+ * Clear the pages of a block going into the pool.  Pooled blocks are
+ * matched by pid, and a pid can belong to another process by the time
+ * the block is handed out again.
+ */
+static void omap_tiler_zero(struct ion_heap *heap, struct omap_tiler_info *info)
+{
+	struct page *pg;
+	void *vaddr;
+	int i;
+
+	if ((heap->id != OMAP_ION_HEAP_TILER) &&
+	    (heap->id != OMAP_ION_HEAP_NONSECURE_TILER))
+		return;
+
+	if (!use_dynamic_pages && info->lump) {
+		omap_tiler_zero_carveout(info->phys_addrs[0],
+					 info->n_phys_pages * PAGE_SIZE);
+		return;
+	}
+
+	for (i = 0; i < info->n_phys_pages; i++) {
+		if (!use_dynamic_pages) {
+			omap_tiler_zero_carveout(info->phys_addrs[i],
+						 PAGE_SIZE);
+			continue;
+		}
+		/* dynamic pages may be highmem, with no linear mapping */
+		pg = phys_to_page(info->phys_addrs[i]);
+		vaddr = kmap_atomic(pg, KM_USER0);
+		memset(vaddr, 0, PAGE_SIZE);
+		dmac_flush_range(vaddr, vaddr + PAGE_SIZE);
+		kunmap_atomic(vaddr, KM_USER0);
+		outer_flush_range(info->phys_addrs[i],
+			info->phys_addrs[i] + PAGE_SIZE);
+	}
+}
+
+/* returns false if the block has to be released by the caller */
+static bool omap_tiler_pool_put(struct ion_heap *heap,
+				struct omap_tiler_info *info)
+{
+	struct omap_ion_heap *omap_heap = (struct omap_ion_heap *)heap;
+	struct omap_tiler_info *oldest = NULL;
+	unsigned long timeout = msecs_to_jiffies(pool_ms);
+
+	if (!timeout)
+		return false;
+
+	omap_tiler_zero(heap, info);
+	info->expires = jiffies + timeout;
+	mutex_lock(&omap_heap->block_lock);
+	list_add(&info->pool, &omap_heap->blocks);
+	if (++omap_heap->n_blocks > TILER_POOL_MAX_BLOCKS) {
+		oldest = list_entry(omap_heap->blocks.prev,
+				    struct omap_tiler_info, pool);
+		list_del(&oldest->pool);
+		omap_heap->n_blocks--;
+	}
+	mutex_unlock(&omap_heap->block_lock);
+
+	if (oldest)
+		omap_tiler_release(heap, oldest);
+	schedule_delayed_work(&omap_heap->expire_work, timeout);
+	return true;
+}
+
+static void omap_tiler_pool_expire(struct work_struct *work)
+{
+	struct omap_ion_heap *omap_heap = container_of(work,
+				struct omap_ion_heap, expire_work.work);
+	struct omap_tiler_info *info, *tmp;
+	unsigned long next = 0;
+	LIST_HEAD(expired);
+
+	/* the oldest blocks are at the tail */
+	mutex_lock(&omap_heap->block_lock);
+	list_for_each_entry_safe_reverse(info, tmp, &omap_heap->blocks, pool) {
+		if (time_before(jiffies, info->expires)) {
+			next = info->expires - jiffies;
+			break;
+		}
+		list_move(&info->pool, &expired);
+		omap_heap->n_blocks--;
+	}
+	mutex_unlock(&omap_heap->block_lock);
+
+	list_for_each_entry_safe(info, tmp, &expired, pool)
+		omap_tiler_release(&omap_heap->heap, info);
+
+	if (next)
+		schedule_delayed_work(&omap_heap->expire_work, next);
+}
+
+/* release all pooled blocks, returns how many there were */
+static int omap_tiler_pool_drain(struct ion_heap *heap)
+{
+	struct omap_ion_heap *omap_heap = (struct omap_ion_heap *)heap;
+	struct omap_tiler_info *info, *tmp;
+	LIST_HEAD(blocks);
+	int n;
+
+	mutex_lock(&omap_heap->block_lock);
+	list_splice_init(&omap_heap->blocks, &blocks);
+	n = omap_heap->n_blocks;
+	omap_heap->n_blocks = 0;
+	mutex_unlock(&omap_heap->block_lock);
+
+	list_for_each_entry_safe(info, tmp, &blocks, pool)
+		omap_tiler_release(heap, info);
+	return n;
+}
+
 int omap_tiler_alloc(struct ion_heap *heap,
 		     struct ion_client *client,
 		     struct omap_ion_tiler_alloc_data *data)
@@ -176,6 +374,7 @@ int omap_tiler_alloc(struct ion_heap *heap,
 	u32 tiler_start = 0;
 	u32 v_size;
 	tiler_blk_handle tiler_handle;
+	ktime_t start = ktime_get();
 	int ret;
 
 	if (data->fmt == TILER_PIXEL_FMT_PAGE && data->h != 1) {
@@ -196,6 +395,15 @@ int omap_tiler_alloc(struct ion_heap *heap,
 
 	BUG_ON(!n_phys_pages || !n_tiler_pages);
 
+	info = omap_tiler_pool_get(heap, client->pid, data);
+	if (info) {
+		tiler_handle = info->tiler_handle;
+		n_tiler_pages = info->n_tiler_pages;
+		v_size = tiler_block_vsize(tiler_handle);
+		goto reuse;
+	}
+
+retry:
 	if( (TILER_ENABLE_NON_PAGE_ALIGNED_ALLOCATIONS)
 			&& (data->token != 0) ) {
 		tiler_handle = tiler_alloc_block_area_aligned(data->fmt, data->w, data->h,
@@ -211,6 +419,10 @@ int omap_tiler_alloc(struct ion_heap *heap,
 	}
 
 	if (IS_ERR_OR_NULL(tiler_handle)) {
+		/* The space may only be waiting for a deferred free */
+		if (ion_heap_drain_freelist(heap) ||
+		    omap_tiler_pool_drain(heap))
+			goto retry;
 		ret = PTR_ERR(tiler_handle);
 		pr_err("%s: failure to allocate address space from tiler\n",
 		       __func__);
@@ -237,6 +449,12 @@ int omap_tiler_alloc(struct ion_heap *heap,
 	info->phys_addrs = (u32 *)(info + 1);
 	info->tiler_addrs = info->phys_addrs + n_phys_pages;
 	info->fmt = data->fmt;
+	info->owner = client->pid;
+	info->w = data->w;
+	info->h = data->h;
+	info->align = data->out_align;
+	info->offset = data->offset;
+	info->token = data->token;
 
 	if ((heap->id == OMAP_ION_HEAP_TILER) ||
 	    (heap->id == OMAP_ION_HEAP_NONSECURE_TILER)) {
@@ -256,6 +474,7 @@ int omap_tiler_alloc(struct ion_heap *heap,
 			goto err_pin;
 		}
 	}
+reuse:
 	data->stride = tiler_block_vstride(info->tiler_handle);
 
 	/* create an ion handle  for the allocation */
@@ -280,6 +499,7 @@ int omap_tiler_alloc(struct ion_heap *heap,
 				__func__, n_tiler_pages);
 	}
 
+	ion_alloc_account(client, heap, start, false);
 	return 0;
 
 err:
@@ -296,6 +516,7 @@ err_alloc:
 	tiler_free_block_area(tiler_handle);
 err_nomem:
 	kfree(info);
+	ion_alloc_account(client, heap, start, true);
 	return ret;
 }
 
@@ -303,18 +524,8 @@ void omap_tiler_heap_free(struct ion_buffer *buffer)
 {
 	struct omap_tiler_info *info = buffer->priv_virt;
 
-	tiler_unpin_block(info->tiler_handle);
-	tiler_free_block_area(info->tiler_handle);
-
-	if ((buffer->heap->id == OMAP_ION_HEAP_TILER) ||
-	    (buffer->heap->id == OMAP_ION_HEAP_NONSECURE_TILER)) {
-		if (use_dynamic_pages)
-			omap_tiler_free_dynamicpages(info);
-		else
-			omap_tiler_free_carveout(buffer->heap, info);
-	}
-
-	kfree(info);
+	if (!omap_tiler_pool_put(buffer->heap, info))
+		omap_tiler_release(buffer->heap, info);
 }
 
 static int omap_tiler_phys(struct ion_heap *heap,
@@ -365,7 +576,7 @@ int omap_tiler_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 	unsigned long addr = vma->vm_start;
 	u32 vma_pages = (vma->vm_end - vma->vm_start) / PAGE_SIZE;
 	int n_pages = min(vma_pages, info->n_tiler_pages);
-	int i, ret = 0;
+	int i, run, ret = 0;
 
 	if (TILER_PIXEL_FMT_PAGE == info->fmt) {
 		/* Since 1D buffer is linear, map whole buffer in one shot */
@@ -376,28 +587,70 @@ int omap_tiler_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 				(vma->vm_page_prot)
 				: pgprot_writecombine(vma->vm_page_prot)));
 	} else {
-		for (i = vma->vm_pgoff; i < n_pages; i++, addr += PAGE_SIZE) {
+		/* one remap per run of consecutive container pages (a row) */
+		for (i = vma->vm_pgoff; i < n_pages; i += run) {
+			for (run = 1; i + run < n_pages; run++)
+				if (info->tiler_addrs[i + run] !=
+				    info->tiler_addrs[i] + run * PAGE_SIZE)
+					break;
+
 			ret = remap_pfn_range(vma, addr,
 				 __phys_to_pfn(info->tiler_addrs[i]),
-				PAGE_SIZE,
+				run * PAGE_SIZE,
 				pgprot_writecombine(vma->vm_page_prot));
 			if (ret)
 				return ret;
+			addr += run * PAGE_SIZE;
 		}
 	}
 	return ret;
 }
 
+/*
+ * Maintenance by line is broadcast to the other core and leaves the
+ * rest of the caches alone, so it is used for buffers up to about a
+ * 1080p frame; only bigger ones get the whole caches flushed, which
+ * takes an IPI and empties both L1s and the L2.
+ */
+#define TILER_FULL_CACHE_FLUSH_THRESHOLD	SZ_4M
+
 static void per_cpu_cache_flush_arm(void *arg)
 {
 	   flush_cache_all();
 }
 
+/*
+ * Clean and invalidate the inner caches over the user mapping. Cache
+ * operations by address must not fault, so the range has to be mapped
+ * by a pfn mapping, which is populated in full. mmap_sem can only be
+ * tried: ion_share_mmap() takes buffer->lock under it.
+ */
+static int omap_tiler_flush_user_range(unsigned long vaddr, size_t len)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	int ret = -EINVAL;
+
+	if (!down_read_trylock(&mm->mmap_sem))
+		return -EBUSY;
+
+	vma = find_vma(mm, vaddr);
+	if (vma && vma->vm_start <= vaddr && vaddr + len <= vma->vm_end &&
+	    (vma->vm_flags & VM_PFNMAP)) {
+		dmac_flush_range((void *)vaddr, (void *)(vaddr + len));
+		ret = 0;
+	}
+
+	up_read(&mm->mmap_sem);
+	return ret;
+}
+
 int omap_tiler_cache_operation(struct ion_buffer *buffer, size_t len,
 			unsigned long vaddr, enum cache_operation cacheop)
 {
 	struct omap_tiler_info *info;
 	int n_pages;
+	int ret;
 
 	if (!buffer) {
 		pr_err("%s(): buffer is NULL\n", __func__);
@@ -427,13 +680,16 @@ int omap_tiler_cache_operation(struct ion_buffer *buffer, size_t len,
 		return -EINVAL;
 	}
 
-	if (len > FULL_CACHE_FLUSH_THRESHOLD) {
-		on_each_cpu(per_cpu_cache_flush_arm, NULL, 1);
-		outer_flush_all();
-		return 0;
-	}
+	if (len > TILER_FULL_CACHE_FLUSH_THRESHOLD)
+		goto flush_all;
 
-	flush_cache_user_range(vaddr, vaddr + len);
+	ret = omap_tiler_flush_user_range(vaddr, len);
+	if (ret == -EBUSY)
+		goto flush_all;
+	if (ret) {
+		pr_err("%s(): range not mapped by the buffer\n", __func__);
+		return ret;
+	}
 
 	if (cacheop == CACHE_FLUSH)
 		outer_flush_range(info->tiler_addrs[0],
@@ -442,6 +698,11 @@ int omap_tiler_cache_operation(struct ion_buffer *buffer, size_t len,
 		outer_inv_range(info->tiler_addrs[0],
 			info->tiler_addrs[0] + len);
 	return 0;
+
+flush_all:
+	on_each_cpu(per_cpu_cache_flush_arm, NULL, 1);
+	outer_flush_all();
+	return 0;
 }
 
 int omap_tiler_heap_flush_user(struct ion_buffer *buffer, size_t len,
@@ -456,6 +717,12 @@ int omap_tiler_heap_inval_user(struct ion_buffer *buffer, size_t len,
 	return omap_tiler_cache_operation(buffer, len, vaddr, CACHE_INVALIDATE);
 }
 
+/* Only the 1D space fragments in a way a single number can tell */
+static size_t omap_tiler_heap_largest_free(struct ion_heap *heap)
+{
+	return tiler_max_free_1d();
+}
+
 static struct ion_heap_ops omap_tiler_ops = {
 	.allocate = omap_tiler_heap_allocate,
 	.free = omap_tiler_heap_free,
@@ -463,6 +730,7 @@ static struct ion_heap_ops omap_tiler_ops = {
 	.map_user = omap_tiler_heap_map_user,
 	.flush_user = omap_tiler_heap_flush_user,
 	.inval_user = omap_tiler_heap_inval_user,
+	.largest_free = omap_tiler_heap_largest_free,
 };
 
 struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *data)
@@ -483,10 +751,15 @@ struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *data)
 		heap->base = data->base;
 		gen_pool_add(heap->pool, heap->base, data->size, -1);
 	}
+	mutex_init(&heap->block_lock);
+	INIT_LIST_HEAD(&heap->blocks);
+	INIT_DELAYED_WORK(&heap->expire_work, omap_tiler_pool_expire);
 	heap->heap.ops = &omap_tiler_ops;
 	heap->heap.type = OMAP_ION_HEAP_TYPE_TILER;
 	heap->heap.name = data->name;
 	heap->heap.id = data->id;
+	/* Unpinning and releasing the area is slow, keep it off the caller */
+	heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
 #ifdef DYNAMIC_PAGE_ALLOC
 	use_dynamic_pages = true;
 #else
@@ -501,6 +774,10 @@ struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *data)
 void omap_tiler_heap_destroy(struct ion_heap *heap)
 {
 	struct omap_ion_heap *omap_ion_heap = (struct omap_ion_heap *)heap;
+
+	ion_heap_deinit_deferred_free(heap);
+	cancel_delayed_work_sync(&omap_ion_heap->expire_work);
+	omap_tiler_pool_drain(heap);
 	if (omap_ion_heap->pool)
 		gen_pool_destroy(omap_ion_heap->pool);
 	kfree(heap);
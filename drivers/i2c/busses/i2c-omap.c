@@ -187,6 +187,7 @@ struct omap_i2c_dev {
 						 * fifo_size==0 implies no fifo
 						 * if set, should be trsh+1
 						 */
+	u8			threshold;	/* of the current message */
 	u8			rev;
 	unsigned		b_hw:1;		/* bad h/w fixes */
 	unsigned		idle:1;
@@ -197,6 +198,10 @@ struct omap_i2c_dev {
 	u16			bufstate;
 	u16			westate;
 	u16			errata;
+	/* combined transfer: messages the isr starts after this one */
+	struct i2c_msg		*msg;
+	int			msgs_left;
+	unsigned		stop:1;
 };
 
 const static u8 reg_map[] = {
@@ -588,19 +593,16 @@ static int omap_i2c_bus_clear(struct omap_i2c_dev *dev)
 /*
  * Low level master read/write transaction.
  */
-static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
-			     struct i2c_msg *msg, int stop)
+/*
+ * Program msg and send the start condition; also called from the isr
+ * for the next message of a combined transfer.  Returns the value
+ * written to I2C_CON.
+ */
+static u16 omap_i2c_start_msg(struct omap_i2c_dev *dev,
+			      struct i2c_msg *msg, int stop)
 {
-	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
-	int r;
 	u16 w;
 
-	dev_dbg(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
-		msg->addr, msg->len, msg->flags, stop);
-
-	if (msg->len == 0)
-		return -EINVAL;
-
 	omap_i2c_write_reg(dev, OMAP_I2C_SA_REG, msg->addr);
 
 	/* REVISIT: Could the STB bit of I2C_CON be used with probing? */
@@ -612,11 +614,17 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	/* Clear the FIFO Buffers */
 	w = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
 	w |= OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
+	if (dev->fifo_size) {
+		/*
+		 * One interrupt for a short message: the threshold is
+		 * the message, up to what the fifo takes by interrupt.
+		 */
+		dev->threshold = clamp_t(u16, msg->len, 1, dev->fifo_size);
+		w &= ~(0x3f << 8 | 0x3f);
+		w |= (dev->threshold - 1) << 8 | (dev->threshold - 1);
+	}
 	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
 
-	init_completion(&dev->cmd_complete);
-	dev->cmd_err = 0;
-
 	w = OMAP_I2C_CON_EN | OMAP_I2C_CON_MST | OMAP_I2C_CON_STT;
 
 	/* High speed configuration */
@@ -633,6 +641,37 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, w);
 
+	return w;
+}
+
+/*
+ * Transfer num messages, stop after the last if stop.  Past the first,
+ * the isr starts each message when the previous one is done, so they
+ * all take a single completion.
+ */
+static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
+			     struct i2c_msg *msgs, int num, int stop)
+{
+	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
+	struct i2c_msg *msg = msgs;
+	int i, r;
+	u16 w;
+
+	dev_dbg(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
+		msg->addr, msg->len, msg->flags, stop);
+
+	for (i = 0; i < num; i++)
+		if (msgs[i].len == 0)
+			return -EINVAL;
+
+	init_completion(&dev->cmd_complete);
+	dev->cmd_err = 0;
+	dev->msg = msgs;
+	dev->msgs_left = num - 1;
+	dev->stop = stop;
+
+	w = omap_i2c_start_msg(dev, msg, stop && num == 1);
+
 	/*
 	 * Don't write stt and stp together on some hardware.
 	 */
@@ -662,6 +701,8 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	 */
 	r = wait_for_completion_timeout(&dev->cmd_complete, OMAP_I2C_TIMEOUT);
 	dev->buf_len = 0;
+	dev->msgs_left = 0;
+	msg = dev->msg;
 	if (r == 0) {
 		dev_err(dev->dev, "controller timed out\n");
 
@@ -712,7 +753,7 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	if (dev->cmd_err & OMAP_I2C_STAT_NACK) {
 		if (msg->flags & I2C_M_IGNORE_NAK)
 			return 0;
-		if (stop) {
+		if (stop || msg != msgs + num - 1) {
 			w = omap_i2c_read_reg(dev, OMAP_I2C_CON_REG);
 			w |= OMAP_I2C_CON_STP;
 			omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, w);
@@ -731,7 +772,7 @@ static int
 omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
-	int i;
+	int i, n;
 	int r;
 
 	if (dev == NULL)
@@ -763,8 +804,17 @@ omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	if (dev->pm_qos)
 		pm_qos_update_request(dev->pm_qos, dev->latency);
 
-	for (i = 0; i < num; i++) {
-		r = omap_i2c_xfer_msg(adap, &msgs[i], (i == (num - 1)));
+	for (i = 0; i < num; i += n) {
+		/*
+		 * Chain the rest on controllers with a fifo (the omap1
+		 * isr does not chain) unless stt and stp need separate
+		 * writes or a message may carry on after a nack.
+		 */
+		for (n = 1; dev->fifo_size && !dev->b_hw && i + n < num; n++)
+			if ((msgs[i + n - 1].flags | msgs[i + n].flags) &
+			    I2C_M_IGNORE_NAK)
+				break;
+		r = omap_i2c_xfer_msg(adap, &msgs[i], n, (i + n == num));
 		if (r != 0)
 			break;
 	}
@@ -964,6 +1014,14 @@ complete:
 				(OMAP_I2C_STAT_RRDY | OMAP_I2C_STAT_RDR |
 				OMAP_I2C_STAT_XRDY | OMAP_I2C_STAT_XDR |
 				OMAP_I2C_STAT_ARDY));
+			if (!err && dev->msgs_left) {
+				/* repeated start for the next message */
+				dev->msgs_left--;
+				dev->msg++;
+				omap_i2c_start_msg(dev, dev->msg,
+					dev->stop && !dev->msgs_left);
+				return IRQ_HANDLED;
+			}
 			omap_i2c_complete_cmd(dev, err);
 			return IRQ_HANDLED;
 		}
@@ -975,7 +1033,7 @@ complete:
 
 			if (dev->fifo_size) {
 				if (stat & OMAP_I2C_STAT_RRDY)
-					num_bytes = dev->fifo_size;
+					num_bytes = dev->threshold;
 				else    /* read RXSTAT on RDR interrupt */
 					num_bytes = (omap_i2c_read_reg(dev,
 							OMAP_I2C_BUFSTAT_REG)
@@ -1018,7 +1076,7 @@ complete:
 			u8 num_bytes = 1;
 			if (dev->fifo_size) {
 				if (stat & OMAP_I2C_STAT_XRDY)
-					num_bytes = dev->fifo_size;
+					num_bytes = dev->threshold;
 				else    /* read TXSTAT on XDR interrupt */
 					num_bytes = omap_i2c_read_reg(dev,
 							OMAP_I2C_BUFSTAT_REG)
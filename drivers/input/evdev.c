@@ -24,8 +24,39 @@
 #include <linux/major.h>
 #include <linux/device.h>
 #include <linux/wakelock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "input-compat.h"
 
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+/* Buckets are <1, <2, <4 ... <128 and >=128 ms */
+#define EVDEV_LAT_BUCKETS	9
+
+struct evdev_latency {
+	unsigned long hist[EVDEV_LAT_BUCKETS];
+	unsigned long count;
+	unsigned int max_us;
+};
+
+static struct dentry *evdev_debugfs_root;
+
+static void evdev_latency_add(struct evdev_latency *lat, ktime_t delta)
+{
+	s64 us = ktime_to_us(delta);
+	unsigned int ms;
+
+	if (us < 0)
+		us = 0;
+	if (us > UINT_MAX)
+		us = UINT_MAX;
+
+	ms = (unsigned int)us / USEC_PER_MSEC;
+	lat->hist[min(fls(ms), EVDEV_LAT_BUCKETS - 1)]++;
+	lat->count++;
+	lat->max_us = max(lat->max_us, (unsigned int)us);
+}
+#endif
+
 struct evdev {
 	int open;
 	int minor;
@@ -37,6 +68,10 @@ struct evdev {
 	struct mutex mutex;
 	struct device dev;
 	bool exist;
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	struct evdev_latency irq_to_report; /* under the input dev event_lock */
+	struct dentry *debugfs;
+#endif
 };
 
 struct evdev_client {
@@ -52,17 +87,24 @@ struct evdev_client {
 	struct list_head node;
 	unsigned int bufsize;
 	struct input_event *buffer;
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	ktime_t *queued; /* when each SYN_REPORT in buffer was queued */
+	struct evdev_latency report_to_read; /* under buffer_lock */
+#endif
 };
 
 static struct evdev *evdev_table[EVDEV_MINORS];
 static DEFINE_MUTEX(evdev_table_mutex);
 
 static void evdev_pass_event(struct evdev_client *client,
-			     struct input_event *event)
+			     struct input_event *event, ktime_t now)
 {
 	/* Interrupts are disabled, just acquire the lock. */
 	spin_lock(&client->buffer_lock);
 
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	client->queued[client->head] = now;
+#endif
 	client->buffer[client->head++] = *event;
 	client->head &= client->bufsize - 1;
 
@@ -100,11 +142,14 @@ static void evdev_event(struct input_handle *handle,
 			unsigned int type, unsigned int code, int value)
 {
 	struct evdev *evdev = handle->private;
+	struct input_dev *dev = handle->dev;
 	struct evdev_client *client;
 	struct input_event event;
 	struct timespec ts;
+	ktime_t now = ktime_get();
 
-	ktime_get_ts(&ts);
+	/* Events stamped by the driver carry the time of their interrupt */
+	ts = ktime_to_timespec(dev->timestamp.tv64 ? dev->timestamp : now);
 	event.time.tv_sec = ts.tv_sec;
 	event.time.tv_usec = ts.tv_nsec / NSEC_PER_USEC;
 	event.type = type;
@@ -115,13 +160,19 @@ static void evdev_event(struct input_handle *handle,
 
 	client = rcu_dereference(evdev->grab);
 	if (client)
-		evdev_pass_event(client, &event);
+		evdev_pass_event(client, &event, now);
 	else
 		list_for_each_entry_rcu(client, &evdev->client_list, node)
-			evdev_pass_event(client, &event);
+			evdev_pass_event(client, &event, now);
 
 	rcu_read_unlock();
 
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	if (type == EV_SYN && code == SYN_REPORT && dev->timestamp.tv64)
+		evdev_latency_add(&evdev->irq_to_report,
+				  ktime_sub(now, dev->timestamp));
+#endif
+
 	if (type == EV_SYN && code == SYN_REPORT)
 		wake_up_interruptible(&evdev->wait);
 }
@@ -271,6 +322,9 @@ static int evdev_release(struct inode *inode, struct file *file)
 		wake_lock_destroy(&client->wake_lock);
 
 	kfree(client->buffer);
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	kfree(client->queued);
+#endif
 	kfree(client);
 
 	evdev_close_device(evdev);
@@ -324,6 +378,14 @@ static int evdev_open(struct inode *inode, struct file *file)
 		goto err_free_client;
 	}
 
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	client->queued = kcalloc(bufsize, sizeof(ktime_t), GFP_KERNEL);
+	if (!client->queued) {
+		error = -ENOMEM;
+		goto err_free_buffer;
+	}
+#endif
+
 	client->bufsize = bufsize;
 	spin_lock_init(&client->buffer_lock);
 	snprintf(client->name, sizeof(client->name), "%s-%d",
@@ -342,6 +404,10 @@ static int evdev_open(struct inode *inode, struct file *file)
 
  err_detach_client:
 	evdev_detach_client(evdev, client);
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	kfree(client->queued);
+ err_free_buffer:
+#endif
 	kfree(client->buffer);
  err_free_client:
 	kfree(client);
@@ -395,6 +461,13 @@ static int evdev_fetch_next_event(struct evdev_client *client,
 
 	have_event = client->packet_head != client->tail;
 	if (have_event) {
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+		if (client->buffer[client->tail].type == EV_SYN &&
+		    client->buffer[client->tail].code == SYN_REPORT)
+			evdev_latency_add(&client->report_to_read,
+				ktime_sub(ktime_get(),
+					  client->queued[client->tail]));
+#endif
 		*event = client->buffer[client->tail++];
 		client->tail &= client->bufsize - 1;
 		if (client->use_wake_lock &&
@@ -966,6 +1039,69 @@ static void evdev_cleanup(struct evdev *evdev)
 	}
 }
 
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+static void evdev_latency_show(struct seq_file *s, const char *name,
+			       const struct evdev_latency *lat)
+{
+	int i;
+
+	seq_printf(s, "%-28s %8lu", name, lat->count);
+	for (i = 0; i < EVDEV_LAT_BUCKETS; i++)
+		seq_printf(s, " %7lu", lat->hist[i]);
+	seq_printf(s, " %8u\n", lat->max_us);
+}
+
+static int evdev_debugfs_show(struct seq_file *s, void *unused)
+{
+	struct evdev *evdev = s->private;
+	struct evdev_client *client;
+	int i;
+
+	seq_printf(s, "%-28s %8s", "", "count");
+	for (i = 0; i < EVDEV_LAT_BUCKETS - 1; i++)
+		seq_printf(s, " %5dms", 1 << i);
+	seq_printf(s, " %7s %8s\n", "more", "max_us");
+
+	evdev_latency_show(s, "irq-to-report", &evdev->irq_to_report);
+
+	spin_lock(&evdev->client_lock);
+	list_for_each_entry(client, &evdev->client_list, node)
+		evdev_latency_show(s, client->name, &client->report_to_read);
+	spin_unlock(&evdev->client_lock);
+
+	return 0;
+}
+
+static int evdev_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, evdev_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations evdev_debugfs_fops = {
+	.open		= evdev_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void evdev_debugfs_add(struct evdev *evdev)
+{
+	if (evdev_debugfs_root)
+		evdev->debugfs = debugfs_create_file(dev_name(&evdev->dev),
+						     S_IRUGO,
+						     evdev_debugfs_root, evdev,
+						     &evdev_debugfs_fops);
+}
+
+static void evdev_debugfs_remove(struct evdev *evdev)
+{
+	debugfs_remove(evdev->debugfs);
+}
+#else
+static inline void evdev_debugfs_add(struct evdev *evdev) { }
+static inline void evdev_debugfs_remove(struct evdev *evdev) { }
+#endif
+
 /*
  * Create new evdev device. Note that input core serializes calls
  * to connect and disconnect so we don't need to lock evdev_table here.
@@ -1022,6 +1158,8 @@ static int evdev_connect(struct input_handler *handler, struct input_dev *dev,
 	if (error)
 		goto err_cleanup_evdev;
 
+	evdev_debugfs_add(evdev);
+
 	return 0;
 
  err_cleanup_evdev:
@@ -1037,6 +1175,7 @@ static void evdev_disconnect(struct input_handle *handle)
 {
 	struct evdev *evdev = handle->private;
 
+	evdev_debugfs_remove(evdev);
 	device_del(&evdev->dev);
 	evdev_cleanup(evdev);
 	input_unregister_handle(handle);
@@ -1062,12 +1201,18 @@ static struct input_handler evdev_handler = {
 
 static int __init evdev_init(void)
 {
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	evdev_debugfs_root = debugfs_create_dir("evdev", NULL);
+#endif
 	return input_register_handler(&evdev_handler);
 }
 
 static void __exit evdev_exit(void)
 {
 	input_unregister_handler(&evdev_handler);
+#ifdef CONFIG_INPUT_EVDEV_LATENCY
+	debugfs_remove(evdev_debugfs_root);
+#endif
 }
 
 module_init(evdev_init);
@@ -33,6 +33,7 @@
 #include <linux/stat.h>
 #include <linux/string.h>
 #include <linux/firmware.h>
+#include <linux/sched.h>
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/earlysuspend.h>
 #endif
@@ -40,6 +41,9 @@
 #include <linux/time.h>
 #endif
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/atmxt.h>
+
 static int atmxt_probe(struct i2c_client *client,
 		const struct i2c_device_id *id);
 static int atmxt_remove(struct i2c_client *client);
@@ -64,6 +68,7 @@ static int atmxt_register_inputs(struct atmxt_driver_data *dd);
 static int atmxt_request_irq(struct atmxt_driver_data *dd);
 static int atmxt_restart_ic(struct atmxt_driver_data *dd,
 		struct touch_firmware *fw, bool force_fw_upgrade);
+static irqreturn_t atmxt_irq_handler(int irq, void *handle);
 static irqreturn_t atmxt_isr(int irq, void *handle);
 static int atmxt_get_info_header(struct atmxt_driver_data *dd);
 static int atmxt_get_object_table(struct atmxt_driver_data *dd);
@@ -85,6 +90,8 @@ static int atmxt_i2c_write(struct atmxt_driver_data *dd,
 		uint8_t addr_lo, uint8_t addr_hi,
 		const uint8_t *buf, int size);
 static int atmxt_i2c_read(struct atmxt_driver_data *dd, uint8_t *buf, int size);
+static int atmxt_i2c_read_addr(struct atmxt_driver_data *dd,
+		uint8_t addr_lo, uint8_t addr_hi, uint8_t *buf, int size);
 static void atmxt_check_useful_addr(struct atmxt_driver_data *dd,
 		uint8_t *entry);
 static int atmxt_set_useful_data(struct atmxt_driver_data *dd);
@@ -212,6 +219,7 @@ static int atmxt_probe(struct i2c_client *client,
 	dd->es.level = EARLY_SUSPEND_LEVEL_DISABLE_FB;
 	dd->es.suspend = atmxt_early_suspend;
 	dd->es.resume = atmxt_late_resume;
+	dd->es.resume_async = true;
 	register_early_suspend(&dd->es);
 #endif
 
@@ -542,6 +550,9 @@ static void atmxt_free(struct atmxt_driver_data *dd)
 			dd->dbg = NULL;
 		}
 
+		kfree(dd->msg_buf);
+		dd->msg_buf = NULL;
+
 		kfree(dd);
 		dd = NULL;
 	}
@@ -777,7 +788,8 @@ static int atmxt_request_irq(struct atmxt_driver_data *dd)
 		goto atmxt_request_irq_fail;
 	}
 
-	err = request_threaded_irq(dd->client->irq, NULL, atmxt_isr,
+	dd->irq_prio_set = false;
+	err = request_threaded_irq(dd->client->irq, atmxt_irq_handler, atmxt_isr,
 			IRQF_TRIGGER_LOW | IRQF_ONESHOT, ATMXT_I2C_NAME, dd);
 	if (err < 0) {
 		printk(KERN_ERR "%s: IRQ request failed.\n", __func__);
@@ -1070,11 +1082,29 @@ atmxt_restart_ic_fail:
 	return err;
 }
 
+static irqreturn_t atmxt_irq_handler(int irq, void *handle)
+{
+	struct atmxt_driver_data *dd = handle;
+
+	/* Stamp the touch here, before the thread gets scheduled */
+	dd->irq_time = ktime_get();
+	trace_atmxt_irq(irq);
+
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t atmxt_isr(int irq, void *handle)
 {
 	struct atmxt_driver_data *dd = handle;
 	int drv_state;
 	int ic_state;
+	struct sched_param param = { .sched_priority = ATMXT_IRQ_THREAD_PRIO };
+
+	/* Run ahead of the other IRQ threads, which all share one priority */
+	if (!dd->irq_prio_set) {
+		sched_setscheduler(current, SCHED_FIFO, &param);
+		dd->irq_prio_set = true;
+	}
 
 	mutex_lock(dd->mutex);
 
@@ -1871,6 +1901,60 @@ static int atmxt_i2c_read(struct atmxt_driver_data *dd, uint8_t *buf, int size)
 	return err;
 }
 
+/* Sets the address pointer and reads with a repeated start */
+static int atmxt_i2c_read_addr(struct atmxt_driver_data *dd,
+		uint8_t addr_lo, uint8_t addr_hi, uint8_t *buf, int size)
+{
+	int err = 0;
+	int i = 0;
+	uint8_t addr[2] = {addr_lo, addr_hi};
+	char *str = NULL;
+	struct i2c_msg msgs[] = {
+		{
+			.addr = dd->client->addr,
+			.flags = 0,
+			.len = sizeof(addr),
+			.buf = addr,
+		},
+		{
+			.addr = dd->client->addr,
+			.flags = I2C_M_RD,
+			.len = size,
+			.buf = buf,
+		},
+	};
+
+	for (i = 1; i <= ATMXT_I2C_ATTEMPTS; i++) {
+		err = i2c_transfer(dd->client->adapter, msgs, ARRAY_SIZE(msgs));
+		if (err < 0) {
+			printk(KERN_ERR
+				"%s: %s %d, failed with error code %d.\n",
+				__func__, "On I2C read attempt", i, err);
+		} else if (err < ARRAY_SIZE(msgs)) {
+			printk(KERN_ERR
+				"%s: %s %d, transferred %d of %d messages.\n",
+				__func__, "On I2C read attempt", i, err,
+				ARRAY_SIZE(msgs));
+			err = -EBADE;
+		} else {
+			break;
+		}
+
+		udelay(ATMXT_I2C_WAIT_TIME);
+	}
+
+	if (err < 0)
+		printk(KERN_ERR "%s: I2C read failed.\n", __func__);
+
+#ifdef CONFIG_TOUCHSCREEN_DEBUG
+	str = atmxt_msg2str(buf, size);
+#endif
+	atmxt_dbg(dd, ATMXT_DBG1, "%s: %s\n", __func__, str);
+	kfree(str);
+
+	return err;
+}
+
 static void atmxt_check_useful_addr(struct atmxt_driver_data *dd,
 		uint8_t *entry)
 {
@@ -1901,6 +1985,11 @@ static void atmxt_check_useful_addr(struct atmxt_driver_data *dd,
 
 		break;
 
+	case 44:
+		dd->addr->msg_cnt[0] = entry[1];
+		dd->addr->msg_cnt[1] = entry[2];
+		break;
+
 	case 7:
 		dd->addr->pwr[0] = entry[1];
 		dd->addr->pwr[1] = entry[2];
@@ -1949,6 +2038,16 @@ static int atmxt_set_useful_data(struct atmxt_driver_data *dd)
 
 	dd->data->max_msg_size = entry[3];
 
+	/*
+	 * The message count object sits right in front of the message
+	 * processor, so the count and the messages can be read together.
+	 */
+	dd->data->use_msg_cnt = false;
+	entry = atmxt_get_entry(dd, 44);
+	if (entry != NULL && (((entry[2] << 8) | entry[1]) + 1) ==
+		((dd->addr->msg[1] << 8) | dd->addr->msg[0]))
+		dd->data->use_msg_cnt = true;
+
 	obj = atmxt_get_obj(dd, 7);
 	if (obj == NULL) {
 		printk(KERN_ERR "%s: Power object is missing.\n", __func__);
@@ -2182,22 +2281,57 @@ static void atmxt_compute_partial_checksum(uint8_t *byte1, uint8_t *byte2,
 	return;
 }
 
+static uint8_t *atmxt_get_msg_buf(struct atmxt_driver_data *dd, int size)
+{
+	uint8_t *buf = NULL;
+
+	if (size > dd->msg_buf_size) {
+		buf = krealloc(dd->msg_buf, size, GFP_KERNEL);
+		if (buf == NULL)
+			return NULL;
+		dd->msg_buf = buf;
+		dd->msg_buf_size = size;
+	}
+
+	return dd->msg_buf;
+}
+
+static bool atmxt_is_touch_msg(struct atmxt_driver_data *dd, uint8_t *msg)
+{
+	return msg[0] <= (dd->info_blk->id_size-1) &&
+		dd->info_blk->msg_id[msg[0]] == 9;
+}
+
+/*
+ * Reads the pending messages with as few transfers as possible: the
+ * expected number of messages, preceded by the message count when the IC
+ * has one, in a single burst, and only if the count says there are more,
+ * the rest in a second one.  Touches are reported as soon as the last
+ * touch message is parsed, ahead of any other message.
+ */
 static void atmxt_active_handler(struct atmxt_driver_data *dd)
 {
 	int err = 0;
 	int i = 0;
 	uint8_t *msg_buf = NULL;
+	uint8_t *msgs = NULL;
 	int size = 0;
 	char *contents = NULL;
 	bool msg_fail = false;
 	int last_err = 0;
 	int msg_size = 0;
+	int cnt_size = 0;
+	int num = 0;
+	int pending = 0;
+	int last_touch = -1;
 
 	atmxt_dbg(dd, ATMXT_DBG3, "%s: Starting active handler...\n", __func__);
 
 	msg_size = dd->data->max_msg_size;
-	size = (dd->rdat->active_touches + 1) * msg_size;
-	msg_buf = kzalloc(sizeof(uint8_t) * size, GFP_KERNEL);
+	cnt_size = dd->data->use_msg_cnt ? 1 : 0;
+	num = dd->rdat->active_touches + 1;
+	size = cnt_size + (num * msg_size);
+	msg_buf = atmxt_get_msg_buf(dd, size);
 	if (msg_buf == NULL) {
 		printk(KERN_ERR
 			"%s: Unable to allocate memory for message buffer.\n",
@@ -2206,29 +2340,71 @@ static void atmxt_active_handler(struct atmxt_driver_data *dd)
 		goto atmxt_active_handler_fail;
 	}
 
-	err = atmxt_i2c_write(dd, dd->addr->msg[0], dd->addr->msg[1], NULL, 0);
-	if (err < 0) {
-		printk(KERN_ERR "%s: Failed to set message buffer pointer.\n",
-			__func__);
-		goto atmxt_active_handler_fail;
+	if (dd->data->use_msg_cnt) {
+		err = atmxt_i2c_read_addr(dd, dd->addr->msg_cnt[0],
+			dd->addr->msg_cnt[1], msg_buf, size);
+	} else {
+		err = atmxt_i2c_read_addr(dd, dd->addr->msg[0],
+			dd->addr->msg[1], msg_buf, size);
 	}
-
-	err = atmxt_i2c_read(dd, msg_buf, size);
 	if (err < 0) {
 		printk(KERN_ERR "%s: Failed to read messages.\n", __func__);
 		goto atmxt_active_handler_fail;
 	}
 
-	if (msg_buf[0] == 0xFF) {
-		contents = atmxt_msg2str(msg_buf, size);
+	if (dd->data->use_msg_cnt) {
+		pending = msg_buf[0];
+		if (pending > num) {
+			size = cnt_size + (pending * msg_size);
+			msg_buf = atmxt_get_msg_buf(dd, size);
+			if (msg_buf == NULL) {
+				printk(KERN_ERR "%s: %s.\n", __func__,
+					"Unable to grow message buffer");
+				err = -ENOMEM;
+				goto atmxt_active_handler_fail;
+			}
+
+			err = atmxt_i2c_read_addr(dd, dd->addr->msg[0],
+				dd->addr->msg[1],
+				&(msg_buf[cnt_size + (num * msg_size)]),
+				(pending - num) * msg_size);
+			if (err < 0) {
+				printk(KERN_ERR "%s: %s.\n", __func__,
+					"Failed to read remaining messages");
+				goto atmxt_active_handler_fail;
+			}
+			num = pending;
+		} else if (pending < num) {
+			num = pending;
+		}
+		size = num * msg_size;
+	} else {
+		size = num * msg_size;
+	}
+
+	msgs = &(msg_buf[cnt_size]);
+
+	if (size == 0) {
+		atmxt_dbg(dd, ATMXT_DBG3, "%s: No messages pending.\n",
+			__func__);
+		goto atmxt_active_handler_pass;
+	}
+
+	if (msgs[0] == 0xFF) {
+		contents = atmxt_msg2str(msgs, size);
 		printk(KERN_ERR "%s: Received invalid data:  %s.\n",
 			__func__, contents);
 		err = -EINVAL;
 		goto atmxt_active_handler_fail;
 	}
 
+	for (i = 0; i < size && msgs[i] != 0xFF; i += msg_size) {
+		if (atmxt_is_touch_msg(dd, &(msgs[i])))
+			last_touch = i;
+	}
+
 	for (i = 0; i < size; i += msg_size) {
-		if (msg_buf[i] == 0xFF) {
+		if (msgs[i] == 0xFF) {
 			atmxt_dbg(dd, ATMXT_DBG3, "%s: Finished processing.\n",
 				__func__);
 			break;
@@ -2237,7 +2413,7 @@ static void atmxt_active_handler(struct atmxt_driver_data *dd)
 		atmxt_dbg(dd, ATMXT_DBG3,
 			"%s: Processing message %d...\n", __func__,
 			(i + 1) / msg_size);
-		err = atmxt_process_message(dd, &(msg_buf[i]), msg_size);
+		err = atmxt_process_message(dd, &(msgs[i]), msg_size);
 		if (err < 0) {
 			printk(KERN_ERR
 				"%s: Processing message %d failed %s %d.\n",
@@ -2246,6 +2422,13 @@ static void atmxt_active_handler(struct atmxt_driver_data *dd)
 			msg_fail = true;
 			last_err = err;
 		}
+
+		if (i == last_touch &&
+			(dd->status & (1 << ATMXT_REPORT_TOUCHES))) {
+			input_set_timestamp(dd->in_dev, dd->irq_time);
+			atmxt_report_touches(dd);
+			dd->status = dd->status & ~(1 << ATMXT_REPORT_TOUCHES);
+		}
 	}
 
 	if (dd->status & (1 << ATMXT_FIXING_CALIBRATION)) {
@@ -2258,6 +2441,7 @@ static void atmxt_active_handler(struct atmxt_driver_data *dd)
 	}
 
 	if (dd->status & (1 << ATMXT_REPORT_TOUCHES)) {
+		input_set_timestamp(dd->in_dev, dd->irq_time);
 		atmxt_report_touches(dd);
 		dd->status = dd->status & ~(1 << ATMXT_REPORT_TOUCHES);
 	}
@@ -2274,7 +2458,6 @@ atmxt_active_handler_fail:
 		__func__, err);
 
 atmxt_active_handler_pass:
-	kfree(msg_buf);
 	kfree(contents);
 	return;
 }
@@ -2418,6 +2601,7 @@ static void atmxt_report_touches(struct atmxt_driver_data *dd)
 		input_mt_sync(dd->in_dev);
 
 	input_sync(dd->in_dev);
+	trace_atmxt_report(dd->rdat->active_touches, dd->irq_time);
 
 	return;
 }
@@ -60,6 +60,7 @@
 #define ATMXT_I2C_WAIT_TIME         50
 #define ATMXT_MAX_TOUCHES           10
 #define ATMXT_ABS_RESERVED          0xFFFF
+#define ATMXT_IRQ_THREAD_PRIO       (MAX_USER_RT_PRIO/2 + 10)
 
 
 enum atmxt_driver_state {
@@ -122,6 +123,7 @@ struct atmxt_info_block {
 
 struct atmxt_addr {
 	uint8_t         msg[2];
+	uint8_t         msg_cnt[2];
 	uint8_t         pwr[2];
 	uint8_t         rst[2];
 	uint8_t         nvm[2];
@@ -142,6 +144,7 @@ struct atmxt_data {
 	unsigned long   timer;
 	uint8_t         last_stat;
 	uint8_t         max_x;
+	bool            use_msg_cnt;
 } __packed;
 
 struct atmxt_touch_data {
@@ -193,6 +196,11 @@ struct atmxt_driver_data {
 
 	uint16_t        status;
 	uint16_t        settings;
+
+	uint8_t         *msg_buf;
+	int             msg_buf_size;
+	bool            irq_prio_set;
+	ktime_t         irq_time;
 } __packed;
 
 #endif /* _LINUX_ATMXT_H */
@@ -147,6 +147,12 @@ struct crypt_config {
 	sector_t iv_offset;
 	unsigned int iv_size;
 
+	/*
+	 * Bytes encrypted by one cipher request, with one IV.  The IV is
+	 * still derived from the 512 byte sector number of the first sector.
+	 */
+	unsigned int sector_size;
+
 	/*
 	 * Duplicated per cpu state. Access through
 	 * per_cpu_ptr() only.
@@ -695,29 +701,35 @@ static int crypt_convert_block(struct crypt_config *cc,
 	struct bio_vec *bv_in = bio_iovec_idx(ctx->bio_in, ctx->idx_in);
 	struct bio_vec *bv_out = bio_iovec_idx(ctx->bio_out, ctx->idx_out);
 	struct dm_crypt_request *dmreq;
+	unsigned int len = cc->sector_size;
 	u8 *iv;
 	int r = 0;
 
+	/* a crypto sector must not straddle two bio vectors */
+	if (unlikely((bv_in->bv_len & (len - 1)) ||
+		     (bv_out->bv_len & (len - 1))))
+		return -EIO;
+
 	dmreq = dmreq_of_req(cc, req);
 	iv = iv_of_dmreq(cc, dmreq);
 
 	dmreq->iv_sector = ctx->sector;
 	dmreq->ctx = ctx;
 	sg_init_table(&dmreq->sg_in, 1);
-	sg_set_page(&dmreq->sg_in, bv_in->bv_page, 1 << SECTOR_SHIFT,
+	sg_set_page(&dmreq->sg_in, bv_in->bv_page, len,
 		    bv_in->bv_offset + ctx->offset_in);
 
 	sg_init_table(&dmreq->sg_out, 1);
-	sg_set_page(&dmreq->sg_out, bv_out->bv_page, 1 << SECTOR_SHIFT,
+	sg_set_page(&dmreq->sg_out, bv_out->bv_page, len,
 		    bv_out->bv_offset + ctx->offset_out);
 
-	ctx->offset_in += 1 << SECTOR_SHIFT;
+	ctx->offset_in += len;
 	if (ctx->offset_in >= bv_in->bv_len) {
 		ctx->offset_in = 0;
 		ctx->idx_in++;
 	}
 
-	ctx->offset_out += 1 << SECTOR_SHIFT;
+	ctx->offset_out += len;
 	if (ctx->offset_out >= bv_out->bv_len) {
 		ctx->offset_out = 0;
 		ctx->idx_out++;
@@ -730,7 +742,7 @@ static int crypt_convert_block(struct crypt_config *cc,
 	}
 
 	ablkcipher_request_set_crypt(req, &dmreq->sg_in, &dmreq->sg_out,
-				     1 << SECTOR_SHIFT, iv);
+				     len, iv);
 
 	if (bio_data_dir(ctx->bio_in) == WRITE)
 		r = crypto_ablkcipher_encrypt(req);
@@ -789,13 +801,13 @@ static int crypt_convert(struct crypt_config *cc,
 			/* fall through*/
 		case -EINPROGRESS:
 			this_cc->req = NULL;
-			ctx->sector++;
+			ctx->sector += cc->sector_size >> SECTOR_SHIFT;
 			continue;
 
 		/* sync */
 		case 0:
 			atomic_dec(&ctx->pending);
-			ctx->sector++;
+			ctx->sector += cc->sector_size >> SECTOR_SHIFT;
 			cond_resched();
 			continue;
 
@@ -1579,9 +1591,10 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	struct crypt_config *cc;
 	unsigned int key_size;
 	unsigned long long tmpll;
+	unsigned int opt_params, i;
 	int ret;
 
-	if (argc != 5) {
+	if (argc < 5) {
 		ti->error = "Not enough arguments";
 		return -EINVAL;
 	}
@@ -1594,6 +1607,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		return -ENOMEM;
 	}
 	cc->key_size = key_size;
+	cc->sector_size = 1 << SECTOR_SHIFT;
 
 	ti->private = cc;
 	ret = crypt_ctr_cipher(ti, argv[0], argv[1]);
@@ -1650,6 +1664,44 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	}
 	cc->start = tmpll;
 
+	/* optional parameters: <#opt_params> <opt_params> */
+	if (argc > 5) {
+		if (sscanf(argv[5], "%u", &opt_params) != 1 ||
+		    opt_params != argc - 6) {
+			ti->error = "Invalid number of feature args";
+			goto bad;
+		}
+
+		for (i = 6; i < argc; i++) {
+			if (sscanf(argv[i], "sector_size:%u",
+				   &cc->sector_size) != 1) {
+				ti->error = "Invalid feature arguments";
+				goto bad;
+			}
+		}
+
+		if (cc->sector_size < (1 << SECTOR_SHIFT) ||
+		    cc->sector_size > PAGE_SIZE ||
+		    !is_power_of_2(cc->sector_size)) {
+			ti->error = "Invalid feature value for sector_size";
+			goto bad;
+		}
+	}
+
+	if (cc->sector_size != (1 << SECTOR_SHIFT)) {
+		sector_t mask = (cc->sector_size >> SECTOR_SHIFT) - 1;
+
+		/* LMK hashes exactly 512 bytes of each sector */
+		if (cc->iv_gen_ops == &crypt_iv_lmk_ops) {
+			ti->error = "sector_size is not supported with lmk";
+			goto bad;
+		}
+		if ((ti->begin | ti->len | cc->start | cc->iv_offset) & mask) {
+			ti->error = "Device or offset not aligned to sector_size";
+			goto bad;
+		}
+	}
+
 	ret = -ENOMEM;
 	cc->io_queue = alloc_workqueue("kcryptd_io",
 				       WQ_NON_REENTRANT|
@@ -1729,6 +1781,8 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
+		if (cc->sector_size != (1 << SECTOR_SHIFT))
+			DMEMIT(" 1 sector_size:%u", cc->sector_size);
 		break;
 	}
 	return 0;
@@ -1815,6 +1869,19 @@ static int crypt_merge(struct dm_target *ti, struct bvec_merge_data *bvm,
 	return min(max_size, q->merge_bvec_fn(q, bvm, biovec));
 }
 
+static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
+{
+	struct crypt_config *cc = ti->private;
+
+	/* the block layer then never splits a crypto sector */
+	limits->logical_block_size =
+		max_t(unsigned short, limits->logical_block_size,
+		      cc->sector_size);
+	limits->physical_block_size =
+		max_t(unsigned, limits->physical_block_size, cc->sector_size);
+	blk_limits_io_min(limits, cc->sector_size);
+}
+
 static int crypt_iterate_devices(struct dm_target *ti,
 				 iterate_devices_callout_fn fn, void *data)
 {
@@ -1825,7 +1892,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 10, 0},
+	.version = {1, 11, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -1837,6 +1904,7 @@ static struct target_type crypt_target = {
 	.message = crypt_message,
 	.merge  = crypt_merge,
 	.iterate_devices = crypt_iterate_devices,
+	.io_hints = crypt_io_hints,
 };
 
 static int __init dm_crypt_init(void)
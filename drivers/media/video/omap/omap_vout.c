@@ -300,33 +300,66 @@ static int omap_vout_try_format(struct v4l2_pix_format *pix)
 	return bpp;
 }
 
+/*
+ * Physical address of a pfn mapped user buffer, such as a buffer of this
+ * driver, of the frame buffer or of a carveout allocator mmapped by the
+ * application.  The whole buffer must be physically contiguous since DSS
+ * and the VRFB DMA read it in place.
+ */
+static u32 omap_vout_pfnmap_to_phys(struct vm_area_struct *vma, u32 virtp,
+				    u32 size)
+{
+	unsigned long addr, pfn, first_pfn = 0;
+	unsigned long start = virtp & PAGE_MASK;
+
+	if (virtp + size > vma->vm_end)
+		return 0;
+
+	for (addr = start; addr < virtp + size; addr += PAGE_SIZE) {
+		if (follow_pfn(vma, addr, &pfn))
+			return 0;
+		if (addr == start)
+			first_pfn = pfn;
+		else if (pfn != first_pfn + ((addr - start) >> PAGE_SHIFT))
+			return 0;
+	}
+
+	return (first_pfn << PAGE_SHIFT) + (virtp & ~PAGE_MASK);
+}
+
 /*
  * omap_vout_uservirt_to_phys: This inline function is used to convert user
  * space virtual address to physical address.
  */
-static u32 omap_vout_uservirt_to_phys(u32 virtp)
+static u32 omap_vout_uservirt_to_phys(u32 virtp, u32 size)
 {
 	unsigned long physp = 0;
 	struct vm_area_struct *vma;
 	struct mm_struct *mm = current->mm;
 
-	vma = find_vma(mm, virtp);
 	/* For kernel direct-mapped memory, take the easy way */
-	if (virtp >= PAGE_OFFSET) {
-		physp = virt_to_phys((void *) virtp);
-	} else if (vma && (vma->vm_flags & VM_IO) && vma->vm_pgoff) {
+	if (virtp >= PAGE_OFFSET)
+		return virt_to_phys((void *) virtp);
+
+	down_read(&mm->mmap_sem);
+	vma = find_vma(mm, virtp);
+	if (vma && vma->vm_start <= virtp &&
+	    (vma->vm_flags & (VM_IO | VM_PFNMAP))) {
 		/* this will catch, kernel-allocated, mmaped-to-usermode
 		   addresses */
-		physp = (vma->vm_pgoff << PAGE_SHIFT) + (virtp - vma->vm_start);
+		physp = omap_vout_pfnmap_to_phys(vma, virtp, size);
+		up_read(&mm->mmap_sem);
+		if (!physp)
+			printk(KERN_WARNING VOUT_NAME
+					"user buffer not contiguous\n");
 	} else {
 		/* otherwise, use get_user_pages() for general userland pages */
 		int res, nr_pages = 1;
 		struct page *pages;
-		down_read(&current->mm->mmap_sem);
 
-		res = get_user_pages(current, current->mm, virtp, nr_pages, 1,
+		res = get_user_pages(current, mm, virtp, nr_pages, 1,
 				0, &pages, NULL);
-		up_read(&current->mm->mmap_sem);
+		up_read(&mm->mmap_sem);
 
 		if (res == nr_pages) {
 			physp =  __pa(page_address(&pages[0]) +
@@ -1085,7 +1118,9 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 			return -EINVAL;
 		/* Physical address */
 		vout->queued_buf_addr[vb->i] = (u8 *)
-			omap_vout_uservirt_to_phys(vb->baddr);
+			omap_vout_uservirt_to_phys(vb->baddr, vb->size);
+		if (!vout->queued_buf_addr[vb->i])
+			return -EINVAL;
 	} else {
 		vout->queued_buf_addr[vb->i] = (u8 *)vout->buf_phy_addr[vb->i];
 	}
@@ -1093,7 +1128,8 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 	if (!rotation_enabled(vout))
 		return 0;
 
-	dmabuf = vout->buf_phy_addr[vb->i];
+	/* the application's own buffer for USERPTR, not a driver copy */
+	dmabuf = (dma_addr_t)vout->queued_buf_addr[vb->i];
 	/* If rotation is enabled, copy input buffer into VRFB
 	 * memory space using DMA. We are copying input buffer
 	 * into VRFB memory space of desired angle and DSS will
@@ -24,6 +24,8 @@
 #include <linux/errno.h>
 #include <linux/slab.h>
 #include <linux/delay.h>
+#include <linux/interrupt.h>
+#include <linux/completion.h>
 
 #include <mach/dmm.h>
 
@@ -40,10 +42,41 @@
 #define DEBUG(x, y)
 #endif
 
+/* PAT status and refill engine 0 interrupt bits */
+#define DMM_PAT_STATUS_ERR	0xFC00
+#define DMM_IRQSTAT_LST		(1 << 1)	/* last descriptor done */
+#define DMM_IRQSTAT_ERR_MASK	0x7C		/* descriptor/update errors */
+#define DMM_IRQ_CHAIN		(DMM_IRQSTAT_LST | DMM_IRQSTAT_ERR_MASK)
+
+#define DMM_REFILL_TIMEOUT_MS	100
+
 static struct mutex dmm_mtx;
 
 static struct omap_dmm_platform_data *device_data;
 
+/* chained refill completion, signalled from the DMM interrupt */
+static DECLARE_COMPLETION(dmm_refill_done);
+static u32 dmm_irq_status;
+static bool dmm_irq_ok;
+
+static irqreturn_t dmm_irq_handler(int irq, void *data)
+{
+	void __iomem *base = device_data->base;
+	u32 status = __raw_readl(base + DMM_PAT_IRQSTATUS);
+
+	if (!status)
+		return IRQ_NONE;
+	__raw_writel(status, base + DMM_PAT_IRQSTATUS);
+
+	/* only refill engine 0 is used */
+	if (status & DMM_IRQ_CHAIN) {
+		dmm_irq_status = status;
+		complete(&dmm_refill_done);
+	}
+
+	return IRQ_HANDLED;
+}
+
 static int dmm_probe(struct platform_device *pdev)
 {
 	if (!pdev || !pdev->dev.platform_data) {
@@ -58,6 +91,13 @@ static int dmm_probe(struct platform_device *pdev)
 	writel(0x88888888, device_data->base + DMM_TILER_OR__0);
 	writel(0x88888888, device_data->base + DMM_TILER_OR__1);
 
+	/* without the interrupt only manual refills are available */
+	__raw_writel(0xFFFFFFFF, device_data->base + DMM_PAT_IRQENABLE_CLR);
+	if (request_irq(device_data->irq, dmm_irq_handler, 0, "dmm", NULL))
+		printk(KERN_WARNING "dmm: no irq, chained refill disabled\n");
+	else
+		dmm_irq_ok = true;
+
 	return 0;
 }
 
@@ -210,6 +250,67 @@ refill_error:
 }
 EXPORT_SYMBOL(dmm_pat_refill);
 
+s32 dmm_pat_refill_chain(struct dmm *dmm, u32 desc_pa)
+{
+	s32 ret = 0;
+	void __iomem *r;
+	u32 v;
+
+	if (!dmm_irq_ok)
+		return -ENODEV;
+
+	/* descriptors must be 16 aligned */
+	BUG_ON(desc_pa & 15);
+
+	mutex_lock(&dmm_mtx);
+
+	r = dmm->base + DMM_PAT_STATUS__0;
+	v = __raw_readl(r);
+	if (WARN(v & DMM_PAT_STATUS_ERR,
+		 KERN_ERR "Abort dmm refill, bad status\n")) {
+		ret = -EIO;
+		goto refill_error;
+	}
+
+	INIT_COMPLETION(dmm_refill_done);
+	__raw_writel(0xFFFFFFFF, dmm->base + DMM_PAT_IRQSTATUS);
+	__raw_writel(DMM_IRQ_CHAIN, dmm->base + DMM_PAT_IRQENABLE_SET);
+
+	/* descriptors must reach memory before the engine fetches them */
+	wmb();
+
+	/* kick the engine, it walks the chain through the next pointers */
+	r = dmm->base + DMM_PAT_DESCR__0;
+	v = __raw_readl(r);
+	v = SET_FLD(v, 31, 4, desc_pa >> 4);
+	__raw_writel(v, r);
+
+	if (!wait_for_completion_timeout(&dmm_refill_done,
+				msecs_to_jiffies(DMM_REFILL_TIMEOUT_MS))) {
+		printk(KERN_ERR "dmm: chained PAT refill timed out\n");
+		ret = -ETIMEDOUT;
+	} else if (dmm_irq_status & DMM_IRQSTAT_ERR_MASK) {
+		printk(KERN_ERR "dmm: chained PAT refill failed (0x%x)\n",
+			dmm_irq_status);
+		ret = -EIO;
+	}
+
+	__raw_writel(DMM_IRQ_CHAIN, dmm->base + DMM_PAT_IRQENABLE_CLR);
+
+	/* set "next" register to NULL to clear any PAT STATUS errors */
+	if (ret) {
+		v = __raw_readl(r);
+		v = SET_FLD(v, 31, 4, (u32) NULL);
+		__raw_writel(v, r);
+	}
+
+refill_error:
+	mutex_unlock(&dmm_mtx);
+
+	return ret;
+}
+EXPORT_SYMBOL(dmm_pat_refill_chain);
+
 struct dmm *dmm_pat_init(u32 id)
 {
 	u32 base;
@@ -266,6 +367,8 @@ static s32 __init dmm_init(void)
 
 static void __exit dmm_exit(void)
 {
+	if (dmm_irq_ok)
+		free_irq(device_data->irq, NULL);
 	mutex_destroy(&dmm_mtx);
 	platform_driver_unregister(&dmm_driver_ldm);
 }
@@ -70,6 +70,7 @@ struct tcm {
 	s32 (*reserve_1d)(struct tcm *tcm, u32 slots, struct tcm_area *area);
 	s32 (*free)      (struct tcm *tcm, struct tcm_area *area);
 	void (*deinit)   (struct tcm *tcm);
+	u32 (*max_free_1d)(struct tcm *tcm);	/* optional */
 };
 
 /*=============================================================================
@@ -216,6 +217,19 @@ static inline s32 tcm_free(struct tcm_area *area)
 	return res;
 }
 
+/**
+ * Largest 1D area that could currently be reserved.
+ *
+ * @param tcm	Pointer to container manager.
+ *
+ * @return Number of slots in the longest run of free slots, or 0 if the
+ *	   manager does not keep track of it.
+ */
+static inline u32 tcm_max_free_1d(struct tcm *tcm)
+{
+	return tcm && tcm->max_free_1d ? tcm->max_free_1d(tcm) : 0;
+}
+
 /*=============================================================================
     HELPER FUNCTION FOR ANY TILER CONTAINER MANAGER
 =============================================================================*/
@@ -80,6 +80,8 @@ struct sita_pvt {
 	struct mutex mtx;
 	struct tcm_pt div_pt;	/* divider point splitting container */
 	struct tcm_area ***map;	/* pointers to the parent area for each slot */
+	u16 *run;		/* per slot, row-major: number of free slots
+				   from it to the right, 0 if it is busy */
 };
 
 #endif
@@ -46,6 +46,7 @@ static s32 sita_reserve_2d(struct tcm *tcm, u16 h, u16 w, u8 align,
 static s32 sita_reserve_1d(struct tcm *tcm, u32 slots, struct tcm_area *area);
 static s32 sita_free(struct tcm *tcm, struct tcm_area *area);
 static void sita_deinit(struct tcm *tcm);
+static u32 sita_max_free_1d(struct tcm *tcm);
 
 /*********************************************
  *	Main Scanner functions
@@ -72,7 +73,7 @@ static s32 scan_r2l_b2t_one_dim(struct tcm *tcm, u32 num_slots,
 /*********************************************
  *	Support Infrastructure Methods
  *********************************************/
-static s32 is_area_free(struct tcm_area ***map, u16 x0, u16 y0, u16 w, u16 h);
+static s32 area_blocker(struct tcm *tcm, u16 x0, u16 y0, u16 w, u16 h);
 
 static s32 update_candidate(struct tcm *tcm, u16 x0, u16 y0, u16 w, u16 h,
 			    struct tcm_area *field, s32 criteria,
@@ -118,6 +119,7 @@ struct tcm *sita_init(u16 width, u16 height, struct tcm_pt *attr)
 	tcm->reserve_1d = sita_reserve_1d;
 	tcm->free = sita_free;
 	tcm->deinit = sita_deinit;
+	tcm->max_free_1d = sita_max_free_1d;
 	tcm->pvt = (void *)pvt;
 
 	mutex_init(&(pvt->mtx));
@@ -139,6 +141,16 @@ struct tcm *sita_init(u16 width, u16 height, struct tcm_pt *attr)
 		}
 	}
 
+	/* Free run lengths, to skip busy slots when scanning */
+	pvt->run = kmalloc(sizeof(*pvt->run) * tcm->width * tcm->height,
+			   GFP_KERNEL);
+	if (!pvt->run) {
+		for (i = 0; i < tcm->width; i++)
+			kfree(pvt->map[i]);
+		kfree(pvt->map);
+		goto error;
+	}
+
 	if (attr && attr->x <= tcm->width && attr->y <= tcm->height) {
 		pvt->div_pt.x = attr->x;
 		pvt->div_pt.y = attr->y;
@@ -180,6 +192,7 @@ static void sita_deinit(struct tcm *tcm)
 	for (i = 0; i < tcm->height; i++)
 		kfree(pvt->map[i]);
 	kfree(pvt->map);
+	kfree(pvt->run);
 	kfree(pvt);
 }
 
@@ -216,6 +229,39 @@ static s32 sita_reserve_1d(struct tcm *tcm, u32 num_slots,
 	return ret;
 }
 
+/**
+ * Find the longest run of free slots where 1D areas are reserved, in the
+ * same field and raster order as sita_reserve_1d() scans.
+ *
+ * @param tcm	Pointer to container manager.
+ *
+ * @return Number of slots in the run.
+ */
+static u32 sita_max_free_1d(struct tcm *tcm)
+{
+	struct sita_pvt *pvt = (struct sita_pvt *)tcm->pvt;
+	u32 run = 0, max = 0;
+	u16 x, y, y0 = 0;
+
+#ifdef RESTRICT_1D
+	y0 = pvt->div_pt.y;
+#endif
+	mutex_lock(&(pvt->mtx));
+	for (y = y0; y < tcm->height; y++) {
+		for (x = 0; x < tcm->width; x++) {
+			if (pvt->map[x][y]) {
+				run = 0;
+				continue;
+			}
+			if (++run > max)
+				max = run;
+		}
+	}
+	mutex_unlock(&(pvt->mtx));
+
+	return max;
+}
+
 /**
  * Reserve a 2D area in the container
  *
@@ -295,9 +341,8 @@ static s32 sita_free(struct tcm *tcm, struct tcm_area *area)
 static s32 scan_r2l_t2b(struct tcm *tcm, u16 w, u16 h, u16 align,
 			struct tcm_area *field, struct tcm_area *area)
 {
-	s32 x, y;
+	s32 x, y, blocker;
 	s16 start_x, end_x, start_y, end_y, found_x = -1;
-	struct tcm_area ***map = ((struct sita_pvt *)tcm->pvt)->map;
 	struct score best = {{0}, {0}, {0}, 0};
 
 	PA(2, "scan_r2l_t2b:", field);
@@ -329,7 +374,8 @@ static s32 scan_r2l_t2b(struct tcm *tcm, u16 w, u16 h, u16 align,
 	/* scan field top-to-bottom, right-to-left */
 	for (y = start_y; y <= end_y; y++) {
 		for (x = start_x; x >= end_x; x -= align) {
-			if (is_area_free(map, x, y, w, h)) {
+			blocker = area_blocker(tcm, x, y, w, h);
+			if (blocker < 0) {
 				P3("found shoulder: %d,%d", x, y);
 				found_x = x;
 
@@ -343,9 +389,9 @@ static s32 scan_r2l_t2b(struct tcm *tcm, u16 w, u16 h, u16 align,
 				end_x = x + 1;
 #endif
 				break;
-			} else if (map[x][y] && map[x][y]->is2d) {
-				/* step over 2D areas */
-				x = ALIGN(map[x][y]->p0.x - w + 1, align);
+			} else {
+				/* step to the left of the busy slot */
+				x = ALIGN_DOWN(blocker - w, align) + align;
 				P3("moving to: %d,%d", x, y);
 			}
 		}
@@ -382,9 +428,8 @@ static s32 scan_r2l_b2t(struct tcm *tcm, u16 w, u16 h, u16 align,
 	/* TODO: Should I check scan area?
 	 * Might have to take it as input during initialization
 	 */
-	s32 x, y;
+	s32 x, y, blocker;
 	s16 start_x, end_x, start_y, end_y, found_x = -1;
-	struct tcm_area ***map = ((struct sita_pvt *)tcm->pvt)->map;
 	struct score best = {{0}, {0}, {0}, 0};
 
 	PA(2, "scan_r2l_b2t:", field);
@@ -416,7 +461,8 @@ static s32 scan_r2l_b2t(struct tcm *tcm, u16 w, u16 h, u16 align,
 	/* scan field bottom-to-top, right-to-left */
 	for (y = start_y; y >= end_y; y--) {
 		for (x = start_x; x >= end_x; x -= align) {
-			if (is_area_free(map, x, y, w, h)) {
+			blocker = area_blocker(tcm, x, y, w, h);
+			if (blocker < 0) {
 				P3("found shoulder: %d,%d", x, y);
 				found_x = x;
 
@@ -429,9 +475,9 @@ static s32 scan_r2l_b2t(struct tcm *tcm, u16 w, u16 h, u16 align,
 				end_x = x + 1;
 #endif
 				break;
-			} else if (map[x][y] && map[x][y]->is2d) {
-				/* step over 2D areas */
-				x = ALIGN(map[x][y]->p0.x - w + 1, align);
+			} else {
+				/* step to the left of the busy slot */
+				x = ALIGN_DOWN(blocker - w, align) + align;
 				P3("moving to: %d,%d", x, y);
 			}
 		}
@@ -465,9 +511,8 @@ done:
 static s32 scan_l2r_t2b(struct tcm *tcm, u16 w, u16 h, u16 align,
 			struct tcm_area *field, struct tcm_area *area)
 {
-	s32 x, y;
+	s32 x, y, blocker;
 	s16 start_x, end_x, start_y, end_y, found_x = -1;
-	struct tcm_area ***map = ((struct sita_pvt *)tcm->pvt)->map;
 	struct score best = {{0}, {0}, {0}, 0};
 
 	PA(2, "scan_l2r_t2b:", field);
@@ -501,7 +546,8 @@ static s32 scan_l2r_t2b(struct tcm *tcm, u16 w, u16 h, u16 align,
 	/* scan field top-to-bottom, left-to-right */
 	for (y = start_y; y <= end_y; y++) {
 		for (x = start_x; x <= end_x; x += align) {
-			if (is_area_free(map, x, y, w, h)) {
+			blocker = area_blocker(tcm, x, y, w, h);
+			if (blocker < 0) {
 				P3("found shoulder: %d,%d", x, y);
 				found_x = x;
 
@@ -514,9 +560,9 @@ static s32 scan_l2r_t2b(struct tcm *tcm, u16 w, u16 h, u16 align,
 				end_x = x - 1;
 #endif
 				break;
-			} else if (map[x][y] && map[x][y]->is2d) {
-				/* step over 2D areas */
-				x = ALIGN_DOWN(map[x][y]->p1.x, align);
+			} else {
+				/* step to the right of the busy slot */
+				x = ALIGN(blocker + 1, align) - align;
 				P3("moving to: %d,%d", x, y);
 			}
 		}
@@ -550,9 +596,8 @@ done:
 static s32 scan_l2r_b2t(struct tcm *tcm, u16 w, u16 h, u16 align,
 			struct tcm_area *field, struct tcm_area *area)
 {
-	s32 x, y;
+	s32 x, y, blocker;
 	s16 start_x, end_x, start_y, end_y, found_x = -1;
-	struct tcm_area ***map = ((struct sita_pvt *)tcm->pvt)->map;
 	struct score best = {{0}, {0}, {0}, 0};
 
 	PA(2, "scan_l2r_b2t:", field);
@@ -586,7 +631,8 @@ static s32 scan_l2r_b2t(struct tcm *tcm, u16 w, u16 h, u16 align,
 	/* scan field bottom-to-top, left-to-right */
 	for (y = start_y; y >= end_y; y--) {
 		for (x = start_x; x <= end_x; x += align) {
-			if (is_area_free(map, x, y, w, h)) {
+			blocker = area_blocker(tcm, x, y, w, h);
+			if (blocker < 0) {
 				P3("found shoulder: %d,%d", x, y);
 				found_x = x;
 
@@ -599,9 +645,9 @@ static s32 scan_l2r_b2t(struct tcm *tcm, u16 w, u16 h, u16 align,
 				end_x = x - 1;
 #endif
 				break;
-			} else if (map[x][y] && map[x][y]->is2d) {
-				/* step over 2D areas */
-				x = ALIGN_DOWN(map[x][y]->p1.x, align);
+			} else {
+				/* step to the right of the busy slot */
+				x = ALIGN(blocker + 1, align) - align;
 				P3("moving to: %d,%d", x, y);
 			}
 		}
@@ -769,17 +815,36 @@ static s32 scan_areas_and_find_fit(struct tcm *tcm, u16 w, u16 h, u16 align,
 	return ret;
 }
 
-/* check if an entire area is free */
-static s32 is_area_free(struct tcm_area ***map, u16 x0, u16 y0, u16 w, u16 h)
+/**
+ * Check if an entire area is free, from the free run lengths of its rows.
+ *
+ * @return -1 if it is, otherwise the column of a busy slot in the area:
+ *	   scans can skip all positions that would cover it.
+ */
+static s32 area_blocker(struct tcm *tcm, u16 x0, u16 y0, u16 w, u16 h)
+{
+	struct sita_pvt *pvt = (struct sita_pvt *)tcm->pvt;
+	u16 *run = pvt->run + y0 * tcm->width + x0;
+	u16 y;
+
+	for (y = 0; y < h; y++, run += tcm->width)
+		if (*run < w)
+			return x0 + *run;
+	return -1;
+}
+
+/* recompute the free run lengths of a row after the map changed */
+static void update_runs(struct tcm *tcm, u16 y)
 {
-	u16 x = 0, y = 0;
-	for (y = y0; y < y0 + h; y++) {
-		for (x = x0; x < x0 + w; x++) {
-			if (map[x][y])
-				return false;
-		}
+	struct sita_pvt *pvt = (struct sita_pvt *)tcm->pvt;
+	u16 *run = pvt->run + y * tcm->width;
+	u16 free = 0;
+	s32 x;
+
+	for (x = tcm->width - 1; x >= 0; x--) {
+		free = pvt->map[x][y] ? 0 : free + 1;
+		run[x] = free;
 	}
-	return true;
 }
 
 /* fills an area with a parent tcm_area */
@@ -800,6 +865,9 @@ static void fill_area(struct tcm *tcm, struct tcm_area *area,
 				pvt->map[x][y] = parent;
 
 	}
+
+	for (y = area->p0.y; y <= area->p1.y; ++y)
+		update_runs(tcm, y);
 }
 
 /**
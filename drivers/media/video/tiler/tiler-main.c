@@ -82,32 +82,42 @@ static DEFINE_MUTEX(dmac_mtx);
  *  TMM connectors
  *  ==========================================================================
  */
+/* a 1D area is made up of at most 3 2D slices */
+#define TILER_MAX_SLICES 3
+
 /* wrapper around tmm_pin */
 static s32 pin_mem_to_area(struct tmm *tmm, struct tcm_area *area, u32 *ptr)
 {
 	s32 res = 0;
-	struct pat_area p_area = {0};
+	struct pat_area p_area[TILER_MAX_SLICES];
+	u32 pages_pa[TILER_MAX_SLICES];
 	struct tcm_area slice, area_s;
-
-	/* Ensure the data reaches to main memory before PAT refill */
-	wmb();
+	u32 n = 0, ofs = 0;
 
 	mutex_lock(&dmac_mtx);
 	tcm_for_each_slice(slice, *area, area_s) {
-		p_area.x0 = slice.p0.x;
-		p_area.y0 = slice.p0.y;
-		p_area.x1 = slice.p1.x;
-		p_area.y1 = slice.p1.y;
+		p_area[n].x0 = slice.p0.x;
+		p_area[n].y0 = slice.p0.y;
+		p_area[n].x1 = slice.p1.x;
+		p_area[n].y1 = slice.p1.y;
 
-		memcpy(dmac_va, ptr, sizeof(*ptr) * tcm_sizeof(slice));
+		/*
+		 * Each slice gets its own 16-byte aligned page list.  Only the
+		 * first slice needs padding, and that never exceeds p0.x, so
+		 * the lists still fit in dmac_va.
+		 */
+		memcpy(dmac_va + ofs, ptr, sizeof(*ptr) * tcm_sizeof(slice));
+		pages_pa[n++] = dmac_pa + ofs * sizeof(*dmac_va);
 		ptr += tcm_sizeof(slice);
-
-		/* pin memory into DMM */
-		if (tmm_pin(tmm, p_area, dmac_pa)) {
-			res = -EFAULT;
-			break;
-		}
+		ofs += ALIGN(tcm_sizeof(slice), 4);
 	}
+
+	/* Ensure the data reaches to main memory before PAT refill */
+	wmb();
+
+	/* pin all slices into DMM in one refill */
+	if (tmm_pin_n(tmm, n, p_area, pages_pa))
+		res = -EFAULT;
 	mutex_unlock(&dmac_mtx);
 
 	return res;
@@ -1872,6 +1882,12 @@ u32 tiler_block_vsize(tiler_blk_handle block)
 }
 EXPORT_SYMBOL(tiler_block_vsize);
 
+u32 tiler_max_free_1d(void)
+{
+	return tcm_max_free_1d(tcm[TILFMT_PAGE]) * PAGE_SIZE;
+}
+EXPORT_SYMBOL(tiler_max_free_1d);
+
 MODULE_LICENSE("GPL v2");
 MODULE_AUTHOR("Lajos Molnar <molnar@ti.com>");
 MODULE_AUTHOR("David Sin <davidsin@ti.com>");
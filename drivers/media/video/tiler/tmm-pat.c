@@ -23,6 +23,7 @@
 #include <linux/mutex.h>
 #include <linux/list.h>
 #include <linux/slab.h>
+#include <linux/dma-mapping.h>
 
 #include "tmm.h"
 
@@ -42,6 +43,9 @@ static u32 total_mem;		/* total memory allocated (free & used) */
 static u32 refs;		/* number of tmm_pat instances */
 static DEFINE_MUTEX(mtx);	/* global mutex */
 
+/* max. number of PAT descriptors programmed in one chained refill */
+#define TMM_PAT_MAX_DESC	16
+
 /* The page struct pointer and physical address of each page.*/
 struct mem {
 	struct list_head list;
@@ -65,6 +69,8 @@ struct dmm_mem {
 	u32 dmac_pa;		/* phys.addr of coherent memory */
 	struct page *dummy_pg;	/* dummy page */
 	u32 dummy_pa;		/* phys.addr of dummy page */
+	struct pat *desc_va;	/* coherent PAT descriptor chain */
+	dma_addr_t desc_pa;	/* phys.addr of descriptor chain */
 };
 
 /* read mem values for a param */
@@ -168,6 +174,9 @@ static void tmm_pat_deinit(struct tmm *tmm)
 		free_page_cache();
 
 	__free_page(pvt->dummy_pg);
+	if (pvt->desc_va)
+		dma_free_coherent(NULL, TMM_PAT_MAX_DESC * sizeof(struct pat),
+				  pvt->desc_va, pvt->desc_pa);
 
 	mutex_unlock(&mtx);
 }
@@ -268,6 +277,36 @@ static s32 tmm_pat_pin(struct tmm *tmm, struct pat_area area, u32 page_pa)
 	return dmm_pat_refill(pvt->dmm, &pat_desc, MANUAL);
 }
 
+/* callers serialize use of the descriptor chain (and the page lists) */
+static s32 tmm_pat_pin_n(struct tmm *tmm, u32 n, struct pat_area *areas,
+			 u32 *pages_pa)
+{
+	struct dmm_mem *pvt = (struct dmm_mem *) tmm->pvt;
+	struct pat *d;
+	s32 res = -ENODEV;
+	u32 i;
+
+	if (pvt->desc_va && n <= TMM_PAT_MAX_DESC) {
+		for (i = 0; i < n; i++) {
+			d = pvt->desc_va + i;
+			memset(d, 0, sizeof(*d));
+			/* the engine follows physical addresses */
+			d->next = (i + 1 < n) ? (struct pat *)
+				(pvt->desc_pa + (i + 1) * sizeof(*d)) : NULL;
+			d->area = areas[i];
+			d->ctrl.start = 1;
+			d->data = pages_pa[i];
+		}
+		res = dmm_pat_refill_chain(pvt->dmm, pvt->desc_pa);
+	}
+
+	/* fall back to one manual refill per area */
+	if (res == -ENODEV)
+		for (i = 0, res = 0; !res && i < n; i++)
+			res = tmm_pat_pin(tmm, areas[i], pages_pa[i]);
+	return res;
+}
+
 static void tmm_pat_unpin(struct tmm *tmm, struct pat_area area)
 {
 	u16 w = (u8) area.x1 - (u8) area.x0;
@@ -300,6 +339,11 @@ struct tmm *tmm_pat_init(u32 pat_id, u32 *dmac_va, u32 dmac_pa)
 		pvt->dmac_va = dmac_va;
 		pvt->dummy_pa = page_to_phys(pvt->dummy_pg);
 
+		/* chained refill is optional, pin_n falls back without it */
+		pvt->desc_va = dma_alloc_coherent(NULL,
+				TMM_PAT_MAX_DESC * sizeof(struct pat),
+				&pvt->desc_pa, GFP_KERNEL);
+
 		INIT_LIST_HEAD(&pvt->fast_list);
 
 		/* increate tmm_pat references */
@@ -313,6 +357,7 @@ struct tmm *tmm_pat_init(u32 pat_id, u32 *dmac_va, u32 dmac_pa)
 		tmm->get = tmm_pat_get_pages;
 		tmm->free = tmm_pat_free_pages;
 		tmm->pin = tmm_pat_pin;
+		tmm->pin_n = tmm_pat_pin_n;
 		tmm->unpin = tmm_pat_unpin;
 
 		return tmm;
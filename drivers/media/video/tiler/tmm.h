@@ -50,6 +50,8 @@ struct tmm {
 	u32 *(*get)	(struct tmm *tmm, u32 num_pages);
 	void (*free)	(struct tmm *tmm, u32 *pages);
 	s32  (*pin)	(struct tmm *tmm, struct pat_area area, u32 page_pa);
+	s32  (*pin_n)	(struct tmm *tmm, u32 n, struct pat_area *areas,
+			 u32 *pages_pa);
 	void (*unpin)	(struct tmm *tmm, struct pat_area area);
 	void (*deinit)	(struct tmm *tmm);
 };
@@ -90,6 +92,25 @@ s32 tmm_pin(struct tmm *tmm, struct pat_area area, u32 page_pa)
 	return -ENODEV;
 }
 
+/**
+ * Program the physical address translator for several areas at once.
+ * @param n number of areas
+ * @param areas PAT areas
+ * @param pages_pa physical address of the page list for each area
+ */
+static inline
+s32 tmm_pin_n(struct tmm *tmm, u32 n, struct pat_area *areas, u32 *pages_pa)
+{
+	s32 res = 0;
+
+	if (tmm && tmm->pin_n && tmm->pvt)
+		return tmm->pin_n(tmm, n, areas, pages_pa);
+
+	while (!res && n--)
+		res = tmm_pin(tmm, *areas++, *pages_pa++);
+	return res;
+}
+
 /**
  * Clears the physical address translator.
  * @param area PAT area
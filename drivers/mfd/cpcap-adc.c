@@ -38,6 +38,28 @@
 #define ST_ADC_CAL_BATTI_LOWER_THRESHOLD 494
 #define ST_ADC_CALIBRATE_DIFF_THRESHOLD 3
 
+/* the result registers, then the TI calibration words, read in one go */
+enum {
+	ADC_RAW_CAL1 = CPCAP_ADC_BANK0_NUM,
+	ADC_RAW_CAL2,
+	ADC_RAW_NUM,
+};
+
+static const enum cpcap_reg adc_raw_regs[ADC_RAW_NUM] = {
+	CPCAP_REG_ADCD0, CPCAP_REG_ADCD1, CPCAP_REG_ADCD2, CPCAP_REG_ADCD3,
+	CPCAP_REG_ADCD4, CPCAP_REG_ADCD5, CPCAP_REG_ADCD6, CPCAP_REG_ADCD7,
+	[ADC_RAW_CAL1] = CPCAP_REG_ADCAL1,
+	[ADC_RAW_CAL2] = CPCAP_REG_ADCAL2,
+};
+
+/*
+ * An immediate bank 0 or 1 conversion is reused this long by later
+ * immediate requests for the same bank.  0 always converts afresh.
+ */
+static unsigned int bundle_ms;
+module_param(bundle_ms, uint, 0644);
+MODULE_PARM_DESC(bundle_ms, "Reuse immediate conversions this long (ms)");
+
 struct cpcap_adc {
 	struct cpcap_device *cpcap;
 
@@ -47,6 +69,15 @@ struct cpcap_adc {
 	int queue_tail;
 	struct mutex queue_mutex;
 	struct delayed_work work;
+
+	/* requests answered from a bundle, completed by done_work */
+	struct cpcap_adc_request *done;
+	struct work_struct done_work;
+
+	/* the last immediate conversion of each bank */
+	unsigned short bundle[CPCAP_ADC_TYPE_BATT_PI][ADC_RAW_NUM];
+	unsigned long bundle_time[CPCAP_ADC_TYPE_BATT_PI];
+	bool bundle_valid[CPCAP_ADC_TYPE_BATT_PI];
 };
 
 struct phasing_tbl {
@@ -334,13 +365,33 @@ static void trigger_next_adc_job_if_any(struct cpcap_device *cpcap)
 	adc_setup(cpcap, type, timing);
 }
 
+static void adc_result(struct cpcap_device *cpcap,
+		       struct cpcap_adc_request *req,
+		       const unsigned short *raw);
+
+static bool adc_bundle_fresh(struct cpcap_adc *adc,
+			     struct cpcap_adc_request *req)
+{
+	if (!bundle_ms || req->timing != CPCAP_ADC_TIMING_IMM ||
+	    req->type >= CPCAP_ADC_TYPE_BATT_PI ||
+	    !adc->bundle_valid[req->type])
+		return false;
+
+	return time_before(jiffies, adc->bundle_time[req->type] +
+				    msecs_to_jiffies(bundle_ms));
+}
+
 static int
 adc_enqueue_request(struct cpcap_device *cpcap, struct cpcap_adc_request *req)
 {
 	struct cpcap_adc *adc = cpcap->adcdata;
+	struct cpcap_adc_request *last;
 	int head;
 	int tail;
 	int running;
+	int i;
+
+	req->next = NULL;
 
 	mutex_lock(&adc->queue_mutex);
 
@@ -348,6 +399,35 @@ adc_enqueue_request(struct cpcap_device *cpcap, struct cpcap_adc_request *req)
 	tail = adc->queue_tail;
 	running = (head != tail);
 
+	if (adc_bundle_fresh(adc, req)) {
+		adc_result(cpcap, req, adc->bundle[req->type]);
+		req->next = adc->done;
+		adc->done = req;
+		mutex_unlock(&adc->queue_mutex);
+		schedule_work(&adc->done_work);
+		return 0;
+	}
+
+	/*
+	 * A request that has not been started yet with the same bank and
+	 * timing will sample exactly what this one wants, so ride along
+	 * with it.  The request at the head is already converting and may
+	 * have sampled before this one was made.
+	 */
+	for (i = (head + 1) & (MAX_ADC_FIFO_DEPTH - 1);
+	     adc->queue[head] && i != tail;
+	     i = (i + 1) & (MAX_ADC_FIFO_DEPTH - 1)) {
+		last = adc->queue[i];
+		if (last->type != req->type || last->timing != req->timing)
+			continue;
+
+		while (last->next)
+			last = last->next;
+		last->next = req;
+		mutex_unlock(&adc->queue_mutex);
+		return 0;
+	}
+
 	if (adc->queue[tail]) {
 		mutex_unlock(&adc->queue_mutex);
 		return -EBUSY;
@@ -502,33 +582,27 @@ static void adc_raw(struct cpcap_adc_request *req, int index)
 	}
 }
 
+static void adc_read_raw(struct cpcap_device *cpcap, unsigned short *raw)
+{
+	memset(raw, 0, ADC_RAW_NUM * sizeof(*raw));
+	cpcap_regacc_read_batch(cpcap, adc_raw_regs, raw, ADC_RAW_NUM);
+}
+
 static void adc_result(struct cpcap_device *cpcap,
-		       struct cpcap_adc_request *req)
+		       struct cpcap_adc_request *req,
+		       const unsigned short *raw)
 {
-	int i;
 	int j;
-	unsigned short cal_data;
-
-
 
 	if (cpcap->vendor == CPCAP_VENDOR_TI) {
-		cal_data = 0;
-		cpcap_regacc_read(cpcap, CPCAP_REG_ADCAL1, &cal_data);
 		bank0_conversion[CPCAP_ADC_CHG_ISENSE].cal_offset =
-			((short)cal_data * -1) + 512;
-	}
-
-	if (cpcap->vendor == CPCAP_VENDOR_TI) {
-		cal_data = 0;
-		cpcap_regacc_read(cpcap, CPCAP_REG_ADCAL2, &cal_data);
+			((short)raw[ADC_RAW_CAL1] * -1) + 512;
 		bank0_conversion[CPCAP_ADC_BATTI_ADC].cal_offset =
-			((short)cal_data * -1) + 512;
+			((short)raw[ADC_RAW_CAL2] * -1) + 512;
 	}
 
-	for (i = CPCAP_REG_ADCD0; i <= CPCAP_REG_ADCD7; i++) {
-		j = i - CPCAP_REG_ADCD0;
-		cpcap_regacc_read(cpcap, i, (unsigned short *)&req->result[j]);
-		req->result[j] &= 0x3FF;
+	for (j = 0; j < CPCAP_ADC_BANK0_NUM; j++) {
+		req->result[j] = raw[j] & 0x3FF;
 
 		switch (req->format) {
 		case CPCAP_ADC_FORMAT_PHASED:
@@ -555,6 +629,9 @@ static void cpcap_adc_irq(enum cpcap_irqs irq, void *data)
 	struct cpcap_adc *adc = data;
 	struct cpcap_device *cpcap = adc->cpcap;
 	struct cpcap_adc_request *req;
+	struct cpcap_adc_request *next;
+	struct cpcap_adc_request *r;
+	unsigned short raw[ADC_RAW_NUM];
 	int head;
 	char btrigger_next;
 
@@ -578,22 +655,54 @@ static void cpcap_adc_irq(enum cpcap_irqs irq, void *data)
 	adc->queue_head = (head + 1) & (MAX_ADC_FIFO_DEPTH - 1);
 	btrigger_next = !!adc->queue[adc->queue_head];
 
-	mutex_unlock(&adc->queue_mutex);
+	adc_read_raw(cpcap, raw);
+	for (r = req; r; r = r->next)
+		adc_result(cpcap, r, raw);
 
-	adc_result(cpcap, req);
+	if (req->timing == CPCAP_ADC_TIMING_IMM &&
+	    req->type < CPCAP_ADC_TYPE_BATT_PI) {
+		memcpy(adc->bundle[req->type], raw, sizeof(raw));
+		adc->bundle_time[req->type] = jiffies;
+		adc->bundle_valid[req->type] = true;
+	}
+
+	mutex_unlock(&adc->queue_mutex);
 
 	if (btrigger_next)
 		trigger_next_adc_job_if_any(cpcap);
 
-	req->status = 0;
+	/* a completed sync request may be gone once its callback returns */
+	for (r = req; r; r = next) {
+		next = r->next;
+		r->status = 0;
+		r->callback(cpcap, r->callback_param);
+	}
+}
+
+static void cpcap_adc_done(struct work_struct *work)
+{
+	struct cpcap_adc *adc =
+		container_of(work, struct cpcap_adc, done_work);
+	struct cpcap_adc_request *req;
+	struct cpcap_adc_request *next;
 
-	req->callback(cpcap, req->callback_param);
+	mutex_lock(&adc->queue_mutex);
+	req = adc->done;
+	adc->done = NULL;
+	mutex_unlock(&adc->queue_mutex);
+
+	for (; req; req = next) {
+		next = req->next;
+		req->status = 0;
+		req->callback(adc->cpcap, req->callback_param);
+	}
 }
 
 static void cpcap_adc_cancel(struct work_struct *work)
 {
 	int head;
 	struct cpcap_adc_request *req;
+	struct cpcap_adc_request *next;
 	struct cpcap_adc *adc =
 		container_of(work, struct cpcap_adc, work.work);
 
@@ -618,9 +727,11 @@ static void cpcap_adc_cancel(struct work_struct *work)
 
 	mutex_unlock(&adc->queue_mutex);
 
-	req->status = -ETIMEDOUT;
-
-	req->callback(adc->cpcap, req->callback_param);
+	for (; req; req = next) {
+		next = req->next;
+		req->status = -ETIMEDOUT;
+		req->callback(adc->cpcap, req->callback_param);
+	}
 
 	trigger_next_adc_job_if_any(adc->cpcap);
 }
@@ -712,6 +823,7 @@ static int __devinit cpcap_adc_probe(struct platform_device *pdev)
 
 
 	INIT_DELAYED_WORK(&adc->work, cpcap_adc_cancel);
+	INIT_WORK(&adc->done_work, cpcap_adc_done);
 
 	cpcap_irq_register(adc->cpcap, CPCAP_IRQ_ADCDONE,
 			   cpcap_adc_irq, adc);
@@ -727,6 +839,7 @@ static int __devexit cpcap_adc_remove(struct platform_device *pdev)
 	int head;
 
 	cancel_delayed_work_sync(&adc->work);
+	flush_work_sync(&adc->done_work);
 
 	cpcap_irq_free(adc->cpcap, CPCAP_IRQ_ADCDONE);
 
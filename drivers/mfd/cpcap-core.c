@@ -122,6 +122,13 @@ void cpcap_set_bit(enum cpcap_reg reg, unsigned short value,
 }
 EXPORT_SYMBOL(cpcap_set_bit);
 
+/* the probed device, for code outside the cpcap MFD children */
+struct cpcap_device *cpcap_get_device(void)
+{
+	return misc_cpcap;
+}
+EXPORT_SYMBOL_GPL(cpcap_get_device);
+
 static int cpcap_reboot(struct notifier_block *this, unsigned long code,
 			void *cmd)
 {
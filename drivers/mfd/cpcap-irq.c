@@ -21,6 +21,7 @@
 #include <linux/interrupt.h>
 #include <linux/irq.h>
 #include <linux/mutex.h>
+#include <linux/sched.h>
 #include <linux/workqueue.h>
 #include <linux/wakelock.h>
 
@@ -56,12 +57,18 @@ struct cpcap_irq_info {
 
 struct cpcap_irqdata {
 	struct mutex lock;
-	struct work_struct work;
-	struct workqueue_struct *workqueue;
 	struct cpcap_device *cpcap;
 	struct cpcap_event_handler event_handler[CPCAP_IRQ__NUM];
 	struct cpcap_irq_info irq_info[CPCAP_IRQ__NUM];
 	struct wake_lock wake_lock;
+	/*
+	 * Sense bits read along with the interrupts.  The handler of
+	 * sense_irq, running in sense_task, gets its first cpcap_irq_sense
+	 * from here instead of the bus.
+	 */
+	unsigned short sense[NUM_INT_REGS];
+	struct task_struct *sense_task;
+	enum cpcap_irqs sense_irq;
 };
 
 #define EVENT_MASK(event) (1 << ((event) % NUM_INTS_PER_REG))
@@ -75,11 +82,10 @@ enum pwrkey_states {
 static irqreturn_t event_isr(int irq, void *data)
 {
 	struct cpcap_irqdata *irq_data = data;
-	disable_irq_nosync(irq);
+
 	wake_lock(&irq_data->wake_lock);
-	queue_work(irq_data->workqueue, &irq_data->work);
 
-	return IRQ_HANDLED;
+	return IRQ_WAKE_THREAD;
 }
 
 static unsigned short get_int_reg(enum cpcap_irqs event)
@@ -301,77 +307,89 @@ static void pwrkey_remove(struct cpcap_device *cpcap)
 	kfree(data);
 }
 
-static int int_read_and_clear(struct cpcap_device *cpcap,
-			      unsigned short status_reg,
-			      unsigned short mask_reg,
-			      unsigned short valid_mask,
+static const struct {
+	unsigned short status_reg;
+	unsigned short mask_reg;
+	unsigned short sense_reg;
+	unsigned short valid;
+} int_bank[NUM_INT_REGS] = {
+	{CPCAP_REG_INT1, CPCAP_REG_INTM1, CPCAP_REG_INTS1,
+	 CPCAP_INT1_VALID_BITS},
+	{CPCAP_REG_INT2, CPCAP_REG_INTM2, CPCAP_REG_INTS2,
+	 CPCAP_INT2_VALID_BITS},
+	{CPCAP_REG_INT3, CPCAP_REG_INTM3, CPCAP_REG_INTS3,
+	 CPCAP_INT3_VALID_BITS},
+	{CPCAP_REG_INT4, CPCAP_REG_INTM4, CPCAP_REG_INTS4,
+	 CPCAP_INT4_VALID_BITS},
+	{CPCAP_REG_MI1,  CPCAP_REG_MIM1,  CPCAP_REG_MI2,
+	 CPCAP_INT5_VALID_BITS}
+};
+
+/*
+ * Read the status, mask and sense banks in one transaction, then mask and
+ * clear what is pending in a second one.
+ */
+static int int_read_and_clear(struct cpcap_irqdata *data,
 			      unsigned short *en)
 {
-	unsigned short ireg_val, mreg_val;
+	enum cpcap_reg regs[NUM_INT_REGS * 3];
+	unsigned short val[NUM_INT_REGS * 3];
+	struct cpcap_regacc ops[NUM_INT_REGS * 2];
+	int i, n = 0;
 	int ret;
-	ret = cpcap_regacc_read(cpcap, status_reg, &ireg_val);
-	if (ret)
-		return ret;
-	ret = cpcap_regacc_read(cpcap, mask_reg, &mreg_val);
-	if (ret)
-		return ret;
-	*en |= ireg_val & ~mreg_val;
-	*en &= valid_mask;
-	ret = cpcap_regacc_write(cpcap, mask_reg, *en, *en);
-	if (ret)
-		return ret;
-	ret = cpcap_regacc_write(cpcap, status_reg, *en, *en);
+
+	for (i = 0; i < NUM_INT_REGS; i++) {
+		regs[i] = int_bank[i].status_reg;
+		regs[NUM_INT_REGS + i] = int_bank[i].mask_reg;
+		regs[2 * NUM_INT_REGS + i] = int_bank[i].sense_reg;
+	}
+	ret = cpcap_regacc_read_batch(data->cpcap, regs, val, ARRAY_SIZE(val));
 	if (ret)
 		return ret;
-	return 0;
+
+	for (i = 0; i < NUM_INT_REGS; i++) {
+		en[i] |= val[i] & ~val[NUM_INT_REGS + i];
+		en[i] &= int_bank[i].valid;
+		data->sense[i] = val[2 * NUM_INT_REGS + i];
+		if (!en[i])
+			continue;
+		ops[n].reg = int_bank[i].mask_reg;
+		ops[n].value = en[i];
+		ops[n++].mask = en[i];
+		ops[n].reg = int_bank[i].status_reg;
+		ops[n].value = en[i];
+		ops[n++].mask = en[i];
+	}
+
+	return cpcap_regacc_write_batch(data->cpcap, ops, n);
 }
 
 
-static void irq_work_func(struct work_struct *work)
+static irqreturn_t irq_thread_func(int irq, void *dev_id)
 {
 	int retval = 0;
 	unsigned short en_ints[NUM_INT_REGS];
 	int i;
-	struct cpcap_irqdata *data;
+	struct cpcap_irqdata *data = dev_id;
 	struct cpcap_device *cpcap;
 	struct spi_device *spi;
 	struct cpcap_platform_data *pdata;
 
-	static const struct {
-		unsigned short status_reg;
-		unsigned short mask_reg;
-		unsigned short valid;
-	} int_reg[NUM_INT_REGS] = {
-		{CPCAP_REG_INT1, CPCAP_REG_INTM1, CPCAP_INT1_VALID_BITS},
-		{CPCAP_REG_INT2, CPCAP_REG_INTM2, CPCAP_INT2_VALID_BITS},
-		{CPCAP_REG_INT3, CPCAP_REG_INTM3, CPCAP_INT3_VALID_BITS},
-		{CPCAP_REG_INT4, CPCAP_REG_INTM4, CPCAP_INT4_VALID_BITS},
-		{CPCAP_REG_MI1,  CPCAP_REG_MIM1,  CPCAP_INT5_VALID_BITS}
-	};
-
 	for (i = 0; i < NUM_INT_REGS; ++i)
 		en_ints[i] = 0;
 
-	data = container_of(work, struct cpcap_irqdata, work);
 	cpcap = data->cpcap;
 	spi = cpcap->spi;
 	pdata = (struct cpcap_platform_data *)spi->dev.platform_data;
 
 	while (pdata->irq_pending(spi->irq)) {
-		for (i = 0; i < NUM_INT_REGS; ++i) {
-			retval = int_read_and_clear(cpcap,
-						int_reg[i].status_reg,
-						int_reg[i].mask_reg,
-						int_reg[i].valid,
-						&en_ints[i]);
-			if (retval < 0) {
-				dev_err(&cpcap->spi->dev,
-					"Error reading interrupts\n");
-				break;
-			}
+		retval = int_read_and_clear(data, en_ints);
+		if (retval < 0) {
+			dev_err(&cpcap->spi->dev,
+				"Error reading interrupts\n");
+			break;
 		}
 	}
-	enable_irq(spi->irq);
 
 #ifdef CONFIG_PM_DBG_DRV
 	if ((pm_dbg_info.suspend != 0) && (pm_dbg_info.wakeup == 0)) {
@@ -401,8 +419,14 @@ static void irq_work_func(struct work_struct *work)
 				goto error;
 			event_handler = &data->event_handler[index];
 
-			if (event_handler->func)
+			if (event_handler->func) {
+				if (!retval) {
+					data->sense_task = current;
+					data->sense_irq = index;
+				}
 				event_handler->func(index, event_handler->data);
+				data->sense_task = NULL;
+			}
 
 			data->irq_info[index].count++;
 
@@ -411,6 +435,8 @@ static void irq_work_func(struct work_struct *work)
 error:
 	mutex_unlock(&data->lock);
 	wake_unlock(&data->wake_lock);
+
+	return IRQ_HANDLED;
 }
 
 #ifdef CONFIG_DEBUG_FS
@@ -544,14 +570,17 @@ int cpcap_irq_init(struct cpcap_device *cpcap)
 
 	cpcap_irq_mask_all(cpcap);
 
-	data->workqueue = create_singlethread_workqueue("cpcap_irq");
-	INIT_WORK(&data->work, irq_work_func);
 	mutex_init(&data->lock);
 	wake_lock_init(&data->wake_lock, WAKE_LOCK_SUSPEND, "cpcap-irq");
 	data->cpcap = cpcap;
 
-	retval = request_irq(spi->irq, event_isr, IRQF_DISABLED |
-				IRQF_TRIGGER_RISING, "cpcap-irq", data);
+	/*
+	 * Events are decoded and dispatched from the irq thread, at
+	 * realtime priority, with the line masked until it is done.
+	 */
+	retval = request_threaded_irq(spi->irq, event_isr, irq_thread_func,
+				      IRQF_ONESHOT | IRQF_TRIGGER_RISING,
+				      "cpcap-irq", data);
 	if (retval) {
 		printk(KERN_ERR "cpcap_irq: Failed requesting irq.\n");
 		goto error;
@@ -584,8 +613,6 @@ void cpcap_irq_shutdown(struct cpcap_device *cpcap)
 	struct cpcap_irqdata *data = cpcap->irqdata;
 
 	pwrkey_remove(cpcap);
-	cancel_work_sync(&data->work);
-	destroy_workqueue(data->workqueue);
 	free_irq(spi->irq, data);
 	kfree(data);
 }
@@ -722,15 +749,22 @@ int cpcap_irq_sense(struct cpcap_device *cpcap,
 		    enum cpcap_irqs irq,
 		    unsigned char clear)
 {
+	struct cpcap_irqdata *data = cpcap->irqdata;
 	unsigned short val;
 	int retval;
 
 	if (irq >= CPCAP_IRQ__NUM)
 		return -EINVAL;
 
-	retval = cpcap_regacc_read(cpcap, get_sense_reg(irq), &val);
-	if (retval)
-		return retval;
+	if (data && data->sense_task == current && data->sense_irq == irq) {
+		/* read with the event, once: the handler may change it */
+		val = data->sense[(irq - CPCAP_IRQ__START) / NUM_INTS_PER_REG];
+		data->sense_task = NULL;
+	} else {
+		retval = cpcap_regacc_read(cpcap, get_sense_reg(irq), &val);
+		if (retval)
+			return retval;
+	}
 
 	if (clear)
 		retval = cpcap_irq_clear(cpcap, irq);
@@ -17,16 +17,27 @@
  */
 
 #include <linux/device.h>
+#include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/bitmap.h>
 #include <linux/spi/spi.h>
 #include <linux/spi/cpcap.h>
 #include <linux/spi/cpcap-regbits.h>
 
 #define IS_CPCAP(reg) ((reg) >= CPCAP_REG_START && (reg) <= CPCAP_REG_END)
 #define CPCAP_SECONDARY_CS    1
+#define CPCAP_BATCH_MAX       16	/* registers per spi message */
 
 static DEFINE_MUTEX(reg_access);
 
+/* last value of the cached registers, valid once read or written; reg_access */
+static unsigned short reg_cache[CPCAP_NUM_REG_CPCAP];
+static DECLARE_BITMAP(reg_cache_valid, CPCAP_NUM_REG_CPCAP);
+
+/* one word per register of a batch, chip select toggled between; reg_access */
+static u32 batch_buf[CPCAP_BATCH_MAX];
+static struct spi_transfer batch_xfer[CPCAP_BATCH_MAX];
+
 /*
  * This table contains information about a single register in the power IC.
  * It is used during register access to information such as the register address
@@ -46,11 +57,18 @@ static DEFINE_MUTEX(reg_access);
  * being changed) should be written with the current value of that bit.  A '0'
  * in this mask indicates that the corresponding bit (when not being changed)
  * should be written with a value of '0'.
+ *
+ * cached: the register only changes when written through this file, so its
+ * last value is kept in reg_cache.  Reads of it do not go to the bus and
+ * masked writes skip the read before write.  Only fully read-before-write
+ * configuration registers qualify; status, interrupt and microcontroller
+ * registers are never cached.
  */
 static const struct {
 	unsigned short address;         /* Address of the register */
 	unsigned short constant_mask;	/* Constant modifiability mask */
 	unsigned short rbw_mask;	/* Read-before-write mask */
+	unsigned short cached;		/* Value kept in reg_cache */
 } register_info_tbl[CPCAP_NUM_REG_CPCAP] = {
 	[CPCAP_REG_INT1]      = {0, 0x0004, 0x0000},
 	[CPCAP_REG_INT2]      = {1, 0x0000, 0x0000},
@@ -98,57 +116,57 @@ static const struct {
 	[CPCAP_REG_DAYA]      = {265, 0x8000, 0xFFFF},
 	[CPCAP_REG_VAL1]      = {266, 0x0000, 0xFFFF},
 	[CPCAP_REG_VAL2]      = {267, 0x0000, 0xFFFF},
-	[CPCAP_REG_SDVSPLL]   = {384, 0x2488, 0xFFFF},
-	[CPCAP_REG_SI2CC1]    = {385, 0x8000, 0xFFFF},
-	[CPCAP_REG_Si2CC2]    = {386, 0xFF00, 0xFFFF},
-	[CPCAP_REG_S1C1]      = {387, 0x9080, 0xFFFF},
-	[CPCAP_REG_S1C2]      = {388, 0x8080, 0xFFFF},
-	[CPCAP_REG_S2C1]      = {389, 0x9080, 0xFFFF},
-	[CPCAP_REG_S2C2]      = {390, 0x8080, 0xFFFF},
-	[CPCAP_REG_S3C]       = {391, 0xFA84, 0xFFFF},
-	[CPCAP_REG_S4C1]      = {392, 0x9080, 0xFFFF},
-	[CPCAP_REG_S4C2]      = {393, 0x8080, 0xFFFF},
-	[CPCAP_REG_S5C]       = {394, 0xFFD7, 0xFFFF},
-	[CPCAP_REG_S6C]       = {395, 0xFFF4, 0xFFFF},
-	[CPCAP_REG_VCAMC]     = {396, 0xFF48, 0xFFFF},
-	[CPCAP_REG_VCSIC]     = {397, 0xFFA8, 0xFFFF},
-	[CPCAP_REG_VDACC]     = {398, 0xFF48, 0xFFFF},
-	[CPCAP_REG_VDIGC]     = {399, 0xFF48, 0xFFFF},
-	[CPCAP_REG_VFUSEC]    = {400, 0xFF50, 0xFFFF},
-	[CPCAP_REG_VHVIOC]    = {401, 0xFFE8, 0xFFFF},
-	[CPCAP_REG_VSDIOC]    = {402, 0xFF40, 0xFFFF},
-	[CPCAP_REG_VPLLC]     = {403, 0xFFA4, 0xFFFF},
-	[CPCAP_REG_VRF1C]     = {404, 0xFF50, 0xFFFF},
-	[CPCAP_REG_VRF2C]     = {405, 0xFFD4, 0xFFFF},
-	[CPCAP_REG_VRFREFC]   = {406, 0xFFD4, 0xFFFF},
-	[CPCAP_REG_VWLAN1C]   = {407, 0xFFA8, 0xFFFF},
-	[CPCAP_REG_VWLAN2C]   = {408, 0xFD32, 0xFFFF},
-	[CPCAP_REG_VSIMC]     = {409, 0xE154, 0xFFFF},
-	[CPCAP_REG_VVIBC]     = {410, 0xFFF2, 0xFFFF},
+	[CPCAP_REG_SDVSPLL]   = {384, 0x2488, 0xFFFF, 1},
+	[CPCAP_REG_SI2CC1]    = {385, 0x8000, 0xFFFF, 1},
+	[CPCAP_REG_Si2CC2]    = {386, 0xFF00, 0xFFFF, 1},
+	[CPCAP_REG_S1C1]      = {387, 0x9080, 0xFFFF, 1},
+	[CPCAP_REG_S1C2]      = {388, 0x8080, 0xFFFF, 1},
+	[CPCAP_REG_S2C1]      = {389, 0x9080, 0xFFFF, 1},
+	[CPCAP_REG_S2C2]      = {390, 0x8080, 0xFFFF, 1},
+	[CPCAP_REG_S3C]       = {391, 0xFA84, 0xFFFF, 1},
+	[CPCAP_REG_S4C1]      = {392, 0x9080, 0xFFFF, 1},
+	[CPCAP_REG_S4C2]      = {393, 0x8080, 0xFFFF, 1},
+	[CPCAP_REG_S5C]       = {394, 0xFFD7, 0xFFFF, 1},
+	[CPCAP_REG_S6C]       = {395, 0xFFF4, 0xFFFF, 1},
+	[CPCAP_REG_VCAMC]     = {396, 0xFF48, 0xFFFF, 1},
+	[CPCAP_REG_VCSIC]     = {397, 0xFFA8, 0xFFFF, 1},
+	[CPCAP_REG_VDACC]     = {398, 0xFF48, 0xFFFF, 1},
+	[CPCAP_REG_VDIGC]     = {399, 0xFF48, 0xFFFF, 1},
+	[CPCAP_REG_VFUSEC]    = {400, 0xFF50, 0xFFFF, 1},
+	[CPCAP_REG_VHVIOC]    = {401, 0xFFE8, 0xFFFF, 1},
+	[CPCAP_REG_VSDIOC]    = {402, 0xFF40, 0xFFFF, 1},
+	[CPCAP_REG_VPLLC]     = {403, 0xFFA4, 0xFFFF, 1},
+	[CPCAP_REG_VRF1C]     = {404, 0xFF50, 0xFFFF, 1},
+	[CPCAP_REG_VRF2C]     = {405, 0xFFD4, 0xFFFF, 1},
+	[CPCAP_REG_VRFREFC]   = {406, 0xFFD4, 0xFFFF, 1},
+	[CPCAP_REG_VWLAN1C]   = {407, 0xFFA8, 0xFFFF, 1},
+	[CPCAP_REG_VWLAN2C]   = {408, 0xFD32, 0xFFFF, 1},
+	[CPCAP_REG_VSIMC]     = {409, 0xE154, 0xFFFF, 1},
+	[CPCAP_REG_VVIBC]     = {410, 0xFFF2, 0xFFFF, 1},
 #ifdef CONFIG_EMU_UART_DEBUG
-	[CPCAP_REG_VUSBC]     = {411, 0xFFFF, 0xFFFF},
+	[CPCAP_REG_VUSBC]     = {411, 0xFFFF, 0xFFFF, 1},
 #else
-	[CPCAP_REG_VUSBC]     = {411, 0xFEA2, 0xFFFF},
+	[CPCAP_REG_VUSBC]     = {411, 0xFEA2, 0xFFFF, 1},
 #endif
-	[CPCAP_REG_VUSBINT1C] = {412, 0xFFD4, 0xFFFF},
-	[CPCAP_REG_VUSBINT2C] = {413, 0xFFD4, 0xFFFF},
+	[CPCAP_REG_VUSBINT1C] = {412, 0xFFD4, 0xFFFF, 1},
+	[CPCAP_REG_VUSBINT2C] = {413, 0xFFD4, 0xFFFF, 1},
 	[CPCAP_REG_URT]       = {414, 0xFFFE, 0xFFFF},
 	[CPCAP_REG_URM1]      = {415, 0x0000, 0xFFFF},
 	[CPCAP_REG_URM2]      = {416, 0xFC00, 0xFFFF},
-	[CPCAP_REG_VAUDIOC]   = {512, 0xFF88, 0xFFFF},
+	[CPCAP_REG_VAUDIOC]   = {512, 0xFF88, 0xFFFF, 1},
 	[CPCAP_REG_CC]        = {513, 0x0000, 0xFEDF},
-	[CPCAP_REG_CDI]       = {514, 0x4000, 0xFFFF},
+	[CPCAP_REG_CDI]       = {514, 0x4000, 0xFFFF, 1},
 	[CPCAP_REG_SDAC]      = {515, 0xF000, 0xFCFF},
-	[CPCAP_REG_SDACDI]    = {516, 0xC000, 0xFFFF},
-	[CPCAP_REG_TXI]       = {517, 0x0000, 0xFFFF},
-	[CPCAP_REG_TXMP]      = {518, 0xF000, 0xFFFF},
-	[CPCAP_REG_RXOA]      = {519, 0xF800, 0xFFFF},
-	[CPCAP_REG_RXVC]      = {520, 0x00C3, 0xFFFF},
-	[CPCAP_REG_RXCOA]     = {521, 0xF800, 0xFFFF},
-	[CPCAP_REG_RXSDOA]    = {522, 0xE000, 0xFFFF},
-	[CPCAP_REG_RXEPOA]    = {523, 0x8000, 0xFFFF},
-	[CPCAP_REG_RXLL]      = {524, 0x0000, 0xFFFF},
-	[CPCAP_REG_A2LA]      = {525, 0xFF00, 0xFFFF},
+	[CPCAP_REG_SDACDI]    = {516, 0xC000, 0xFFFF, 1},
+	[CPCAP_REG_TXI]       = {517, 0x0000, 0xFFFF, 1},
+	[CPCAP_REG_TXMP]      = {518, 0xF000, 0xFFFF, 1},
+	[CPCAP_REG_RXOA]      = {519, 0xF800, 0xFFFF, 1},
+	[CPCAP_REG_RXVC]      = {520, 0x00C3, 0xFFFF, 1},
+	[CPCAP_REG_RXCOA]     = {521, 0xF800, 0xFFFF, 1},
+	[CPCAP_REG_RXSDOA]    = {522, 0xE000, 0xFFFF, 1},
+	[CPCAP_REG_RXEPOA]    = {523, 0x8000, 0xFFFF, 1},
+	[CPCAP_REG_RXLL]      = {524, 0x0000, 0xFFFF, 1},
+	[CPCAP_REG_A2LA]      = {525, 0xFF00, 0xFFFF, 1},
 	[CPCAP_REG_MIPIS1]    = {526, 0x0000, 0xFFFF},
 	[CPCAP_REG_MIPIS2]    = {527, 0xFF00, 0xFFFF},
 	[CPCAP_REG_MIPIS3]    = {528, 0xFFFC, 0xFFFF},
@@ -272,6 +290,43 @@ static int cpcap_spi_access(struct spi_device *spi, u8 *buf,
 	return spi_sync(spi, &m);
 }
 
+static void cpcap_batch_cmd(int i, unsigned short reg, bool write,
+			    unsigned short data)
+{
+	u8 *buf = (u8 *) &batch_buf[i];
+
+	buf[3] = ((reg >> 6) & 0x000000FF) | (write ? 0x80 : 0);
+	buf[2] = (reg << 2) & 0x000000FF;
+	buf[1] = (data >> 8) & 0x000000FF;
+	buf[0] = data & 0x000000FF;
+}
+
+static unsigned short cpcap_batch_data(int i)
+{
+	u8 *buf = (u8 *) &batch_buf[i];
+
+	return buf[0] | (buf[1] << 8);
+}
+
+/* send the first n words of batch_buf as a single message */
+static int cpcap_spi_batch(struct spi_device *spi, int n)
+{
+	struct spi_message m;
+	int i;
+
+	spi_message_init(&m);
+	for (i = 0; i < n; i++) {
+		memset(&batch_xfer[i], 0, sizeof(batch_xfer[i]));
+		batch_xfer[i].tx_buf = &batch_buf[i];
+		batch_xfer[i].rx_buf = &batch_buf[i];
+		batch_xfer[i].len = 4;
+		batch_xfer[i].bits_per_word = 32;
+		batch_xfer[i].cs_change = (i != n - 1);
+		spi_message_add_tail(&batch_xfer[i], &m);
+	}
+	return spi_sync(spi, &m);
+}
+
 static int cpcap_config_for_read(struct spi_device *spi, unsigned short reg,
 				 unsigned short *data)
 {
@@ -313,8 +368,48 @@ static int cpcap_config_for_write(struct spi_device *spi, unsigned short reg,
 	return status;
 }
 
-int cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
-		      unsigned short *value_ptr)
+/*
+ * Current value of reg, from reg_cache when it holds it.  Called with
+ * reg_access held; the secondary CPCAP does not use the cache.
+ */
+static int cpcap_reg_get(struct spi_device *spi, enum cpcap_reg reg,
+			 unsigned short *value, bool use_cache)
+{
+	int retval;
+
+	use_cache = use_cache && register_info_tbl[reg].cached;
+	if (use_cache && test_bit(reg, reg_cache_valid)) {
+		*value = reg_cache[reg];
+		return 0;
+	}
+
+	retval = cpcap_config_for_read(spi, register_info_tbl[reg].address,
+				       value);
+	if (!retval && use_cache) {
+		reg_cache[reg] = *value;
+		set_bit(reg, reg_cache_valid);
+	}
+
+	return retval;
+}
+
+/* record a write of value to reg that returned retval; reg_access held */
+static void cpcap_reg_put(enum cpcap_reg reg, unsigned short value,
+			  int retval)
+{
+	if (!register_info_tbl[reg].cached)
+		return;
+
+	/* a failed write leaves the register unknown */
+	reg_cache[reg] = value;
+	if (retval)
+		clear_bit(reg, reg_cache_valid);
+	else
+		set_bit(reg, reg_cache_valid);
+}
+
+static int __cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
+			       unsigned short *value_ptr, bool use_cache)
 {
 	int retval = -EINVAL;
 	struct spi_device *spi = cpcap->spi;
@@ -322,8 +417,7 @@ int cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
 	if (IS_CPCAP(reg) && (value_ptr != 0)) {
 		mutex_lock(&reg_access);
 
-		retval = cpcap_config_for_read(spi, register_info_tbl
-				      [reg].address, value_ptr);
+		retval = cpcap_reg_get(spi, reg, value_ptr, use_cache);
 
 		mutex_unlock(&reg_access);
 	}
@@ -331,6 +425,13 @@ int cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
 	return retval;
 }
 
+int cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
+		      unsigned short *value_ptr)
+{
+	return __cpcap_regacc_read(cpcap, reg, value_ptr, true);
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_read);
+
 void cpcap_mismatch_detect(struct spi_device *spi, bool do_check,
 			enum cpcap_reg reg, unsigned short value)
 {
@@ -375,10 +476,11 @@ void cpcap_mismatch_detect(struct spi_device *spi, bool do_check,
 	}
 }
 
-int cpcap_regacc_write(struct cpcap_device *cpcap,
-		       enum cpcap_reg reg,
-		       unsigned short value,
-		       unsigned short mask)
+static int __cpcap_regacc_write(struct cpcap_device *cpcap,
+				enum cpcap_reg reg,
+				unsigned short value,
+				unsigned short mask,
+				bool use_cache)
 {
 	int retval = -EINVAL;
 	unsigned short old_value = 0;
@@ -394,9 +496,8 @@ int cpcap_regacc_write(struct cpcap_device *cpcap,
 		value &= mask;
 
 		if ((register_info_tbl[reg].rbw_mask) != 0) {
-			retval = cpcap_config_for_read(spi, register_info_tbl
-						       [reg].address,
-						       &old_value);
+			retval = cpcap_reg_get(spi, reg, &old_value,
+					       use_cache);
 			if (retval != 0)
 				goto error;
 			else
@@ -414,6 +515,9 @@ int cpcap_regacc_write(struct cpcap_device *cpcap,
 		if (!retval)
 			cpcap_mismatch_detect(spi, false, reg, value);
 
+		if (use_cache)
+			cpcap_reg_put(reg, value, retval);
+
 error:
 		mutex_unlock(&reg_access);
 	}
@@ -421,6 +525,181 @@ error:
 	return retval;
 }
 
+int cpcap_regacc_write(struct cpcap_device *cpcap,
+		       enum cpcap_reg reg,
+		       unsigned short value,
+		       unsigned short mask)
+{
+	return __cpcap_regacc_write(cpcap, reg, value, mask, true);
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_write);
+
+/*
+ * Up to CPCAP_BATCH_MAX writes in two messages: one reading every register
+ * the writes need to merge with, one writing them all.  A register written
+ * twice merges with the value of the first write.
+ */
+static int cpcap_regacc_write_chunk(struct spi_device *spi,
+				    const struct cpcap_regacc *ops, int n)
+{
+	unsigned short value[CPCAP_BATCH_MAX];
+	signed char prev[CPCAP_BATCH_MAX];	/* earlier write to the reg */
+	signed char rd[CPCAP_BATCH_MAX];	/* word the reg is read into */
+	int i, j, reads = 0;
+	int retval = 0;
+
+	for (i = 0; i < n; i++) {
+		enum cpcap_reg reg = ops[i].reg;
+
+		value[i] = 0;
+		prev[i] = -1;
+		rd[i] = -1;
+		if (register_info_tbl[reg].rbw_mask == 0)
+			continue;
+		for (j = i - 1; j >= 0; j--)
+			if (ops[j].reg == reg)
+				break;
+		if (j >= 0) {
+			prev[i] = j;
+		} else if (register_info_tbl[reg].cached &&
+			   test_bit(reg, reg_cache_valid)) {
+			value[i] = reg_cache[reg];
+		} else {
+			rd[i] = reads;
+			cpcap_batch_cmd(reads++, register_info_tbl[reg].address,
+					false, 0);
+		}
+	}
+
+	if (reads) {
+		retval = cpcap_spi_batch(spi, reads);
+		if (retval)
+			return retval;
+	}
+
+	for (i = 0; i < n; i++) {
+		enum cpcap_reg reg = ops[i].reg;
+		unsigned short old_value = value[i];
+
+		if (prev[i] >= 0) {
+			old_value = value[prev[i]];
+		} else if (rd[i] >= 0) {
+			old_value = cpcap_batch_data(rd[i]);
+			cpcap_mismatch_detect(spi, true, reg, old_value);
+		}
+		old_value &= register_info_tbl[reg].rbw_mask;
+		old_value &= ~ops[i].mask;
+		value[i] = (ops[i].value & ops[i].mask) | old_value;
+	}
+
+	for (i = 0; i < n; i++)
+		cpcap_batch_cmd(i, register_info_tbl[ops[i].reg].address,
+				true, value[i]);
+	retval = cpcap_spi_batch(spi, n);
+
+	for (i = 0; i < n; i++) {
+		if (!retval)
+			cpcap_mismatch_detect(spi, false, ops[i].reg, value[i]);
+		cpcap_reg_put(ops[i].reg, value[i], retval);
+	}
+
+	return retval;
+}
+
+/**
+ * cpcap_regacc_read_batch - read several registers in one transaction
+ * @cpcap: the device
+ * @regs: registers to read
+ * @values: filled with the values, in the order of regs
+ * @n: number of registers
+ */
+int cpcap_regacc_read_batch(struct cpcap_device *cpcap,
+			    const enum cpcap_reg *regs,
+			    unsigned short *values, int n)
+{
+	int i, j, reads;
+	int rd[CPCAP_BATCH_MAX];
+	int retval = 0;
+	struct spi_device *spi = cpcap->spi;
+
+	for (i = 0; i < n; i++)
+		if (!IS_CPCAP(regs[i]) || !values)
+			return -EINVAL;
+
+	mutex_lock(&reg_access);
+
+	for (i = 0; i < n && !retval; i += CPCAP_BATCH_MAX) {
+		int len = min(n - i, CPCAP_BATCH_MAX);
+
+		reads = 0;
+		for (j = 0; j < len; j++) {
+			enum cpcap_reg reg = regs[i + j];
+
+			rd[j] = -1;
+			if (register_info_tbl[reg].cached &&
+			    test_bit(reg, reg_cache_valid))
+				values[i + j] = reg_cache[reg];
+			else {
+				rd[j] = reads;
+				cpcap_batch_cmd(reads++,
+					register_info_tbl[reg].address,
+					false, 0);
+			}
+		}
+
+		if (reads)
+			retval = cpcap_spi_batch(spi, reads);
+		if (retval)
+			break;
+
+		for (j = 0; j < len; j++) {
+			if (rd[j] < 0)
+				continue;
+			values[i + j] = cpcap_batch_data(rd[j]);
+			if (register_info_tbl[regs[i + j]].cached) {
+				reg_cache[regs[i + j]] = values[i + j];
+				set_bit(regs[i + j], reg_cache_valid);
+			}
+		}
+	}
+
+	mutex_unlock(&reg_access);
+
+	return retval;
+}
+
+/**
+ * cpcap_regacc_write_batch - write several registers in one transaction
+ * @cpcap: the device
+ * @ops: registers, values and masks, as for cpcap_regacc_write
+ * @n: number of entries in ops
+ *
+ * The writes are done in order, with no other register access in between.
+ * Nothing is written if any entry is invalid.
+ */
+int cpcap_regacc_write_batch(struct cpcap_device *cpcap,
+			     const struct cpcap_regacc *ops, int n)
+{
+	int i;
+	int retval = 0;
+	struct spi_device *spi = cpcap->spi;
+
+	for (i = 0; i < n; i++)
+		if (!IS_CPCAP(ops[i].reg) ||
+		    (ops[i].mask & register_info_tbl[ops[i].reg].constant_mask))
+			return -EINVAL;
+
+	mutex_lock(&reg_access);
+
+	for (i = 0; i < n && !retval; i += CPCAP_BATCH_MAX)
+		retval = cpcap_regacc_write_chunk(spi, &ops[i],
+					min(n - i, CPCAP_BATCH_MAX));
+
+	mutex_unlock(&reg_access);
+
+	return retval;
+}
+
 int cpcap_regacc_read_secondary(struct cpcap_device *cpcap, enum cpcap_reg reg,
 		      unsigned short *value_ptr)
 {
@@ -440,7 +719,8 @@ int cpcap_regacc_read_secondary(struct cpcap_device *cpcap, enum cpcap_reg reg,
 		memcpy(&secondary_spi, cpcap->spi, sizeof(struct spi_device));
 		secondary_spi.chip_select = CPCAP_SECONDARY_CS;
 		secondary_cpcap.spi = &secondary_spi;
-		retval = cpcap_regacc_read(&secondary_cpcap, reg, value_ptr);
+		retval = __cpcap_regacc_read(&secondary_cpcap, reg, value_ptr,
+					     false);
 	}
 
 	if (retval)
@@ -471,7 +751,8 @@ int cpcap_regacc_write_secondary(struct cpcap_device *cpcap,
 		memcpy(&secondary_spi, cpcap->spi, sizeof(struct spi_device));
 		secondary_spi.chip_select = CPCAP_SECONDARY_CS;
 		secondary_cpcap.spi = &secondary_spi;
-		retval = cpcap_regacc_write(&secondary_cpcap, reg, value, mask);
+		retval = __cpcap_regacc_write(&secondary_cpcap, reg, value,
+					      mask, false);
 	}
 
 	if (retval)
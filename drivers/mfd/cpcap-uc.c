@@ -110,6 +110,18 @@ static int is_valid_address(struct cpcap_device *cpcap, unsigned short address,
 	return vld;
 }
 
+/* MT1..MT3 written together, as one spi transaction */
+static void ram_transfer_start(struct cpcap_uc_data *uc_data)
+{
+	struct cpcap_regacc ops[] = {
+		{CPCAP_REG_MT1, uc_data->req.address, 0xFFFF},
+		{CPCAP_REG_MT2, uc_data->req.num_words, 0xFFFF},
+		{CPCAP_REG_MT3, 0, 0xFFFF},
+	};
+
+	cpcap_regacc_write_batch(uc_data->cpcap, ops, ARRAY_SIZE(ops));
+}
+
 static void ram_read_state_machine(enum cpcap_irqs irq, void *data)
 {
 	struct cpcap_uc_data *uc_data = data;
@@ -120,11 +132,7 @@ static void ram_read_state_machine(enum cpcap_irqs irq, void *data)
 
 	switch (uc_data->state) {
 	case READ_STATE_1:
-		cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT1,
-				   uc_data->req.address, 0xFFFF);
-		cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT2,
-				   uc_data->req.num_words, 0xFFFF);
-		cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT3, 0, 0xFFFF);
+		ram_transfer_start(uc_data);
 
 		if (uc_data->cpcap->vendor == CPCAP_VENDOR_ST)
 			uc_data->state = READ_STATE_2;
@@ -212,18 +220,20 @@ static void ram_read_state_machine(enum cpcap_irqs irq, void *data)
 static void ram_write_state_machine(enum cpcap_irqs irq, void *data)
 {
 	struct cpcap_uc_data *uc_data = data;
+	struct cpcap_regacc ops[] = {
+		{CPCAP_REG_MT1, 0, 0xFFFF},
+		{CPCAP_REG_MT2, 0, 0xFFFF},
+		{CPCAP_REG_MT3, 0, 0xFFFF},
+	};
 	unsigned short error_check;
+	int i;
 
 	if (irq != CPCAP_IRQ_UC_PRIRAMW)
 		return;
 
 	switch (uc_data->state) {
 	case WRITE_STATE_1:
-		cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT1,
-				   uc_data->req.address, 0xFFFF);
-		cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT2,
-				   uc_data->req.num_words, 0xFFFF);
-		cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT3, 0, 0xFFFF);
+		ram_transfer_start(uc_data);
 
 		uc_data->state = WRITE_STATE_2;
 		cpcap_irq_unmask(uc_data->cpcap, CPCAP_IRQ_UC_PRIRAMW);
@@ -248,32 +258,18 @@ static void ram_write_state_machine(enum cpcap_irqs irq, void *data)
 		/* No error has occured, fall through */
 
 	case WRITE_STATE_3:
-		cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT1,
-				   *(uc_data->req.data + uc_data->state_cntr),
-				   0xFFFF);
+		/* up to three words per interrupt, zero past the end */
+		ops[0].value = *(uc_data->req.data + uc_data->state_cntr);
 		uc_data->state_cntr += 1;
 
-		if (uc_data->state_cntr == uc_data->req.num_words)
-			cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT2, 0,
-					   0xFFFF);
-		else {
-			cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT2,
-					   *(uc_data->req.data +
-					     uc_data->state_cntr), 0xFFFF);
-
-			uc_data->state_cntr += 1;
-		}
-
-		if (uc_data->state_cntr == uc_data->req.num_words)
-			cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT3, 0,
-					   0xFFFF);
-		else {
-			cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MT3,
-					   *(uc_data->req.data +
-					     uc_data->state_cntr), 0xFFFF);
-
+		for (i = 1; i < ARRAY_SIZE(ops); i++) {
+			if (uc_data->state_cntr == uc_data->req.num_words)
+				break;
+			ops[i].value = *(uc_data->req.data +
+					 uc_data->state_cntr);
 			uc_data->state_cntr += 1;
 		}
+		cpcap_regacc_write_batch(uc_data->cpcap, ops, ARRAY_SIZE(ops));
 
 		if (uc_data->state_cntr == uc_data->req.num_words)
 			uc_data->state = WRITE_STATE_4;
@@ -304,6 +300,15 @@ static void ram_write_state_machine(enum cpcap_irqs irq, void *data)
 
 static void reset_handler(enum cpcap_irqs irq, void *data)
 {
+	static const struct cpcap_regacc halt[] = {
+		{CPCAP_REG_UCC1, CPCAP_BIT_PRIHALT, CPCAP_BIT_PRIHALT},
+		{CPCAP_REG_PGC, CPCAP_BIT_PRI_UC_SUSPEND,
+		 CPCAP_BIT_PRI_UC_SUSPEND},
+	};
+	static const struct cpcap_regacc macros[] = {
+		{CPCAP_REG_MI2, 0, 0xFFFF},
+		{CPCAP_REG_MIM1, 0xFFFF, 0xFFFF},
+	};
 	int i;
 	unsigned short regval;
 	struct cpcap_uc_data *uc_data = data;
@@ -311,18 +316,13 @@ static void reset_handler(enum cpcap_irqs irq, void *data)
 	if (irq != CPCAP_IRQ_UCRESET)
 		return;
 
-	cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_UCC1,
-			   CPCAP_BIT_PRIHALT, CPCAP_BIT_PRIHALT);
-
-	cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_PGC,
-			   CPCAP_BIT_PRI_UC_SUSPEND, CPCAP_BIT_PRI_UC_SUSPEND);
+	cpcap_regacc_write_batch(uc_data->cpcap, halt, ARRAY_SIZE(halt));
 
 	uc_data->uc_reset = 1;
 	uc_data->cb_status = -EIO;
 	complete(&uc_data->completion);
 
-	cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MI2, 0, 0xFFFF);
-	cpcap_regacc_write(uc_data->cpcap, CPCAP_REG_MIM1, 0xFFFF, 0xFFFF);
+	cpcap_regacc_write_batch(uc_data->cpcap, macros, ARRAY_SIZE(macros));
 	cpcap_irq_mask(uc_data->cpcap, CPCAP_IRQ_PRIMAC);
 	cpcap_irq_unmask(uc_data->cpcap, CPCAP_IRQ_UCRESET);
 
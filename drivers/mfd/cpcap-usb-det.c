@@ -512,20 +512,64 @@ static int configure_hardware(struct cpcap_usb_det_data *data,
 	struct cpcap_device *cpcap;
 	struct cpcap_platform_data *pdata;
 	int count;
+	/* Take control of pull up from ULPI, the first entry */
+	static const struct cpcap_regacc pull_up[] = {
+		{CPCAP_REG_USBC3, CPCAP_BIT_PU_SPI, CPCAP_BIT_PU_SPI},
+		{CPCAP_REG_USBC1, CPCAP_BIT_DP150KPU,
+		 (CPCAP_BIT_DP150KPU | CPCAP_BIT_DP1K5PU |
+		  CPCAP_BIT_DM1K5PU | CPCAP_BIT_DPPD | CPCAP_BIT_DMPD)},
+	};
+	/* Past the third entry, give USB driver control of pull up via ULPI. */
+	static const struct cpcap_regacc usb[] = {
+		{CPCAP_REG_USBC1, 0, CPCAP_BIT_VBUSPD},
+		{CPCAP_REG_USBC2, CPCAP_BIT_USBXCVREN, CPCAP_BIT_USBXCVREN},
+		{CPCAP_REG_USBC3, 0, CPCAP_BIT_VBUSSTBY_EN},
+		{CPCAP_REG_USBC3, 0,
+		 (CPCAP_BIT_PU_SPI | CPCAP_BIT_DMPD_SPI | CPCAP_BIT_DPPD_SPI |
+		  CPCAP_BIT_SUSPEND_SPI | CPCAP_BIT_ULPI_SPI_SEL)},
+		{CPCAP_REG_USBC2, CPCAP_BIT_USBXCVREN, CPCAP_BIT_USBXCVREN},
+	};
+	static const struct cpcap_regacc charger[] = {
+		{CPCAP_REG_USBC1, CPCAP_BIT_VBUSPD, CPCAP_BIT_VBUSPD},
+		{CPCAP_REG_USBC3, 0, CPCAP_BIT_VBUSSTBY_EN},
+	};
+	static const struct cpcap_regacc whisper_ppd[] = {
+		{CPCAP_REG_USBC1, 0, CPCAP_BIT_VBUSPD},
+		{CPCAP_REG_CRM, CPCAP_BIT_RVRSMODE, CPCAP_BIT_RVRSMODE},
+	};
+	static const struct cpcap_regacc unknown_pre[] = {
+		{CPCAP_REG_USBC1, 0, CPCAP_BIT_VBUSPD | CPCAP_BIT_ID100KPU},
+		{CPCAP_REG_CRM, 0, CPCAP_BIT_RVRSMODE},
+	};
+	static const struct cpcap_regacc unknown[] = {
+		{CPCAP_REG_USBC2, 0,
+		 (CPCAP_BIT_EMUMODE2 | CPCAP_BIT_EMUMODE1 |
+		  CPCAP_BIT_EMUMODE0)},
+		{CPCAP_REG_USBC3, CPCAP_BIT_VBUSSTBY_EN, CPCAP_BIT_VBUSSTBY_EN},
+		{CPCAP_REG_VUSBC, 0, CPCAP_BIT_VBUS_SWITCH},
+	};
+	/* the fifth entry only with the pull up controlled via ULPI */
+	static const struct cpcap_regacc none[] = {
+		{CPCAP_REG_VUSBC, 0, CPCAP_BIT_VBUS_SWITCH},
+		{CPCAP_REG_USBC1, CPCAP_BIT_VBUSPD, CPCAP_BIT_VBUSPD},
+		{CPCAP_REG_USBC2, CPCAP_BIT_USBSUSPEND,
+		 CPCAP_BIT_USBXCVREN | CPCAP_BIT_USBSUSPEND},
+		{CPCAP_REG_USBC3, CPCAP_BIT_VBUSSTBY_EN, CPCAP_BIT_VBUSSTBY_EN},
+		{CPCAP_REG_USBC3,
+		 (CPCAP_BIT_DMPD_SPI | CPCAP_BIT_DPPD_SPI |
+		  CPCAP_BIT_SUSPEND_SPI | CPCAP_BIT_ULPI_SPI_SEL),
+		 (CPCAP_BIT_DMPD_SPI | CPCAP_BIT_DPPD_SPI |
+		  CPCAP_BIT_SUSPEND_SPI | CPCAP_BIT_ULPI_SPI_SEL)},
+	};
+	int ulpi = (data->usb_drv_ctrl_via_ulpi == STATUS_SUPPORTED);
 
 	cpcap = data->cpcap;
 	pdata = cpcap->spi->dev.platform_data;
 
-	if (data->usb_drv_ctrl_via_ulpi == STATUS_SUPPORTED)
-		/* Take control of pull up from ULPI. */
-		retval  = cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC3,
-				     CPCAP_BIT_PU_SPI,
-				     CPCAP_BIT_PU_SPI);
-	retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC1,
-				    CPCAP_BIT_DP150KPU,
-				    (CPCAP_BIT_DP150KPU | CPCAP_BIT_DP1K5PU |
-				     CPCAP_BIT_DM1K5PU | CPCAP_BIT_DPPD |
-				     CPCAP_BIT_DMPD));
+	if (ulpi)
+		retval = cpcap_regacc_write_batch(data->cpcap, pull_up, 2);
+	else
+		retval = cpcap_regacc_write_batch(data->cpcap, &pull_up[1], 1);
 
 	pr_cpcap_usb_det(STATUS,  "configure_hardware: accy=%s\n",
 		accy_names[accy]);
@@ -535,24 +579,8 @@ static int configure_hardware(struct cpcap_usb_det_data *data,
 	case CPCAP_ACCY_FACTORY:
 		pdata->usb_mux->configure_switch_muxmode(OTG_DM_DP);
 		pdata->usb_mux->configure_otg_muxmode(USB_OTG);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC1, 0,
-					     CPCAP_BIT_VBUSPD);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC2,
-					     CPCAP_BIT_USBXCVREN,
-					     CPCAP_BIT_USBXCVREN);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC3, 0,
-					     CPCAP_BIT_VBUSSTBY_EN);
-
-		/* Give USB driver control of pull up via ULPI. */
-		if (data->usb_drv_ctrl_via_ulpi == STATUS_SUPPORTED)
-			retval |= cpcap_regacc_write(data->cpcap,
-						     CPCAP_REG_USBC3,
-						     0,
-						     CPCAP_BIT_PU_SPI |
-						     CPCAP_BIT_DMPD_SPI |
-						     CPCAP_BIT_DPPD_SPI |
-						     CPCAP_BIT_SUSPEND_SPI |
-						     CPCAP_BIT_ULPI_SPI_SEL);
+		retval |= cpcap_regacc_write_batch(data->cpcap, usb,
+						   ulpi ? 4 : 3);
 
 		if ((data->cpcap->vendor == CPCAP_VENDOR_ST) &&
 			(data->cpcap->revision == CPCAP_REVISION_2_0))
@@ -569,11 +597,8 @@ static int configure_hardware(struct cpcap_usb_det_data *data,
 					     0, CPCAP_BIT_RVRSMODE);
 		cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_CHRG);
 		cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_MODE);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC1,
-					     CPCAP_BIT_VBUSPD,
-					     CPCAP_BIT_VBUSPD);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC3, 0,
-					     CPCAP_BIT_VBUSSTBY_EN);
+		retval |= cpcap_regacc_write_batch(data->cpcap, charger,
+						   ARRAY_SIZE(charger));
 		break;
 
 	case CPCAP_ACCY_WHISPER_PPD:
@@ -581,11 +606,8 @@ static int configure_hardware(struct cpcap_usb_det_data *data,
 		pdata->usb_mux->configure_otg_muxmode(SAFE_MODE);
 		if (pdata->ind_chrg->force_cable_path != NULL)
 			pdata->ind_chrg->force_cable_path(1);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC1, 0,
-					     CPCAP_BIT_VBUSPD);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_CRM,
-					     CPCAP_BIT_RVRSMODE,
-					     CPCAP_BIT_RVRSMODE);
+		retval |= cpcap_regacc_write_batch(data->cpcap, whisper_ppd,
+						   ARRAY_SIZE(whisper_ppd));
 		for (count = 0; count < 50; count++) {
 			cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_CHRG);
 			cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_MODE);
@@ -606,29 +628,8 @@ static int configure_hardware(struct cpcap_usb_det_data *data,
 	case CPCAP_ACCY_USB_DEVICE:
 		pdata->usb_mux->configure_switch_muxmode(OTG_DM_DP);
 		pdata->usb_mux->configure_otg_muxmode(USB_OTG);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC1,
-					     0,
-					     CPCAP_BIT_VBUSPD);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC2,
-					     CPCAP_BIT_USBXCVREN,
-					     CPCAP_BIT_USBXCVREN);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC3, 0,
-					     CPCAP_BIT_VBUSSTBY_EN);
-		/* Give USB driver control of pull up via ULPI. */
-		if (data->usb_drv_ctrl_via_ulpi == STATUS_SUPPORTED) {
-			retval |= cpcap_regacc_write(data->cpcap,
-						     CPCAP_REG_USBC3,
-						     0,
-						     CPCAP_BIT_PU_SPI |
-						     CPCAP_BIT_DMPD_SPI |
-						     CPCAP_BIT_DPPD_SPI |
-						     CPCAP_BIT_SUSPEND_SPI |
-						     CPCAP_BIT_ULPI_SPI_SEL);
-			retval |= cpcap_regacc_write(data->cpcap,
-						     CPCAP_REG_USBC2,
-						     CPCAP_BIT_USBXCVREN,
-						     CPCAP_BIT_USBXCVREN);
-		}
+		retval |= cpcap_regacc_write_batch(data->cpcap, usb,
+						   ulpi ? 5 : 3);
 		break;
 
 	case CPCAP_ACCY_UNKNOWN:
@@ -636,22 +637,12 @@ static int configure_hardware(struct cpcap_usb_det_data *data,
 		pdata->usb_mux->configure_otg_muxmode(SAFE_MODE);
 		if (pdata->ind_chrg->force_cable_path != NULL)
 			pdata->ind_chrg->force_cable_path(0);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC1, 0,
-					     CPCAP_BIT_VBUSPD |
-					     CPCAP_BIT_ID100KPU);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_CRM, 0,
-					     CPCAP_BIT_RVRSMODE);
+		retval |= cpcap_regacc_write_batch(data->cpcap, unknown_pre,
+						   ARRAY_SIZE(unknown_pre));
 		cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_CHRG);
 		cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_MODE);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC2, 0,
-					     CPCAP_BIT_EMUMODE2 |
-					     CPCAP_BIT_EMUMODE1 |
-					     CPCAP_BIT_EMUMODE0);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC3,
-					     CPCAP_BIT_VBUSSTBY_EN,
-					     CPCAP_BIT_VBUSSTBY_EN);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_VUSBC, 0,
-					     CPCAP_BIT_VBUS_SWITCH);
+		retval |= cpcap_regacc_write_batch(data->cpcap, unknown,
+						   ARRAY_SIZE(unknown));
 		data->whisper_auth = AUTH_NOT_STARTED;
 		break;
 
@@ -667,29 +658,8 @@ static int configure_hardware(struct cpcap_usb_det_data *data,
 					     CPCAP_BIT_RVRSMODE);
 		cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_CHRG);
 		cpcap_irq_clear(data->cpcap, CPCAP_IRQ_RVRS_MODE);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_VUSBC, 0,
-					     CPCAP_BIT_VBUS_SWITCH);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC1,
-					     CPCAP_BIT_VBUSPD,
-					     CPCAP_BIT_VBUSPD);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC2,
-					     CPCAP_BIT_USBSUSPEND,
-					     CPCAP_BIT_USBXCVREN |
-					     CPCAP_BIT_USBSUSPEND);
-		retval |= cpcap_regacc_write(data->cpcap, CPCAP_REG_USBC3,
-					     CPCAP_BIT_VBUSSTBY_EN,
-					     CPCAP_BIT_VBUSSTBY_EN);
-		if (data->usb_drv_ctrl_via_ulpi == STATUS_SUPPORTED)
-			retval |= cpcap_regacc_write(data->cpcap,
-						     CPCAP_REG_USBC3,
-						     CPCAP_BIT_DMPD_SPI |
-						     CPCAP_BIT_DPPD_SPI |
-						     CPCAP_BIT_SUSPEND_SPI |
-						     CPCAP_BIT_ULPI_SPI_SEL,
-						     CPCAP_BIT_DMPD_SPI |
-						     CPCAP_BIT_DPPD_SPI |
-						     CPCAP_BIT_SUSPEND_SPI |
-						     CPCAP_BIT_ULPI_SPI_SEL);
+		retval |= cpcap_regacc_write_batch(data->cpcap, none,
+						   ulpi ? 5 : 4);
 		data->whisper_auth = AUTH_NOT_STARTED;
 		break;
 	}
@@ -677,7 +677,10 @@ static void apanic_mmc_memdump(void)
 		return;
 	}
 
-	/* no need to flush_cache_all(); */
+	/*
+	 * no need to flush_cache_all(): the raw driver writes large
+	 * buffers by ADMA, in chunks, cleaning each from the caches
+	 */
 	/* get the last memory bank, probably the only bank */
 	if (meminfo.nr_banks >= 1 && meminfo.nr_banks < NR_BANKS)
 		bank = &meminfo.bank[meminfo.nr_banks - 1];
@@ -28,6 +28,7 @@
 #include <linux/irq.h>
 #include <linux/miscdevice.h>
 #include <linux/regulator/consumer.h>
+#include <linux/sensor_hub.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
 #include <linux/uaccess.h>
@@ -180,6 +181,10 @@ struct kxtf9_data {
 	u8 resume_state[14];
 
 	struct regulator *regulator;
+
+	/* polled on the sensor hub tick instead of input_work */
+	struct sensor_hub_producer hub;
+	bool hub_registered;
 };
 
 /*
@@ -555,6 +560,40 @@ static void kxtf9_report_values(struct kxtf9_data *tf9, int *xyz)
 	input_sync(tf9->input_dev);
 }
 
+static int kxtf9_hub_sample(struct sensor_hub_producer *p, s32 *values)
+{
+	struct kxtf9_data *tf9 = container_of(p, struct kxtf9_data, hub);
+	int xyz[3] = { 0 };
+	int err;
+
+	mutex_lock(&tf9->lock);
+	err = kxtf9_get_acceleration_data(tf9, xyz);
+	if (err < 0)
+		dev_err(&tf9->client->dev, "get_acceleration_data failed\n");
+	else
+		kxtf9_report_values(tf9, xyz);
+	mutex_unlock(&tf9->lock);
+
+	if (err < 0)
+		return err;
+
+	values[0] = xyz[0];
+	values[1] = xyz[1];
+	values[2] = xyz[2];
+
+	return 3;
+}
+
+static void kxtf9_start_polling(struct kxtf9_data *tf9)
+{
+	if (tf9->hub_registered)
+		sensor_hub_set_interval(&tf9->hub, tf9->pdata->poll_interval);
+	else
+		schedule_delayed_work(&tf9->input_work,
+				      msecs_to_jiffies(tf9->
+						       pdata->poll_interval));
+}
+
 static int kxtf9_enable(struct kxtf9_data *tf9)
 {
 	int err;
@@ -566,9 +605,7 @@ static int kxtf9_enable(struct kxtf9_data *tf9)
 			atomic_set(&tf9->enabled, 0);
 			return err;
 		}
-		schedule_delayed_work(&tf9->input_work,
-				      msecs_to_jiffies(tf9->
-						       pdata->poll_interval));
+		kxtf9_start_polling(tf9);
 	}
 
 	return 0;
@@ -577,6 +614,8 @@ static int kxtf9_enable(struct kxtf9_data *tf9)
 static int kxtf9_disable(struct kxtf9_data *tf9)
 {
 	if (atomic_cmpxchg(&tf9->enabled, 1, 0)) {
+		if (tf9->hub_registered)
+			sensor_hub_set_interval(&tf9->hub, 0);
 		cancel_delayed_work_sync(&tf9->input_work);
 		kxtf9_device_power_off(tf9);
 	}
@@ -624,6 +663,9 @@ static long kxtf9_misc_ioctl(struct file *file, unsigned int cmd,
 		err = kxtf9_update_odr(tf9, tf9->pdata->poll_interval);
 		if (err < 0)
 			return err;
+		if (tf9->hub_registered && atomic_read(&tf9->enabled))
+			sensor_hub_set_interval(&tf9->hub,
+						tf9->pdata->poll_interval);
 
 		break;
 
@@ -922,6 +964,12 @@ static int kxtf9_probe(struct i2c_client *client,
 
 	mutex_unlock(&tf9->lock);
 
+	/* the hub tick takes tf9->lock, so not under it */
+	tf9->hub.name = NAME;
+	tf9->hub.type = SENSOR_HUB_TYPE_ACCEL;
+	tf9->hub.sample = kxtf9_hub_sample;
+	tf9->hub_registered = !sensor_hub_register(&tf9->hub);
+
 	dev_info(&client->dev, "kxtf9 probed\n");
 
 	return 0;
@@ -955,6 +1003,8 @@ static int __devexit kxtf9_remove(struct i2c_client *client)
 
 	unregister_pm_notifier(&tf9->pm_notifier);
 	misc_deregister(&kxtf9_misc_device);
+	if (tf9->hub_registered)
+		sensor_hub_unregister(&tf9->hub);
 	kxtf9_input_cleanup(tf9);
 	kxtf9_device_power_off(tf9);
 	if (tf9->pdata->tdt_always_on)
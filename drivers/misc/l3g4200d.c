@@ -29,6 +29,7 @@
 #include <linux/miscdevice.h>
 #include <linux/mutex.h>
 #include <linux/regulator/consumer.h>
+#include <linux/sensor_hub.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
 #include <linux/uaccess.h>
@@ -55,7 +56,7 @@
 #define L3G4200D_OUT_Z_H		0x2d
 
 #define L3G4200D_FIFO_CTRL		0x2e
-#define L3G4200D_FIFO_SRC		0x2e
+#define L3G4200D_FIFO_SRC		0x2f
 
 #define L3G4200D_INTERRUPT_CFG		0x30
 #define L3G4200D_INTERRUPT_SRC		0x31
@@ -75,6 +76,17 @@
 #define ODR400_BW110	0xB0
 #define ODR800_BW110	0xF0
 
+#define I2_DRDY				0x08
+#define I2_WTM				0x04
+#define FIFO_EN				0x40
+#define FIFO_MODE_BYPASS		0x00
+#define FIFO_MODE_STREAM		0x40
+#define FIFO_OVRN			0x40
+#define FIFO_FSS_MASK			0x1f
+#define L3G4200D_FIFO_SIZE		32
+/* leave room for the samples that come in while the FIFO is read */
+#define L3G4200D_FIFO_WTM_MAX		24
+
 #define I2C_RETRY_DELAY			5
 #define I2C_RETRIES			5
 #define AUTO_INCREMENT			0x80
@@ -92,6 +104,15 @@ struct l3g4200d_data {
 	struct delayed_work enable_work;
 	struct mutex mutex;  /* used for all functions */
 	struct notifier_block pm_notifier;
+
+	u32 odr_us;
+	u32 latency_ms;
+	u8 fifo_wtm;	/* samples per batch, 0 when not batching */
+	u8 fifo_buf[1 + L3G4200D_FIFO_SIZE * 6];
+
+	ktime_t irq_time;
+	struct sensor_hub_producer hub;
+	bool hub_registered;
 };
 
 struct gyro_val {
@@ -223,6 +244,57 @@ static int l3g4200d_hw_init(struct l3g4200d_data *gyro)
 		return err;
 
 	gyro->hw_initialized = true;
+	gyro->fifo_wtm = 0;
+
+	return 0;
+}
+
+/*
+ * Batching: with a report latency of several output periods the FIFO runs
+ * in stream mode and INT2 signals the watermark instead of data ready, so
+ * there is one interrupt and one burst read per batch.  Switching through
+ * bypass mode also empties the FIFO.
+ */
+static int l3g4200d_config_fifo(struct l3g4200d_data *gyro)
+{
+	u32 wtm = gyro->latency_ms * USEC_PER_MSEC / gyro->odr_us;
+	u8 buf[2];
+	int err;
+
+	if (wtm < 2)
+		wtm = 0;
+	else if (wtm > L3G4200D_FIFO_WTM_MAX)
+		wtm = L3G4200D_FIFO_WTM_MAX;
+
+	buf[0] = L3G4200D_FIFO_CTRL;
+	buf[1] = FIFO_MODE_BYPASS;
+	err = l3g4200d_i2c_write(gyro, buf, 1);
+	if (err < 0)
+		return err;
+
+	buf[0] = L3G4200D_CTRL_REG3;
+	buf[1] = gyro->pdata->ctrl_reg3;
+	if (wtm)
+		buf[1] = (buf[1] & ~I2_DRDY) | I2_WTM;
+	err = l3g4200d_i2c_write(gyro, buf, 1);
+	if (err < 0)
+		return err;
+
+	buf[0] = L3G4200D_CTRL_REG5;
+	buf[1] = gyro->pdata->ctrl_reg5;
+	if (wtm)
+		buf[1] |= FIFO_EN;
+	err = l3g4200d_i2c_write(gyro, buf, 1);
+	if (err < 0)
+		return err;
+
+	buf[0] = L3G4200D_FIFO_CTRL;
+	buf[1] = wtm ? (FIFO_MODE_STREAM | wtm) : gyro->pdata->fifo_ctrl_reg;
+	err = l3g4200d_i2c_write(gyro, buf, 1);
+	if (err < 0)
+		return err;
+
+	gyro->fifo_wtm = wtm;
 
 	return 0;
 }
@@ -328,6 +400,73 @@ static void l3g4200d_report_values(struct l3g4200d_data *gyro,
 			 data->x, data->y, data->z);
 }
 
+static void l3g4200d_hub_push(struct l3g4200d_data *gyro, ktime_t stamp,
+			      struct gyro_val *data)
+{
+	s32 values[3] = { data->x, data->y, data->z };
+
+	if (gyro->hub_registered)
+		sensor_hub_push(&gyro->hub, stamp, values, ARRAY_SIZE(values));
+}
+
+/*
+ * Read everything the FIFO holds in one burst; with the FIFO enabled the
+ * output address wraps from OUT_Z_H back to OUT_X_L.  The newest sample is
+ * stamped with the time the FIFO level was read and the older ones one
+ * output period apart.
+ */
+static int l3g4200d_drain_fifo(struct l3g4200d_data *gyro)
+{
+	struct gyro_val data;
+	ktime_t now;
+	u8 *p = gyro->fifo_buf;
+	int count;
+	int err;
+	int i;
+
+	p[0] = L3G4200D_FIFO_SRC;
+	err = l3g4200d_i2c_read(gyro, p, 1);
+	if (err < 0)
+		return err;
+	now = ktime_get();
+
+	count = p[0] & FIFO_FSS_MASK;
+	if (p[0] & FIFO_OVRN)
+		count = L3G4200D_FIFO_SIZE;
+	if (!count)
+		return 0;
+
+	p[0] = (AUTO_INCREMENT | L3G4200D_OUT_X_L);
+	err = l3g4200d_i2c_read(gyro, p, count * 6);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < count; i++, p += 6) {
+		ktime_t ts = ktime_sub_us(now,
+					  (u64)(count - 1 - i) * gyro->odr_us);
+
+		data.x = (p[1] << 8) | p[0];
+		data.y = (p[3] << 8) | p[2];
+		data.z = (p[5] << 8) | p[4];
+
+		input_event(gyro->input_dev, EV_MSC, MSC_TIMESTAMP,
+			    (u32)ktime_to_us(ts));
+		l3g4200d_report_values(gyro, &data);
+		l3g4200d_hub_push(gyro, ts, &data);
+	}
+
+	return 0;
+}
+
+static irqreturn_t gyro_irq_handler(int irq, void *dev)
+{
+	struct l3g4200d_data *gyro = dev;
+
+	gyro->irq_time = ktime_get();
+
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t gyro_irq_thread(int irq, void *dev)
 {
 	struct l3g4200d_data *gyro = dev;
@@ -336,11 +475,21 @@ static irqreturn_t gyro_irq_thread(int irq, void *dev)
 
 	mutex_lock(&gyro->mutex);
 
+	if (gyro->fifo_wtm) {
+		err = l3g4200d_drain_fifo(gyro);
+		if (err < 0)
+			dev_err(&gyro->client->dev, "fifo read failed\n");
+		mutex_unlock(&gyro->mutex);
+		return IRQ_HANDLED;
+	}
+
 	err = l3g4200d_get_gyro_data(gyro, &data);
-	if (err < 0)
+	if (err < 0) {
 		dev_err(&gyro->client->dev, "get_acceleration_data failed\n");
-	else
+	} else {
 		l3g4200d_report_values(gyro, &data);
+		l3g4200d_hub_push(gyro, gyro->irq_time, &data);
+	}
 
 	mutex_unlock(&gyro->mutex);
 
@@ -350,8 +499,15 @@ static irqreturn_t gyro_irq_thread(int irq, void *dev)
 static int l3g4200d_flush_gyro_data(struct l3g4200d_data *gyro)
 {
 	struct gyro_val data;
+	int err;
 	int i;
 
+	if (gyro->latency_ms) {
+		err = l3g4200d_config_fifo(gyro);
+		if (err < 0 || gyro->fifo_wtm)
+			return err;
+	}
+
 	for (i = 0; i < 5; i++) {
 		if (gpio_get_value(gyro->pdata->gpio_drdy))
 			l3g4200d_get_gyro_data(gyro, &data);
@@ -471,6 +627,7 @@ static int l3g4200d_set_delay(struct l3g4200d_data *gyro, u32 delay_ms)
 	}
 
 	gyro->pdata->poll_interval = delay_us / USEC_PER_MSEC;
+	gyro->odr_us = delay_us;
 	/* noisy data upto 6/ODR */
 	msleep((delay_us * 6) / USEC_PER_MSEC);
 
@@ -531,6 +688,27 @@ static long l3g4200d_misc_ioctl_locked(struct file *file,
 
 		break;
 
+	case L3G4200D_IOCTL_SET_LATENCY:
+		if (copy_from_user(&interval, argp, sizeof(interval)))
+			return -EFAULT;
+		if (interval < 0)
+			return -EINVAL;
+
+		gyro->latency_ms = interval;
+		/* the irq thread serializes on the mutex we hold */
+		if (gyro->enabled && !delayed_work_pending(&gyro->enable_work)) {
+			err = l3g4200d_config_fifo(gyro);
+			if (err < 0)
+				return err;
+		}
+		break;
+
+	case L3G4200D_IOCTL_GET_LATENCY:
+		interval = gyro->latency_ms;
+		if (copy_to_user(argp, &interval, sizeof(interval)))
+			return -EFAULT;
+		break;
+
 	default:
 		return -EINVAL;
 	}
@@ -581,6 +759,7 @@ static int l3g4200d_input_init(struct l3g4200d_data *gyro)
 	input_set_capability(gyro->input_dev, EV_REL, REL_RX);
 	input_set_capability(gyro->input_dev, EV_REL, REL_RY);
 	input_set_capability(gyro->input_dev, EV_REL, REL_RZ);
+	input_set_capability(gyro->input_dev, EV_MSC, MSC_TIMESTAMP);
 
 	gyro->input_dev->name = "gyroscope";
 
@@ -655,6 +834,7 @@ static int l3g4200d_probe(struct i2c_client *client,
 {
 	struct l3g4200d_data *gyro;
 	int err = -1;
+	int i;
 
 	pr_err("%s:Enter\n", __func__);
 	if (client->dev.platform_data == NULL) {
@@ -686,6 +866,11 @@ static int l3g4200d_probe(struct i2c_client *client,
 	memcpy(gyro->pdata, client->dev.platform_data, sizeof(*gyro->pdata));
 
 	gyro->client->irq = gyro->pdata->irq;
+	gyro->odr_us = gyro_odr_table[ARRAY_SIZE(gyro_odr_table) - 1].delay_us;
+	for (i = 0; i < ARRAY_SIZE(gyro_odr_table); i++)
+		if ((gyro->pdata->ctrl_reg1 & ODR_MASK) ==
+		    gyro_odr_table[i].odr_mask)
+			gyro->odr_us = gyro_odr_table[i].delay_us;
 
 	gyro->regulator = regulator_get(&client->dev,
 				gyro->pdata->regulator_name);
@@ -715,7 +900,11 @@ static int l3g4200d_probe(struct i2c_client *client,
 		goto err4;
 	}
 
-	err = request_threaded_irq(gyro->client->irq, NULL,
+	gyro->hub.name = L3G4200D_NAME;
+	gyro->hub.type = SENSOR_HUB_TYPE_GYRO;
+	gyro->hub_registered = !sensor_hub_register(&gyro->hub);
+
+	err = request_threaded_irq(gyro->client->irq, gyro_irq_handler,
 		gyro_irq_thread, IRQF_TRIGGER_HIGH | IRQF_ONESHOT,
 		L3G4200D_NAME, gyro);
 	if (err != 0) {
@@ -738,6 +927,8 @@ static int l3g4200d_probe(struct i2c_client *client,
 err6:
 	free_irq(gyro->client->irq, gyro);
 err5:
+	if (gyro->hub_registered)
+		sensor_hub_unregister(&gyro->hub);
 	misc_deregister(&l3g4200d_misc_device);
 err4:
 	mutex_destroy(&gyro->mutex);
@@ -764,6 +955,8 @@ static int __devexit l3g4200d_remove(struct i2c_client *client)
 		regulator_put(gyro->regulator);
 	unregister_pm_notifier(&gyro->pm_notifier);
 	free_irq(gyro->client->irq, gyro);
+	if (gyro->hub_registered)
+		sensor_hub_unregister(&gyro->hub);
 	kfree(gyro->pdata);
 	kfree(gyro);
 
@@ -26,6 +26,7 @@
 #include <linux/gpio_mapping.h>
 #include <linux/fs.h>
 #include <linux/slab.h>
+#include <linux/bitmap.h>
 
 #include <linux/lm48901.h>
 
@@ -169,10 +170,21 @@ enum {
 #define I2C_RETRY_DELAY		5
 #define I2C_RETRIES		5
 
+/* coefficient RAM and control registers, shadowed in lm48901_data */
+#define LM48901_CACHE_LEN	(LM48901_MBIST_STAT_REG + 1)
+
+/* words sent in one auto-increment write */
+#define LM48901_BURST_LEN	64
+
 struct lm48901_data {
 	struct i2c_client *client;
 	struct lm48901_platform_data *pdata;
 	struct mutex lock; /* used for all functions */
+
+	/* last value written to or read from each register */
+	unsigned int cache[LM48901_CACHE_LEN];
+	DECLARE_BITMAP(cache_valid, LM48901_CACHE_LEN);
+	u8 burst_buf[2 + 4 * LM48901_BURST_LEN];
 };
 
 /*
@@ -241,28 +253,35 @@ static int lm48901_i2c_read(struct lm48901_data *lm48901,
 	return err;
 }
 
+/* Write count words from reg on, the address auto-increments */
 static int lm48901_i2c_write(struct lm48901_data *lm48901,
-				unsigned short reg, unsigned int value)
+				unsigned short reg, const unsigned int *values,
+				int count)
 {
 	int err;
 	int tries = 0;
-	u8 buf[6] = { 0, 0, 0, 0, 0, 0 };
+	int i;
+	u8 *buf = lm48901->burst_buf;
 
 	struct i2c_msg msgs[] = {
 		{
 		 .addr = lm48901->client->addr,
 		 .flags = lm48901->client->flags & I2C_M_TEN,
-		 .len = 6,
+		 .len = 2 + 4 * count,
 		 .buf = buf,
 		 },
 	};
 
+	BUG_ON(count > LM48901_BURST_LEN);
+
 	buf[0] = reg >> 8;
 	buf[1] = reg & 0xff;
-	buf[2] = value & 0xff;
-	buf[3] = (value >> 8) & 0xff;
-	buf[4] = (value >> 16) & 0xff;
-	buf[5] = (value >> 24) & 0xff;
+	for (i = 0; i < count; i++) {
+		buf[2 + 4 * i] = values[i] & 0xff;
+		buf[3 + 4 * i] = (values[i] >> 8) & 0xff;
+		buf[4 + 4 * i] = (values[i] >> 16) & 0xff;
+		buf[5 + 4 * i] = (values[i] >> 24) & 0xff;
+	}
 
 	do {
 		err = i2c_transfer(lm48901->client->adapter, msgs, 1);
@@ -280,6 +299,91 @@ static int lm48901_i2c_write(struct lm48901_data *lm48901,
 	return err;
 }
 
+/* Status, debug and counter registers change under us */
+static bool lm48901_volatile(unsigned short reg)
+{
+	switch (reg) {
+	case LM48901_FILTER_DEBUG0_REG:
+	case LM48901_FILTER_DEBUG1_REG:
+	case LM48901_FILTER_STATUS_REG:
+	case LM48901_FILTER_TAP_REG ... LM48901_STAT_ACNT2_REG:
+	case LM48901_READBACK_REG:
+	case LM48901_MBIST_STAT_REG:
+		return true;
+	default:
+		return reg >= LM48901_CACHE_LEN;
+	}
+}
+
+static int __lm48901_reg_read(struct lm48901_data *lm48901,
+			unsigned short reg,
+			unsigned int *value)
+{
+	int retval;
+
+	if (!lm48901_volatile(reg) && test_bit(reg, lm48901->cache_valid)) {
+		*value = lm48901->cache[reg];
+		return 0;
+	}
+
+	retval = lm48901_i2c_read(lm48901, reg, value);
+	if (retval == 0 && !lm48901_volatile(reg)) {
+		lm48901->cache[reg] = *value;
+		set_bit(reg, lm48901->cache_valid);
+	}
+
+	return retval;
+}
+
+/*
+ * Write count words from reg on, skipping the ones the chip already
+ * holds and sending each run of changed words as one burst.
+ */
+static int __lm48901_reg_write_block(struct lm48901_data *lm48901,
+			unsigned short reg,
+			const unsigned int *values,
+			int count)
+{
+	int retval;
+	int i = 0;
+	int n;
+
+	while (i < count) {
+		if (!lm48901_volatile(reg + i) &&
+		    test_bit(reg + i, lm48901->cache_valid) &&
+		    lm48901->cache[reg + i] == values[i]) {
+			i++;
+			continue;
+		}
+
+		for (n = 1; n < LM48901_BURST_LEN && i + n < count; n++) {
+			if (lm48901_volatile(reg + i + n))
+				break;
+			if (test_bit(reg + i + n, lm48901->cache_valid) &&
+			    lm48901->cache[reg + i + n] == values[i + n])
+				break;
+		}
+
+		retval = lm48901_i2c_write(lm48901, reg + i, values + i, n);
+
+		/* after a failed burst, any part of it may have landed */
+		for (; n > 0; i++, n--) {
+			if (lm48901_volatile(reg + i))
+				continue;
+			lm48901->cache[reg + i] = values[i];
+			if (retval == 0)
+				set_bit(reg + i, lm48901->cache_valid);
+			else
+				clear_bit(reg + i, lm48901->cache_valid);
+		}
+
+		if (retval != 0)
+			return retval;
+	}
+
+	return 0;
+}
+
 static int lm48901_reg_read(struct lm48901_data *lm48901,
 			unsigned short reg,
 			unsigned int *value)
@@ -288,7 +392,7 @@ static int lm48901_reg_read(struct lm48901_data *lm48901,
 
 	mutex_lock(&lm48901->lock);
 
-	retval = lm48901_i2c_read(lm48901, reg , value);
+	retval = __lm48901_reg_read(lm48901, reg , value);
 
 	mutex_unlock(&lm48901->lock);
 
@@ -300,14 +404,16 @@ static int lm48901_reg_write(struct lm48901_data *lm48901,
 			unsigned int value,
 		       unsigned int mask)
 {
-	int retval = -EINVAL;
+	int retval = 0;
 	unsigned int old_value = 0;
 
 	mutex_lock(&lm48901->lock);
 
 	value &= mask;
 
-	retval = lm48901_i2c_read(lm48901, reg , &old_value);
+	/* a whole register is written as is */
+	if (mask != 0xFFFFFFFF)
+		retval = __lm48901_reg_read(lm48901, reg , &old_value);
 
 	pr_debug("Old value = 0x%08X\n", old_value);
 
@@ -319,7 +425,7 @@ static int lm48901_reg_write(struct lm48901_data *lm48901,
 
 	pr_debug("New value = 0x%08X\n", value);
 
-	retval = lm48901_i2c_write(lm48901, reg, value);
+	retval = __lm48901_reg_write_block(lm48901, reg, &value, 1);
 
 error:
 
@@ -328,6 +434,27 @@ error:
 	return retval;
 }
 
+/* Program a coefficient table, with the DSP in debug mode */
+static int lm48901_load_coef(struct lm48901_data *lm48901,
+			const unsigned int *coef)
+{
+	int retval;
+
+	retval = lm48901_reg_write(lm48901, LM48901_FILTER_DEBUG1_REG,
+		LM48901_DBG_ENABLE_M, LM48901_DBG_ENABLE_M);
+	if (retval != 0)
+		return retval;
+
+	mutex_lock(&lm48901->lock);
+	retval = __lm48901_reg_write_block(lm48901, 0, coef, LM48901_TAB_LEN);
+	mutex_unlock(&lm48901->lock);
+
+	lm48901_reg_write(lm48901, LM48901_FILTER_DEBUG1_REG,
+		~LM48901_DBG_ENABLE_M, LM48901_DBG_ENABLE_M);
+
+	return retval;
+}
+
 static int lm48901_misc_open(struct inode *inode, struct file *file)
 {
 	int err;
@@ -353,8 +480,13 @@ static long lm48901_misc_ioctl(struct file *file, unsigned int cmd,
 	switch (cmd) {
 	case LM48901_IOCTL_AMP_DISABLE:
 		pr_debug("Disabled a lm48901_amp_en\n");
-		if (lm48901->pdata->amp_en_gpio != -1)
+		if (lm48901->pdata->amp_en_gpio != -1) {
 			gpio_set_value(lm48901->pdata->amp_en_gpio, 0);
+			/* registers are back to reset values on enable */
+			mutex_lock(&lm48901->lock);
+			bitmap_zero(lm48901->cache_valid, LM48901_CACHE_LEN);
+			mutex_unlock(&lm48901->lock);
+		}
 		break;
 
 	case LM48901_IOCTL_AMP_ENABLE:
@@ -365,7 +497,6 @@ static long lm48901_misc_ioctl(struct file *file, unsigned int cmd,
 
 	case LM48901_IOCTL_INIT:
 		{
-		int i = 0;
 		unsigned int value = 0;
 
 		if (copy_from_user(&value, argp, sizeof(value)))
@@ -447,16 +578,7 @@ static long lm48901_misc_ioctl(struct file *file, unsigned int cmd,
 			0x00000003, LM48901_RX_WIDTH_M);
 
 		/*load coef*/
-		lm48901_reg_write(lm48901, LM48901_FILTER_DEBUG1_REG,
-			LM48901_DBG_ENABLE_M, LM48901_DBG_ENABLE_M);
-
-		for (i = 0; i < LM48901_TAB_LEN; i++) {
-			lm48901_reg_write(lm48901, i,
-				lm48901_tab_2p1_3ch[i], 0xFFFFFFFF);
-		}
-
-		lm48901_reg_write(lm48901, LM48901_FILTER_DEBUG1_REG,
-			~LM48901_DBG_ENABLE_M, LM48901_DBG_ENABLE_M);
+		lm48901_load_coef(lm48901, lm48901_tab_2p1_3ch);
 
 		}
 		break;
@@ -719,7 +841,6 @@ static long lm48901_misc_ioctl(struct file *file, unsigned int cmd,
 		{
 		unsigned int value = 0;
 		const unsigned int *lm48901_coef = NULL;
-		int i = 0;
 
 		if (copy_from_user(&value, argp, sizeof(value)))
 			return -EFAULT;
@@ -740,18 +861,8 @@ static long lm48901_misc_ioctl(struct file *file, unsigned int cmd,
 			break;
 		}
 
-		if (lm48901_coef != NULL) {
-			lm48901_reg_write(lm48901, LM48901_FILTER_DEBUG1_REG,
-				LM48901_DBG_ENABLE_M, LM48901_DBG_ENABLE_M);
-
-			for (i = 0; i < LM48901_TAB_LEN; i++) {
-				lm48901_reg_write(lm48901, i,
-					lm48901_coef[i], 0xFFFFFFFF);
-			}
-
-			lm48901_reg_write(lm48901, LM48901_FILTER_DEBUG1_REG,
-				~LM48901_DBG_ENABLE_M, LM48901_DBG_ENABLE_M);
-		}
+		if (lm48901_coef != NULL)
+			lm48901_load_coef(lm48901, lm48901_coef);
 
 		}
 		break;
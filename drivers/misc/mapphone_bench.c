@@ -0,0 +1,715 @@
+/*
+ * Microbenchmarks for mapphone kernel hot paths
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Every benchmark has a file in <debugfs>/mapphone-bench.  Writing a
+ * number of iterations to it runs the benchmark from the writer's
+ * context, reading it back gives the result of the last run:
+ *
+ *	# echo 1000 > /sys/kernel/debug/mapphone-bench/zram_compress
+ *	# cat /sys/kernel/debug/mapphone-bench/zram_compress
+ *	n 1000 min 61035 median 62256 p99 70190 ns, 16043 ops/s, 62 MB/s
+ *
+ * Each iteration is timed on its own with ktime_get(), so the figures
+ * include the cost of the clock read, about a microsecond on OMAP4.
+ *
+ * The mailbox round trip needs a remote processor that echoes messages
+ * back; it only runs with mapphone_bench.mbox=<mailbox name>.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/vmalloc.h>
+#include <linux/lzo.h>
+
+#if defined(CONFIG_ION_OMAP) || defined(CONFIG_ION_OMAP_MODULE)
+#include <linux/ion.h>
+#include <linux/omap_ion.h>
+#endif
+#if defined(CONFIG_TI_TILER) || defined(CONFIG_TI_TILER_MODULE)
+#include <mach/tiler.h>
+#endif
+#ifdef CONFIG_ASHMEM
+#include <linux/ashmem.h>
+#include <linux/mman.h>
+#endif
+#if defined(CONFIG_MFD_CPCAP) || defined(CONFIG_MFD_CPCAP_MODULE)
+#include <linux/spi/cpcap.h>
+#endif
+#ifdef CONFIG_OMAP_MBOX_FWK
+#include <linux/completion.h>
+#include <linux/notifier.h>
+#include <plat/mailbox.h>
+#endif
+
+#define BENCH_MAX_ITERATIONS	100000
+#define BENCH_RESULT_SIZE	128
+
+#define BENCH_ION_SIZE		(64 * 1024)
+#define BENCH_TILER_WIDTH	640
+#define BENCH_TILER_HEIGHT	480
+
+static char *mbox = "";
+module_param(mbox, charp, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mbox, "mailbox for the round trip, the remote must echo");
+
+static char *logger = "/dev/log/main";
+module_param(logger, charp, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(logger, "logger device written by logger_write");
+
+struct bench {
+	const char *name;
+	size_t bytes;			/* per iteration, 0 if meaningless */
+	int (*setup)(struct bench *b);
+	int (*run)(struct bench *b);
+	void (*teardown)(struct bench *b);
+	void *priv;
+	char result[BENCH_RESULT_SIZE];
+};
+
+static DEFINE_MUTEX(bench_lock);
+static struct dentry *bench_dir;
+
+#if defined(CONFIG_ION_OMAP) || defined(CONFIG_ION_OMAP_MODULE)
+extern struct ion_device *omap_ion_device;
+
+static int bench_ion_setup(struct bench *b)
+{
+	struct ion_client *client;
+
+	if (!omap_ion_device)
+		return -ENODEV;
+
+	client = ion_client_create(omap_ion_device, -1, "mapphone-bench");
+	if (IS_ERR_OR_NULL(client))
+		return client ? PTR_ERR(client) : -ENOMEM;
+
+	b->priv = client;
+	return 0;
+}
+
+static void bench_ion_teardown(struct bench *b)
+{
+	ion_client_destroy(b->priv);
+}
+
+static int bench_ion_system(struct bench *b)
+{
+	struct ion_handle *handle;
+
+	handle = ion_alloc(b->priv, BENCH_ION_SIZE, PAGE_SIZE,
+			   1 << OMAP_ION_HEAP_SYSTEM);
+	if (IS_ERR_OR_NULL(handle))
+		return handle ? PTR_ERR(handle) : -ENOMEM;
+
+	ion_free(b->priv, handle);
+	return 0;
+}
+
+static int bench_ion_tiler(struct bench *b)
+{
+	struct omap_ion_tiler_alloc_data data = {
+		.w = BENCH_TILER_WIDTH,
+		.h = BENCH_TILER_HEIGHT,
+		.fmt = TILER_PIXEL_FMT_8BIT,
+	};
+	int ret;
+
+	ret = omap_ion_tiler_alloc(b->priv, &data);
+	if (ret)
+		return ret;
+
+	ion_free(b->priv, data.handle);
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_TI_TILER) || defined(CONFIG_TI_TILER_MODULE)
+struct bench_tiler {
+	u32 n_pages;
+	u32 addrs[0];
+};
+
+static int bench_tiler_setup(struct bench *b)
+{
+	struct bench_tiler *t;
+	u32 n_pages, n_virt;
+	struct page *pg;
+	int i;
+
+	if (tiler_memsize(TILFMT_8BIT, BENCH_TILER_WIDTH, BENCH_TILER_HEIGHT,
+			  &n_pages, &n_virt))
+		return -EINVAL;
+
+	t = kzalloc(sizeof(*t) + n_pages * sizeof(u32), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	for (i = 0; i < n_pages; i++) {
+		pg = alloc_page(GFP_KERNEL);
+		if (!pg)
+			break;
+		t->addrs[t->n_pages++] = page_to_phys(pg);
+	}
+
+	b->priv = t;
+	return t->n_pages == n_pages ? 0 : -ENOMEM;
+}
+
+static void bench_tiler_teardown(struct bench *b)
+{
+	struct bench_tiler *t = b->priv;
+	int i;
+
+	for (i = 0; i < t->n_pages; i++)
+		__free_page(phys_to_page(t->addrs[i]));
+	kfree(t);
+}
+
+/* what the tiler heap does for a buffer that is not in its pool */
+static int bench_tiler_pin(struct bench *b)
+{
+	struct bench_tiler *t = b->priv;
+	tiler_blk_handle handle;
+	u32 ssptr;
+	int ret;
+
+	handle = tiler_alloc_block_area(TILFMT_8BIT, BENCH_TILER_WIDTH,
+					BENCH_TILER_HEIGHT, &ssptr, NULL);
+	if (IS_ERR_OR_NULL(handle))
+		return handle ? PTR_ERR(handle) : -ENOMEM;
+
+	ret = tiler_pin_block(handle, t->addrs, t->n_pages);
+	if (!ret)
+		tiler_unpin_block(handle);
+
+	tiler_free_block_area(handle);
+	return ret;
+}
+#endif
+
+/* zram compresses every swapped out page with LZO1X-1 */
+struct bench_lzo {
+	size_t clen;
+	void *wrkmem;
+	unsigned char src[PAGE_SIZE];
+	unsigned char dst[PAGE_SIZE];
+	unsigned char buf[lzo1x_worst_compress(PAGE_SIZE)];
+};
+
+static int bench_lzo_setup(struct bench *b)
+{
+	struct bench_lzo *z;
+	int i;
+
+	z = vmalloc(sizeof(*z));
+	if (!z)
+		return -ENOMEM;
+
+	z->wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	if (!z->wrkmem) {
+		vfree(z);
+		return -ENOMEM;
+	}
+
+	/* roughly the 2:1 ratio zram sees on anonymous memory */
+	for (i = 0; i < PAGE_SIZE; i++)
+		z->src[i] = (i & 64) ? i * 2654435761U >> 24 : i / 16;
+
+	b->priv = z;
+	return lzo1x_1_compress(z->src, PAGE_SIZE, z->buf, &z->clen,
+				z->wrkmem) == LZO_E_OK ? 0 : -EIO;
+}
+
+static void bench_lzo_teardown(struct bench *b)
+{
+	struct bench_lzo *z = b->priv;
+
+	vfree(z->wrkmem);
+	vfree(z);
+}
+
+static int bench_zram_compress(struct bench *b)
+{
+	struct bench_lzo *z = b->priv;
+	size_t clen;
+
+	return lzo1x_1_compress(z->src, PAGE_SIZE, z->buf, &clen,
+				z->wrkmem) == LZO_E_OK ? 0 : -EIO;
+}
+
+static int bench_zram_decompress(struct bench *b)
+{
+	struct bench_lzo *z = b->priv;
+	size_t len = PAGE_SIZE;
+
+	return lzo1x_decompress_safe(z->buf, z->clen, z->dst,
+				     &len) == LZO_E_OK ? 0 : -EIO;
+}
+
+#ifdef CONFIG_ASHMEM
+struct bench_ashmem {
+	struct file *filp;
+	unsigned long addr;
+};
+
+/* the ioctl on behalf of the writer, as if it called it itself */
+static long bench_ioctl(struct file *filp, unsigned int cmd, void *arg)
+{
+	mm_segment_t old_fs = get_fs();
+	long ret;
+
+	set_fs(KERNEL_DS);
+	ret = filp->f_op->unlocked_ioctl(filp, cmd, (unsigned long)arg);
+	set_fs(old_fs);
+
+	return ret;
+}
+
+static int bench_ashmem_setup(struct bench *b)
+{
+	struct bench_ashmem *a;
+	struct file *filp;
+	int ret;
+
+	filp = filp_open("/dev/ashmem", O_RDWR, 0);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	a = kzalloc(sizeof(*a), GFP_KERNEL);
+	if (!a) {
+		filp_close(filp, NULL);
+		return -ENOMEM;
+	}
+	a->filp = filp;
+	b->priv = a;
+
+	ret = filp->f_op->unlocked_ioctl(filp, ASHMEM_SET_SIZE, PAGE_SIZE);
+	if (ret)
+		return ret;
+
+	/* pinning is only allowed on mapped regions */
+	down_write(&current->mm->mmap_sem);
+	a->addr = do_mmap_pgoff(filp, 0, PAGE_SIZE, PROT_READ | PROT_WRITE,
+				MAP_SHARED, 0);
+	up_write(&current->mm->mmap_sem);
+	if (IS_ERR_VALUE(a->addr)) {
+		ret = a->addr;
+		a->addr = 0;
+		return ret;
+	}
+
+	return 0;
+}
+
+static void bench_ashmem_teardown(struct bench *b)
+{
+	struct bench_ashmem *a = b->priv;
+
+	if (!a)
+		return;
+
+	if (a->addr) {
+		down_write(&current->mm->mmap_sem);
+		do_munmap(current->mm, a->addr, PAGE_SIZE);
+		up_write(&current->mm->mmap_sem);
+	}
+	filp_close(a->filp, NULL);
+	kfree(a);
+}
+
+static int bench_ashmem_pin(struct bench *b)
+{
+	struct bench_ashmem *a = b->priv;
+	struct ashmem_pin pin = { .offset = 0, .len = PAGE_SIZE };
+	long ret;
+
+	ret = bench_ioctl(a->filp, ASHMEM_UNPIN, &pin);
+	if (ret < 0)
+		return ret;
+
+	ret = bench_ioctl(a->filp, ASHMEM_PIN, &pin);
+	return ret < 0 ? ret : 0;
+}
+#endif
+
+#if defined(CONFIG_MFD_CPCAP) || defined(CONFIG_MFD_CPCAP_MODULE)
+static int bench_cpcap_setup(struct bench *b)
+{
+	b->priv = cpcap_get_device();
+	return b->priv ? 0 : -ENODEV;
+}
+
+static int bench_cpcap_read(struct bench *b)
+{
+	unsigned short value;
+
+	return cpcap_regacc_read(b->priv, CPCAP_REG_INT2, &value);
+}
+
+/* an empty mask still does the locked read-modify-write over SPI */
+static int bench_cpcap_write(struct bench *b)
+{
+	return cpcap_regacc_write(b->priv, CPCAP_REG_INTM2, 0, 0);
+}
+#endif
+
+#ifdef CONFIG_OMAP_MBOX_FWK
+#define BENCH_MBOX_MSG		0xbe0c0000
+
+struct bench_mbox {
+	struct omap_mbox *mbox;
+	struct notifier_block nb;
+	struct completion done;
+};
+
+static int bench_mbox_notify(struct notifier_block *nb, unsigned long len,
+			     void *msg)
+{
+	struct bench_mbox *m = container_of(nb, struct bench_mbox, nb);
+
+	complete(&m->done);
+	return NOTIFY_OK;
+}
+
+static int bench_mbox_setup(struct bench *b)
+{
+	struct bench_mbox *m;
+
+	if (!*mbox)
+		return -ENODEV;
+
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	init_completion(&m->done);
+	m->nb.notifier_call = bench_mbox_notify;
+	m->mbox = omap_mbox_get(mbox, &m->nb);
+	if (IS_ERR(m->mbox)) {
+		int ret = PTR_ERR(m->mbox);
+
+		kfree(m);
+		return ret;
+	}
+
+	b->priv = m;
+	return 0;
+}
+
+static void bench_mbox_teardown(struct bench *b)
+{
+	struct bench_mbox *m = b->priv;
+
+	if (!m)
+		return;
+
+	omap_mbox_put(m->mbox, &m->nb);
+	kfree(m);
+}
+
+static int bench_mbox_rtt(struct bench *b)
+{
+	struct bench_mbox *m = b->priv;
+	int ret;
+
+	INIT_COMPLETION(m->done);
+	ret = omap_mbox_msg_send(m->mbox, BENCH_MBOX_MSG);
+	if (ret)
+		return ret;
+
+	return wait_for_completion_timeout(&m->done, HZ) ? 0 : -ETIMEDOUT;
+}
+#endif
+
+#if defined(CONFIG_ANDROID_LOGGER) || defined(CONFIG_ANDROID_LOGGER_MODULE)
+static const char bench_log_tag[] = "bench";
+static const char bench_log_msg[] =
+	"mapphone-bench: a log line of a typical length, 64 bytes or so";
+
+static int bench_logger_setup(struct bench *b)
+{
+	struct file *filp;
+
+	filp = filp_open(logger, O_WRONLY, 0);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	b->priv = filp;
+	return 0;
+}
+
+static void bench_logger_teardown(struct bench *b)
+{
+	filp_close(b->priv, NULL);
+}
+
+/* the three part writev liblog does for every line */
+static int bench_logger_write(struct bench *b)
+{
+	unsigned char prio = 4;		/* ANDROID_LOG_INFO */
+	struct iovec vec[3] = {
+		{ .iov_base = &prio, .iov_len = 1 },
+		{ .iov_base = (void *)bench_log_tag,
+		  .iov_len = sizeof(bench_log_tag) },
+		{ .iov_base = (void *)bench_log_msg,
+		  .iov_len = sizeof(bench_log_msg) },
+	};
+	mm_segment_t old_fs = get_fs();
+	loff_t pos = 0;
+	ssize_t ret;
+
+	set_fs(KERNEL_DS);
+	ret = vfs_writev(b->priv, (struct iovec __user *)vec, 3, &pos);
+	set_fs(old_fs);
+
+	return ret < 0 ? ret : 0;
+}
+#endif
+
+static struct bench benches[] = {
+#if defined(CONFIG_ION_OMAP) || defined(CONFIG_ION_OMAP_MODULE)
+	{
+		.name = "ion_system",
+		.bytes = BENCH_ION_SIZE,
+		.setup = bench_ion_setup,
+		.run = bench_ion_system,
+		.teardown = bench_ion_teardown,
+	},
+	{
+		.name = "ion_tiler",
+		.bytes = BENCH_TILER_WIDTH * BENCH_TILER_HEIGHT,
+		.setup = bench_ion_setup,
+		.run = bench_ion_tiler,
+		.teardown = bench_ion_teardown,
+	},
+#endif
+#if defined(CONFIG_TI_TILER) || defined(CONFIG_TI_TILER_MODULE)
+	{
+		.name = "tiler_pin",
+		.bytes = BENCH_TILER_WIDTH * BENCH_TILER_HEIGHT,
+		.setup = bench_tiler_setup,
+		.run = bench_tiler_pin,
+		.teardown = bench_tiler_teardown,
+	},
+#endif
+	{
+		.name = "zram_compress",
+		.bytes = PAGE_SIZE,
+		.setup = bench_lzo_setup,
+		.run = bench_zram_compress,
+		.teardown = bench_lzo_teardown,
+	},
+	{
+		.name = "zram_decompress",
+		.bytes = PAGE_SIZE,
+		.setup = bench_lzo_setup,
+		.run = bench_zram_decompress,
+		.teardown = bench_lzo_teardown,
+	},
+#ifdef CONFIG_ASHMEM
+	{
+		.name = "ashmem_pin",
+		.bytes = PAGE_SIZE,
+		.setup = bench_ashmem_setup,
+		.run = bench_ashmem_pin,
+		.teardown = bench_ashmem_teardown,
+	},
+#endif
+#if defined(CONFIG_MFD_CPCAP) || defined(CONFIG_MFD_CPCAP_MODULE)
+	{
+		.name = "cpcap_read",
+		.setup = bench_cpcap_setup,
+		.run = bench_cpcap_read,
+	},
+	{
+		.name = "cpcap_write",
+		.setup = bench_cpcap_setup,
+		.run = bench_cpcap_write,
+	},
+#endif
+#ifdef CONFIG_OMAP_MBOX_FWK
+	{
+		.name = "mbox_rtt",
+		.setup = bench_mbox_setup,
+		.run = bench_mbox_rtt,
+		.teardown = bench_mbox_teardown,
+	},
+#endif
+#if defined(CONFIG_ANDROID_LOGGER) || defined(CONFIG_ANDROID_LOGGER_MODULE)
+	{
+		.name = "logger_write",
+		.bytes = 1 + sizeof(bench_log_tag) + sizeof(bench_log_msg),
+		.setup = bench_logger_setup,
+		.run = bench_logger_write,
+		.teardown = bench_logger_teardown,
+	},
+#endif
+};
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_report(struct bench *b, u32 *ns, unsigned int n)
+{
+	u64 total = 0, ops, mbps;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		total += ns[i];
+	total = max_t(u64, total, 1);
+
+	sort(ns, n, sizeof(*ns), bench_cmp, NULL);
+
+	ops = div64_u64((u64)n * NSEC_PER_SEC, total);
+	mbps = div64_u64((u64)n * b->bytes * 1000, total);
+
+	snprintf(b->result, sizeof(b->result),
+		 "n %u min %u median %u p99 %u ns, %llu ops/s, %llu MB/s\n",
+		 n, ns[0], ns[n / 2], ns[min(n - 1, n * 99 / 100)],
+		 ops, mbps);
+}
+
+static int bench_run(struct bench *b, unsigned int n)
+{
+	unsigned int i;
+	ktime_t start;
+	s64 delta;
+	u32 *ns;
+	int ret;
+
+	ns = vmalloc(n * sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	b->priv = NULL;
+	ret = b->setup ? b->setup(b) : 0;
+
+	for (i = 0; !ret && i < n; i++) {
+		start = ktime_get();
+		ret = b->run(b);
+		delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+		ns[i] = min_t(s64, delta, UINT_MAX);
+
+		if (fatal_signal_pending(current))
+			ret = -EINTR;
+		cond_resched();
+	}
+
+	if (b->teardown && b->priv)
+		b->teardown(b);
+
+	if (ret)
+		snprintf(b->result, sizeof(b->result),
+			 "failed after %u iterations: %d\n", i, ret);
+	else
+		bench_report(b, ns, n);
+
+	vfree(ns);
+	return ret;
+}
+
+static ssize_t bench_read(struct file *file, char __user *ubuf,
+			  size_t count, loff_t *ppos)
+{
+	struct bench *b = file->private_data;
+	char result[BENCH_RESULT_SIZE];
+
+	mutex_lock(&bench_lock);
+	strlcpy(result, b->result[0] ? b->result : "not run\n",
+		sizeof(result));
+	mutex_unlock(&bench_lock);
+
+	return simple_read_from_buffer(ubuf, count, ppos, result,
+				       strlen(result));
+}
+
+static ssize_t bench_write(struct file *file, const char __user *ubuf,
+			   size_t count, loff_t *ppos)
+{
+	struct bench *b = file->private_data;
+	unsigned int n;
+	int ret;
+
+	ret = kstrtouint_from_user(ubuf, count, 0, &n);
+	if (ret)
+		return ret;
+	if (!n || n > BENCH_MAX_ITERATIONS)
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&bench_lock))
+		return -ERESTARTSYS;
+	ret = bench_run(b, n);
+	mutex_unlock(&bench_lock);
+
+	pr_info("mapphone-bench: %s: %s", b->name, b->result);
+
+	return ret ? ret : count;
+}
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations bench_fops = {
+	.owner = THIS_MODULE,
+	.open = bench_open,
+	.read = bench_read,
+	.write = bench_write,
+	.llseek = default_llseek,
+};
+
+static int __init mapphone_bench_init(void)
+{
+	int i;
+
+	bench_dir = debugfs_create_dir("mapphone-bench", NULL);
+	if (IS_ERR_OR_NULL(bench_dir))
+		return bench_dir ? PTR_ERR(bench_dir) : -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		if (!debugfs_create_file(benches[i].name, S_IRUSR | S_IWUSR,
+					 bench_dir, &benches[i],
+					 &bench_fops)) {
+			debugfs_remove_recursive(bench_dir);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void __exit mapphone_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_dir);
+}
+
+module_init(mapphone_bench_init);
+module_exit(mapphone_bench_exit);
+
+MODULE_DESCRIPTION("Microbenchmarks for mapphone kernel hot paths");
+MODULE_LICENSE("GPL");
@@ -571,9 +571,12 @@ static int __init omap4_duty_module_init(void)
 
 	/* Data initialization */
 	duty_wq = create_workqueue("omap4_duty_cycle");
-	INIT_DELAYED_WORK(&work_exit_cool, omap4_duty_exit_cool_wq);
-	INIT_DELAYED_WORK(&work_exit_heat, omap4_duty_exit_heating_wq);
-	INIT_DELAYED_WORK(&work_enter_heat, omap4_duty_enter_heat_wq);
+	/* an idle cpu neither heats nor needs the speed, no need to wake it */
+	INIT_DELAYED_WORK_DEFERRABLE(&work_exit_cool, omap4_duty_exit_cool_wq);
+	INIT_DELAYED_WORK_DEFERRABLE(&work_exit_heat,
+				     omap4_duty_exit_heating_wq);
+	INIT_DELAYED_WORK_DEFERRABLE(&work_enter_heat,
+				     omap4_duty_enter_heat_wq);
 	INIT_WORK(&work_enter_cool0, omap4_duty_enter_c0_wq);
 	INIT_WORK(&work_enter_cool1, omap4_duty_enter_c1_wq);
 	INIT_WORK(&work_cpu1_plugin, omap4_duty_enable_wq);
@@ -53,10 +53,23 @@
 
 extern void omap_thermal_throttle(void);
 extern void omap_thermal_unthrottle(void);
+extern void omap_thermal_step_up(void);
 
 static void throttle_delayed_work_fn(struct work_struct *work);
+static void predict_work_fn(struct work_struct *work);
 
 #define THROTTLE_DELAY_MS	1000
+#define PREDICT_SAMPLE_MS	1000
+#define PREDICT_HOLD_MS		3000	/* let one OPP step settle */
+
+/*
+ * How far ahead, in ms, to extrapolate the temperature trend. An OPP
+ * step is taken off when t_hot is predicted within this time, and given
+ * back one at a time once the trend says t_cold will hold. 0 leaves only
+ * the t_hot/t_cold alerts.
+ */
+static unsigned int predict_ms = 5000;
+module_param(predict_ms, uint, 0644);
 
 #define TSHUT_THRESHOLD_TSHUT_HOT	110000	/* 110 deg C */
 #define TSHUT_THRESHOLD_TSHUT_COLD	100000	/* 100 deg C */
@@ -77,6 +90,11 @@ static void throttle_delayed_work_fn(struct work_struct *work);
  * @is_efuse_valid - Flag to determine if eFuse is valid or not
  * @clk_on - Manages the current clock state
  * @clk_rate - Holds current clock rate
+ * @predict_work - Periodic sampling for the trend based throttling
+ * @last_temp - Temperature at the previous sample, milli degrees C
+ * @last_sample - jiffies at the previous sample, 0 if none
+ * @slope - Smoothed temperature slope in milli degrees C per second
+ * @last_step - jiffies at the last predictive OPP change
  */
 struct omap_temp_sensor {
 	struct platform_device *pdev;
@@ -91,6 +109,11 @@ struct omap_temp_sensor {
 	unsigned long clk_rate;
 	u32 current_temp;
 	struct delayed_work throttle_work;
+	struct delayed_work predict_work;
+	int last_temp;
+	unsigned long last_sample;
+	int slope;
+	unsigned long last_step;
 };
 
 #ifdef CONFIG_PM
@@ -209,6 +232,27 @@ static int omap_read_current_temp(struct omap_temp_sensor *temp_sensor)
 	return adc_to_temp_conversion(adc);
 }
 
+/**
+ * omap_temp_sensor_get_temp() - read the die temperature
+ * @temp:	set to the temperature in milli degrees C
+ *
+ * For in-kernel users that only need a rough reading.
+ */
+int omap_temp_sensor_get_temp(int *temp)
+{
+	int ret;
+
+	if (!temp_sensor_pm)
+		return -ENODEV;
+
+	ret = omap_read_current_temp(temp_sensor_pm);
+	if (ret == -EINVAL)
+		return ret;
+	*temp = ret;
+	return 0;
+}
+EXPORT_SYMBOL(omap_temp_sensor_get_temp);
+
 static void omap_configure_temp_sensor_thresholds(struct omap_temp_sensor
 						  *temp_sensor)
 {
@@ -402,6 +446,68 @@ static void throttle_delayed_work_fn(struct work_struct *work)
 	}
 }
 
+/*
+ * Sample the die temperature, track its slope and act on where it is
+ * heading rather than where it is: lowering the max OPP one step at a
+ * time before t_hot is reached avoids the large frequency drops, and
+ * the oscillation, of throttling only after the alert.
+ */
+static void predict_work_fn(struct work_struct *work)
+{
+	struct omap_temp_sensor *temp_sensor =
+				container_of(work, struct omap_temp_sensor,
+					     predict_work.work);
+	unsigned long now = jiffies;
+	unsigned int dt;
+	int curr, predicted;
+
+	if (!predict_ms)
+		goto out;
+
+	curr = omap_read_current_temp(temp_sensor);
+	if (curr < 0)
+		goto out;
+
+	dt = jiffies_to_msecs(now - temp_sensor->last_sample);
+	if (temp_sensor->last_sample && dt)
+		temp_sensor->slope = (3 * temp_sensor->slope +
+			(curr - temp_sensor->last_temp) * 1000 / (int)dt) / 4;
+	else
+		temp_sensor->slope = 0;
+	temp_sensor->last_temp = curr;
+	temp_sensor->last_sample = now;
+
+	if (time_before(now, temp_sensor->last_step +
+			msecs_to_jiffies(PREDICT_HOLD_MS)))
+		goto out;
+
+	predicted = curr + temp_sensor->slope * (int)predict_ms / 1000;
+
+	if (temp_sensor->slope > 0 && predicted >= BGAP_THRESHOLD_T_HOT) {
+		pr_info("%s: %d mC rising %d mC/s, throttling ahead of t_hot\n",
+			__func__, curr, temp_sensor->slope);
+		omap_thermal_throttle();
+		temp_sensor->last_step = now;
+	} else if (temp_sensor->slope <= 0 &&
+		   predicted < BGAP_THRESHOLD_T_COLD) {
+		omap_thermal_step_up();
+		temp_sensor->last_step = now;
+	}
+
+out:
+	schedule_delayed_work(&temp_sensor->predict_work,
+			      msecs_to_jiffies(PREDICT_SAMPLE_MS));
+}
+
+static void omap_temp_sensor_start_predict(struct omap_temp_sensor
+					   *temp_sensor)
+{
+	temp_sensor->last_sample = 0;
+	temp_sensor->last_step = jiffies - msecs_to_jiffies(PREDICT_HOLD_MS);
+	schedule_delayed_work(&temp_sensor->predict_work,
+			      msecs_to_jiffies(PREDICT_SAMPLE_MS));
+}
+
 static irqreturn_t omap_tshut_irq_handler(int irq, void *data)
 {
 	struct omap_temp_sensor *temp_sensor = (struct omap_temp_sensor *)data;
@@ -438,7 +544,9 @@ static irqreturn_t omap_talert_irq_handler(int irq, void *data)
 		temp_offset |= OMAP4_MASK_COLD_MASK;
 	} else if (t_cold) {
 		cancel_delayed_work_sync(&temp_sensor->throttle_work);
-		omap_thermal_unthrottle();
+		/* with prediction on, the OPPs are given back gradually */
+		if (!predict_ms)
+			omap_thermal_unthrottle();
 		temp_offset &= ~(OMAP4_MASK_COLD_MASK);
 		temp_offset |= OMAP4_MASK_HOT_MASK;
 	}
@@ -522,8 +630,10 @@ static int __devinit omap_temp_sensor_probe(struct platform_device *pdev)
 	}
 
 	/* Init delayed work for throttle decision */
-	INIT_DELAYED_WORK(&temp_sensor->throttle_work,
-			  throttle_delayed_work_fn);
+	INIT_DELAYED_WORK_DEFERRABLE(&temp_sensor->throttle_work,
+				     throttle_delayed_work_fn);
+	INIT_DELAYED_WORK_DEFERRABLE(&temp_sensor->predict_work,
+				     predict_work_fn);
 
 	platform_set_drvdata(pdev, temp_sensor);
 
@@ -580,6 +690,7 @@ static int __devinit omap_temp_sensor_probe(struct platform_device *pdev)
 	dev_info(dev, "%s probed", pdata->name);
 
 	temp_sensor_pm = temp_sensor;
+	omap_temp_sensor_start_predict(temp_sensor);
 
 	return 0;
 
@@ -610,6 +721,7 @@ static int __devexit omap_temp_sensor_remove(struct platform_device *pdev)
 
 	sysfs_remove_group(&pdev->dev.kobj, &omap_temp_sensor_group);
 	cancel_delayed_work_sync(&temp_sensor->throttle_work);
+	cancel_delayed_work_sync(&temp_sensor->predict_work);
 	omap_temp_sensor_disable(temp_sensor);
 	clk_put(temp_sensor->clock);
 	platform_set_drvdata(pdev, NULL);
@@ -661,6 +773,7 @@ static int omap_temp_sensor_suspend(struct platform_device *pdev,
 {
 	struct omap_temp_sensor *temp_sensor = platform_get_drvdata(pdev);
 
+	cancel_delayed_work_sync(&temp_sensor->predict_work);
 	omap_temp_sensor_disable(temp_sensor);
 
 	return 0;
@@ -671,6 +784,7 @@ static int omap_temp_sensor_resume(struct platform_device *pdev)
 	struct omap_temp_sensor *temp_sensor = platform_get_drvdata(pdev);
 
 	omap_temp_sensor_enable(temp_sensor);
+	omap_temp_sensor_start_predict(temp_sensor);
 
 	return 0;
 }
@@ -30,6 +30,8 @@
 
 #define PMEM_MAX_DEVICES 10
 #define PMEM_MAX_ORDER 128
+/* orders that can occur: a region has less than 1 << BITS_PER_LONG pages */
+#define PMEM_NR_ORDERS BITS_PER_LONG
 #define PMEM_MIN_ALLOC PAGE_SIZE
 
 #define PMEM_DEBUG 1
@@ -83,6 +85,10 @@ struct pmem_data {
 struct pmem_bits {
 	unsigned allocated:1;		/* 1 if allocated, 0 if free */
 	unsigned order:7;		/* size of the region in pmem space */
+	/* links in the free list of its order, by index, -1 terminated.
+	 * only valid for the first entry of a free region */
+	int prev;
+	int next;
 };
 
 struct pmem_region_node {
@@ -117,6 +123,9 @@ struct pmem_info {
 	/* the bitmap for the region indicating which entries are allocated
 	 * and which are free */
 	struct pmem_bits *bitmap;
+	/* index of the first free region of each order, -1 if none, so that
+	 * allocating and freeing do not have to scan the bitmap */
+	int free_list[PMEM_NR_ORDERS];
 	/* indicates the region should not be managed with an allocator */
 	unsigned no_allocator;
 	/* indicates maps of this region should be cached, if a mix of
@@ -132,7 +141,7 @@ struct pmem_info {
 	 * needed */
 	struct mutex data_list_lock;
 	struct list_head data_list;
-	/* pmem_sem protects the bitmap array
+	/* pmem_sem protects the bitmap array and the free lists
 	 * a write lock should be held when modifying entries in bitmap
 	 * a read lock should be held when reading data from bits or
 	 * dereferencing a pointer into bitmap
@@ -233,6 +242,31 @@ static int is_master_owner(struct file *file)
 	return ret;
 }
 
+static void pmem_free_list_add(int id, int index)
+{
+	int order = PMEM_ORDER(id, index);
+	int head = pmem[id].free_list[order];
+
+	pmem[id].bitmap[index].prev = -1;
+	pmem[id].bitmap[index].next = head;
+	if (head >= 0)
+		pmem[id].bitmap[head].prev = index;
+	pmem[id].free_list[order] = index;
+}
+
+static void pmem_free_list_del(int id, int index)
+{
+	int prev = pmem[id].bitmap[index].prev;
+	int next = pmem[id].bitmap[index].next;
+
+	if (prev >= 0)
+		pmem[id].bitmap[prev].next = next;
+	else
+		pmem[id].free_list[PMEM_ORDER(id, index)] = next;
+	if (next >= 0)
+		pmem[id].bitmap[next].prev = prev;
+}
+
 static int pmem_free(int id, int index)
 {
 	/* caller should hold the write lock on pmem_sem! */
@@ -251,8 +285,11 @@ static int pmem_free(int id, int index)
 	 */
 	do {
 		buddy = PMEM_BUDDY_INDEX(id, curr);
+		if (buddy >= pmem[id].num_entries)
+			break;
 		if (PMEM_IS_FREE(id, buddy) &&
 				PMEM_ORDER(id, buddy) == PMEM_ORDER(id, curr)) {
+			pmem_free_list_del(id, buddy);
 			PMEM_ORDER(id, buddy)++;
 			PMEM_ORDER(id, curr)++;
 			curr = min(buddy, curr);
@@ -260,6 +297,7 @@ static int pmem_free(int id, int index)
 			break;
 		}
 	} while (curr < pmem[id].num_entries);
+	pmem_free_list_add(id, curr);
 
 	return 0;
 }
@@ -381,10 +419,9 @@ static int pmem_allocate(int id, unsigned long len)
 {
 	/* caller should hold the write lock on pmem_sem! */
 	/* return the corresponding pdata[] entry */
-	int curr = 0;
-	int end = pmem[id].num_entries;
 	int best_fit = -1;
 	unsigned long order = pmem_order(len);
+	unsigned long curr;
 
 	if (pmem[id].no_allocator) {
 		DLOG("no allocator");
@@ -394,27 +431,19 @@ static int pmem_allocate(int id, unsigned long len)
 		return len;
 	}
 
-	if (order > PMEM_MAX_ORDER)
+	if (order > PMEM_MAX_ORDER || order >= PMEM_NR_ORDERS)
 		return -1;
 	DLOG("order %lx\n", order);
 
-	/* look through the bitmap:
-	 * 	if you find a free slot of the correct order use it
+	/* look through the free lists:
+	 * 	if there is a free slot of the correct order use it
 	 * 	otherwise, use the best fit (smallest with size > order) slot
 	 */
-	while (curr < end) {
-		if (PMEM_IS_FREE(id, curr)) {
-			if (PMEM_ORDER(id, curr) == (unsigned char)order) {
-				/* set the not free bit and clear others */
-				best_fit = curr;
-				break;
-			}
-			if (PMEM_ORDER(id, curr) > (unsigned char)order &&
-			    (best_fit < 0 ||
-			     PMEM_ORDER(id, curr) < PMEM_ORDER(id, best_fit)))
-				best_fit = curr;
+	for (curr = order; curr < PMEM_NR_ORDERS; curr++) {
+		if (pmem[id].free_list[curr] >= 0) {
+			best_fit = pmem[id].free_list[curr];
+			break;
 		}
-		curr = PMEM_NEXT_INDEX(id, curr);
 	}
 
 	/* if best_fit < 0, there are no suitable slots,
@@ -429,11 +458,13 @@ static int pmem_allocate(int id, unsigned long len)
 	 * 	split the slot into 2 buddies of order - 1
 	 * 	repeat until the slot is of the correct order
 	 */
+	pmem_free_list_del(id, best_fit);
 	while (PMEM_ORDER(id, best_fit) > (unsigned char)order) {
 		int buddy;
 		PMEM_ORDER(id, best_fit) -= 1;
 		buddy = PMEM_BUDDY_INDEX(id, best_fit);
 		PMEM_ORDER(id, buddy) = PMEM_ORDER(id, best_fit);
+		pmem_free_list_add(id, buddy);
 	}
 	pmem[id].bitmap[best_fit].allocated = 1;
 	return best_fit;
@@ -1218,6 +1249,65 @@ static struct file_operations debug_fops = {
 };
 #endif
 
+static int pmem_free_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+/*
+ * Free space of an allocator managed region: the free blocks per order,
+ * the total and the largest one, and how fragmented the free space is,
+ * i.e. which share of it cannot be handed out as a single allocation.
+ */
+static ssize_t pmem_free_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	int id = (int)file->private_data;
+	const int bufmax = 1024;
+	unsigned long nr_free, free = 0, largest = 0;
+	char *buffer;
+	int n = 0, order, index;
+	ssize_t ret;
+
+	buffer = kmalloc(bufmax, GFP_KERNEL);
+	if (!buffer)
+		return -ENOMEM;
+
+	n = scnprintf(buffer, bufmax, "order free blocks\n");
+	down_read(&pmem[id].bitmap_sem);
+	for (order = 0; order < PMEM_NR_ORDERS; order++) {
+		nr_free = 0;
+		for (index = pmem[id].free_list[order]; index >= 0;
+		     index = pmem[id].bitmap[index].next)
+			nr_free++;
+		if (!nr_free)
+			continue;
+		n += scnprintf(buffer + n, bufmax - n, "%5d %lu\n", order,
+			       nr_free);
+		free += nr_free << order;
+		largest = 1UL << order;
+	}
+	up_read(&pmem[id].bitmap_sem);
+
+	n += scnprintf(buffer + n, bufmax - n,
+		       "free: %lu kB of %lu kB\nlargest free block: %lu kB\n"
+		       "fragmentation: %lu%%\n",
+		       free * (PMEM_MIN_ALLOC >> 10),
+		       pmem[id].size >> 10, largest * (PMEM_MIN_ALLOC >> 10),
+		       free ? 100 - largest * 100 / free : 0);
+
+	ret = simple_read_from_buffer(buf, count, ppos, buffer, n);
+	kfree(buffer);
+	return ret;
+}
+
+static const struct file_operations pmem_free_fops = {
+	.read = pmem_free_read,
+	.open = pmem_free_open,
+	.llseek = default_llseek,
+};
+
 #if 0
 static struct miscdevice pmem_dev = {
 	.name = "pmem",
@@ -1264,9 +1354,13 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	memset(pmem[id].bitmap, 0, sizeof(struct pmem_bits) *
 					  pmem[id].num_entries);
 
+	for (i = 0; i < PMEM_NR_ORDERS; i++)
+		pmem[id].free_list[i] = -1;
+
 	for (i = sizeof(pmem[id].num_entries) * 8 - 1; i >= 0; i--) {
 		if ((pmem[id].num_entries) &  1<<i) {
 			PMEM_ORDER(id, index) = i;
+			pmem_free_list_add(id, index);
 			index = PMEM_NEXT_INDEX(id, index);
 		}
 	}
@@ -1293,6 +1387,13 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	debugfs_create_file(pdata->name, S_IFREG | S_IRUGO, NULL, (void *)id,
 			    &debug_fops);
 #endif
+	if (!pmem[id].no_allocator) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "%s_free", pdata->name);
+		debugfs_create_file(name, S_IFREG | S_IRUGO, NULL, (void *)id,
+				    &pmem_free_fops);
+	}
 	return 0;
 error_cant_remap:
 	kfree(pmem[id].bitmap);
@@ -76,7 +76,6 @@ static const char *bp_power_state[2] = {
 /* structure to keep track of gpio, irq, and irq enabled info */
 struct gpio_info {
 	int irq;
-	struct work_struct work;
 };
 
 struct mdm_ctrl_info {
@@ -89,8 +88,6 @@ static struct mdm_ctrl_info mdm_ctrl;
 static DEFINE_MUTEX(mdm_ctrl_info_lock);
 static DEFINE_MUTEX(mdm_power_lock);
 
-struct workqueue_struct *mdm6600_wq;
-
 static struct radio_dev radio_cdev;
 
 static unsigned int bp_status_idx = BP_STATUS_UNDEFINED;
@@ -382,19 +379,13 @@ static void mdm_ctrl_set_bootmode(int mode)
 	mutex_unlock(&mdm_ctrl_info_lock);
 }
 
-static void irq_worker(struct work_struct *work)
+/*
+ * Status changes are read from the irq thread rather than a workqueue,
+ * so a BP waking us is seen ahead of whatever else resume queued.
+ */
+static irqreturn_t irq_thread_fn(int irq, void *data)
 {
-	struct gpio_info *gpio = container_of(work, struct gpio_info, work);
 	update_bp_status();
-	enable_irq(gpio->irq);
-}
-
-static irqreturn_t irq_handler(int irq, void *data)
-{
-	struct gpio_info *gpio = (struct gpio_info *) data;
-
-	disable_irq_nosync(irq);
-	queue_work(mdm6600_wq, &gpio->work);
 
 	return IRQ_HANDLED;
 }
@@ -413,9 +404,9 @@ static int mdm_gpio_setup_internal(struct mdm6600_ctrl_platform_data *pdata)
 	for (i = 0; i < MDM6600_CTRL_NUM_GPIOS; i++) {
 		gpio_data = &mdm_ctrl.gpios[i];
 		if (pdata->gpios[i].direction == MDM6600_GPIO_DIRECTION_IN) {
-			INIT_WORK(&gpio_data->work, irq_worker);
 			gpio_data->irq = gpio_to_irq(pdata->gpios[i].number);
-			rv = request_irq(gpio_data->irq, irq_handler,
+			rv = request_threaded_irq(gpio_data->irq, NULL,
+				irq_thread_fn, IRQF_ONESHOT |
 				IRQ_TYPE_EDGE_FALLING | IRQ_TYPE_EDGE_RISING,
 					pdata->gpios[i].name, gpio_data);
 			if (rv < 0) {
@@ -474,12 +465,6 @@ static int __devinit mdm6600_ctrl_probe(struct platform_device *pdev)
 		}
 	}
 
-	mdm6600_wq = create_singlethread_workqueue("mdm6600_ctrl_wq");
-	if (!mdm6600_wq) {
-		dev_err(&pdev->dev, "Cannot create work queue.\n");
-		goto probe_cleanup;
-	}
-
 	if (mdm_gpio_setup_internal(pdata) < 0) {
 		dev_err(&pdev->dev, "Failed to setup bp  status irq\n");
 		goto err_setup;
@@ -498,7 +483,6 @@ static int __devinit mdm6600_ctrl_probe(struct platform_device *pdev)
 
 err_setup:
 	mdm_gpio_cleanup_internal();
-	destroy_workqueue(mdm6600_wq);
 
 probe_cleanup:
 	for (i = 0; i < MDM6600_CTRL_NUM_GPIOS; i++)
@@ -518,9 +502,6 @@ static int __devexit mdm_ctrl_remove(struct platform_device *pdev)
 
 	mdm_gpio_cleanup_internal();
 
-	if (mdm6600_wq)
-		destroy_workqueue(mdm6600_wq);
-
 	for (i = 0; i < MDM6600_CTRL_NUM_GPIOS; i++)
 		mdm_gpio_free(&pdata->gpios[i]);
 
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA
+ */
+
+/*
+ * Sensor hub: one place where the sensor drivers put their samples.
+ *
+ * Polled sensors register a sample() callback and are read on a common
+ * tick: whenever the tick runs, every sensor due within slack_ms is read
+ * as well, so sensors with related rates share wakeups and are sampled
+ * at the same moment.  Interrupt driven sensors push samples stamped at
+ * irq time.  Everything lands, stamped with CLOCK_MONOTONIC, in a single
+ * ring read through /dev/sensor_hub; readers are woken once per batch
+ * events rather than once per sample.
+ */
+
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/miscdevice.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+
+#include <linux/sensor_hub.h>
+
+#define SENSOR_HUB_RING_SIZE	256	/* must be a power of 2 */
+
+static unsigned int slack_ms = 5;
+module_param(slack_ms, uint, 0644);
+MODULE_PARM_DESC(slack_ms, "Read polled sensors due within this many ms");
+
+static unsigned int batch = 1;
+module_param(batch, uint, 0644);
+MODULE_PARM_DESC(batch, "Events to collect before waking a reader");
+
+static LIST_HEAD(producers);
+static DEFINE_MUTEX(producers_lock);
+static struct workqueue_struct *tick_wq;
+static struct delayed_work tick_work;
+
+static struct sensor_hub_event ring[SENSOR_HUB_RING_SIZE];
+static unsigned int ring_head;
+static unsigned int ring_tail;
+static unsigned int ring_dropped;
+static DEFINE_SPINLOCK(ring_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ring_wait);
+module_param_named(dropped, ring_dropped, uint, 0444);
+MODULE_PARM_DESC(dropped, "Events lost to ring overflow");
+
+static unsigned int ring_count(void)
+{
+	return (ring_head - ring_tail) & (SENSOR_HUB_RING_SIZE - 1);
+}
+
+static bool ring_ready(void)
+{
+	return ring_count() >= clamp(batch, 1U, SENSOR_HUB_RING_SIZE - 1U);
+}
+
+static void ring_add(struct sensor_hub_producer *p, ktime_t stamp,
+		     const s32 *values, int count)
+{
+	struct sensor_hub_event *ev;
+	unsigned long flags;
+	bool wake;
+
+	if (count > SENSOR_HUB_MAX_VALUES)
+		count = SENSOR_HUB_MAX_VALUES;
+
+	spin_lock_irqsave(&ring_lock, flags);
+
+	/* keep the newest samples */
+	if (ring_count() == SENSOR_HUB_RING_SIZE - 1) {
+		ring_tail = (ring_tail + 1) & (SENSOR_HUB_RING_SIZE - 1);
+		ring_dropped++;
+	}
+
+	ev = &ring[ring_head];
+	ev->type = p->type;
+	ev->count = count;
+	ev->timestamp = ktime_to_ns(stamp);
+	memset(ev->values, 0, sizeof(ev->values));
+	memcpy(ev->values, values, count * sizeof(*values));
+	ring_head = (ring_head + 1) & (SENSOR_HUB_RING_SIZE - 1);
+
+	wake = ring_ready();
+
+	spin_unlock_irqrestore(&ring_lock, flags);
+
+	if (wake)
+		wake_up_interruptible(&ring_wait);
+}
+
+/**
+ * sensor_hub_push - queue a sample of an interrupt driven sensor
+ * @p: the producer
+ * @stamp: ktime_get() at the interrupt, or when the sample was taken
+ * @values: sample values
+ * @count: number of values, up to SENSOR_HUB_MAX_VALUES
+ *
+ * Can be called from any context.
+ */
+void sensor_hub_push(struct sensor_hub_producer *p, ktime_t stamp,
+		     const s32 *values, int count)
+{
+	ring_add(p, stamp, values, count);
+}
+EXPORT_SYMBOL_GPL(sensor_hub_push);
+
+static void sensor_hub_tick(struct work_struct *work)
+{
+	struct sensor_hub_producer *p;
+	unsigned long now = jiffies;
+	unsigned long window = now + msecs_to_jiffies(slack_ms);
+	unsigned long next = 0;
+	bool armed = false;
+	s32 values[SENSOR_HUB_MAX_VALUES];
+	int count;
+
+	mutex_lock(&producers_lock);
+
+	list_for_each_entry(p, &producers, node) {
+		if (!p->sample || !p->interval_ms)
+			continue;
+
+		if (time_before_eq(p->next, window)) {
+			unsigned long interval = msecs_to_jiffies(p->interval_ms);
+
+			count = p->sample(p, values);
+			if (count > 0)
+				ring_add(p, ktime_get(), values, count);
+
+			p->next += interval;
+			if (time_before_eq(p->next, now))
+				p->next = now + interval;
+		}
+
+		if (!armed || time_before(p->next, next)) {
+			next = p->next;
+			armed = true;
+		}
+	}
+
+	if (armed)
+		queue_delayed_work(tick_wq, &tick_work,
+				   time_after(next, now) ? next - now : 0);
+
+	mutex_unlock(&producers_lock);
+}
+
+/**
+ * sensor_hub_set_interval - start, stop or re-rate a polled sensor
+ * @p: the producer
+ * @interval_ms: sampling interval, 0 to stop
+ */
+void sensor_hub_set_interval(struct sensor_hub_producer *p,
+			     unsigned int interval_ms)
+{
+	mutex_lock(&producers_lock);
+	p->interval_ms = interval_ms;
+	p->next = jiffies + msecs_to_jiffies(interval_ms);
+	mutex_unlock(&producers_lock);
+
+	/*
+	 * Run the tick now so it picks up the new rate.  No _sync here, a
+	 * sample() running meanwhile may well need a lock our caller holds.
+	 */
+	if (interval_ms && p->sample) {
+		cancel_delayed_work(&tick_work);
+		queue_delayed_work(tick_wq, &tick_work, 0);
+	}
+}
+EXPORT_SYMBOL_GPL(sensor_hub_set_interval);
+
+int sensor_hub_register(struct sensor_hub_producer *p)
+{
+	if (!tick_wq)
+		return -ENODEV;
+
+	p->interval_ms = 0;
+
+	mutex_lock(&producers_lock);
+	list_add_tail(&p->node, &producers);
+	mutex_unlock(&producers_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sensor_hub_register);
+
+void sensor_hub_unregister(struct sensor_hub_producer *p)
+{
+	mutex_lock(&producers_lock);
+	list_del(&p->node);
+	mutex_unlock(&producers_lock);
+}
+EXPORT_SYMBOL_GPL(sensor_hub_unregister);
+
+static ssize_t sensor_hub_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct sensor_hub_event ev;
+	size_t done = 0;
+	unsigned long flags;
+	int err;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	if (!(file->f_flags & O_NONBLOCK)) {
+		err = wait_event_interruptible(ring_wait, ring_ready());
+		if (err)
+			return err;
+	}
+
+	while (done + sizeof(ev) <= count) {
+		spin_lock_irqsave(&ring_lock, flags);
+		if (!ring_count()) {
+			spin_unlock_irqrestore(&ring_lock, flags);
+			break;
+		}
+		ev = ring[ring_tail];
+		ring_tail = (ring_tail + 1) & (SENSOR_HUB_RING_SIZE - 1);
+		spin_unlock_irqrestore(&ring_lock, flags);
+
+		if (copy_to_user(buf + done, &ev, sizeof(ev)))
+			return done ? done : -EFAULT;
+		done += sizeof(ev);
+	}
+
+	return done ? done : -EAGAIN;
+}
+
+static unsigned int sensor_hub_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &ring_wait, wait);
+
+	return ring_ready() ? (POLLIN | POLLRDNORM) : 0;
+}
+
+static const struct file_operations sensor_hub_fops = {
+	.owner = THIS_MODULE,
+	.open = nonseekable_open,
+	.read = sensor_hub_read,
+	.poll = sensor_hub_poll,
+};
+
+static struct miscdevice sensor_hub_device = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = SENSOR_HUB_NAME,
+	.fops = &sensor_hub_fops,
+};
+
+static int __init sensor_hub_init(void)
+{
+	int err;
+
+	INIT_DELAYED_WORK(&tick_work, sensor_hub_tick);
+	tick_wq = create_singlethread_workqueue("sensor_hub");
+	if (!tick_wq)
+		return -ENOMEM;
+
+	err = misc_register(&sensor_hub_device);
+	if (err < 0) {
+		pr_err("%s: misc_register failed: %d\n", __func__, err);
+		destroy_workqueue(tick_wq);
+		tick_wq = NULL;
+	}
+
+	return err;
+}
+/* before the sensor drivers register */
+subsys_initcall(sensor_hub_init);
+
+MODULE_DESCRIPTION("Sensor sample hub");
+MODULE_AUTHOR("Motorola Mobility");
+MODULE_LICENSE("GPL");
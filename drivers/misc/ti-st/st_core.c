@@ -29,6 +29,10 @@
 #include <linux/skbuff.h>
 
 #include <linux/ti_wilink_st.h>
+#include <asm/unaligned.h>
+
+/* largest burst of queued frames handed to the UART in one write */
+#define ST_TX_BATCH_SIZE	1024
 
 /* function pointer pointing to either,
  * st_kim_recv during registration to receive fw download responses
@@ -232,6 +236,62 @@ static inline void st_wakeup_ack(struct st_data_s *st_gdata,
  *	HCI-Events, ACL, SCO, 4 types of HCI-LL PM packets
  *	CH-8 packets from FM, CH-9 packets from GPS cores.
  */
+/*
+ * st_int_recv_frame - fast path for a frame whose header is complete in
+ *	the received chunk: allocate the skb to the size of the frame and
+ *	copy the header and the payload, or as much of it as is there,
+ *	in one go.
+ * Returns the number of bytes consumed, or -1 to leave the frame to the
+ * byte-wise state machine.
+ */
+static int st_int_recv_frame(struct st_data_s *st_gdata, unsigned char type,
+	const unsigned char *ptr, long count)
+{
+	struct st_proto_s *proto = st_gdata->list[type];
+	const unsigned char *plen = ptr + proto->offset_len_in_hdr;
+	unsigned short payload_len;
+	struct sk_buff *skb;
+	int frame_len, len;
+
+	if (proto->len_size == 1)
+		payload_len = *plen;
+	else if (proto->len_size == 2)
+		payload_len = get_unaligned_le16(plen);
+	else
+		return -1;
+
+	frame_len = proto->hdr_len + payload_len;
+	/* oversized frames are reported by st_check_data_len() */
+	if (proto->reserve + frame_len > proto->max_frame_size)
+		return -1;
+
+	skb = alloc_skb(proto->reserve + frame_len, GFP_ATOMIC);
+	if (!skb)
+		return -1;
+
+	skb_reserve(skb, proto->reserve);
+	/* next 2 required for BT only */
+	skb->cb[0] = type; /*pkt_type*/
+	skb->cb[1] = 0; /*incoming*/
+
+	len = min_t(long, frame_len, count);
+	memcpy(skb_put(skb, len), ptr, len);
+
+	st_gdata->rx_skb = skb;
+	st_gdata->rx_chnl = type;
+	if (len == frame_len) {
+		st_send_frame(type, st_gdata);
+		st_gdata->rx_state = ST_W4_PACKET_TYPE;
+		st_gdata->rx_skb = NULL;
+		st_gdata->rx_count = 0;
+	} else {
+		st_gdata->rx_state = ST_W4_DATA;
+		st_gdata->rx_count = frame_len - len;
+	}
+
+	return len;
+}
+
 void st_int_recv(void *disc_data,
 	const unsigned char *data, long count)
 {
@@ -359,6 +419,17 @@ void st_int_recv(void *disc_data,
 						"with 0x%02x", type);
 				goto done;
 			}
+
+			if (count > st_gdata->list[type]->hdr_len) {
+				len = st_int_recv_frame(st_gdata, type,
+							ptr + 1, count - 1);
+				if (len >= 0) {
+					ptr += 1 + len;
+					count -= 1 + len;
+					continue;
+				}
+			}
+
 			st_gdata->rx_skb = alloc_skb(
 					st_gdata->list[type]->max_frame_size,
 					GFP_ATOMIC);
@@ -454,6 +525,39 @@ void st_int_enqueue(struct st_data_s *st_gdata, struct sk_buff *skb)
  * - TTY layer when write's finished
  * - st_write (in context of the protocol stack)
  */
+/*
+ * st_tx_batch - gather the frames queued behind @skb into one buffer, so
+ *	that a single UART write carries them and the UART is started once.
+ *	Called with st_data->lock held, by the only sender.
+ */
+static struct sk_buff *st_tx_batch(struct st_data_s *st_data,
+	struct sk_buff *skb)
+{
+	struct sk_buff *batch, *next;
+
+	if (skb->len >= ST_TX_BATCH_SIZE || skb_queue_empty(&st_data->txq))
+		return skb;
+
+	batch = alloc_skb(ST_TX_BATCH_SIZE, GFP_ATOMIC);
+	if (!batch)
+		return skb;
+
+	memcpy(skb_put(batch, skb->len), skb->data, skb->len);
+	kfree_skb(skb);
+
+	while ((next = skb_dequeue(&st_data->txq))) {
+		if (next->len > skb_tailroom(batch)) {
+			/* first in line for the next write */
+			skb_queue_head(&st_data->txq, next);
+			break;
+		}
+		memcpy(skb_put(batch, next->len), next->data, next->len);
+		kfree_skb(next);
+	}
+
+	return batch;
+}
+
 void st_tx_wakeup(struct st_data_s *st_data)
 {
 	struct sk_buff *skb;
@@ -477,6 +581,7 @@ void st_tx_wakeup(struct st_data_s *st_data)
 			spin_lock_irqsave(&st_data->lock, flags);
 			/* enable wake-up from TTY */
 			set_bit(TTY_DO_WRITE_WAKEUP, &st_data->tty->flags);
+			skb = st_tx_batch(st_data, skb);
 			len = st_int_write(st_data, skb->data, skb->len);
 			skb_pull(skb, len);
 			/* if skb->len = len as expected, skb->len=0 */
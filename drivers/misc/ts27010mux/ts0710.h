@@ -261,6 +261,8 @@ struct dlci_struct {
 struct chan_struct {
 	struct mutex	write_lock;
 	u8		*buf;
+	int		tx_len;		/* of the frame waiting for the link */
+	int		credit;		/* bytes it may send in this round */
 };
 
 
@@ -270,4 +272,11 @@ struct ts0710_con {
 
 	struct dlci_struct	dlci[TS0710_MAX_CHN];
 	struct chan_struct	chan[NR_MUXS];
+
+	/* which line sends the next UIH frame, see ts27010_tx_pick */
+	spinlock_t		tx_lock;
+	wait_queue_head_t	tx_wait;
+	unsigned long		tx_waiting;	/* lines, as bits */
+	int			tx_owner;	/* -1 when the link is free */
+	int			tx_last;
 };
@@ -5,6 +5,7 @@
 #include <linux/string.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/sched.h>
 
 #include "ts27010_mux.h"
 #include "ts27010_ringbuf.h"
@@ -15,8 +16,12 @@ struct ts27010_ldisc_data {
 	spinlock_t			recv_lock;
 
 	struct mutex			send_lock;
+	wait_queue_head_t		send_wait;
 };
 
+/* how long a frame waits for room in the uart before overflowing it */
+#define TS27010_SEND_TIMEOUT	(HZ / 2)
+
 static void ts27010_ldisc_recv_worker(struct work_struct *work)
 {
 	struct ts27010_ldisc_data *ts =
@@ -32,6 +37,14 @@ int ts27010_ldisc_send(struct tty_struct *tty, u8 *data, int len)
 	struct ts27010_ldisc_data *ts = tty->disc_data;
 
 	mutex_lock(&ts->send_lock);
+	if (tty->driver->ops->write_room(tty) < len) {
+		/* the scheduling of the lines only works with backpressure */
+		set_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+		wait_event_timeout(ts->send_wait,
+			tty->driver->ops->write_room(tty) >= len,
+			TS27010_SEND_TIMEOUT);
+		clear_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+	}
 	if (tty->driver->ops->write_room(tty) < len)
 		pr_err("\n******** write overflow ********\n\n");
 	len = tty->driver->ops->write(tty, data, len);
@@ -62,6 +75,7 @@ static int ts27010_ldisc_open(struct tty_struct *tty)
 	INIT_WORK(&ts->recv_work, ts27010_ldisc_recv_worker);
 
 	mutex_init(&ts->send_lock);
+	init_waitqueue_head(&ts->send_wait);
 	spin_lock_init(&ts->recv_lock);
 
 	tty->disc_data = ts;
@@ -195,7 +209,10 @@ static void ts27010_ldisc_receive(struct tty_struct *tty,
 
 static void ts27010_ldisc_wakeup(struct tty_struct *tty)
 {
-	pr_info(" Enter into ts27010mux_tty_wakeup. \n");
+	struct ts27010_ldisc_data *ts = tty->disc_data;
+
+	if (ts)
+		wake_up(&ts->send_wait);
 }
 
 
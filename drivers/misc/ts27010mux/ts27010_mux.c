@@ -92,6 +92,9 @@
 
 #define TS0710MUX_SERIAL_BUF_SIZE 2048
 
+/* credit a data line gets per round, at least one full frame */
+#define TS0710MUX_TX_QUANTUM TS0710MUX_SEND_BUF_SIZE
+
 #define CMDTAG 0x55
 #define DATATAG 0xAA
 
@@ -203,17 +206,16 @@ static void ts27010_debugrbuf(int level, const char *header,
 			      struct ts27010_ringbuf *rbuf,
 			      int idx, int len)
 {
-	int i;
-
 	len = min(TS0710_DBG_BUF_SIZE - 1, len);
+	if (len <= 0)
+		return;
 
-	for (i = 0; i < len; i++)
-		dbg_buf[i] = ts27010_ringbuf_peek(rbuf, idx+i);
+	ts27010_ringbuf_read(rbuf, idx, dbg_buf, len);
 
-	if (dbg_buf[i-1] == '\n')
-		dbg_buf[i-1] = '\0';
+	if (dbg_buf[len-1] == '\n')
+		dbg_buf[len-1] = '\0';
 	else
-		dbg_buf[i] = '\0';
+		dbg_buf[len] = '\0';
 
 	ts_debug(level, "%s%s\n", header, dbg_buf);
 }
@@ -634,15 +636,13 @@ static void ts27010_handle_pn(struct ts0710_con *ts0710, u8 type,
 	u8 dlci;
 	u16 frame_size;
 	struct pn_msg_data pn;
-	int i;
 
 	if (len != 8) {
 		pr_err("ts27010: reveived pn on length:%d != 8\n", len);
 		return;
 	}
 
-	for (i = 0; i < 8; i++)
-		((u8 *)&pn)[i] = ts27010_ringbuf_peek(rbuf, data_idx + i);
+	ts27010_ringbuf_read(rbuf, data_idx, (u8 *)&pn, 8);
 
 	dlci = pn.dlci;
 	frame_size = pn.frame_sizel | (pn.frame_sizeh << 8);
@@ -706,13 +706,19 @@ static void ts27010_handle_mcc(struct ts0710_con *ts0710, u8 control,
 	case FCON:
 		ts_debug(DBG_CMD,
 			 "ts27010: received all channels flow control on\n");
-		pr_warning("ts27010: flow control unimplemented\n");
+		if (ts0710->dlci[0].state == FLOW_STOPPED)
+			ts0710->dlci[0].state = CONNECTED;
+		if (mcc_is_cmd(type))
+			ts27010_send_fcon(ts0710, MCC_RSP);
 		break;
 
 	case FCOFF:
 		ts_debug(DBG_CMD,
 			 "ts27010: received all channels flow control off\n");
-		pr_warning("ts27010: flow control unimplemented\n");
+		if (ts0710->dlci[0].state == CONNECTED)
+			ts0710->dlci[0].state = FLOW_STOPPED;
+		if (mcc_is_cmd(type))
+			ts27010_send_fcoff(ts0710, MCC_RSP);
 		break;
 
 	case MSC:
@@ -1237,6 +1243,86 @@ void ts27010_mux_line_close(int line)
 
 }
 
+/*
+ * The next line to send a UIH frame, with tx_lock held; -1 if no line
+ * waits.  The command lines, which carry AT commands and SMS, go
+ * first.  The data lines share the rest by deficit round robin: each
+ * frame is charged to the credit of its line, and the credits of the
+ * waiting lines are topped up once none of them can pay for its
+ * frame.  A saturated data line thus gets its share, not the link.
+ */
+static int ts27010_tx_pick(struct ts0710_con *ts0710)
+{
+	struct chan_struct *c;
+	int i, line;
+
+	if (!ts0710->tx_waiting)
+		return -1;
+
+	for (i = 1; i <= NR_MUXS; i++) {
+		line = (ts0710->tx_last + i) % NR_MUXS;
+		if (iscmdtty[line] && test_bit(line, &ts0710->tx_waiting))
+			return line;
+	}
+
+	for (;;) {
+		for (i = 1; i <= NR_MUXS; i++) {
+			line = (ts0710->tx_last + i) % NR_MUXS;
+			c = &ts0710->chan[line];
+			if (test_bit(line, &ts0710->tx_waiting) &&
+			    c->credit >= c->tx_len) {
+				c->credit -= c->tx_len;
+				return line;
+			}
+		}
+
+		for (line = 0; line < NR_MUXS; line++) {
+			c = &ts0710->chan[line];
+			if (test_bit(line, &ts0710->tx_waiting))
+				c->credit = min(c->credit +
+						TS0710MUX_TX_QUANTUM,
+						TS0710MUX_TX_QUANTUM);
+		}
+	}
+}
+
+/* wait for the turn of line to send a frame of len bytes */
+static void ts27010_tx_acquire(struct ts0710_con *ts0710, int line, int len)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ts0710->tx_lock, flags);
+	ts0710->chan[line].tx_len = len;
+	set_bit(line, &ts0710->tx_waiting);
+	if (ts0710->tx_owner < 0) {
+		ts0710->tx_owner = ts27010_tx_pick(ts0710);
+		if (ts0710->tx_owner >= 0) {
+			clear_bit(ts0710->tx_owner, &ts0710->tx_waiting);
+			ts0710->tx_last = ts0710->tx_owner;
+		}
+		wake_up_all(&ts0710->tx_wait);
+	}
+	spin_unlock_irqrestore(&ts0710->tx_lock, flags);
+
+	wait_event(ts0710->tx_wait, ts0710->tx_owner == line);
+}
+
+/* pass the link on to the next waiting line */
+static void ts27010_tx_release(struct ts0710_con *ts0710, int line)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ts0710->tx_lock, flags);
+	WARN_ON(ts0710->tx_owner != line);
+	ts0710->tx_owner = ts27010_tx_pick(ts0710);
+	if (ts0710->tx_owner >= 0) {
+		clear_bit(ts0710->tx_owner, &ts0710->tx_waiting);
+		ts0710->tx_last = ts0710->tx_owner;
+		wake_up_all(&ts0710->tx_wait);
+	}
+	spin_unlock_irqrestore(&ts0710->tx_lock, flags);
+}
+
 int ts27010_mux_line_write(int line, const unsigned char *buf, int count)
 {
 	/* TODO: this should come from somewhere good */
@@ -1279,8 +1365,10 @@ int ts27010_mux_line_write(int line, const unsigned char *buf, int count)
 			tag = DATATAG;
 		}
 
+		ts27010_tx_acquire(ts0710, line, c + 1);
 		ts27010_send_uih(ts0710, dlci, ts0710->chan[line].buf,
 				 tag, buf, c);
+		ts27010_tx_release(ts0710, line);
 
 		mutex_unlock(&ts0710->chan[line].write_lock);
 
@@ -1374,6 +1462,8 @@ void ts27010_mux_recv(struct ts27010_ringbuf *rbuf)
 			if (c & 0x1) {
 				data_idx = i+1;
 				state = RECV_STATE_DATA;
+				/* payload is not parsed, on to the FCS */
+				i = min(data_idx + len, count) - 1;
 			} else {
 				state = RECV_STATE_LEN2;
 			}
@@ -1391,6 +1481,7 @@ void ts27010_mux_recv(struct ts27010_ringbuf *rbuf)
 				break;
 			}
 			state = RECV_STATE_DATA;
+			i = min(data_idx + len, count) - 1;
 			break;
 
 		case RECV_STATE_DATA:
@@ -1428,6 +1519,10 @@ static int __init mux_init(void)
 	for (j = 0; j < TS0710_MAX_CHN; j++)
 		mutex_init(&ts0710_connection.dlci[j].lock);
 
+	spin_lock_init(&ts0710_connection.tx_lock);
+	init_waitqueue_head(&ts0710_connection.tx_wait);
+	ts0710_connection.tx_owner = -1;
+
 	for (j = 0; j < NR_MUXS; j++) {
 		ts0710_connection.chan[j].buf =
 			kmalloc(TS0710MUX_SEND_BUF_SIZE, GFP_KERNEL);
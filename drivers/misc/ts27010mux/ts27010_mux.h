@@ -31,7 +31,7 @@
 #define NUM_MUX_DATA_FILES 0
 #define NUM_MUX_FILES (NUM_MUX_CMD_FILES  +  NUM_MUX_DATA_FILES)
 
-#define LDISC_BUFFER_SIZE (4096 - sizeof(struct ts27010_ringbuf))
+#define LDISC_BUFFER_SIZE 4096 /* a power of two */
 
 /* TODO: should use the IOCTLNUM macros */
 /* Special ioctl() upon a MUX device file for hanging up a call */
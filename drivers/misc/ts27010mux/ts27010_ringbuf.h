@@ -2,14 +2,20 @@
  * simple ring buffer
  *
  * supports a concurrent reader and writer without locking
+ *
+ * len is a power of two so indices wrap with a mask.  The span
+ * helpers give the data from an index up to the end of the buffer,
+ * so any range is at most two contiguous pieces.
  */
 
+#include <linux/log2.h>
+
 
 struct ts27010_ringbuf {
 	int len;
 	int head;
 	int tail;
-	u8 buf[];
+	u8 *buf;
 };
 
 
@@ -17,10 +23,19 @@ static inline struct ts27010_ringbuf *ts27010_ringbuf_alloc(int len)
 {
 	struct ts27010_ringbuf *rbuf;
 
-	rbuf = kzalloc(sizeof(*rbuf) + len, GFP_KERNEL);
+	if (WARN_ON(!is_power_of_2(len)))
+		return NULL;
+
+	rbuf = kzalloc(sizeof(*rbuf), GFP_KERNEL);
 	if (rbuf == NULL)
 		return NULL;
 
+	rbuf->buf = kzalloc(len, GFP_KERNEL);
+	if (rbuf->buf == NULL) {
+		kfree(rbuf);
+		return NULL;
+	}
+
 	rbuf->len = len;
 	rbuf->head = 0;
 	rbuf->tail = 0;
@@ -30,17 +45,13 @@ static inline struct ts27010_ringbuf *ts27010_ringbuf_alloc(int len)
 
 static inline void ts27010_ringbuf_free(struct ts27010_ringbuf *rbuf)
 {
+	kfree(rbuf->buf);
 	kfree(rbuf);
 }
 
 static inline int ts27010_ringbuf_level(struct ts27010_ringbuf *rbuf)
 {
-	int level = rbuf->head - rbuf->tail;
-
-	if (level < 0)
-		level = rbuf->len + level;
-
-	return level;
+	return (rbuf->head - rbuf->tail) & (rbuf->len - 1);
 }
 
 static inline int ts27010_ringbuf_room(struct ts27010_ringbuf *rbuf)
@@ -50,7 +61,33 @@ static inline int ts27010_ringbuf_room(struct ts27010_ringbuf *rbuf)
 
 static inline u8 ts27010_ringbuf_peek(struct ts27010_ringbuf *rbuf, int i)
 {
-	return rbuf->buf[(rbuf->tail + i) % rbuf->len];
+	return rbuf->buf[(rbuf->tail + i) & (rbuf->len - 1)];
+}
+
+/*
+ * contiguous data at offset i from the tail, at most len bytes:
+ * returns the count and sets *data
+ */
+static inline int ts27010_ringbuf_span(struct ts27010_ringbuf *rbuf,
+				       int i, int len, u8 **data)
+{
+	int pos = (rbuf->tail + i) & (rbuf->len - 1);
+
+	*data = &rbuf->buf[pos];
+	return min(len, rbuf->len - pos);
+}
+
+/* copy len bytes from offset i, which the caller knows are there */
+static inline void ts27010_ringbuf_read(struct ts27010_ringbuf *rbuf,
+					int i, u8 *buf, int len)
+{
+	u8 *data;
+	int c;
+
+	c = ts27010_ringbuf_span(rbuf, i, len, &data);
+	memcpy(buf, data, c);
+	if (c < len)
+		memcpy(buf + c, rbuf->buf, len - c);
 }
 
 static inline int ts27010_ringbuf_consume(struct ts27010_ringbuf *rbuf,
@@ -58,7 +95,7 @@ static inline int ts27010_ringbuf_consume(struct ts27010_ringbuf *rbuf,
 {
 	count = min(count, ts27010_ringbuf_level(rbuf));
 
-	rbuf->tail = (rbuf->tail + count) % rbuf->len;
+	rbuf->tail = (rbuf->tail + count) & (rbuf->len - 1);
 
 	return count;
 }
@@ -69,7 +106,7 @@ static inline int ts27010_ringbuf_push(struct ts27010_ringbuf *rbuf, u8 datum)
 		return 0;
 
 	rbuf->buf[rbuf->head] = datum;
-	rbuf->head = (rbuf->head + 1) % rbuf->len;
+	rbuf->head = (rbuf->head + 1) & (rbuf->len - 1);
 
 	return 1;
 }
@@ -77,11 +114,13 @@ static inline int ts27010_ringbuf_push(struct ts27010_ringbuf *rbuf, u8 datum)
 static inline int ts27010_ringbuf_write(struct ts27010_ringbuf *rbuf,
 					const u8 *data, int len)
 {
-	int count = 0;
-	int i;
+	int count = min(len, ts27010_ringbuf_room(rbuf));
+	int c;
 
-	for (i = 0; i < len; i++)
-		count += ts27010_ringbuf_push(rbuf, data[i]);
+	c = min(count, rbuf->len - rbuf->head);
+	memcpy(&rbuf->buf[rbuf->head], data, c);
+	memcpy(rbuf->buf, data + c, count - c);
+	rbuf->head = (rbuf->head + count) & (rbuf->len - 1);
 
 	return count;
 }
@@ -46,6 +46,8 @@ int ts27010_tty_send_rbuf(int line, struct ts27010_ringbuf *rbuf,
 {
 	struct ts27010_tty_data *td = driver->driver_state;
 	struct tty_struct *tty = td->chan[line].tty;
+	int count, c;
+	u8 *data;
 
 	if (!tty) {
 		pr_info("ts27010: mux%d no open.  discarding %d bytes\n",
@@ -53,12 +55,18 @@ int ts27010_tty_send_rbuf(int line, struct ts27010_ringbuf *rbuf,
 		return 0;
 	}
 
-	while (len--) {
-		char c = ts27010_ringbuf_peek(rbuf, data_idx++);
-		tty_insert_flip_char(tty, c, TTY_NORMAL);
+	/* at most two pieces, where the ring wraps */
+	count = 0;
+	while (count < len) {
+		c = ts27010_ringbuf_span(rbuf, data_idx + count,
+					 len - count, &data);
+		c = tty_insert_flip_string(tty, data, c);
+		if (!c)
+			break;
+		count += c;
 	}
 	tty_flip_buffer_push(tty);
-	return len;
+	return count;
 }
 
 static int ts27010_tty_open(struct tty_struct *tty, struct file *filp)
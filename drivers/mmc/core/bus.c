@@ -142,6 +142,24 @@ static int mmc_bus_resume(struct device *dev)
 	return ret;
 }
 
+/*
+ * Write back the eMMC volatile cache before power off, reboot or kexec;
+ * it is only otherwise flushed on suspend.
+ */
+static void mmc_bus_shutdown(struct device *dev)
+{
+	struct mmc_card *card = mmc_dev_to_card(dev);
+	struct mmc_host *host = card->host;
+
+	if (!mmc_card_mmc(card))
+		return;
+
+	mmc_claim_host(host);
+	mmc_wait_bkops(card);
+	mmc_cache_ctrl(host, 0);
+	mmc_release_host(host);
+}
+
 #ifdef CONFIG_PM_RUNTIME
 
 static int mmc_runtime_suspend(struct device *dev)
@@ -184,6 +202,7 @@ static struct bus_type mmc_bus_type = {
 	.uevent		= mmc_bus_uevent,
 	.probe		= mmc_bus_probe,
 	.remove		= mmc_bus_remove,
+	.shutdown	= mmc_bus_shutdown,
 	.suspend	= mmc_bus_suspend,
 	.resume		= mmc_bus_resume,
 	.pm		= MMC_PM_OPS_PTR,
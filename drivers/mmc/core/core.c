@@ -24,6 +24,7 @@
 #include <linux/regulator/consumer.h>
 #include <linux/pm_runtime.h>
 #include <linux/wakelock.h>
+#include <linux/slab.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -41,6 +42,9 @@
 
 static struct workqueue_struct *workqueue;
 
+/* the spec sets no limit on BKOPS, this only bounds a stuck card */
+#define MMC_BKOPS_MAX_TIMEOUT	(4 * 60 * 1000)	/* ms */
+
 /*
  * Enabling software CRCs on the data blocks can be a significant (30%)
  * performance cost, and for other reasons may not always be desired.
@@ -202,6 +206,111 @@ static void mmc_wait_done(struct mmc_request *mrq)
 	complete(mrq->done_data);
 }
 
+static void mmc_async_done(struct mmc_request *mrq)
+{
+	complete(&mrq->completion);
+}
+
+static void __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	init_completion(&mrq->completion);
+	mrq->done = mmc_async_done;
+	mmc_start_request(host, mrq);
+}
+
+static void mmc_wait_for_req_done(struct mmc_host *host,
+				  struct mmc_request *mrq)
+{
+	wait_for_completion(&mrq->completion);
+}
+
+/**
+ *	mmc_pre_req - Prepare for a new request
+ *	@host: MMC host to prepare command
+ *	@mrq: MMC request to prepare for
+ *	@is_first_req: true if there is no previous started request
+ *                     that may run in parellel to this call, otherwise false
+ *
+ *	mmc_pre_req() is called in prior to mmc_start_req() to let
+ *	host prepare for the new request. Preparation of a request may be
+ *	performed while another request is running on the host.
+ */
+static void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+		 bool is_first_req)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq, is_first_req);
+}
+
+/**
+ *	mmc_post_req - Post process a completed request
+ *	@host: MMC host to post process command
+ *	@mrq: MMC request to post process for
+ *	@err: Error, if non zero, clean up any resources made in pre_req
+ *
+ *	Let the host post process a completed request. Post processing of
+ *	a request may be performed while another reuqest is running.
+ */
+static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
+			 int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+/**
+ *	mmc_start_req - start a non-blocking request
+ *	@host: MMC host to start command
+ *	@areq: async request to start
+ *	@error: out parameter returns 0 for success, otherwise non zero
+ *
+ *	Start a new MMC custom command request for a host.
+ *	If there is on ongoing async request wait for completion
+ *	of that request and start the new one and return.
+ *	Does not wait for the new request to complete.
+ *
+ *      Returns the completed request, NULL in case of none completed.
+ *	Wait for the an ongoing request (previoulsy started) to complete and
+ *	return the completed request. If there is no ongoing request, NULL
+ *	is returned without waiting. NULL is not an error condition.
+ */
+struct mmc_async_req *mmc_start_req(struct mmc_host *host,
+				    struct mmc_async_req *areq, int *error)
+{
+	int err = 0;
+	struct mmc_async_req *data = host->areq;
+
+	/* Prepare a new request */
+	if (areq)
+		mmc_pre_req(host, areq->mrq, !host->areq);
+
+	if (host->areq) {
+		mmc_wait_for_req_done(host, host->areq->mrq);
+		err = host->areq->err_check(host->card, host->areq);
+		if (err) {
+			mmc_post_req(host, host->areq->mrq, 0);
+			if (areq)
+				mmc_post_req(host, areq->mrq, -EINVAL);
+
+			host->areq = NULL;
+			goto out;
+		}
+	}
+
+	if (areq)
+		__mmc_start_req(host, areq->mrq);
+
+	if (host->areq)
+		mmc_post_req(host, host->areq->mrq, 0);
+
+	host->areq = areq;
+ out:
+	if (error)
+		*error = err;
+	return data;
+}
+EXPORT_SYMBOL(mmc_start_req);
+
 /**
  *	mmc_wait_for_req - start a request and wait for completion
  *	@host: MMC host to start command
@@ -1584,6 +1693,169 @@ int mmc_set_blocklen(struct mmc_card *card, unsigned int blocklen)
 }
 EXPORT_SYMBOL(mmc_set_blocklen);
 
+/**
+ *	mmc_flush_cache - write back the eMMC volatile cache
+ *	@card: MMC card, with the host claimed
+ *
+ *	Does nothing unless the cache was turned on by mmc_cache_ctrl().
+ */
+int mmc_flush_cache(struct mmc_card *card)
+{
+	int err = 0;
+
+	if (mmc_card_mmc(card) && card->ext_csd.cache_ctrl) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_FLUSH_CACHE, 1, 0);
+		if (err)
+			pr_err("%s: cache flush error %d\n",
+			       mmc_hostname(card->host), err);
+	}
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_flush_cache);
+
+/**
+ *	mmc_cache_ctrl - turn the eMMC volatile cache on or off
+ *	@host: MMC host, claimed
+ *	@enable: nonzero to turn it on
+ *
+ *	Only non-removable cards whose host allows it get a cache, since
+ *	data still in the cache is lost if the card is pulled.  Turning
+ *	the cache off writes it back first.
+ */
+int mmc_cache_ctrl(struct mmc_host *host, u8 enable)
+{
+	struct mmc_card *card = host->card;
+	int err = 0;
+
+	if (!(host->caps2 & MMC_CAP2_CACHE_CTRL) ||
+	    mmc_card_is_removable(host))
+		return 0;
+
+	if (card && mmc_card_mmc(card) && card->ext_csd.cache_size > 0) {
+		enable = !!enable;
+
+		if (card->ext_csd.cache_ctrl != enable)
+			err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_CACHE_CTRL, enable, 0);
+		if (err)
+			pr_err("%s: cache %s error %d\n",
+			       mmc_hostname(card->host),
+			       enable ? "on" : "off", err);
+		else
+			card->ext_csd.cache_ctrl = enable;
+	}
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_cache_ctrl);
+
+static int mmc_read_bkops_status(struct mmc_card *card)
+{
+	u8 *ext_csd;
+	int err;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (!err)
+		card->ext_csd.raw_bkops_status = ext_csd[EXT_CSD_BKOPS_STATUS];
+
+	kfree(ext_csd);
+	return err;
+}
+
+/**
+ *	mmc_start_bkops - start background operations the card asks for
+ *	@card: MMC card, with the host claimed
+ *	@urgent: only start them at level 2 or above, and wait for them
+ *
+ *	Non-urgent operations are left running and the card stays busy
+ *	until they are done.  There is no HPI to cut them short, so
+ *	mmc_wait_bkops() has to be called before the next command.
+ */
+void mmc_start_bkops(struct mmc_card *card, bool urgent)
+{
+	int err;
+	u8 level;
+
+	BUG_ON(!card);
+
+	if (!card->ext_csd.bkops_en || mmc_card_doing_bkops(card))
+		return;
+
+	err = mmc_read_bkops_status(card);
+	if (err) {
+		pr_err("%s: error %d reading BKOPS status\n",
+		       mmc_hostname(card->host), err);
+		return;
+	}
+
+	level = card->ext_csd.raw_bkops_status & EXT_CSD_BKOPS_LEVEL_MASK;
+	if (!level || (urgent && level < EXT_CSD_BKOPS_LEVEL_2)) {
+		mmc_card_clr_need_bkops(card);
+		return;
+	}
+
+	pr_debug("%s: starting %s BKOPS, level %u\n",
+		 mmc_hostname(card->host), urgent ? "urgent" : "idle", level);
+
+	err = __mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BKOPS_START,
+			   1, MMC_BKOPS_MAX_TIMEOUT, urgent);
+	if (err) {
+		pr_warning("%s: error %d starting BKOPS\n",
+			   mmc_hostname(card->host), err);
+		return;
+	}
+
+	mmc_card_clr_need_bkops(card);
+	if (!urgent)
+		mmc_card_set_doing_bkops(card);
+}
+EXPORT_SYMBOL(mmc_start_bkops);
+
+/**
+ *	mmc_wait_bkops - wait for background operations to finish
+ *	@card: MMC card, with the host claimed
+ *
+ *	Polls the card until it leaves the programming state entered by
+ *	mmc_start_bkops().  Returns at once if none were started.
+ */
+int mmc_wait_bkops(struct mmc_card *card)
+{
+	unsigned long timeout;
+	u32 status;
+	int err;
+
+	if (!card || !mmc_card_doing_bkops(card))
+		return 0;
+
+	timeout = jiffies + msecs_to_jiffies(MMC_BKOPS_MAX_TIMEOUT);
+	do {
+		err = mmc_send_status(card, &status);
+		if (err)
+			break;
+		if (R1_CURRENT_STATE(status) != R1_STATE_PRG)
+			break;
+		if (time_after(jiffies, timeout)) {
+			err = -ETIMEDOUT;
+			break;
+		}
+		msleep(1);
+	} while (1);
+
+	if (err)
+		pr_err("%s: error %d waiting for BKOPS\n",
+		       mmc_hostname(card->host), err);
+
+	mmc_card_clr_doing_bkops(card);
+	return err;
+}
+EXPORT_SYMBOL(mmc_wait_bkops);
+
 static int mmc_rescan_try_freq(struct mmc_host *host, unsigned freq)
 {
 	host->f_init = freq;
@@ -403,9 +403,38 @@ static int mmc_read_ext_csd(struct mmc_card *card, u8 *ext_csd)
 			ext_csd[EXT_CSD_TRIM_MULT];
 	}
 
-	if (card->ext_csd.rev >= 5)
+	if (card->ext_csd.rev >= 5) {
 		card->ext_csd.rel_param = ext_csd[EXT_CSD_WR_REL_PARAM];
 
+		/*
+		 * BKOPS_EN can be set only once, which is left to the
+		 * manufacturing flow: the host starts BKOPS only on
+		 * parts where it already is.
+		 */
+		card->ext_csd.bkops = ext_csd[EXT_CSD_BKOPS_SUPPORT] & 0x1;
+		if (card->ext_csd.bkops) {
+			card->ext_csd.bkops_en = ext_csd[EXT_CSD_BKOPS_EN] & 0x1;
+			card->ext_csd.raw_bkops_status =
+				ext_csd[EXT_CSD_BKOPS_STATUS];
+			if (!card->ext_csd.bkops_en)
+				pr_info("%s: BKOPS_EN bit is not set\n",
+					mmc_hostname(card->host));
+		}
+	}
+
+	/* The volatile cache and packed commands came with v4.5 */
+	if (card->ext_csd.rev >= 6) {
+		card->ext_csd.cache_size =
+			ext_csd[EXT_CSD_CACHE_SIZE + 0] << 0 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24;
+		card->ext_csd.max_packed_writes =
+			ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		card->ext_csd.max_packed_reads =
+			ext_csd[EXT_CSD_MAX_PACKED_READS];
+	}
+
 	card->ext_csd.raw_erased_mem_count = ext_csd[EXT_CSD_ERASED_MEM_CONT];
 	if (ext_csd[EXT_CSD_ERASED_MEM_CONT])
 		card->erased_byte = 0xFF;
@@ -844,6 +873,40 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * If cache size is higher than 0, this indicates
+	 * the existence of cache and it can be turned on.
+	 * The card comes out of reset with the cache off.
+	 */
+	card->ext_csd.cache_ctrl = 0;
+	if ((host->caps2 & MMC_CAP2_CACHE_CTRL) &&
+	    !mmc_card_is_removable(host) &&
+	    card->ext_csd.cache_size > 0) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_CACHE_CTRL, 1, 0);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		/* Only if no error, cache is turned on successfully. */
+		card->ext_csd.cache_ctrl = err ? 0 : 1;
+		err = 0;
+	}
+
+	/*
+	 * Packed write failures are reported as an exception event, which
+	 * tells which entry of the group failed.  Without it the whole
+	 * group would have to be failed, so only pack with it enabled.
+	 */
+	card->ext_csd.packed_event_en = 0;
+	if (mmc_host_packed_wr(host) && card->ext_csd.max_packed_writes) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_EXP_EVENTS_CTRL,
+				 EXT_CSD_PACKED_EVENT_EN, 0);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		card->ext_csd.packed_event_en = err ? 0 : 1;
+		err = 0;
+	}
+
 	if (!oldcard)
 		host->card = card;
 
@@ -911,11 +974,16 @@ static int mmc_suspend(struct mmc_host *host)
 	BUG_ON(!host->card);
 
 	mmc_claim_host(host);
+	mmc_wait_bkops(host->card);
+	err = mmc_cache_ctrl(host, 0);
+	if (err)
+		goto out;
 	if (mmc_card_can_sleep(host))
 		err = mmc_card_sleep(host);
 	else if (!mmc_host_is_spi(host))
 		mmc_deselect_cards(host);
 	host->card->state &= ~MMC_STATE_HIGHSPEED;
+out:
 	mmc_release_host(host);
 
 	return err;
@@ -959,6 +1027,8 @@ static int mmc_sleep(struct mmc_host *host)
 	int err = -ENOSYS;
 
 	if (card && card->ext_csd.rev >= 3) {
+		/* a card in sleep state does no background work */
+		mmc_wait_bkops(card);
 		err = mmc_card_sleepawake(host, 1);
 		if (err < 0)
 			pr_debug("%s: Error %d while putting card into sleep",
@@ -81,7 +81,11 @@
 #define SDVSCLR			0xFFFFF1FF
 #define SDVSDET			0x00000400
 #define AUTOIDLE		0x1
+#define ENAWAKEUP		(1 << 2)
+#define SIDLE_MASK		(0x3 << 3)
+#define SIDLE_SMART		(0x2 << 3)
 #define SDBP			(1 << 8)
+#define IWE			(1 << 24)
 #define DTO			0xe
 #define ICE			0x1
 #define ICS			0x2
@@ -93,6 +97,7 @@
 #define INT_EN_MASK		0x307F0033
 #define BWR_ENABLE		(1 << 4)
 #define BRR_ENABLE		(1 << 5)
+#define CIRQ_ENABLE		(1 << 8)
 #define DTO_ENABLE		(1 << 20)
 #define INIT_STREAM		(1 << 1)
 #define ACEN_ACMD12		(1 << 2)
@@ -105,8 +110,11 @@
 #define FOUR_BIT		(1 << 1)
 #define DDR			(1 << 19)
 #define DW8			(1 << 5)
+#define CTPL			(1 << 11)
+#define CLKEXTFREE		(1 << 16)
 #define CC			0x1
 #define TC			0x02
+#define CIRQ			(1 << 8)
 #define OD			0x1
 #define ERR			(1 << 15)
 #define CMD_TIMEOUT		(1 << 16)
@@ -135,6 +143,8 @@
 #define ADMA_TABLE_SZ (PAGE_SIZE)
 #define ADMA_TABLE_NUM_ENTRIES \
 	(ADMA_TABLE_SZ / sizeof(struct adma_desc_table))
+/* one table for the active transfer, one for the prepared next one */
+#define ADMA_TABLE_NUM	2
 
 #define SDMA_XFER	1
 #define ADMA_XFER	2
@@ -147,8 +157,11 @@
  */
 #define ADMA_MAX_XFER_PER_ROW (60 * 1024)
 
+/* SDMA segments in flight, on linked channels */
+#define OMAP_HSMMC_DMA_LCH	4
 
 #define AUTO_CMD12		(1 << 0)	/* Auto CMD12 support */
+#define HSMMC_SDIO_IRQ_ENABLED	(1 << 1)	/* SDIO card irq wanted */
 /*
  * FIXME: Most likely all the data using these _DEVID defines should come
  * from the platform_data, or implemented in controller and slot specific
@@ -191,6 +204,13 @@ struct adma_desc_table {
 	dma_addr_t addr;
 };
 
+/* request mapped by pre_req, ahead of its start */
+struct omap_hsmmc_next {
+	unsigned int		dma_len;
+	unsigned int		adma_idx;
+	s32			cookie;
+};
+
 struct omap_hsmmc_host {
 	struct	device		*dev;
 	struct	mmc_host	*mmc;
@@ -215,7 +235,6 @@ struct omap_hsmmc_host {
 	spinlock_t		irq_lock; /* Prevent races with irq handler */
 	unsigned int		id;
 	unsigned int		dma_len;
-	unsigned int		dma_sg_idx;
 	unsigned int		master_clock;
 	unsigned char		bus_mode;
 	unsigned char		power_mode;
@@ -223,9 +242,12 @@ struct omap_hsmmc_host {
 	u32			bytesleft;
 	int			suspended;
 	int			irq;
-	int			dma_type, dma_ch;
+	int			dma_type;
+	struct omap_dma_sg	*dma_sg;
 	struct adma_desc_table	*adma_table;
 	dma_addr_t		phy_adma_table;
+	unsigned int		adma_idx;
+	struct omap_hsmmc_next	next_data;
 	int			dma_line_tx, dma_line_rx;
 	int			slot_id;
 	int			got_dbclk;
@@ -236,6 +258,7 @@ struct omap_hsmmc_host {
 	int			reqs_blocked;
 	int			use_reg;
 	int			req_in_progress;
+	int			sdio_irq_pm;	/* runtime PM ref for CIRQ */
 	unsigned int		flags;
 
 	struct	omap_mmc_platform_data	*pdata;
@@ -652,16 +675,55 @@ static void omap_hsmmc_enable_irq(struct omap_hsmmc_host *host,
 	if (cmd->opcode == MMC_ERASE)
 		irq_mask &= ~DTO_ENABLE;
 
+	if (host->flags & HSMMC_SDIO_IRQ_ENABLED)
+		irq_mask |= CIRQ_ENABLE;
+
 	OMAP_HSMMC_WRITE(host->base, STAT, STAT_CLEAR);
 	OMAP_HSMMC_WRITE(host->base, ISE, irq_mask);
 	OMAP_HSMMC_WRITE(host->base, IE, irq_mask);
 }
 
+/* Mask the request interrupts, keeping the card interrupt if wanted */
 static void omap_hsmmc_disable_irq(struct omap_hsmmc_host *host)
 {
-	OMAP_HSMMC_WRITE(host->base, ISE, 0);
-	OMAP_HSMMC_WRITE(host->base, IE, 0);
+	unsigned long flags;
+	u32 irq_mask = 0;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	if (host->flags & HSMMC_SDIO_IRQ_ENABLED)
+		irq_mask = CIRQ_ENABLE;
+	OMAP_HSMMC_WRITE(host->base, ISE, irq_mask);
+	OMAP_HSMMC_WRITE(host->base, IE, irq_mask);
 	OMAP_HSMMC_WRITE(host->base, STAT, STAT_CLEAR);
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+}
+
+/*
+ * Card interrupt detection on DAT1: keep the lines powered and the card
+ * clock free running, and let the card interrupt wake the controller up
+ * from smart idle so that the interrupt is not lost while it idles.
+ */
+static void omap_hsmmc_conf_sdio_irq(struct omap_hsmmc_host *host, int enable)
+{
+	u32 con, hctl, sysc;
+
+	con = OMAP_HSMMC_READ(host->base, CON);
+	hctl = OMAP_HSMMC_READ(host->base, HCTL);
+	sysc = OMAP_HSMMC_READ(host->base, SYSCONFIG);
+
+	if (enable) {
+		con |= CTPL | CLKEXTFREE;
+		hctl |= IWE;
+		sysc = (sysc & ~SIDLE_MASK) | SIDLE_SMART | ENAWAKEUP;
+	} else {
+		con &= ~(CTPL | CLKEXTFREE);
+		hctl &= ~IWE;
+		sysc &= ~ENAWAKEUP;
+	}
+
+	OMAP_HSMMC_WRITE(host->base, CON, con);
+	OMAP_HSMMC_WRITE(host->base, HCTL, hctl);
+	OMAP_HSMMC_WRITE(host->base, SYSCONFIG, sysc);
 }
 
 #ifdef CONFIG_PM
@@ -729,6 +791,8 @@ static int omap_hsmmc_context_restore(struct omap_hsmmc_host *host)
 		&& time_before(jiffies, timeout))
 		;
 
+	if (host->flags & HSMMC_SDIO_IRQ_ENABLED)
+		omap_hsmmc_conf_sdio_irq(host, 1);
 	omap_hsmmc_disable_irq(host);
 
 	/* Do not initialize card-specific things if the power is off */
@@ -949,16 +1013,16 @@ omap_hsmmc_get_dma_dir(struct omap_hsmmc_host *host, struct mmc_data *data)
 
 static void omap_hsmmc_request_done(struct omap_hsmmc_host *host, struct mmc_request *mrq)
 {
-	int dma_ch;
+	struct omap_dma_sg *dma_sg;
 
 	spin_lock(&host->irq_lock);
 	host->req_in_progress = 0;
-	dma_ch = host->dma_ch;
+	dma_sg = host->dma_sg;
 	spin_unlock(&host->irq_lock);
 
 	omap_hsmmc_disable_irq(host);
 	/* Do not complete the request if DMA is still in progress */
-	if (mrq->data && host->dma_type && dma_ch != -1)
+	if (mrq->data && host->dma_type && dma_sg)
 		return;
 	host->mrq = NULL;
 	mmc_request_done(host->mmc, mrq);
@@ -986,7 +1050,7 @@ omap_hsmmc_xfer_done(struct omap_hsmmc_host *host, struct mmc_data *data)
 
 	host->data = NULL;
 
-	if (host->dma_type == ADMA_XFER)
+	if (host->dma_type == ADMA_XFER && !data->host_cookie)
 		dma_unmap_sg(mmc_dev(host->mmc), data->sg, host->dma_len,
 					omap_hsmmc_get_dma_dir(host, data));
 
@@ -1056,20 +1120,21 @@ omap_hsmmc_cmd_done(struct omap_hsmmc_host *host, struct mmc_command *cmd)
  */
 static void omap_hsmmc_dma_cleanup(struct omap_hsmmc_host *host, int errno)
 {
-	int dma_ch;
+	struct omap_dma_sg *dma_sg;
 
 	host->data->error = errno;
 
 	spin_lock(&host->irq_lock);
-	dma_ch = host->dma_ch;
-	host->dma_ch = -1;
+	dma_sg = host->dma_sg;
+	host->dma_sg = NULL;
 	spin_unlock(&host->irq_lock);
 
-	if ((host->dma_type == SDMA_XFER) && (dma_ch != -1)) {
-		dma_unmap_sg(mmc_dev(host->mmc), host->data->sg,
-			host->data->sg_len,
-			omap_hsmmc_get_dma_dir(host, host->data));
-		omap_free_dma(dma_ch);
+	if ((host->dma_type == SDMA_XFER) && dma_sg) {
+		if (!host->data->host_cookie)
+			dma_unmap_sg(mmc_dev(host->mmc), host->data->sg,
+				host->data->sg_len,
+				omap_hsmmc_get_dma_dir(host, host->data));
+		omap_free_dma_sg(dma_sg);
 	}
 	host->data = NULL;
 }
@@ -1243,10 +1308,14 @@ static irqreturn_t omap_hsmmc_irq(int irq, void *dev_id)
 
 	status = OMAP_HSMMC_READ(host->base, STAT);
 	do {
+		/* masks CIRQ until ksdioirqd has serviced the card */
+		if ((status & CIRQ) &&
+		    (host->flags & HSMMC_SDIO_IRQ_ENABLED))
+			mmc_signal_sdio_irq(host->mmc);
 		omap_hsmmc_do_irq(host, status);
 		/* Flush posted write */
 		status = OMAP_HSMMC_READ(host->base, STAT);
-	} while (status & INT_EN_MASK);
+	} while (status & (INT_EN_MASK | CIRQ));
 
 	return IRQ_HANDLED;
 }
@@ -1428,34 +1497,19 @@ static int omap_hsmmc_get_dma_sync_dev(struct omap_hsmmc_host *host,
 	return sync_dev;
 }
 
-static void omap_hsmmc_config_dma_params(struct omap_hsmmc_host *host,
-				       struct mmc_data *data,
-				       struct scatterlist *sgl)
+static int omap_hsmmc_config_dma_params(struct omap_hsmmc_host *host,
+				       struct mmc_data *data)
 {
-	int blksz, nblk, dma_ch;
-
-	dma_ch = host->dma_ch;
-	if (data->flags & MMC_DATA_WRITE) {
-		omap_set_dma_dest_params(dma_ch, 0, OMAP_DMA_AMODE_CONSTANT,
-			(host->mapbase + OMAP_HSMMC_DATA), 0, 0);
-		omap_set_dma_src_params(dma_ch, 0, OMAP_DMA_AMODE_POST_INC,
-			sg_dma_address(sgl), 0, 0);
-	} else {
-		omap_set_dma_src_params(dma_ch, 0, OMAP_DMA_AMODE_CONSTANT,
-			(host->mapbase + OMAP_HSMMC_DATA), 0, 0);
-		omap_set_dma_dest_params(dma_ch, 0, OMAP_DMA_AMODE_POST_INC,
-			sg_dma_address(sgl), 0, 0);
-	}
-
-	blksz = host->data->blksz;
-	nblk = sg_dma_len(sgl) / blksz;
-
-	omap_set_dma_transfer_params(dma_ch, OMAP_DMA_DATA_TYPE_S32,
-			blksz / 4, nblk, OMAP_DMA_SYNC_FRAME,
-			omap_hsmmc_get_dma_sync_dev(host, data),
-			!(data->flags & MMC_DATA_WRITE));
+	struct omap_dma_sg_config cfg = {
+		.dev_addr	= host->mapbase + OMAP_HSMMC_DATA,
+		.data_type	= OMAP_DMA_DATA_TYPE_S32,
+		.elem_count	= data->blksz / 4,
+		.sync_mode	= OMAP_DMA_SYNC_FRAME,
+		.dma_trigger	= omap_hsmmc_get_dma_sync_dev(host, data),
+		.to_device	= data->flags & MMC_DATA_WRITE,
+	};
 
-	omap_start_dma(dma_ch);
+	return omap_start_dma_sg(host->dma_sg, &cfg, data->sg, host->dma_len);
 }
 
 /*
@@ -1465,7 +1519,8 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 {
 	struct omap_hsmmc_host *host = cb_data;
 	struct mmc_data *data = host->mrq->data;
-	int dma_ch, req_in_progress;
+	struct omap_dma_sg *dma_sg;
+	int req_in_progress;
 
 	if (!(ch_status & OMAP_DMA_BLOCK_IRQ)) {
 		dev_warn(mmc_dev(host->mmc), "unexpected dma status %x\n",
@@ -1474,29 +1529,21 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 	}
 
 	spin_lock(&host->irq_lock);
-	if (host->dma_ch < 0) {
-		spin_unlock(&host->irq_lock);
-		return;
-	}
-
-	host->dma_sg_idx++;
-	if (host->dma_sg_idx < host->dma_len) {
-		/* Fire up the next transfer. */
-		omap_hsmmc_config_dma_params(host, data,
-					   data->sg + host->dma_sg_idx);
+	if (!host->dma_sg) {
 		spin_unlock(&host->irq_lock);
 		return;
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
-		omap_hsmmc_get_dma_dir(host, data));
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			omap_hsmmc_get_dma_dir(host, data));
 
 	req_in_progress = host->req_in_progress;
-	dma_ch = host->dma_ch;
-	host->dma_ch = -1;
+	dma_sg = host->dma_sg;
+	host->dma_sg = NULL;
 	spin_unlock(&host->irq_lock);
 
-	omap_free_dma(dma_ch);
+	omap_free_dma_sg(dma_sg);
 
 	/* If DMA has finished after TC, complete the request */
 	if (!req_in_progress) {
@@ -1507,13 +1554,18 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 	}
 }
 
+static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
+				       struct mmc_data *data,
+				       struct omap_hsmmc_next *next);
+
 /*
  * Routine to configure and start DMA for the MMC card
  */
 static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 					struct mmc_request *req)
 {
-	int dma_ch = 0, ret = 0, i;
+	struct omap_dma_sg *dma_sg;
+	int ret = 0, i;
 	struct mmc_data *data = req->data;
 
 	/* Sanity check: all the SG entries must be aligned by block size. */
@@ -1530,39 +1582,47 @@ static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 		 */
 		return -EINVAL;
 
-	BUG_ON(host->dma_ch != -1);
+	BUG_ON(host->dma_sg);
 
-	ret = omap_request_dma(omap_hsmmc_get_dma_sync_dev(host, data),
-			       "MMC/SD", omap_hsmmc_dma_cb, host, &dma_ch);
+	ret = omap_request_dma_sg(omap_hsmmc_get_dma_sync_dev(host, data),
+				  "MMC/SD", OMAP_HSMMC_DMA_LCH,
+				  omap_hsmmc_dma_cb, host, &dma_sg);
 	if (ret != 0) {
 		dev_err(mmc_dev(host->mmc),
-			"%s: omap_request_dma() failed with %d\n",
+			"%s: omap_request_dma_sg() failed with %d\n",
 			mmc_hostname(host->mmc), ret);
 		return ret;
 	}
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
-	host->dma_ch = dma_ch;
-	host->dma_sg_idx = 0;
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	if (ret) {
+		omap_free_dma_sg(dma_sg);
+		return ret;
+	}
+	host->dma_sg = dma_sg;
 
-	omap_hsmmc_config_dma_params(host, data, data->sg);
+	ret = omap_hsmmc_config_dma_params(host, data);
+	if (ret) {
+		host->dma_sg = NULL;
+		if (!data->host_cookie)
+			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+				data->sg_len, omap_hsmmc_get_dma_dir(host, data));
+		omap_free_dma_sg(dma_sg);
+	}
 
-	return 0;
+	return ret;
 }
 
 static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
-		struct mmc_request *req, struct adma_desc_table *pdesc)
+		struct mmc_data *data, unsigned int dma_len,
+		struct adma_desc_table *pdesc)
 {
 	int i, j, dmalen;
 	int splitseg, xferaddr;
 	int numblocks = 0;
 	dma_addr_t dmaaddr;
-	struct mmc_data *data = req->data;
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
-	for (i = 0, j = 0; i < host->dma_len; i++) {
+	for (i = 0, j = 0; i < dma_len; i++) {
 		dmaaddr = sg_dma_address(data->sg + i);
 		dmalen = sg_dma_len(data->sg + i);
 		numblocks += dmalen / data->blksz;
@@ -1600,14 +1660,75 @@ static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
 	WARN_ON((i + j - 1) > ADMA_TABLE_NUM_ENTRIES);
 	dev_dbg(mmc_dev(host->mmc),
 		"ADMA table has %d entries from %d sglist\n",
-		i + j, host->dma_len);
+		i + j, dma_len);
 	return numblocks;
 }
 
+/*
+ * Map the data for DMA and, in ADMA mode, build its descriptor table.
+ * With next set this is pre_req preparing a request ahead of its start,
+ * while another one may be transferring: the table is built in the one
+ * the active transfer does not use, and the request is tagged with a
+ * cookie.  Otherwise the request is being started, and if it was
+ * prepared the work is already done.
+ */
+static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
+				       struct mmc_data *data,
+				       struct omap_hsmmc_next *next)
+{
+	unsigned int dma_len, idx = 0;
+	int numblks;
+
+	if (!next && data->host_cookie &&
+	    data->host_cookie != host->next_data.cookie) {
+		dev_warn(mmc_dev(host->mmc),
+			"invalid cookie %d, next cookie %d\n",
+			data->host_cookie, host->next_data.cookie);
+		data->host_cookie = 0;
+	}
+
+	if (!next && data->host_cookie) {
+		host->dma_len = host->next_data.dma_len;
+		host->adma_idx = host->next_data.adma_idx;
+		host->next_data.dma_len = 0;
+		return 0;
+	}
+
+	dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     omap_hsmmc_get_dma_dir(host, data));
+	if (!dma_len)
+		return -EINVAL;
+
+	if (host->dma_type == ADMA_XFER) {
+		/* keep clear of the table of the active or prepared request */
+		if (next)
+			idx = host->adma_idx ^ 1;
+		else if (host->next_data.dma_len)
+			idx = host->next_data.adma_idx ^ 1;
+		else
+			idx = host->adma_idx;
+		numblks = mmc_populate_adma_desc_table(host, data, dma_len,
+				host->adma_table + idx * ADMA_TABLE_NUM_ENTRIES);
+		WARN_ON(numblks != data->blocks);
+	}
+
+	if (next) {
+		next->dma_len = dma_len;
+		next->adma_idx = idx;
+		data->host_cookie = ++next->cookie < 0 ? 1 : next->cookie;
+	} else {
+		host->dma_len = dma_len;
+		host->adma_idx = idx;
+	}
+
+	return 0;
+}
+
 static void omap_hsmmc_start_adma_transfer(struct omap_hsmmc_host *host)
 {
 	wmb();
-	OMAP_HSMMC_WRITE(host->base, ADMA_SAL, host->phy_adma_table);
+	OMAP_HSMMC_WRITE(host->base, ADMA_SAL,
+		host->phy_adma_table + host->adma_idx * ADMA_TABLE_SZ);
 }
 
 static void set_data_timeout(struct omap_hsmmc_host *host,
@@ -1654,7 +1775,6 @@ static int
 omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 {
 	int ret;
-	int numblks;
 
 	host->data = req->data;
 
@@ -1680,14 +1800,50 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 			return ret;
 		}
 	} else if (host->dma_type == ADMA_XFER) {
-		numblks = mmc_populate_adma_desc_table(host,
-				req, host->adma_table);
-		WARN_ON(numblks != req->data->blocks);
+		ret = omap_hsmmc_pre_dma_transfer(host, req->data, NULL);
+		if (ret != 0) {
+			dev_dbg(mmc_dev(host->mmc), "MMC adma map failure\n");
+			return ret;
+		}
 		omap_hsmmc_start_adma_transfer(host);
 	}
 	return 0;
 }
 
+static void omap_hsmmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+				int err)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (host->dma_type && data && data->host_cookie) {
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     omap_hsmmc_get_dma_dir(host, data));
+		/* undoing a pre_req whose request never started */
+		if (data->host_cookie == host->next_data.cookie)
+			host->next_data.dma_len = 0;
+		data->host_cookie = 0;
+	}
+}
+
+static void omap_hsmmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			       bool is_first_req)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+
+	if (!mrq->data)
+		return;
+
+	if (mrq->data->host_cookie) {
+		mrq->data->host_cookie = 0;
+		return;
+	}
+
+	if (host->dma_type &&
+	    omap_hsmmc_pre_dma_transfer(host, mrq->data, &host->next_data))
+		mrq->data->host_cookie = 0;
+}
+
 /*
  * Request function. for read/write operation
  */
@@ -1697,7 +1853,7 @@ static void omap_hsmmc_request(struct mmc_host *mmc, struct mmc_request *req)
 	int err;
 
 	BUG_ON(host->req_in_progress);
-	BUG_ON(host->dma_ch != -1);
+	BUG_ON(host->dma_sg);
 	if (host->protect_card) {
 		if (host->reqs_blocked < 3) {
 			/*
@@ -2159,15 +2315,79 @@ static int omap_hsmmc_disable_simple(struct mmc_host *mmc, int lazy)
 	return 0;
 }
 
+/*
+ * Called by the SDIO core to arm the card interrupt again once ksdioirqd
+ * has run the function handlers, and from the interrupt handler, through
+ * mmc_signal_sdio_irq(), to mask it until then.  For as long as the SDIO
+ * interrupt thread exists the controller is kept enabled, so that the
+ * card interrupt can wake it up from idle instead of going unnoticed.
+ */
+static void omap_hsmmc_enable_sdio_irq(struct mmc_host *mmc, int enable)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	unsigned long flags;
+	u32 irq_mask;
+
+	/* ksdioirqd stopped before it ever armed the interrupt */
+	if (!enable && !host->sdio_irq_pm)
+		return;
+
+	if (enable && !host->sdio_irq_pm) {
+		pm_runtime_get_sync(host->dev);
+		host->sdio_irq_pm = 1;
+	}
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+
+	irq_mask = OMAP_HSMMC_READ(host->base, ISE);
+	if (enable) {
+		if (!(host->flags & HSMMC_SDIO_IRQ_ENABLED))
+			omap_hsmmc_conf_sdio_irq(host, 1);
+		host->flags |= HSMMC_SDIO_IRQ_ENABLED;
+		irq_mask |= CIRQ_ENABLE;
+	} else {
+		host->flags &= ~HSMMC_SDIO_IRQ_ENABLED;
+		irq_mask &= ~CIRQ_ENABLE;
+	}
+
+	OMAP_HSMMC_WRITE(host->base, IE, irq_mask);
+	/*
+	 * While a request is in progress the card interrupt is only latched,
+	 * it is signalled with the request interrupts once the request is
+	 * done and omap_hsmmc_disable_irq() unmasks it.
+	 */
+	if (!host->req_in_progress || !enable)
+		OMAP_HSMMC_WRITE(host->base, ISE, irq_mask);
+	/* Flush posted write */
+	OMAP_HSMMC_READ(host->base, IE);
+
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+
+	/*
+	 * The thread is gone once the last function released its irq.
+	 * mmc_signal_sdio_irq() also gets here from the interrupt handler,
+	 * leave the teardown to the thread, which disables the irq again
+	 * from process context on its way out.
+	 */
+	if (!enable && host->sdio_irq_pm && !mmc->sdio_irqs &&
+	    !in_interrupt()) {
+		omap_hsmmc_conf_sdio_irq(host, 0);
+		host->sdio_irq_pm = 0;
+		pm_runtime_put_sync(host->dev);
+	}
+}
+
 static const struct mmc_host_ops omap_hsmmc_ops = {
 	.enable = omap_hsmmc_enable_simple,
 	.disable = omap_hsmmc_disable_simple,
+	.post_req = omap_hsmmc_post_req,
+	.pre_req = omap_hsmmc_pre_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
 	.get_ro = omap_hsmmc_get_ro,
 	.init_card = omap_hsmmc_init_card,
-	/* NYET -- enable_sdio_irq */
+	.enable_sdio_irq = omap_hsmmc_enable_sdio_irq,
 	.panic_probe = raw_mmc_panic_probe,
 	.panic_write = raw_mmc_panic_write,
 	.panic_erase = raw_mmc_panic_erase,
@@ -2176,12 +2396,14 @@ static const struct mmc_host_ops omap_hsmmc_ops = {
 static const struct mmc_host_ops omap_hsmmc_ps_ops = {
 	.enable = omap_hsmmc_enable,
 	.disable = omap_hsmmc_disable,
+	.post_req = omap_hsmmc_post_req,
+	.pre_req = omap_hsmmc_pre_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
 	.get_ro = omap_hsmmc_get_ro,
 	.init_card = omap_hsmmc_init_card,
-	/* NYET -- enable_sdio_irq */
+	.enable_sdio_irq = omap_hsmmc_enable_sdio_irq,
 	.panic_probe = raw_mmc_panic_probe,
 	.panic_write = raw_mmc_panic_write,
 	.panic_erase = raw_mmc_panic_erase,
@@ -2333,7 +2555,7 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 	host->dev	= &pdev->dev;
 	host->dma_type	= SDMA_XFER;
 	host->dev->dma_mask = &pdata->dma_mask;
-	host->dma_ch	= -1;
+	host->dma_sg	= NULL;
 	host->irq	= irq;
 	host->id	= pdev->id;
 	host->mmc->init_delay = pdata->init_delay;
@@ -2427,7 +2649,8 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 		 * due to unset conherency mask
 		 */
 		host->adma_table = dma_alloc_coherent(NULL,
-			ADMA_TABLE_SZ, &host->phy_adma_table, 0);
+			ADMA_TABLE_NUM * ADMA_TABLE_SZ,
+			&host->phy_adma_table, 0);
 		if (host->adma_table != NULL)
 			host->dma_type = ADMA_XFER;
 	}
@@ -2452,6 +2675,9 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 	if (mmc_slot(host).nonremovable)
 		mmc->caps |= MMC_CAP_NONREMOVABLE;
 
+	/* CMD23 is sent by the driver, which is all packed writes need */
+	mmc->caps2 |= MMC_CAP2_CACHE_CTRL | MMC_CAP2_PACKED_WR;
+
 	mmc->pm_caps = MMC_PM_KEEP_POWER | MMC_PM_IGNORE_PM_NOTIFY;
 	if (mmc_slot(host).mmc_data.built_in)
 		mmc->pm_flags = MMC_PM_KEEP_POWER | MMC_PM_IGNORE_PM_NOTIFY;
@@ -2564,7 +2790,7 @@ err_irq:
 	}
 err1:
 	if (host->adma_table != NULL)
-		dma_free_coherent(NULL, ADMA_TABLE_SZ,
+		dma_free_coherent(NULL, ADMA_TABLE_NUM * ADMA_TABLE_SZ,
 			host->adma_table, host->phy_adma_table);
 	iounmap(host->base);
 err_ioremap:
@@ -2595,7 +2821,7 @@ static int omap_hsmmc_remove(struct platform_device *pdev)
 		flush_work_sync(&host->mmc_carddetect_work);
 
 		if (host->adma_table != NULL)
-			dma_free_coherent(NULL, ADMA_TABLE_SZ,
+			dma_free_coherent(NULL, ADMA_TABLE_NUM * ADMA_TABLE_SZ,
 				host->adma_table, host->phy_adma_table);
 
 		mmc_host_disable(host->mmc);
@@ -2658,11 +2884,16 @@ static int omap_hsmmc_suspend(struct device *dev)
 			}
 			mmc_host_enable(host->mmc);
 			omap_hsmmc_disable_irq(host);
+			/* no card interrupt without bus power either */
+			OMAP_HSMMC_WRITE(host->base, ISE, 0);
+			OMAP_HSMMC_WRITE(host->base, IE, 0);
 			OMAP_HSMMC_WRITE(host->base, HCTL,
 				OMAP_HSMMC_READ(host->base, HCTL) & ~SDBP);
 			if (!mmc)
 				mmc_do_release_host(host->mmc);
 			mmc_host_disable(host->mmc);
+			if (host->sdio_irq_pm)
+				pm_runtime_put_sync(host->dev);
 
 			if (host->got_dbclk)
 				clk_disable(host->dbclk);
@@ -2695,11 +2926,15 @@ static int omap_hsmmc_resume(struct device *dev)
 		if (mmc_host_enable(host->mmc) != 0) {
 			goto clk_en_err;
 		}
+		if (host->sdio_irq_pm)
+			pm_runtime_get_sync(host->dev);
 
 		if (host->got_dbclk)
 			clk_enable(host->dbclk);
 
 		omap_hsmmc_conf_bus_power(host);
+		/* re-arms the card interrupt if ksdioirqd is waiting */
+		omap_hsmmc_disable_irq(host);
 
 		if (host->pdata->resume) {
 			ret = host->pdata->resume(&pdev->dev, host->slot_id);
@@ -62,6 +62,8 @@
 #define OMAP_HSMMC_AC12		0x013C
 #define OMAP_HSMMC_CAPA		0x0140
 #define OMAP_HSMMC_CUR_CAPA	0x0148
+#define OMAP_HSMMC_ADMA_ES	0x0154
+#define OMAP_HSMMC_ADMA_SAL	0x0158
 
 #define CM_FCLKEN1_CORE		0x48004A00
 #define CM_ICLKEN1_CORE		0x48004A10
@@ -99,6 +101,8 @@
 #define OMAP_HSMMC_AC12		0x023C
 #define OMAP_HSMMC_CAPA		0x0240
 #define OMAP_HSMMC_CUR_CAPA		0x0248
+#define OMAP_HSMMC_ADMA_ES		0x0254
+#define OMAP_HSMMC_ADMA_SAL		0x0258
 
 #define CM_L3INIT_CLKSTCTRL		0x4a009300
 #define OMAP4_HSMMC1_ICLK		(1 << 8)
@@ -166,6 +170,24 @@
 #define BWE			(1 << 10)
 #define BRE			(1 << 11)
 #define DLEV_0			(1 << 20)
+#define DMAS			(0x2 << 3)
+#define CAPA_ADMA_SUPPORT	(1 << 19)
+#define DMA_MNS_ADMA_MODE	(1 << 20)
+#define ADMA_ERR		(1 << 25)
+#define ADMA_XFER_VALID		(1 << 0)
+#define ADMA_XFER_END		(1 << 1)
+#define ADMA_XFER_DESC		(1 << 5)
+
+/*
+ * Multi-block writes of at least RAW_ADMA_MIN_LEN go through ADMA, in
+ * commands of up to RAW_ADMA_ENTRIES rows of 60KB (the length field is
+ * 16 bits).  The PIO path moves a word per register access, which takes
+ * minutes for a memory dump.
+ */
+#define RAW_ADMA_ENTRIES	64
+#define RAW_ADMA_MAX_PER_ROW	(60 * 1024)
+#define RAW_ADMA_MAX_BLOCKS	(RAW_ADMA_ENTRIES * RAW_ADMA_MAX_PER_ROW / 512)
+#define RAW_ADMA_MIN_LEN	(64 * 1024)
 
 /*
  * FIXME: Most likely all the data using these _DEVID defines should come
@@ -259,8 +281,18 @@ struct raw_mmc_data {
 	char			*buf;
 	unsigned int		len;
 	unsigned int		bytes_xfered;
+	unsigned int		use_adma;
 };
 
+struct raw_adma_desc {
+	u16 attr;
+	u16 length;
+	u32 addr;
+};
+
+/* preallocated, nothing can be allocated at panic time */
+static struct raw_adma_desc raw_adma_table[RAW_ADMA_ENTRIES] __aligned(32);
+
 struct raw_mmc_request {
 	struct mmc_command	*cmd;
 	struct raw_mmc_data	*data;
@@ -507,6 +539,8 @@ raw_omap_hsmmc_start_command(struct raw_omap_hsmmc_host *host,
 		/* switch to infinite mode if NBLK overflowed */
 		if (data->blocks > 0xFFFF)
 			cmdreg &= ~(BCE);
+		if (data->use_adma)
+			cmdreg |= DMA_EN;
 	}
 
 	DPRINTK(KERN_ERR "KPANIC-MMC: CMD%d, argument 0x%08x, data=%#x\n",
@@ -727,6 +761,84 @@ out:
 	return -1;
 }
 
+/*
+ * Point the controller to a descriptor table for data, which must be
+ * contiguous lowmem, word aligned and a whole number of blocks.
+ */
+static void raw_omap_hsmmc_setup_adma(struct raw_omap_hsmmc_host *host,
+				struct raw_mmc_data *data)
+{
+	dma_addr_t addr, table;
+	unsigned int off, n;
+	int i;
+
+	addr = dma_map_single(NULL, data->buf, data->len, DMA_TO_DEVICE);
+	for (i = 0, off = 0; off < data->len; i++, off += n) {
+		n = min_t(unsigned int, data->len - off, RAW_ADMA_MAX_PER_ROW);
+		raw_adma_table[i].addr = addr + off;
+		raw_adma_table[i].length = n;
+		raw_adma_table[i].attr = ADMA_XFER_DESC | ADMA_XFER_VALID;
+	}
+	raw_adma_table[i - 1].attr |= ADMA_XFER_END;
+	table = dma_map_single(NULL, raw_adma_table, sizeof(raw_adma_table),
+			DMA_TO_DEVICE);
+
+	OMAP_HSMMC_WRITE(host->base, ADMA_SAL, table);
+	OMAP_HSMMC_WRITE(host->base, HCTL,
+		OMAP_HSMMC_READ(host->base, HCTL) | DMAS);
+	OMAP_HSMMC_WRITE(host->base, CON,
+		OMAP_HSMMC_READ(host->base, CON) | DMA_MNS_ADMA_MODE);
+}
+
+/* back to PIO, which the rest of this driver expects */
+static void raw_omap_hsmmc_stop_adma(struct raw_omap_hsmmc_host *host)
+{
+	OMAP_HSMMC_WRITE(host->base, HCTL,
+		OMAP_HSMMC_READ(host->base, HCTL) & ~DMAS);
+	OMAP_HSMMC_WRITE(host->base, CON,
+		OMAP_HSMMC_READ(host->base, CON) & ~DMA_MNS_ADMA_MODE);
+}
+
+static int raw_omap_hsmmc_wait_adma(struct raw_omap_hsmmc_host *host,
+				struct raw_mmc_request *req)
+{
+	/* the TC timeout of a block, for each 512KB */
+	unsigned long count = MMC_TIMEOUT_COUNT * (req->data->blocks / 1024 + 1);
+	unsigned long timeout = 0;
+	int status = 0;
+
+	while (!(status & (TC | ERR)) && (timeout++ < count))
+		status = OMAP_HSMMC_READ(host->base, STAT);
+	if (!(status & (TC | ERR))) {
+		raw_omap_hsmmc_dump_regs(host->id);
+		printk(KERN_ERR "KPANIC-MMC: %s timeout on TC, status=%#x\n",
+			__func__, status);
+		goto out;
+	}
+
+	if (status & ERR) {
+		if (status & (DATA_TIMEOUT | DATA_CRC | ADMA_ERR))
+			raw_omap_hsmmc_reset_controller_fsm(host, SRD);
+		req->data->error = -status;
+		printk(KERN_ERR "KPANIC-MMC: ADMA write error, status=%#x, "
+			"ADMA_ES=%#x, SAL=%#x\n", status,
+			OMAP_HSMMC_READ(host->base, ADMA_ES),
+			OMAP_HSMMC_READ(host->base, ADMA_SAL));
+		goto out;
+	}
+	if (status & CARD_ERR)
+		printk(KERN_ERR "KPANIC-MMC: Ignoring card err CMD%d\n",
+			req->cmd->opcode);
+
+	req->data->bytes_xfered = req->data->len;
+	OMAP_HSMMC_WRITE(host->base, STAT, status);
+	OMAP_HSMMC_READ(host->base, STAT);
+
+	return 0;
+out:
+	return -1;
+}
+
 /*
  * Request function. for writing operation only
  * Data maybe not rounded up to block size before calling this function
@@ -738,6 +850,8 @@ static void raw_omap_hsmmc_request(struct raw_omap_hsmmc_host *host,
 
 	host->mrq = req;
 	omap_hsmmc_prepare_data(host, req);
+	if (req->data->use_adma)
+		raw_omap_hsmmc_setup_adma(host, req->data);
 
 	err = raw_omap_hsmmc_start_command(host, req->cmd, req->data);
 	if (err < 0) {
@@ -751,7 +865,9 @@ static void raw_omap_hsmmc_request(struct raw_omap_hsmmc_host *host,
 	if (!req->data)
 		goto out;
 
-	if (req->data->flags & MMC_DATA_WRITE)
+	if (req->data->use_adma)
+		err = raw_omap_hsmmc_wait_adma(host, req);
+	else if (req->data->flags & MMC_DATA_WRITE)
 		err = raw_omap_hsmmc_write_data(host, req);
 	else
 		err = raw_omap_hsmmc_read_data(host, req);
@@ -776,6 +892,8 @@ static void raw_omap_hsmmc_request(struct raw_omap_hsmmc_host *host,
 		}
 	}
 out:
+	if (req->data->use_adma)
+		raw_omap_hsmmc_stop_adma(host);
 	return;
 }
 
@@ -1676,39 +1794,22 @@ static void raw_mmc_power_up(struct raw_omap_hsmmc_host *host)
 	mdelay(10);
 }
 
-static int raw_mmc_write_mmc(char *buf, sector_t start_sect, sector_t nr_sects,
-			unsigned int offset, unsigned int len)
+/* one CMD25 of len bytes from buf at sector sect, padded to a block */
+static int raw_mmc_write_blocks(char *buf, sector_t sect, unsigned int len,
+			int use_adma)
 {
 	struct mmc_command	cmd;
 	struct raw_mmc_data	data;
 	struct mmc_command	stop;
 	struct raw_mmc_request	req;
 
-	DPRINTK(KERN_ERR "KPANIC-MMC: %s : start_sect=%u, nr_sects=%u, "
-		"offset=%u, len=%u\n", __func__, (unsigned int)start_sect,
-		(unsigned int)nr_sects, offset, len);
-	if (!len)
-		return 0;
-	if (offset + len > nr_sects * 512) {
-		printk(KERN_ERR "KPANIC-MMC: writing buf too long for "
-			"the partition\n");
-		return 0;
-	}
-	if (offset % 512 != 0) {
-		printk(KERN_ERR "KPANIC-MMC: writing offset not aligned to "
-			"sector size\n");
-		return 0;
-	}
-	/* truncate those bytes that are not aligned to word */
-	/* buffer not aligned to sector size is taken care of */
-
 	memset(&req, 0, sizeof(struct raw_mmc_request));
 	memset(&cmd, 0, sizeof(struct mmc_command));
 	memset(&stop, 0, sizeof(struct mmc_command));
 	memset(&data, 0, sizeof(struct raw_mmc_data));
 
 	cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
-	cmd.arg = start_sect + offset / 512;
+	cmd.arg = sect;
 	if (kpanic_host && !(kpanic_host->card.state & MMC_STATE_BLOCKADDR))
 		cmd.arg <<= 9;
 	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
@@ -1724,6 +1825,7 @@ static int raw_mmc_write_mmc(char *buf, sector_t start_sect, sector_t nr_sects,
 	data.timeout_ns = 300000000;
 	data.timeout_clks = 0;
 	data.flags |= MMC_DATA_WRITE;
+	data.use_adma = use_adma;
 
 	req.cmd = &cmd;
 	req.data = &data;
@@ -1735,9 +1837,61 @@ static int raw_mmc_write_mmc(char *buf, sector_t start_sect, sector_t nr_sects,
 		printk(KERN_ERR "KPANIC-MMC: done req with cmd->error=%#x,"
 			"data->error=%#x, stop->error=%#x\n", req.cmd->error,
 			req.data->error, req.stop->error);
+		return -1;
+	}
+	return 0;
+}
+
+static int raw_mmc_can_adma(struct raw_omap_hsmmc_host *host, char *buf,
+			unsigned int len)
+{
+	if (!host || len < RAW_ADMA_MIN_LEN || ((unsigned long)buf & 3))
+		return 0;
+	if (!virt_addr_valid(buf) || !virt_addr_valid(buf + len - 1))
 		return 0;
-	} else
-		return len;
+	return OMAP_HSMMC_READ(host->base, CAPA) & CAPA_ADMA_SUPPORT;
+}
+
+static int raw_mmc_write_mmc(char *buf, sector_t start_sect, sector_t nr_sects,
+			unsigned int offset, unsigned int len)
+{
+	sector_t sect = start_sect + offset / 512;
+	unsigned int done = 0, n;
+
+	DPRINTK(KERN_ERR "KPANIC-MMC: %s : start_sect=%u, nr_sects=%u, "
+		"offset=%u, len=%u\n", __func__, (unsigned int)start_sect,
+		(unsigned int)nr_sects, offset, len);
+	if (!len)
+		return 0;
+	if (offset + len > nr_sects * 512) {
+		printk(KERN_ERR "KPANIC-MMC: writing buf too long for "
+			"the partition\n");
+		return 0;
+	}
+	if (offset % 512 != 0) {
+		printk(KERN_ERR "KPANIC-MMC: writing offset not aligned to "
+			"sector size\n");
+		return 0;
+	}
+	/* truncate those bytes that are not aligned to word */
+	/* buffer not aligned to sector size is taken care of */
+
+	/* whole blocks by ADMA, the padded tail if any by PIO */
+	if (raw_mmc_can_adma(kpanic_host, buf, len)) {
+		while (len - done >= 512) {
+			n = min_t(unsigned int, (len - done) / 512,
+				  RAW_ADMA_MAX_BLOCKS) * 512;
+			if (raw_mmc_write_blocks(buf + done, sect + done / 512,
+						 n, 1))
+				return 0;
+			done += n;
+		}
+	}
+	if (done < len && raw_mmc_write_blocks(buf + done, sect + done / 512,
+					       len - done, 0))
+		return 0;
+
+	return len;
 }
 
 /*
@@ -134,70 +134,62 @@ static void wl1271_boot_fw_version(struct wl1271 *wl)
 	wl1271_parse_fw_ver(wl);
 }
 
+/*
+ * Upload one firmware section in transfers as large as the bus accepts
+ * (the aggregation buffer size, which is also the SPI limit), moving the
+ * download partition only once its whole window has been written. SDIO
+ * sends these as multi-block commands. A physically contiguous image is
+ * written as it is, otherwise the data goes through the aggregation
+ * buffer, which is idle while booting.
+ */
 static int wl1271_boot_upload_firmware_chunk(struct wl1271 *wl, void *buf,
 					     size_t fw_data_len, u32 dest)
 {
 	struct wl1271_partition_set partition;
-	int addr, chunk_num, partition_limit;
-	u8 *p, *chunk;
+	size_t offset, len, window, part_size;
+	u8 *p;
 
 	/* whal_FwCtrl_LoadFwImageSm() */
 
 	wl1271_debug(DEBUG_BOOT, "starting firmware upload");
 
-	wl1271_debug(DEBUG_BOOT, "fw_data_len %zd chunk_size %d",
-		     fw_data_len, CHUNK_SIZE);
+	wl1271_debug(DEBUG_BOOT, "fw_data_len %zd contiguous %d",
+		     fw_data_len, wl->fw_contig);
 
 	if ((fw_data_len % 4) != 0) {
 		wl1271_error("firmware length not multiple of four");
 		return -EIO;
 	}
 
-	chunk = kmalloc(CHUNK_SIZE, GFP_KERNEL);
-	if (!chunk) {
-		wl1271_error("allocation for firmware upload chunk failed");
-		return -ENOMEM;
-	}
-
 	memcpy(&partition, &part_table[PART_DOWN], sizeof(partition));
-	partition.mem.start = dest;
-	wl1271_set_partition(wl, &partition);
-
-	/* 10.1 set partition limit and chunk num */
-	chunk_num = 0;
-	partition_limit = part_table[PART_DOWN].mem.size;
-
-	while (chunk_num < fw_data_len / CHUNK_SIZE) {
-		/* 10.2 update partition, if needed */
-		addr = dest + (chunk_num + 2) * CHUNK_SIZE;
-		if (addr > partition_limit) {
-			addr = dest + chunk_num * CHUNK_SIZE;
-			partition_limit = chunk_num * CHUNK_SIZE +
-				part_table[PART_DOWN].mem.size;
-			partition.mem.start = addr;
-			wl1271_set_partition(wl, &partition);
-		}
+	part_size = part_table[PART_DOWN].mem.size;
 
-		/* 10.3 upload the chunk */
-		addr = dest + chunk_num * CHUNK_SIZE;
-		p = buf + chunk_num * CHUNK_SIZE;
-		memcpy(chunk, p, CHUNK_SIZE);
-		wl1271_debug(DEBUG_BOOT, "uploading fw chunk 0x%p to 0x%x",
-			     p, addr);
-		wl1271_write(wl, addr, chunk, CHUNK_SIZE, false);
+	offset = 0;
+	while (offset < fw_data_len) {
+		/* move the partition window to the next part of the section */
+		window = min(fw_data_len - offset, part_size);
+		partition.mem.start = dest + offset;
+		wl1271_set_partition(wl, &partition);
 
-		chunk_num++;
-	}
+		while (window) {
+			p = buf + offset;
+			len = min_t(size_t, window, WL1271_AGGR_BUFFER_SIZE);
+
+			if (!wl->fw_contig) {
+				memcpy(wl->aggr_buf, p, len);
+				p = wl->aggr_buf;
+			}
+
+			wl1271_debug(DEBUG_BOOT,
+				     "uploading fw chunk (%zd B) to 0x%zx",
+				     len, dest + offset);
+			wl1271_write(wl, dest + offset, p, len, false);
 
-	/* 10.4 upload the last chunk */
-	addr = dest + chunk_num * CHUNK_SIZE;
-	p = buf + chunk_num * CHUNK_SIZE;
-	memcpy(chunk, p, fw_data_len % CHUNK_SIZE);
-	wl1271_debug(DEBUG_BOOT, "uploading fw last chunk (%zd B) 0x%p to 0x%x",
-		     fw_data_len % CHUNK_SIZE, p, addr);
-	wl1271_write(wl, addr, chunk, fw_data_len % CHUNK_SIZE, false);
+			offset += len;
+			window -= len;
+		}
+	}
 
-	kfree(chunk);
 	return 0;
 }
 
@@ -1026,6 +1026,18 @@ struct conf_conn_settings {
 	 * Range: u16
 	 */
 	u8 max_listen_interval;
+
+	/*
+	 * Delay before the chip is put into ELP once the host is done with
+	 * it, in ms.  While the chip is in use at intervals shorter than
+	 * dynamic_elp_max, it is kept awake for one and a half times the
+	 * average interval instead, so the next use doesn't wait for the
+	 * wakeup.  Setting dynamic_elp_max to 0 always uses the minimum.
+	 *
+	 * Range: u16
+	 */
+	u16 dynamic_elp_min;
+	u16 dynamic_elp_max;
 };
 
 enum {
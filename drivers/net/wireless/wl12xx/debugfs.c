@@ -397,6 +397,66 @@ static const struct file_operations driver_state_ops = {
 	.llseek = default_llseek,
 };
 
+static const char * const host_stats_names[WL12XX_HIST_NR] = {
+	[WL12XX_HIST_READ_BYTES]	= "read_bytes",
+	[WL12XX_HIST_READ_US]		= "read_us",
+	[WL12XX_HIST_WRITE_BYTES]	= "write_bytes",
+	[WL12XX_HIST_WRITE_US]		= "write_us",
+	[WL12XX_HIST_IRQ_RX_US]		= "irq_to_rx_us",
+	[WL12XX_HIST_TX_QUEUE_US]	= "tx_queue_us",
+	[WL12XX_HIST_ELP_WAKEUP_US]	= "elp_wakeup_us",
+};
+
+/*
+ * One line per histogram: the name, then the counts of the log2
+ * buckets (0, 1, 2-3, 4-7, ...).  Writing anything clears them.
+ */
+static ssize_t host_stats_read(struct file *file, char __user *user_buf,
+			       size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	ssize_t ret;
+	char *buf;
+	int res = 0;
+	int i, j;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	for (i = 0; i < WL12XX_HIST_NR; i++) {
+		res += scnprintf(buf + res, PAGE_SIZE - res, "%-14s",
+				 host_stats_names[i]);
+		for (j = 0; j < WL12XX_HIST_BUCKETS; j++)
+			res += scnprintf(buf + res, PAGE_SIZE - res, " %u",
+					 wl->stats.hist[i].count[j]);
+		res += scnprintf(buf + res, PAGE_SIZE - res, "\n");
+	}
+
+	ret = simple_read_from_buffer(user_buf, count, ppos, buf, res);
+	kfree(buf);
+
+	return ret;
+}
+
+static ssize_t host_stats_write(struct file *file,
+				const char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+
+	memset(wl->stats.hist, 0, sizeof(wl->stats.hist));
+
+	return count;
+}
+
+static const struct file_operations host_stats_ops = {
+	.read = host_stats_read,
+	.write = host_stats_write,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
 static ssize_t dtim_interval_read(struct file *file, char __user *user_buf,
 				  size_t count, loff_t *ppos)
 {
@@ -639,6 +699,7 @@ static int wl1271_debugfs_add_files(struct wl1271 *wl,
 	DEBUGFS_ADD(driver_state, rootdir);
 	DEBUGFS_ADD(dtim_interval, rootdir);
 	DEBUGFS_ADD(beacon_interval, rootdir);
+	DEBUGFS_ADD(host_stats, rootdir);
 
 	return 0;
 
@@ -56,17 +56,43 @@ static inline struct device *wl1271_wl_to_dev(struct wl1271 *wl)
 }
 
 
+static inline void wl12xx_hist_add(struct wl1271 *wl, enum wl12xx_hist_id id,
+				   u32 val)
+{
+	int bucket = min(fls(val), WL12XX_HIST_BUCKETS - 1);
+
+	wl->stats.hist[id].count[bucket]++;
+}
+
+static inline void wl12xx_hist_add_us(struct wl1271 *wl,
+				      enum wl12xx_hist_id id, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	wl12xx_hist_add(wl, id, us > 0 ? (u32)min_t(s64, us, UINT_MAX) : 0);
+}
+
 /* Raw target IO, address is not translated */
 static inline void wl1271_raw_write(struct wl1271 *wl, int addr, void *buf,
 				    size_t len, bool fixed)
 {
+	ktime_t start = ktime_get();
+
 	wl->if_ops->write(wl, addr, buf, len, fixed);
+
+	wl12xx_hist_add_us(wl, WL12XX_HIST_WRITE_US, start);
+	wl12xx_hist_add(wl, WL12XX_HIST_WRITE_BYTES, len);
 }
 
 static inline void wl1271_raw_read(struct wl1271 *wl, int addr, void *buf,
 				   size_t len, bool fixed)
 {
+	ktime_t start = ktime_get();
+
 	wl->if_ops->read(wl, addr, buf, len, fixed);
+
+	wl12xx_hist_add_us(wl, WL12XX_HIST_READ_US, start);
+	wl12xx_hist_add(wl, WL12XX_HIST_READ_BYTES, len);
 }
 
 static inline u32 wl1271_raw_read32(struct wl1271 *wl, int addr)
@@ -169,6 +195,7 @@ int wl1271_init_ieee80211(struct wl1271 *wl);
 struct ieee80211_hw *wl1271_alloc_hw(void);
 int wl1271_free_hw(struct wl1271 *wl);
 irqreturn_t wl1271_irq(int irq, void *data);
+void wl1271_irq_locked(struct wl1271 *wl);
 bool wl1271_set_block_size(struct wl1271 *wl);
 int wl1271_tx_dummy_packet(struct wl1271 *wl);
 void wl1271_configure_filters(struct wl1271 *wl, unsigned int filters);
@@ -283,6 +283,8 @@ static struct conf_drv_settings default_conf = {
 		.psm_entry_hangover_period   = 1,
 		.keep_alive_interval         = 55000,
 		.max_listen_interval         = 20,
+		.dynamic_elp_min             = 5,
+		.dynamic_elp_max             = 50,
 	},
 	.itrim = {
 		.enable = false,
@@ -731,44 +733,78 @@ static void wl1271_fw_status(struct wl1271 *wl,
 		(s64)le32_to_cpu(status->fw_localtime);
 }
 
-static void wl1271_flush_deferred_work(struct wl1271 *wl)
+static void wl1271_flush_deferred_tx(struct wl1271 *wl)
 {
 	struct sk_buff *skb;
 
-	/* Pass all received frames to the network stack */
-	while ((skb = skb_dequeue(&wl->deferred_rx_queue)))
-		ieee80211_rx_ni(wl->hw, skb);
-
 	/* Return sent skbs to the network stack */
 	while ((skb = skb_dequeue(&wl->deferred_tx_queue)))
 		ieee80211_tx_status(wl->hw, skb);
 }
 
+static void wl1271_flush_deferred_work(struct wl1271 *wl)
+{
+	/*
+	 * Received frames only go up from the NAPI poll, which mac80211
+	 * relies on to serialize them; the interface is going down here,
+	 * so whatever is still queued is dropped.
+	 */
+	skb_queue_purge(&wl->deferred_rx_queue);
+
+	wl1271_flush_deferred_tx(wl);
+}
+
 static void wl1271_netstack_work(struct work_struct *work)
 {
 	struct wl1271 *wl =
 		container_of(work, struct wl1271, netstack_work);
 
 	do {
-		wl1271_flush_deferred_work(wl);
-	} while (skb_queue_len(&wl->deferred_rx_queue));
+		wl1271_flush_deferred_tx(wl);
+	} while (skb_queue_len(&wl->deferred_tx_queue));
+}
+
+/* Received frames are passed on from here, in softirq context */
+static int wl1271_op_napi_poll(struct ieee80211_hw *hw, int budget)
+{
+	struct wl1271 *wl = hw->priv;
+	struct sk_buff *skb;
+	int done = 0;
+
+	while (done < budget &&
+	       (skb = skb_dequeue(&wl->deferred_rx_queue))) {
+		ieee80211_rx(hw, skb);
+		done++;
+	}
+
+	if (done < budget) {
+		ieee80211_napi_complete(hw);
+
+		/* don't strand frames queued since the last dequeue */
+		if (!skb_queue_empty(&wl->deferred_rx_queue))
+			ieee80211_napi_schedule(hw);
+	}
+
+	return done;
 }
 
 #define WL1271_IRQ_MAX_LOOPS 256
 
-irqreturn_t wl1271_irq(int irq, void *cookie)
+/*
+ * Called with wl->mutex held: from wl1271_irq(), or straight from the
+ * SDIO interrupt handler, which already has the bus claimed.
+ */
+void wl1271_irq_locked(struct wl1271 *wl)
 {
 	int ret;
 	u32 intr;
 	int loopcount = WL1271_IRQ_MAX_LOOPS;
-	struct wl1271 *wl = (struct wl1271 *)cookie;
 	bool done = false;
 	unsigned int defer_count;
 	unsigned long flags;
 
 	/* TX might be handled here, avoid redundant work */
 	set_bit(WL1271_FLAG_TX_PENDING, &wl->flags);
-	cancel_work_sync(&wl->tx_work);
 
 	/*
 	 * In case edge triggered interrupt must be used, we cannot iterate
@@ -777,8 +813,6 @@ irqreturn_t wl1271_irq(int irq, void *cookie)
 	if (wl->platform_quirks & WL12XX_PLATFORM_QUIRK_EDGE_IRQ)
 		loopcount = 1;
 
-	mutex_lock(&wl->mutex);
-
 	wl1271_debug(DEBUG_IRQ, "IRQ work");
 
 	if (unlikely(wl->state == WL1271_STATE_OFF))
@@ -817,6 +851,14 @@ irqreturn_t wl1271_irq(int irq, void *cookie)
 		if (likely(intr & WL1271_ACX_INTR_DATA)) {
 			wl1271_debug(DEBUG_IRQ, "WL1271_ACX_INTR_DATA");
 
+			spin_lock_irqsave(&wl->wl_lock, flags);
+			if (wl->stats.irq_time.tv64) {
+				wl12xx_hist_add_us(wl, WL12XX_HIST_IRQ_RX_US,
+						   wl->stats.irq_time);
+				wl->stats.irq_time.tv64 = 0;
+			}
+			spin_unlock_irqrestore(&wl->wl_lock, flags);
+
 			wl1271_rx(wl, &wl->fw_status->common);
 
 			/* Check if any tx blocks were freed */
@@ -838,11 +880,13 @@ irqreturn_t wl1271_irq(int irq, void *cookie)
 			    (wl->tx_results_count & 0xff))
 				wl1271_tx_complete(wl);
 
-			/* Make sure the deferred queues don't get too long */
-			defer_count = skb_queue_len(&wl->deferred_tx_queue) +
-				      skb_queue_len(&wl->deferred_rx_queue);
+			/*
+			 * Make sure the deferred tx queue doesn't get too
+			 * long, the rx one is drained by NAPI
+			 */
+			defer_count = skb_queue_len(&wl->deferred_tx_queue);
 			if (defer_count > WL1271_DEFERRED_QUEUE_LIMIT)
-				wl1271_flush_deferred_work(wl);
+				wl1271_flush_deferred_tx(wl);
 		}
 
 		if (intr & WL1271_ACX_INTR_EVENT_A) {
@@ -867,21 +911,66 @@ irqreturn_t wl1271_irq(int irq, void *cookie)
 
 out:
 	spin_lock_irqsave(&wl->wl_lock, flags);
+	/* an interrupt without RX data doesn't count */
+	wl->stats.irq_time.tv64 = 0;
 	/* In case TX was not handled here, queue TX work */
 	clear_bit(WL1271_FLAG_TX_PENDING, &wl->flags);
 	if (!test_bit(WL1271_FLAG_FW_TX_BUSY, &wl->flags) &&
 	    wl->tx_queue_count)
 		ieee80211_queue_work(wl->hw, &wl->tx_work);
 	spin_unlock_irqrestore(&wl->wl_lock, flags);
+}
+EXPORT_SYMBOL_GPL(wl1271_irq_locked);
+
+irqreturn_t wl1271_irq(int irq, void *cookie)
+{
+	struct wl1271 *wl = (struct wl1271 *)cookie;
+
+	/* TX might be handled here, avoid redundant work */
+	set_bit(WL1271_FLAG_TX_PENDING, &wl->flags);
+	cancel_work_sync(&wl->tx_work);
 
+	mutex_lock(&wl->mutex);
+	wl1271_irq_locked(wl);
 	mutex_unlock(&wl->mutex);
 
 	return IRQ_HANDLED;
 }
 EXPORT_SYMBOL_GPL(wl1271_irq);
 
+/*
+ * The image is kept in physically contiguous memory when possible so that
+ * the boot code can hand it to the bus directly instead of copying it
+ * through a bounce buffer. Don't try too hard, vmalloc works as well.
+ */
+static u8 *wl12xx_alloc_fw(size_t len, bool *contig)
+{
+	u8 *buf;
+
+	buf = alloc_pages_exact(len, GFP_KERNEL | __GFP_NOWARN |
+				__GFP_NORETRY);
+	*contig = buf != NULL;
+	if (!buf)
+		buf = vmalloc(len);
+
+	return buf;
+}
+
+static void wl12xx_free_fw(struct wl12xx_fw_image *image)
+{
+	if (image->contig)
+		free_pages_exact(image->data, image->len);
+	else
+		vfree(image->data);
+
+	image->data = NULL;
+	image->len = 0;
+	image->contig = false;
+}
+
 static int wl1271_fetch_firmware(struct wl1271 *wl)
 {
+	struct wl12xx_fw_image *image;
 	const struct firmware *fw;
 	const char *fw_name;
 	int ret;
@@ -892,6 +981,7 @@ static int wl1271_fetch_firmware(struct wl1271 *wl)
 			fw_name = WL128X_AP_FW_NAME;
 		else
 			fw_name = WL127X_AP_FW_NAME;
+		image = &wl->fw_cache[WL12XX_FW_TYPE_AP];
 		break;
 	case BSS_TYPE_IBSS:
 	case BSS_TYPE_STA_BSS:
@@ -899,6 +989,7 @@ static int wl1271_fetch_firmware(struct wl1271 *wl)
 			fw_name = WL128X_FW_NAME;
 		else
 			fw_name	= WL1271_FW_NAME;
+		image = &wl->fw_cache[WL12XX_FW_TYPE_STA];
 		break;
 	default:
 		wl1271_error("no compatible firmware for bss_type %d",
@@ -906,6 +997,12 @@ static int wl1271_fetch_firmware(struct wl1271 *wl)
 		return -EINVAL;
 	}
 
+	if (image->data) {
+		wl1271_debug(DEBUG_BOOT, "booting cached firmware %s",
+			     fw_name);
+		goto out_set;
+	}
+
 	wl1271_debug(DEBUG_BOOT, "booting firmware %s", fw_name);
 
 	ret = request_firmware(&fw, fw_name, wl1271_wl_to_dev(wl));
@@ -922,19 +1019,24 @@ static int wl1271_fetch_firmware(struct wl1271 *wl)
 		goto out;
 	}
 
-	vfree(wl->fw);
-	wl->fw_len = fw->size;
-	wl->fw = vmalloc(wl->fw_len);
+	image->data = wl12xx_alloc_fw(fw->size, &image->contig);
 
-	if (!wl->fw) {
+	if (!image->data) {
 		wl1271_error("could not allocate memory for the firmware");
 		ret = -ENOMEM;
 		goto out;
 	}
 
-	memcpy(wl->fw, fw->data, wl->fw_len);
+	image->len = fw->size;
+	memcpy(image->data, fw->data, image->len);
+	release_firmware(fw);
+
+out_set:
+	wl->fw = image->data;
+	wl->fw_len = image->len;
+	wl->fw_contig = image->contig;
 	wl->fw_bss_type = wl->bss_type;
-	ret = 0;
+	return 0;
 
 out:
 	release_firmware(fw);
@@ -1264,6 +1366,9 @@ static void wl1271_op_tx(struct ieee80211_hw *hw, struct sk_buff *skb)
 		set_bit(WL1271_FLAG_TX_QUEUE_STOPPED, &wl->flags);
 	}
 
+	/* for the queue residence histogram */
+	skb->tstamp = ktime_get();
+
 	/* queue the packet */
 	if (wl->bss_type == BSS_TYPE_AP_BSS) {
 		wl1271_debug(DEBUG_TX, "queue skb hlid %d q %d", hlid, q);
@@ -3675,6 +3780,7 @@ static const struct ieee80211_ops wl1271_ops = {
 	.sta_remove = wl1271_op_sta_remove,
 	.ampdu_action = wl1271_op_ampdu_action,
 	.tx_frames_pending = wl1271_tx_frames_pending,
+	.napi_poll = wl1271_op_napi_poll,
 	CFG80211_TESTMODE_CMD(wl1271_tm_cmd)
 };
 
@@ -3900,6 +4006,7 @@ int wl1271_init_ieee80211(struct wl1271 *wl)
 
 	wl->hw->queues = 4;
 	wl->hw->max_rates = 1;
+	wl->hw->napi_weight = WL1271_NAPI_WEIGHT;
 
 	wl->hw->wiphy->reg_notifier = wl1271_reg_notify;
 
@@ -4063,6 +4170,8 @@ EXPORT_SYMBOL_GPL(wl1271_alloc_hw);
 
 int wl1271_free_hw(struct wl1271 *wl)
 {
+	int i;
+
 	platform_device_unregister(wl->plat_dev);
 	dev_kfree_skb(wl->dummy_packet);
 	free_pages((unsigned long)wl->aggr_buf,
@@ -4071,7 +4180,8 @@ int wl1271_free_hw(struct wl1271 *wl)
 
 	wl1271_debugfs_exit(wl);
 
-	vfree(wl->fw);
+	for (i = 0; i < WL12XX_FW_TYPES; i++)
+		wl12xx_free_fw(&wl->fw_cache[i]);
 	wl->fw = NULL;
 	kfree(wl->nvs);
 	wl->nvs = NULL;
@@ -60,21 +60,56 @@ out:
 	mutex_unlock(&wl->mutex);
 }
 
-#define ELP_ENTRY_DELAY  5
+/*
+ * How long to keep the chip awake after the host is done with it.  The
+ * intervals between the host's uses (frames in and out, commands) are
+ * averaged.  While they are short, the chip stays up through the next
+ * expected one rather than being woken for it; once traffic is sparse
+ * it goes to ELP after the minimum delay.
+ */
+static unsigned long wl1271_ps_elp_delay(struct wl1271 *wl)
+{
+	struct conf_conn_settings *conf = &wl->conf.conn;
+	u32 max_us = conf->dynamic_elp_max * USEC_PER_MSEC;
+	u32 delay_us;
+	ktime_t now = ktime_get();
+	s64 gap;
+
+	gap = ktime_us_delta(now, wl->elp_last_request);
+	wl->elp_last_request = now;
+
+	if (!max_us)
+		return msecs_to_jiffies(conf->dynamic_elp_min);
+
+	/* a long idle period shouldn't take forever to average out */
+	if (gap < 0 || gap > 4 * max_us)
+		gap = 4 * max_us;
+	wl->elp_avg_gap_us = (wl->elp_avg_gap_us * 3 + (u32)gap) / 4;
+
+	delay_us = wl->elp_avg_gap_us + wl->elp_avg_gap_us / 2;
+	if (delay_us > max_us)
+		delay_us = 0;
+
+	delay_us = max_t(u32, delay_us, conf->dynamic_elp_min * USEC_PER_MSEC);
+	return usecs_to_jiffies(delay_us);
+}
 
 /* Routines to toggle sleep mode while in ELP */
 void wl1271_ps_elp_sleep(struct wl1271 *wl)
 {
+	unsigned long delay;
+
 	/* we shouldn't get consecutive sleep requests */
 	if (WARN_ON(test_and_set_bit(WL1271_FLAG_ELP_REQUESTED, &wl->flags)))
 		return;
 
+	delay = wl1271_ps_elp_delay(wl);
+
 	if (!test_bit(WL1271_FLAG_PSM, &wl->flags) &&
 	    !test_bit(WL1271_FLAG_IDLE, &wl->flags))
 		return;
 
-	ieee80211_queue_delayed_work(wl->hw, &wl->elp_work,
-				     msecs_to_jiffies(ELP_ENTRY_DELAY));
+	ieee80211_queue_delayed_work(wl->hw, &wl->elp_work, delay);
 }
 
 int wl1271_ps_elp_wakeup(struct wl1271 *wl)
@@ -83,6 +118,7 @@ int wl1271_ps_elp_wakeup(struct wl1271 *wl)
 	unsigned long flags;
 	int ret;
 	u32 start_time = jiffies;
+	ktime_t start;
 	bool pending = false;
 
 	/*
@@ -111,6 +147,7 @@ int wl1271_ps_elp_wakeup(struct wl1271 *wl)
 		wl->elp_compl = &compl;
 	spin_unlock_irqrestore(&wl->wl_lock, flags);
 
+	start = ktime_get();
 	wl1271_raw_write32(wl, HW_ACCESS_ELP_CTRL_REG_ADDR, ELPCTRL_WAKE_UP);
 
 	if (!pending) {
@@ -129,6 +166,8 @@ int wl1271_ps_elp_wakeup(struct wl1271 *wl)
 
 	clear_bit(WL1271_FLAG_IN_ELP, &wl->flags);
 
+	wl12xx_hist_add_us(wl, WL12XX_HIST_ELP_WAKEUP_US, start);
+
 	wl1271_debug(DEBUG_PSM, "wakeup time: %u ms",
 		     jiffies_to_msecs(jiffies - start_time));
 	goto out;
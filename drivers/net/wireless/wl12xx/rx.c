@@ -43,6 +43,28 @@ static u32 wl1271_rx_get_buf_size(struct wl1271_fw_common_status *status,
 		RX_BUF_SIZE_MASK) >> RX_BUF_SIZE_SHIFT_DIV;
 }
 
+/*
+ * Bytes taken by the frames from drv_rx_counter on which fit into max,
+ * all of them read in one go.
+ */
+static u32 wl1271_rx_aggr_size(struct wl1271_fw_common_status *status,
+			       u32 drv_rx_counter, u32 fw_rx_counter, u32 max)
+{
+	u32 buf_size = 0;
+	u32 pkt_length;
+
+	while (drv_rx_counter != fw_rx_counter) {
+		pkt_length = wl1271_rx_get_buf_size(status, drv_rx_counter);
+		if (buf_size + pkt_length > max)
+			break;
+		buf_size += pkt_length;
+		drv_rx_counter++;
+		drv_rx_counter &= NUM_RX_PKT_DESC_MOD_MASK;
+	}
+
+	return buf_size;
+}
+
 static void wl1271_rx_status(struct wl1271 *wl,
 			     struct wl1271_rx_descriptor *desc,
 			     struct ieee80211_rx_status *status,
@@ -88,7 +110,54 @@ static void wl1271_rx_status(struct wl1271 *wl,
 	}
 }
 
-static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length)
+/*
+ * Bytes of each frame copied into the skb head when receiving into pages:
+ * the descriptor and the 802.11 and LLC headers, which mac80211 parses
+ * from the linear part.  The payload stays in the pages.
+ */
+#define WL1271_RX_COPY_LEN	128
+
+/*
+ * Build an skb for the frame at offset in the aggregation pages: the
+ * headers are copied, the rest is attached by reference as page frags.
+ */
+static struct sk_buff *wl1271_rx_frag_skb(struct page **pages, u32 offset,
+					  u32 length)
+{
+	struct sk_buff *skb;
+	u32 copy = min_t(u32, length, WL1271_RX_COPY_LEN);
+
+	skb = __dev_alloc_skb(copy, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	memcpy(skb_put(skb, copy),
+	       page_address(pages[0]) + offset, copy);
+	offset += copy;
+	length -= copy;
+
+	while (length) {
+		struct page *page = pages[offset >> PAGE_SHIFT];
+		u32 off = offset & ~PAGE_MASK;
+		u32 size = min_t(u32, length, PAGE_SIZE - off);
+
+		if (skb_shinfo(skb)->nr_frags == MAX_SKB_FRAGS) {
+			dev_kfree_skb(skb);
+			return NULL;
+		}
+
+		get_page(page);
+		skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, page,
+				off, size);
+		offset += size;
+		length -= size;
+	}
+
+	return skb;
+}
+
+static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length,
+				 struct page **pages, u32 offset)
 {
 	struct wl1271_rx_descriptor *desc;
 	struct sk_buff *skb;
@@ -122,15 +191,25 @@ static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length)
 		return -EINVAL;
 	}
 
-	skb = __dev_alloc_skb(length, GFP_KERNEL);
+	if (unlikely(length < sizeof(*desc) + desc->pad_len)) {
+		wl1271_warning("short RX frame: %u B", length);
+		return -EINVAL;
+	}
+
+	if (pages) {
+		skb = wl1271_rx_frag_skb(pages, offset, length);
+	} else {
+		skb = __dev_alloc_skb(length, GFP_KERNEL);
+		if (skb) {
+			buf = skb_put(skb, length);
+			memcpy(buf, data, length);
+		}
+	}
 	if (!skb) {
 		wl1271_error("Couldn't allocate RX frame");
 		return -ENOMEM;
 	}
 
-	buf = skb_put(skb, length);
-	memcpy(buf, data, length);
-
 	/* now we pull the descriptor out of the buffer */
 	skb_pull(skb, sizeof(*desc));
 
@@ -144,10 +223,12 @@ static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length)
 		     skb->len - desc->pad_len,
 		     beacon ? "beacon" : "");
 
-	skb_trim(skb, skb->len - desc->pad_len);
+	if (pskb_trim(skb, skb->len - desc->pad_len)) {
+		dev_kfree_skb(skb);
+		return -ENOMEM;
+	}
 
 	skb_queue_tail(&wl->deferred_rx_queue, skb);
-	ieee80211_queue_work(wl->hw, &wl->netstack_work);
 
 	return 0;
 }
@@ -158,28 +239,49 @@ void wl1271_rx(struct wl1271 *wl, struct wl1271_fw_common_status *status)
 	u32 buf_size;
 	u32 fw_rx_counter  = status->fw_rx_counter & NUM_RX_PKT_DESC_MOD_MASK;
 	u32 drv_rx_counter = wl->rx_counter & NUM_RX_PKT_DESC_MOD_MASK;
-	u32 rx_counter;
 	u32 mem_block;
 	u32 pkt_length;
 	u32 pkt_offset;
+	struct page *pages[WL1271_RX_AGGR_MAX_PAGES];
+	struct page *page;
+	u8 *buf;
+	int order, i;
 
 	while (drv_rx_counter != fw_rx_counter) {
-		buf_size = 0;
-		rx_counter = drv_rx_counter;
-		while (rx_counter != fw_rx_counter) {
-			pkt_length = wl1271_rx_get_buf_size(status, rx_counter);
-			if (buf_size + pkt_length > WL1271_AGGR_BUFFER_SIZE)
-				break;
-			buf_size += pkt_length;
-			rx_counter++;
-			rx_counter &= NUM_RX_PKT_DESC_MOD_MASK;
-		}
-
+		buf_size = wl1271_rx_aggr_size(status, drv_rx_counter,
+					       fw_rx_counter,
+					       WL1271_RX_AGGR_MAX_SIZE);
 		if (buf_size == 0) {
 			wl1271_warning("received empty data");
 			break;
 		}
 
+		/*
+		 * Read into pages the frames can keep by reference.  The
+		 * allocation is split so that each page is freed as soon as
+		 * the last frame in it is.  This runs in the IRQ thread, so
+		 * don't reclaim or compact for it: without memory at hand,
+		 * fall back to copying out of the preallocated buffer.
+		 */
+		order = get_order(buf_size);
+		page = alloc_pages(GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN,
+				   order);
+		if (page) {
+			split_page(page, order);
+			for (i = 0; i < (1 << order); i++)
+				pages[i] = page + i;
+			buf = page_address(page);
+		} else {
+			buf_size = wl1271_rx_aggr_size(status, drv_rx_counter,
+						       fw_rx_counter,
+						       WL1271_AGGR_BUFFER_SIZE);
+			if (buf_size == 0) {
+				wl1271_warning("received empty data");
+				break;
+			}
+			buf = wl->aggr_buf;
+		}
+
 		if (wl->chip.id != CHIP_ID_1283_PG20) {
 			/*
 			 * Choose the block we want to read
@@ -201,8 +303,7 @@ void wl1271_rx(struct wl1271 *wl, struct wl1271_fw_common_status *status)
 		}
 
 		/* Read all available packets at once */
-		wl1271_read(wl, WL1271_SLV_MEM_DATA, wl->aggr_buf,
-				buf_size, true);
+		wl1271_read(wl, WL1271_SLV_MEM_DATA, buf, buf_size, true);
 
 		/* Split data into separate packets */
 		pkt_offset = 0;
@@ -214,14 +315,26 @@ void wl1271_rx(struct wl1271 *wl, struct wl1271_fw_common_status *status)
 			 * conditions, in that case the received frame will just
 			 * be dropped.
 			 */
-			wl1271_rx_handle_data(wl,
-					      wl->aggr_buf + pkt_offset,
-					      pkt_length);
+			wl1271_rx_handle_data(wl, buf + pkt_offset, pkt_length,
+					      page ? pages : NULL, pkt_offset);
 			wl->rx_counter++;
 			drv_rx_counter++;
 			drv_rx_counter &= NUM_RX_PKT_DESC_MOD_MASK;
 			pkt_offset += pkt_length;
 		}
+
+		/* the frames hold their own references */
+		if (page)
+			for (i = 0; i < (1 << order); i++)
+				put_page(pages[i]);
+
+		/*
+		 * Deliver the aggregate from NAPI context, as one batch that
+		 * GRO can merge.  The poll runs as soon as BHs are enabled.
+		 */
+		local_bh_disable();
+		ieee80211_napi_schedule(wl->hw);
+		local_bh_enable();
 	}
 
 	/*
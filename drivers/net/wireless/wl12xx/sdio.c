@@ -25,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/crc7.h>
 #include <linux/vmalloc.h>
+#include <linux/mmc/sdio.h>
 #include <linux/mmc/sdio_func.h>
 #include <linux/mmc/sdio_ids.h>
 #include <linux/mmc/card.h>
@@ -77,6 +78,8 @@ static irqreturn_t wl1271_hardirq(int irq, void *cookie)
 
 	/* complete the ELP completion */
 	spin_lock_irqsave(&wl->wl_lock, flags);
+	if (!wl->stats.irq_time.tv64)
+		wl->stats.irq_time = ktime_get();
 	set_bit(WL1271_FLAG_IRQ_RUNNING, &wl->flags);
 	if (wl->elp_compl) {
 		complete(wl->elp_compl);
@@ -87,7 +90,8 @@ static irqreturn_t wl1271_hardirq(int irq, void *cookie)
 		/* don't enqueue a work right now. mark it as pending */
 		set_bit(WL1271_FLAG_PENDING_WORK, &wl->flags);
 		wl1271_debug(DEBUG_IRQ, "should not enqueue work");
-		disable_irq_nosync(wl->irq);
+		if (wl->irq)
+			disable_irq_nosync(wl->irq);
 		pm_wakeup_event(wl1271_sdio_wl_to_dev(wl), 0);
 		spin_unlock_irqrestore(&wl->wl_lock, flags);
 		return IRQ_HANDLED;
@@ -97,14 +101,121 @@ static irqreturn_t wl1271_hardirq(int irq, void *cookie)
 	return IRQ_WAKE_THREAD;
 }
 
+/*
+ * Without a WLAN_IRQ line (platform irq 0) the chip interrupts in band,
+ * through the SDIO host, and ksdioirqd calls wl1271_sdio_irq() with the
+ * host claimed.  The host then cannot stay claimed for as long as the chip
+ * is powered, so every bus access claims it instead.
+ */
+static inline bool wl1271_sdio_in_band(struct wl1271 *wl)
+{
+	return !wl->irq;
+}
+
+static void wl1271_sdio_claim(struct wl1271 *wl)
+{
+	if (wl1271_sdio_in_band(wl))
+		sdio_claim_host(wl_to_func(wl));
+}
+
+static void wl1271_sdio_release(struct wl1271 *wl)
+{
+	if (wl1271_sdio_in_band(wl))
+		sdio_release_host(wl_to_func(wl));
+}
+
+/* Gate the function interrupt at the card, with the host claimed */
+static void wl1271_sdio_mask_irq(struct sdio_func *func, bool mask)
+{
+	u8 ien;
+	int ret;
+
+	ien = sdio_f0_readb(func, SDIO_CCCR_IENx, &ret);
+	if (ret)
+		goto out;
+
+	if (mask)
+		ien &= ~(1 << func->num);
+	else
+		ien |= (1 << func->num) | 1;
+
+	sdio_f0_writeb(func, ien, SDIO_CCCR_IENx, &ret);
+out:
+	if (ret)
+		wl1271_error("sdio irq %s failed (%d)",
+			     mask ? "mask" : "unmask", ret);
+}
+
+static void wl1271_sdio_irq(struct sdio_func *func)
+{
+	struct wl1271 *wl = sdio_get_drvdata(func);
+
+	if (wl1271_hardirq(0, wl) != IRQ_WAKE_THREAD) {
+		/* suspended, wl1271_op_resume() runs the work and unmasks */
+		wl1271_sdio_mask_irq(func, true);
+		return;
+	}
+
+	/*
+	 * The mutex is taken before the host everywhere else, so only try
+	 * it here.  When it is busy the holder may be waiting for the host:
+	 * mask the interrupt and leave it to irq_work instead.
+	 */
+	if (mutex_trylock(&wl->mutex)) {
+		wl1271_irq_locked(wl);
+		mutex_unlock(&wl->mutex);
+	} else {
+		wl1271_sdio_mask_irq(func, true);
+		ieee80211_queue_work(wl->hw, &wl->irq_work);
+	}
+}
+
+static void wl1271_sdio_irq_work(struct work_struct *work)
+{
+	struct wl1271 *wl = container_of(work, struct wl1271, irq_work);
+	struct sdio_func *func = wl_to_func(wl);
+
+	wl1271_irq(0, wl);
+
+	sdio_claim_host(func);
+	/* unless the interrupt was released meanwhile */
+	if (func->irq_handler)
+		wl1271_sdio_mask_irq(func, false);
+	sdio_release_host(func);
+}
+
 static void wl1271_sdio_disable_interrupts(struct wl1271 *wl)
 {
-	disable_irq(wl->irq);
+	struct sdio_func *func = wl_to_func(wl);
+
+	if (!wl1271_sdio_in_band(wl)) {
+		disable_irq(wl->irq);
+		return;
+	}
+
+	/* waits for ksdioirqd, like disable_irq() for the threaded irq */
+	sdio_claim_host(func);
+	sdio_release_irq(func);
+	sdio_release_host(func);
+	cancel_work_sync(&wl->irq_work);
 }
 
 static void wl1271_sdio_enable_interrupts(struct wl1271 *wl)
 {
-	enable_irq(wl->irq);
+	struct sdio_func *func = wl_to_func(wl);
+
+	if (!wl1271_sdio_in_band(wl)) {
+		enable_irq(wl->irq);
+		return;
+	}
+
+	sdio_claim_host(func);
+	/* still claimed if it was only masked while suspended */
+	if (func->irq_handler)
+		wl1271_sdio_mask_irq(func, false);
+	else if (sdio_claim_irq(func, wl1271_sdio_irq))
+		wl1271_error("sdio_claim_irq() failed");
+	sdio_release_host(func);
 }
 
 static void wl1271_sdio_reset(struct wl1271 *wl)
@@ -121,6 +232,8 @@ static void wl1271_sdio_raw_read(struct wl1271 *wl, int addr, void *buf,
 	int ret;
 	struct sdio_func *func = wl_to_func(wl);
 
+	wl1271_sdio_claim(wl);
+
 	if (unlikely(addr == HW_ACCESS_ELP_CTRL_REG_ADDR)) {
 		((u8 *)buf)[0] = sdio_f0_readb(func, addr, &ret);
 		wl1271_debug(DEBUG_SDIO, "sdio read 52 addr 0x%x, byte 0x%02x",
@@ -136,6 +249,8 @@ static void wl1271_sdio_raw_read(struct wl1271 *wl, int addr, void *buf,
 		wl1271_dump_ascii(DEBUG_SDIO, "data: ", buf, len);
 	}
 
+	wl1271_sdio_release(wl);
+
 	if (ret)
 		wl1271_error("sdio read failed (%d)", ret);
 }
@@ -146,6 +261,8 @@ static void wl1271_sdio_raw_write(struct wl1271 *wl, int addr, void *buf,
 	int ret;
 	struct sdio_func *func = wl_to_func(wl);
 
+	wl1271_sdio_claim(wl);
+
 	if (unlikely(addr == HW_ACCESS_ELP_CTRL_REG_ADDR)) {
 		sdio_f0_writeb(func, ((u8 *)buf)[0], addr, &ret);
 		wl1271_debug(DEBUG_SDIO, "sdio write 52 addr 0x%x, byte 0x%02x",
@@ -161,6 +278,8 @@ static void wl1271_sdio_raw_write(struct wl1271 *wl, int addr, void *buf,
 			ret = sdio_memcpy_toio(func, addr, buf, len);
 	}
 
+	wl1271_sdio_release(wl);
+
 	if (ret)
 		wl1271_error("sdio write failed (%d)", ret);
 }
@@ -182,6 +301,7 @@ static int wl1271_sdio_power_on(struct wl1271 *wl)
 
 	sdio_claim_host(func);
 	sdio_enable_func(func);
+	wl1271_sdio_release(wl);
 
 out:
 	return ret;
@@ -192,6 +312,7 @@ static int wl1271_sdio_power_off(struct wl1271 *wl)
 	struct sdio_func *func = wl_to_func(wl);
 	int ret;
 
+	wl1271_sdio_claim(wl);
 	sdio_disable_func(func);
 	sdio_release_host(func);
 
@@ -265,24 +386,29 @@ static int __devinit wl1271_probe(struct sdio_func *func,
 	wl->tcxo_clock = wlan_data->board_tcxo_clock;
 	wl->platform_quirks = wlan_data->platform_quirks;
 
-	if (wl->platform_quirks & WL12XX_PLATFORM_QUIRK_EDGE_IRQ)
-		irqflags = IRQF_TRIGGER_RISING;
-	else
-		irqflags = IRQF_TRIGGER_HIGH | IRQF_ONESHOT;
+	INIT_WORK(&wl->irq_work, wl1271_sdio_irq_work);
 
-	ret = request_threaded_irq(wl->irq, wl1271_hardirq, wl1271_irq,
-				   irqflags,
-				   DRIVER_NAME, wl);
-	if (ret < 0) {
-		wl1271_error("request_irq() failed: %d", ret);
-		goto out_free;
+	/* the SDIO irq is claimed once the firmware is up */
+	if (!wl1271_sdio_in_band(wl)) {
+		if (wl->platform_quirks & WL12XX_PLATFORM_QUIRK_EDGE_IRQ)
+			irqflags = IRQF_TRIGGER_RISING;
+		else
+			irqflags = IRQF_TRIGGER_HIGH | IRQF_ONESHOT;
+
+		ret = request_threaded_irq(wl->irq, wl1271_hardirq,
+					   wl1271_irq, irqflags,
+					   DRIVER_NAME, wl);
+		if (ret < 0) {
+			wl1271_error("request_irq() failed: %d", ret);
+			goto out_free;
+		}
+
+		enable_irq_wake(wl->irq);
+		disable_irq(wl->irq);
 	}
 
-	enable_irq_wake(wl->irq);
 	device_init_wakeup(wl1271_sdio_wl_to_dev(wl), 1);
 
-	disable_irq(wl->irq);
-
 	/* if sdio can keep power while host is suspended, enable wow */
 	mmcflags = sdio_get_host_pm_caps(func);
 	wl1271_debug(DEBUG_SDIO, "sdio PM caps = 0x%x", mmcflags);
@@ -308,7 +434,8 @@ static int __devinit wl1271_probe(struct sdio_func *func,
 	return 0;
 
  out_irq:
-	free_irq(wl->irq, wl);
+	if (!wl1271_sdio_in_band(wl))
+		free_irq(wl->irq, wl);
 
  out_free:
 	wl1271_free_hw(wl);
@@ -325,8 +452,10 @@ static void __devexit wl1271_remove(struct sdio_func *func)
 
 	wl1271_unregister_hw(wl);
 	device_init_wakeup(wl1271_sdio_wl_to_dev(wl), 0);
-	disable_irq_wake(wl->irq);
-	free_irq(wl->irq, wl);
+	if (!wl1271_sdio_in_band(wl)) {
+		disable_irq_wake(wl->irq);
+		free_irq(wl->irq, wl);
+	}
 	wl1271_free_hw(wl);
 }
 
@@ -362,7 +491,8 @@ static int wl1271_suspend(struct device *dev)
 		}
 
 		/* release host */
-		sdio_release_host(func);
+		if (!wl1271_sdio_in_band(wl))
+			sdio_release_host(func);
 	}
 out:
 	return ret;
@@ -376,7 +506,8 @@ static int wl1271_resume(struct device *dev)
 	wl1271_debug(DEBUG_MAC80211, "wl1271 resume");
 	if (wl->wow_enabled) {
 		/* claim back host */
-		sdio_claim_host(func);
+		if (!wl1271_sdio_in_band(wl))
+			sdio_claim_host(func);
 	}
 
 	return 0;
@@ -329,6 +329,8 @@ static irqreturn_t wl1271_hardirq(int irq, void *cookie)
 
 	/* complete the ELP completion */
 	spin_lock_irqsave(&wl->wl_lock, flags);
+	if (!wl->stats.irq_time.tv64)
+		wl->stats.irq_time = ktime_get();
 	set_bit(WL1271_FLAG_IRQ_RUNNING, &wl->flags);
 	if (wl->elp_compl) {
 		complete(wl->elp_compl);
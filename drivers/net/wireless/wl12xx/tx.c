@@ -176,7 +176,9 @@ static int wl1271_tx_allocate(struct wl1271 *wl, struct sk_buff *skb, u32 extra,
 	else
 		spare_blocks = 1;
 
-	if (buf_offset + total_len > WL1271_AGGR_BUFFER_SIZE)
+	/* the frame is padded to its aligned length in the buffer */
+	if (buf_offset + wl12xx_calc_packet_alignment(wl, total_len) >
+	    WL1271_AGGR_BUFFER_SIZE)
 		return -EAGAIN;
 
 	/* allocate free identifier for the packet */
@@ -383,6 +385,9 @@ static int wl1271_prepare_tx_frame(struct wl1271 *wl, struct sk_buff *skb,
 	if (ret < 0)
 		return ret;
 
+	if (skb->tstamp.tv64)
+		wl12xx_hist_add_us(wl, WL12XX_HIST_TX_QUEUE_US, skb->tstamp);
+
 	if (wl->bss_type == BSS_TYPE_AP_BSS) {
 		wl1271_tx_ap_update_inconnection_sta(wl, skb);
 		wl1271_tx_regulate_link(wl, hlid);
@@ -519,6 +524,59 @@ out:
 	return skb;
 }
 
+/* bytes the frame will take in the aggregation buffer */
+static u32 wl1271_tx_frame_len(struct wl1271 *wl, struct sk_buff *skb)
+{
+	struct ieee80211_tx_info *info = IEEE80211_SKB_CB(skb);
+	u32 extra = 0;
+
+	if (info->control.hw_key &&
+	    info->control.hw_key->cipher == WLAN_CIPHER_SUITE_TKIP)
+		extra = WL1271_TKIP_IV_SPACE;
+
+	return wl12xx_calc_packet_alignment(wl, skb->len + extra +
+					    sizeof(struct wl1271_tx_hw_descr));
+}
+
+/*
+ * Dequeue the head of the highest priority queue in queues that fits
+ * into room.  Only heads are considered, so the frames of each AC still
+ * go out in order.
+ */
+static struct sk_buff *wl1271_skb_dequeue_fit(struct wl1271 *wl,
+					      struct sk_buff_head *queues,
+					      u32 room)
+{
+	static const int acs[NUM_TX_QUEUES] = {
+		CONF_TX_AC_VO, CONF_TX_AC_VI, CONF_TX_AC_BE, CONF_TX_AC_BK
+	};
+	struct sk_buff *skb;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < NUM_TX_QUEUES; i++) {
+		struct sk_buff_head *q = &queues[acs[i]];
+
+		spin_lock_irqsave(&q->lock, flags);
+		skb = skb_peek(q);
+		if (skb && wl1271_tx_frame_len(wl, skb) <= room) {
+			__skb_unlink(skb, q);
+			spin_unlock_irqrestore(&q->lock, flags);
+			goto out;
+		}
+		spin_unlock_irqrestore(&q->lock, flags);
+	}
+
+	return NULL;
+
+out:
+	spin_lock_irqsave(&wl->wl_lock, flags);
+	wl->tx_queue_count--;
+	spin_unlock_irqrestore(&wl->wl_lock, flags);
+
+	return skb;
+}
+
 static struct sk_buff *wl1271_skb_dequeue(struct wl1271 *wl)
 {
 	unsigned long flags;
@@ -562,6 +620,50 @@ static void wl1271_skb_queue_head(struct wl1271 *wl, struct sk_buff *skb)
 	spin_unlock_irqrestore(&wl->wl_lock, flags);
 }
 
+/*
+ * The next frame doesn't fit into what is left of the aggregation
+ * buffer: fill the rest with smaller frames from the other ACs (and in
+ * AP mode, the other links) before it is flushed.
+ */
+static u32 wl1271_tx_fill_aggr(struct wl1271 *wl, u32 buf_offset)
+{
+	struct sk_buff *skb;
+	int h, ret;
+
+	h = 0;
+	while (buf_offset < WL1271_AGGR_BUFFER_SIZE) {
+		u32 room = WL1271_AGGR_BUFFER_SIZE - buf_offset;
+
+		if (wl->bss_type == BSS_TYPE_AP_BSS) {
+			skb = NULL;
+			for (; h < AP_MAX_LINKS && !skb; h++)
+				skb = wl1271_skb_dequeue_fit(wl,
+						wl->links[h].tx_queue, room);
+			/* retry the same link, it may have more that fit */
+			if (skb)
+				h--;
+		} else {
+			skb = wl1271_skb_dequeue_fit(wl, wl->tx_queue, room);
+		}
+		if (!skb)
+			break;
+
+		ret = wl1271_prepare_tx_frame(wl, skb, buf_offset);
+		if (ret == -EAGAIN || ret == -EBUSY) {
+			/* leave it to the main loop */
+			wl1271_skb_queue_head(wl, skb);
+			break;
+		} else if (ret < 0) {
+			dev_kfree_skb(skb);
+			break;
+		}
+		buf_offset += ret;
+		wl->tx_packets_count++;
+	}
+
+	return buf_offset;
+}
+
 void wl1271_tx_work_locked(struct wl1271 *wl)
 {
 	struct sk_buff *skb;
@@ -577,9 +679,11 @@ void wl1271_tx_work_locked(struct wl1271 *wl)
 		if (ret == -EAGAIN) {
 			/*
 			 * Aggregation buffer is full.
-			 * Flush buffer and try again.
+			 * Top it up from the other queues, then flush
+			 * buffer and try again.
 			 */
 			wl1271_skb_queue_head(wl, skb);
+			buf_offset = wl1271_tx_fill_aggr(wl, buf_offset);
 			wl1271_write(wl, WL1271_SLV_MEM_DATA, wl->aggr_buf,
 				     buf_offset, true);
 			sent_packets = true;
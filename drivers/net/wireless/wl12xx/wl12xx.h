@@ -179,6 +179,13 @@ extern u32 wl12xx_debug_level;
 
 #define WL1271_AGGR_BUFFER_SIZE (4 * PAGE_SIZE)
 
+/*
+ * RX aggregation is read straight into freshly allocated pages, sized
+ * from the frames the firmware reports, up to this much per read.
+ */
+#define WL1271_RX_AGGR_MAX_SIZE (8 * PAGE_SIZE)
+#define WL1271_RX_AGGR_MAX_PAGES (WL1271_RX_AGGR_MAX_SIZE / PAGE_SIZE)
+
 enum wl1271_state {
 	WL1271_STATE_OFF,
 	WL1271_STATE_ON,
@@ -232,12 +239,39 @@ struct wl1271_chip {
 	unsigned int fw_ver[NUM_FW_VER];
 };
 
+/*
+ * Host side histograms, log2 buckets: bucket 0 counts zeroes, bucket n
+ * values from 2^(n-1) up to 2^n, and the last one everything above.
+ */
+#define WL12XX_HIST_BUCKETS	20
+
+enum wl12xx_hist_id {
+	WL12XX_HIST_READ_BYTES,		/* bus read sizes */
+	WL12XX_HIST_READ_US,		/* bus read durations */
+	WL12XX_HIST_WRITE_BYTES,	/* bus write sizes */
+	WL12XX_HIST_WRITE_US,		/* bus write durations */
+	WL12XX_HIST_IRQ_RX_US,		/* hardirq to wl1271_rx */
+	WL12XX_HIST_TX_QUEUE_US,	/* op_tx to the TX aggregation */
+	WL12XX_HIST_ELP_WAKEUP_US,	/* ELP wakeup */
+	WL12XX_HIST_NR,
+};
+
+struct wl12xx_hist {
+	u32 count[WL12XX_HIST_BUCKETS];
+};
+
 struct wl1271_stats {
 	struct acx_statistics *fw_stats;
 	unsigned long fw_stats_update;
 
 	unsigned int retry_count;
 	unsigned int excessive_retries;
+
+	/* updated without locking, an odd lost count doesn't matter */
+	struct wl12xx_hist hist[WL12XX_HIST_NR];
+
+	/* time of the first hardirq not yet followed by RX, under wl_lock */
+	ktime_t irq_time;
 };
 
 #define NUM_TX_QUEUES              4
@@ -372,6 +406,21 @@ struct wl1271_link {
 	u8 addr[ETH_ALEN];
 };
 
+/* firmware images kept across power cycles, one per firmware type */
+enum wl12xx_fw_type {
+	WL12XX_FW_TYPE_STA,
+	WL12XX_FW_TYPE_AP,
+	WL12XX_FW_TYPES
+};
+
+struct wl12xx_fw_image {
+	u8 *data;
+	size_t len;
+
+	/* physically contiguous, can be handed to the bus as it is */
+	bool contig;
+};
+
 struct wl1271 {
 	struct platform_device *plat_dev;
 	struct ieee80211_hw *hw;
@@ -402,6 +451,8 @@ struct wl1271 {
 	u8 *fw;
 	size_t fw_len;
 	u8 fw_bss_type;
+	bool fw_contig;
+	struct wl12xx_fw_image fw_cache[WL12XX_FW_TYPES];
 	void *nvs;
 	size_t nvs_len;
 
@@ -444,6 +495,9 @@ struct wl1271 {
 
 	struct work_struct tx_work;
 
+	/* SDIO interrupt serviced outside of ksdioirqd */
+	struct work_struct irq_work;
+
 	/* Pending TX frames */
 	unsigned long tx_frames_map[BITS_TO_LONGS(ACX_TX_DESCRIPTORS)];
 	struct sk_buff *tx_frames[ACX_TX_DESCRIPTORS];
@@ -517,6 +571,10 @@ struct wl1271 {
 	struct delayed_work elp_work;
 	struct delayed_work pspoll_work;
 
+	/* when the chip was last released, and the average gap between */
+	ktime_t elp_last_request;
+	u32 elp_avg_gap_us;
+
 	/* counter for ps-poll delivery failures */
 	int ps_poll_failures;
 
@@ -613,6 +671,9 @@ int wl1271_plt_stop(struct wl1271 *wl);
 
 #define WL1271_DEFERRED_QUEUE_LIMIT    64
 
+/* RX frames handed to mac80211 per NAPI poll */
+#define WL1271_NAPI_WEIGHT             64
+
 /* WL1271 needs a 200ms sleep after power on, and a 20ms sleep before power
    on in case is has been shut down shortly before */
 #define WL1271_PRE_POWER_ON_SLEEP 20 /* in milliseconds */
@@ -45,6 +45,7 @@
 #define INDCHRG_RS_CPCY		95	/* 95% */
 #define INDCHRG_HOT_TEMP	600	/* 60 C */
 #define INDCHRG_COLD_TEMP	-200	/* -20 C */
+#define BATT_RESUME_MIN_TIME	50	/* secs between daemon runs on resume */
 
 #define CPCAP_BATT_PRINT_STATUS (1U << 0)
 #define CPCAP_BATT_PRINT_TRANSITION (1U << 1)
@@ -56,6 +57,22 @@ static unsigned char cc_counter_percentage;
 
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * On resume the daemon used to be run whenever it had not run for
+ * BATT_RESUME_MIN_TIME, which means ADC conversions and a full update on
+ * nearly every wakeup.  With cc_step set, it is only run if the coulomb
+ * counter accumulator moved by that many counts since its last run, or
+ * after max_idle seconds without a run.  Charger changes and the battery
+ * interrupts always run it.
+ */
+static unsigned int cc_step;
+module_param(cc_step, uint, 0644);
+MODULE_PARM_DESC(cc_step, "Coulomb counter change that triggers an update");
+
+static unsigned int max_idle = 30 * 60;
+module_param(max_idle, uint, 0644);
+MODULE_PARM_DESC(max_idle, "Seconds after which an update is forced");
+
 #define pr_cpcap_batt(debug_level_mask, args...) \
 	do { \
 		if (debug_mask & CPCAP_BATT_PRINT_##debug_level_mask) { \
@@ -94,6 +111,7 @@ struct cpcap_batt_ps {
 	wait_queue_head_t wait;
 	char async_req_pending;
 	unsigned long last_run_time;
+	s32 last_run_cc;
 	bool no_update;
 	unsigned long ind_chrg_dsbl_time;
 };
@@ -178,6 +196,29 @@ module_param_cb(cc_counter_percentage, &cc_counter_percentage_param_ops,
 	&cc_counter_percentage, 0644);
 MODULE_PARM_DESC(cc_counter_percentage, "Charge cycle counter percentage value");
 
+static s32 cpcap_batt_read_cc(struct cpcap_batt_ps *sply)
+{
+	static const enum cpcap_reg regs[] = {
+		CPCAP_REG_CCA1, CPCAP_REG_CCA2,
+	};
+	unsigned short val[ARRAY_SIZE(regs)] = {0, 0};
+
+	cpcap_regacc_read_batch(sply->cpcap, regs, val, ARRAY_SIZE(regs));
+
+	return (s32)(val[0] | (val[1] << 16));
+}
+
+/* have the daemon run a full update */
+static void cpcap_batt_kick(struct cpcap_batt_ps *sply)
+{
+	mutex_lock(&sply->lock);
+	sply->data_pending = 1;
+	sply->irq_status |= CPCAP_BATT_IRQ_MACRO;
+	mutex_unlock(&sply->lock);
+
+	wake_up_interruptible(&sply->wait);
+}
+
 void cpcap_batt_irq_hdlr(enum cpcap_irqs irq, void *data)
 {
 	struct cpcap_batt_ps *sply = data;
@@ -272,6 +313,8 @@ static ssize_t cpcap_batt_read(struct file *file,
 		temp = sched_clock();
 		do_div(temp, NSEC_PER_SEC);
 		sply->last_run_time = (unsigned long)temp;
+		if (cc_step)
+			sply->last_run_cc = cpcap_batt_read_cc(sply);
 
 		sply->irq_status = 0;
 		mutex_unlock(&sply->lock);
@@ -762,6 +805,7 @@ static int cpcap_batt_resume(struct platform_device *pdev)
 	struct cpcap_platform_data *pdata = sply->cpcap->spi->dev.platform_data;
 	unsigned long cur_time;
 	unsigned long long temp;
+	bool kick;
 
 	temp = sched_clock();
 	do_div(temp, NSEC_PER_SEC);
@@ -769,15 +813,13 @@ static int cpcap_batt_resume(struct platform_device *pdev)
 	if ((cur_time - sply->last_run_time) < 0)
 		sply->last_run_time = 0;
 
-	if ((cur_time - sply->last_run_time) > 50) {
-		mutex_lock(&sply->lock);
-		sply->data_pending = 1;
-		sply->irq_status |= CPCAP_BATT_IRQ_MACRO;
+	kick = (cur_time - sply->last_run_time) > BATT_RESUME_MIN_TIME;
+	if (kick && cc_step && (cur_time - sply->last_run_time) < max_idle)
+		kick = abs(cpcap_batt_read_cc(sply) - sply->last_run_cc) >=
+			cc_step;
 
-		mutex_unlock(&sply->lock);
-
-		wake_up_interruptible(&sply->wait);
-	}
+	if (kick)
+		cpcap_batt_kick(sply);
 
 	cpcap_batt_ind_chrg_ctrl(sply);
 
@@ -792,12 +834,18 @@ void cpcap_batt_set_ac_prop(struct cpcap_device *cpcap,
 	struct cpcap_platform_data *data = spi->dev.platform_data;
 
 	if (sply != NULL) {
+		bool changed = sply->ac_state.online != ac->online ||
+			       sply->ac_state.model != ac->model;
+
 		sply->ac_state.online = ac->online;
 		sply->ac_state.model = ac->model;
 		power_supply_changed(&sply->ac);
 
 		if (data->ac_changed)
 			data->ac_changed(&sply->ac, &sply->ac_state);
+
+		if (changed)
+			cpcap_batt_kick(sply);
 	}
 
 	cpcap_batt_ind_chrg_ctrl(sply);
@@ -812,12 +860,18 @@ void cpcap_batt_set_usb_prop_online(struct cpcap_device *cpcap, int online,
 	struct cpcap_platform_data *data = spi->dev.platform_data;
 
 	if (sply != NULL) {
+		bool changed = sply->usb_state.online != online ||
+			       sply->usb_state.model != model;
+
 		sply->usb_state.online = online;
 		sply->usb_state.model = model;
 		power_supply_changed(&sply->usb);
 
 		if (data->usb_changed)
 			data->usb_changed(&sply->usb, &sply->usb_state);
+
+		if (changed)
+			cpcap_batt_kick(sply);
 	}
 
 	cpcap_batt_ind_chrg_ctrl(sply);
@@ -34,6 +34,9 @@
 
 #define REGULATOR_STATE_LEN 512
 
+/* shorter settle times are busy-waited, longer ones sleep */
+#define CPCAP_REGLTR_SLEEP_MIN_US 20
+
 #define CPCAP_REGULATOR(_name, _id) 		\
 	{					\
 		.name = _name, 			\
@@ -357,7 +360,66 @@ static struct {
 			    1000},
 };
 
+/*
+ * What is in the voltage bits, serialized by the regulator core.  A
+ * voltage set while the regulator is off is only written when it is
+ * turned on, in the same register write.
+ */
+static struct {
+	bool on;
+	int sel;		/* written to the register, -1 if unknown */
+	int pending_sel;	/* to write on enable, -1 if none */
+} cpcap_regltr_volt[CPCAP_NUM_REGULATORS];
+
 static int cpcap_regulator_state;
+
+static void cpcap_regulator_settle(unsigned int us)
+{
+	if (us >= CPCAP_REGLTR_SLEEP_MIN_US)
+		usleep_range(us, us + us / 4);
+	else if (us)
+		udelay(us);
+}
+
+/*
+ * volt_trans_time is the ramp across the whole table, so a step takes its
+ * share of it.  Nothing waits for the output to come down.
+ */
+static unsigned int cpcap_regulator_ramp_time(int regltr_id, int old_sel,
+					      int new_sel)
+{
+	const int *tbl = cpcap_regltr_data[regltr_id].val_tbl;
+	unsigned int trans_time = cpcap_regltr_data[regltr_id].volt_trans_time;
+	int min_uV = INT_MAX, max_uV = 0;
+	int i;
+
+	if (old_sel < 0)
+		return trans_time;
+	if (tbl[new_sel] <= tbl[old_sel])
+		return 0;
+
+	for (i = 0; i < cpcap_regltr_data[regltr_id].val_tbl_sz; i++) {
+		min_uV = min(min_uV, tbl[i]);
+		max_uV = max(max_uV, tbl[i]);
+	}
+
+	return DIV_ROUND_UP(trans_time * (tbl[new_sel] - tbl[old_sel]),
+			    max_uV - min_uV);
+}
+
+/* vsim and vsimcard share their voltage bits */
+static void cpcap_regulator_sel_written(int regltr_id, int sel)
+{
+	enum cpcap_reg regnr = cpcap_regltr_data[regltr_id].reg;
+	unsigned short mask = cpcap_regltr_data[regltr_id].volt_mask;
+	int i;
+
+	for (i = 0; i < CPCAP_NUM_REGULATORS; i++)
+		if (cpcap_regltr_data[i].reg == regnr &&
+		    cpcap_regltr_data[i].volt_mask == mask)
+			cpcap_regltr_volt[i].sel = sel;
+}
+
 static int cpcap_regulator_set_voltage(struct regulator_dev *rdev,
 				       int min_uV, int max_uV,
 				       unsigned *selector)
@@ -391,18 +453,28 @@ static int cpcap_regulator_set_voltage(struct regulator_dev *rdev,
 	}
 
 	*selector = i;
-	i <<= cpcap_regltr_data[regltr_id].volt_shft;
-	retval = cpcap_regacc_write(cpcap, regnr, i,
+
+	/* fixed voltage, nothing to write */
+	if (!cpcap_regltr_data[regltr_id].volt_mask)
+		return 0;
+
+	if (i == cpcap_regltr_volt[regltr_id].sel) {
+		cpcap_regltr_volt[regltr_id].pending_sel = -1;
+		return 0;
+	}
+
+	if (!cpcap_regltr_volt[regltr_id].on) {
+		cpcap_regltr_volt[regltr_id].pending_sel = i;
+		return 0;
+	}
+
+	retval = cpcap_regacc_write(cpcap, regnr,
+				    i << cpcap_regltr_data[regltr_id].volt_shft,
 				    cpcap_regltr_data[regltr_id].volt_mask);
-	if ((cpcap_regltr_data[regltr_id].volt_trans_time) && (retval == 0)) {
-		if (cpcap_regltr_data[regltr_id].volt_trans_time >=
-		    (MAX_UDELAY_MS * USEC_PER_MSEC)) {
-			mdelay(cpcap_regltr_data[regltr_id].volt_trans_time /
-			       USEC_PER_MSEC);
-			udelay(cpcap_regltr_data[regltr_id].volt_trans_time %
-			       USEC_PER_MSEC);
-		} else
-			udelay(cpcap_regltr_data[regltr_id].volt_trans_time);
+	if (retval == 0) {
+		cpcap_regulator_settle(cpcap_regulator_ramp_time(regltr_id,
+				cpcap_regltr_volt[regltr_id].sel, i));
+		cpcap_regulator_sel_written(regltr_id, i);
 	}
 
 	return retval;
@@ -430,6 +502,10 @@ static int cpcap_regulator_get_voltage(struct regulator_dev *rdev)
 	if (!(volt_bits & cpcap_regltr_data[regltr_id].mode_mask))
 		return 0;
 
+	if (cpcap_regltr_volt[regltr_id].pending_sel >= 0)
+		return cpcap_regltr_data[regltr_id].val_tbl[
+			cpcap_regltr_volt[regltr_id].pending_sel];
+
 	volt_bits &= cpcap_regltr_data[regltr_id].volt_mask;
 	shift = cpcap_regltr_data[regltr_id].volt_shft;
 
@@ -439,68 +515,80 @@ static int cpcap_regulator_get_voltage(struct regulator_dev *rdev)
 static int cpcap_regulator_enable(struct regulator_dev *rdev)
 {
 	struct cpcap_device *cpcap = rdev_get_drvdata(rdev);
+	struct cpcap_regacc ops[2];
 	int regltr_id;
 	int retval;
-	enum cpcap_reg regnr;
+	int pending;
+	int n = 0;
 
 	regltr_id = rdev_get_id(rdev);
 	if (regltr_id >= CPCAP_NUM_REGULATORS)
 		return -EINVAL;
 
-	regnr = cpcap_regltr_data[regltr_id].reg;
-	cpcap_regulator_state |= (1 << regltr_id);
-	retval = cpcap_regacc_write(cpcap, regnr,
-				    cpcap_regltr_data[regltr_id].mode_val,
-				    cpcap_regltr_data[regltr_id].mode_mask);
-
-	if ((retval == 0) &&
-		(cpcap_regltr_data[regltr_id].mode_val &
-			CPCAP_REG_OFF_MODE_SEC)) {
-		retval = cpcap_regacc_write(cpcap,
-				cpcap_regltr_data[regltr_id].assignment_reg,
-				0,
-				cpcap_regltr_data[regltr_id].assignment_mask);
+	pending = cpcap_regltr_volt[regltr_id].pending_sel;
+
+	ops[n].reg = cpcap_regltr_data[regltr_id].reg;
+	ops[n].value = cpcap_regltr_data[regltr_id].mode_val;
+	ops[n].mask = cpcap_regltr_data[regltr_id].mode_mask;
+	if (pending >= 0) {
+		ops[n].value |= pending <<
+			cpcap_regltr_data[regltr_id].volt_shft;
+		ops[n].mask |= cpcap_regltr_data[regltr_id].volt_mask;
 	}
+	n++;
 
-	if ((cpcap_regltr_data[regltr_id].turn_on_time) && (retval == 0)) {
-		if (cpcap_regltr_data[regltr_id].turn_on_time >=
-		    (MAX_UDELAY_MS * USEC_PER_MSEC)) {
-			mdelay(cpcap_regltr_data[regltr_id].turn_on_time /
-			       USEC_PER_MSEC);
-			udelay(cpcap_regltr_data[regltr_id].turn_on_time %
-			       USEC_PER_MSEC);
-		} else
-			udelay(cpcap_regltr_data[regltr_id].turn_on_time);
+	if (cpcap_regltr_data[regltr_id].mode_val & CPCAP_REG_OFF_MODE_SEC) {
+		ops[n].reg = cpcap_regltr_data[regltr_id].assignment_reg;
+		ops[n].value = 0;
+		ops[n].mask = cpcap_regltr_data[regltr_id].assignment_mask;
+		n++;
 	}
 
-	return retval;
+	cpcap_regulator_state |= (1 << regltr_id);
+	retval = cpcap_regacc_write_batch(cpcap, ops, n);
+	if (retval)
+		return retval;
+
+	cpcap_regltr_volt[regltr_id].on = true;
+	if (pending >= 0) {
+		cpcap_regulator_sel_written(regltr_id, pending);
+		cpcap_regltr_volt[regltr_id].pending_sel = -1;
+	}
+
+	cpcap_regulator_settle(cpcap_regltr_data[regltr_id].turn_on_time);
+
+	return 0;
 }
 
 static int cpcap_regulator_disable(struct regulator_dev *rdev)
 {
 	struct cpcap_device *cpcap = rdev_get_drvdata(rdev);
+	struct cpcap_regacc ops[2];
 	int regltr_id;
-	int retval = 0;
-	enum cpcap_reg regnr;
+	int retval;
+	int n = 0;
 
 	regltr_id = rdev_get_id(rdev);
 	if (regltr_id >= CPCAP_NUM_REGULATORS)
 		return -EINVAL;
 
-	regnr = cpcap_regltr_data[regltr_id].reg;
 	cpcap_regulator_state &= ~(1 << regltr_id);
 	if (cpcap_regltr_data[regltr_id].mode_val & CPCAP_REG_OFF_MODE_SEC) {
-		retval = cpcap_regacc_write(cpcap,
-				cpcap_regltr_data[regltr_id].assignment_reg,
-				cpcap_regltr_data[regltr_id].assignment_mask,
-				cpcap_regltr_data[regltr_id].assignment_mask);
+		ops[n].reg = cpcap_regltr_data[regltr_id].assignment_reg;
+		ops[n].value = cpcap_regltr_data[regltr_id].assignment_mask;
+		ops[n].mask = cpcap_regltr_data[regltr_id].assignment_mask;
+		n++;
 	}
 
-	if (retval == 0) {
-		retval = cpcap_regacc_write(cpcap, regnr,
-				cpcap_regltr_data[regltr_id].off_mode_val,
-				cpcap_regltr_data[regltr_id].mode_mask);
-	}
+	ops[n].reg = cpcap_regltr_data[regltr_id].reg;
+	ops[n].value = cpcap_regltr_data[regltr_id].off_mode_val;
+	ops[n].mask = cpcap_regltr_data[regltr_id].mode_mask;
+	n++;
+
+	retval = cpcap_regacc_write_batch(cpcap, ops, n);
+	if (retval == 0)
+		cpcap_regltr_volt[regltr_id].on = false;
+
 	return retval;
 }
 
@@ -640,6 +728,8 @@ static int __devinit cpcap_regulator_probe(struct platform_device *pdev)
 	struct cpcap_device *cpcap;
 	struct cpcap_platform_data *data;
 	struct regulator_init_data *init;
+	unsigned short value;
+	int id = pdev->id;
 	int i;
 
 	/* Already set by core driver */
@@ -653,6 +743,22 @@ static int __devinit cpcap_regulator_probe(struct platform_device *pdev)
 			data->regulator_off_mode_values[i];
 	}
 
+	/* before registering: applying the constraints sets the voltage */
+	cpcap_regltr_volt[id].sel = -1;
+	cpcap_regltr_volt[id].pending_sel = -1;
+	if (!cpcap_regacc_read(cpcap, cpcap_regltr_data[id].reg, &value)) {
+		cpcap_regltr_volt[id].on =
+			(value & cpcap_regltr_data[id].mode_mask) ==
+			cpcap_regltr_data[id].mode_val;
+		i = (value & cpcap_regltr_data[id].volt_mask) >>
+			cpcap_regltr_data[id].volt_shft;
+		if (i < cpcap_regltr_data[id].val_tbl_sz)
+			cpcap_regltr_volt[id].sel = i;
+	} else {
+		/* write through until the state is known */
+		cpcap_regltr_volt[id].on = true;
+	}
+
 	rdev = regulator_register(&regulators[pdev->id], &pdev->dev,
 				init, cpcap);
 	if (IS_ERR(rdev))
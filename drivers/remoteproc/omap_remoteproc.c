@@ -172,6 +172,37 @@ omap_rproc_map(struct device *dev, struct iommu *obj, u32 da, u32 pa, u32 size)
 }
 
 
+/*
+ * The regions that go into a core dump are the remote core's code and
+ * data; keep their translations locked in the TLB.
+ */
+static void omap_rproc_lock_ranges(struct rproc *rproc, const char *name)
+{
+	struct iommu_lock_range *r;
+	int i, n = 0;
+
+	for (i = 0; rproc->memory_maps[i].size; i++)
+		if (rproc->memory_maps[i].core)
+			n++;
+	if (!n)
+		return;
+
+	r = kcalloc(n, sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return;
+
+	for (i = 0, n = 0; rproc->memory_maps[i].size; i++) {
+		const struct rproc_mem_entry *me = &rproc->memory_maps[i];
+
+		if (!me->core)
+			continue;
+		r[n].da = me->da;
+		r[n++].size = me->size;
+	}
+	iommu_set_lock_ranges(name, r, n);
+	kfree(r);
+}
+
 static int omap_rproc_iommu_isr(struct iommu *iommu, u32 da, u32 errs, void *p)
 {
 	struct rproc *rproc = p;
@@ -298,6 +329,8 @@ static int omap_rproc_iommu_init(struct rproc *rproc,
 	iommu_set_isr(pdata->iommu_name, omap_rproc_iommu_isr, rproc);
 	iommu_set_secure(pdata->iommu_name, rproc->secure_mode,
 						rproc->secure_ttb);
+	if (!rproc->secure_mode)
+		omap_rproc_lock_ranges(rproc, pdata->iommu_name);
 	iommu = iommu_get(pdata->iommu_name);
 	if (IS_ERR(iommu)) {
 		ret = PTR_ERR(iommu);
@@ -49,6 +49,26 @@ static DEFINE_SPINLOCK(rprocs_lock);
 /* debugfs parent dir */
 static struct dentry *rproc_dbg;
 
+/* keep each validated image in memory for the next start / recovery */
+static bool cache_fw = true;
+module_param(cache_fw, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(cache_fw, "Keep firmware images loaded across restarts");
+
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+/*
+ * Gaps between two rproc_last_busy() calls shorter than this are within
+ * a burst of messages, not idle time worth suspending for.
+ */
+#define RPROC_IDLE_GAP_MIN_MS		10
+#define RPROC_AUTOSUSPEND_MIN_MS	100
+
+/* size the autosuspend delay from the recent idle gaps */
+static bool adaptive_suspend = true;
+module_param(adaptive_suspend, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adaptive_suspend,
+	"Adapt the autosuspend delay to the observed idle gaps");
+#endif
+
 static ssize_t rproc_format_trace_buf(char __user *userbuf, size_t count,
 				    loff_t *ppos, const void *src, int size)
 {
@@ -679,6 +699,8 @@ static void rproc_start(struct rproc *rproc, u64 bootaddr)
 	}
 
 #ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+	rproc->cur_delay = rproc->sus_timeout;
+	rproc->last_busy = jiffies;
 	pm_runtime_use_autosuspend(dev);
 	pm_runtime_set_autosuspend_delay(dev, rproc->sus_timeout);
 	pm_runtime_get_noresume(rproc->dev);
@@ -1088,15 +1110,12 @@ exit:
 	return ret;
 }
 
-static void rproc_loader_defered(struct rproc *rproc)
+static const struct firmware *rproc_request_fw(struct rproc *rproc)
 {
 	const struct firmware *fw;
 	struct device *dev = rproc->dev;
 	const char *fwfile = rproc->firmware;
-	u64 bootaddr = 0;
 	struct fw_header *image;
-	struct fw_section *section;
-	int left, ret;
 	int count = 15;
 
 	/* wait until udev is up */
@@ -1109,7 +1128,7 @@ static void rproc_loader_defered(struct rproc *rproc)
 
 	if (!fw) {
 		dev_err(dev, "%s: failed to load %s\n", __func__, fwfile);
-		goto complete_fw;
+		return NULL;
 	}
 
 	dev_info(dev, "Loaded BIOS image %s, size %d\n", fwfile, fw->size);
@@ -1129,6 +1148,7 @@ static void rproc_loader_defered(struct rproc *rproc)
 
 	dev_info(dev, "BIOS image version is %d\n", image->version);
 
+	kfree(rproc->header);
 	rproc->header = kzalloc(image->header_len, GFP_KERNEL);
 	if (!rproc->header) {
 		dev_err(dev, "%s: kzalloc failed\n", __func__);
@@ -1144,6 +1164,36 @@ static void rproc_loader_defered(struct rproc *rproc)
 		goto out;
 	}
 
+	return fw;
+
+out:
+	release_firmware(fw);
+	return NULL;
+}
+
+static void rproc_loader_defered(struct rproc *rproc)
+{
+	const struct firmware *fw;
+	struct device *dev = rproc->dev;
+	u64 bootaddr = 0;
+	struct fw_header *image;
+	struct fw_section *section;
+	int left, ret;
+
+	/*
+	 * A cached image was validated when it was first requested and
+	 * only needs its sections copied again: the remote processor
+	 * writes to its data and the carveout is reused by the next load.
+	 */
+	fw = rproc->fw;
+	rproc->fw = NULL;
+	if (!fw)
+		fw = rproc_request_fw(rproc);
+	if (!fw)
+		goto complete_fw;
+
+	image = (struct fw_header *) fw->data;
+
 	/* now process the image, section by section */
 	section = (struct fw_section *)(image->header + image->header_len);
 
@@ -1157,6 +1207,10 @@ static void rproc_loader_defered(struct rproc *rproc)
 
 	rproc_start(rproc, bootaddr);
 
+	if (cache_fw) {
+		rproc->fw = fw;
+		goto complete_fw;
+	}
 out:
 	release_firmware(fw);
 complete_fw:
@@ -1338,7 +1392,11 @@ void rproc_put(struct rproc *rproc)
 
 	rproc_reset_poolmem(rproc);
 	memset(rproc->memory_maps, 0, sizeof(rproc->memory_maps));
-	kfree(rproc->header);
+	/* the header belongs to a cached image, if any */
+	if (!rproc->fw) {
+		kfree(rproc->header);
+		rproc->header = NULL;
+	}
 
 	/*
 	 * make sure rproc is really running before powering it off.
@@ -1396,6 +1454,43 @@ out:
 }
 EXPORT_SYMBOL_GPL(rproc_put);
 
+/**
+ * rproc_stop_all() - force every running remote processor off
+ *
+ * Meant for the reboot/kexec path: stops each running or crashed remote
+ * processor regardless of its users, without waiting on firmware loading
+ * or on a busy rproc lock, so it completes in bounded time.  Resources
+ * are not released; the system is going down anyway.
+ */
+void rproc_stop_all(void)
+{
+	struct rproc *rproc;
+
+	/* no rproc can be (un)registered anymore at this point */
+	list_for_each_entry(rproc, &rprocs, next) {
+		if (!mutex_trylock(&rproc->lock)) {
+			dev_warn(rproc->dev, "%s busy, not stopped\n",
+								rproc->name);
+			continue;
+		}
+
+		if (rproc->state == RPROC_RUNNING ||
+				rproc->state == RPROC_CRASHED) {
+			if (rproc->ops->stop(rproc)) {
+				dev_err(rproc->dev, "can't stop rproc %s\n",
+								rproc->name);
+			} else {
+				if (rproc->ops->watchdog_exit)
+					rproc->ops->watchdog_exit(rproc);
+				rproc->state = RPROC_OFFLINE;
+			}
+		}
+
+		mutex_unlock(&rproc->lock);
+	}
+}
+EXPORT_SYMBOL_GPL(rproc_stop_all);
+
 static void rproc_error_work(struct work_struct *work)
 {
 	struct rproc *rproc = container_of(work, struct rproc, error_work);
@@ -1416,16 +1511,66 @@ int rproc_event_unregister(struct rproc *rproc, struct notifier_block *nb)
 }
 EXPORT_SYMBOL_GPL(rproc_event_unregister);
 
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+/*
+ * Remote processors are mostly driven by periodic work, video frames or
+ * camera shots.  Keep them up for twice the longest of the recent idle
+ * gaps, so that they stay powered between two frames of a stream but
+ * suspend soon after it ends, rather than always after sus_timeout.
+ * A gap that led to a suspend and a resume also lands in the history,
+ * so a delay that turned out too short grows on the next call.
+ *
+ * Locking: pm_lock.  Returns the new delay, or 0 to keep the current one.
+ */
+static unsigned rproc_next_delay(struct rproc *rproc)
+{
+	unsigned long now = jiffies;
+	unsigned gap = jiffies_to_msecs(now - rproc->last_busy);
+	unsigned delay, max_gap = 0;
+	int i;
+
+	rproc->last_busy = now;
+
+	if (gap >= RPROC_IDLE_GAP_MIN_MS && gap < rproc->sus_timeout) {
+		rproc->idle_gaps[rproc->idle_gap_ptr++] = gap;
+		if (rproc->idle_gap_ptr >= RPROC_IDLE_GAPS)
+			rproc->idle_gap_ptr = 0;
+		if (rproc->idle_gap_cnt < RPROC_IDLE_GAPS)
+			rproc->idle_gap_cnt++;
+	}
+
+	if (!adaptive_suspend || rproc->idle_gap_cnt < RPROC_IDLE_GAPS) {
+		delay = rproc->sus_timeout;
+	} else {
+		for (i = 0; i < RPROC_IDLE_GAPS; i++)
+			max_gap = max(max_gap, rproc->idle_gaps[i]);
+		delay = clamp_t(unsigned, 2 * max_gap,
+				RPROC_AUTOSUSPEND_MIN_MS, rproc->sus_timeout);
+	}
+
+	/* only bother the PM core with changes that matter */
+	if (abs((int)delay - (int)rproc->cur_delay) <= rproc->cur_delay / 4)
+		return 0;
+
+	rproc->cur_delay = delay;
+	return delay;
+}
+#endif
+
 void rproc_last_busy(struct rproc *rproc)
 {
 #ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
 	struct device *dev = rproc->dev;
+	unsigned delay;
 
 	mutex_lock(&rproc->pm_lock);
+	delay = rproc_next_delay(rproc);
 	if (pm_runtime_suspended(dev) ||
 			!pm_runtime_autosuspend_expiration(dev)) {
 		pm_runtime_mark_last_busy(dev);
 		mutex_unlock(&rproc->pm_lock);
+		if (delay)
+			pm_runtime_set_autosuspend_delay(dev, delay);
 		/*
 		 * if the remote processor is suspended, we can not wake it
 		 * up (that would abort system suspend), instead state that
@@ -1445,10 +1590,49 @@ void rproc_last_busy(struct rproc *rproc)
 	}
 	pm_runtime_mark_last_busy(dev);
 	mutex_unlock(&rproc->pm_lock);
+	/* outside pm_lock: this may run the runtime suspend callback */
+	if (delay)
+		pm_runtime_set_autosuspend_delay(dev, delay);
 #endif
 }
 EXPORT_SYMBOL(rproc_last_busy);
 
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+/*
+ * Userspace hint that a stream is running on the remote processor:
+ * writing 1 wakes it up ahead of the first frame and keeps it from
+ * autosuspending until 0 is written.
+ */
+static ssize_t rproc_stream_active_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct rproc *rproc = platform_get_drvdata(to_platform_device(dev));
+
+	return sprintf(buf, "%d\n", rproc->stream_active);
+}
+
+static ssize_t rproc_stream_active_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct rproc *rproc = platform_get_drvdata(to_platform_device(dev));
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	rproc->stream_active = !!val;
+	/* wake it up, or restart the autosuspend timer on release */
+	if (rproc->state == RPROC_RUNNING)
+		rproc_last_busy(rproc);
+
+	return count;
+}
+
+static DEVICE_ATTR(stream_active, S_IRUGO | S_IWUSR,
+		   rproc_stream_active_show, rproc_stream_active_store);
+#endif
+
 #ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
 static int rproc_resume(struct device *dev)
 {
@@ -1553,7 +1737,8 @@ static int rproc_runtime_suspend(struct device *dev)
 
 	mutex_lock(&rproc->pm_lock);
 
-	if (pm_runtime_autosuspend_expiration(dev) && !rproc->force_suspend) {
+	if ((pm_runtime_autosuspend_expiration(dev) || rproc->stream_active)
+						&& !rproc->force_suspend) {
 		ret = -EBUSY;
 		goto abort;
 	}
@@ -1727,6 +1912,10 @@ int rproc_register(struct device *dev, const char *name,
 	debugfs_create_file("version", 0444, rproc->dbg_dir, rproc,
 							&rproc_version_ops);
 out:
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+	if (device_create_file(dev, &dev_attr_stream_active))
+		dev_warn(dev, "can't create stream_active attribute\n");
+#endif
 	return 0;
 }
 EXPORT_SYMBOL_GPL(rproc_register);
@@ -1745,6 +1934,9 @@ int rproc_unregister(const char *name)
 
 	if (rproc->dbg_dir)
 		debugfs_remove_recursive(rproc->dbg_dir);
+#ifdef CONFIG_REMOTE_PROC_AUTOSUSPEND
+	device_remove_file(rproc->dev, &dev_attr_stream_active);
+#endif
 
 	spin_lock(&rprocs_lock);
 	list_del(&rproc->next);
@@ -1754,6 +1946,9 @@ int rproc_unregister(const char *name)
 	rproc->secure_ttb = NULL;
 	pm_qos_remove_request(rproc->qos_request);
 	kfree(rproc->qos_request);
+	if (rproc->fw)
+		release_firmware(rproc->fw);
+	kfree(rproc->header);
 	kfree(rproc->last_trace_buf0);
 	kfree(rproc->last_trace_buf1);
 	kfree(rproc);
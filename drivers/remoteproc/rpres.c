@@ -15,11 +15,28 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <plat/omap_device.h>
 #include <plat/rpres.h>
 
+/*
+ * A codec start on the remote processor sends a burst of constraint
+ * changes, often raising and dropping the same one several times.
+ * Demands (a higher frequency or bandwidth, a tighter latency) are
+ * applied at once so that the remote processor never waits for them,
+ * but relaxations are held for a short window and only the last one is
+ * applied, saving the OPP transitions in between.
+ */
+#define RPRES_RELAX_WINDOW_MS	20
+
 static LIST_HEAD(rpres_list);
 static DEFINE_SPINLOCK(rpres_lock);
+static struct dentry *rpres_dbg;
+
+static const char *rpres_cname[] = {"scale", "latency", "bandwidth"};
 
 static struct rpres *__find_by_name(const char *name)
 {
@@ -33,7 +50,7 @@ static struct rpres *__find_by_name(const char *name)
 
 struct rpres *rpres_get(const char *name)
 {
-	int ret;
+	int ret, i;
 	struct rpres *r;
 	struct rpres_platform_data *pdata;
 
@@ -51,8 +68,11 @@ struct rpres *rpres_get(const char *name)
 	}
 	pdata = r->pdev->dev.platform_data;
 	ret = pdata->ops->start(r->pdev);
-	if (!ret)
+	if (!ret) {
 		r->state = RPRES_ACTIVE;
+		for (i = 0; i < RPRES_CONSTRAINT_MAX; i++)
+			r->c[i].has_applied = r->c[i].has_pending = false;
+	}
 out:
 	mutex_unlock(&r->lock);
 	if (ret)
@@ -64,6 +84,9 @@ EXPORT_SYMBOL(rpres_get);
 void rpres_put(struct rpres *obj)
 {
 	struct rpres_platform_data *pdata = obj->pdev->dev.platform_data;
+
+	/* pending relaxations are moot once the resource stops */
+	cancel_delayed_work_sync(&obj->relax_work);
 	mutex_lock(&obj->lock);
 	if (obj->state == RPRES_INACTIVE) {
 		pr_err("%s:resource already inactive\n", __func__);
@@ -75,33 +98,101 @@ void rpres_put(struct rpres *obj)
 }
 EXPORT_SYMBOL(rpres_put);
 
-int rpres_set_constraints(struct rpres *obj, enum rpres_constraint type, long val)
+static int (*rpres_constraint_func(struct rpres *obj,
+		enum rpres_constraint type))(struct platform_device *, long)
 {
-	int ret;
 	struct rpres_platform_data *pdata = obj->pdev->dev.platform_data;
-	struct platform_device *pdev = obj->pdev;
-	static const char *cname[] = {"scale", "latency", "bandwidth"};
-	int (*func)(struct platform_device *, long);
 
 	switch (type) {
 	case RPRES_CONSTRAINT_SCALE:
-		func = pdata->ops->scale_dev;
-		break;
+		return pdata->ops->scale_dev;
 	case RPRES_CONSTRAINT_LATENCY:
-		func = pdata->ops->set_lat;
-		break;
+		return pdata->ops->set_lat;
 	case RPRES_CONSTRAINT_BANDWIDTH:
-		func = pdata->ops->set_bw;
-		break;
+		return pdata->ops->set_bw;
 	default:
+		return NULL;
+	}
+}
+
+/* does val weaken the constraint of the given type set to cur? */
+static bool rpres_is_relax(enum rpres_constraint type, long cur, long val)
+{
+	if (type == RPRES_CONSTRAINT_SCALE)
+		return val < cur;
+	/* -1 drops a latency or bandwidth constraint */
+	if (val == -1)
+		return true;
+	if (cur == -1)
+		return false;
+	if (type == RPRES_CONSTRAINT_LATENCY)
+		return val > cur;
+	return val < cur;
+}
+
+/* Locking: obj->lock */
+static int __rpres_apply(struct rpres *obj, enum rpres_constraint type,
+			 long val)
+{
+	struct rpres_constraint_stat *s = &obj->c[type];
+	struct platform_device *pdev = obj->pdev;
+	ktime_t start;
+	s64 us;
+	int ret;
+
+	dev_dbg(&pdev->dev, "set %s constraint %ld\n", rpres_cname[type], val);
+	start = ktime_get();
+	ret = rpres_constraint_func(obj, type)(pdev, val);
+	us = ktime_us_delta(ktime_get(), start);
+
+	s->count++;
+	s->total_us += us;
+	s->max_us = max_t(u32, s->max_us, us);
+
+	if (ret) {
+		dev_err(&pdev->dev, "%s: error setting constraint %s\n",
+				__func__, rpres_cname[type]);
+		return ret;
+	}
+
+	s->applied = val;
+	s->has_applied = true;
+	return 0;
+}
+
+static void rpres_relax_work(struct work_struct *work)
+{
+	struct rpres *obj = container_of(work, struct rpres, relax_work.work);
+	int i;
+
+	mutex_lock(&obj->lock);
+	for (i = 0; i < RPRES_CONSTRAINT_MAX; i++) {
+		struct rpres_constraint_stat *s = &obj->c[i];
+
+		if (!s->has_pending)
+			continue;
+		s->has_pending = false;
+		if (obj->state == RPRES_ACTIVE)
+			__rpres_apply(obj, i, s->pending);
+	}
+	mutex_unlock(&obj->lock);
+}
+
+int rpres_set_constraints(struct rpres *obj, enum rpres_constraint type, long val)
+{
+	int ret = 0;
+	struct platform_device *pdev = obj->pdev;
+	struct rpres_constraint_stat *s;
+
+	if (type < 0 || type >= RPRES_CONSTRAINT_MAX) {
 		dev_err(&pdev->dev, "%s: invalid constraint %d\n",
 			__func__, type);
 		return -EINVAL;
 	}
 
-	if (!func) {
+	if (!rpres_constraint_func(obj, type)) {
 		dev_err(&pdev->dev, "%s: No %s constraint\n",
-			__func__, cname[type]);
+			__func__, rpres_cname[type]);
 		return -EINVAL;
 	}
 
@@ -112,17 +203,63 @@ int rpres_set_constraints(struct rpres *obj, enum rpres_constraint type, long va
 		return -EPERM;
 	}
 
-	dev_dbg(&pdev->dev, "set %s constraint %ld\n", cname[type], val);
-	ret = func(pdev, val);
-	if (ret)
-		dev_err(&pdev->dev, "%s: error setting constraint %s\n",
-				__func__, cname[type]);
+	s = &obj->c[type];
+	if (s->has_pending) {
+		s->has_pending = false;
+		s->coalesced++;
+	}
+
+	if (s->has_applied && val == s->applied) {
+		s->skipped++;
+	} else if (s->has_applied && rpres_is_relax(type, s->applied, val)) {
+		s->pending = val;
+		s->has_pending = true;
+		s->deferred++;
+		schedule_delayed_work(&obj->relax_work,
+				      msecs_to_jiffies(RPRES_RELAX_WINDOW_MS));
+	} else {
+		ret = __rpres_apply(obj, type, val);
+	}
 	mutex_unlock(&obj->lock);
 
 	return ret;
 }
 EXPORT_SYMBOL(rpres_set_constraints);
 
+static int rpres_stats_show(struct seq_file *m, void *v)
+{
+	struct rpres *obj = m->private;
+	int i;
+
+	mutex_lock(&obj->lock);
+	for (i = 0; i < RPRES_CONSTRAINT_MAX; i++) {
+		struct rpres_constraint_stat *s = &obj->c[i];
+
+		seq_printf(m, "%-9s applied %ld calls %lu skipped %lu "
+			   "deferred %lu coalesced %lu avg %lluus max %uus\n",
+			   rpres_cname[i], s->has_applied ? s->applied : 0,
+			   s->count, s->skipped, s->deferred, s->coalesced,
+			   (unsigned long long)(s->count ?
+			   div_u64(s->total_us, s->count) : 0),
+			   s->max_us);
+	}
+	mutex_unlock(&obj->lock);
+
+	return 0;
+}
+
+static int rpres_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rpres_stats_show, inode->i_private);
+}
+
+static const struct file_operations rpres_stats_fops = {
+	.open		= rpres_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int rpres_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -137,6 +274,11 @@ static int rpres_probe(struct platform_device *pdev)
 	obj->name = pdata->name;
 	obj->state = RPRES_INACTIVE;
 	mutex_init(&obj->lock);
+	INIT_DELAYED_WORK(&obj->relax_work, rpres_relax_work);
+
+	if (rpres_dbg)
+		obj->dbg = debugfs_create_file(obj->name, 0444, rpres_dbg,
+					       obj, &rpres_stats_fops);
 
 	spin_lock(&rpres_lock);
 	list_add_tail(&obj->next, &rpres_list);
@@ -160,6 +302,8 @@ static int __devexit rpres_remove(struct platform_device *pdev)
 	list_del(&obj->next);
 	spin_unlock(&rpres_lock);
 
+	cancel_delayed_work_sync(&obj->relax_work);
+	debugfs_remove(obj->dbg);
 	kfree(obj);
 
 	return 0;
@@ -191,6 +335,10 @@ static struct platform_driver omap_rpres_driver = {
 
 static int __init rpres_init(void)
 {
+	rpres_dbg = debugfs_create_dir("rpres", NULL);
+	if (IS_ERR(rpres_dbg))
+		rpres_dbg = NULL;
+
 	return platform_driver_register(&omap_rpres_driver);
 }
 late_initcall(rpres_init);
@@ -198,6 +346,7 @@ late_initcall(rpres_init);
 static void __exit rpres_exit(void)
 {
 	platform_driver_unregister(&omap_rpres_driver);
+	debugfs_remove(rpres_dbg);
 }
 module_exit(rpres_exit);
 
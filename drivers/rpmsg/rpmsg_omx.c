@@ -35,6 +35,9 @@
 #include <linux/rpmsg.h>
 #include <linux/rpmsg_omx.h>
 #include <linux/completion.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
 
 #include <mach/tiler.h>
 
@@ -48,6 +51,9 @@ extern struct ion_device *omap_ion_device;
 /* maximum OMX devices this driver can handle */
 #define MAX_OMX_DEVICES		8
 
+/* buckets of the per-instance ion handle to da map */
+#define OMX_BUF_HASH_BITS	5
+
 enum rpc_omx_map_info_type {
 	RPC_OMX_MAP_INFO_NONE          = 0,
 	RPC_OMX_MAP_INFO_ONE_BUF       = 1,
@@ -88,9 +94,20 @@ struct rpmsg_omx_instance {
 	int state;
 #ifdef CONFIG_ION_OMAP
 	struct ion_client *ion_client;
+	/* da of the ion handles seen in messages, until they are freed */
+	spinlock_t buf_lock;
+	struct hlist_head bufs[1 << OMX_BUF_HASH_BITS];
 #endif
 };
 
+#ifdef CONFIG_ION_OMAP
+struct rpmsg_omx_buf {
+	struct hlist_node node;
+	long handle;
+	u32 da;
+};
+#endif
+
 static struct class *rpmsg_omx_class;
 static dev_t rpmsg_omx_dev;
 
@@ -128,6 +145,87 @@ static int _rpmsg_pa_to_da(u32 pa, u32 *da)
 	return ret;
 }
 
+#ifdef CONFIG_ION_OMAP
+static struct rpmsg_omx_buf *_rpmsg_omx_buf_find(
+			struct rpmsg_omx_instance *omx, long handle)
+{
+	struct hlist_head *head;
+	struct hlist_node *pos;
+	struct rpmsg_omx_buf *b;
+
+	head = &omx->bufs[hash_long(handle, OMX_BUF_HASH_BITS)];
+	hlist_for_each_entry(b, pos, head, node)
+		if (b->handle == handle)
+			return b;
+
+	return NULL;
+}
+
+static bool _rpmsg_omx_buf_cached(struct rpmsg_omx_instance *omx,
+					long handle, u32 *da)
+{
+	struct rpmsg_omx_buf *b;
+
+	spin_lock(&omx->buf_lock);
+	b = _rpmsg_omx_buf_find(omx, handle);
+	if (b)
+		*da = b->da;
+	spin_unlock(&omx->buf_lock);
+
+	return b != NULL;
+}
+
+static void _rpmsg_omx_buf_add(struct rpmsg_omx_instance *omx,
+					long handle, u32 da)
+{
+	struct rpmsg_omx_buf *b;
+
+	/* a miss only costs the next message another ion_phys() */
+	b = kmalloc(sizeof(*b), GFP_KERNEL);
+	if (!b)
+		return;
+	b->handle = handle;
+	b->da = da;
+
+	spin_lock(&omx->buf_lock);
+	if (_rpmsg_omx_buf_find(omx, handle)) {
+		spin_unlock(&omx->buf_lock);
+		kfree(b);
+		return;
+	}
+	hlist_add_head(&b->node,
+		       &omx->bufs[hash_long(handle, OMX_BUF_HASH_BITS)]);
+	spin_unlock(&omx->buf_lock);
+}
+
+static void _rpmsg_omx_buf_del(struct rpmsg_omx_instance *omx, long handle)
+{
+	struct rpmsg_omx_buf *b;
+
+	spin_lock(&omx->buf_lock);
+	b = _rpmsg_omx_buf_find(omx, handle);
+	if (b)
+		hlist_del(&b->node);
+	spin_unlock(&omx->buf_lock);
+
+	kfree(b);
+}
+
+static void _rpmsg_omx_buf_flush(struct rpmsg_omx_instance *omx)
+{
+	struct hlist_node *pos, *n;
+	struct rpmsg_omx_buf *b;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(omx->bufs); i++) {
+		hlist_for_each_entry_safe(b, pos, n, &omx->bufs[i], node) {
+			hlist_del(&b->node);
+			kfree(b);
+		}
+	}
+}
+#endif
+
 static int _rpmsg_omx_buffer_lookup(struct rpmsg_omx_instance *omx,
 					long buffer, u32 *va, u32 *va2)
 {
@@ -142,10 +240,20 @@ static int _rpmsg_omx_buffer_lookup(struct rpmsg_omx_instance *omx,
 		ion_phys_addr_t paddr;
 		size_t unused;
 
+		/*
+		 * Handles are imported into our own client and only go away
+		 * through OMX_IOCIONUNREGISTER or release, both of which drop
+		 * them from the map, so a hit needs no call into ion.
+		 */
+		if (_rpmsg_omx_buf_cached(omx, buffer, va))
+			return 0;
+
 		/* is it an ion handle? */
 		handle = (struct ion_handle *)buffer;
 		if (!ion_phys(omx->ion_client, handle, &paddr, &unused)) {
 			ret = _rpmsg_pa_to_da((phys_addr_t)paddr, va);
+			if (!ret)
+				_rpmsg_omx_buf_add(omx, buffer, *va);
 			goto exit;
 		}
 
@@ -420,6 +528,7 @@ long rpmsg_omx_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 				_IOC_NR(cmd), ret);
 			return -EFAULT;
 		}
+		_rpmsg_omx_buf_del(omx, (long)data.handle);
 		ion_free(omx->ion_client, data.handle);
 		if (copy_to_user(&data, (char __user *) arg, sizeof(data))) {
 			dev_err(omxserv->dev,
@@ -459,6 +568,9 @@ static int rpmsg_omx_open(struct inode *inode, struct file *filp)
 	init_waitqueue_head(&omx->readq);
 	omx->omxserv = omxserv;
 	omx->state = OMX_UNCONNECTED;
+#ifdef CONFIG_ION_OMAP
+	spin_lock_init(&omx->buf_lock);
+#endif
 
 	/* assign a new, unique, local address and associate omx with it */
 	omx->ept = rpmsg_create_ept(omxserv->rpdev, rpmsg_omx_cb, omx,
@@ -523,6 +635,7 @@ static int rpmsg_omx_release(struct inode *inode, struct file *filp)
 	rpmsg_destroy_ept(omx->ept);
 out:
 #ifdef CONFIG_ION_OMAP
+	_rpmsg_omx_buf_flush(omx);
 	ion_client_destroy(omx->ion_client);
 #endif
 	mutex_lock(&omxserv->lock);
@@ -536,26 +536,15 @@ out:
 }
 EXPORT_SYMBOL(rpmsg_send_offchannel_raw);
 
-static void rpmsg_recv_done(struct virtqueue *rvq)
+static int rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
+			     struct rpmsg_hdr *msg, unsigned int len)
 {
-	struct rpmsg_hdr *msg;
-	unsigned int len;
 	struct rpmsg_endpoint *ept;
 	struct scatterlist sg;
 	unsigned long offset;
 	void *sim_addr;
-	struct virtproc_info *vrp = rvq->vdev->priv;
-	struct device *dev = &rvq->vdev->dev;
 	int err;
 
-	/* make sure the descriptors are updated before reading */
-	rmb();
-	msg = virtqueue_get_buf(rvq, &len);
-	if (!msg) {
-		dev_err(dev, "uhm, incoming signal, but no used buffer ?\n");
-		return;
-	}
-
 	dev_dbg(dev, "From: 0x%x, To: 0x%x, Len: %d, Flags: %d, Unused: %d\n",
 					msg->src, msg->dst, msg->len,
 					msg->flags, msg->unused);
@@ -582,12 +571,55 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 	err = virtqueue_add_buf_gfp(vrp->rvq, &sg, 0, 1, msg, GFP_KERNEL);
 	if (err < 0) {
 		dev_err(dev, "failed to add a virtqueue buffer: %d\n", err);
+		return err;
+	}
+
+	return 0;
+}
+
+/*
+ * The remote processor raises one mailbox interrupt per message, but
+ * by the time we get here several may be sitting in the vring.  Handle
+ * all of them and hand the buffers back with a single kick; the
+ * interrupts of the messages already consumed then find an empty vring
+ * and stop in vring_interrupt().
+ */
+static void rpmsg_recv_done(struct virtqueue *rvq)
+{
+	struct rpmsg_hdr *msg;
+	unsigned int len, msgs_received = 0;
+	struct virtproc_info *vrp = rvq->vdev->priv;
+	struct device *dev = &rvq->vdev->dev;
+	int err;
+
+	/* make sure the descriptors are updated before reading */
+	rmb();
+	msg = virtqueue_get_buf(rvq, &len);
+	if (!msg) {
+		dev_err(dev, "uhm, incoming signal, but no used buffer ?\n");
 		return;
 	}
+
+	while (msg) {
+		err = rpmsg_recv_single(vrp, dev, msg, len);
+		if (err)
+			break;
+
+		msgs_received++;
+
+		rmb();
+		msg = virtqueue_get_buf(rvq, &len);
+	}
+
+	dev_dbg(dev, "Received %u messages\n", msgs_received);
+
+	if (!msgs_received)
+		return;
+
 	/* descriptors must be written before kicking remote processor */
 	wmb();
 
-	/* tell the remote processor we added another available rx buffer */
+	/* tell the remote processor we added more available rx buffers */
 	virtqueue_kick(vrp->rvq);
 }
 
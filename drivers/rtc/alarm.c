@@ -36,6 +36,13 @@ static int debug_mask = ANDROID_ALARM_PRINT_ERROR | \
 			ANDROID_ALARM_PRINT_INIT_STATUS;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Non-wakeup alarms may be late by this much, so they can expire along
+ * with other timers and alarms rather than waking the cpu on their own.
+ */
+static unsigned int batch_ms = 1000;
+module_param_named(batch_ms, batch_ms, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #define pr_alarm(debug_level_mask, args...) \
 	do { \
 		if (debug_mask & ANDROID_ALARM_PRINT_##debug_level_mask) { \
@@ -168,10 +175,20 @@ void alarm_init(struct alarm *alarm,
  * @alarm:	the alarm to be added
  * @start:	earliest expiry time
  * @end:	expiry time
+ *
+ * For the non-wakeup types @end is pushed out to at least batch_ms after
+ * @start.
  */
 void alarm_start_range(struct alarm *alarm, ktime_t start, ktime_t end)
 {
 	unsigned long flags;
+	ktime_t batch_end;
+
+	if (!((1U << alarm->type) & ANDROID_ALARM_WAKEUP_MASK)) {
+		batch_end = ktime_add_ns(start, (u64)batch_ms * NSEC_PER_MSEC);
+		if (batch_end.tv64 > end.tv64)
+			end = batch_end;
+	}
 
 	spin_lock_irqsave(&alarm_slock, flags);
 	alarm->softexpires = start;
@@ -123,9 +123,14 @@ struct omap2_mcspi_dma {
 };
 
 /* use PIO for small transfers, avoiding DMA setup/teardown overhead and
- * cache operations; better heuristics consider wordsize and bitrate.
+ * cache operations.  PIO busy-waits for every word though, so what
+ * matters is how long the words take on the wire: anything longer
+ * than DMA_MIN_USECS goes by DMA and waits for its completion irq.
+ * The DMA path reads the last words by PIO, so it needs a few of them.
  */
 #define DMA_MIN_BYTES			160
+#define DMA_MIN_USECS			50
+#define DMA_MIN_TIMED_BYTES		16
 
 
 struct omap2_mcspi {
@@ -438,8 +443,28 @@ static int mcspi_wait_for_reg_bit(void __iomem *reg, unsigned long bit)
 	return 0;
 }
 
+/* whether t goes by DMA; the same answer in transfer() and the work */
+static int omap2_mcspi_use_dma(struct spi_device *spi, struct spi_message *m,
+			       struct spi_transfer *t)
+{
+	struct omap2_mcspi *mcspi = spi_master_get_devdata(spi->master);
+	u32 speed_hz = t->speed_hz ? t->speed_hz : spi->max_speed_hz;
+
+	if (m->is_dma_mapped || mcspi->dma_mode || t->len >= DMA_MIN_BYTES)
+		return 1;
+
+	/* the slave does not know the clock, keep it as it was */
+	if (mcspi->mcspi_mode != OMAP2_MCSPI_MASTER || !speed_hz ||
+	    t->len < DMA_MIN_TIMED_BYTES)
+		return 0;
+
+	speed_hz = min_t(u32, speed_hz, OMAP2_MCSPI_MAX_FREQ);
+	return (u64)t->len * 8 * USEC_PER_SEC > (u64)speed_hz * DMA_MIN_USECS;
+}
+
 static unsigned
-omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
+omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer,
+		     int mapped)
 {
 	struct omap2_mcspi	*mcspi;
 	struct omap2_mcspi_cs	*cs = spi->controller_state;
@@ -605,7 +630,9 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 		  omap2_mcspi_set_txfifo(spi, count, bytes_per_transfer, 0);
 		 }
 		}
-		dma_unmap_single(NULL, xfer->tx_dma, count, DMA_TO_DEVICE);
+		if (!mapped)
+			dma_unmap_single(NULL, xfer->tx_dma, count,
+					DMA_TO_DEVICE);
 	}
 
 	if (rx != NULL) {
@@ -617,8 +644,9 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 			omap2_mcspi_set_dma_req(spi, 1, 0);
 			count = 0;
 			omap_stop_dma(mcspi_dma->dma_rx_channel);
-			dma_unmap_single(NULL, xfer->rx_dma, count,
-					DMA_FROM_DEVICE);
+			if (!mapped)
+				dma_unmap_single(NULL, xfer->rx_dma, count,
+						DMA_FROM_DEVICE);
 			dev_err(&spi->dev, "DMA rx timeout\n");
 			offset_rx = omap_get_dma_dst_pos\
 					(mcspi_dma->dma_rx_channel);
@@ -638,7 +666,9 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 				OMAP2_MCSPI_IRQ_EOW);
 		}
 
-		dma_unmap_single(NULL, xfer->rx_dma, count, DMA_FROM_DEVICE);
+		if (!mapped)
+			dma_unmap_single(NULL, xfer->rx_dma, count,
+					DMA_FROM_DEVICE);
 		omap2_mcspi_set_enable(spi, 0);
 		/*
 		 * Reading last word in PIO mode not required when FIFO is
@@ -1239,10 +1269,9 @@ static void omap2_mcspi_work(struct work_struct *work)
 					__raw_writel(0, cs->base
 							+ OMAP2_MCSPI_TX0);
 
-				if (m->is_dma_mapped ||
-					t->len >= DMA_MIN_BYTES ||
-					mcspi->dma_mode)
-					count = omap2_mcspi_txrx_dma(spi, t);
+				if (omap2_mcspi_use_dma(spi, m, t))
+					count = omap2_mcspi_txrx_dma(spi, t,
+							m->is_dma_mapped);
 				else
 					count = omap2_mcspi_txrx_pio(spi, t);
 				m->actual_length += count;
@@ -1337,8 +1366,7 @@ static int omap2_mcspi_transfer(struct spi_device *spi, struct spi_message *m)
 				return -EINVAL;
 		}
 
-		if (m->is_dma_mapped || ((len < DMA_MIN_BYTES) &&
-					(!mcspi->dma_mode)))
+		if (m->is_dma_mapped || !omap2_mcspi_use_dma(spi, m, t))
 			continue;
 
 		if (tx_buf != NULL) {
@@ -20,7 +20,9 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -33,10 +35,14 @@
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
 #include <linux/vmalloc.h>
 
 #include "binder.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
+
 static DEFINE_MUTEX(binder_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
 
@@ -106,6 +112,27 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static int binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+static int binder_latency_stats;
+module_param_named(latency_stats, binder_latency_stats, bool,
+		   S_IWUSR | S_IRUGO);
+
+/* let synchronous calls from SCHED_FIFO/SCHED_RR threads raise the callee */
+static int binder_inherit_rt = 1;
+module_param_named(inherit_rt, binder_inherit_rt, bool, S_IWUSR | S_IRUGO);
+
+/*
+ * Transactions of a process taking this long on average are worth a
+ * looper each, so bursts of them get several spawned at once.
+ */
+static uint binder_spawn_service_us = 1000;
+module_param_named(spawn_service_us, binder_spawn_service_us, uint,
+		   S_IWUSR | S_IRUGO);
+
+/* spawned loopers idle this long are told to exit, 0 to keep them */
+static uint binder_idle_exit_ms = 10000;
+module_param_named(idle_exit_ms, binder_idle_exit_ms, uint,
+		   S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -148,7 +175,7 @@ enum binder_stat_types {
 
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
+	int bc[_IOC_NR(BC_REPLY_IOV) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
 };
@@ -185,6 +212,24 @@ struct binder_transaction_log {
 static struct binder_transaction_log binder_transaction_log;
 static struct binder_transaction_log binder_transaction_log_failed;
 
+/*
+ * Latency histograms, kept per target proc and transaction code while
+ * the latency_stats parameter is set.  Bucket i counts transactions that
+ * took [2^i, 2^(i+1)) us, the last one everything slower.  "queued" is
+ * from BC_TRANSACTION to the target thread picking it up, "exec" from
+ * there to BC_REPLY.  The last slot of a proc takes the codes that do
+ * not fit and has code ~0.
+ */
+#define BINDER_LAT_BUCKETS	16
+#define BINDER_LAT_CODES	16
+
+struct binder_lat_hist {
+	uint32_t code;
+	uint32_t count;
+	uint32_t queued[BINDER_LAT_BUCKETS];
+	uint32_t exec[BINDER_LAT_BUCKETS];
+};
+
 static struct binder_transaction_log_entry *binder_transaction_log_add(
 	struct binder_transaction_log *log)
 {
@@ -199,6 +244,14 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	return e;
 }
 
+static void binder_lat_add(uint32_t *hist, ktime_t start, ktime_t end)
+{
+	s64 us = ktime_us_delta(end, start);
+	int b = us > 1 ? ilog2(us) : 0;
+
+	hist[min(b, BINDER_LAT_BUCKETS - 1)]++;
+}
+
 struct binder_work {
 	struct list_head entry;
 	enum {
@@ -211,6 +264,19 @@ struct binder_work {
 	} type;
 };
 
+/*
+ * A thread's scheduling policy and its priority in the scheduler's own
+ * scale (0..MAX_RT_PRIO-1 real time, then nice -20..19), lower is more
+ * important.  This is task->normal_prio, so without any PI boost.
+ */
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
+};
+
+#define BINDER_NICE_TO_PRIO(nice)	(MAX_RT_PRIO + (nice) + 20)
+#define BINDER_PRIO_TO_NICE(prio)	((prio) - MAX_RT_PRIO - 20)
+
 struct binder_node {
 	int debug_id;
 	struct binder_work work;
@@ -280,6 +346,21 @@ enum binder_deferred_state {
 	BINDER_DEFERRED_RELEASE      = 0x04,
 };
 
+/*
+ * A page of a proc's buffer space.  Pages that only back free buffer
+ * space stay mapped on binder_lru so the next allocation there can reuse
+ * them, until the shrinker takes them back.
+ */
+struct binder_lru_page {
+	struct list_head lru;
+	struct page *page_ptr;
+	struct binder_proc *proc;
+};
+
+static LIST_HEAD(binder_lru);
+static DEFINE_SPINLOCK(binder_lru_lock);
+static unsigned long binder_lru_count;
+
 struct binder_proc {
 	struct hlist_node proc_node;
 	struct rb_root threads;
@@ -300,9 +381,14 @@ struct binder_proc {
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 
-	struct page **pages;
+	struct binder_lru_page *pages;
 	size_t buffer_size;
 	uint32_t buffer_free;
+	struct mutex alloc_lock;
+	int tmp_ref;
+	unsigned dead:1;
+	struct binder_lat_hist *lat;
+	int lat_used;
 	struct list_head todo;
 	wait_queue_head_t wait;
 	struct binder_stats stats;
@@ -311,10 +397,38 @@ struct binder_proc {
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	/* running averages, scaled by BINDER_AVG_SCALE */
+	int backlog_avg;	/* proc work queued when a looper takes one */
+	int service_avg_us;	/* time a looper spends on proc work */
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
 };
 
+static struct binder_lat_hist *binder_lat_hist_get(struct binder_proc *proc,
+						   uint32_t code)
+{
+	struct binder_lat_hist *h;
+	int i;
+
+	if (proc->lat == NULL) {
+		proc->lat = kcalloc(BINDER_LAT_CODES, sizeof(*proc->lat),
+				    GFP_KERNEL);
+		if (proc->lat == NULL)
+			return NULL;
+	}
+	for (i = 0; i < proc->lat_used; i++)
+		if (proc->lat[i].code == code)
+			return &proc->lat[i];
+	if (proc->lat_used < BINDER_LAT_CODES - 1) {
+		h = &proc->lat[proc->lat_used++];
+		h->code = code;
+		return h;
+	}
+	h = &proc->lat[BINDER_LAT_CODES - 1];
+	h->code = ~0U;
+	return h;
+}
+
 enum {
 	BINDER_LOOPER_STATE_REGISTERED  = 0x01,
 	BINDER_LOOPER_STATE_ENTERED     = 0x02,
@@ -337,6 +451,7 @@ struct binder_thread {
 		/* we are also waiting on */
 	wait_queue_head_t wait;
 	struct binder_stats stats;
+	ktime_t proc_work_start;
 };
 
 struct binder_transaction {
@@ -353,9 +468,11 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	uid_t	sender_euid;
+	ktime_t	send_time;	/* only with latency_stats */
+	ktime_t	dequeue_time;
 };
 
 struct binder_stats_data {
@@ -535,6 +652,78 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static bool binder_is_rt_policy(unsigned int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static struct binder_priority binder_get_priority(struct task_struct *task)
+{
+	struct binder_priority p = {
+		.sched_policy = task->policy,
+		.prio = task->normal_prio,
+	};
+
+	return p;
+}
+
+static void binder_set_priority(struct binder_priority desired)
+{
+	struct sched_param params;
+
+	if (binder_is_rt_policy(desired.sched_policy)) {
+		if (current->policy == desired.sched_policy &&
+		    current->normal_prio == desired.prio)
+			return;
+		/* a borrowed priority must not leak into children */
+		params.sched_priority = MAX_RT_PRIO - 1 - desired.prio;
+		sched_setscheduler_nocheck(current, desired.sched_policy |
+					   SCHED_RESET_ON_FORK, &params);
+		return;
+	}
+
+	if (binder_is_rt_policy(current->policy)) {
+		params.sched_priority = 0;
+		sched_setscheduler_nocheck(current, desired.sched_policy,
+					   &params);
+	}
+	binder_set_nice(BINDER_PRIO_TO_NICE(desired.prio));
+}
+
+/*
+ * Called by the thread picking up @t.  A synchronous call runs at the
+ * caller's policy and priority, or at the node's minimum priority if
+ * that is higher; a one way call is only raised to the node's minimum.
+ * The thread's own priority is saved in @t and restored on reply.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
+{
+	struct binder_priority desired = t->priority;
+	struct binder_priority node_prio = {
+		.sched_policy = SCHED_NORMAL,
+		.prio = BINDER_NICE_TO_PRIO(node->min_priority),
+	};
+
+	t->saved_priority = binder_get_priority(current);
+
+	if (t->flags & TF_ONE_WAY) {
+		if (t->saved_priority.prio <= node_prio.prio)
+			return;
+		desired = node_prio;
+	} else {
+		if (binder_is_rt_policy(desired.sched_policy) &&
+		    !binder_inherit_rt) {
+			desired.sched_policy = SCHED_NORMAL;
+			desired.prio = BINDER_NICE_TO_PRIO(0);
+		}
+		if (node_prio.prio < desired.prio)
+			desired = node_prio;
+	}
+
+	binder_set_priority(desired);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -627,6 +816,28 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 	return NULL;
 }
 
+static void binder_lru_add(struct binder_lru_page *page)
+{
+	spin_lock(&binder_lru_lock);
+	list_add_tail(&page->lru, &binder_lru);
+	binder_lru_count++;
+	spin_unlock(&binder_lru_lock);
+}
+
+static bool binder_lru_del(struct binder_lru_page *page)
+{
+	bool on_lru;
+
+	spin_lock(&binder_lru_lock);
+	on_lru = !list_empty(&page->lru);
+	if (on_lru) {
+		list_del_init(&page->lru);
+		binder_lru_count--;
+	}
+	spin_unlock(&binder_lru_lock);
+	return on_lru;
+}
+
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				    void *start, void *end,
 				    struct vm_area_struct *vma)
@@ -634,8 +845,8 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	void *page_addr;
 	unsigned long user_page_addr;
 	struct vm_struct tmp_area;
-	struct page **page;
-	struct mm_struct *mm;
+	struct binder_lru_page *page;
+	struct mm_struct *mm = NULL;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: %s pages %p-%p\n", proc->pid,
@@ -644,9 +855,10 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	if (end <= start)
 		return 0;
 
-	if (vma)
-		mm = NULL;
-	else
+	if (allocate == 0)
+		goto free_range;
+
+	if (!vma)
 		mm = get_task_mm(proc->tsk);
 
 	if (mm) {
@@ -654,9 +866,6 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		vma = proc->vma;
 	}
 
-	if (allocate == 0)
-		goto free_range;
-
 	if (vma == NULL) {
 		printk(KERN_ERR "binder: %d: binder_alloc_buf failed to "
 		       "map pages in userspace, no vma\n", proc->pid);
@@ -668,16 +877,22 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
-		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
-		if (*page == NULL) {
+		if (page->page_ptr) {
+			/* still mapped from before, take it off the lru */
+			bool on_lru = binder_lru_del(page);
+
+			WARN_ON(!on_lru);
+			continue;
+		}
+		page->page_ptr = alloc_page(GFP_KERNEL | __GFP_ZERO);
+		if (page->page_ptr == NULL) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
 			       "for page at %p\n", proc->pid, page_addr);
 			goto err_alloc_page_failed;
 		}
 		tmp_area.addr = page_addr;
 		tmp_area.size = PAGE_SIZE + PAGE_SIZE /* guard page? */;
-		page_array_ptr = page;
+		page_array_ptr = &page->page_ptr;
 		ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
 		if (ret) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
@@ -687,7 +902,7 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		}
 		user_page_addr =
 			(uintptr_t)page_addr + proc->user_buffer_offset;
-		ret = vm_insert_page(vma, user_page_addr, page[0]);
+		ret = vm_insert_page(vma, user_page_addr, page->page_ptr);
 		if (ret) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
 			       "to map page at %lx in userspace\n",
@@ -703,20 +918,27 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	return 0;
 
 free_range:
+	/*
+	 * Pages are not given back here but kept mapped on the lru, where
+	 * the next allocation finds them or the shrinker frees them.  On
+	 * an allocation error the pages this call already set up go there
+	 * too; only the one that failed is undone.
+	 */
 	for (page_addr = end - PAGE_SIZE; page_addr >= start;
 	     page_addr -= PAGE_SIZE) {
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-		if (vma)
-			zap_page_range(vma, (uintptr_t)page_addr +
-				proc->user_buffer_offset, PAGE_SIZE, NULL);
+		binder_lru_add(page);
+		continue;
 err_vm_insert_page_failed:
 		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
 err_map_kernel_failed:
-		__free_page(*page);
-		*page = NULL;
+		__free_page(page->page_ptr);
+		page->page_ptr = NULL;
 err_alloc_page_failed:
 		;
 	}
+	if (allocate == 0)
+		return 0;
 err_no_vma:
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -725,9 +947,86 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+/*
+ * Unmap and free one lru page.  Called with binder_lru_lock held and
+ * @page first on the lru; drops the lock.  Everything that can block is
+ * only tried, reclaim must not wait for binder.
+ */
+static bool binder_shrink_page(struct binder_lru_page *page)
+{
+	struct binder_proc *proc = page->proc;
+	struct mm_struct *mm = NULL;
+	void *page_addr;
+
+	/* proc cannot go away while its page is on the lru */
+	if (!mutex_trylock(&proc->alloc_lock)) {
+		list_move_tail(&page->lru, &binder_lru);
+		spin_unlock(&binder_lru_lock);
+		return false;
+	}
+	list_del_init(&page->lru);
+	binder_lru_count--;
+	spin_unlock(&binder_lru_lock);
+
+	page_addr = proc->buffer + (page - proc->pages) * PAGE_SIZE;
+	if (proc->vma) {
+		mm = get_task_mm(proc->tsk);
+		if (mm && !down_write_trylock(&mm->mmap_sem)) {
+			mmput(mm);
+			binder_lru_add(page);
+			mutex_unlock(&proc->alloc_lock);
+			return false;
+		}
+	}
+
+	if (mm) {
+		if (proc->vma)
+			zap_page_range(proc->vma, (uintptr_t)page_addr +
+				proc->user_buffer_offset, PAGE_SIZE, NULL);
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+	unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+	__free_page(page->page_ptr);
+	page->page_ptr = NULL;
+	mutex_unlock(&proc->alloc_lock);
+
+	return true;
+}
+
+static int binder_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	unsigned long nr_to_scan = sc->nr_to_scan;
+	int nr_freed = 0;
+
+	if (nr_to_scan) {
+		spin_lock(&binder_lru_lock);
+		while (nr_to_scan-- && !list_empty(&binder_lru)) {
+			struct binder_lru_page *page = list_first_entry(
+				&binder_lru, struct binder_lru_page, lru);
+
+			if (binder_shrink_page(page))
+				nr_freed++;
+			spin_lock(&binder_lru_lock);
+		}
+		spin_unlock(&binder_lru_lock);
+
+		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+			     "binder: shrinker freed %d pages\n", nr_freed);
+	}
+
+	return min_t(unsigned long, binder_lru_count, INT_MAX);
+}
+
+static struct shrinker binder_shrinker = {
+	.shrink = binder_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -820,6 +1119,8 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
 	buffer->async_transaction = is_async;
+	/* a reused buffer must not be freed from user space while filled */
+	buffer->allow_user_free = 0;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
@@ -831,6 +1132,26 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+/*
+ * The allocator state of a proc (buffers, free_buffers, allocated_buffers,
+ * free_async_space and pages) belongs to proc->alloc_lock alone:
+ * binder_transaction() allocates into its target without binder_lock.
+ * Once the proc is released, nothing more is allocated from it.
+ */
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async)
+{
+	struct binder_buffer *buffer = NULL;
+
+	mutex_lock(&proc->alloc_lock);
+	if (!proc->dead)
+		buffer = __binder_alloc_buf(proc, data_size, offsets_size,
+					    is_async);
+	mutex_unlock(&proc->alloc_lock);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -888,8 +1209,8 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
@@ -943,6 +1264,140 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	mutex_lock(&proc->alloc_lock);
+	__binder_free_buf(proc, buffer);
+	mutex_unlock(&proc->alloc_lock);
+}
+
+/*
+ * Free the buffer space of a released proc, and the proc itself, once no
+ * transaction is copying into it any more.  Called with binder_lock held.
+ */
+static void binder_free_proc(struct binder_proc *proc)
+{
+	struct binder_transaction *t;
+	struct rb_node *n;
+	int buffers, page_count;
+
+	buffers = 0;
+	mutex_lock(&proc->alloc_lock);
+	while ((n = rb_first(&proc->allocated_buffers))) {
+		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
+							rb_node);
+		t = buffer->transaction;
+		if (t) {
+			t->buffer = NULL;
+			buffer->transaction = NULL;
+			printk(KERN_ERR "binder: release proc %d, "
+			       "transaction %d, not freed\n",
+			       proc->pid, t->debug_id);
+			/*BUG();*/
+		}
+		__binder_free_buf(proc, buffer);
+		buffers++;
+	}
+
+	page_count = 0;
+	if (proc->pages) {
+		int i;
+		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+			if (proc->pages[i].page_ptr) {
+				void *page_addr = proc->buffer + i * PAGE_SIZE;
+
+				/* free buffer space, not a leak */
+				if (binder_lru_del(&proc->pages[i])) {
+					unmap_kernel_range(
+						(unsigned long)page_addr,
+						PAGE_SIZE);
+					__free_page(proc->pages[i].page_ptr);
+					continue;
+				}
+				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+					     "binder_release: %d: "
+					     "page %d at %p not freed\n",
+					     proc->pid, i,
+					     page_addr);
+				unmap_kernel_range((unsigned long)page_addr,
+					PAGE_SIZE);
+				__free_page(proc->pages[i].page_ptr);
+				page_count++;
+			}
+		}
+		kfree(proc->pages);
+		vfree(proc->buffer);
+	}
+	mutex_unlock(&proc->alloc_lock);
+
+	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
+		     "binder_release: %d buffers %d, pages %d\n",
+		     proc->pid, buffers, page_count);
+
+	kfree(proc);
+}
+
+/*
+ * Drop a reference taken by binder_transaction() across its unlocked
+ * allocation and copy.  Returns nonzero if the proc was released
+ * meanwhile, in which case the last reference frees it.  Called with
+ * binder_lock held.
+ */
+static int binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	int dead = proc->dead;
+
+	if (--proc->tmp_ref == 0 && dead)
+		binder_free_proc(proc);
+	return dead;
+}
+
+/*
+ * Copy the payload of a transaction into its buffer in the target.  Runs
+ * without any lock: nobody else knows about the buffer yet, and the
+ * caller's tmp_ref on the target keeps binder_deferred_release() from
+ * freeing the buffer space under us.
+ */
+static int binder_copy_transaction_data(struct binder_buffer *buffer,
+					struct binder_transaction_data *tr,
+					const struct binder_iovec __user *iov,
+					size_t iov_count)
+{
+	struct binder_iovec frag;
+	uint8_t *data;
+	size_t *offp;
+	size_t left;
+
+	data = buffer->data;
+	offp = (size_t *)(data + ALIGN(tr->data_size, sizeof(void *)));
+	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size))
+		return -EFAULT;
+	if (iov == NULL) {
+		if (copy_from_user(data, tr->data.ptr.buffer, tr->data_size))
+			return -EFAULT;
+		return 0;
+	}
+
+	/* gather: one copy per fragment, straight into the target */
+	if (iov_count > UIO_MAXIOV)
+		return -EINVAL;
+	left = tr->data_size;
+	for (; iov_count; iov_count--, iov++) {
+		if (copy_from_user(&frag, iov, sizeof(frag)))
+			return -EFAULT;
+		if (frag.len > left)
+			return -EINVAL;
+		if (copy_from_user(data, frag.base, frag.len))
+			return -EFAULT;
+		data += frag.len;
+		left -= frag.len;
+	}
+	if (left)
+		return -EINVAL;
+	return 0;
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   void __user *ptr)
 {
@@ -1395,9 +1850,39 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/* the node a transaction of proc to handle goes to, if any */
+static struct binder_node *binder_get_target_node(struct binder_proc *proc,
+						  uint32_t handle)
+{
+	struct binder_ref *ref;
+
+	if (handle == 0)
+		return binder_context_mgr_node;
+	ref = binder_get_ref(proc, handle);
+	return ref ? ref->node : NULL;
+}
+
+/*
+ * A synchronous transaction goes to the thread of target_proc that is
+ * already waiting on our call stack, if there is one.
+ */
+static struct binder_thread *binder_stack_target_thread(
+	struct binder_thread *thread, struct binder_proc *target_proc)
+{
+	struct binder_thread *target_thread = NULL;
+	struct binder_transaction *tmp;
+
+	for (tmp = thread->transaction_stack; tmp; tmp = tmp->from_parent)
+		if (tmp->from && tmp->from->proc == target_proc)
+			target_thread = tmp->from;
+	return target_thread;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       const struct binder_iovec __user *iov,
+			       size_t iov_count)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
@@ -1410,6 +1895,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	int ret = 0;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1428,7 +1914,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1501,21 +1987,12 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
+			target_thread = binder_stack_target_thread(thread,
+								   target_proc);
 		}
 	}
-	if (target_thread) {
+	if (target_thread)
 		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1536,6 +2013,11 @@ static void binder_transaction(struct binder_proc *proc,
 	t->debug_id = ++binder_last_id;
 	e->debug_id = t->debug_id;
 
+	trace_binder_transaction(reply, t->debug_id, proc->pid, thread->pid,
+				 target_proc->pid,
+				 target_thread ? target_thread->pid : 0,
+				 tr->code, tr->flags);
+
 	if (reply)
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "binder: %d:%d BC_REPLY %d -> %d:%d, "
@@ -1562,34 +2044,78 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	t->priority = binder_get_priority(current);
+	if (binder_latency_stats)
+		t->send_time = ktime_get();
+
+	/*
+	 * Allocate and fill the buffer without binder_lock, so that other
+	 * transactions go on meanwhile.  tmp_ref keeps target_proc and its
+	 * buffer space around.  No node reference is held across this:
+	 * target_node is looked up again once the lock is back.
+	 */
+	target_proc->tmp_ref++;
+	mutex_unlock(&binder_lock);
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+	if (t->buffer)
+		ret = binder_copy_transaction_data(t->buffer, tr, iov,
+						   iov_count);
+	mutex_lock(&binder_lock);
+
+	if (target_proc->dead && t->buffer) {
+		binder_free_buf(target_proc, t->buffer);
+		t->buffer = NULL;
+	}
+	if (binder_proc_dec_tmpref(target_proc)) {
+		return_error = BR_DEAD_REPLY;
+		goto err_binder_alloc_buf_failed;
+	}
 	if (t->buffer == NULL) {
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
+
+	/* anything but our own stack and t may have changed meanwhile */
+	if (!reply) {
+		target_node = binder_get_target_node(proc, tr->target.handle);
+		if (target_node == NULL || target_node->proc != target_proc) {
+			return_error = BR_DEAD_REPLY;
+			goto err_dead_target_node;
+		}
+	}
 	t->buffer->target_node = target_node;
 	if (target_node)
 		binder_inc_node(target_node, 1, 0, NULL);
 
 	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
-	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+	if (ret) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
-			"data ptr\n", proc->pid, thread->pid);
+			"data or offsets ptr, %d\n", proc->pid, thread->pid,
+			ret);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("binder: %d:%d got transaction with invalid "
-			"offsets ptr\n", proc->pid, thread->pid);
-		return_error = BR_FAILED_REPLY;
-		goto err_copy_data_failed;
+	if (reply) {
+		if (in_reply_to->from != target_thread) {
+			return_error = BR_DEAD_REPLY;
+			goto err_dead_target_thread;
+		}
+	} else if (!(tr->flags & TF_ONE_WAY) && t->to_thread) {
+		target_thread = binder_stack_target_thread(thread, target_proc);
+		t->to_thread = target_thread;
+	}
+	if (target_thread) {
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
 	}
+
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
@@ -1737,6 +2263,15 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		if (in_reply_to->dequeue_time.tv64) {
+			struct binder_lat_hist *h;
+
+			h = binder_lat_hist_get(proc, in_reply_to->code);
+			if (h)
+				binder_lat_add(h->exec,
+					       in_reply_to->dequeue_time,
+					       ktime_get());
+		}
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -1768,8 +2303,10 @@ err_binder_get_ref_failed:
 err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
+err_dead_target_thread:
 err_copy_data_failed:
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
+err_dead_target_node:
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
 err_binder_alloc_buf_failed:
@@ -1953,7 +2490,9 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 			ptr += sizeof(void *);
 
+			mutex_lock(&proc->alloc_lock);
 			buffer = binder_buffer_lookup(proc, data_ptr);
+			mutex_unlock(&proc->alloc_lock);
 			if (buffer == NULL) {
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p no match\n",
@@ -1995,7 +2534,21 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, cmd == BC_REPLY,
+					   NULL, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_IOV:
+		case BC_REPLY_IOV: {
+			struct binder_transaction_data_iov tri;
+
+			if (copy_from_user(&tri, ptr, sizeof(tri)))
+				return -EFAULT;
+			ptr += sizeof(tri);
+			binder_transaction(proc, thread, &tri.tr,
+					   cmd == BC_REPLY_IOV,
+					   tri.iov, tri.iov_count);
 			break;
 		}
 
@@ -2038,6 +2591,12 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			binder_debug(BINDER_DEBUG_THREADS,
 				     "binder: %d:%d BC_EXIT_LOOPER\n",
 				     proc->pid, thread->pid);
+			/* a spawned looper leaving makes room for another */
+			if ((thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
+			     BINDER_LOOPER_STATE_EXITED |
+			     BINDER_LOOPER_STATE_INVALID)) ==
+			    BINDER_LOOPER_STATE_REGISTERED)
+				proc->requested_threads_started--;
 			thread->looper |= BINDER_LOOPER_STATE_EXITED;
 			break;
 
@@ -2211,6 +2770,87 @@ static int binder_has_thread_work(struct binder_thread *thread)
 		(thread->looper & BINDER_LOOPER_STATE_NEED_RETURN);
 }
 
+#define BINDER_AVG_SCALE	16
+#define BINDER_AVG_WEIGHT	8	/* new samples count for 1/8th */
+#define BINDER_SPAWN_MAX	4	/* BR_SPAWN_LOOPERs per read */
+
+static void binder_avg_add(int *avg, int sample)
+{
+	*avg += (sample * BINDER_AVG_SCALE - *avg) / BINDER_AVG_WEIGHT;
+}
+
+/* Transactions queued to the process as a whole, counting up to limit */
+static int binder_proc_backlog(struct binder_proc *proc, int limit)
+{
+	struct binder_work *w;
+	int count = 0;
+
+	list_for_each_entry(w, &proc->todo, entry) {
+		if (w->type != BINDER_WORK_TRANSACTION)
+			continue;
+		if (++count >= limit)
+			break;
+	}
+	return count;
+}
+
+/*
+ * Number of loopers to ask for. While transactions are short the threads
+ * already there keep up, and a looper is only asked for when none is
+ * idle. Once they take long, enough are asked for to cover what is
+ * queued, or the depth bursts have been reaching, plus a spare.
+ */
+static int binder_spawn_count(struct binder_proc *proc)
+{
+	int room = proc->max_threads - proc->requested_threads_started;
+	int want;
+
+	if (proc->requested_threads || room <= 0)
+		return 0;
+
+	if (proc->service_avg_us <
+	    binder_spawn_service_us * BINDER_AVG_SCALE)
+		return proc->ready_threads ? 0 : 1;
+
+	want = max(binder_proc_backlog(proc, room + proc->ready_threads),
+		   DIV_ROUND_UP(proc->backlog_avg, BINDER_AVG_SCALE));
+	want = want - proc->ready_threads + 1;
+
+	return clamp(want, 0, min(room, BINDER_SPAWN_MAX));
+}
+
+/*
+ * wait_event_interruptible_exclusive() with a timeout, -ETIMEDOUT when it
+ * expires. The caller must recheck for work under binder_lock then, in
+ * case a wakeup raced with the timeout.
+ */
+static int binder_wait_for_proc_work(struct binder_proc *proc,
+				     struct binder_thread *thread,
+				     long timeout)
+{
+	DEFINE_WAIT(wait);
+	int ret = 0;
+
+	for (;;) {
+		prepare_to_wait_exclusive(&proc->wait, &wait,
+					  TASK_INTERRUPTIBLE);
+		if (binder_has_proc_work(proc, thread))
+			break;
+		if (signal_pending(current)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		if (!timeout) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		timeout = schedule_timeout(timeout);
+	}
+	finish_wait(&proc->wait, &wait);
+
+	return ret;
+}
+
 static int binder_thread_read(struct binder_proc *proc,
 			      struct binder_thread *thread,
 			      void  __user *buffer, int size,
@@ -2221,6 +2861,7 @@ static int binder_thread_read(struct binder_proc *proc,
 
 	int ret = 0;
 	int wait_for_proc_work;
+	int spawn;
 
 	if (*consumed == 0) {
 		if (put_user(BR_NOOP, (uint32_t __user *)ptr))
@@ -2249,6 +2890,14 @@ retry:
 	}
 
 
+	if (wait_for_proc_work && thread->proc_work_start.tv64) {
+		s64 us = ktime_us_delta(ktime_get(), thread->proc_work_start);
+
+		binder_avg_add(&proc->service_avg_us,
+			       min_t(s64, us, USEC_PER_SEC));
+		thread->proc_work_start.tv64 = 0;
+	}
+
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
 	if (wait_for_proc_work)
 		proc->ready_threads++;
@@ -2263,10 +2912,14 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
+		} else if (binder_idle_exit_ms &&
+			   (thread->looper & BINDER_LOOPER_STATE_REGISTERED)) {
+			ret = binder_wait_for_proc_work(proc, thread,
+				msecs_to_jiffies(binder_idle_exit_ms));
 		} else
 			ret = wait_event_interruptible_exclusive(proc->wait, binder_has_proc_work(proc, thread));
 	} else {
@@ -2281,6 +2934,19 @@ retry:
 		proc->ready_threads--;
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
 
+	if (ret == -ETIMEDOUT) {
+		/*
+		 * A spawned looper idle for that long is not needed, unless
+		 * it is the last idle one. User space lets pool threads exit
+		 * on TIMED_OUT, and they then send BC_EXIT_LOOPER.
+		 */
+		if (binder_has_proc_work(proc, thread) || !proc->ready_threads)
+			goto retry;
+		binder_debug(BINDER_DEBUG_THREADS,
+			     "binder: %d:%d idle looper timed out\n",
+			     proc->pid, thread->pid);
+	}
+
 	if (ret)
 		return ret;
 
@@ -2303,6 +2969,14 @@ retry:
 		if (end - ptr < sizeof(tr) + 4)
 			break;
 
+		/* a looper taking work queued to the process */
+		if (w->type == BINDER_WORK_TRANSACTION &&
+		    list_empty(&thread->todo)) {
+			binder_avg_add(&proc->backlog_avg,
+				binder_proc_backlog(proc, proc->max_threads + 1));
+			thread->proc_work_start = ktime_get();
+		}
+
 		switch (w->type) {
 		case BINDER_WORK_TRANSACTION: {
 			t = container_of(w, struct binder_transaction, work);
@@ -2426,13 +3100,7 @@ retry:
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			binder_transaction_priority(t, target_node);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2467,6 +3135,8 @@ retry:
 		ptr += sizeof(tr);
 
 		binder_stat_br(proc, thread, cmd);
+		trace_binder_transaction_received(cmd == BR_REPLY, t->debug_id,
+						  proc->pid, thread->pid);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "binder: %d:%d %s %d %d:%d, cmd %d"
 			     "size %zd-%zd ptr %p-%p\n",
@@ -2478,6 +3148,18 @@ retry:
 			     t->buffer->data_size, t->buffer->offsets_size,
 			     tr.data.ptr.buffer, tr.data.ptr.offsets);
 
+		if (cmd == BR_TRANSACTION && t->send_time.tv64) {
+			struct binder_lat_hist *h;
+
+			h = binder_lat_hist_get(proc, t->code);
+			if (h) {
+				t->dequeue_time = ktime_get();
+				h->count++;
+				binder_lat_add(h->queued, t->send_time,
+					       t->dequeue_time);
+			}
+		}
+
 		list_del(&t->work.entry);
 		t->buffer->allow_user_free = 1;
 		if (cmd == BR_TRANSACTION && !(t->flags & TF_ONE_WAY)) {
@@ -2494,19 +3176,27 @@ retry:
 
 done:
 
-	*consumed = ptr - buffer;
-	if (proc->requested_threads + proc->ready_threads == 0 &&
-	    proc->requested_threads_started < proc->max_threads &&
-	    (thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
-	     BINDER_LOOPER_STATE_ENTERED)) /* the user-space code fails to */
-	     /*spawn a new thread if we leave this out */) {
-		proc->requested_threads++;
+	spawn = 0;
+	if (thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
+	    BINDER_LOOPER_STATE_ENTERED)) /* the user-space code fails to */
+		/*spawn a new thread if we leave this out */
+		spawn = binder_spawn_count(proc);
+	if (spawn) {
 		binder_debug(BINDER_DEBUG_THREADS,
-			     "binder: %d:%d BR_SPAWN_LOOPER\n",
-			     proc->pid, thread->pid);
+			     "binder: %d:%d BR_SPAWN_LOOPER x%d\n",
+			     proc->pid, thread->pid, spawn);
+		/* the first takes the place of the leading BR_NOOP */
 		if (put_user(BR_SPAWN_LOOPER, (uint32_t __user *)buffer))
 			return -EFAULT;
+		proc->requested_threads++;
+		while (--spawn && end - ptr >= sizeof(uint32_t)) {
+			if (put_user(BR_SPAWN_LOOPER, (uint32_t __user *)ptr))
+				return -EFAULT;
+			ptr += sizeof(uint32_t);
+			proc->requested_threads++;
+		}
 	}
+	*consumed = ptr - buffer;
 	return 0;
 }
 
@@ -2815,7 +3505,8 @@ err:
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
 	mutex_unlock(&binder_lock);
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
-	if (ret && ret != -ERESTARTSYS)
+	/* idle loopers timing out is routine */
+	if (ret && ret != -ERESTARTSYS && ret != -ETIMEDOUT)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
 	return ret;
 }
@@ -2850,7 +3541,7 @@ static struct vm_operations_struct binder_vm_ops = {
 
 static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 {
-	int ret;
+	int ret, i;
 	struct vm_struct *area;
 	struct binder_proc *proc = filp->private_data;
 	const char *failure_string;
@@ -2902,6 +3593,10 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 		goto err_alloc_pages_failed;
 	}
 	proc->buffer_size = vma->vm_end - vma->vm_start;
+	for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+		INIT_LIST_HEAD(&proc->pages[i].lru);
+		proc->pages[i].proc = proc;
+	}
 
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
@@ -2953,7 +3648,8 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
+	mutex_init(&proc->alloc_lock);
+	proc->default_priority = binder_get_priority(current);
 	mutex_lock(&binder_lock);
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
@@ -3012,9 +3708,8 @@ static int binder_release(struct inode *nodp, struct file *filp)
 static void binder_deferred_release(struct binder_proc *proc)
 {
 	struct hlist_node *pos;
-	struct binder_transaction *t;
 	struct rb_node *n;
-	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
+	int threads, nodes, incoming_refs, outgoing_refs, active_transactions;
 
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
@@ -3080,57 +3775,26 @@ static void binder_deferred_release(struct binder_proc *proc)
 		binder_delete_ref(ref);
 	}
 	binder_release_work(&proc->todo);
-	buffers = 0;
 
-	while ((n = rb_first(&proc->allocated_buffers))) {
-		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
-							rb_node);
-		t = buffer->transaction;
-		if (t) {
-			t->buffer = NULL;
-			buffer->transaction = NULL;
-			printk(KERN_ERR "binder: release proc %d, "
-			       "transaction %d, not freed\n",
-			       proc->pid, t->debug_id);
-			/*BUG();*/
-		}
-		binder_free_buf(proc, buffer);
-		buffers++;
-	}
+	/* keep out new allocations, copies under way free us when done */
+	mutex_lock(&proc->alloc_lock);
+	proc->dead = 1;
+	mutex_unlock(&proc->alloc_lock);
 
 	binder_stats_deleted(BINDER_STAT_PROC);
 
-	page_count = 0;
-	if (proc->pages) {
-		int i;
-		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
-			if (proc->pages[i]) {
-				void *page_addr = proc->buffer + i * PAGE_SIZE;
-				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-					     "binder_release: %d: "
-					     "page %d at %p not freed\n",
-					     proc->pid, i,
-					     page_addr);
-				unmap_kernel_range((unsigned long)page_addr,
-					PAGE_SIZE);
-				__free_page(proc->pages[i]);
-				page_count++;
-			}
-		}
-		kfree(proc->pages);
-		vfree(proc->buffer);
-	}
+	kfree(proc->lat);
 
 	put_task_struct(proc->tsk);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
 		     "binder_release: %d threads %d, nodes %d (ref %d), "
-		     "refs %d, active transactions %d, buffers %d, "
-		     "pages %d\n",
+		     "refs %d, active transactions %d\n",
 		     proc->pid, threads, nodes, incoming_refs, outgoing_refs,
-		     active_transactions, buffers, page_count);
+		     active_transactions);
 
-	kfree(proc);
+	if (!proc->tmp_ref)
+		binder_free_proc(proc);
 }
 
 static void binder_deferred_func(struct work_struct *work)
@@ -3191,13 +3855,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy, t->priority.prio,
+		   t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3348,9 +4013,11 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3399,7 +4066,9 @@ static const char *binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_IOV",
+	"BC_REPLY_IOV"
 };
 
 static const char *binder_objstat_strings[] = {
@@ -3463,6 +4132,10 @@ static void print_binder_proc_stats(struct seq_file *m,
 			"  free async space %zd\n", proc->requested_threads,
 			proc->requested_threads_started, proc->max_threads,
 			proc->ready_threads, proc->free_async_space);
+	seq_printf(m, "  backlog avg %d/%d\n"
+			"  service avg %dus\n",
+			proc->backlog_avg, BINDER_AVG_SCALE,
+			proc->service_avg_us / BINDER_AVG_SCALE);
 	count = 0;
 	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n))
 		count++;
@@ -3480,8 +4153,10 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	mutex_unlock(&proc->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
 
 	count = 0;
@@ -3536,6 +4211,7 @@ static int binder_stats_header(struct seq_file *m)
 {
 	seq_puts(m, "binder stats:\n");
 	print_binder_stats(m, "", &binder_stats);
+	seq_printf(m, "lru pages: %lu\n", binder_lru_count);
 	return 0;
 }
 
@@ -3702,13 +4378,16 @@ static int print_binder_proc_sub(struct seq_file *m, struct binder_proc *proc,
 			return 0;
 		}
 
+	mutex_lock(&proc->alloc_lock);
 	for (r = rb_first(&proc->allocated_buffers); r; r = rb_next(r))
 		if (cnt-- == 0) {
 			struct binder_buffer *b;
 			b = rb_entry(r, struct binder_buffer, rb_node);
 			print_binder_buffer(m, "  buffer", b);
+			mutex_unlock(&proc->alloc_lock);
 			return 0;
 		}
+	mutex_unlock(&proc->alloc_lock);
 
 	list_for_each_entry(w, &proc->todo, entry)
 		if (cnt-- == 0) {
@@ -3812,6 +4491,61 @@ static int binder_transaction_log_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+/*
+ * Binary dump of the latency histograms: a binder_lat_header followed by
+ * one binder_lat_record per (proc, code) seen, all in host byte order.
+ */
+#define BINDER_LAT_MAGIC	0x4c544e42	/* "BNTL" */
+#define BINDER_LAT_VERSION	1
+
+struct binder_lat_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t buckets;
+	uint32_t record_size;
+};
+
+struct binder_lat_record {
+	int32_t pid;
+	struct binder_lat_hist hist;
+};
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_lat_header hdr = {
+		.magic = BINDER_LAT_MAGIC,
+		.version = BINDER_LAT_VERSION,
+		.buckets = BINDER_LAT_BUCKETS,
+		.record_size = sizeof(struct binder_lat_record),
+	};
+	struct binder_lat_record rec;
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	int do_lock = !binder_debug_no_lock;
+	int i;
+
+	if (do_lock)
+		mutex_lock(&binder_lock);
+
+	seq_write(m, &hdr, sizeof(hdr));
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		if (proc->lat == NULL)
+			continue;
+		rec.pid = proc->pid;
+		for (i = 0; i < BINDER_LAT_CODES; i++) {
+			if (i >= proc->lat_used && i != BINDER_LAT_CODES - 1)
+				continue;
+			if (!proc->lat[i].count)
+				continue;
+			rec.hist = proc->lat[i];
+			seq_write(m, &rec, sizeof(rec));
+		}
+	}
+	if (do_lock)
+		mutex_unlock(&binder_lock);
+	return 0;
+}
+
 static const struct file_operations binder_fops = {
 	.owner = THIS_MODULE,
 	.poll = binder_poll,
@@ -3830,6 +4564,7 @@ static struct miscdevice binder_miscdev = {
 
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+BINDER_DEBUG_ENTRY(latency);
 
 static const struct seq_operations binder_stats_seq_ops = {
 	.start = binder_stats_seq_start,
@@ -3929,6 +4664,8 @@ static int __init binder_init(void)
 	if (!binder_deferred_workqueue)
 		return -ENOMEM;
 
+	register_shrinker(&binder_shrinker);
+
 	binder_debugfs_dir_entry_root = debugfs_create_dir("binder", NULL);
 	if (binder_debugfs_dir_entry_root)
 		binder_debugfs_dir_entry_proc = debugfs_create_dir("proc",
@@ -3960,6 +4697,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
 	return ret;
 }
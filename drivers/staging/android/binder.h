@@ -153,6 +153,19 @@ struct binder_transaction_data {
 	} data;
 };
 
+/* One fragment of the data of a BC_TRANSACTION_IOV or BC_REPLY_IOV */
+struct binder_iovec {
+	const void	*base;
+	size_t		len;
+};
+
+struct binder_transaction_data_iov {
+	/* data.ptr.buffer is ignored, the data is gathered from iov */
+	struct binder_transaction_data	tr;
+	const struct binder_iovec	*iov;
+	size_t				iov_count;
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -330,6 +343,15 @@ enum BinderDriverCommandProtocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_IOV = _IOW('c', 17, struct binder_transaction_data_iov),
+	BC_REPLY_IOV = _IOW('c', 18, struct binder_transaction_data_iov),
+	/*
+	 * Like BC_TRANSACTION and BC_REPLY, but the data is copied straight
+	 * from the fragments in iov to the target's buffer.  The fragment
+	 * lengths must add up to tr.data_size; the offsets are still
+	 * taken from tr.data.ptr.offsets.
+	 */
 };
 
 #endif /* _LINUX_BINDER_H */
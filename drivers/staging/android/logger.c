@@ -25,33 +25,62 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/reboot.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/vmalloc.h>
+#include <linux/lzo.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+#include <asm/kexec.h>
+#include <asm/setup.h>
+#endif
 
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * spinlock 'lock', which is only ever held to commit or copy out entries;
+ * nothing that touches user memory or sleeps may run under it.
  */
 struct logger_log {
 	unsigned char 		*buffer;/* the ring buffer itself */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
 	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
+	spinlock_t		lock;	/* spinlock protecting buffer */
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+	bool			read_only; /* left by the previous kernel */
+	bool			frozen;	/* handed over, drop new entries */
+#endif
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	u64			w_pos;	/* bytes ever written, ends at w_off */
+	size_t			a_off;	/* next entry to archive */
+	u64			a_pos;	/* a_off as a position like w_pos */
+	struct work_struct	a_work;	/* compresses the ring into a_chunks */
+	struct mutex		a_mutex; /* mutex protecting the archive */
+	struct list_head	a_chunks; /* compressed chunks, oldest first */
+	size_t			a_bytes; /* memory held by a_chunks */
+	size_t			a_max;	/* archive budget, zero if disabled */
+#endif
 };
 
 /*
  * struct logger_reader - a logging device open for reading
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. The structure is protected by log->lock, except for
+ * 'r_mode', 'buf' and the archive state, which are protected by 'mutex'.
+ * 'r_archive' is only changed with log->a_mutex held as well.
  */
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
@@ -59,8 +88,30 @@ struct logger_reader {
 	size_t			r_off;	/* current read head offset */
 	bool			r_all;	/* reader can read all entries */
 	int			r_ver;	/* reader ABI version */
+	int			r_mode;	/* LOGGER_READ_SINGLE or _BATCH */
+	struct mutex		mutex;	/* serializes read() on this reader */
+	unsigned char		*buf;	/* bounce buffer for one entry */
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	bool			r_archive; /* still reading the archive */
+	u64			r_pos;	/* archive read position */
+	unsigned char		*a_buf;	/* the last chunk decompressed */
+	u64			a_buf_pos; /* position of a_buf's chunk */
+	size_t			a_buf_len; /* zero if a_buf is not valid */
+#endif
 };
 
+/* the largest entry we ever write, also the largest one we ever read */
+#define LOGGER_ENTRY_MAX_LEN \
+	(sizeof(struct logger_entry) + LOGGER_ENTRY_MAX_PAYLOAD)
+
+/*
+ * Writers assemble their entry here with preemption disabled and then
+ * commit it to the log in one go, so log->lock is never held across a
+ * copy from user space.
+ */
+static DEFINE_PER_CPU_ALIGNED(unsigned char [LOGGER_ENTRY_MAX_LEN],
+			       logger_stage);
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 #define logger_offset(n)	((n) & (log->size - 1))
 
@@ -112,7 +163,7 @@ static struct logger_entry *get_entry_header(struct logger_log *log,
  * get_entry_msg_len - Grabs the length of the message of the entry
  * starting from from 'off'.
  *
- * Caller needs to hold log->mutex.
+ * Caller needs to hold log->lock.
  */
 static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
 {
@@ -131,8 +182,7 @@ static size_t get_user_hdr_len(int ver)
 		return sizeof(struct logger_entry);
 }
 
-static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
-					 char __user *buf)
+static size_t copy_header(int ver, struct logger_entry *entry, void *buf)
 {
 	void *hdr;
 	size_t hdr_len;
@@ -152,35 +202,37 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 		hdr_len     = sizeof(struct logger_entry);
 	}
 
-	return copy_to_user(buf, hdr, hdr_len);
+	memcpy(buf, hdr, hdr_len);
+	return hdr_len;
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log - reads exactly 'count' bytes from 'log' into the reader's
+ * bounce buffer, which the caller then copies to user space once it has
+ * dropped log->lock. Returns 'count'. The read head is left alone; the
+ * caller moves it past the entry once the copy has succeeded.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock and reader->mutex.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static ssize_t do_read_log(struct logger_log *log,
+			   struct logger_reader *reader,
+			   size_t count)
 {
 	struct logger_entry scratch;
 	struct logger_entry *entry;
+	unsigned char *buf = reader->buf;
+	size_t hdr_len;
 	size_t len;
 	size_t msg_start;
 
 	/*
-	 * First, copy the header to userspace, using the version of
-	 * the header requested
+	 * First, copy the header, using the version of the header requested
 	 */
 	entry = get_entry_header(log, reader->r_off, &scratch);
-	if (copy_header_to_user(reader->r_ver, entry, buf))
-		return -EFAULT;
+	hdr_len = copy_header(reader->r_ver, entry, buf);
 
-	count -= get_user_hdr_len(reader->r_ver);
-	buf += get_user_hdr_len(reader->r_ver);
+	count -= hdr_len;
+	buf += hdr_len;
 	msg_start = logger_offset(reader->r_off + sizeof(struct logger_entry));
 
 	/*
@@ -189,21 +241,16 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	 * the log, whichever comes first.
 	 */
 	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
-		return -EFAULT;
+	memcpy(buf, log->buffer + msg_start, len);
 
 	/*
 	 * Second, we read any remaining bytes, starting back at the head of
 	 * the log.
 	 */
 	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
-
-	reader->r_off = logger_offset(reader->r_off +
-		sizeof(struct logger_entry) + count);
+		memcpy(buf + len, log->buffer, count - len);
 
-	return count + get_user_hdr_len(reader->r_ver);
+	return count + hdr_len;
 }
 
 /*
@@ -230,6 +277,375 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
 	return off;
 }
 
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+/*
+ * struct logger_chunk - a run of whole entries compressed out of the ring,
+ * covering the log positions [pos, pos + len).
+ */
+struct logger_chunk {
+	struct list_head	list;	/* entry in logger_log's a_chunks */
+	u64			pos;	/* position of the first entry */
+	size_t			len;	/* uncompressed length */
+	size_t			clen;	/* compressed length */
+	unsigned char		data[0]; /* lzo1x compressed entries */
+};
+
+/* how much of the ring the archiver compresses at a time */
+#define LOGGER_CHUNK_SIZE	(16*1024)
+
+/* the archiver's scratch space, shared by all logs */
+static DEFINE_MUTEX(logger_archive_mutex);
+static unsigned char *logger_archive_raw;
+static unsigned char *logger_archive_lzo;
+static void *logger_archive_wrkmem;
+
+/*
+ * logger_archive_pending - bytes written to 'log' but not yet archived
+ *
+ * Caller needs to hold log->lock.
+ */
+static inline size_t logger_archive_pending(struct logger_log *log)
+{
+	return logger_offset(log->w_off - log->a_off);
+}
+
+/*
+ * logger_archive_take - copies up to LOGGER_CHUNK_SIZE bytes of whole
+ * entries starting at log->a_off out of the ring into 'buf', and stores
+ * the position of the first one in 'pos'. Returns the number of bytes
+ * copied, or zero if there is not yet a chunk's worth to take.
+ *
+ * Caller needs to hold log->lock.
+ */
+static size_t logger_archive_take(struct logger_log *log,
+				  unsigned char *buf, u64 *pos)
+{
+	size_t len = 0;
+
+	if (logger_archive_pending(log) < LOGGER_CHUNK_SIZE)
+		return 0;
+
+	*pos = log->a_pos;
+	while (log->a_off != log->w_off) {
+		size_t nr = sizeof(struct logger_entry) +
+			get_entry_msg_len(log, log->a_off);
+		size_t part;
+
+		if (len + nr > LOGGER_CHUNK_SIZE)
+			break;
+
+		part = min(nr, log->size - log->a_off);
+		memcpy(buf + len, log->buffer + log->a_off, part);
+		memcpy(buf + len + part, log->buffer, nr - part);
+
+		log->a_off = logger_offset(log->a_off + nr);
+		len += nr;
+	}
+	log->a_pos += len;
+
+	return len;
+}
+
+/*
+ * logger_archive_add - appends 'chunk' to the archive of 'log', dropping
+ * the oldest chunks to stay within budget
+ */
+static void logger_archive_add(struct logger_log *log,
+			       struct logger_chunk *chunk)
+{
+	mutex_lock(&log->a_mutex);
+	list_add_tail(&chunk->list, &log->a_chunks);
+	log->a_bytes += ksize(chunk);
+
+	while (log->a_bytes > log->a_max) {
+		chunk = list_first_entry(&log->a_chunks,
+					 struct logger_chunk, list);
+		list_del(&chunk->list);
+		log->a_bytes -= ksize(chunk);
+		kfree(chunk);
+	}
+	mutex_unlock(&log->a_mutex);
+}
+
+/*
+ * logger_archive_work - compresses the completed chunks of the ring before
+ * the writers lap them. Should we fall behind, the lapped entries are lost
+ * to the archive just as they are to a slow reader.
+ */
+static void logger_archive_work(struct work_struct *work)
+{
+	struct logger_log *log = container_of(work, struct logger_log, a_work);
+	struct logger_chunk *chunk;
+	size_t len, clen;
+	u64 pos;
+
+	mutex_lock(&logger_archive_mutex);
+
+	while (1) {
+		spin_lock(&log->lock);
+		len = logger_archive_take(log, logger_archive_raw, &pos);
+		spin_unlock(&log->lock);
+		if (!len)
+			break;
+
+		if (lzo1x_1_compress(logger_archive_raw, len,
+				     logger_archive_lzo, &clen,
+				     logger_archive_wrkmem) != LZO_E_OK)
+			continue;
+
+		chunk = kmalloc(sizeof(struct logger_chunk) + clen,
+				GFP_KERNEL);
+		if (!chunk)
+			continue;
+
+		chunk->pos = pos;
+		chunk->len = len;
+		chunk->clen = clen;
+		memcpy(chunk->data, logger_archive_lzo, clen);
+
+		logger_archive_add(log, chunk);
+	}
+
+	mutex_unlock(&logger_archive_mutex);
+}
+
+/*
+ * logger_archive_flush - drops the archive of 'log', along with anything
+ * in the ring that was still waiting to go into it
+ */
+static void logger_archive_flush(struct logger_log *log)
+{
+	struct logger_chunk *chunk, *tmp;
+
+	mutex_lock(&logger_archive_mutex);
+	mutex_lock(&log->a_mutex);
+
+	list_for_each_entry_safe(chunk, tmp, &log->a_chunks, list) {
+		list_del(&chunk->list);
+		kfree(chunk);
+	}
+	log->a_bytes = 0;
+
+	spin_lock(&log->lock);
+	log->a_off = log->w_off;
+	log->a_pos = log->w_pos;
+	spin_unlock(&log->lock);
+
+	mutex_unlock(&log->a_mutex);
+	mutex_unlock(&logger_archive_mutex);
+}
+
+/*
+ * logger_archive_done - points 'reader', which has read all of the
+ * archive, at the ring: at the entry it would have read next if that is
+ * still there, or else at the oldest one.
+ *
+ * Caller must hold log->a_mutex and reader->mutex.
+ */
+static void logger_archive_done(struct logger_log *log,
+				struct logger_reader *reader)
+{
+	u64 head_pos;
+
+	spin_lock(&log->lock);
+
+	/* the ring holds everything from its head up to w_pos */
+	head_pos = log->w_pos - logger_offset(log->w_off - log->head);
+	if (reader->r_pos >= head_pos)
+		reader->r_off = logger_offset(reader->r_pos);
+	else
+		reader->r_off = log->head;
+	reader->r_archive = false;
+
+	spin_unlock(&log->lock);
+}
+
+/*
+ * logger_load_chunk - decompresses 'chunk' into the reader's a_buf, unless
+ * it is already there
+ *
+ * Caller must hold log->a_mutex and reader->mutex.
+ */
+static int logger_load_chunk(struct logger_reader *reader,
+			     struct logger_chunk *chunk)
+{
+	size_t len = LOGGER_CHUNK_SIZE;
+
+	if (reader->a_buf_len && reader->a_buf_pos == chunk->pos)
+		return 0;
+
+	if (!reader->a_buf) {
+		reader->a_buf = kmalloc(LOGGER_CHUNK_SIZE, GFP_KERNEL);
+		if (!reader->a_buf)
+			return -ENOMEM;
+	}
+
+	reader->a_buf_len = 0;
+	if (lzo1x_decompress_safe(chunk->data, chunk->clen, reader->a_buf,
+				  &len) != LZO_E_OK || len != chunk->len)
+		return -EIO;
+
+	reader->a_buf_pos = chunk->pos;
+	reader->a_buf_len = len;
+
+	return 0;
+}
+
+/*
+ * logger_read_archive - the archive's counterpart to logger_read_entry().
+ * Returns zero once the reader has caught up with the ring, so that it can
+ * carry on there.
+ *
+ * Caller must hold reader->mutex.
+ */
+static ssize_t logger_read_archive(struct logger_log *log,
+				   struct logger_reader *reader,
+				   char __user *buf, size_t count)
+{
+	struct logger_chunk *chunk;
+	struct logger_entry *entry;
+	size_t hdr_len;
+	ssize_t ret;
+
+	mutex_lock(&log->a_mutex);
+
+	while (1) {
+		list_for_each_entry(chunk, &log->a_chunks, list)
+			if (chunk->pos + chunk->len > reader->r_pos)
+				break;
+
+		if (&chunk->list == &log->a_chunks) {
+			logger_archive_done(log, reader);
+			mutex_unlock(&log->a_mutex);
+			return 0;
+		}
+
+		/* whatever was before this chunk has been dropped */
+		if (reader->r_pos < chunk->pos)
+			reader->r_pos = chunk->pos;
+
+		ret = logger_load_chunk(reader, chunk);
+		if (unlikely(ret)) {
+			if (ret == -EIO)
+				reader->r_pos = chunk->pos + chunk->len;
+			goto out;
+		}
+
+		entry = (struct logger_entry *)
+			(reader->a_buf + (reader->r_pos - chunk->pos));
+		if (reader->r_all || entry->euid == current_euid())
+			break;
+
+		reader->r_pos += sizeof(struct logger_entry) + entry->len;
+	}
+
+	ret = get_user_hdr_len(reader->r_ver) + entry->len;
+	if (count < ret) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	hdr_len = copy_header(reader->r_ver, entry, reader->buf);
+	if (copy_to_user(buf, reader->buf, hdr_len) ||
+	    copy_to_user(buf + hdr_len, entry->msg, entry->len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	reader->r_pos += sizeof(struct logger_entry) + entry->len;
+
+out:
+	mutex_unlock(&log->a_mutex);
+
+	return ret;
+}
+
+/* may sleep, so must not be called with log->lock held */
+static bool logger_in_archive(struct logger_log *log,
+			      struct logger_reader *reader)
+{
+	bool ret;
+
+	mutex_lock(&log->a_mutex);
+	ret = reader->r_archive;
+	mutex_unlock(&log->a_mutex);
+
+	return ret;
+}
+#else
+static inline bool logger_in_archive(struct logger_log *log,
+				     struct logger_reader *reader)
+{
+	return false;
+}
+#endif
+
+/*
+ * logger_read_entry - copies the next entry readable by 'reader' to the
+ * user-space buffer 'buf' of 'count' bytes.
+ *
+ * Returns the size of the entry, zero if there is none, or a negative error
+ * code; -EINVAL leaves the entry in place. Caller must hold reader->mutex.
+ */
+static ssize_t logger_read_entry(struct logger_log *log,
+				 struct logger_reader *reader,
+				 char __user *buf, size_t count)
+{
+	size_t off, msg_len;
+	ssize_t ret;
+
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	if (reader->r_archive) {
+		ret = logger_read_archive(log, reader, buf, count);
+		if (ret)
+			return ret;
+	}
+#endif
+
+	spin_lock(&log->lock);
+
+	if (!reader->r_all)
+		reader->r_off = get_next_entry_by_uid(log,
+			reader->r_off, current_euid());
+
+	if (log->w_off == reader->r_off) {
+		spin_unlock(&log->lock);
+		return 0;
+	}
+
+	/* get the size of the next entry */
+	off = reader->r_off;
+	msg_len = get_entry_msg_len(log, off);
+	ret = get_user_hdr_len(reader->r_ver) + msg_len;
+	if (count < ret) {
+		spin_unlock(&log->lock);
+		return -EINVAL;
+	}
+
+	/* only a corrupt log handed over by kexec can get here, skip it */
+	if (unlikely(ret > LOGGER_ENTRY_MAX_LEN)) {
+		reader->r_off = log->w_off;
+		spin_unlock(&log->lock);
+		return -EIO;
+	}
+
+	/* get exactly one entry from the log */
+	ret = do_read_log(log, reader, ret);
+	spin_unlock(&log->lock);
+
+	if (copy_to_user(buf, reader->buf, ret))
+		return -EFAULT;
+
+	/* unless a writer lapped us meanwhile, step past the entry */
+	spin_lock(&log->lock);
+	if (reader->r_off == off)
+		reader->r_off = logger_offset(off +
+			sizeof(struct logger_entry) + msg_len);
+	spin_unlock(&log->lock);
+
+	return ret;
+}
+
 /*
  * logger_read - our log's read() method
  *
@@ -237,7 +653,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
  *
  * 	- O_NONBLOCK works
  * 	- If there are no log entries to read, blocks until log is written to
- * 	- Atomically reads exactly one log entry
+ * 	- Atomically reads exactly one log entry, or in LOGGER_READ_BATCH mode
+ * 	  as many whole entries as fit in the buffer
  *
  * Will set errno to EINVAL if read
  * buffer is insufficient to hold next entry.
@@ -247,16 +664,17 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 {
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
-	ssize_t ret;
+	ssize_t ret, nr;
 	DEFINE_WAIT(wait);
 
 start:
-	while (1) {
+	ret = 0;
+	while (!logger_in_archive(log, reader)) {
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 		if (!ret)
 			break;
 
@@ -277,31 +695,25 @@ start:
 	if (ret)
 		return ret;
 
-	mutex_lock(&log->mutex);
-
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
+	mutex_lock(&reader->mutex);
 
 	/* is there still something to read or did we race? */
-	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
+	ret = logger_read_entry(log, reader, buf, count);
+	if (unlikely(!ret)) {
+		mutex_unlock(&reader->mutex);
 		goto start;
 	}
 
-	/* get the size of the next entry */
-	ret = get_user_hdr_len(reader->r_ver) +
-		get_entry_msg_len(log, reader->r_off);
-	if (count < ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	/*
+	 * Keep going while whole entries fit; whatever stops us is left
+	 * for the next read() to report.
+	 */
+	if (ret > 0 && reader->r_mode == LOGGER_READ_BATCH)
+		while ((nr = logger_read_entry(log, reader, buf + ret,
+					       count - ret)) > 0)
+			ret += nr;
 
-out:
-	mutex_unlock(&log->mutex);
+	mutex_unlock(&reader->mutex);
 
 	return ret;
 }
@@ -310,7 +722,7 @@ out:
  * get_next_entry - return the offset of the first valid entry at least 'len'
  * bytes after 'off'.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
 static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
 {
@@ -349,7 +761,7 @@ static inline int clock_interval(size_t a, size_t b, size_t c)
  * We do this by "pulling forward" the readers and start head to the first
  * entry after the new write head.
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void fix_up_readers(struct logger_log *log, size_t len)
 {
@@ -360,6 +772,16 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 	if (clock_interval(old, new, log->head))
 		log->head = get_next_entry(log, log->head, len);
 
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	/* the archiver fell behind, as if it were a reader */
+	if (log->a_max && clock_interval(old, new, log->a_off)) {
+		size_t off = get_next_entry(log, log->a_off, len);
+
+		log->a_pos += logger_offset(off - log->a_off);
+		log->a_off = off;
+	}
+#endif
+
 	list_for_each_entry(reader, &log->readers, list)
 		if (clock_interval(old, new, reader->r_off))
 			reader->r_off = get_next_entry(log, reader->r_off, len);
@@ -368,7 +790,7 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 /*
  * do_write_log - writes 'len' bytes from 'buf' to 'log'
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 {
@@ -385,29 +807,88 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
+ * logger_stage_from_user - gathers up to 'count' bytes of payload from the
+ * user-space vector 'iov' into 'buf'. If 'atomic' is set, page faults are
+ * disabled and we return -EFAULT rather than sleep on one; the caller then
+ * retries with a buffer it is allowed to sleep on.
  *
- * Returns 'count' on success, negative error code on failure.
+ * Returns the number of bytes staged, negative error code on failure.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static ssize_t logger_stage_from_user(unsigned char *buf,
+				      const struct iovec *iov,
+				      unsigned long nr_segs,
+				      size_t count, bool atomic)
 {
-	size_t len;
+	size_t done = 0;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	while (nr_segs-- > 0 && done < count) {
+		size_t len;
+		unsigned long left;
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
+		/* figure out how much of this vector we can keep */
+		len = min_t(size_t, iov->iov_len, count - done);
+
+		if (atomic) {
+			if (!access_ok(VERIFY_READ, iov->iov_base, len))
+				return -EFAULT;
+			left = __copy_from_user_inatomic(buf + done,
+							 iov->iov_base, len);
+		} else
+			left = copy_from_user(buf + done, iov->iov_base, len);
+		if (left)
 			return -EFAULT;
 
-	log->w_off = logger_offset(log->w_off + count);
+		iov++;
+		done += len;
+	}
+
+	return done;
+}
 
-	return count;
+/*
+ * logger_commit - copies the staged entry 'entry' of 'len' bytes into 'log'.
+ * This is the only place the write head moves, so it is also where lapped
+ * readers get fixed up. Returns false if the entry was dropped.
+ */
+static bool logger_commit(struct logger_log *log, const void *entry,
+			  size_t len)
+{
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	bool archive;
+#endif
+
+	spin_lock(&log->lock);
+
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+	/* the buffer now belongs to the next kernel, drop the entry */
+	if (unlikely(log->frozen)) {
+		spin_unlock(&log->lock);
+		return false;
+	}
+#endif
+
+	/*
+	 * Fix up any readers, pulling them forward to the first readable
+	 * entry after (what will be) the new write offset.
+	 */
+	fix_up_readers(log, len);
+
+	do_write_log(log, entry, len);
+
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	log->w_pos += len;
+	archive = log->a_max &&
+		logger_archive_pending(log) >= LOGGER_CHUNK_SIZE;
+#endif
+
+	spin_unlock(&log->lock);
+
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	if (archive)
+		schedule_work(&log->a_work);
+#endif
+
+	return true;
 }
 
 /*
@@ -419,60 +900,72 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
-	struct logger_entry header;
+	struct logger_entry *header;
+	unsigned char *stage, *slow = NULL;
 	struct timespec now;
-	ssize_t ret = 0;
-
-	now = current_kernel_time();
+	size_t len;
+	ssize_t ret;
+	bool committed;
 
-	header.pid = current->tgid;
-	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
-	header.euid = current_euid();
-	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
-	header.hdr_size = sizeof(struct logger_entry);
+	len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
 
 	/* null writes succeed, return zero */
-	if (unlikely(!header.len))
+	if (unlikely(!len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
 	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
+	 * Stage the entry in this CPU's buffer. The payload is normally
+	 * resident, as the caller just wrote it; if it is not we fall back
+	 * to a private buffer that we can fault the pages into.
 	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
+	stage = get_cpu_var(logger_stage);
+	pagefault_disable();
+	ret = logger_stage_from_user(stage + sizeof(struct logger_entry),
+				     iov, nr_segs, len, true);
+	pagefault_enable();
+	if (unlikely(ret < 0)) {
+		put_cpu_var(logger_stage);
+
+		slow = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!slow)
+			return -ENOMEM;
 
-	do_write_log(log, &header, sizeof(struct logger_entry));
+		ret = logger_stage_from_user(slow + sizeof(struct logger_entry),
+					     iov, nr_segs, len, false);
+		if (unlikely(ret < 0)) {
+			kfree(slow);
+			return ret;
+		}
+		stage = slow;
+	}
 
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
+	now = current_kernel_time();
 
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
-		}
+	header = (struct logger_entry *) stage;
+	header->pid = current->tgid;
+	header->tid = current->pid;
+	header->sec = now.tv_sec;
+	header->nsec = now.tv_nsec;
+	header->euid = current_euid();
+	header->len = ret;
+	header->hdr_size = sizeof(struct logger_entry);
 
-		iov++;
-		ret += nr;
-	}
+	committed = logger_commit(log, stage,
+				  sizeof(struct logger_entry) + ret);
 
-	mutex_unlock(&log->mutex);
+	if (slow)
+		kfree(slow);
+	else
+		put_cpu_var(logger_stage);
 
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	/*
+	 * Wake up any blocked readers. A woken reader leaves the wait queue
+	 * until it has drained the log, so the entries committed meanwhile
+	 * are picked up in one batch without a wakeup each. The commit above
+	 * orders this check against a reader that is about to sleep.
+	 */
+	if (committed && waitqueue_active(&log->wq))
+		wake_up_interruptible(&log->wq);
 
 	return ret;
 }
@@ -497,6 +990,11 @@ static int logger_open(struct inode *inode, struct file *file)
 	if (!log)
 		return -ENODEV;
 
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+	if (log->read_only && (file->f_mode & FMODE_WRITE))
+		return -EPERM;
+#endif
+
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader;
 
@@ -504,17 +1002,34 @@ static int logger_open(struct inode *inode, struct file *file)
 		if (!reader)
 			return -ENOMEM;
 
+		reader->buf = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!reader->buf) {
+			kfree(reader);
+			return -ENOMEM;
+		}
+
 		reader->log = log;
 		reader->r_ver = 1;
+		reader->r_mode = LOGGER_READ_SINGLE;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
 			capable(CAP_SYSLOG);
 
 		INIT_LIST_HEAD(&reader->list);
-
-		mutex_lock(&log->mutex);
+		mutex_init(&reader->mutex);
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+		/* start with the oldest entries, if any were archived */
+		mutex_lock(&log->a_mutex);
+		reader->r_archive = log->a_max && !list_empty(&log->a_chunks);
+		mutex_unlock(&log->a_mutex);
+		reader->r_pos = 0;
+		reader->a_buf = NULL;
+		reader->a_buf_len = 0;
+#endif
+
+		spin_lock(&log->lock);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		file->private_data = reader;
 	} else
@@ -535,9 +1050,13 @@ static int logger_release(struct inode *ignored, struct file *file)
 		struct logger_log *log;
 
 		log = reader->log;
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		list_del(&reader->list);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
+		kfree(reader->buf);
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+		kfree(reader->a_buf);
+#endif
 		kfree(reader);
 	}
 
@@ -567,14 +1086,17 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
+	if (logger_in_archive(log, reader))
+		return ret | POLLIN | POLLRDNORM;
+
+	spin_lock(&log->lock);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
 
 	if (log->w_off != reader->r_off)
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -588,7 +1110,25 @@ static long logger_set_version(struct logger_reader *reader, void __user *arg)
 	if ((version < 1) || (version > 2))
 		return -EINVAL;
 
+	spin_lock(&reader->log->lock);
 	reader->r_ver = version;
+	spin_unlock(&reader->log->lock);
+	return 0;
+}
+
+static long logger_set_read_mode(struct logger_reader *reader,
+				 void __user *arg)
+{
+	int mode;
+	if (copy_from_user(&mode, arg, sizeof(int)))
+		return -EFAULT;
+
+	if ((mode != LOGGER_READ_SINGLE) && (mode != LOGGER_READ_BATCH))
+		return -EINVAL;
+
+	mutex_lock(&reader->mutex);
+	reader->r_mode = mode;
+	mutex_unlock(&reader->mutex);
 	return 0;
 }
 
@@ -599,7 +1139,22 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	long ret = -EINVAL;
 	void __user *argp = (void __user *) arg;
 
-	mutex_lock(&log->mutex);
+	/* these copy from user space, so they can't run under log->lock */
+	if (cmd == LOGGER_SET_VERSION || cmd == LOGGER_SET_READ_MODE) {
+		if (!(file->f_mode & FMODE_READ))
+			return -EBADF;
+		if (cmd == LOGGER_SET_VERSION)
+			return logger_set_version(file->private_data, argp);
+		return logger_set_read_mode(file->private_data, argp);
+	}
+
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	if (cmd == LOGGER_FLUSH_LOG && (file->f_mode & FMODE_WRITE) &&
+	    log->a_max)
+		logger_archive_flush(log);
+#endif
+
+	spin_lock(&log->lock);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -651,17 +1206,17 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = reader->r_ver;
 		break;
-	case LOGGER_SET_VERSION:
+	case LOGGER_GET_READ_MODE:
 		if (!(file->f_mode & FMODE_READ)) {
 			ret = -EBADF;
 			break;
 		}
 		reader = file->private_data;
-		ret = logger_set_version(reader, argp);
+		ret = reader->r_mode;
 		break;
 	}
 
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -681,11 +1236,36 @@ static const struct file_operations logger_fops = {
  * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
  * must be a power of two, and greater than
  * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)).
+ *
+ * With CONFIG_ANDROID_LOGGER_COMPRESS, a quarter of 'SIZE' goes to the ring
+ * and the rest is the budget for its compressed archive.
  */
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+#define LOGGER_RING_SIZE(SIZE)	((SIZE) / 4)
+#define LOGGER_ARCHIVE_INIT(VAR, SIZE) \
+	.a_work = __WORK_INITIALIZER(VAR .a_work, logger_archive_work), \
+	.a_mutex = __MUTEX_INITIALIZER(VAR .a_mutex), \
+	.a_chunks = LIST_HEAD_INIT(VAR .a_chunks), \
+	.a_max = (SIZE) - LOGGER_RING_SIZE(SIZE),
+#else
+#define LOGGER_RING_SIZE(SIZE)	(SIZE)
+#define LOGGER_ARCHIVE_INIT(VAR, SIZE)
+#endif
+
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+/* allocated by init_log(), so that the buffer survives the next kernel */
+#define LOGGER_BUFFER(VAR, SIZE)
+#define LOGGER_BUFFER_INIT(VAR)	NULL
+#else
+#define LOGGER_BUFFER(VAR, SIZE) \
+	static unsigned char _buf_ ## VAR[LOGGER_RING_SIZE(SIZE)];
+#define LOGGER_BUFFER_INIT(VAR)	_buf_ ## VAR
+#endif
+
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
+LOGGER_BUFFER(VAR, SIZE) \
 static struct logger_log VAR = { \
-	.buffer = _buf_ ## VAR, \
+	.buffer = LOGGER_BUFFER_INIT(VAR), \
 	.misc = { \
 		.minor = MISC_DYNAMIC_MINOR, \
 		.name = NAME, \
@@ -694,10 +1274,11 @@ static struct logger_log VAR = { \
 	}, \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
-	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.w_off = 0, \
 	.head = 0, \
-	.size = SIZE, \
+	.size = LOGGER_RING_SIZE(SIZE), \
+	LOGGER_ARCHIVE_INIT(VAR, SIZE) \
 };
 
 DEFINE_LOGGER_DEVICE(log_main, LOGGER_LOG_MAIN, 256*1024)
@@ -705,6 +1286,22 @@ DEFINE_LOGGER_DEVICE(log_events, LOGGER_LOG_EVENTS, 256*1024)
 DEFINE_LOGGER_DEVICE(log_radio, LOGGER_LOG_RADIO, 256*1024)
 DEFINE_LOGGER_DEVICE(log_system, LOGGER_LOG_SYSTEM, 256*1024)
 
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+/* the previous kernel's logs, registered only if they were handed over */
+DEFINE_LOGGER_DEVICE(log_last_main, "log_last_main", 0)
+DEFINE_LOGGER_DEVICE(log_last_events, "log_last_events", 0)
+DEFINE_LOGGER_DEVICE(log_last_radio, "log_last_radio", 0)
+DEFINE_LOGGER_DEVICE(log_last_system, "log_last_system", 0)
+
+static struct logger_log *logger_logs[] = {
+	&log_main, &log_events, &log_radio, &log_system,
+};
+
+static struct logger_log *logger_last_logs[] = {
+	&log_last_main, &log_last_events, &log_last_radio, &log_last_system,
+};
+#endif
+
 static struct logger_log *get_log_from_minor(int minor)
 {
 	if (log_main.misc.minor == minor)
@@ -715,13 +1312,110 @@ static struct logger_log *get_log_from_minor(int minor)
 		return &log_radio;
 	if (log_system.misc.minor == minor)
 		return &log_system;
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+	{
+		int i;
+
+		for (i = 0; i < ARRAY_SIZE(logger_last_logs); i++)
+			if (logger_last_logs[i]->buffer &&
+			    logger_last_logs[i]->misc.minor == minor)
+				return logger_last_logs[i];
+	}
+#endif
 	return NULL;
 }
 
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+/*
+ * logger_kexec_notify - queue a handoff tag for each log on the way into
+ * kexec. Writes are dropped from here on so that the write head we pass
+ * stays in sync with the buffer.
+ */
+static int logger_kexec_notify(struct notifier_block *nb,
+			       unsigned long event, void *unused)
+{
+	struct logger_log *log;
+	struct tag tag;
+	int i;
+
+	if (event != SYS_RESTART)
+		return NOTIFY_DONE;
+
+	for (i = 0; i < ARRAY_SIZE(logger_logs); i++) {
+		log = logger_logs[i];
+		if (!log->buffer)
+			continue;
+
+		memset(&tag, 0, sizeof(tag));
+		spin_lock(&log->lock);
+		log->frozen = true;
+		tag.hdr.tag = ATAG_KEXEC_LOG;
+		tag.hdr.size = tag_size(tag_kexec_log);
+		tag.u.kexec_log.start = virt_to_phys(log->buffer);
+		tag.u.kexec_log.size = log->size;
+		tag.u.kexec_log.w_off = log->w_off;
+		tag.u.kexec_log.head = log->head;
+		strlcpy(tag.u.kexec_log.name, log->misc.name,
+			sizeof(tag.u.kexec_log.name));
+		spin_unlock(&log->lock);
+
+		if (kexec_add_handoff_tag(&tag))
+			break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block logger_kexec_nb = {
+	.notifier_call = logger_kexec_notify,
+};
+
+/*
+ * init_last_log - adopt the buffer that the previous kernel left for 'log'
+ * under 'name'; it was kept out of the page allocator by the arch code.
+ */
+static void __init init_last_log(struct logger_log *log, const char *name)
+{
+	struct tag_kexec_log *t = kexec_handoff_find_log(name);
+
+	if (!t)
+		return;
+
+	if (!is_power_of_2(t->size) || t->w_off >= t->size ||
+	    t->head >= t->size || (t->start & ~PAGE_MASK) ||
+	    !pfn_valid(__phys_to_pfn(t->start)) ||
+	    PageHighMem(pfn_to_page(__phys_to_pfn(t->start)))) {
+		printk(KERN_ERR "logger: ignoring bad handoff of '%s'\n",
+		       name);
+		return;
+	}
+
+	log->buffer = phys_to_virt(t->start);
+	log->size = t->size;
+	log->w_off = t->w_off;
+	log->head = t->head;
+	log->read_only = true;
+}
+#endif
+
 static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	if (!logger_archive_wrkmem)
+		log->a_max = 0;
+#endif
+
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+	if (!log->buffer) {
+		log->buffer = (unsigned char *)
+			__get_free_pages(GFP_KERNEL, get_order(log->size));
+		if (!log->buffer)
+			return -ENOMEM;
+	}
+#endif
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
@@ -735,10 +1429,33 @@ static int __init init_log(struct logger_log *log)
 	return 0;
 }
 
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+/* without its scratch space the archiver stays off, see init_log() */
+static void __init logger_archive_init(void)
+{
+	logger_archive_raw = vmalloc(LOGGER_CHUNK_SIZE);
+	logger_archive_lzo = vmalloc(lzo1x_worst_compress(LOGGER_CHUNK_SIZE));
+	logger_archive_wrkmem = vmalloc(LZO1X_1_MEM_COMPRESS);
+
+	if (!logger_archive_raw || !logger_archive_lzo ||
+	    !logger_archive_wrkmem) {
+		printk(KERN_ERR "logger: no memory to compress the logs\n");
+		vfree(logger_archive_raw);
+		vfree(logger_archive_lzo);
+		vfree(logger_archive_wrkmem);
+		logger_archive_wrkmem = NULL;
+	}
+}
+#endif
+
 static int __init logger_init(void)
 {
 	int ret;
 
+#ifdef CONFIG_ANDROID_LOGGER_COMPRESS
+	logger_archive_init();
+#endif
+
 	ret = init_log(&log_main);
 	if (unlikely(ret))
 		goto out;
@@ -755,6 +1472,22 @@ static int __init logger_init(void)
 	if (unlikely(ret))
 		goto out;
 
+#ifdef CONFIG_ANDROID_LOGGER_KEXEC
+	{
+		int i;
+
+		for (i = 0; i < ARRAY_SIZE(logger_last_logs); i++) {
+			init_last_log(logger_last_logs[i],
+				      logger_logs[i]->misc.name);
+			if (logger_last_logs[i]->buffer &&
+			    init_log(logger_last_logs[i]))
+				logger_last_logs[i]->buffer = NULL;
+		}
+	}
+
+	register_reboot_notifier(&logger_kexec_nb);
+#endif
+
 out:
 	return ret;
 }
@@ -66,5 +66,11 @@ struct logger_entry {
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
 #define LOGGER_GET_VERSION		_IO(__LOGGERIO, 5) /* abi version */
 #define LOGGER_SET_VERSION		_IO(__LOGGERIO, 6) /* abi version */
+#define LOGGER_GET_READ_MODE		_IO(__LOGGERIO, 7) /* read() mode */
+#define LOGGER_SET_READ_MODE		_IO(__LOGGERIO, 8) /* read() mode */
+
+/* read() modes, see LOGGER_SET_READ_MODE */
+#define LOGGER_READ_SINGLE	0	/* one entry per read() */
+#define LOGGER_READ_BATCH	1	/* as many whole entries as fit */
 
 #endif /* _LINUX_LOGGER_H */
@@ -12,6 +12,19 @@
  * and kill processes with a oom_adj value of 0 or higher when the free memory
  * drops below 1024 pages.
  *
+ * Before it gets to that, the driver grades the memory pressure in
+ * /sys/kernel/mm/lowmemorykiller/pressure_level, which can be poll()ed for
+ * changes: 0 while free memory is above twice the largest minfree value,
+ * 1 below that, 2 below one and a half times it and 3 below it, when kills
+ * are due. The level is raised by one while reclaim gets back less than half
+ * of the pages it scans.
+ *
+ * Victims are picked by RSS. With /sys/module/lowmemorykiller/parameters/score
+ * set to 1, pages swapped out count for swap_cost percent of a page (what
+ * zram holds on to for them), the few largest processes at the top oom_adj
+ * are ranked by their proportional set size instead, and the swap cache no
+ * longer counts as free file cache.
+ *
  * The driver considers memory used for caches to be free, but if a large
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
@@ -35,6 +48,16 @@
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/rculist.h>
+#include <linux/seqlock.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+#include <linux/vmstat.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/hugetlb.h>
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -52,6 +75,24 @@ static size_t lowmem_minfree[6] = {
 };
 static int lowmem_minfree_size = 4;
 
+#define LOWMEM_SCORE_RSS	0
+#define LOWMEM_SCORE_PSS	1
+static int lowmem_score = LOWMEM_SCORE_RSS;
+#if defined(CONFIG_ZRAM) || defined(CONFIG_ZRAM_MODULE)
+static int lowmem_swap_cost = 33;
+#else
+static int lowmem_swap_cost;
+#endif
+
+/* how many of the largest processes LOWMEM_SCORE_PSS looks at more closely */
+#define LOWMEM_CANDIDATES	4
+
+struct lowmem_candidate {
+	struct task_struct	*task;
+	int			tasksize;
+	int			oom_adj;
+};
+
 static struct task_struct *lowmem_deathpending;
 static unsigned long lowmem_deathpending_timeout;
 
@@ -79,21 +120,440 @@ task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 	return NOTIFY_OK;
 }
 
+enum {
+	LOWMEM_PRESSURE_NONE,
+	LOWMEM_PRESSURE_LOW,
+	LOWMEM_PRESSURE_MEDIUM,
+	LOWMEM_PRESSURE_CRITICAL,
+};
+
+static int lowmem_pressure_level;
+static int lowmem_pressure_reclaim;	/* bump from the reclaim ratio */
+static unsigned long lowmem_pressure_sampled;
+static unsigned long lowmem_pressure_reclaimed;	/* last reclaim call */
+static unsigned long lowmem_pressure_scanned;
+static unsigned long lowmem_pressure_stolen;
+static struct sysfs_dirent *lowmem_pressure_sd;
+static DEFINE_SPINLOCK(lowmem_pressure_lock);
+
+static void lowmem_pressure_decay(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lowmem_pressure_work, lowmem_pressure_decay);
+
+#ifdef CONFIG_VM_EVENT_COUNTERS
+/* add up the per-zone counters of 'item', given as its _NORMAL one */
+static unsigned long lowmem_zone_events(enum vm_event_item item)
+{
+	unsigned long sum = 0;
+	int cpu, zid;
+
+	for_each_online_cpu(cpu) {
+		struct vm_event_state *this = &per_cpu(vm_event_states, cpu);
+
+		for (zid = 0; zid < MAX_NR_ZONES; zid++)
+			sum += this->event[item - ZONE_NORMAL + zid];
+	}
+
+	return sum;
+}
+
+/*
+ * Sample how much of what reclaim scanned it got back since last time, at
+ * most every HZ / 10. Caller holds lowmem_pressure_lock.
+ */
+static void lowmem_pressure_sample(void)
+{
+	unsigned long scanned, stolen;
+
+	if (time_before(jiffies, lowmem_pressure_sampled + HZ / 10))
+		return;
+	lowmem_pressure_sampled = jiffies;
+
+	scanned = lowmem_zone_events(PGSCAN_KSWAPD_NORMAL) +
+		lowmem_zone_events(PGSCAN_DIRECT_NORMAL);
+	stolen = lowmem_zone_events(PGSTEAL_NORMAL);
+
+	lowmem_pressure_reclaim = 0;
+	if (scanned - lowmem_pressure_scanned >
+	    2 * (stolen - lowmem_pressure_stolen))
+		lowmem_pressure_reclaim = 1;
+
+	lowmem_pressure_scanned = scanned;
+	lowmem_pressure_stolen = stolen;
+}
+#else
+static inline void lowmem_pressure_sample(void)
+{
+}
+#endif
+
+/*
+ * lowmem_pressure_update - grade the pressure from the same free page
+ * counts and minfree thresholds that lowmem_shrink() kills by, and let
+ * pollers know if the level changed
+ */
+static void lowmem_pressure_update(int other_free, int other_file,
+				   int array_size, bool reclaiming)
+{
+	int top = array_size ? lowmem_minfree[array_size - 1] : 0;
+	int other = max(other_free, other_file);
+	unsigned long flags;
+	int level;
+	bool changed;
+
+	if (other < top)
+		level = LOWMEM_PRESSURE_CRITICAL;
+	else if (other < top + top / 2)
+		level = LOWMEM_PRESSURE_MEDIUM;
+	else if (other < 2 * top)
+		level = LOWMEM_PRESSURE_LOW;
+	else
+		level = LOWMEM_PRESSURE_NONE;
+
+	spin_lock_irqsave(&lowmem_pressure_lock, flags);
+	if (reclaiming) {
+		lowmem_pressure_reclaimed = jiffies;
+		lowmem_pressure_sample();
+	} else if (time_after_eq(jiffies, lowmem_pressure_reclaimed + HZ))
+		lowmem_pressure_reclaim = 0;
+	level = min(level + lowmem_pressure_reclaim, LOWMEM_PRESSURE_CRITICAL);
+	changed = level != lowmem_pressure_level;
+	lowmem_pressure_level = level;
+	spin_unlock_irqrestore(&lowmem_pressure_lock, flags);
+
+	if (changed && lowmem_pressure_sd)
+		sysfs_notify_dirent(lowmem_pressure_sd);
+
+	/* once reclaim stops calling us, nothing else would bring it down */
+	if (level != LOWMEM_PRESSURE_NONE)
+		schedule_delayed_work(&lowmem_pressure_work, HZ);
+}
+
+static int lowmem_array_size(void)
+{
+	int array_size = ARRAY_SIZE(lowmem_adj);
+
+	if (lowmem_adj_size < array_size)
+		array_size = lowmem_adj_size;
+	if (lowmem_minfree_size < array_size)
+		array_size = lowmem_minfree_size;
+	return array_size;
+}
+
+static void lowmem_pressure_decay(struct work_struct *work)
+{
+	lowmem_pressure_update(global_page_state(NR_FREE_PAGES),
+			       global_page_state(NR_FILE_PAGES) -
+			       global_page_state(NR_SHMEM),
+			       lowmem_array_size(), false);
+}
+
+static ssize_t pressure_level_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", lowmem_pressure_level);
+}
+
+static struct kobj_attribute lowmem_pressure_attr = __ATTR_RO(pressure_level);
+
+static int lowmem_swap_pages(unsigned long swap)
+{
+	if (lowmem_score != LOWMEM_SCORE_PSS)
+		return 0;
+	return swap * lowmem_swap_cost / 100;
+}
+
+/* the size of 'mm' for choosing a victim; the caller holds task_lock() */
+static int lowmem_task_size(struct mm_struct *mm)
+{
+	return get_mm_rss(mm) +
+		lowmem_swap_pages(get_mm_counter(mm, MM_SWAPENTS));
+}
+
+/*
+ * lowmem_consider - adds 'p' to the 'n' best candidates, kept best first:
+ * highest oom_adj, then largest. The caller keeps 'p' from going away.
+ * Returns whether 'p' made it in.
+ */
+static bool lowmem_consider(struct lowmem_candidate *c, int n,
+			    struct task_struct *p, int tasksize, int oom_adj)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (!c[i].task || oom_adj > c[i].oom_adj ||
+		    (oom_adj == c[i].oom_adj && tasksize > c[i].tasksize))
+			break;
+	if (i == n)
+		return false;
+
+	memmove(&c[i + 1], &c[i], (n - i - 1) * sizeof(*c));
+	c[i].task = p;
+	c[i].tasksize = tasksize;
+	c[i].oom_adj = oom_adj;
+	return true;
+}
+
+/* fraction bits of lowmem_pss.pss; it is counted in pages, as RSS is */
+#define LOWMEM_PSS_SHIFT	12
+
+struct lowmem_pss {
+	struct vm_area_struct	*vma;
+	u64			pss;	/* pages << LOWMEM_PSS_SHIFT */
+	unsigned long		swap;	/* swapped out pages */
+};
+
+static int lowmem_pss_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct lowmem_pss *pss = walk->private;
+	struct page *page;
+	spinlock_t *ptl;
+	pte_t *pte;
+	int mapcount;
+
+	split_huge_page_pmd(walk->mm, pmd);
+
+	pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		if (is_swap_pte(*pte)) {
+			pss->swap++;
+			continue;
+		}
+		if (!pte_present(*pte))
+			continue;
+		page = vm_normal_page(pss->vma, addr, *pte);
+		if (!page)
+			continue;
+		mapcount = page_mapcount(page);
+		if (mapcount >= 2)
+			pss->pss += (1ULL << LOWMEM_PSS_SHIFT) / mapcount;
+		else
+			pss->pss += 1ULL << LOWMEM_PSS_SHIFT;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+	cond_resched();
+	return 0;
+}
+
+/*
+ * lowmem_task_pss - what killing 'p' would give back, in pages: its
+ * proportional set size plus its share of swap, weighted the same way as
+ * in lowmem_task_size(). Returns -1 if that can't be had right now.
+ */
+static int lowmem_task_pss(struct task_struct *p)
+{
+	struct lowmem_pss pss = { .pss = 0, .swap = 0 };
+	struct mm_walk walk = {
+		.pmd_entry = lowmem_pss_pte_range,
+		.private = &pss,
+	};
+	struct vm_area_struct *vma;
+	struct mm_struct *mm;
+
+	mm = get_task_mm(p);
+	if (!mm)
+		return -1;
+
+	/* never wait for a process that may itself be waiting for memory */
+	if (!down_read_trylock(&mm->mmap_sem)) {
+		mmput(mm);
+		return -1;
+	}
+
+	walk.mm = mm;
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		pss.vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &walk);
+	}
+
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	return (pss.pss >> LOWMEM_PSS_SHIFT) + lowmem_swap_pages(pss.swap);
+}
+
+/*
+ * lowmem_rank_pss - moves the candidate that would give back the most to
+ * the front, among those sharing the first one's oom_adj. Either all of
+ * those are scored by PSS or, if one can't be, all keep their RSS score.
+ */
+static void lowmem_rank_pss(struct lowmem_candidate *c, int n)
+{
+	struct lowmem_candidate tmp;
+	int size[LOWMEM_CANDIDATES];
+	int best = 0;
+	int i, m;
+
+	for (m = 0; m < n && c[m].task && c[m].oom_adj == c[0].oom_adj; m++) {
+		size[m] = lowmem_task_pss(c[m].task);
+		if (size[m] < 0)
+			return;
+		lowmem_print(3, "%d (%s), adj %d, size %d, pss %d\n",
+			     c[m].task->pid, c[m].task->comm, c[m].oom_adj,
+			     c[m].tasksize, size[m]);
+	}
+
+	for (i = 0; i < m; i++) {
+		c[i].tasksize = size[i];
+		if (size[i] > size[best])
+			best = i;
+	}
+
+	tmp = c[0];
+	c[0] = c[best];
+	c[best] = tmp;
+}
+
+#ifdef CONFIG_ANDROID_LMK_ADJ_BUCKETS
+#define LOWMEM_ADJ_BUCKETS	(OOM_ADJUST_MAX - OOM_DISABLE + 1)
+
+/*
+ * Thread group leaders, on one list per oom_adj. Fork and exit update the
+ * lists with tasklist_lock held for writing and interrupts off, so nothing
+ * else is taken under lowmem_adj_lock; the killer walks them under RCU,
+ * the same way for_each_process() is safe there.
+ *
+ * A leader moved to another list takes an RCU walker standing on it along,
+ * so moves bump lowmem_adj_seq and the killer walks again when it sees one.
+ */
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+static seqcount_t lowmem_adj_seq = SEQCNT_ZERO;
+static struct hlist_head lowmem_adj_buckets[LOWMEM_ADJ_BUCKETS];
+
+/* how often lowmem_select() walks again before making do with what it has */
+#define LOWMEM_SELECT_RETRIES	3
+
+static struct hlist_head *lowmem_adj_bucket(int oom_adj)
+{
+	oom_adj = clamp(oom_adj, OOM_DISABLE, OOM_ADJUST_MAX);
+	return &lowmem_adj_buckets[oom_adj - OOM_DISABLE];
+}
+
+/* the caller holds lowmem_adj_lock */
+static void __lowmem_adj_add(struct task_struct *p)
+{
+	hlist_add_head_rcu(&p->lowmem_adj_node,
+			   lowmem_adj_bucket(p->signal->oom_adj));
+}
+
+void lowmem_adj_add(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	__lowmem_adj_add(p);
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+void lowmem_adj_del(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	hlist_del_init_rcu(&p->lowmem_adj_node);
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/* a non-leader thread exec()ed and took over as group leader */
+void lowmem_adj_replace(struct task_struct *old, struct task_struct *new)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (!hlist_unhashed(&old->lowmem_adj_node)) {
+		write_seqcount_begin(&lowmem_adj_seq);
+		hlist_del_init_rcu(&old->lowmem_adj_node);
+		__lowmem_adj_add(new);
+		write_seqcount_end(&lowmem_adj_seq);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/* the oom_adj of the thread group of 'p' has been written */
+void lowmem_adj_update(struct task_struct *p)
+{
+	unsigned long flags;
+
+	rcu_read_lock();
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	p = p->group_leader;
+	if (!hlist_unhashed(&p->lowmem_adj_node)) {
+		write_seqcount_begin(&lowmem_adj_seq);
+		hlist_del_init_rcu(&p->lowmem_adj_node);
+		__lowmem_adj_add(p);
+		write_seqcount_end(&lowmem_adj_seq);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+	rcu_read_unlock();
+}
+
+/*
+ * lowmem_select - fills in the 'n' largest processes at the highest
+ * populated oom_adj of at least 'min_adj'. Only the processes at that one
+ * oom_adj have their RSS looked at. The caller holds rcu_read_lock().
+ */
+static void lowmem_select(int min_adj, struct lowmem_candidate *c, int n)
+{
+	struct task_struct *p;
+	struct hlist_node *node;
+	int retries = LOWMEM_SELECT_RETRIES;
+	unsigned int seq;
+	int tasksize;
+	int oom_adj;
+
+retry:
+	memset(c, 0, n * sizeof(*c));
+	seq = read_seqcount_begin(&lowmem_adj_seq);
+	for (oom_adj = OOM_ADJUST_MAX;
+	     oom_adj >= max(min_adj, OOM_DISABLE) && !c[0].task; oom_adj--) {
+		hlist_for_each_entry_rcu(p, node, lowmem_adj_bucket(oom_adj),
+					 lowmem_adj_node) {
+			/* skip those whose oom_adj changed under us */
+			task_lock(p);
+			tasksize = 0;
+			if (p->mm && p->signal->oom_adj == oom_adj)
+				tasksize = lowmem_task_size(p->mm);
+			task_unlock(p);
+			if (tasksize <= 0 ||
+			    !lowmem_consider(c, n, p, tasksize, oom_adj))
+				continue;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, "
+				     "to kill\n", p->pid, p->comm, oom_adj,
+				     tasksize);
+		}
+	}
+
+	/* a move may have taken the walk to the wrong list or cut it short */
+	if (read_seqcount_retry(&lowmem_adj_seq, seq) && --retries)
+		goto retry;
+}
+#endif
+
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
+#ifndef CONFIG_ANDROID_LMK_ADJ_BUCKETS
 	struct task_struct *p;
-	struct task_struct *selected = NULL;
-	int rem = 0;
 	int tasksize;
+#endif
+	struct lowmem_candidate cand[LOWMEM_CANDIDATES];
+	int ncand = lowmem_score == LOWMEM_SCORE_PSS ? LOWMEM_CANDIDATES : 1;
+	struct task_struct *selected;
+	int rem = 0;
 	int i;
 	int min_adj = OOM_ADJUST_MAX + 1;
 	int selected_tasksize = 0;
 	int selected_oom_adj;
-	int array_size = ARRAY_SIZE(lowmem_adj);
+	int array_size = lowmem_array_size();
 	int other_free = global_page_state(NR_FREE_PAGES);
 	int other_file = global_page_state(NR_FILE_PAGES) -
 						global_page_state(NR_SHMEM);
 
+	/* with zram, the swap cache is anon memory on its way out */
+	if (lowmem_score == LOWMEM_SCORE_PSS)
+		other_file -= total_swapcache_pages;
+
 	/*
 	 * If we already have a death outstanding, then
 	 * bail out right away; indicating to vmscan
@@ -105,10 +565,6 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	    time_before_eq(jiffies, lowmem_deathpending_timeout))
 		return 0;
 
-	if (lowmem_adj_size < array_size)
-		array_size = lowmem_adj_size;
-	if (lowmem_minfree_size < array_size)
-		array_size = lowmem_minfree_size;
 	for (i = 0; i < array_size; i++) {
 		if (other_free < lowmem_minfree[i] &&
 		    other_file < lowmem_minfree[i]) {
@@ -116,6 +572,8 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			break;
 		}
 	}
+	lowmem_pressure_update(other_free, other_file, array_size,
+			       sc->nr_to_scan > 0);
 	if (sc->nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %d\n",
 			     sc->nr_to_scan, sc->gfp_mask, other_free, other_file,
@@ -129,8 +587,12 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
-	selected_oom_adj = min_adj;
+	memset(cand, 0, sizeof(cand));
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_BUCKETS
+	rcu_read_lock();
+	lowmem_select(min_adj, cand, ncand);
+#else
 	read_lock(&tasklist_lock);
 	for_each_process(p) {
 		struct mm_struct *mm;
@@ -149,23 +611,37 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			task_unlock(p);
 			continue;
 		}
-		tasksize = get_mm_rss(mm);
+		tasksize = lowmem_task_size(mm);
 		task_unlock(p);
 		if (tasksize <= 0)
 			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
-				continue;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
+		if (!lowmem_consider(cand, ncand, p, tasksize, oom_adj))
+			continue;
 		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
 			     p->pid, p->comm, oom_adj, tasksize);
 	}
+#endif
+	for (i = 0; i < ncand && cand[i].task; i++)
+		get_task_struct(cand[i].task);
+#ifdef CONFIG_ANDROID_LMK_ADJ_BUCKETS
+	rcu_read_unlock();
+#else
+	read_unlock(&tasklist_lock);
+#endif
+
+	if (lowmem_score == LOWMEM_SCORE_PSS && cand[0].task)
+		lowmem_rank_pss(cand, ncand);
+
+	selected = cand[0].task;
+	selected_tasksize = cand[0].tasksize;
+	selected_oom_adj = cand[0].oom_adj;
+	/* it may have been moved to the foreground since it was picked */
+	if (selected && selected->signal->oom_adj < selected_oom_adj) {
+		lowmem_print(2, "%d (%s), adj %d, now adj %d, spared\n",
+			     selected->pid, selected->comm, selected_oom_adj,
+			     selected->signal->oom_adj);
+		selected = NULL;
+	}
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
@@ -175,9 +651,10 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		force_sig(SIGKILL, selected);
 		rem -= selected_tasksize;
 	}
+	for (i = 0; i < ncand && cand[i].task; i++)
+		put_task_struct(cand[i].task);
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
-	read_unlock(&tasklist_lock);
 	return rem;
 }
 
@@ -186,8 +663,19 @@ static struct shrinker lowmem_shrinker = {
 	.seeks = DEFAULT_SEEKS * 16
 };
 
+static struct kobject *lowmem_kobj;
+
 static int __init lowmem_init(void)
 {
+	lowmem_kobj = kobject_create_and_add("lowmemorykiller", mm_kobj);
+	if (lowmem_kobj) {
+		if (!sysfs_create_file(lowmem_kobj, &lowmem_pressure_attr.attr))
+			lowmem_pressure_sd = sysfs_get_dirent(lowmem_kobj->sd,
+							      NULL,
+							      "pressure_level");
+	} else
+		pr_err("lowmemorykiller: failed to create sysfs node\n");
+
 	task_free_register(&task_nb);
 	register_shrinker(&lowmem_shrinker);
 	return 0;
@@ -197,6 +685,10 @@ static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
 	task_free_unregister(&task_nb);
+	cancel_delayed_work_sync(&lowmem_pressure_work);
+	if (lowmem_pressure_sd)
+		sysfs_put(lowmem_pressure_sd);
+	kobject_put(lowmem_kobj);
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -205,6 +697,8 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(score, lowmem_score, int, S_IRUGO | S_IWUSR);
+module_param_named(swap_cost, lowmem_swap_cost, int, S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
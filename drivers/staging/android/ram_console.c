@@ -26,6 +26,20 @@
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 #include <linux/rslib.h>
 #endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+#include <linux/bitops.h>
+#include <linux/irq_work.h>
+#include <linux/notifier.h>
+#include <linux/reboot.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_PSTORE
+#include <linux/mutex.h>
+#include <linux/pstore.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#endif
 
 #include <asm/bootinfo.h>
 
@@ -51,18 +65,36 @@ static char __initdata
 static char *ram_console_old_log;
 static size_t ram_console_old_log_size;
 
-static struct ram_console_buffer *ram_console_buffer;
-static size_t ram_console_buffer_size;
+/*
+ * A ring of 'buffer_size' bytes behind a ram_console_buffer header, with
+ * the parity of every block and of the header after the data.  The
+ * console is one of these, the pstore records are kept in others.
+ */
+struct ram_console_zone {
+	struct ram_console_buffer *buffer;
+	size_t buffer_size;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	uint8_t *par_buffer;
+	int corrected_bytes;
+	int bad_blocks;
+#endif
+};
+
+static struct ram_console_zone ram_console_zone;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-static char *ram_console_par_buffer;
 static struct rs_control *ram_console_rs_decoder;
-static int ram_console_corrected_bytes;
-static int ram_console_bad_blocks;
 #define ECC_BLOCK_SIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DATA_SIZE
 #define ECC_SIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_ECC_SIZE
 #define ECC_SYMSIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_SYMBOL_SIZE
 #define ECC_POLY CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_POLYNOMIAL
 #endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+/* one bit per block whose parity is stale, the last one for the header */
+static unsigned long *ram_console_ecc_dirty;
+static size_t ram_console_ecc_blocks;
+/* encode on the spot, until set up and again once we are going down */
+static bool ram_console_ecc_sync = true;
+#endif
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 static void ram_console_encode_rs8(uint8_t *data, size_t len, uint8_t *ecc)
@@ -85,73 +117,303 @@ static int ram_console_decode_rs8(void *data, size_t len, uint8_t *ecc)
 	return decode_rs8(ram_console_rs_decoder, data, par, len,
 				NULL, 0, NULL, 0, NULL);
 }
+
+static size_t ram_console_zone_blocks(struct ram_console_zone *zone)
+{
+	return DIV_ROUND_UP(zone->buffer_size, ECC_BLOCK_SIZE);
+}
+
+/* encode block 'i' of the zone, or its header if 'i' is the block count */
+static void ram_console_encode_block(struct ram_console_zone *zone, size_t i)
+{
+	struct ram_console_buffer *buffer = zone->buffer;
+	uint8_t *par = zone->par_buffer + i * ECC_SIZE;
+	uint8_t *block = buffer->data + i * ECC_BLOCK_SIZE;
+	uint8_t *buffer_end = buffer->data + zone->buffer_size;
+	int size = ECC_BLOCK_SIZE;
+
+	if (i == ram_console_zone_blocks(zone)) {
+		ram_console_encode_rs8((uint8_t *)buffer, sizeof(*buffer), par);
+		return;
+	}
+
+	if (block + ECC_BLOCK_SIZE > buffer_end)
+		size = buffer_end - block;
+	ram_console_encode_rs8(block, size, par);
+}
+
+/* correct what was left in the zone, up to the size in its header */
+static void ram_console_zone_decode(struct ram_console_zone *zone)
+{
+	struct ram_console_buffer *buffer = zone->buffer;
+	uint8_t *buffer_end = buffer->data + zone->buffer_size;
+	uint8_t *block = buffer->data;
+	uint8_t *par = zone->par_buffer;
+
+	while (block < buffer->data + buffer->size) {
+		int numerr;
+		int size = ECC_BLOCK_SIZE;
+		if (block + size > buffer_end)
+			size = buffer_end - block;
+		numerr = ram_console_decode_rs8(block, size, par);
+		if (numerr > 0)
+			zone->corrected_bytes += numerr;
+		else if (numerr < 0)
+			zone->bad_blocks++;
+		block += ECC_BLOCK_SIZE;
+		par += ECC_SIZE;
+	}
+}
+#endif
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+static void ram_console_ecc_flush(void)
+{
+	size_t i;
+
+	for_each_set_bit(i, ram_console_ecc_dirty, ram_console_ecc_blocks + 1)
+		if (test_and_clear_bit(i, ram_console_ecc_dirty))
+			ram_console_encode_block(&ram_console_zone, i);
+}
+
+static void ram_console_ecc_work_func(struct work_struct *work)
+{
+	ram_console_ecc_flush();
+}
+
+static DECLARE_WORK(ram_console_ecc_work, ram_console_ecc_work_func);
+
+/* printk may hold any lock, so get to the work item through an irq_work */
+static void ram_console_ecc_kick(struct irq_work *work)
+{
+	schedule_work(&ram_console_ecc_work);
+}
+
+static struct irq_work ram_console_ecc_irq_work;
+
+/*
+ * Leave the parity of block 'i' to the work item, unless we are encoding
+ * synchronously or this is not the console; returns false if the caller
+ * has to encode it.
+ */
+static bool ram_console_ecc_defer(struct ram_console_zone *zone, size_t i)
+{
+	if (zone != &ram_console_zone || ram_console_ecc_sync)
+		return false;
+
+	set_bit(i, ram_console_ecc_dirty);
+	irq_work_queue(&ram_console_ecc_irq_work);
+	return true;
+}
+
+/*
+ * Other CPUs are stopped by now and may have been in the middle of the work
+ * item, so simply re-encode the lot; it is what printk used to do anyway.
+ */
+static int ram_console_ecc_panic(struct notifier_block *nb,
+				 unsigned long event, void *unused)
+{
+	size_t i;
+
+	ram_console_ecc_sync = true;
+	for (i = 0; i <= ram_console_ecc_blocks; i++)
+		ram_console_encode_block(&ram_console_zone, i);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_console_ecc_panic_nb = {
+	.notifier_call = ram_console_ecc_panic,
+	/* after anyone who still wants to log the panic */
+	.priority = INT_MIN,
+};
+
+static int ram_console_ecc_reboot(struct notifier_block *nb,
+				  unsigned long event, void *unused)
+{
+	ram_console_ecc_sync = true;
+	smp_mb();
+	irq_work_sync(&ram_console_ecc_irq_work);
+	flush_work_sync(&ram_console_ecc_work);
+	ram_console_ecc_flush();
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_console_ecc_reboot_nb = {
+	.notifier_call = ram_console_ecc_reboot,
+	.priority = INT_MIN,
+};
+
+static void __init ram_console_ecc_init(void)
+{
+	ram_console_ecc_blocks = ram_console_zone_blocks(&ram_console_zone);
+	ram_console_ecc_dirty = kzalloc(BITS_TO_LONGS(ram_console_ecc_blocks
+						      + 1) * sizeof(long),
+					GFP_KERNEL);
+	if (!ram_console_ecc_dirty) {
+		printk(KERN_ERR "ram_console: failed to allocate ECC bitmap, "
+		       "encoding synchronously\n");
+		return;
+	}
+
+	init_irq_work(&ram_console_ecc_irq_work, ram_console_ecc_kick);
+	atomic_notifier_chain_register(&panic_notifier_list,
+				       &ram_console_ecc_panic_nb);
+	register_reboot_notifier(&ram_console_ecc_reboot_nb);
+	ram_console_ecc_sync = false;
+}
+#else
+static inline bool
+ram_console_ecc_defer(struct ram_console_zone *zone, size_t i)
+{
+	return false;
+}
 #endif
 
-static void ram_console_update(const char *s, unsigned int count)
+static void ram_console_update(struct ram_console_zone *zone,
+			       const char *s, unsigned int count)
 {
-	struct ram_console_buffer *buffer = ram_console_buffer;
+	struct ram_console_buffer *buffer = zone->buffer;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
-	uint8_t *block;
-	uint8_t *par;
-	int size = ECC_BLOCK_SIZE;
+	size_t i = buffer->start / ECC_BLOCK_SIZE;
 #endif
 	memcpy(buffer->data + buffer->start, s, count);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	block = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
-	par = ram_console_par_buffer +
-	      (buffer->start / ECC_BLOCK_SIZE) * ECC_SIZE;
 	do {
-		if (block + ECC_BLOCK_SIZE > buffer_end)
-			size = buffer_end - block;
-		ram_console_encode_rs8(block, size, par);
-		block += ECC_BLOCK_SIZE;
-		par += ECC_SIZE;
-	} while (block < buffer->data + buffer->start + count);
+		if (!ram_console_ecc_defer(zone, i))
+			ram_console_encode_block(zone, i);
+		i++;
+	} while (i * ECC_BLOCK_SIZE < buffer->start + count);
 #endif
 }
 
-static void ram_console_update_header(void)
+static void ram_console_update_header(struct ram_console_zone *zone)
 {
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	struct ram_console_buffer *buffer = ram_console_buffer;
-	uint8_t *par;
-	par = ram_console_par_buffer +
-	      DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) * ECC_SIZE;
-	ram_console_encode_rs8((uint8_t *)buffer, sizeof(*buffer), par);
+	size_t i = ram_console_zone_blocks(zone);
+
+	if (!ram_console_ecc_defer(zone, i))
+		ram_console_encode_block(zone, i);
 #endif
 }
 
-static void
-ram_console_write(struct console *console, const char *s, unsigned int count)
+static void ram_console_zone_write(struct ram_console_zone *zone,
+				   const char *s, unsigned int count)
 {
 	int rem;
-	struct ram_console_buffer *buffer = ram_console_buffer;
+	struct ram_console_buffer *buffer = zone->buffer;
 
-	if (count > ram_console_buffer_size) {
-		s += count - ram_console_buffer_size;
-		count = ram_console_buffer_size;
+	if (count > zone->buffer_size) {
+		s += count - zone->buffer_size;
+		count = zone->buffer_size;
 	}
-	rem = ram_console_buffer_size - buffer->start;
+	rem = zone->buffer_size - buffer->start;
 	if (rem < count) {
-		ram_console_update(s, rem);
+		ram_console_update(zone, s, rem);
 		s += rem;
 		count -= rem;
 		buffer->start = 0;
-		buffer->size = ram_console_buffer_size;
+		buffer->size = zone->buffer_size;
 	}
-	ram_console_update(s, count);
+	ram_console_update(zone, s, count);
 
 	buffer->start += count;
-	if (buffer->size < ram_console_buffer_size)
+	if (buffer->size < zone->buffer_size)
 		buffer->size += count;
-	ram_console_update_header();
+	ram_console_update_header(zone);
+}
+
+static void ram_console_zone_reset(struct ram_console_zone *zone)
+{
+	struct ram_console_buffer *buffer = zone->buffer;
+
+	buffer->sig = RAM_CONSOLE_SIG;
+	buffer->start = 0;
+	buffer->size = 0;
+	ram_console_update_header(zone);
+}
+
+/* a header that can be trusted to index the ring */
+static bool ram_console_zone_valid(struct ram_console_zone *zone)
+{
+	struct ram_console_buffer *buffer = zone->buffer;
+
+	return buffer->size <= zone->buffer_size &&
+	       buffer->start <= buffer->size;
+}
+
+/* copy out the contents of the ring, oldest first */
+static size_t ram_console_zone_copy(struct ram_console_zone *zone, char *dest)
+{
+	struct ram_console_buffer *buffer = zone->buffer;
+
+	memcpy(dest, &buffer->data[buffer->start],
+	       buffer->size - buffer->start);
+	memcpy(dest + buffer->size - buffer->start,
+	       &buffer->data[0], buffer->start);
+
+	return buffer->size;
+}
+
+static int __init ram_console_zone_init(struct ram_console_zone *zone,
+					void *mem, size_t size)
+{
+	struct ram_console_buffer *buffer = mem;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	int numerr;
+	uint8_t *par;
+#endif
+
+	zone->buffer = buffer;
+	zone->buffer_size = size - sizeof(struct ram_console_buffer);
+
+	if (zone->buffer_size > size) {
+		pr_err("ram_console: buffer %p, invalid size %zu, "
+		       "datasize %zu\n", buffer, size, zone->buffer_size);
+		return -EINVAL;
+	}
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	zone->buffer_size -= (DIV_ROUND_UP(zone->buffer_size,
+					   ECC_BLOCK_SIZE) + 1) * ECC_SIZE;
+
+	if (zone->buffer_size > size) {
+		pr_err("ram_console: buffer %p, invalid size %zu, "
+		       "non-ecc datasize %zu\n",
+		       buffer, size, zone->buffer_size);
+		return -EINVAL;
+	}
+
+	zone->par_buffer = buffer->data + zone->buffer_size;
+	zone->corrected_bytes = 0;
+	zone->bad_blocks = 0;
+
+	par = zone->par_buffer + ram_console_zone_blocks(zone) * ECC_SIZE;
+
+	numerr = ram_console_decode_rs8(buffer, sizeof(*buffer), par);
+	if (numerr > 0) {
+		printk(KERN_INFO "ram_console: error in header, %d\n", numerr);
+		zone->corrected_bytes += numerr;
+	} else if (numerr < 0) {
+		printk(KERN_INFO
+		       "ram_console: uncorrectable error in header\n");
+		zone->bad_blocks++;
+	}
+#endif
+	return 0;
+}
+
+static void
+ram_console_write(struct console *console, const char *s, unsigned int count)
+{
+	ram_console_zone_write(&ram_console_zone, s, count);
 }
 
 static struct console ram_console = {
 	.name	= "ram",
 	.write	= ram_console_write,
-	.flags	= CON_PRINTBUFFER | CON_ENABLED,
+	.flags	= CON_PRINTBUFFER | CON_ENABLED | CON_FAST,
 	.index	= -1,
 };
 
@@ -164,49 +426,24 @@ void ram_console_enable_console(int enabled)
 }
 
 static void __init
-ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
+ram_console_save_old(struct ram_console_zone *zone, const char *bootinfo,
 	char *dest)
 {
-	size_t old_log_size = buffer->size;
+	size_t old_log_size = zone->buffer->size;
 	size_t bootinfo_size = 0;
 	size_t total_size = old_log_size;
 	char *ptr;
 	const char *bootinfo_label = "Boot info:\n";
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	uint8_t *block;
-	uint8_t *par;
 	char strbuf[80];
 	int strbuf_len = 0;
 
-	block = buffer->data;
-	par = ram_console_par_buffer;
-	while (block < buffer->data + buffer->size) {
-		int numerr;
-		int size = ECC_BLOCK_SIZE;
-		if (block + size > buffer->data + ram_console_buffer_size)
-			size = buffer->data + ram_console_buffer_size - block;
-		numerr = ram_console_decode_rs8(block, size, par);
-		if (numerr > 0) {
-#if 0
-			printk(KERN_INFO "ram_console: error in block %p, %d\n",
-			       block, numerr);
-#endif
-			ram_console_corrected_bytes += numerr;
-		} else if (numerr < 0) {
-#if 0
-			printk(KERN_INFO "ram_console: uncorrectable error in "
-			       "block %p\n", block);
-#endif
-			ram_console_bad_blocks++;
-		}
-		block += ECC_BLOCK_SIZE;
-		par += ECC_SIZE;
-	}
-	if (ram_console_corrected_bytes || ram_console_bad_blocks)
+	ram_console_zone_decode(zone);
+	if (zone->corrected_bytes || zone->bad_blocks)
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
 			"\n%d Corrected bytes, %d unrecoverable blocks\n",
-			ram_console_corrected_bytes, ram_console_bad_blocks);
+			zone->corrected_bytes, zone->bad_blocks);
 	else
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
 				      "\nNo errors detected\n");
@@ -230,10 +467,7 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 
 	ram_console_old_log = dest;
 	ram_console_old_log_size = total_size;
-	memcpy(ram_console_old_log,
-	       &buffer->data[buffer->start], buffer->size - buffer->start);
-	memcpy(ram_console_old_log + buffer->size - buffer->start,
-	       &buffer->data[0], buffer->start);
+	ram_console_zone_copy(zone, ram_console_old_log);
 	ptr = ram_console_old_log + old_log_size;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	memcpy(ptr, strbuf, strbuf_len);
@@ -262,39 +496,247 @@ static int __is_sys_exception(void)
 	return 1;
 }
 
-static int __init ram_console_init(struct ram_console_buffer *buffer,
-				   size_t buffer_size, const char *bootinfo,
-				   char *old_buf)
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_PSTORE
+/*
+ * The end of the region is carved into pstore zones: one per oops record,
+ * then one for the function tracer, each laid out like the console.  The
+ * previous boot's console log is handed out as a record as well.
+ */
+#define RAM_PSTORE_RECORDS	CONFIG_ANDROID_RAM_CONSOLE_PSTORE_RECORDS
+#define RAM_PSTORE_RECORD_SIZE	CONFIG_ANDROID_RAM_CONSOLE_PSTORE_RECORD_SIZE
+#define RAM_PSTORE_FTRACE_SIZE	CONFIG_ANDROID_RAM_CONSOLE_PSTORE_FTRACE_SIZE
+#define RAM_PSTORE_SIZE		(RAM_PSTORE_RECORDS * RAM_PSTORE_RECORD_SIZE + \
+				 RAM_PSTORE_FTRACE_SIZE)
+/* pstore keeps records in kmalloc memory, /proc/last_kmsg has it all */
+#define RAM_PSTORE_CONSOLE_SIZE	(64 * 1024)
+
+/* record ids: the oops zones, then the old console and ftrace logs */
+#define RAM_PSTORE_ID_CONSOLE	RAM_PSTORE_RECORDS
+#define RAM_PSTORE_ID_FTRACE	(RAM_PSTORE_RECORDS + 1)
+
+static struct ram_console_zone ram_pstore_oops[RAM_PSTORE_RECORDS];
+static int ram_pstore_oops_next;
+static struct ram_console_zone ram_pstore_ftrace;
+static DEFINE_RAW_SPINLOCK(ram_pstore_ftrace_lock);
+static char *ram_pstore_ftrace_old;
+static size_t ram_pstore_ftrace_old_size;
+static bool ram_pstore_console_erased;
+static size_t ram_pstore_buf_size;
+static u64 ram_pstore_read_id;
+
+static int ram_pstore_open(struct pstore_info *psi)
 {
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	int numerr;
-	uint8_t *par;
-#endif
-	ram_console_buffer = buffer;
-	ram_console_buffer_size =
-		buffer_size - sizeof(struct ram_console_buffer);
+	ram_pstore_read_id = 0;
+	return 0;
+}
 
-	if (ram_console_buffer_size > buffer_size) {
-		pr_err("ram_console: buffer %p, invalid size %zu, "
-		       "datasize %zu\n", buffer, buffer_size,
-		       ram_console_buffer_size);
-		return 0;
+static int ram_pstore_close(struct pstore_info *psi)
+{
+	return 0;
+}
+
+/* the last 'size' bytes of 'log', at most as much as fits in psi->buf */
+static ssize_t ram_pstore_read_tail(struct pstore_info *psi,
+				    const char *log, size_t size)
+{
+	size_t len = min(size, ram_pstore_buf_size);
+
+	memcpy(psi->buf, log + size - len, len);
+	return len;
+}
+
+static struct pstore_info ram_pstore_info;
+
+static ssize_t ram_pstore_read(u64 *id, enum pstore_type_id *type,
+			       struct timespec *time)
+{
+	struct pstore_info *psi = &ram_pstore_info;
+
+	time->tv_sec = 0;
+	time->tv_nsec = 0;
+
+	for (; ram_pstore_read_id < RAM_PSTORE_RECORDS; ram_pstore_read_id++) {
+		struct ram_console_zone *zone =
+			&ram_pstore_oops[ram_pstore_read_id];
+
+		if (!zone->buffer->size)
+			continue;
+		*id = ram_pstore_read_id++;
+		*type = PSTORE_TYPE_DMESG;
+		return ram_console_zone_copy(zone, psi->buf);
+	}
+
+	if (ram_pstore_read_id == RAM_PSTORE_ID_CONSOLE) {
+		*id = ram_pstore_read_id++;
+		if (ram_console_old_log && !ram_pstore_console_erased) {
+			*type = PSTORE_TYPE_CONSOLE;
+			return ram_pstore_read_tail(psi, ram_console_old_log,
+						    ram_console_old_log_size);
+		}
+	}
+
+	if (ram_pstore_read_id == RAM_PSTORE_ID_FTRACE) {
+		*id = ram_pstore_read_id++;
+		if (ram_pstore_ftrace_old) {
+			*type = PSTORE_TYPE_FTRACE;
+			return ram_pstore_read_tail(psi, ram_pstore_ftrace_old,
+						    ram_pstore_ftrace_old_size);
+		}
+	}
+
+	return 0;
+}
+
+/* called with buf_mutex held, from the kmsg dumper on oops and panic */
+static u64 ram_pstore_write(enum pstore_type_id type, size_t size)
+{
+	struct ram_console_zone *zone;
+	int id = ram_pstore_oops_next;
+
+	zone = &ram_pstore_oops[id];
+	ram_console_zone_reset(zone);
+	ram_console_zone_write(zone, ram_pstore_info.buf, size);
+	ram_pstore_oops_next = (id + 1) % RAM_PSTORE_RECORDS;
+
+	return id;
+}
+
+/* called from the function tracer, so no sleeping and no printk */
+static int ram_pstore_write_buf(enum pstore_type_id type, const char *buf,
+				size_t size)
+{
+	unsigned long flags;
+
+	if (type != PSTORE_TYPE_FTRACE)
+		return -EINVAL;
+
+	raw_spin_lock_irqsave(&ram_pstore_ftrace_lock, flags);
+	ram_console_zone_write(&ram_pstore_ftrace, buf, size);
+	raw_spin_unlock_irqrestore(&ram_pstore_ftrace_lock, flags);
+
+	return 0;
+}
+
+static int ram_pstore_erase(u64 id)
+{
+	if (id < RAM_PSTORE_RECORDS) {
+		ram_console_zone_reset(&ram_pstore_oops[id]);
+	} else if (id == RAM_PSTORE_ID_CONSOLE) {
+		/* still there in /proc/last_kmsg */
+		ram_pstore_console_erased = true;
+	} else if (id == RAM_PSTORE_ID_FTRACE) {
+		kfree(ram_pstore_ftrace_old);
+		ram_pstore_ftrace_old = NULL;
+	} else {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static struct pstore_info ram_pstore_info = {
+	.owner		= THIS_MODULE,
+	.name		= "ram_console",
+	.buf_mutex	= __MUTEX_INITIALIZER(ram_pstore_info.buf_mutex),
+	.open		= ram_pstore_open,
+	.close		= ram_pstore_close,
+	.read		= ram_pstore_read,
+	.write		= ram_pstore_write,
+	.erase		= ram_pstore_erase,
+};
+
+/* correct what a zone kept from before; false if it holds nothing */
+static bool __init ram_pstore_zone_load(struct ram_console_zone *zone,
+					const char *what)
+{
+	struct ram_console_buffer *buffer = zone->buffer;
+
+	if (buffer->sig != RAM_CONSOLE_SIG || !ram_console_zone_valid(zone) ||
+	    !buffer->size) {
+		ram_console_zone_reset(zone);
+		return false;
 	}
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	ram_console_buffer_size -= (DIV_ROUND_UP(ram_console_buffer_size,
-						ECC_BLOCK_SIZE) + 1) * ECC_SIZE;
+	ram_console_zone_decode(zone);
+	if (zone->corrected_bytes || zone->bad_blocks)
+		pr_info("ram_console: %s: %d corrected bytes, "
+			"%d unrecoverable blocks\n", what,
+			zone->corrected_bytes, zone->bad_blocks);
+#endif
+	return true;
+}
 
-	if (ram_console_buffer_size > buffer_size) {
-		pr_err("ram_console: buffer %p, invalid size %zu, "
-		       "non-ecc datasize %zu\n",
-		       buffer, buffer_size, ram_console_buffer_size);
-		return 0;
+static void __init ram_console_pstore_init(char *mem)
+{
+	bool full = true;
+	int i, err;
+
+	BUILD_BUG_ON(RAM_PSTORE_RECORD_SIZE % sizeof(uint32_t) ||
+		     RAM_PSTORE_FTRACE_SIZE % sizeof(uint32_t));
+
+	for (i = 0; i < RAM_PSTORE_RECORDS; i++) {
+		if (ram_console_zone_init(&ram_pstore_oops[i], mem,
+					  RAM_PSTORE_RECORD_SIZE))
+			return;
+		mem += RAM_PSTORE_RECORD_SIZE;
+
+		if (!ram_pstore_zone_load(&ram_pstore_oops[i], "oops") &&
+		    full) {
+			/* fill the free zones before overwriting any */
+			ram_pstore_oops_next = i;
+			full = false;
+		}
+	}
+	ram_pstore_buf_size = max_t(size_t, ram_pstore_oops[0].buffer_size,
+				    RAM_PSTORE_CONSOLE_SIZE);
+
+	if (RAM_PSTORE_FTRACE_SIZE &&
+	    !ram_console_zone_init(&ram_pstore_ftrace, mem,
+				   RAM_PSTORE_FTRACE_SIZE)) {
+		struct ram_console_zone *zone = &ram_pstore_ftrace;
+
+		if (ram_pstore_zone_load(zone, "ftrace")) {
+			ram_pstore_ftrace_old = kmalloc(zone->buffer->size,
+							GFP_KERNEL);
+			if (ram_pstore_ftrace_old)
+				ram_pstore_ftrace_old_size =
+					ram_console_zone_copy(zone,
+							ram_pstore_ftrace_old);
+			ram_console_zone_reset(zone);
+		}
+		ram_pstore_buf_size = max(ram_pstore_buf_size,
+					  zone->buffer_size);
+		ram_pstore_info.write_buf = ram_pstore_write_buf;
 	}
 
-	ram_console_par_buffer = buffer->data + ram_console_buffer_size;
+	/* the dumper writes bufsize sized parts, one oops zone each */
+	ram_pstore_info.bufsize = ram_pstore_oops[0].buffer_size;
+	ram_pstore_info.buf = kmalloc(ram_pstore_buf_size, GFP_KERNEL);
+	if (!ram_pstore_info.buf) {
+		pr_err("ram_console: failed to allocate pstore buffer\n");
+		return;
+	}
 
+	err = pstore_register(&ram_pstore_info);
+	if (err) {
+		pr_err("ram_console: pstore_register failed, %d\n", err);
+		kfree(ram_pstore_info.buf);
+		ram_pstore_info.buf = NULL;
+	}
+}
+#endif
 
+static int __init ram_console_init(struct ram_console_buffer *buffer,
+				   size_t buffer_size, const char *bootinfo,
+				   char *old_buf)
+{
+	struct ram_console_zone *zone = &ram_console_zone;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_PSTORE
+	char *pstore_mem = NULL;
+#endif
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	/* first consecutive root is 0
 	 * primitive element to generate roots = 1
 	 */
@@ -303,27 +745,24 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 		printk(KERN_INFO "ram_console: init_rs failed\n");
 		return 0;
 	}
+#endif
 
-	ram_console_corrected_bytes = 0;
-	ram_console_bad_blocks = 0;
-
-	par = ram_console_par_buffer +
-	      DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) * ECC_SIZE;
-
-	numerr = ram_console_decode_rs8(buffer, sizeof(*buffer), par);
-	if (numerr > 0) {
-		printk(KERN_INFO "ram_console: error in header, %d\n", numerr);
-		ram_console_corrected_bytes += numerr;
-	} else if (numerr < 0) {
-		printk(KERN_INFO
-		       "ram_console: uncorrectable error in header\n");
-		ram_console_bad_blocks++;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_PSTORE
+	/* the pstore zones go at the end, the console keeps the rest */
+	if (buffer_size >= 2 * RAM_PSTORE_SIZE) {
+		buffer_size -= RAM_PSTORE_SIZE;
+		pstore_mem = (char *)buffer + buffer_size;
+	} else {
+		pr_err("ram_console: buffer size %zu too small for pstore\n",
+		       buffer_size);
 	}
 #endif
 
+	if (ram_console_zone_init(zone, buffer, buffer_size))
+		return 0;
+
 	if (__is_sys_exception()) {
-		if (buffer->size > ram_console_buffer_size
-		    || buffer->start > buffer->size)
+		if (!ram_console_zone_valid(zone))
 			printk(KERN_INFO "ram_console: found existing invalid "
 			       "buffer, size %d, start %d\n",
 			       buffer->size, buffer->start);
@@ -331,7 +770,7 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 			printk(KERN_INFO "ram_console: found existing buffer, "
 			       "size %d, start %d\n",
 			       buffer->size, buffer->start);
-			ram_console_save_old(buffer, bootinfo, old_buf);
+			ram_console_save_old(zone, bootinfo, old_buf);
 		}
 	}
 
@@ -339,13 +778,18 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 		printk(KERN_INFO "ram_console: no valid data in buffer "
 		       "(sig = 0x%08x)\n", buffer->sig);
 
-	buffer->sig = RAM_CONSOLE_SIG;
-	buffer->start = 0;
-	buffer->size = 0;
+	ram_console_zone_reset(zone);
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DEFERRED
+	ram_console_ecc_init();
+#endif
 	register_console(&ram_console);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ENABLE_VERBOSE
 	console_verbose();
+#endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_PSTORE
+	if (pstore_mem)
+		ram_console_pstore_init(pstore_mem);
 #endif
 	return 0;
 }
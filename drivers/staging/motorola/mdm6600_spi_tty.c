@@ -30,7 +30,7 @@
 #include <linux/tty_driver.h>
 #include <linux/tty_flip.h>
 #include <linux/serial.h>
-#include <linux/circ_buf.h>
+#include <linux/dma-mapping.h>
 #include <linux/delay.h>
 #include <linux/uaccess.h>
 #include <linux/types.h>
@@ -44,13 +44,17 @@
 #include <linux/debugfs.h>
 #include <linux/suspend.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/mdm6600_spi.h>
 
 #define SPI_TRANSACTION_LEN 16256
 #define SPI_TTY_MINORS		1
 
 
-#define SPI_TTY_BUF_SIZE (128*1024) /* size should be power of 2 */
-
 /*
  * 2s wakelock timeout, because everything is done in kthread,
  * we give it a little bit more time
@@ -63,11 +67,37 @@
 #define REQUEST_BLOCK_UNIT  1792
 #define SPI_IPC_DEBUG 0
 
+/*
+ * Each message carries its own coherent tx frame, which spi_tty_write
+ * fills in place; the pool buffers are only used for rx.
+ */
 #define SPI_MSG_NUM		12
-#define SPI_BUF_NUM		((SPI_MSG_NUM) * 3)
+#define SPI_BUF_NUM		((SPI_MSG_NUM) * 2)
 #define SPI_MSG_PENDING_MAX	3
+#define SPI_MSG_TX_RESERVE	1	/* left to the worker by writers */
 #define SPI_MSG_PENDING_RX	2
 
+/*
+ * Frame type word.  With variable length transactions, a side that
+ * supports them sets SPI_MSG_VARLEN in every frame and puts in the top
+ * half how many SPI_VARLEN_UNITs it wants the next frame to be.  Once
+ * both did so in a frame, each following frame is clocked for the
+ * larger of the two requests, at least SPI_VARLEN_MIN: small control
+ * messages and short packets take a single short frame.  Any frame
+ * lost or invalid falls back to a full SPI_TRANSACTION_LEN frame that
+ * carries no more than a minimal frame would, until headers are
+ * exchanged again.  Frames are not pipelined in this mode: each
+ * length depends on the previous exchange.
+ */
+#define SPI_MSG_TYPE_DATA	1
+#define SPI_MSG_TYPE_MASK	0xff
+#define SPI_MSG_VARLEN		0x100
+#define SPI_MSG_NEXT_SHIFT	16
+
+#define SPI_VARLEN_UNIT		128
+#define SPI_VARLEN_MIN		256
+#define SPI_VARLEN_TIMEOUT	(HZ / 2)
+
 #define SPI_SEND_DTR		0x01
 #define SPI_NEED_RX		0x02
 
@@ -77,6 +107,20 @@
 #define SPI_TTY_START	0
 #define SPI_TTY_FINISH	1
 
+/*
+ * Latency histograms, log2 buckets of microseconds: bucket 0 is below
+ * 1us, bucket n from 2^(n-1)us, the last one open ended.
+ */
+#define SPI_LAT_BUCKETS	16
+
+enum {
+	SPI_LAT_MRDY_SRDY,	/* BP request to our srdy */
+	SPI_LAT_XFER_QUEUE,	/* spi_async to transfer start */
+	SPI_LAT_XFER,		/* transfer start to end */
+	SPI_LAT_RX_PEND,	/* rx frame waiting for the rx thread */
+	SPI_LAT_NUM,
+};
+
 #if SPI_IPC_DEBUG
 #include <linux/sched.h>
 #include <linux/ctype.h>
@@ -122,6 +166,9 @@ struct mdm6600_spi_buf {
 	struct list_head list;
 	struct mdm6600_spi_list *ms_list;
 	unsigned char *buf;
+	dma_addr_t dma;
+	int len;		/* of the frame it was used for */
+	ktime_t pended;
 	int id;
 };
 
@@ -138,6 +185,11 @@ struct mdm6600_spi_msg {
 	struct spi_transfer xfer;
 	struct mdm6600_spi_buf *tx;
 	struct mdm6600_spi_buf *rx;
+	struct mdm6600_spi_buf tx_frame;
+	int count;		/* payload assembled in tx_frame */
+	int offset;		/* of the payload not sent yet */
+	ktime_t queued;
+	ktime_t started;
 	void *data;
 	int id;
 };
@@ -145,6 +197,7 @@ struct mdm6600_spi_msg {
 struct mdm6600_spi_msg_pool {
 	struct mdm6600_spi_list free_list;
 	struct mdm6600_spi_list xfer_list;
+	struct mdm6600_spi_list ready_list;	/* full tx frames */
 };
 
 struct mdm6600_spi_tty_device {
@@ -183,8 +236,13 @@ struct mdm6600_spi_tty_device {
 	struct tty_struct			*tty;
 
 	u8								dtr;
-	u8                                      write_buf_full;
-	struct circ_buf				*write_buf;
+	/*
+	 * tx data is kept in messages, in the order: tx_carry, the rest
+	 * of a frame that had to be sent in shorter ones, the ready_list
+	 * and tx_msg, the frame spi_tty_write is filling.  port_lock.
+	 */
+	struct mdm6600_spi_msg			*tx_carry;
+	struct mdm6600_spi_msg			*tx_msg;
 
 	u8					throttle;
 	int					open_count;
@@ -204,8 +262,16 @@ struct mdm6600_spi_tty_device {
 	wait_queue_head_t                       xfer_wait;
 	struct workqueue_struct		*work_queue;
 	struct notifier_block                   pm_notify;
+	struct notifier_block			bp_wake_notify;
 	int					mrdy_irq_status;
 	u8					complete_status;
+	ktime_t					mrdy_time;
+
+	/* variable length transactions, updated from each exchange */
+	u8					bp_varlen;
+	u8					resync;
+	u16					ap_next;
+	u16					bp_next;
 };
 
 static struct tty_driver *spi_tty_driver;
@@ -223,6 +289,59 @@ static unsigned long tx_time;
 static unsigned long tx_count;
 static unsigned long write_count;
 
+struct spi_lat_hist {
+	u32 bucket[SPI_LAT_BUCKETS];
+	u32 max_us;
+};
+
+static const char * const spi_lat_names[SPI_LAT_NUM] = {
+	[SPI_LAT_MRDY_SRDY]	= "mrdy_to_srdy",
+	[SPI_LAT_XFER_QUEUE]	= "xfer_queue",
+	[SPI_LAT_XFER]		= "xfer",
+	[SPI_LAT_RX_PEND]	= "rx_pending",
+};
+
+static struct spi_lat_hist spi_lat[SPI_LAT_NUM];
+static int xfer_list_hwm;
+static int pend_list_hwm;
+static DEFINE_SPINLOCK(spi_lat_lock);
+
+static void spi_lat_record(int phase, ktime_t start)
+{
+	struct spi_lat_hist *h = &spi_lat[phase];
+	unsigned long flags;
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int i;
+
+	if (us < 0)
+		us = 0;
+	if (us > UINT_MAX)
+		us = UINT_MAX;
+	i = us ? min(ilog2((u32)us) + 1, SPI_LAT_BUCKETS - 1) : 0;
+
+	spin_lock_irqsave(&spi_lat_lock, flags);
+	h->bucket[i]++;
+	if (us > h->max_us)
+		h->max_us = us;
+	spin_unlock_irqrestore(&spi_lat_lock, flags);
+}
+
+static void spi_lat_hwm(int *hwm, int count)
+{
+	if (count > *hwm)
+		*hwm = count;
+}
+
+static bool varlen;
+module_param(varlen, bool, S_IRUGO);
+MODULE_PARM_DESC(varlen,
+	"Offer variable length transactions (needs BP firmware support)");
+
+static int pending_max = SPI_MSG_PENDING_MAX;
+module_param(pending_max, int, S_IRUGO);
+MODULE_PARM_DESC(pending_max,
+	"Transactions queued to the SPI controller before waiting");
+
 #if SPI_IPC_DEBUG
 void spi_ipc_buf_dump1(const char *header, const u8 *buf, int len, int in_ascii)
 {
@@ -247,36 +366,6 @@ void spi_ipc_buf_dump1(const char *header, const u8 *buf, int len, int in_ascii)
 	SPI_IPC_INFO("%s%s\n", header, dbg_buf);
 }
 #endif
-static void spi_tty_buf_clear(struct circ_buf *cb)
-{
-	cb->head = 0;
-	cb->tail = 0;
-}
-
-static struct circ_buf *spi_tty_buf_alloc(void)
-{
-	struct circ_buf *cb;
-
-	cb = kmalloc(sizeof(struct circ_buf), GFP_KERNEL);
-	if (!cb)
-		return NULL;
-	cb->buf = kmalloc(SPI_TTY_BUF_SIZE, GFP_KERNEL);
-	if (!cb->buf) {
-		kfree(cb);
-		return NULL;
-	}
-
-	spi_tty_buf_clear(cb);
-
-	return cb;
-}
-
-static void spi_tty_buf_free(struct circ_buf *cb)
-{
-	kfree(cb->buf);
-	kfree(cb);
-}
-
 static u32 spi_tty_msg_calc_crc(struct spi_tty_msg *msg)
 {
 	u32 fcs = 0;
@@ -290,53 +379,90 @@ static u32 spi_tty_msg_calc_crc(struct spi_tty_msg *msg)
 	return fcs;
 }
 
-static int spi_tty_buf_room_avail(struct circ_buf *cb)
+static int spi_tty_msg_valid(struct spi_tty_msg *msg, int frame_len)
 {
-	return CIRC_SPACE(cb->head, cb->tail, SPI_TTY_BUF_SIZE);
+	u32 msg_type = le32_to_cpu(msg->type);
+
+	return (msg_type & SPI_MSG_TYPE_MASK) == SPI_MSG_TYPE_DATA &&
+		le32_to_cpu(msg->len) <= frame_len - SPI_MSG_HEADER_LEN &&
+		le32_to_cpu(msg->fcs) == spi_tty_msg_calc_crc(msg);
 }
 
-static int spi_tty_buf_data_avail(struct circ_buf *cb)
+/* length of the next frame, from the last exchange of headers */
+static int spi_tty_frame_len(struct mdm6600_spi_tty_device *mdm6600_tty)
 {
-	return CIRC_CNT(cb->head, cb->tail, SPI_TTY_BUF_SIZE);
+	int len;
+
+	if (!varlen || !mdm6600_tty->bp_varlen)
+		return SPI_TRANSACTION_LEN;
+
+	len = max(mdm6600_tty->ap_next, mdm6600_tty->bp_next) *
+		SPI_VARLEN_UNIT;
+	return clamp(len, SPI_VARLEN_MIN, SPI_TRANSACTION_LEN);
 }
 
-static int spi_tty_buf_put(struct circ_buf *cb, const char *buf, int count)
+/* bytes queued for tx, with port_lock held; ready frames are full */
+static int spi_tty_tx_avail(struct mdm6600_spi_tty_device *mdm6600_tty)
 {
-	int c, ret = 0;
+	int c = mdm6600_tty->msg_pool.ready_list.count * SPI_MTU;
+
+	if (mdm6600_tty->tx_carry)
+		c += mdm6600_tty->tx_carry->count -
+			mdm6600_tty->tx_carry->offset;
+	if (mdm6600_tty->tx_msg)
+		c += mdm6600_tty->tx_msg->count;
+	return c;
+}
 
-	while (1) {
-		c = CIRC_SPACE_TO_END(cb->head, cb->tail, SPI_TTY_BUF_SIZE);
-		if (count < c)
-			c = count;
-		if (c <= 0)
-			break;
-		memcpy(cb->buf + cb->head, buf, c);
-		cb->head = (cb->head + c) & (SPI_TTY_BUF_SIZE-1);
-		buf += c;
-		count -= c;
-		ret += c;
-	}
+/* bytes spi_tty_write can take, with port_lock held */
+static int spi_tty_tx_room(struct mdm6600_spi_tty_device *mdm6600_tty)
+{
+	int room = mdm6600_tty->msg_pool.free_list.count - SPI_MSG_TX_RESERVE;
 
-	return ret;
+	room = max(room, 0) * SPI_MTU;
+	if (mdm6600_tty->tx_msg)
+		room += SPI_MTU - mdm6600_tty->tx_msg->count;
+	return room;
 }
 
-static int spi_tty_buf_get(struct circ_buf *cb, char *buf, int count)
+static void mdm6600_spi_msg_add(struct mdm6600_spi_msg *spi_obj,
+				struct mdm6600_spi_list *ms_list);
+static struct mdm6600_spi_msg *mdm6600_spi_msg_get_nosleep(
+				struct mdm6600_spi_list *ms_list);
+
+/* copy tty data straight into tx frames, with port_lock held */
+static int spi_tty_tx_put(struct mdm6600_spi_tty_device *mdm6600_tty,
+		const unsigned char *buf, int count)
 {
+	struct mdm6600_spi_msg *spi_msg;
 	int c, ret = 0;
 
-	SPI_IPC_INFO("%s Enter\n", __func__);
+	while (count > 0) {
+		spi_msg = mdm6600_tty->tx_msg;
+		if (!spi_msg) {
+			if (mdm6600_tty->msg_pool.free_list.count <=
+			    SPI_MSG_TX_RESERVE)
+				break;
+			spi_msg = mdm6600_spi_msg_get_nosleep(
+					&mdm6600_tty->msg_pool.free_list);
+			if (!spi_msg)
+				break;
+			mdm6600_tty->tx_msg = spi_msg;
+		}
 
-	while (1) {
-		c = CIRC_CNT_TO_END(cb->head, cb->tail, SPI_TTY_BUF_SIZE);
-		if (count < c)
-			c = count;
-		if (c <= 0)
-			break;
-		memcpy(buf, cb->buf + cb->tail, c);
-		cb->tail = (cb->tail + c) & (SPI_TTY_BUF_SIZE-1);
+		c = min(count, SPI_MTU - spi_msg->count);
+		memcpy(spi_msg->tx->buf + SPI_MSG_HEADER_LEN + spi_msg->count,
+			buf, c);
+		spi_msg->count += c;
 		buf += c;
 		count -= c;
 		ret += c;
+
+		if (spi_msg->count == SPI_MTU) {
+			mdm6600_spi_msg_add(spi_msg,
+					&mdm6600_tty->msg_pool.ready_list);
+			mdm6600_tty->tx_msg = NULL;
+		}
 	}
 
 	return ret;
@@ -356,18 +482,17 @@ int spi_tty_write_cache(struct tty_struct *tty,
 		ret = 0;
 	} else {
 		if (!in_interrupt()
-			&& spi_tty_buf_room_avail(spi_tty->write_buf) < count) {
+			&& spi_tty_tx_room(spi_tty) < count) {
 			/* no enough room, wait */
 			spin_unlock_irqrestore(&spi_tty->port_lock, flags);
 			SPI_IPC_INFO("No write room, put write wait...\n");
-			spi_tty->write_buf_full = 1;
 			wait_event_interruptible_timeout(spi_tty->write_wait,
-					spi_tty->write_buf_full == 0, 2*HZ);
+					spi_tty_tx_room(spi_tty) >= count, 2*HZ);
 			SPI_IPC_INFO("Write wait up from sleep\n");
 			spin_lock_irqsave(&spi_tty->port_lock, flags);
 		}
 
-		ret = spi_tty_buf_put(spi_tty->write_buf, buffer, count);
+		ret = spi_tty_tx_put(spi_tty, buffer, count);
 	}
 
 	/* wake lock to prevent suspend */
@@ -403,23 +528,21 @@ static int spi_tty_open(struct tty_struct *tty, struct file *file)
 }
 
 static void spi_tty_handle_data(struct mdm6600_spi_tty_device  *mdm6600_tty,
-				unsigned char *rx_buf)
+				unsigned char *rx_buf, int frame_len)
 {
 	struct spi_tty_msg *msg;
-	int cnt, crc, len;
-	u32 msg_type, msg_len, msg_fcs;
+	int cnt, len;
+	u32 msg_type, msg_len;
 	u8 *data;
 	u8 request_num, i;
 
 	msg = (struct spi_tty_msg *)rx_buf;
-	crc = spi_tty_msg_calc_crc(msg);
 
 	msg_type = le32_to_cpu(msg->type);
 	msg_len = le32_to_cpu(msg->len);
-	msg_fcs = le32_to_cpu(msg->fcs);
 
 	/* validate data */
-	if (msg_type != 1 || msg_len > SPI_MTU || msg_fcs != crc) {
+	if (!spi_tty_msg_valid(msg, frame_len)) {
 		dev_err(&mdm6600_tty->spi->dev, "Invalid data received: "
 				"type %d len %d\n", msg_type, msg_len);
 		return;
@@ -539,16 +662,66 @@ static struct mdm6600_spi_##objtype				\
 MDM6600_SPI_LIST_GET(buf);
 MDM6600_SPI_LIST_GET(msg);
 
+/*
+ * The next tx frame, with port_lock held.  Frames assembled by
+ * spi_tty_write go out as they are; the rest of a frame longer than
+ * the transaction allows, and a null frame, take a free message.
+ * NULL when there is none: spi_msg is then put back in front.
+ */
+static struct mdm6600_spi_msg *spi_tty_tx_frame(
+		struct mdm6600_spi_tty_device *mdm6600_tty, int room)
+{
+	struct mdm6600_spi_msg *spi_msg, *frame;
+	int c;
+
+	spi_msg = mdm6600_tty->tx_carry;
+	mdm6600_tty->tx_carry = NULL;
+	if (!spi_msg)
+		spi_msg = mdm6600_spi_msg_get_nosleep(
+				&mdm6600_tty->msg_pool.ready_list);
+	if (!spi_msg) {
+		spi_msg = mdm6600_tty->tx_msg;
+		mdm6600_tty->tx_msg = NULL;
+	}
+	if (spi_msg && !spi_msg->offset && spi_msg->count <= room)
+		return spi_msg;
+
+	frame = mdm6600_spi_msg_get_nosleep(&mdm6600_tty->msg_pool.free_list);
+	if (!frame) {
+		mdm6600_tty->tx_carry = spi_msg;
+		return NULL;
+	}
+	if (!spi_msg)
+		return frame;
+
+	c = min(room, spi_msg->count - spi_msg->offset);
+	memcpy(frame->tx->buf + SPI_MSG_HEADER_LEN, spi_msg->tx->buf +
+		SPI_MSG_HEADER_LEN + spi_msg->offset, c);
+	frame->count = c;
+	spi_msg->offset += c;
+	if (spi_msg->offset < spi_msg->count) {
+		mdm6600_tty->tx_carry = spi_msg;
+	} else {
+		spi_msg->count = 0;
+		spi_msg->offset = 0;
+		mdm6600_spi_msg_add(spi_msg, &mdm6600_tty->msg_pool.free_list);
+	}
+	return frame;
+}
+
 static void spi_tty_write_worker(struct work_struct *work)
 {
 	int c;
 	int crc;
+	int frame_len, room, left;
+	u8 tx_null;
+	u32 msg_type;
 	unsigned long flags;
 	unsigned long start_t = 0;
 	struct spi_tty_msg *msg;
 	struct mdm6600_spi_tty_device *mdm6600_tty =
 		container_of(work, struct mdm6600_spi_tty_device, write_work);
-	struct mdm6600_spi_buf *spi_tx_buf, *spi_rx_buf;
+	struct mdm6600_spi_buf *spi_rx_buf;
 	struct mdm6600_spi_msg *spi_msg;
 	struct mdm6600_spi_list *msg_ol;
 
@@ -558,10 +731,11 @@ static void spi_tty_write_worker(struct work_struct *work)
 	mutex_lock(&mdm6600_tty->work_lock);
 	spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
 
-	c = spi_tty_buf_data_avail(mdm6600_tty->write_buf);
+	c = spi_tty_tx_avail(mdm6600_tty);
 	while (((c) || (mdm6600_tty->tx_null))
 		&& (!mdm6600_tty->throttle)
 		&& mdm6600_ctrl_is_bp_up()) {
+		tx_null = mdm6600_tty->tx_null;
 		if (mdm6600_tty->tx_null) {
 			if (!c && (mdm6600_tty->tx_null == SPI_NEED_RX)
 				&& (msg_ol->count >= SPI_MSG_PENDING_RX)) {
@@ -574,71 +748,97 @@ static void spi_tty_write_worker(struct work_struct *work)
 		spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
 
 		if ((c < (SPI_TRANSACTION_LEN / 10)) &&
-			(msg_ol->count > SPI_MSG_PENDING_MAX))
+			(msg_ol->count > pending_max))
 			wait_event_interruptible_timeout(
 				mdm6600_tty->xfer_wait,
-				(msg_ol->count <= SPI_MSG_PENDING_MAX), 2);
+				(msg_ol->count <= pending_max), 2);
+
+		/* the next length comes out of the frame in flight */
+		if (varlen && msg_ol->count &&
+		    wait_event_interruptible_timeout(mdm6600_tty->xfer_wait,
+				!msg_ol->count, SPI_VARLEN_TIMEOUT) <= 0) {
+			mdm6600_tty->bp_varlen = 0;
+			mdm6600_tty->resync = 1;
+		}
+		frame_len = spi_tty_frame_len(mdm6600_tty);
+		if (varlen && mdm6600_tty->resync)
+			room = SPI_VARLEN_MIN - SPI_MSG_HEADER_LEN;
+		else
+			room = frame_len - SPI_MSG_HEADER_LEN;
+
+		spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
+		spi_msg = spi_tty_tx_frame(mdm6600_tty, room);
+		if (!spi_msg) {
+			/* all in flight, one will complete */
+			mdm6600_tty->tx_null |= tx_null;
+			spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
+			wait_event(mdm6600_tty->msg_pool.free_list.wait,
+				mdm6600_tty->msg_pool.free_list.count);
+			spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
+			c = spi_tty_tx_avail(mdm6600_tty);
+			continue;
+		}
+		c = spi_msg->count;
+		left = spi_tty_tx_avail(mdm6600_tty);
+		mdm6600_tty->complete_status = SPI_TTY_START;
+		spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
+		DBGBUF("PAYLOAD %d\n", c);
 
-		spi_tx_buf = mdm6600_spi_buf_get(
-				&mdm6600_tty->buf_pool.free_list);
-		DBGBUF("BUF %d transceving\n", spi_tx_buf->id);
-		mdm6600_spi_buf_add(spi_tx_buf,
-				&mdm6600_tty->buf_pool.xfer_list);
 		spi_rx_buf = mdm6600_spi_buf_get(
 				&mdm6600_tty->buf_pool.free_list);
 		DBGBUF("BUF %d transceving\n", spi_rx_buf->id);
 		mdm6600_spi_buf_add(spi_rx_buf,
 				&mdm6600_tty->buf_pool.xfer_list);
-		spi_msg = mdm6600_spi_msg_get(
-				&mdm6600_tty->msg_pool.free_list);
 		DBGBUF("MSG %d transceving\n", spi_msg->id);
 		mdm6600_spi_msg_add(spi_msg, msg_ol);
-
-		msg = (struct spi_tty_msg *)spi_tx_buf->buf;
-
-		/* need memset ? */
-		memset(spi_tx_buf->buf, 0x0, SPI_TRANSACTION_LEN);
-		memset(spi_rx_buf->buf, 0x0, SPI_TRANSACTION_LEN);
-
-		spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
-		c = min(SPI_MTU,
-			spi_tty_buf_data_avail(mdm6600_tty->write_buf));
-		spi_tty_buf_get(mdm6600_tty->write_buf,
-				spi_tx_buf->buf + SPI_MSG_HEADER_LEN, c);
-		if (mdm6600_tty->tty && mdm6600_tty->open_count)
-			tty_wakeup(mdm6600_tty->tty);
-		mdm6600_tty->complete_status = SPI_TTY_START;
-		spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
-		DBGBUF("PAYLOAD %d\n", c);
-
-		msg->type = cpu_to_le32(1);
+		spi_lat_hwm(&xfer_list_hwm, msg_ol->count);
+
+		/* the payload is in place, clear what follows it */
+		msg = (struct spi_tty_msg *)spi_msg->tx->buf;
+		memset(msg->data + c, 0x0, frame_len - SPI_MSG_HEADER_LEN - c);
+
+		msg_type = SPI_MSG_TYPE_DATA;
+		if (varlen) {
+			/* ask for what is left, a short frame if nothing */
+			mdm6600_tty->ap_next = left ? DIV_ROUND_UP(
+				SPI_MSG_HEADER_LEN + min(left, SPI_MTU),
+				SPI_VARLEN_UNIT) : 0;
+			msg_type |= SPI_MSG_VARLEN |
+				mdm6600_tty->ap_next << SPI_MSG_NEXT_SHIFT;
+		}
+		msg->type = cpu_to_le32(msg_type);
 		msg->len = cpu_to_le32(c);
 		msg->dtr = cpu_to_le32(mdm6600_tty->dtr);
 		crc = spi_tty_msg_calc_crc(msg);
 		msg->fcs = cpu_to_le32(crc);
-		spi_ipc_buf_dump("tx header: ", spi_tx_buf->buf,
+		spi_ipc_buf_dump("tx header: ", spi_msg->tx->buf,
 				SPI_MSG_HEADER_LEN);
 		spi_ipc_buf_dump_ascii("tx data: ",
-				spi_tx_buf->buf + SPI_MSG_HEADER_LEN,
+				spi_msg->tx->buf + SPI_MSG_HEADER_LEN,
 				(c > 16 ? 16 : c));
 
 		DBGBUF("PREPARE  spi_msg %d tx_buf %d rx_buf %d\n",
-				spi_msg->id, spi_tx_buf->id, spi_rx_buf->id);
+				spi_msg->id, spi_msg->tx->id, spi_rx_buf->id);
 		spi_msg->msg.actual_length = 0;
-		spi_msg->xfer.tx_buf = spi_tx_buf->buf;
+		spi_msg->xfer.len = frame_len;
+		spi_msg->tx->len = frame_len;
+		spi_rx_buf->len = frame_len;
+		spi_rx_buf->dma = dma_map_single(&mdm6600_tty->spi->dev,
+				spi_rx_buf->buf, frame_len, DMA_FROM_DEVICE);
+		spi_msg->xfer.tx_buf = spi_msg->tx->buf;
 		spi_msg->xfer.rx_buf = spi_rx_buf->buf;
-		spi_msg->tx = spi_tx_buf;
+		spi_msg->xfer.tx_dma = spi_msg->tx->dma;
+		spi_msg->xfer.rx_dma = spi_rx_buf->dma;
 		spi_msg->rx = spi_rx_buf;
 		spi_msg->data = mdm6600_tty;
+		spi_msg->queued = ktime_get();
 
+		trace_mdm6600_spi_xfer_start(spi_msg->id, frame_len, c);
 		spi_async(mdm6600_tty->spi, &spi_msg->msg);
 
-		/* wake up writes wait on queue */
-		wake_up_interruptible(&mdm6600_tty->write_wait);
-
 		spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
 		mdm6600_tty->complete_status = SPI_TTY_FINISH;
-		c = spi_tty_buf_data_avail(mdm6600_tty->write_buf);
+		c = spi_tty_tx_avail(mdm6600_tty);
 	}
 
 	spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
@@ -666,11 +866,13 @@ static irqreturn_t mdm6600_spi_mrdy_irq_handler(int irq, void *ptr)
 			spin_unlock_irqrestore(&mdm6600->port_lock, flags);
 		} else {
 		mdm6600->tx_null |= SPI_NEED_RX;
+		if (!mdm6600->mrdy_time.tv64)
+			mdm6600->mrdy_time = ktime_get();
 		/* wake lock to prevent suspend */
 		wake_lock_timeout(&mdm6600->wakelock,
 			SPI_TTY_WAKE_LOCK_TIMEOUT);
 		spin_unlock_irqrestore(&mdm6600->port_lock, flags);
-		queue_work(mdm6600->work_queue, &mdm6600->write_work);
+		return IRQ_WAKE_THREAD;
 		}
 	} else {
 	  /*printk(KERN_ERR"This is a spur!\n");*/
@@ -678,8 +880,38 @@ static irqreturn_t mdm6600_spi_mrdy_irq_handler(int irq, void *ptr)
 	return IRQ_HANDLED;
 }
 
+/*
+ * The BP is waiting on us: answer from the irq thread, which runs at
+ * realtime priority, rather than behind whatever sits on spi_tty_wq
+ * while the system resumes.  work_lock keeps it from racing a write
+ * worker queued by spi_tty_write.
+ */
+static irqreturn_t mdm6600_spi_mrdy_irq_thread(int irq, void *ptr)
+{
+	struct mdm6600_spi_tty_device *mdm6600 = ptr;
+
+	spi_tty_write_worker(&mdm6600->write_work);
+	return IRQ_HANDLED;
+}
+
+/*
+ * BP -> AP wake trigger: keep the system up until the BP has had time
+ * to raise MRDY, which mdm6600_spi_resume unmasks as soon as our SPI
+ * controller is back rather than when the whole system is.
+ */
+static int mdm6600_spi_bp_wake(struct notifier_block *nb,
+			       unsigned long level, void *unused)
+{
+	struct mdm6600_spi_tty_device *mdm6600 = container_of(nb,
+		struct mdm6600_spi_tty_device, bp_wake_notify);
+
+	wake_lock_timeout(&mdm6600->wakelock, SPI_TTY_WAKE_LOCK_TIMEOUT);
+	return NOTIFY_OK;
+}
+
 static void mdm6600_active_slave_srdy(void *ptr)
 {
+	unsigned long flags;
 	struct mdm6600_spi_msg *spi_msg;
 	struct mdm6600_spi_tty_device *mdm6600_tty;
 	int state;
@@ -687,10 +919,19 @@ static void mdm6600_active_slave_srdy(void *ptr)
 	spi_msg = ptr;
 	mdm6600_tty = spi_msg->data;
 
-	if (mdm6600_tty->msg_pool.xfer_list.count <= SPI_MSG_PENDING_MAX)
+	if (mdm6600_tty->msg_pool.xfer_list.count <= pending_max)
 		wake_up_interruptible(&mdm6600_tty->xfer_wait);
 
+	spi_lat_record(SPI_LAT_XFER_QUEUE, spi_msg->queued);
+	spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
+	if (mdm6600_tty->mrdy_time.tv64) {
+		spi_lat_record(SPI_LAT_MRDY_SRDY, mdm6600_tty->mrdy_time);
+		mdm6600_tty->mrdy_time.tv64 = 0;
+	}
+	spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
+
 	gpio_direction_output(mdm6600_tty->pdata->gpio_srdy, 0);
+	spi_msg->started = ktime_get();
 	state = gpio_get_value(mdm6600_tty->pdata->gpio_mrdy);
 	SPI_IPC_INFO("%s: after setting output, MRDY state is %d\n",\
 		 __func__, state);
@@ -706,6 +947,7 @@ static void mdm6600_deactive_slave_srdy(void *ptr)
 	spi_msg = ptr;
 	mdm6600_tty = spi_msg->data;
 	gpio_direction_output(mdm6600_tty->pdata->gpio_srdy, 1);
+	spi_lat_record(SPI_LAT_XFER, spi_msg->started);
 	DBGBUF("XFER     spi_msg %d tx_buf %d rx_buf %d\n",
 		spi_msg->id, spi_msg->tx->id, spi_msg->rx->id);
 	mdm6600_tty->wait_for_mrdy = 0;
@@ -719,25 +961,54 @@ static void mdm6600_deactive_slave_srdy(void *ptr)
 
 static void mdm6600_spi_msg_complete_cb(void *ptr)
 {
+	unsigned long flags;
 	struct mdm6600_spi_msg *spi_msg;
 	struct mdm6600_spi_tty_device *mdm6600_tty;
+	struct tty_struct *tty = NULL;
 
 	spi_msg = ptr;
 	mdm6600_tty = spi_msg->data;
 	spi_msg->xfer.tx_buf = NULL;
 	spi_msg->xfer.rx_buf = NULL;
+	dma_unmap_single(&mdm6600_tty->spi->dev, spi_msg->rx->dma,
+			spi_msg->xfer.len, DMA_FROM_DEVICE);
 
+	trace_mdm6600_spi_xfer_done(spi_msg->id, spi_msg->msg.status,
+				    spi_msg->msg.actual_length);
 	DBGBUF("COMPLETE spi_msg %d tx_buf %d rx_buf %d\n",
 		spi_msg->id, spi_msg->tx->id, spi_msg->rx->id);
 	mdm6600_spi_buf_remove(spi_msg->rx,
 			&mdm6600_tty->buf_pool.xfer_list);
+
+	/* what the BP asks of the next frame */
+	if (varlen) {
+		struct spi_tty_msg *msg =
+			(struct spi_tty_msg *)spi_msg->rx->buf;
+
+		if (!spi_msg->msg.status &&
+		    spi_msg->msg.actual_length == spi_msg->xfer.len &&
+		    spi_tty_msg_valid(msg, spi_msg->xfer.len)) {
+			u32 msg_type = le32_to_cpu(msg->type);
+
+			mdm6600_tty->bp_varlen = !!(msg_type & SPI_MSG_VARLEN);
+			mdm6600_tty->bp_next = msg_type >> SPI_MSG_NEXT_SHIFT;
+			mdm6600_tty->resync = 0;
+		} else {
+			mdm6600_tty->bp_varlen = 0;
+			mdm6600_tty->resync = 1;
+		}
+	}
+
 	if (!spi_msg->msg.status && (spi_msg->msg.actual_length
-				 == SPI_TRANSACTION_LEN)) {
+				 == spi_msg->xfer.len)) {
 		tx_count++;
 		tx_size += spi_msg->xfer.len - SPI_MSG_HEADER_LEN;
 		DBGBUF("BUF %d pending\n", spi_msg->rx->id);
+		spi_msg->rx->pended = ktime_get();
 		mdm6600_spi_buf_add(spi_msg->rx,
 				&mdm6600_tty->buf_pool.pend_list);
+		spi_lat_hwm(&pend_list_hwm,
+				mdm6600_tty->buf_pool.pend_list.count);
 	} else {
 		dev_err(&mdm6600_tty->spi->dev, "failed to transfer data! "
 			"status %d actual_len %u\n", spi_msg->msg.status,
@@ -747,15 +1018,23 @@ static void mdm6600_spi_msg_complete_cb(void *ptr)
 				&mdm6600_tty->buf_pool.free_list);
 	}
 	spi_msg->rx = NULL;
-	mdm6600_spi_buf_remove(spi_msg->tx,
-			 &mdm6600_tty->buf_pool.xfer_list);
-	DBGBUF("BUF %d free\n", spi_msg->tx->id);
-	mdm6600_spi_buf_add(spi_msg->tx, &mdm6600_tty->buf_pool.free_list);
-	spi_msg->tx = NULL;
+	spi_msg->count = 0;
+	spi_msg->offset = 0;
 	mdm6600_spi_msg_remove(spi_msg,
 			&mdm6600_tty->msg_pool.xfer_list);
 	DBGBUF("MSG %d free\n", spi_msg->id);
 	mdm6600_spi_msg_add(spi_msg, &mdm6600_tty->msg_pool.free_list);
+	if (varlen)
+		wake_up_interruptible(&mdm6600_tty->xfer_wait);
+
+	/* a frame is free for writers again */
+	wake_up_interruptible(&mdm6600_tty->write_wait);
+	spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
+	if (mdm6600_tty->open_count)
+		tty = mdm6600_tty->tty;
+	spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
+	if (tty)
+		tty_wakeup(tty);
 }
 
 static int mdm6600_spi_trans_pending(struct mdm6600_spi_tty_device
@@ -784,8 +1063,11 @@ static int mdm6600_spi_rx_buf_processing(void *data)
 		if (mdm6600_tty->rx_buf) {
 			DBGBUF("BUF %d in processing\n",
 					mdm6600_tty->rx_buf->id);
+			spi_lat_record(SPI_LAT_RX_PEND,
+					mdm6600_tty->rx_buf->pended);
 			spi_tty_handle_data(mdm6600_tty,
-					mdm6600_tty->rx_buf->buf);
+					mdm6600_tty->rx_buf->buf,
+					mdm6600_tty->rx_buf->len);
 			DBGBUF("BUF %d free\n", mdm6600_tty->rx_buf->id);
 			mdm6600_spi_buf_add(mdm6600_tty->rx_buf,
 					&mdm6600_tty->buf_pool.free_list);
@@ -857,6 +1139,9 @@ static ssize_t mdm6600_spi_buf_show(struct device *dev,
 		else if (ms_list == &mdm6600_tty->msg_pool.xfer_list)
 			status += scnprintf(&buf[status], PAGE_SIZE - status,
 				"%s ", "XFER    ");
+		else if (ms_list == &mdm6600_tty->msg_pool.ready_list)
+			status += scnprintf(&buf[status], PAGE_SIZE - status,
+				"%s ", "READY   ");
 		else
 			status += scnprintf(&buf[status], PAGE_SIZE - status,
 				"%p ", ms_list);
@@ -925,8 +1210,9 @@ static int mdm6600_spi_config_gpio(struct mdm6600_spi_tty_device *mdm6600)
 
 	/*how to specify only falling edge for interrupt?*/
 	irq_set_irq_type(mrdy_irq, IRQ_TYPE_LEVEL_LOW);
-	err = request_irq(mrdy_irq, mdm6600_spi_mrdy_irq_handler,
-		IRQ_TYPE_LEVEL_LOW, "MRDY GPIO IRQ", mdm6600);
+	err = request_threaded_irq(mrdy_irq, mdm6600_spi_mrdy_irq_handler,
+		mdm6600_spi_mrdy_irq_thread, IRQ_TYPE_LEVEL_LOW,
+		"MRDY GPIO IRQ", mdm6600);
 
 	if (err < 0) {
 		dev_err(&mdm6600->spi->dev,
@@ -954,7 +1240,7 @@ static int mdm6600_spi_suspend(struct spi_device *dev, pm_message_t mesg)
 	spin_lock_irqsave(&__mdm6600_spi_tty_device->port_lock, flags);
 	if (__mdm6600_spi_tty_device->mrdy_irq_status == MRDY_IRQ_ENABLE) {
 		__mdm6600_spi_tty_device->mrdy_irq_status = MRDY_IRQ_DISABLE;
-		disable_irq(__mdm6600_spi_tty_device->mrdy_irq);
+		disable_irq_nosync(__mdm6600_spi_tty_device->mrdy_irq);
 	}
 
 	if (__mdm6600_spi_tty_device->complete_status == SPI_TTY_START)
@@ -965,6 +1251,9 @@ static int mdm6600_spi_suspend(struct spi_device *dev, pm_message_t mesg)
 
 	spin_unlock_irqrestore(&__mdm6600_spi_tty_device->port_lock, flags);
 
+	/* the irq thread may sleep, wait for it outside the lock */
+	synchronize_irq(__mdm6600_spi_tty_device->mrdy_irq);
+
 	return ret;
 }
 
@@ -1017,6 +1306,38 @@ static void mdm6600_spi_buf_destroy(struct mdm6600_spi_buf *spi_buf, int num)
 		kfree(spi_buf->buf);
 }
 
+/* tx frames, coherent: spi_tty_write writes them, the dma reads them */
+static int mdm6600_spi_frame_init(struct mdm6600_spi_msg *spi_msg, int num)
+{
+	int i;
+	for (i = 0; i < num; i++, spi_msg++) {
+		spi_msg->tx = &spi_msg->tx_frame;
+		spi_msg->tx->id = i + 1;
+		spi_msg->tx->buf = dma_alloc_coherent(NULL,
+				SPI_TRANSACTION_LEN, &spi_msg->tx->dma,
+				GFP_KERNEL);
+		if (!spi_msg->tx->buf) {
+			while (i != 0) {
+				--i;
+				--spi_msg;
+				dma_free_coherent(NULL, SPI_TRANSACTION_LEN,
+					spi_msg->tx->buf, spi_msg->tx->dma);
+			}
+			return -ENOMEM;
+		}
+	}
+	return 0;
+}
+
+static void mdm6600_spi_frame_destroy(struct mdm6600_spi_msg *spi_msg,
+				int num)
+{
+	int i;
+	for (i = 0; i < num; i++, spi_msg++)
+		dma_free_coherent(NULL, SPI_TRANSACTION_LEN,
+				spi_msg->tx->buf, spi_msg->tx->dma);
+}
+
 static int mdm6600_spi_buf_mass_add(struct mdm6600_spi_buf *spi_buf, int num,
 				struct mdm6600_spi_list *ms_list)
 {
@@ -1041,6 +1362,7 @@ static void mdm6600_spi_msg_init(struct mdm6600_spi_msg *spi_msg, int num,
 	for (i = 0; i < num; i++, spi_msg++) {
 		spi_msg->id = i + 1;
 		spi_message_init(&spi_msg->msg);
+		spi_msg->msg.is_dma_mapped = 1;
 		spi_msg->msg.complete = mdm6600_spi_msg_complete_cb;
 		spi_msg->msg.context = spi_msg;
 		spi_msg->xfer.bits_per_word = 32;
@@ -1088,13 +1410,6 @@ static int __devinit mdm6600_spi_probe(struct spi_device *spi)
 	tx_count = 0L;
 	write_count = 0L;
 
-	mdm6600_tty->write_buf = spi_tty_buf_alloc();
-	if (!mdm6600_tty->write_buf) {
-		dev_err(&spi->dev, "failed to malloc spi_tty write buf!\n");
-		err = -ENOMEM;
-		goto err_free;
-	}
-
 
 	mdm6600_tty->throttle = 0;
 	mdm6600_tty->open_count = 0;
@@ -1108,13 +1423,12 @@ static int __devinit mdm6600_spi_probe(struct spi_device *spi)
 	init_waitqueue_head(&mdm6600_tty->write_wait);
 	init_waitqueue_head(&mdm6600_tty->close_wait);
 	init_waitqueue_head(&mdm6600_tty->xfer_wait);
-	mdm6600_tty->write_buf_full = 0;
 
 	mdm6600_tty->work_queue = create_singlethread_workqueue("spi_tty_wq");
 	if (mdm6600_tty->work_queue == NULL) {
 		dev_err(&spi->dev, "Failed to create work queue\n");
 		err = -ESRCH;
-		goto err_free_cb;
+		goto err_free;
 	}
 
 	mdm6600_spi_list_init(&mdm6600_tty->buf_pool.free_list, "buf_free");
@@ -1122,8 +1436,14 @@ static int __devinit mdm6600_spi_probe(struct spi_device *spi)
 	mdm6600_spi_list_init(&mdm6600_tty->buf_pool.pend_list, "buf_pend");
 	mdm6600_spi_list_init(&mdm6600_tty->msg_pool.free_list, "msg_free");
 	mdm6600_spi_list_init(&mdm6600_tty->msg_pool.xfer_list, "msg_xfer");
+	mdm6600_spi_list_init(&mdm6600_tty->msg_pool.ready_list, "msg_ready");
+	err = -ENOMEM;
 	if (mdm6600_spi_buf_init(mdm6600_tty->spi_buf, SPI_BUF_NUM))
 		goto err_free_wq;
+	if (mdm6600_spi_frame_init(mdm6600_tty->spi_msg, SPI_MSG_NUM)) {
+		mdm6600_spi_buf_destroy(mdm6600_tty->spi_buf, SPI_BUF_NUM);
+		goto err_free_wq;
+	}
 	mdm6600_spi_buf_mass_add(mdm6600_tty->spi_buf, SPI_BUF_NUM,
 				&mdm6600_tty->buf_pool.free_list);
 	mdm6600_spi_msg_init(mdm6600_tty->spi_msg, SPI_MSG_NUM,
@@ -1138,6 +1458,8 @@ static int __devinit mdm6600_spi_probe(struct spi_device *spi)
 
 	mdm6600_tty->pm_notify.notifier_call = tty_pm_notify;
 	register_pm_notifier(&mdm6600_tty->pm_notify);
+	mdm6600_tty->bp_wake_notify.notifier_call = mdm6600_spi_bp_wake;
+	mapphone_bpwake_register_notifier(&mdm6600_tty->bp_wake_notify);
 
 	/*
 	 * spi_tty_open should be the only place using
@@ -1166,11 +1488,10 @@ static int __devinit mdm6600_spi_probe(struct spi_device *spi)
 err_stop_rx_thread:
 	kthread_stop(mdm6600_tty->rx_thread);
 err_free_spi_buf:
+	mdm6600_spi_frame_destroy(mdm6600_tty->spi_msg, SPI_MSG_NUM);
 	mdm6600_spi_buf_destroy(mdm6600_tty->spi_buf, SPI_BUF_NUM);
 err_free_wq:
 	destroy_workqueue(mdm6600_tty->work_queue);
-err_free_cb:
-	spi_tty_buf_free(mdm6600_tty->write_buf);
 err_free:
 	kfree(mdm6600_tty);
 
@@ -1182,7 +1503,22 @@ err_free:
 
 static int mdm6600_spi_resume(struct spi_device *dev)
 {
+	unsigned long flags;
+	struct mdm6600_spi_tty_device *mdm6600_tty = spi_get_drvdata(dev);
+
 	SPI_IPC_INFO("%s\n", __func__);
+
+	/*
+	 * Our controller is back, so answer a pending MRDY now instead
+	 * of from tty_pm_notify once every other device is resumed and
+	 * tasks are thawed.
+	 */
+	spin_lock_irqsave(&mdm6600_tty->port_lock, flags);
+	if (mdm6600_tty->mrdy_irq_status == MRDY_IRQ_DISABLE) {
+		mdm6600_tty->mrdy_irq_status = MRDY_IRQ_ENABLE;
+		enable_irq(mdm6600_tty->mrdy_irq);
+	}
+	spin_unlock_irqrestore(&mdm6600_tty->port_lock, flags);
 	return 0;
 }
 
@@ -1242,7 +1578,7 @@ static int spi_tty_write_room(struct tty_struct *tty)
 		if (spi_tty->throttle == 1)
 			room = 0;
 		else
-			room = spi_tty_buf_room_avail(spi_tty->write_buf);
+			room = spi_tty_tx_room(spi_tty);
 	}
 
 	spin_unlock_irqrestore(&spi_tty->port_lock, flags);
@@ -1343,6 +1679,64 @@ static const struct tty_operations serial_ops = {
 	.throttle = NULL,
 	.unthrottle = NULL,
 };
+static int spi_lat_show(struct seq_file *s, void *unused)
+{
+	struct spi_lat_hist lat[SPI_LAT_NUM];
+	unsigned long flags;
+	int i, j;
+
+	spin_lock_irqsave(&spi_lat_lock, flags);
+	memcpy(lat, spi_lat, sizeof(lat));
+	spin_unlock_irqrestore(&spi_lat_lock, flags);
+
+	seq_printf(s, "%-8s", "us");
+	for (i = 0; i < SPI_LAT_NUM; i++)
+		seq_printf(s, " %12s", spi_lat_names[i]);
+	seq_printf(s, "\n");
+	for (j = 0; j < SPI_LAT_BUCKETS; j++) {
+		if (j == SPI_LAT_BUCKETS - 1)
+			seq_printf(s, ">=%-6u", 1 << (j - 1));
+		else
+			seq_printf(s, "<%-7u", 1 << j);
+		for (i = 0; i < SPI_LAT_NUM; i++)
+			seq_printf(s, " %12u", lat[i].bucket[j]);
+		seq_printf(s, "\n");
+	}
+	seq_printf(s, "%-8s", "max");
+	for (i = 0; i < SPI_LAT_NUM; i++)
+		seq_printf(s, " %12u", lat[i].max_us);
+	seq_printf(s, "\n\nxfer_list high water %d\npend_list high water %d\n",
+		xfer_list_hwm, pend_list_hwm);
+	return 0;
+}
+
+static int spi_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, spi_lat_show, inode->i_private);
+}
+
+/* any write clears the histograms and the high water marks */
+static ssize_t spi_lat_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&spi_lat_lock, flags);
+	memset(spi_lat, 0, sizeof(spi_lat));
+	xfer_list_hwm = 0;
+	pend_list_hwm = 0;
+	spin_unlock_irqrestore(&spi_lat_lock, flags);
+	return count;
+}
+
+static const struct file_operations spi_lat_fops = {
+	.open		= spi_lat_open,
+	.read		= seq_read,
+	.write		= spi_lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int debugfs_tx_info_init(void)
 {
 	struct dentry *d;
@@ -1375,12 +1769,19 @@ static int debugfs_tx_info_init(void)
 	if (!d)
 		return -ENOMEM;
 
+	d = debugfs_create_file("latency", S_IRUGO|S_IWUSR,
+			mdm6600_spi_tty_debug_root, NULL, &spi_lat_fops);
+	if (!d)
+		return -ENOMEM;
+
 	return 0;
 }
 static int __init mdm6600_spi_tty_init(void)
 {
 	int ret;
 
+	pending_max = clamp(pending_max, 1, SPI_MSG_NUM - SPI_MSG_TX_RESERVE);
+
 	spi_tty_driver = alloc_tty_driver(SPI_TTY_MINORS);
 	if (!spi_tty_driver)
 		return -ENOMEM;
@@ -1436,8 +1837,9 @@ static void mdm6600_spi_tty_shutdown(void)
 		kthread_stop(__mdm6600_spi_tty_device->rx_thread);
 		mdm6600_spi_buf_destroy(__mdm6600_spi_tty_device->spi_buf,
 					SPI_BUF_NUM);
+		mdm6600_spi_frame_destroy(__mdm6600_spi_tty_device->spi_msg,
+					SPI_MSG_NUM);
 		destroy_workqueue(__mdm6600_spi_tty_device->work_queue);
-		spi_tty_buf_free(__mdm6600_spi_tty_device->write_buf);
 		wake_lock_destroy(&__mdm6600_spi_tty_device->wakelock);
 
 		kfree(__mdm6600_spi_tty_device);
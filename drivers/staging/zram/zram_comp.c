@@ -0,0 +1,194 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/lz4.h>
+#include <linux/lzo.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/sysfs.h>
+#include <linux/zlib.h>
+
+#include "zram_comp.h"
+
+static size_t lzo_compress_mem(void)
+{
+	return LZO1X_MEM_COMPRESS;
+}
+
+static int lzo_compress(const unsigned char *src, unsigned char *dst,
+			size_t *dst_len, void *mem)
+{
+	int ret = lzo1x_1_compress(src, PAGE_SIZE, dst, dst_len, mem);
+
+	return ret == LZO_E_OK ? 0 : -EINVAL;
+}
+
+static int lzo_decompress(const unsigned char *src, size_t src_len,
+			  unsigned char *dst, void *mem)
+{
+	size_t dst_len = PAGE_SIZE;
+	int ret = lzo1x_decompress_safe(src, src_len, dst, &dst_len);
+
+	return ret == LZO_E_OK && dst_len == PAGE_SIZE ? 0 : -EINVAL;
+}
+
+#ifdef CONFIG_ZRAM_LZ4
+static size_t lz4_compress_mem(void)
+{
+	return LZ4_MEM_COMPRESS;
+}
+
+static int zram_lz4_compress(const unsigned char *src, unsigned char *dst,
+			     size_t *dst_len, void *mem)
+{
+	return lz4_compress(src, PAGE_SIZE, dst, dst_len, mem) ? -EINVAL : 0;
+}
+
+static int zram_lz4_decompress(const unsigned char *src, size_t src_len,
+			       unsigned char *dst, void *mem)
+{
+	size_t dst_len = PAGE_SIZE;
+	int ret = lz4_decompress(src, src_len, dst, &dst_len);
+
+	return !ret && dst_len == PAGE_SIZE ? 0 : -EINVAL;
+}
+#endif
+
+#ifdef CONFIG_ZRAM_DEFLATE
+/*
+ * Raw deflate at its fastest level. A window the size of a page is all
+ * it can use, and a smaller hash keeps the per-stream memory down.
+ */
+#define ZRAM_DEFLATE_WINBITS	PAGE_SHIFT
+#define ZRAM_DEFLATE_MEMLEVEL	6
+
+static size_t deflate_compress_mem(void)
+{
+	return zlib_deflate_workspacesize(ZRAM_DEFLATE_WINBITS,
+					  ZRAM_DEFLATE_MEMLEVEL);
+}
+
+static size_t deflate_decompress_mem(void)
+{
+	return zlib_inflate_workspacesize();
+}
+
+static int deflate_compress(const unsigned char *src, unsigned char *dst,
+			    size_t *dst_len, void *mem)
+{
+	z_stream strm = {
+		.workspace = mem,
+	};
+	int ret;
+
+	ret = zlib_deflateInit2(&strm, Z_BEST_SPEED, Z_DEFLATED,
+				-ZRAM_DEFLATE_WINBITS, ZRAM_DEFLATE_MEMLEVEL,
+				Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	strm.next_in = src;
+	strm.avail_in = PAGE_SIZE;
+	strm.next_out = dst;
+	strm.avail_out = 2 * PAGE_SIZE;
+
+	ret = zlib_deflate(&strm, Z_FINISH);
+	zlib_deflateEnd(&strm);
+	if (ret != Z_STREAM_END)
+		return -EINVAL;
+
+	*dst_len = strm.total_out;
+	return 0;
+}
+
+static int deflate_decompress(const unsigned char *src, size_t src_len,
+			      unsigned char *dst, void *mem)
+{
+	z_stream strm = {
+		.workspace = mem,
+	};
+	int ret;
+
+	ret = zlib_inflateInit2(&strm, -ZRAM_DEFLATE_WINBITS);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	strm.next_in = src;
+	strm.avail_in = src_len;
+	strm.next_out = dst;
+	strm.avail_out = PAGE_SIZE;
+
+	ret = zlib_inflate(&strm, Z_FINISH);
+	zlib_inflateEnd(&strm);
+
+	return ret == Z_STREAM_END && strm.total_out == PAGE_SIZE ?
+		0 : -EINVAL;
+}
+#endif
+
+static const struct zram_comp_ops zram_comps[] = {
+	{
+		.name		= "lzo",
+		.compress_mem	= lzo_compress_mem,
+		.compress	= lzo_compress,
+		.decompress	= lzo_decompress,
+	},
+#ifdef CONFIG_ZRAM_LZ4
+	{
+		.name		= "lz4",
+		.compress_mem	= lz4_compress_mem,
+		.compress	= zram_lz4_compress,
+		.decompress	= zram_lz4_decompress,
+	},
+#endif
+#ifdef CONFIG_ZRAM_DEFLATE
+	{
+		.name		= "deflate",
+		.compress_mem	= deflate_compress_mem,
+		.decompress_mem	= deflate_decompress_mem,
+		.compress	= deflate_compress,
+		.decompress	= deflate_decompress,
+	},
+#endif
+};
+
+const struct zram_comp_ops *zram_comp_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(zram_comps); i++)
+		if (sysfs_streq(name, zram_comps[i].name))
+			return &zram_comps[i];
+
+	return NULL;
+}
+
+/* List the algorithms for sysfs, the one in use in brackets */
+ssize_t zram_comp_show(const struct zram_comp_ops *cur, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(zram_comps); i++) {
+		if (&zram_comps[i] == cur)
+			len += sprintf(buf + len, "[%s] ", zram_comps[i].name);
+		else
+			len += sprintf(buf + len, "%s ", zram_comps[i].name);
+	}
+	buf[len - 1] = '\n';
+
+	return len;
+}
@@ -0,0 +1,45 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#ifndef _ZRAM_COMP_H_
+#define _ZRAM_COMP_H_
+
+#include <linux/types.h>
+
+#define ZRAM_COMP_DEFAULT	"lzo"
+
+/*
+ * A compression algorithm for zram pages. compress() may write up to
+ * 2 * PAGE_SIZE bytes to dst, decompress() always produces a full page.
+ * Both return 0 or a negative errno.
+ *
+ * The memory they use is allocated by zram, of the size the *_mem()
+ * callbacks return: compress() gets that of the write stream,
+ * decompress() a per-CPU area, as it runs atomically. Algorithms that
+ * decompress without scratch memory leave decompress_mem NULL.
+ */
+struct zram_comp_ops {
+	const char *name;
+	size_t (*compress_mem)(void);
+	size_t (*decompress_mem)(void);
+	int (*compress)(const unsigned char *src, unsigned char *dst,
+			size_t *dst_len, void *mem);
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			  unsigned char *dst, void *mem);
+};
+
+const struct zram_comp_ops *zram_comp_find(const char *name);
+ssize_t zram_comp_show(const struct zram_comp_ops *cur, char *buf);
+
+#endif
@@ -28,8 +28,10 @@
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
+#include <linux/jhash.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -37,6 +39,7 @@
 
 /* Globals */
 static int zram_major;
+static struct workqueue_struct *zram_bd_wq;
 struct zram *devices;
 
 /* Module params (documentation at end) */
@@ -71,6 +74,18 @@ static void zram_stat64_inc(struct zram *zram, u64 *v)
 	zram_stat64_add(zram, v, 1);
 }
 
+/* Account the time an algorithm took since 'start', from local_clock() */
+static void zram_stat_time(struct zram *zram, u64 *time, u64 *count,
+			   u64 start)
+{
+	u64 delta = local_clock() - start;
+
+	spin_lock(&zram->stat64_lock);
+	*time = *time + delta;
+	*count = *count + 1;
+	spin_unlock(&zram->stat64_lock);
+}
+
 static int zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
@@ -133,13 +148,47 @@ static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 	zram->disksize &= PAGE_MASK;
 }
 
-static void zram_free_page(struct zram *zram, size_t index)
+/*
+ * The compressed object of a slot: in the table itself, or in the
+ * shared entry with dedup.
+ */
+static struct table *zram_obj(struct zram *zram, u32 index)
+{
+	if (zram->dedup)
+		return &zram->table[index].entry->obj;
+
+	return &zram->table[index];
+}
+
+/* Free a compressed object, returning the size of its data */
+static u32 zram_free_object(struct zram *zram, struct table *obj)
 {
 	u32 clen;
-	void *obj;
+	void *cmem;
+
+	if (zram->allocator == ZRAM_ZSMALLOC) {
+		clen = obj->size;
+		zs_free(zram->zs_pool, obj->handle);
+		return clen;
+	}
+
+	cmem = kmap_atomic(obj->page, KM_USER0) + obj->offset;
+	clen = xv_get_object_size(cmem) - sizeof(struct zobj_header);
+	kunmap_atomic(cmem, KM_USER0);
+
+	xv_free(zram->mem_pool, obj->page, obj->offset);
+	return clen;
+}
 
+static void zram_free_page(struct zram *zram, size_t index)
+{
+	u32 clen;
+	struct zram_entry *entry;
 	struct page *page = zram->table[index].page;
-	u32 offset = zram->table[index].offset;
+
+	/* Tell a writeback in flight that the slot changed */
+	zram_clear_flag(zram, index, ZRAM_WB_PENDING);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
 
 	if (unlikely(!page)) {
 		/*
@@ -153,6 +202,14 @@ static void zram_free_page(struct zram *zram, size_t index)
 		return;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		clear_bit(zram->table[index].block, zram->bd_map);
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_stat_dec(&zram->stats.pages_wb);
+		zram_stat_dec(&zram->stats.pages_stored);
+		goto clear;
+	}
+
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		clen = PAGE_SIZE;
 		__free_page(page);
@@ -161,11 +218,26 @@ static void zram_free_page(struct zram *zram, size_t index)
 		goto out;
 	}
 
-	obj = kmap_atomic(page, KM_USER0) + offset;
-	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
-	kunmap_atomic(obj, KM_USER0);
+	if (!zram->dedup) {
+		clen = zram_free_object(zram, &zram->table[index]);
+		goto free_stats;
+	}
+
+	/* Other slots still share the data, only this reference goes */
+	entry = zram->table[index].entry;
+	if (--entry->refcount) {
+		zram_stat64_sub(zram, &zram->stats.dedup_size, entry->clen);
+		zram_stat_dec(&zram->stats.pages_dedup);
+		zram_stat_dec(&zram->stats.pages_stored);
+		goto clear;
+	}
+
+	if (!RB_EMPTY_NODE(&entry->node))
+		rb_erase(&entry->node, &zram->dedup_root);
+	clen = zram_free_object(zram, &entry->obj);
+	kfree(entry);
 
-	xv_free(zram->mem_pool, page, offset);
+free_stats:
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_dec(&zram->stats.good_compress);
 
@@ -173,10 +245,140 @@ out:
 	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
 	zram_stat_dec(&zram->stats.pages_stored);
 
+clear:
 	zram->table[index].page = NULL;
 	zram->table[index].offset = 0;
 }
 
+/*
+ * Map a compressed object, returning its data past the header and the
+ * data's length in 'clen'.
+ */
+static unsigned char *zram_map_object(struct zram *zram, struct table *obj,
+				      size_t *clen)
+{
+	unsigned char *cmem;
+
+	if (zram->allocator == ZRAM_ZSMALLOC) {
+		cmem = zs_map_object(zram->zs_pool, obj->handle, ZS_MM_RO);
+		*clen = obj->size;
+		return cmem + sizeof(struct zsobj_header);
+	}
+
+	cmem = kmap_atomic(obj->page, KM_USER1) + obj->offset;
+	*clen = xv_get_object_size(cmem) - sizeof(struct zobj_header);
+	return cmem + sizeof(struct zobj_header);
+}
+
+static void zram_unmap_object(struct zram *zram, struct table *obj,
+			      unsigned char *cmem)
+{
+	if (zram->allocator == ZRAM_ZSMALLOC)
+		zs_unmap_object(zram->zs_pool, obj->handle,
+				cmem - sizeof(struct zsobj_header));
+	else
+		kunmap_atomic(cmem, KM_USER1);
+}
+
+static void zram_bd_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/* Synchronous I/O of one page to or from a backing device block */
+static int zram_bd_rw(struct zram *zram, unsigned long block,
+		      struct page *page, int rw)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = block << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->bdev;
+	bio->bi_end_io = zram_bd_end_io;
+	bio->bi_private = &done;
+	if (bio_add_page(bio, page, PAGE_SIZE, 0) != PAGE_SIZE) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	submit_bio(rw, bio);
+	wait_for_completion(&done);
+
+	ret = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+
+	return ret;
+}
+
+struct zram_bd_read {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long block;
+	struct page *page;
+	int ret;
+};
+
+static void zram_bd_read_work(struct work_struct *work)
+{
+	struct zram_bd_read *rd = container_of(work, struct zram_bd_read,
+					       work);
+
+	rd->ret = zram_bd_rw(rd->zram, rd->block, rd->page, READ);
+}
+
+/*
+ * Read a page back from the backing device, on behalf of a bio to zram.
+ * Bios submitted from within make_request are only issued once it has
+ * returned, so the read has to be done from a worker.
+ */
+static int zram_bd_read(struct zram *zram, unsigned long block,
+			struct page *page)
+{
+	struct zram_bd_read rd = {
+		.zram = zram,
+		.block = block,
+		.page = page,
+	};
+
+	INIT_WORK_ONSTACK(&rd.work, zram_bd_read_work);
+	queue_work(zram_bd_wq, &rd.work);
+	flush_work(&rd.work);
+	destroy_work_on_stack(&rd.work);
+
+	if (likely(!rd.ret))
+		zram_stat64_inc(zram, &zram->stats.bd_reads);
+	else
+		pr_err("Backing device read failed! err=%d, block=%lu\n",
+		       rd.ret, block);
+
+	return rd.ret;
+}
+
+/* Called atomically, with the object mapped */
+static int zram_decompress(struct zram *zram, const unsigned char *src,
+			   size_t len, unsigned char *dst)
+{
+	void *mem = NULL;
+	u64 start = local_clock();
+	int ret;
+
+	if (zram->decomp_mem)
+		mem = *per_cpu_ptr(zram->decomp_mem, get_cpu());
+	ret = zram->comp->decompress(src, len, dst, mem);
+	if (zram->decomp_mem)
+		put_cpu();
+
+	zram_stat_time(zram, &zram->stats.decomp_time,
+		       &zram->stats.decomp_count, start);
+
+	return ret;
+}
+
 static void handle_zero_page(struct bio_vec *bvec)
 {
 	struct page *page = bvec->bv_page;
@@ -210,17 +412,61 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+static int handle_wb_page(struct zram *zram, struct bio_vec *bvec,
+			  unsigned long block, int offset)
+{
+	struct page *page = bvec->bv_page;
+	unsigned char *user_mem, *buf;
+	struct page *bounce;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = zram_bd_read(zram, block, page);
+		goto out;
+	}
+
+	bounce = alloc_page(GFP_NOIO);
+	if (!bounce)
+		return -ENOMEM;
+
+	ret = zram_bd_read(zram, block, bounce);
+	if (!ret) {
+		buf = page_address(bounce);
+		user_mem = kmap_atomic(page, KM_USER0);
+		memcpy(user_mem + bvec->bv_offset, buf + offset, bvec->bv_len);
+		kunmap_atomic(user_mem, KM_USER0);
+	}
+	__free_page(bounce);
+
+out:
+	if (!ret)
+		flush_dcache_page(page);
+	return ret;
+}
+
+/*
+ * Caller holds zram->lock for read. It is dropped while a page is read
+ * back from the backing device.
+ */
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
+	size_t csize;
 	struct page *page;
-	struct zobj_header *zheader;
+	struct table *obj;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
+	unsigned long block;
 
 	page = bvec->bv_page;
 
+again:
+	/*
+	 * Everyone else changes flags with zram->lock held for write, so
+	 * this can only race with other readers clearing the same bit.
+	 */
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+
 	if (zram_test_flag(zram, index, ZRAM_ZERO)) {
 		handle_zero_page(bvec);
 		return 0;
@@ -234,6 +480,23 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		return 0;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		/*
+		 * Writers should not wait for a disk read. The block stays
+		 * ours until the slot is rewritten, so if it was rewritten
+		 * meanwhile, start over.
+		 */
+		block = zram->table[index].block;
+		up_read(&zram->lock);
+		ret = handle_wb_page(zram, bvec, block, offset);
+		down_read(&zram->lock);
+
+		if (!zram_test_flag(zram, index, ZRAM_WB) ||
+		    zram->table[index].block != block)
+			goto again;
+		return ret;
+	}
+
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		handle_uncompressed_page(zram, bvec, index, offset);
@@ -252,14 +515,11 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	user_mem = kmap_atomic(page, KM_USER0);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
 
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-		zram->table[index].offset;
+	obj = zram_obj(zram, index);
+	cmem = zram_map_object(zram, obj, &csize);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    uncmem, &clen);
+	ret = zram_decompress(zram, cmem, csize, uncmem);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -267,11 +527,11 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		kfree(uncmem);
 	}
 
-	kunmap_atomic(cmem, KM_USER1);
+	zram_unmap_object(zram, obj, cmem);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -285,8 +545,8 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
-	struct zobj_header *zheader;
+	size_t csize;
+	struct table *obj;
 	unsigned char *cmem;
 
 	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
@@ -295,23 +555,33 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
-	cmem = kmap_atomic(zram->table[index].page, KM_USER0) +
-		zram->table[index].offset;
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		struct page *bounce = alloc_page(GFP_NOIO);
+
+		if (!bounce)
+			return -ENOMEM;
+		ret = zram_bd_read(zram, zram->table[index].block, bounce);
+		if (!ret)
+			memcpy(mem, page_address(bounce), PAGE_SIZE);
+		__free_page(bounce);
+		return ret;
+	}
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(zram->table[index].page, KM_USER0);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem, KM_USER0);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    mem, &clen);
-	kunmap_atomic(cmem, KM_USER0);
+	obj = zram_obj(zram, index);
+	cmem = zram_map_object(zram, obj, &csize);
+	ret = zram_decompress(zram, cmem, csize, mem);
+	zram_unmap_object(zram, obj, cmem);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -320,18 +590,258 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/*
+ * System overwrites unused sectors. Free memory associated with this
+ * sector now; a free deferred from swap must not hit the new data.
+ */
+static void zram_overwrite_page(struct zram *zram, u32 index)
+{
+	clear_bit(index, zram->free_pending);
+
+	if (zram->table[index].page ||
+	    zram_test_flag(zram, index, ZRAM_ZERO))
+		zram_free_page(zram, index);
+}
+
+/*
+ * Pages that compress to more than this are stored uncompressed. zsmalloc
+ * packs large objects without losing the rest of a page, so it only
+ * gives up on pages that don't compress at all.
+ */
+static size_t zram_max_zpage_size(struct zram *zram)
+{
+	if (zram->allocator == ZRAM_ZSMALLOC)
+		return ZS_MAX_ALLOC_SIZE - sizeof(struct zsobj_header);
+
+	return max_zpage_size;
+}
+
+/*
+ * Allocate the compressed object 'obj' and copy the data in; with
+ * zsmalloc, 'zheader' goes in front of it.
+ */
+static int zram_store_object(struct zram *zram, struct table *obj,
+			     struct zsobj_header *zheader,
+			     unsigned char *src, size_t clen)
+{
+	unsigned char *cmem;
+	u32 offset;
+
+	if (zram->allocator == ZRAM_ZSMALLOC) {
+		obj->handle = zs_malloc(zram->zs_pool, clen + sizeof(*zheader),
+					GFP_NOIO | __GFP_HIGHMEM);
+		if (!obj->handle)
+			return -ENOMEM;
+
+		cmem = zs_map_object(zram->zs_pool, obj->handle, ZS_MM_WO);
+		memcpy(cmem, zheader, sizeof(*zheader));
+		memcpy(cmem + sizeof(*zheader), src, clen);
+		zs_unmap_object(zram->zs_pool, obj->handle, cmem);
+
+		obj->size = clen;
+		return 0;
+	}
+
+	if (xv_malloc(zram->mem_pool, clen + sizeof(struct zobj_header),
+		      &obj->page, &offset, GFP_NOIO | __GFP_HIGHMEM))
+		return -ENOMEM;
+
+	obj->offset = offset;
+	cmem = kmap_atomic(obj->page, KM_USER1) + offset;
+	memcpy(cmem + sizeof(struct zobj_header), src, clen);
+	kunmap_atomic(cmem, KM_USER1);
+
+	return 0;
+}
+
+/*
+ * Look for stored data identical to what was just compressed. LZO output
+ * only depends on its input, so comparing compressed data is enough.
+ */
+static struct zram_entry *zram_dedup_find(struct zram *zram, u32 checksum,
+					  unsigned char *src, size_t clen)
+{
+	struct rb_node *node = zram->dedup_root.rb_node;
+	struct zram_entry *entry;
+	unsigned char *cmem;
+	size_t csize;
+	int match;
+
+	while (node) {
+		entry = rb_entry(node, struct zram_entry, node);
+		if (checksum < entry->checksum) {
+			node = node->rb_left;
+		} else if (checksum > entry->checksum) {
+			node = node->rb_right;
+		} else {
+			if (entry->clen != clen)
+				return NULL;
+
+			cmem = zram_map_object(zram, &entry->obj, &csize);
+			match = csize == clen && !memcmp(cmem, src, clen);
+			zram_unmap_object(zram, &entry->obj, cmem);
+
+			return match ? entry : NULL;
+		}
+	}
+
+	return NULL;
+}
+
+static void zram_dedup_insert(struct zram *zram, struct zram_entry *new)
+{
+	struct rb_node **link = &zram->dedup_root.rb_node, *parent = NULL;
+	struct zram_entry *entry;
+
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct zram_entry, node);
+		if (new->checksum < entry->checksum) {
+			link = &parent->rb_left;
+		} else if (new->checksum > entry->checksum) {
+			link = &parent->rb_right;
+		} else {
+			/* Checksum collision: keep the older one indexed */
+			RB_CLEAR_NODE(&new->node);
+			return;
+		}
+	}
+
+	rb_link_node(&new->node, parent, link);
+	rb_insert_color(&new->node, &zram->dedup_root);
+}
+
+/*
+ * Take an idle compression stream, waiting for one if all of them are
+ * in use: there are as many as CPUs, so that only happens when a writer
+ * got preempted or is waiting on zram->lock.
+ */
+static struct zram_stream *zram_stream_get(struct zram *zram)
+{
+	struct zram_stream *zstrm;
+
+	spin_lock(&zram->stream_lock);
+	while (list_empty(&zram->stream_list)) {
+		spin_unlock(&zram->stream_lock);
+		wait_event(zram->stream_wait,
+			   !list_empty(&zram->stream_list));
+		spin_lock(&zram->stream_lock);
+	}
+	zstrm = list_first_entry(&zram->stream_list, struct zram_stream, list);
+	list_del(&zstrm->list);
+	spin_unlock(&zram->stream_lock);
+
+	return zstrm;
+}
+
+static void zram_stream_put(struct zram *zram, struct zram_stream *zstrm)
+{
+	spin_lock(&zram->stream_lock);
+	list_add(&zstrm->list, &zram->stream_list);
+	spin_unlock(&zram->stream_lock);
+
+	wake_up(&zram->stream_wait);
+}
+
+static void zram_free_streams(struct zram *zram)
+{
+	struct zram_stream *zstrm, *tmp;
+
+	list_for_each_entry_safe(zstrm, tmp, &zram->stream_list, list) {
+		list_del(&zstrm->list);
+		vfree(zstrm->workmem);
+		free_pages((unsigned long)zstrm->buffer, 1);
+		kfree(zstrm);
+	}
+}
+
+static int zram_alloc_streams(struct zram *zram)
+{
+	struct zram_stream *zstrm;
+	int i;
+
+	for (i = 0; i < num_online_cpus(); i++) {
+		zstrm = kzalloc(sizeof(*zstrm), GFP_KERNEL);
+		if (!zstrm)
+			return -ENOMEM;
+		list_add(&zstrm->list, &zram->stream_list);
+
+		zstrm->workmem = vzalloc(zram->comp->compress_mem());
+		if (!zstrm->workmem) {
+			pr_err("Error allocating compressor working memory!\n");
+			return -ENOMEM;
+		}
+
+		zstrm->buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
+		if (!zstrm->buffer) {
+			pr_err("Error allocating compressor buffer space\n");
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void zram_free_decomp_mem(struct zram *zram)
+{
+	int cpu;
+
+	if (!zram->decomp_mem)
+		return;
+
+	for_each_possible_cpu(cpu)
+		vfree(*per_cpu_ptr(zram->decomp_mem, cpu));
+	free_percpu(zram->decomp_mem);
+	zram->decomp_mem = NULL;
+}
+
+static int zram_alloc_decomp_mem(struct zram *zram)
+{
+	void *mem;
+	int cpu;
+
+	if (!zram->comp->decompress_mem)
+		return 0;
+
+	zram->decomp_mem = alloc_percpu(void *);
+	if (!zram->decomp_mem)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		mem = vmalloc(zram->comp->decompress_mem());
+		if (!mem) {
+			pr_err("Error allocating decompressor memory!\n");
+			return -ENOMEM;
+		}
+		*per_cpu_ptr(zram->decomp_mem, cpu) = mem;
+	}
+
+	return 0;
+}
+
+/*
+ * Full page writes are compressed without zram->lock, into a stream of
+ * their own; the lock is only taken to update the table. A partial write
+ * has to read the old page first, so it holds the lock throughout.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
 	int ret;
-	u32 store_offset;
+	u32 checksum = 0;
+	u64 start;
 	size_t clen;
-	struct zobj_header *zheader;
+	bool locked = false;
+	struct table *obj;
+	struct zsobj_header zheader;
+	struct zram_entry *entry = NULL;
+	struct zram_stream *zstrm;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
+	zstrm = zram_stream_get(zram);
+	src = zstrm->buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -344,6 +854,8 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
+		down_write(&zram->lock);
+		locked = true;
 		ret = zram_read_before_write(zram, uncmem, index);
 		if (ret) {
 			kfree(uncmem);
@@ -351,14 +863,6 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		}
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].page ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
-
 	user_mem = kmap_atomic(page, KM_USER0);
 
 	if (is_partial_io(bvec))
@@ -371,30 +875,44 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		kunmap_atomic(user_mem, KM_USER0);
 		if (is_partial_io(bvec))
 			kfree(uncmem);
+		if (!locked) {
+			down_write(&zram->lock);
+			locked = true;
+		}
+		zram_overwrite_page(zram, index);
 		zram_stat_inc(&zram->stats.pages_zero);
 		zram_set_flag(zram, index, ZRAM_ZERO);
 		ret = 0;
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	start = local_clock();
+	ret = zram->comp->compress(uncmem, src, &clen, zstrm->workmem);
+	zram_stat_time(zram, &zram->stats.comp_time,
+		       &zram->stats.comp_count, start);
 
 	kunmap_atomic(user_mem, KM_USER0);
 	if (is_partial_io(bvec))
 			kfree(uncmem);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
 
+	if (!locked) {
+		down_write(&zram->lock);
+		locked = true;
+	}
+
+	zram_overwrite_page(zram, index);
+
 	/*
 	 * Page is incompressible. Store it as-is (uncompressed)
 	 * since we do not want to return too many disk write
 	 * errors which has side effect of hanging the system.
 	 */
-	if (unlikely(clen > max_zpage_size)) {
+	if (unlikely(clen > zram_max_zpage_size(zram))) {
 		clen = PAGE_SIZE;
 		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 		if (unlikely(!page_store)) {
@@ -404,53 +922,74 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 
-		store_offset = 0;
 		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
 		zram_stat_inc(&zram->stats.pages_expand);
 		zram->table[index].page = page_store;
+
 		src = kmap_atomic(page, KM_USER0);
-		goto memstore;
+		cmem = kmap_atomic(page_store, KM_USER1);
+		memcpy(cmem, src, clen);
+		kunmap_atomic(cmem, KM_USER1);
+		kunmap_atomic(src, KM_USER0);
+		goto update_stats;
+	}
+
+	if (zram->dedup) {
+		checksum = jhash(src, clen, 0);
+		entry = zram_dedup_find(zram, checksum, src, clen);
+		if (entry) {
+			/* Already stored for another slot: share it */
+			entry->refcount++;
+			zram->table[index].entry = entry;
+			zram_stat64_inc(zram, &zram->stats.dedup_hits);
+			zram_stat64_add(zram, &zram->stats.dedup_size, clen);
+			zram_stat_inc(&zram->stats.pages_dedup);
+			zram_stat_inc(&zram->stats.pages_stored);
+			ret = 0;
+			goto out;
+		}
+
+		entry = kzalloc(sizeof(*entry), GFP_NOIO);
+		if (!entry) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		obj = &entry->obj;
+		zheader.entry = entry;
+	} else {
+		obj = &zram->table[index];
+		zheader.table_idx = index;
 	}
 
-	if (xv_malloc(zram->mem_pool, clen + sizeof(*zheader),
-		      &zram->table[index].page, &store_offset,
-		      GFP_NOIO | __GFP_HIGHMEM)) {
+	ret = zram_store_object(zram, obj, &zheader, src, clen);
+	if (unlikely(ret)) {
 		pr_info("Error allocating memory for compressed "
 			"page: %u, size=%zu\n", index, clen);
-		ret = -ENOMEM;
+		kfree(entry);
 		goto out;
 	}
 
-memstore:
-	zram->table[index].offset = store_offset;
-
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-		zram->table[index].offset;
-
-#if 0
-	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
+	if (entry) {
+		entry->checksum = checksum;
+		entry->refcount = 1;
+		entry->clen = clen;
+		zram_dedup_insert(zram, entry);
+		zram->table[index].entry = entry;
 	}
-#endif
-
-	memcpy(cmem, src, clen);
-
-	kunmap_atomic(cmem, KM_USER1);
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
-		kunmap_atomic(src, KM_USER0);
 
+update_stats:
 	/* Update stats */
 	zram_stat64_add(zram, &zram->stats.compr_size, clen);
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
 
-	return 0;
+	ret = 0;
 
 out:
+	if (locked)
+		up_write(&zram->lock);
+	zram_stream_put(zram, zstrm);
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
@@ -466,9 +1005,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
 	}
 
 	return ret;
@@ -576,6 +1113,152 @@ static int zram_make_request(struct request_queue *queue, struct bio *bio)
 	return 0;
 }
 
+static unsigned long zram_bd_alloc(struct zram *zram)
+{
+	unsigned long block;
+
+	do {
+		block = find_next_zero_bit(zram->bd_map, zram->bd_blocks, 1);
+		if (block >= zram->bd_blocks)
+			return 0;
+	} while (test_and_set_bit(block, zram->bd_map));
+
+	return block;
+}
+
+static unsigned long zram_wb_period(struct zram *zram)
+{
+	return (zram->wb_idle_age ? : default_wb_scan_secs) * HZ;
+}
+
+/*
+ * Decide whether a slot goes to the backing device: incompressible (or,
+ * with wb_threshold, poorly compressed) pages right away, others once
+ * a full scan went by without them being accessed. If it does, copy its
+ * data to 'mem' and mark it pending.
+ *
+ * Called with zram->lock held for write.
+ */
+static int zram_wb_prepare(struct zram *zram, u32 index, char *mem)
+{
+	struct table *obj;
+	unsigned char *cmem;
+	size_t clen;
+	int huge;
+
+	if (!zram->table[index].page || zram_test_flag(zram, index, ZRAM_WB))
+		return 0;
+
+	huge = zram_test_flag(zram, index, ZRAM_UNCOMPRESSED);
+	if (!huge && zram->wb_threshold) {
+		obj = zram_obj(zram, index);
+		cmem = zram_map_object(zram, obj, &clen);
+		zram_unmap_object(zram, obj, cmem);
+		huge = clen > zram->wb_threshold;
+	}
+
+	if (!huge) {
+		if (!zram->wb_idle_age)
+			return 0;
+		if (!zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_set_flag(zram, index, ZRAM_IDLE);
+			return 0;
+		}
+	}
+
+	if (zram_read_before_write(zram, mem, index))
+		return 0;
+
+	zram_set_flag(zram, index, ZRAM_WB_PENDING);
+	return 1;
+}
+
+/*
+ * Periodic scan of the table for pages to write back. The I/O is done
+ * without zram->lock; a slot written or freed meanwhile loses its
+ * pending flag, and then the block is dropped instead.
+ */
+static void zram_writeback(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work),
+					 struct zram, wb_work);
+	size_t index, num_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long block;
+	struct page *page;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		goto out;
+
+	for (index = 0; index < num_pages; index++) {
+		down_write(&zram->lock);
+		ret = zram_wb_prepare(zram, index, page_address(page));
+		up_write(&zram->lock);
+		if (!ret)
+			continue;
+
+		block = zram_bd_alloc(zram);
+		if (block)
+			ret = zram_bd_rw(zram, block, page, WRITE);
+
+		down_write(&zram->lock);
+		if (!block || ret ||
+		    !zram_test_flag(zram, index, ZRAM_WB_PENDING)) {
+			zram_clear_flag(zram, index, ZRAM_WB_PENDING);
+			up_write(&zram->lock);
+			if (block)
+				clear_bit(block, zram->bd_map);
+			/* Backing device full or failing: try next time */
+			if (!block || ret)
+				break;
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram->table[index].block = block;
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_stat_inc(&zram->stats.pages_wb);
+		zram_stat_inc(&zram->stats.pages_stored);
+		up_write(&zram->lock);
+
+		zram_stat64_inc(zram, &zram->stats.bd_writes);
+		cond_resched();
+	}
+	__free_page(page);
+
+out:
+	queue_delayed_work(zram_bd_wq, &zram->wb_work, zram_wb_period(zram));
+}
+
+static int zram_bd_init(struct zram *zram)
+{
+	struct block_device *bdev;
+
+	bdev = blkdev_get_by_path(zram->bd_path,
+				  FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (IS_ERR(bdev)) {
+		pr_err("Error opening backing device %s\n", zram->bd_path);
+		return PTR_ERR(bdev);
+	}
+	zram->bdev = bdev;
+
+	zram->bd_blocks = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	if (zram->bd_blocks < 2) {
+		pr_err("Backing device %s is too small\n", zram->bd_path);
+		return -EINVAL;
+	}
+
+	zram->bd_map = vzalloc(BITS_TO_LONGS(zram->bd_blocks) * sizeof(long));
+	if (!zram->bd_map) {
+		pr_err("Error allocating backing device bitmap\n");
+		return -ENOMEM;
+	}
+	set_bit(0, zram->bd_map);
+
+	return 0;
+}
+
 void zram_reset_device(struct zram *zram)
 {
 	size_t index;
@@ -583,36 +1266,58 @@ void zram_reset_device(struct zram *zram)
 	mutex_lock(&zram->init_lock);
 	zram->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
+	/* Let any deferred frees and writeback finish with the table */
+	cancel_work_sync(&zram->free_work);
+	cancel_delayed_work_sync(&zram->wb_work);
 
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	/* Free various per-device buffers */
+	zram_free_streams(zram);
+	zram_free_decomp_mem(zram);
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		struct page *page;
-		u16 offset;
+		struct zram_entry *entry;
 
 		page = zram->table[index].page;
-		offset = zram->table[index].offset;
-
-		if (!page)
+		if (!page || zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
-		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
+		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 			__free_page(page);
-		else
-			xv_free(zram->mem_pool, page, offset);
+		} else if (zram->dedup) {
+			entry = zram->table[index].entry;
+			if (!--entry->refcount) {
+				zram_free_object(zram, &entry->obj);
+				kfree(entry);
+			}
+		} else {
+			zram_free_object(zram, &zram->table[index]);
+		}
 	}
+	zram->dedup_root = RB_ROOT;
 
 	vfree(zram->table);
 	zram->table = NULL;
 
+	vfree(zram->free_pending);
+	zram->free_pending = NULL;
+
 	xv_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
+	if (zram->zs_pool)
+		zs_destroy_pool(zram->zs_pool);
+	zram->zs_pool = NULL;
+
+	if (zram->bdev)
+		blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	zram->bdev = NULL;
+
+	vfree(zram->bd_map);
+	zram->bd_map = NULL;
+	zram->bd_blocks = 0;
+
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -634,19 +1339,13 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
+	ret = zram_alloc_streams(zram);
+	if (ret)
 		goto fail;
-	}
 
-	zram->compress_buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	ret = zram_alloc_decomp_mem(zram);
+	if (ret)
 		goto fail;
-	}
 
 	num_pages = zram->disksize >> PAGE_SHIFT;
 	zram->table = vzalloc(num_pages * sizeof(*zram->table));
@@ -658,18 +1357,36 @@ int zram_init_device(struct zram *zram)
 		goto fail;
 	}
 
+	zram->free_pending = vzalloc(BITS_TO_LONGS(num_pages) * sizeof(long));
+	if (!zram->free_pending) {
+		pr_err("Error allocating zram free bitmap\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = xv_create_pool();
-	if (!zram->mem_pool) {
+	if (zram->allocator == ZRAM_ZSMALLOC)
+		zram->zs_pool = zs_create_pool();
+	else
+		zram->mem_pool = xv_create_pool();
+	if (!zram->mem_pool && !zram->zs_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
 		goto fail;
 	}
 
+	if (zram->bd_path) {
+		ret = zram_bd_init(zram);
+		if (ret)
+			goto fail;
+		queue_delayed_work(zram_bd_wq, &zram->wb_work,
+				   zram_wb_period(zram));
+	}
+
 	zram->init_done = 1;
 	mutex_unlock(&zram->init_lock);
 
@@ -684,12 +1401,68 @@ fail:
 	return ret;
 }
 
+/* zs_compact() callback, runs with zram->lock held for write */
+static void zram_zs_migrate(void *priv, void *obj, unsigned long old_handle,
+			    unsigned long new_handle)
+{
+	struct zram *zram = priv;
+	struct zsobj_header *zheader = obj;
+	struct table *zobj;
+
+	if (zram->dedup)
+		zobj = &zheader->entry->obj;
+	else
+		zobj = &zram->table[zheader->table_idx];
+
+	WARN_ON(zobj->handle != old_handle);
+	zobj->handle = new_handle;
+}
+
+/*
+ * Pack the zsmalloc pool of an initialized device, returning the number
+ * of pages freed. I/O to the device waits meanwhile.
+ */
+unsigned long zram_compact(struct zram *zram)
+{
+	unsigned long freed;
+
+	down_write(&zram->lock);
+	freed = zs_compact(zram->zs_pool, zram_zs_migrate, zram);
+	up_write(&zram->lock);
+
+	return freed;
+}
+
+static void zram_free_pending(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, free_work);
+	size_t index;
+
+	down_write(&zram->lock);
+	for_each_set_bit(index, zram->free_pending,
+			 zram->disksize >> PAGE_SHIFT) {
+		clear_bit(index, zram->free_pending);
+		zram_free_page(zram, index);
+	}
+	up_write(&zram->lock);
+}
+
+/*
+ * Called under swap_lock, so zram->lock can only be tried: if I/O holds
+ * it, leave the slot to free_work.
+ */
 void zram_slot_free_notify(struct block_device *bdev, unsigned long index)
 {
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
-	zram_free_page(zram, index);
+	if (down_write_trylock(&zram->lock)) {
+		zram_free_page(zram, index);
+		up_write(&zram->lock);
+	} else {
+		set_bit(index, zram->free_pending);
+		schedule_work(&zram->free_work);
+	}
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -705,6 +1478,13 @@ static int create_device(struct zram *zram, int device_id)
 	init_rwsem(&zram->lock);
 	mutex_init(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	INIT_LIST_HEAD(&zram->stream_list);
+	spin_lock_init(&zram->stream_lock);
+	init_waitqueue_head(&zram->stream_wait);
+	INIT_WORK(&zram->free_work, zram_free_pending);
+	INIT_DELAYED_WORK(&zram->wb_work, zram_writeback);
+	zram->comp = zram_comp_find(ZRAM_COMP_DEFAULT);
+	zram->dedup_root = RB_ROOT;
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -747,6 +1527,12 @@ static int create_device(struct zram *zram, int device_id)
 	blk_queue_io_min(zram->disk->queue, PAGE_SIZE);
 	blk_queue_io_opt(zram->disk->queue, PAGE_SIZE);
 
+	/*
+	 * Reads are a decompression away: no swapin or file readahead
+	 * by default, read_ahead_kb can still turn it back on.
+	 */
+	zram->disk->queue->backing_dev_info.ra_pages = 0;
+
 	add_disk(zram->disk);
 
 	ret = sysfs_create_group(&disk_to_dev(zram->disk)->kobj,
@@ -787,11 +1573,17 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+	zram_bd_wq = alloc_workqueue("zram_bd", WQ_MEM_RECLAIM, 0);
+	if (!zram_bd_wq) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_warning("Unable to get major number\n");
 		ret = -EBUSY;
-		goto out;
+		goto destroy_wq;
 	}
 
 	if (!num_devices) {
@@ -821,6 +1613,8 @@ free_devices:
 	kfree(devices);
 unregister:
 	unregister_blkdev(zram_major, "zram");
+destroy_wq:
+	destroy_workqueue(zram_bd_wq);
 out:
 	return ret;
 }
@@ -836,9 +1630,11 @@ static void __exit zram_exit(void)
 		destroy_device(zram);
 		if (zram->init_done)
 			zram_reset_device(zram);
+		kfree(zram->bd_path);
 	}
 
 	unregister_blkdev(zram_major, "zram");
+	destroy_workqueue(zram_bd_wq);
 
 	kfree(devices);
 	pr_debug("Cleanup done!\n");
@@ -17,8 +17,14 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
+#include <linux/wait.h>
+
+#include <linux/workqueue.h>
 
 #include "xvmalloc.h"
+#include "zram_comp.h"
+#include "zsmalloc.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -38,6 +44,17 @@ struct zobj_header {
 #endif
 };
 
+/*
+ * zsmalloc moves objects around when compacted, so there the
+ * back-reference is always stored.
+ */
+struct zsobj_header {
+	union {
+		u32 table_idx;
+		struct zram_entry *entry;	/* with dedup */
+	};
+};
+
 /*-- Configurable parameters */
 
 /* Default zram disk size: 25% of total RAM */
@@ -49,6 +66,12 @@ static const unsigned default_disksize_perc_ram = 25;
  */
 static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
 
+/*
+ * With a backing device but no idle age set, this is how often (in
+ * seconds) the table is still scanned for incompressible pages.
+ */
+static const unsigned default_wb_scan_secs = 30;
+
 /*
  * NOTE: max_zpage_size must be less than or equal to:
  *   XV_MAX_ALLOC_SIZE - sizeof(struct zobj_header)
@@ -71,22 +94,58 @@ enum zram_pageflags {
 	/* Page is stored uncompressed */
 	ZRAM_UNCOMPRESSED,
 
+	/* Page is on the backing device, at table[].block */
+	ZRAM_WB,
+
+	/* Page was not accessed since the last writeback scan */
+	ZRAM_IDLE,
+
+	/* Page is being copied to the backing device */
+	ZRAM_WB_PENDING,
+
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
+/* Allocator for compressed pages, selectable per device before init */
+enum zram_allocator {
+	ZRAM_XVMALLOC,
+	ZRAM_ZSMALLOC,
+};
+
 /*-- Data structures */
 
 /* Allocated for each disk page */
 struct table {
-	struct page *page;
-	u16 offset;
+	union {
+		struct page *page;	/* xvmalloc, or uncompressed page */
+		unsigned long handle;	/* zsmalloc */
+		struct zram_entry *entry; /* compressed page, with dedup */
+		unsigned long block;	/* on the backing device */
+	};
+	union {
+		u16 offset;		/* xvmalloc: offset in page */
+		u16 size;		/* zsmalloc: compressed size */
+	};
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
 } __attribute__((aligned(4)));
 
+/*
+ * With dedup, every compressed page is stored through one of these and
+ * shared by all the slots holding the same data: zram_free_page() then
+ * only drops a reference.
+ */
+struct zram_entry {
+	struct rb_node node;	/* in dedup_root by checksum, or empty */
+	u32 checksum;		/* of the compressed data */
+	u32 refcount;		/* slots pointing here */
+	u32 clen;		/* compressed size */
+	struct table obj;	/* where the data is */
+};
+
 struct zram_stats {
 	u64 compr_size;		/* compressed size of pages stored */
 	u64 num_reads;		/* failed + successful */
@@ -95,20 +154,67 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
+	u64 dedup_hits;		/* writes that found their data stored */
+	u64 dedup_size;		/* compressed bytes not stored twice */
+	u64 bd_reads;		/* pages read back from backing device */
+	u64 bd_writes;		/* pages written back to it */
+	u64 comp_time;		/* ns spent compressing */
+	u64 comp_count;		/* pages compressed */
+	u64 decomp_time;	/* ns spent decompressing */
+	u64 decomp_count;	/* pages decompressed */
 	u32 pages_zero;		/* no. of zero filled pages */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_dedup;	/* no. of pages sharing another's data */
+	u32 pages_wb;		/* no. of pages on backing device */
+};
+
+/*
+ * Compressor working memory and output buffer. A device has one per
+ * online CPU, so that writes compress in parallel and only the table
+ * update is serialized.
+ */
+struct zram_stream {
+	struct list_head list;
+	void *workmem;
+	void *buffer;
 };
 
 struct zram {
 	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zs_pool *zs_pool;
+	enum zram_allocator allocator;
+	const struct zram_comp_ops *comp;	/* set before init */
+	void * __percpu *decomp_mem;	/* if comp needs any */
+	int dedup;		/* share identical pages, set before init */
+	struct rb_root dedup_root;
+	struct list_head stream_list;	/* idle zram_streams */
+	spinlock_t stream_lock;		/* protect stream_list */
+	wait_queue_head_t stream_wait;	/* wait for an idle stream */
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	struct rw_semaphore lock; /* protect table against concurrent
+				   * read and writes */
+	/*
+	 * Slots freed by swap while zram->lock was busy, for free_work
+	 * to release under it.
+	 */
+	unsigned long *free_pending;
+	struct work_struct free_work;
+
+	/*
+	 * Optional backing device that incompressible and idle pages are
+	 * written back to. Its block 0 is never used, so that a table
+	 * entry pointing there still looks allocated.
+	 */
+	char *bd_path;			/* set before init */
+	struct block_device *bdev;
+	unsigned long *bd_map;		/* blocks in use */
+	unsigned long bd_blocks;
+	u32 wb_threshold;		/* write back if compressed bigger */
+	u32 wb_idle_age;		/* seconds, write back if idle longer */
+	struct delayed_work wb_work;
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -131,5 +237,6 @@ extern struct attribute_group zram_disk_attr_group;
 
 extern int zram_init_device(struct zram *zram);
 extern void zram_reset_device(struct zram *zram);
+extern unsigned long zram_compact(struct zram *zram);
 
 #endif
@@ -0,0 +1,446 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifdef CONFIG_ZRAM_DEBUG
+#define DEBUG
+#endif
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+
+#include "zsmalloc.h"
+#include "zsmalloc_int.h"
+
+/*
+ * Objects that straddle two pages are copied through here while mapped;
+ * the mapping disables preemption, so one per CPU is enough.
+ */
+struct zs_map_area {
+	char buf[ZS_MAX_ALLOC_SIZE];
+	enum zs_mapmode mm;
+};
+
+static DEFINE_PER_CPU(struct zs_map_area, zs_map_area);
+
+static u32 get_size_class_index(u32 size)
+{
+	if (size <= ZS_MIN_ALLOC_SIZE)
+		return 0;
+
+	return DIV_ROUND_UP(size - ZS_MIN_ALLOC_SIZE, ZS_SIZE_CLASS_DELTA);
+}
+
+/*
+ * The number of pages per zspage that leaves the least space unused
+ * once the zspage is filled with objects of the given size.
+ */
+static u32 get_pages_per_zspage(u32 size)
+{
+	u32 i, best = 1, best_usedpc = 0;
+
+	for (i = 1; i <= ZS_MAX_PAGES_PER_ZSPAGE; i++) {
+		u32 zspage_size = i * PAGE_SIZE;
+		u32 usedpc;
+
+		usedpc = (zspage_size - zspage_size % size) * 100 / zspage_size;
+		if (usedpc > best_usedpc) {
+			best_usedpc = usedpc;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+static unsigned long obj_to_handle(struct zspage *zspage, u32 idx)
+{
+	return (page_to_pfn(zspage->pages[0]) << ZS_OBJ_INDEX_BITS) | idx;
+}
+
+static struct zspage *handle_to_obj(unsigned long handle, u32 *idx)
+{
+	struct page *page = pfn_to_page(handle >> ZS_OBJ_INDEX_BITS);
+
+	*idx = handle & ZS_OBJ_INDEX_MASK;
+	return (struct zspage *)page_private(page);
+}
+
+static int obj_is_spanning(struct size_class *class, u32 off)
+{
+	return (off & ~PAGE_MASK) + class->size > PAGE_SIZE;
+}
+
+/*
+ * Copy 'size' bytes at offset 'off' in a zspage to (or from, when
+ * 'to_buf' is false) a linear buffer, one page at a time.
+ */
+static void copy_object(struct zspage *zspage, u32 off, char *buf,
+			u32 size, int to_buf)
+{
+	while (size) {
+		u32 page_off = off & ~PAGE_MASK;
+		u32 len = min_t(u32, size, PAGE_SIZE - page_off);
+		char *addr;
+
+		addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER1);
+		if (to_buf)
+			memcpy(buf, addr + page_off, len);
+		else
+			memcpy(addr + page_off, buf, len);
+		kunmap_atomic(addr, KM_USER1);
+
+		buf += len;
+		off += len;
+		size -= len;
+	}
+}
+
+static struct zspage *alloc_zspage(struct zs_pool *pool,
+				   struct size_class *class, gfp_t flags)
+{
+	struct zspage *zspage;
+	struct page *page;
+	u32 i;
+
+	zspage = kzalloc(sizeof(*zspage), flags & ~__GFP_HIGHMEM);
+	if (unlikely(!zspage))
+		return NULL;
+
+	for (i = 0; i < class->pages_per_zspage; i++) {
+		page = alloc_page(flags);
+		if (unlikely(!page))
+			goto fail;
+
+		set_page_private(page, (unsigned long)zspage);
+		zspage->pages[i] = page;
+	}
+
+	INIT_LIST_HEAD(&zspage->list);
+	zspage->class = class;
+	atomic_long_add(class->pages_per_zspage, &pool->total_pages);
+
+	return zspage;
+
+fail:
+	while (i--) {
+		set_page_private(zspage->pages[i], 0);
+		__free_page(zspage->pages[i]);
+	}
+	kfree(zspage);
+	return NULL;
+}
+
+static void free_zspage(struct zs_pool *pool, struct zspage *zspage)
+{
+	struct size_class *class = zspage->class;
+	u32 i;
+
+	for (i = 0; i < class->pages_per_zspage; i++) {
+		set_page_private(zspage->pages[i], 0);
+		__free_page(zspage->pages[i]);
+	}
+	kfree(zspage);
+
+	atomic_long_sub(class->pages_per_zspage, &pool->total_pages);
+}
+
+/*
+ * Create a memory pool. Sets up the size classes; no pages are
+ * allocated until the first object is.
+ */
+struct zs_pool *zs_create_pool(void)
+{
+	struct zs_pool *pool;
+	int i;
+
+	BUILD_BUG_ON(ZS_MAX_OBJS_PER_ZSPAGE > ZS_OBJ_INDEX_MASK + 1);
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	for (i = 0; i < ZS_NR_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		class->size = ZS_MIN_ALLOC_SIZE + i * ZS_SIZE_CLASS_DELTA;
+		class->pages_per_zspage = get_pages_per_zspage(class->size);
+		class->objs_per_zspage = class->pages_per_zspage * PAGE_SIZE /
+					class->size;
+		INIT_LIST_HEAD(&class->partial);
+		INIT_LIST_HEAD(&class->full);
+		spin_lock_init(&class->lock);
+	}
+
+	return pool;
+}
+EXPORT_SYMBOL_GPL(zs_create_pool);
+
+/*
+ * All objects must have been freed.
+ */
+void zs_destroy_pool(struct zs_pool *pool)
+{
+	int i;
+
+	for (i = 0; i < ZS_NR_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		WARN_ON(!list_empty(&class->partial) ||
+			!list_empty(&class->full));
+	}
+	kfree(pool);
+}
+EXPORT_SYMBOL_GPL(zs_destroy_pool);
+
+/**
+ * zs_malloc - Allocate block of given size from pool.
+ * @pool: pool to allocate from
+ * @size: size of block to allocate
+ * @flags: flags for any pages the pool has to grow by
+ *
+ * On success, a handle to the object is returned, or 0 on failure.
+ * The handle is opaque: use zs_map_object() to get at the object.
+ *
+ * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
+ */
+unsigned long zs_malloc(struct zs_pool *pool, u32 size, gfp_t flags)
+{
+	struct size_class *class;
+	struct zspage *zspage;
+	unsigned long handle;
+	u32 idx;
+
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
+		return 0;
+
+	class = &pool->size_class[get_size_class_index(size)];
+
+	spin_lock(&class->lock);
+	if (list_empty(&class->partial)) {
+		spin_unlock(&class->lock);
+		zspage = alloc_zspage(pool, class, flags);
+		if (unlikely(!zspage))
+			return 0;
+
+		spin_lock(&class->lock);
+		list_add(&zspage->list, &class->partial);
+	}
+	zspage = list_first_entry(&class->partial, struct zspage, list);
+
+	idx = find_first_zero_bit(zspage->used, class->objs_per_zspage);
+	__set_bit(idx, zspage->used);
+	if (++zspage->inuse == class->objs_per_zspage)
+		list_move(&zspage->list, &class->full);
+
+	handle = obj_to_handle(zspage, idx);
+	spin_unlock(&class->lock);
+
+	return handle;
+}
+EXPORT_SYMBOL_GPL(zs_malloc);
+
+/*
+ * Free the object identified by 'handle'. Its zspage goes back to the
+ * page allocator as soon as it is empty.
+ */
+void zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	struct size_class *class;
+	struct zspage *zspage;
+	u32 idx;
+
+	zspage = handle_to_obj(handle, &idx);
+	class = zspage->class;
+
+	spin_lock(&class->lock);
+	BUG_ON(!__test_and_clear_bit(idx, zspage->used));
+
+	if (zspage->inuse-- == class->objs_per_zspage)
+		list_move(&zspage->list, &class->partial);
+
+	if (!zspage->inuse) {
+		list_del(&zspage->list);
+		spin_unlock(&class->lock);
+		free_zspage(pool, zspage);
+		return;
+	}
+	spin_unlock(&class->lock);
+}
+EXPORT_SYMBOL_GPL(zs_free);
+
+/**
+ * zs_map_object - get a pointer to an object
+ * @pool: pool the object was allocated from
+ * @handle: handle returned by zs_malloc()
+ * @mm: whether the object is about to be read or written
+ *
+ * The object can be accessed up to its allocated size until it is
+ * passed to zs_unmap_object(). The mapping is atomic, like kmap_atomic(),
+ * and mappings must be undone in the reverse order they were taken.
+ *
+ * The caller must keep the object from being freed, or moved by
+ * zs_compact(), while it has it mapped.
+ */
+void *zs_map_object(struct zs_pool *pool, unsigned long handle,
+		    enum zs_mapmode mm)
+{
+	struct zspage *zspage;
+	struct zs_map_area *area;
+	u32 idx, off;
+	char *addr;
+
+	zspage = handle_to_obj(handle, &idx);
+	off = idx * zspage->class->size;
+
+	if (!obj_is_spanning(zspage->class, off)) {
+		addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER1);
+		return addr + (off & ~PAGE_MASK);
+	}
+
+	area = &get_cpu_var(zs_map_area);
+	area->mm = mm;
+	if (mm == ZS_MM_RO)
+		copy_object(zspage, off, area->buf, zspage->class->size, 1);
+
+	return area->buf;
+}
+EXPORT_SYMBOL_GPL(zs_map_object);
+
+void zs_unmap_object(struct zs_pool *pool, unsigned long handle, void *obj)
+{
+	struct zspage *zspage;
+	struct zs_map_area *area;
+	u32 idx, off;
+
+	zspage = handle_to_obj(handle, &idx);
+	off = idx * zspage->class->size;
+
+	if (!obj_is_spanning(zspage->class, off)) {
+		kunmap_atomic(obj, KM_USER1);
+		return;
+	}
+
+	area = &__get_cpu_var(zs_map_area);
+	if (area->mm == ZS_MM_WO)
+		copy_object(zspage, off, area->buf, zspage->class->size, 0);
+	put_cpu_var(zs_map_area);
+}
+EXPORT_SYMBOL_GPL(zs_unmap_object);
+
+/*
+ * Move every object out of 'src', which must be off the class lists,
+ * into the partial zspages that are left. Caller holds class->lock and
+ * has checked that they have enough free objects.
+ */
+static void drain_zspage(struct size_class *class, struct zspage *src,
+			 zs_migrate_fn migrate, void *priv)
+{
+	struct zs_map_area *area = &__get_cpu_var(zs_map_area);
+	struct zspage *dst;
+	u32 sidx, didx, off;
+	char *addr;
+
+	for_each_set_bit(sidx, src->used, class->objs_per_zspage) {
+		dst = list_first_entry(&class->partial, struct zspage, list);
+		didx = find_first_zero_bit(dst->used, class->objs_per_zspage);
+		__set_bit(didx, dst->used);
+		if (++dst->inuse == class->objs_per_zspage)
+			list_move(&dst->list, &class->full);
+
+		copy_object(src, sidx * class->size, area->buf,
+			    class->size, 1);
+		off = didx * class->size;
+		copy_object(dst, off, area->buf, class->size, 0);
+
+		addr = kmap_atomic(dst->pages[off >> PAGE_SHIFT], KM_USER1);
+		migrate(priv, addr + (off & ~PAGE_MASK),
+			obj_to_handle(src, sidx), obj_to_handle(dst, didx));
+		kunmap_atomic(addr, KM_USER1);
+	}
+}
+
+static unsigned long compact_class(struct zs_pool *pool,
+				   struct size_class *class,
+				   zs_migrate_fn migrate, void *priv)
+{
+	struct zspage *zspage, *src;
+	unsigned long freed = 0;
+	u32 nr_free;
+
+	spin_lock(&class->lock);
+	for (;;) {
+		/* empty the least used zspage into the others, if they fit */
+		src = NULL;
+		nr_free = 0;
+		list_for_each_entry(zspage, &class->partial, list) {
+			nr_free += class->objs_per_zspage - zspage->inuse;
+			if (!src || zspage->inuse < src->inuse)
+				src = zspage;
+		}
+		if (!src || nr_free - (class->objs_per_zspage - src->inuse) <
+			    src->inuse)
+			break;
+
+		list_del(&src->list);
+		drain_zspage(class, src, migrate, priv);
+		spin_unlock(&class->lock);
+
+		free_zspage(pool, src);
+		freed += class->pages_per_zspage;
+		cond_resched();
+
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/**
+ * zs_compact - pack partially used zspages together
+ * @pool: pool to compact
+ * @migrate: told about each object that moves, so its handle is updated
+ * @priv: passed to @migrate
+ *
+ * Returns the number of pages freed. The caller must make sure nothing
+ * maps, frees or keeps a copy of any handle of the pool meanwhile, other
+ * than through @migrate.
+ */
+unsigned long zs_compact(struct zs_pool *pool, zs_migrate_fn migrate,
+			 void *priv)
+{
+	unsigned long freed = 0;
+	int i;
+
+	for (i = 0; i < ZS_NR_SIZE_CLASSES; i++)
+		freed += compact_class(pool, &pool->size_class[i],
+				       migrate, priv);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+/*
+ * Returns total memory used by allocator (userdata only, the zspage
+ * descriptors come from the slab)
+ */
+u64 zs_get_total_size_bytes(struct zs_pool *pool)
+{
+	return (u64)atomic_long_read(&pool->total_pages) << PAGE_SHIFT;
+}
+EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
@@ -0,0 +1,55 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZS_MALLOC_H_
+#define _ZS_MALLOC_H_
+
+#include <linux/types.h>
+
+/* the largest object zs_malloc() hands out */
+#define ZS_MAX_ALLOC_SIZE	PAGE_SIZE
+
+struct zs_pool;
+
+/*
+ * How an object is going to be accessed while mapped: an object that
+ * straddles two pages is copied out for reading and copied back after
+ * writing, so say which of the two is needed.
+ */
+enum zs_mapmode {
+	ZS_MM_RO,
+	ZS_MM_WO,
+};
+
+/*
+ * Called by zs_compact() for every object it moves, with the object's
+ * first bytes (at least the part of it in its first page) mapped at
+ * 'obj'. Runs in atomic context.
+ */
+typedef void (*zs_migrate_fn)(void *priv, void *obj,
+			      unsigned long old_handle,
+			      unsigned long new_handle);
+
+struct zs_pool *zs_create_pool(void);
+void zs_destroy_pool(struct zs_pool *pool);
+
+unsigned long zs_malloc(struct zs_pool *pool, u32 size, gfp_t flags);
+void zs_free(struct zs_pool *pool, unsigned long handle);
+
+void *zs_map_object(struct zs_pool *pool, unsigned long handle,
+		    enum zs_mapmode mm);
+void zs_unmap_object(struct zs_pool *pool, unsigned long handle, void *obj);
+
+unsigned long zs_compact(struct zs_pool *pool, zs_migrate_fn migrate,
+			 void *priv);
+
+u64 zs_get_total_size_bytes(struct zs_pool *pool);
+
+#endif
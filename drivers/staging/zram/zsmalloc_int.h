@@ -0,0 +1,76 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZS_MALLOC_INT_H_
+#define _ZS_MALLOC_INT_H_
+
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+/* User configurable params */
+
+/*
+ * Objects are served from size classes ZS_SIZE_CLASS_DELTA bytes apart,
+ * so an allocation wastes less than that to rounding.
+ */
+#define ZS_MIN_ALLOC_SIZE	32
+#define ZS_SIZE_CLASS_DELTA	16
+#define ZS_NR_SIZE_CLASSES	((ZS_MAX_ALLOC_SIZE - ZS_MIN_ALLOC_SIZE) \
+				/ ZS_SIZE_CLASS_DELTA + 1)
+
+/*
+ * A zspage is a group of up to this many (not necessarily contiguous)
+ * pages that a size class carves into objects back to back, letting
+ * objects straddle page boundaries. Each class picks the number of pages
+ * that leaves the smallest tail unused.
+ */
+#define ZS_MAX_PAGES_PER_ZSPAGE	4
+
+/* End of user params */
+
+#define ZS_MAX_OBJS_PER_ZSPAGE	(ZS_MAX_PAGES_PER_ZSPAGE * PAGE_SIZE \
+				/ ZS_MIN_ALLOC_SIZE)
+
+/*
+ * A handle is the pfn of the zspage's first page and the object index
+ * within the zspage; page_private() of every page of a zspage points
+ * back at its descriptor.
+ */
+#define ZS_OBJ_INDEX_BITS	(PAGE_SHIFT + 2 - 5)
+#define ZS_OBJ_INDEX_MASK	((1UL << ZS_OBJ_INDEX_BITS) - 1)
+
+struct size_class;
+
+struct zspage {
+	struct list_head list;		/* in its class's partial/full list */
+	struct size_class *class;
+	u32 inuse;			/* objects allocated */
+	unsigned long used[BITS_TO_LONGS(ZS_MAX_OBJS_PER_ZSPAGE)];
+	struct page *pages[ZS_MAX_PAGES_PER_ZSPAGE];
+};
+
+struct size_class {
+	u32 size;			/* object size */
+	u32 pages_per_zspage;
+	u32 objs_per_zspage;
+	struct list_head partial;	/* zspages with free objects */
+	struct list_head full;		/* zspages without */
+	spinlock_t lock;
+};
+
+struct zs_pool {
+	struct size_class size_class[ZS_NR_SIZE_CLASSES];
+	atomic_long_t total_pages;	/* stats */
+};
+
+#endif
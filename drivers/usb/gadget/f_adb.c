@@ -27,11 +27,15 @@
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
-#define ADB_BULK_BUFFER_SIZE           4096
+#define ADB_BULK_BUFFER_SIZE           16384
 
 /* number of tx requests to allocate */
 #define TX_REQ_MAX 4
 
+/* rx requests queued together for one read */
+#define RX_REQ_MAX 8
+#define ADB_RX_MAX_LEN		(RX_REQ_MAX * ADB_BULK_BUFFER_SIZE)
+
 static const char adb_shortname[] = "android_adb";
 
 struct adb_dev {
@@ -53,8 +57,10 @@ struct adb_dev {
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req;
+	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
+	/* requests of the current read not yet completed */
+	atomic_t rx_pending;
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -208,13 +214,20 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0) {
-                pr_err("%s: status = %d\n", __func__, req->status);
+	/* -ECONNRESET is adb_read() taking back what it queued */
+	if (req->status != 0 && req->status != -ECONNRESET) {
+		pr_err("%s: status = %d\n", __func__, req->status);
 		dev->error = 1;
-        }
+	}
 
-	wake_up(&dev->read_wq);
+	/* one wakeup per read: when its last request is in, or the
+	 * host ended the transfer early
+	 */
+	if (atomic_dec_and_test(&dev->rx_pending) ||
+	    req->actual < req->length || req->status) {
+		dev->rx_done = 1;
+		wake_up(&dev->read_wq);
+	}
 }
 
 static int adb_create_bulk_endpoints(struct adb_dev *dev,
@@ -247,11 +260,13 @@ static int adb_create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, ADB_BULK_BUFFER_SIZE);
-	if (!req)
-		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
+	for (i = 0; i < RX_REQ_MAX; i++) {
+		req = adb_request_new(dev->ep_out, ADB_BULK_BUFFER_SIZE);
+		if (!req)
+			goto fail;
+		req->complete = adb_complete_out;
+		dev->rx_req[i] = req;
+	}
 
 	for (i = 0; i < TX_REQ_MAX; i++) {
 		req = adb_request_new(dev->ep_in, ADB_BULK_BUFFER_SIZE);
@@ -274,7 +289,7 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 	struct adb_dev *dev = fp->private_data;
 	struct usb_request *req;
 	int r = count, xfer;
-	int ret;
+	int ret, i, nreq;
 
 	pr_debug("adb_read(%d)\n", count);
 	if (!_adb_dev) {
@@ -282,10 +297,10 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 		return -ENODEV;
 	}
 
-	if (count > ADB_BULK_BUFFER_SIZE) {
-		pr_err("%s err: count > ADB_BULK_BUFFER_SIZE\n", __func__);
-		return -EINVAL;
-	}
+	/* larger reads just return less, as read() may */
+	if (count > ADB_RX_MAX_LEN)
+		count = ADB_RX_MAX_LEN;
+	r = count;
 
 	if (adb_lock(&dev->read_excl)) {
 		pr_err("%s err: failed to lock read_excl\n", __func__);
@@ -310,40 +325,71 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 	}
 
 requeue_req:
-	/* queue a request */
-	req = dev->rx_req;
-	req->length = count;
+	/*
+	 * Queue enough requests for the whole read, so the host can
+	 * stream it without waiting on us between buffers.  Never ask
+	 * for more than count: adbd reads exact sizes, and a request
+	 * longer than what the host sends would sit there without a
+	 * short packet to end it.
+	 */
+	nreq = DIV_ROUND_UP(count, ADB_BULK_BUFFER_SIZE);
+	atomic_set(&dev->rx_pending, nreq);
 	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		pr_err("adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
-		dev->error = 1;
-		goto done;
-	} else {
-		pr_debug("rx %p queue\n", req);
+	for (i = 0, xfer = count; i < nreq; i++) {
+		req = dev->rx_req[i];
+		req->length = min_t(int, xfer, ADB_BULK_BUFFER_SIZE);
+		xfer -= req->length;
+		ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+		if (ret < 0) {
+			pr_err("adb_read: failed to queue req %p (%d)\n",
+					req, ret);
+			r = -EIO;
+			dev->error = 1;
+			while (--i >= 0)
+				usb_ep_dequeue(dev->ep_out, dev->rx_req[i]);
+			goto done;
+		} else {
+			pr_debug("rx %p queue\n", req);
+		}
 	}
 
-	/* wait for a request to complete */
+	/* wait for the requests to complete */
 	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
 	if (ret < 0) {
 		dev->error = 1;
 		r = ret;
-		usb_ep_dequeue(dev->ep_out, req);
+		for (i = 0; i < nreq; i++)
+			usb_ep_dequeue(dev->ep_out, dev->rx_req[i]);
 		pr_err("%s: wait_event for rx done returned %d\n",
 						__func__, ret);
 		goto done;
 	}
+
+	/* ended early: take back the requests still queued */
+	if (atomic_read(&dev->rx_pending))
+		for (i = 0; i < nreq; i++)
+			usb_ep_dequeue(dev->ep_out, dev->rx_req[i]);
+
 	if (!dev->error) {
+		r = 0;
+		for (i = 0; i < nreq; i++) {
+			req = dev->rx_req[i];
+			pr_debug("rx %p %d\n", req, req->actual);
+			if (req->actual &&
+			    copy_to_user(buf + r, req->buf, req->actual)) {
+				r = -EFAULT;
+				goto done;
+			}
+			r += req->actual;
+			if (req->actual < req->length)
+				break;
+		}
+
 		/* If we got a 0-len packet, throw it back and try again. */
-		if (req->actual == 0)
+		if (r == 0) {
+			r = count;
 			goto requeue_req;
-
-		pr_debug("rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
-			r = -EFAULT;
-
+		}
 	} else
 		r = -EIO;
 
@@ -517,14 +563,17 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct adb_dev	*dev = func_to_adb(f);
 	struct usb_request *req;
-
+	int i;
 
 	dev->online = 0;
 	dev->error = 1;
 
 	wake_up(&dev->read_wq);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	for (i = 0; i < RX_REQ_MAX; i++) {
+		adb_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = adb_req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 }
@@ -1126,6 +1126,18 @@ static int do_write(struct fsg_common *common)
 			amount_left_to_write -= nwritten;
 			common->residue -= nwritten;
 
+			/*
+			 * Start writeback without waiting for it, so the
+			 * data goes to the card while we keep receiving
+			 * instead of piling up until balance_dirty_pages()
+			 * stalls us in the middle of a transfer.
+			 */
+			curlun->unflushed_bytes += nwritten;
+			if (curlun->unflushed_bytes >= FSG_WRITEBACK_CHUNK) {
+				curlun->unflushed_bytes = 0;
+				filemap_flush(curlun->filp->f_mapping);
+			}
+
 			/* If an error occurred, report it and its position */
 			if (nwritten < amount) {
 				curlun->sense_data = SS_WRITE_ERROR;
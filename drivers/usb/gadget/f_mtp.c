@@ -30,6 +30,8 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -51,9 +53,34 @@
 
 /* number of tx and rx requests to allocate */
 #define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
+/* start writeback of received file data every this many bytes */
+#define MTP_WRITEBACK_CHUNK	(4 * 1024 * 1024)
+
+/*
+ * Bulk request sizes and pipeline depths for file transfers, picked up
+ * at bind time.  Lengths are rounded down to MTP_BULK_BUFFER_SIZE
+ * multiples; if the buffers cannot be allocated we fall back to
+ * MTP_BULK_BUFFER_SIZE requests.
+ */
+static unsigned int mtp_tx_req_len = 4 * MTP_BULK_BUFFER_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "MTP IN request length");
+
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "MTP IN requests in flight");
+
+static unsigned int mtp_rx_req_len = 4 * MTP_BULK_BUFFER_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "MTP OUT request length");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "MTP OUT requests in flight (max 8)");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -93,6 +120,13 @@ struct mtp_dev {
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
+	/* OUT completions, so receive_file_work can wait for each one */
+	atomic_t rx_completed;
+
+	/* bulk request geometry chosen at bind time */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	int rx_reqs;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -364,6 +398,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	dev->rx_done = 1;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
+	atomic_inc(&dev->rx_completed);
 
 	wake_up(&dev->read_wq);
 }
@@ -388,6 +423,7 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
 	struct usb_ep *ep;
+	unsigned tx_reqs;
 	int i;
 
 	DBG(cdev, "create_bulk_endpoints dev: %p\n", dev);
@@ -429,17 +465,42 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->tx_req_len = max_t(unsigned, MTP_BULK_BUFFER_SIZE,
+			rounddown(mtp_tx_req_len, MTP_BULK_BUFFER_SIZE));
+	tx_reqs = clamp_t(unsigned, mtp_tx_reqs, 1, 32);
+retry_tx_alloc:
+	for (i = 0; i < tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+			tx_reqs = TX_REQ_MAX;
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+
+	dev->rx_req_len = max_t(unsigned, MTP_BULK_BUFFER_SIZE,
+			rounddown(mtp_rx_req_len, MTP_BULK_BUFFER_SIZE));
+	dev->rx_reqs = clamp_t(unsigned, mtp_rx_reqs, 2, RX_REQ_MAX);
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (--i >= 0) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+			dev->rx_reqs = 2;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
@@ -469,7 +530,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%d)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -589,8 +650,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -655,6 +716,16 @@ static void send_file_work(struct work_struct *data) {
 		hdr_size = 0;
 	}
 
+	/*
+	 * Like POSIX_FADV_SEQUENTIAL: grow the readahead window so the
+	 * page cache stays well ahead of the requests we keep in flight,
+	 * and vfs_read() rarely has to wait for the media.
+	 */
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = max_t(unsigned long, filp->f_ra.ra_pages,
+			(2 * mtp_tx_reqs * dev->tx_req_len) >> PAGE_CACHE_SHIFT);
+	spin_unlock(&filp->f_lock);
+
 	/* we need to send a zero length packet to signal the end of transfer
 	 * if the transfer size is aligned to a packet boundary.
 	 */
@@ -681,8 +752,8 @@ static void send_file_work(struct work_struct *data) {
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -732,11 +803,13 @@ static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
-	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	loff_t offset, wb_offset;
+	int64_t count, unqueued;
+	unsigned queued = 0, done = 0;
+	int completed;
+	int ret;
 	int r = 0;
 
 	/* read our parameters */
@@ -747,62 +820,85 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/*
+	 * Keep up to rx_reqs OUT requests queued, asking for no more than
+	 * the host still has to send, and write each one out in order as
+	 * it completes while the others are filling.
+	 */
+	unqueued = count;
+	wb_offset = offset;
+	completed = atomic_read(&dev->rx_completed);
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
+	while (count > 0) {
+		/* if xfer_file_length is 0xFFFFFFFF, then we read until
+		 * we get a zero length packet, one request at a time
+		 */
+		while (unqueued > 0 && queued - done < dev->rx_reqs &&
+		       (count != 0xFFFFFFFF || queued == done)) {
+			req = dev->rx_req[queued % dev->rx_reqs];
+			req->length = (unqueued > dev->rx_req_len
+					? dev->rx_req_len : unqueued);
 			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			queued++;
+			if (count != 0xFFFFFFFF)
+				unqueued -= req->length;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[done % dev->rx_reqs];
+		ret = wait_event_interruptible(dev->read_wq,
+			atomic_read(&dev->rx_completed) - completed > done
+			|| dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto out;
+		}
+		if (atomic_read(&dev->rx_completed) - completed <= done) {
+			r = ret < 0 ? ret : -EIO;
+			goto out;
+		}
+		done++;
+
+		if (count != 0xFFFFFFFF)
+			count -= req->actual;
+		if (req->actual < req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			count = 0;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		/* stream the data to the media instead of letting the
+		 * dirty pages pile up until the writer gets throttled
+		 */
+		if (offset - wb_offset >= MTP_WRITEBACK_CHUNK) {
+			filemap_fdatawrite_range(filp->f_mapping, wb_offset,
+						 offset - 1);
+			wb_offset = offset;
 		}
 	}
 
+out:
+	/* take back the reads still queued after an error or short packet */
+	while (done != queued) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[done % dev->rx_reqs]);
+		done++;
+	}
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1118,8 +1214,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < RX_REQ_MAX; i++) {
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -1227,6 +1325,7 @@ static int mtp_setup(void)
 	init_waitqueue_head(&dev->intr_wq);
 	atomic_set(&dev->open_excl, 0);
 	atomic_set(&dev->ioctl_excl, 0);
+	atomic_set(&dev->rx_completed, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
 	INIT_LIST_HEAD(&dev->intr_idle);
 
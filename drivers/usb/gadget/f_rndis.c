@@ -76,6 +76,21 @@
  *   - MS-Windows drivers sometimes emit undocumented requests.
  */
 
+/*
+ * How many packet messages one bulk transfer may carry.  Bundling saves
+ * a USB transaction and an interrupt per frame when tethering; 1 goes
+ * back to the classic one frame per transfer.
+ */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+	"RNDIS packets per transfer from the host");
+
+static unsigned int rndis_dl_max_pkt_per_xfer = 3;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+	"RNDIS packets per transfer to the host");
+
 struct rndis_ep_descs {
 	struct usb_endpoint_descriptor	*in;
 	struct usb_endpoint_descriptor	*out;
@@ -406,6 +421,8 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 		if (status < 0)
 			ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 				status, req->actual, req->length);
+		rndis->port.dl_max_xfer_size =
+				rndis_get_dl_max_xfer_size(rndis->config);
 		/*spin_unlock(&dev->lock);*/
 	}
 }
@@ -564,6 +581,7 @@ static void rndis_disable(struct usb_function *f)
 
 	rndis_uninit(rndis->config);
 	gether_disconnect(&rndis->port);
+	rndis->port.dl_max_xfer_size = 0;
 
 	usb_ep_disable(rndis->notify);
 	rndis->notify->driver_data = NULL;
@@ -716,6 +734,7 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
+	rndis_set_max_pkt_xfer(rndis->config, rndis->port.ul_max_pkts_per_xfer);
 
 	if (rndis_set_param_vendor(rndis->config, rndis->vendorID,
 				   rndis->manufacturer))
@@ -852,6 +871,10 @@ rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN],
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.ul_max_pkts_per_xfer = clamp(rndis_ul_max_pkt_per_xfer,
+						 1U, 255U);
+	rndis->port.dl_max_pkts_per_xfer = clamp(rndis_dl_max_pkt_per_xfer,
+						 1U, 255U);
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
@@ -19,6 +19,8 @@
 
 #define RNDIS_MAXIMUM_FRAME_SIZE	1518
 #define RNDIS_MAX_TOTAL_SIZE		1558
+/* bound on the host's MaxTransferSize, IN transfers are atomic allocations */
+#define RNDIS_MAX_DL_XFER_SIZE		16384
 
 /* Remote NDIS Versions */
 #define RNDIS_MAJOR_VERSION		1
@@ -239,6 +241,9 @@ typedef struct rndis_params
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
+
+	u32			max_pkt_per_xfer;	/* host to device */
+	u32			dl_max_xfer_size;	/* device to host */
 } rndis_params;
 
 /* RNDIS Message parser and other useless functions */
@@ -261,6 +266,8 @@ int  rndis_signal_connect (int configNr);
 int  rndis_signal_disconnect (int configNr);
 int  rndis_state (int configNr);
 extern void rndis_set_host_mac (int configNr, const u8 *addr);
+void rndis_set_max_pkt_xfer(int configNr, u8 max_pkt_per_xfer);
+u32  rndis_get_dl_max_xfer_size(int configNr);
 
 int rndis_init(void);
 void rndis_exit (void);
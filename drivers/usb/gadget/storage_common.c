@@ -259,6 +259,9 @@ struct fsg_lun {
 	u32		sense_data_info;
 	u32		unit_attention_data;
 
+	/* written since writeback was last started */
+	u32		unflushed_bytes;
+
 	struct device	dev;
 };
 
@@ -275,10 +278,13 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
 /* Number of buffers we will use.  2 is enough for double-buffering */
-#define FSG_NUM_BUFFERS	2
+#define FSG_NUM_BUFFERS	CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
 
 /* Default size of buffer length. */
-#define FSG_BUFLEN	((u32)16384)
+#define FSG_BUFLEN	((u32)CONFIG_USB_GADGET_STORAGE_BUFLEN * 1024)
+
+/* Start writeback after this much data was written to a LUN */
+#define FSG_WRITEBACK_CHUNK	(4 * 1024 * 1024)
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
@@ -610,6 +616,15 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 		goto out;
 	}
 
+	/*
+	 * Keep readahead a good deal ahead of what the buffer ring
+	 * moves, so sequential reads rarely wait on the medium.
+	 */
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = max_t(unsigned long, filp->f_ra.ra_pages,
+			(2 * FSG_NUM_BUFFERS * FSG_BUFLEN) >> PAGE_CACHE_SHIFT);
+	spin_unlock(&filp->f_lock);
+
 	get_file(filp);
 	curlun->ro = ro;
 	curlun->filp = filp;
@@ -646,6 +661,7 @@ static int fsg_lun_fsync_sub(struct fsg_lun *curlun)
 
 	if (curlun->ro || !filp)
 		return 0;
+	curlun->unflushed_bytes = 0;
 	return vfs_fsync(filp, 1);
 }
 
@@ -28,6 +28,7 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/hrtimer.h>
 
 #include "u_ether.h"
 
@@ -69,6 +70,12 @@ struct eth_dev {
 	struct list_head	tx_reqs, rx_reqs;
 	atomic_t		tx_qlen;
 
+	/* IN transfer being filled with several frames, under req_lock */
+	struct usb_request	*tx_aggr_req;
+	struct sk_buff		*tx_aggr_skb;
+	unsigned		tx_aggr_pkts;
+	struct hrtimer		tx_aggr_timer;
+
 	struct sk_buff_head	rx_frames;
 
 	unsigned		header_len;
@@ -92,6 +99,9 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+/* longest a partly filled aggregate waits for more frames */
+#define TX_AGGR_TIMEOUT_NS	(500 * NSEC_PER_USEC)
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -237,6 +247,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->port_usb->ul_max_pkts_per_xfer > 1)
+		size *= dev->port_usb->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -472,6 +484,124 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_complete(struct usb_ep *ep, struct usb_request *req);
+
+/* give back a request whose frame could not be sent */
+static void tx_drop(struct eth_dev *dev, struct usb_request *req)
+{
+	unsigned long	flags;
+
+	dev->net->stats.tx_dropped++;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+/* queue one IN transfer of pkts wrapped frames */
+static void tx_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, struct sk_buff *skb, unsigned pkts)
+{
+	int		length = skb->len;
+	int		retval;
+
+	/*
+	 * Align data to 32bit if the dma controller requires it
+	 */
+	if (gadget_dma32(dev->gadget)) {
+		unsigned long align = (unsigned long)skb->data & 3;
+		if (WARN_ON(skb_headroom(skb) < align)) {
+			dev_kfree_skb_any(skb);
+			goto drop;
+		} else if (align) {
+			u8 *data = skb->data;
+			size_t len = skb_headlen(skb);
+			skb->data -= align;
+			memmove(skb->data, data, len);
+			skb_set_tail_pointer(skb, len);
+		}
+	}
+
+	req->buf = skb->data;
+	req->context = skb;
+	req->complete = tx_complete;
+
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (dev->port_usb->is_fixed &&
+	    length == dev->port_usb->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
+		length++;
+
+	req->length = length;
+
+	/* throttle highspeed IRQ rate back slightly; aggregates are
+	 * flushed from completions, so those always interrupt
+	 */
+	if (gadget_is_dualspeed(dev->gadget))
+		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH &&
+				     pkts == 1)
+			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
+			: 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		DBG(dev, "tx queue err %d\n", retval);
+		break;
+	case 0:
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		/* tx_complete counts the transfer itself */
+		dev->net->stats.tx_packets += pkts - 1;
+	}
+
+	if (retval) {
+		dev_kfree_skb_any(skb);
+drop:
+		dev->net->stats.tx_dropped += pkts - 1;
+		tx_drop(dev, req);
+	}
+}
+
+/* detach the pending aggregate, if any; caller holds req_lock */
+static struct usb_request *tx_aggr_take(struct eth_dev *dev,
+		struct sk_buff **skb, unsigned *pkts)
+{
+	struct usb_request	*req = dev->tx_aggr_req;
+
+	*skb = dev->tx_aggr_skb;
+	*pkts = dev->tx_aggr_pkts;
+	dev->tx_aggr_req = NULL;
+	dev->tx_aggr_skb = NULL;
+	dev->tx_aggr_pkts = 0;
+	return req;
+}
+
+static void tx_aggr_flush(struct eth_dev *dev, struct usb_ep *in)
+{
+	struct usb_request	*req;
+	struct sk_buff		*skb;
+	unsigned		pkts;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = tx_aggr_take(dev, &skb, &pkts);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (req)
+		tx_queue(dev, in, req, skb, pkts);
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -496,30 +626,134 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	dev_kfree_skb_any(skb);
 
 	atomic_dec(&dev->tx_qlen);
+
+	/* frames bundled while this transfer was on the wire */
+	if (req->status != -ESHUTDOWN && req->status != -ECONNRESET)
+		tx_aggr_flush(dev, ep);
+
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+static enum hrtimer_restart tx_aggr_timeout(struct hrtimer *timer)
+{
+	struct eth_dev	*dev = container_of(timer, struct eth_dev,
+						tx_aggr_timer);
+	struct usb_ep	*in = NULL;
+	unsigned long	flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb)
+		in = dev->port_usb->in_ep;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (in)
+		tx_aggr_flush(dev, in);
+	return HRTIMER_NORESTART;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/*
+ * Copy the wrapped frame into the pending IN transfer, up to max_pkts
+ * frames or max_size bytes.  The transfer goes out at once when the link
+ * is idle; otherwise it gathers frames until the completion of the one
+ * in flight, or TX_AGGR_TIMEOUT_NS.
+ */
+static netdev_tx_t eth_aggr_xmit(struct eth_dev *dev, struct usb_ep *in,
+		struct sk_buff *skb, unsigned max_pkts, unsigned max_size)
+{
+	struct usb_request	*req;
+	struct sk_buff		*aggr;
+	unsigned		pkts;
+	unsigned long		flags;
+
+	if (dev->wrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap(dev->port_usb, skb);
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if (!skb) {
+			dev->net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+	}
+
+again:
+	spin_lock_irqsave(&dev->req_lock, flags);
+
+	/* no room for this frame: send the pending frames first */
+	aggr = dev->tx_aggr_skb;
+	if (aggr && aggr->len + skb->len > max_size) {
+		req = tx_aggr_take(dev, &aggr, &pkts);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		tx_queue(dev, in, req, aggr, pkts);
+		goto again;
+	}
+
+	if (!aggr) {
+		/* see eth_start_xmit(); the frame is wrapped by now */
+		if (list_empty(&dev->tx_reqs))
+			goto drop;
+
+		/* one spare byte for the zlp workaround in tx_queue() */
+		aggr = alloc_skb(max_t(unsigned, max_size, skb->len) + 1,
+				 GFP_ATOMIC);
+		if (!aggr)
+			goto drop;
+
+		req = container_of(dev->tx_reqs.next, struct usb_request, list);
+		list_del(&req->list);
+		if (list_empty(&dev->tx_reqs))
+			netif_stop_queue(dev->net);
+
+		dev->tx_aggr_req = req;
+		dev->tx_aggr_skb = aggr;
+	}
+
+	memcpy(skb_put(aggr, skb->len), skb->data, skb->len);
+	dev->tx_aggr_pkts++;
+
+	req = NULL;
+	if (dev->tx_aggr_pkts >= max_pkts || !atomic_read(&dev->tx_qlen))
+		req = tx_aggr_take(dev, &aggr, &pkts);
+	else if (!hrtimer_active(&dev->tx_aggr_timer))
+		hrtimer_start(&dev->tx_aggr_timer,
+			      ns_to_ktime(TX_AGGR_TIMEOUT_NS),
+			      HRTIMER_MODE_REL);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	if (req)
+		tx_queue(dev, in, req, aggr, pkts);
+	return NETDEV_TX_OK;
+
+drop:
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	dev_kfree_skb_any(skb);
+	dev->net->stats.tx_dropped++;
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
 	struct eth_dev		*dev = netdev_priv(net);
-	int			length = skb->len;
-	int			retval;
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	unsigned		dl_max_pkts = 0, dl_max_size = 0;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		dl_max_pkts = dev->port_usb->dl_max_pkts_per_xfer;
+		dl_max_size = dev->port_usb->dl_max_xfer_size;
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -553,6 +787,10 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	/* bundle frames once the host told us how much it takes */
+	if (dl_max_pkts > 1 && dl_max_size)
+		return eth_aggr_xmit(dev, in, skb, dl_max_pkts, dl_max_size);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -585,74 +823,13 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		spin_unlock_irqrestore(&dev->lock, flags);
 		if (!skb)
 			goto drop;
-
-		length = skb->len;
 	}
 
-	/*
-	 * Align data to 32bit if the dma controller requires it
-	 */
-	if (gadget_dma32(dev->gadget)) {
-		unsigned long align = (unsigned long)skb->data & 3;
-		if (WARN_ON(skb_headroom(skb) < align)) {
-			dev_kfree_skb_any(skb);
-			goto drop;
-		} else if (align) {
-			u8 *data = skb->data;
-			size_t len = skb_headlen(skb);
-			skb->data -= align;
-			memmove(skb->data, data, len);
-			skb_set_tail_pointer(skb, len);
-		}
-	}
-
-	req->buf = skb->data;
-	req->context = skb;
-	req->complete = tx_complete;
-
-	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
-	if (dev->port_usb->is_fixed &&
-	    length == dev->port_usb->fixed_in_len &&
-	    (length % in->maxpacket) == 0)
-		req->zero = 0;
-	else
-		req->zero = 1;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
-		length++;
-
-	req->length = length;
-
-	/* throttle highspeed IRQ rate back slightly */
-	if (gadget_is_dualspeed(dev->gadget))
-		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH)
-			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
-			: 0;
-
-	retval = usb_ep_queue(in, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		DBG(dev, "tx queue err %d\n", retval);
-		break;
-	case 0:
-		net->trans_start = jiffies;
-		atomic_inc(&dev->tx_qlen);
-	}
+	tx_queue(dev, in, req, skb, 1);
+	return NETDEV_TX_OK;
 
-	if (retval) {
-		dev_kfree_skb_any(skb);
 drop:
-		dev->net->stats.tx_dropped++;
-		spin_lock_irqsave(&dev->req_lock, flags);
-		if (list_empty(&dev->tx_reqs))
-			netif_start_queue(net);
-		list_add(&req->list, &dev->tx_reqs);
-		spin_unlock_irqrestore(&dev->req_lock, flags);
-	}
+	tx_drop(dev, req);
 	return NETDEV_TX_OK;
 }
 
@@ -831,6 +1008,8 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	INIT_WORK(&dev->work, eth_work);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_aggr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_aggr_timer.function = tx_aggr_timeout;
 
 	skb_queue_head_init(&dev->rx_frames);
 
@@ -889,6 +1068,7 @@ void gether_cleanup(void)
 
 	unregister_netdev(the_dev->net);
 	flush_work_sync(&the_dev->work);
+	hrtimer_cancel(&the_dev->tx_aggr_timer);
 	free_netdev(the_dev->net);
 
 	the_dev = NULL;
@@ -1004,8 +1184,17 @@ void gether_disconnect(struct gether *link)
 	 * of all pending i/o.  then free the request objects
 	 * and forget about the endpoints.
 	 */
+	hrtimer_cancel(&dev->tx_aggr_timer);
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_aggr_req) {
+		struct sk_buff	*skb;
+		unsigned	pkts;
+
+		req = tx_aggr_take(dev, &skb, &pkts);
+		list_add(&req->list, &dev->tx_reqs);
+		dev_kfree_skb_any(skb);
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
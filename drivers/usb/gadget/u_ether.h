@@ -72,6 +72,15 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/*
+	 * Frames per transfer in each direction, for framings that can
+	 * bundle them (RNDIS).  dl_max_xfer_size is the largest transfer
+	 * the host accepts; until it is known, frames go out one by one.
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
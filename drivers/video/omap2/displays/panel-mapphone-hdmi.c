@@ -30,6 +30,7 @@
 #include <linux/mutex.h>
 #include <linux/delay.h>
 #include <linux/string.h>
+#include <linux/jiffies.h>
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
 #include <linux/pm_runtime.h>
@@ -72,6 +73,26 @@ static struct pm_qos_request_list pm_qos_handle;
 
 #define OMAP_HDMI_TIMINGS_NB			34
 
+/* sinks remembered across hotplug, e.g. the dock and the lapdock */
+#define HDMI_SINK_CACHE_SIZE			4
+
+/*
+ * EDID and the mode last set on a sink.  A sink is recognized by its base
+ * EDID block, looked up by the block checksum, so that a replug costs a
+ * single DDC block read instead of the full EDID and the VGA PLL/PHY
+ * bring-up that the EDID read otherwise needs.
+ */
+struct hdmi_sink {
+	u8 edid[HDMI_EDID_MAX_LENGTH];
+	bool valid;
+	bool has_mode;
+	bool can_do_hdmi;
+	int code;
+	int mode;
+	struct fb_videomode timings;
+	unsigned long last_used;
+};
+
 static struct {
 	struct mutex lock;
 	struct omap_display_platform_data *pdata;
@@ -102,6 +123,9 @@ static struct {
 	void (*hdmi_start_frame_cb)(void);
 	void (*hdmi_irq_cb)(int);
 	bool (*hdmi_power_on_cb)(void);
+
+	struct hdmi_sink sinks[HDMI_SINK_CACHE_SIZE];
+	struct hdmi_sink *sink;		/* attached sink, if known */
 } hdmi;
 
 static const u8 edid_header[8] = {0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0};
@@ -272,6 +296,85 @@ void hdmi_get_monspecs(struct fb_monspecs *specs)
 	specs->modedb_len = j;
 }
 
+/* one DDC block read, HDMI clocks must be on */
+static struct hdmi_sink *hdmi_lookup_sink(void)
+{
+	u8 block0[EDID_DESCRIPTOR_BLOCK1_ADDRESS];
+	int i;
+
+	if (read_ti_4xxx_edid(&hdmi.hdmi_data, block0, sizeof(block0)) ||
+	    memcmp(block0, edid_header, sizeof(edid_header)))
+		return NULL;
+
+	for (i = 0; i < HDMI_SINK_CACHE_SIZE; i++) {
+		struct hdmi_sink *sink = &hdmi.sinks[i];
+
+		if (sink->valid && sink->edid[0x7f] == block0[0x7f] &&
+		    !memcmp(sink->edid, block0, sizeof(block0))) {
+			sink->last_used = jiffies;
+			return sink;
+		}
+	}
+
+	return NULL;
+}
+
+/* replaces the least recently seen sink */
+static struct hdmi_sink *hdmi_store_sink(const u8 *edid)
+{
+	struct hdmi_sink *sink = &hdmi.sinks[0];
+	int i;
+
+	for (i = 1; i < HDMI_SINK_CACHE_SIZE && sink->valid; i++)
+		if (!hdmi.sinks[i].valid ||
+		    time_before(hdmi.sinks[i].last_used, sink->last_used))
+			sink = &hdmi.sinks[i];
+
+	memcpy(sink->edid, edid, HDMI_EDID_MAX_LENGTH);
+	sink->valid = true;
+	sink->has_mode = false;
+	sink->last_used = jiffies;
+	return sink;
+}
+
+/*
+ * Replug of a known sink: take the EDID from the cache and preset the
+ * mode last used on it, so that the enable goes straight into that mode.
+ * Returns true on a cache hit.
+ */
+static bool hdmi_restore_sink(void)
+{
+	hdmi.sink = hdmi_lookup_sink();
+	if (!hdmi.sink)
+		return false;
+
+	memcpy(hdmi.edid, hdmi.sink->edid, HDMI_EDID_MAX_LENGTH);
+	hdmi.edid_set = true;
+	HDTVDBG("known sink, using cached EDID\n");
+
+	if (hdmi.sink->has_mode) {
+		hdmi.custom_set = 1;
+		hdmi.code = hdmi.sink->code;
+		hdmi.mode = hdmi.sink->mode;
+		hdmi.cfg.timings = hdmi.sink->timings;
+		hdmi.can_do_hdmi = hdmi.sink->can_do_hdmi;
+	}
+
+	return true;
+}
+
+static void hdmi_remember_mode(void)
+{
+	if (!hdmi.sink)
+		return;
+
+	hdmi.sink->code = hdmi.code;
+	hdmi.sink->mode = hdmi.mode;
+	hdmi.sink->timings = hdmi.cfg.timings;
+	hdmi.sink->can_do_hdmi = hdmi.can_do_hdmi;
+	hdmi.sink->has_mode = true;
+}
+
 u8 *hdmi_read_edid(struct omap_video_timings *dp)
 {
 	int ret = 0, i;
@@ -285,6 +388,9 @@ u8 *hdmi_read_edid(struct omap_video_timings *dp)
 		return NULL;
 	}
 
+	if (hdmi_restore_sink())
+		return hdmi.edid;
+
 	memset(hdmi.edid, 0, HDMI_EDID_MAX_LENGTH);
 
 	ret = read_ti_4xxx_edid(&hdmi.hdmi_data, hdmi.edid,
@@ -309,6 +415,7 @@ u8 *hdmi_read_edid(struct omap_video_timings *dp)
 		return NULL;
 
 	hdmi.edid_set = true;
+	hdmi.sink = hdmi_store_sink(hdmi.edid);
 	return hdmi.edid;
 }
 
@@ -556,6 +663,13 @@ static int hdmi_power_edid_only(struct omap_dss_device *dssdev)
 
 	dispc_enable_channel(OMAP_DSS_CHANNEL_DIGIT, dssdev->type, 0);
 
+	/*
+	 * DDC only needs the core clocks: a known sink is validated with
+	 * its base block and needs no PLL/PHY until the real mode is set.
+	 */
+	if (!hdmi.edid_set && hdmi_restore_sink())
+		return 0;
+
 	p = &dssdev->panel.timings;
 
 	HDTVDBG("hdmi_power_edid_only\n");
@@ -717,6 +831,8 @@ int omapdss_hdmi_display_set_mode(struct omap_dss_device *dssdev,
 		hdmi.mode = HDMI_HDMI;
 		hdmi.code = 0;
 	}
+	if (rc == 0)
+		hdmi_remember_mode();
 
 	/* The DSSMGR flag chk here is just a hack to allow this driver
 	 * to function with or without the DSSMGR, mostly for bringup
@@ -872,6 +988,7 @@ int omapdss_set_hdmi_mode(struct omap_dss_device *dssdev, int code)
 		hdmi.mode = HDMI_HDMI;
 		hdmi.code = code;
 		hdmi.cfg.timings = cea_modes[code];
+		hdmi_remember_mode();
 	}
 
 	if (rc == 0 && hdmi.enabled) {
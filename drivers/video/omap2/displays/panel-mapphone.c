@@ -245,6 +245,10 @@ struct mapphone_data {
 	struct workqueue_struct *esd_wq;
 	struct delayed_work esd_work;
 
+	/* panel supplies, ramped while the DSI link comes up */
+	struct work_struct power_work;
+	int power_result;
+
 	struct panel_config *panel_config;
 };
 
@@ -327,6 +331,16 @@ static void mapphone_panel_power_off(struct omap_dss_device *dssdev,
 				bool secret);
 static int mapphone_panel_power_on(struct omap_dss_device *dssdev);
 
+static void mapphone_power_work(struct work_struct *work)
+{
+	struct mapphone_data *mp_data = container_of(work, struct mapphone_data,
+						     power_work);
+	struct mapphone_dsi_panel_data *panel_data =
+					get_panel_data(mp_data->dssdev);
+
+	mp_data->power_result = panel_data->power_on(mp_data->dssdev);
+}
+
 static void mapphone_esd_work(struct work_struct *work)
 {
 
@@ -1389,6 +1403,7 @@ static int mapphone_panel_probe(struct omap_dss_device *dssdev)
 		goto err_wq;
 	}
 	INIT_DELAYED_WORK_DEFERRABLE(&mp_data->esd_work, mapphone_esd_work);
+	INIT_WORK(&mp_data->power_work, mapphone_power_work);
 
 	dev_set_drvdata(&dssdev->dev, mp_data);
 	/* Set it to true to enable force update in cmd mode for test */
@@ -3782,13 +3797,26 @@ static int mapphone_panel_power_on(struct omap_dss_device *dssdev)
 	struct mapphone_data *mp_data = dev_get_drvdata(&dssdev->dev);
 	int ret;
 	u8 power_mode = 0;
+	bool powered = false;
 	struct mapphone_dsi_panel_data *panel_data = get_panel_data(dssdev);
+	/*
+	 * The panel is reset after the DSI lanes are up, but its supplies
+	 * can ramp in the meantime: run that part alongside the DSI PLL
+	 * lock and complexio power up.  The bridge used with ULPS wants to
+	 * be fully powered before the link, keep it in the old order.
+	 */
+	bool async_power = !first_boot && !dssdev->phy.dsi.d2l_use_ulps &&
+		panel_data->power_on && panel_data->release_reset;
+
+	if (async_power)
+		schedule_work(&mp_data->power_work);
 
 	if (!first_boot && dssdev->phy.dsi.d2l_use_ulps) {
 		if (dssdev->platform_enable) {
 			ret = dssdev->platform_enable(dssdev);
 			if (ret)
 				goto err0;
+			powered = true;
 		}
 	}
 
@@ -3804,6 +3832,10 @@ static int mapphone_panel_power_on(struct omap_dss_device *dssdev)
 	ret = omapdss_dsi_display_enable(dssdev);
 	if (ret) {
 		dev_err(&dssdev->dev, "failed to enable DSI\n");
+		if (async_power) {
+			flush_work(&mp_data->power_work);
+			powered = !mp_data->power_result;
+		}
 		goto err0;
 	}
 
@@ -3837,11 +3869,19 @@ static int mapphone_panel_power_on(struct omap_dss_device *dssdev)
 	}
 #endif
 
-	if (!first_boot && !dssdev->phy.dsi.d2l_use_ulps) {
+	if (async_power) {
+		flush_work(&mp_data->power_work);
+		ret = mp_data->power_result;
+		if (ret)
+			goto err0;
+		powered = true;
+		panel_data->release_reset(dssdev);
+	} else if (!first_boot && !dssdev->phy.dsi.d2l_use_ulps) {
 		if (dssdev->platform_enable) {
 			ret = dssdev->platform_enable(dssdev);
 			if (ret)
 				goto err0;
+			powered = true;
 		}
 	}
 
@@ -3971,12 +4011,16 @@ err:
 
 	omapdss_dsi_display_disable(dssdev, true, dssdev->phy.dsi.d2l_use_ulps);
 	/* clk is already disabled above, skip dsi_runtime_put() */
+	if (powered && dssdev->platform_disable)
+		dssdev->platform_disable(dssdev);
 	return ret;
 err0:
 	if (panel_init_state == MAPPHONE_PANEL_UNDETERMINE)
 		panel_init_state = MAPPHONE_PANEL_NOT_PRESENT;
 
 	dsi_runtime_put();
+	if (powered && dssdev->platform_disable)
+		dssdev->platform_disable(dssdev);
 	return ret;
 }
 
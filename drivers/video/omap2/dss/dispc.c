@@ -83,6 +83,41 @@ struct dispc_hv_coef {
 #define REG_FLD_MOD(idx, val, start, end)				\
 	dispc_write_reg(idx, FLD_MOD(dispc_read_reg(idx), val, start, end))
 
+/* plane setup apart from the buffer addresses */
+struct dispc_plane_geom {
+	u16 screen_width;
+	u16 pos_x, pos_y;
+	u16 width, height;
+	u16 out_width, out_height;
+	enum omap_color_mode color_mode;
+	bool ilace;
+	int x_decim, y_decim;
+	bool five_taps;
+	enum omap_dss_rotation_type rotation_type;
+	u8 rotation;
+	bool mirror;
+	u8 global_alpha, pre_mult_alpha;
+};
+
+/*
+ * What the plane registers were last programmed with.  When only the
+ * buffer moves, dispc_setup_plane() writes the base addresses and
+ * leaves the scaler, rotation and FIFO setup alone.
+ */
+struct dispc_plane_state {
+	bool valid;
+	struct dispc_plane_geom geom;
+	u32 ba0, uv0;		/* inputs of the FIFO threshold */
+	u32 fifo_sa;		/* lowest safe low threshold */
+	enum omap_channel channel;
+};
+
+/*
+ * Base address bits the FIFO threshold depends on: the TILER mode and
+ * orientation, and the line within a TILER block.
+ */
+#define DISPC_FIFO_BA_MASK	0xf803e000
+
 struct dispc_irq_stats {
 	unsigned long last_reset;
 	unsigned irq_count;
@@ -111,6 +146,9 @@ static struct {
 	bool		ctx_valid;
 	u32		ctx[DISPC_SZ_REGS / sizeof(u32)];
 
+	struct dispc_plane_state plane_state[MAX_DSS_OVERLAYS];
+	bool lp_fetch[MAX_DSS_MANAGERS];
+
 #ifdef CONFIG_OMAP2_DSS_COLLECT_IRQ_STATS
 	spinlock_t irq_stats_lock;
 	struct dispc_irq_stats irq_stats;
@@ -314,6 +352,10 @@ void dispc_restore_context(void)
 	DSSDBG("ctx_loss_count: saved %d, current %d\n",
 			dispc.ctx_loss_cnt, ctx);
 
+	/* be safe and set up the planes from scratch */
+	for (i = 0; i < ARRAY_SIZE(dispc.plane_state); i++)
+		dispc.plane_state[i].valid = false;
+
 	/*RR(IRQENABLE);*/
 	/*RR(CONTROL);*/
 	RR(CONFIG);
@@ -1381,6 +1423,40 @@ void dispc_setup_plane_fifo(enum omap_plane plane, u32 low, u32 high)
 	dispc_runtime_put();
 }
 
+/*
+ * With low power fetch the FIFO is refilled from its lowest safe level,
+ * in long bursts with long idle gaps in between that let the EMIF enter
+ * self-refresh.  Otherwise it is refilled early, which leaves slack for
+ * the memory latency of a busy interconnect, e.g. during animations.
+ */
+static void dispc_plane_set_fifo(enum omap_plane plane)
+{
+	struct dispc_plane_state *st = &dispc.plane_state[plane];
+	u32 high = dispc_get_plane_fifo_size(plane) - 1;
+	u32 low = st->fifo_sa;
+
+	if (!dispc.lp_fetch[st->channel])
+		low = max(low, high - high / 4);
+	dispc_setup_plane_fifo(plane, low, high);
+}
+
+/* select the FIFO thresholds of the planes on a channel */
+void dispc_set_lp_fetch(enum omap_channel channel, bool enable)
+{
+	int i;
+
+	dispc.lp_fetch[channel] = enable;
+	if (!cpu_is_omap44xx())
+		return;
+
+	for (i = 0; i < dss_feat_get_num_ovls(); i++) {
+		struct dispc_plane_state *st = &dispc.plane_state[i];
+
+		if (st->valid && st->channel == channel)
+			dispc_plane_set_fifo(i);
+	}
+}
+
 void dispc_enable_fifomerge(bool enable)
 {
 	DSSDBG("FIFO merge %s\n", enable ? "enabled" : "disabled");
@@ -2267,7 +2343,9 @@ int dispc_setup_plane(enum omap_plane plane,
 	int pixpg = (color_mode &
 		(OMAP_DSS_COLOR_YUV2 | OMAP_DSS_COLOR_UYVY)) ? 2 : 1;
 	unsigned long tiler_width, tiler_height;
-	u32 fifo_high, fifo_low;
+	struct dispc_plane_state *st = &dispc.plane_state[plane];
+	struct dispc_plane_geom geom;
+	bool same;
 
 	DSSDBG("dispc_setup_plane %d, pa %x, sw %d, %d,%d, %d/%dx%d/%d -> "
 	       "%dx%d, ilace %d, cmode %x, rot %d, mir %d chan %d %dtap\n",
@@ -2280,6 +2358,29 @@ int dispc_setup_plane(enum omap_plane plane,
 	if (paddr == 0)
 		return -EINVAL;
 
+	memset(&geom, 0, sizeof(geom));
+	geom.screen_width = screen_width;
+	geom.pos_x = pos_x;
+	geom.pos_y = pos_y;
+	geom.width = width;
+	geom.height = height;
+	geom.out_width = out_width;
+	geom.out_height = out_height;
+	geom.color_mode = color_mode;
+	geom.ilace = ilace;
+	geom.x_decim = x_decim;
+	geom.y_decim = y_decim;
+	geom.five_taps = five_taps;
+	geom.rotation_type = rotation_type;
+	geom.rotation = rotation;
+	geom.mirror = mirror;
+	geom.global_alpha = global_alpha;
+	geom.pre_mult_alpha = pre_mult_alpha;
+	same = st->valid && !memcmp(&geom, &st->geom, sizeof(geom)) &&
+	       st->channel == channel;
+	st->valid = false;
+	st->channel = channel;
+
 	if (ilace && height == out_height)
 		fieldmode = 1;
 
@@ -2360,7 +2461,7 @@ int dispc_setup_plane(enum omap_plane plane,
 	 * :HACK: we piggy back on UV separate feature for TILER to avoid
 	 * having to keep rebase our FEAT_ enum until they add TILER.
 	 */
-	if (dss_has_feature(FEAT_HANDLE_UV_SEPARATE)) {
+	if (dss_has_feature(FEAT_HANDLE_UV_SEPARATE) && !same) {
 		/* set BURSTTYPE */
 		bool use_tiler = rotation_type == OMAP_DSS_ROT_TILER;
 		REG_FLD_MOD(DISPC_OVL_ATTRIBUTES(plane), use_tiler, 29, 29);
@@ -2418,8 +2519,6 @@ int dispc_setup_plane(enum omap_plane plane,
 	DSSDBG("offset0 %u, offset1 %u, row_inc %d, pix_inc %d\n",
 			offset0, offset1, row_inc, pix_inc);
 
-	_dispc_set_color_mode(plane, color_mode);
-
 	_dispc_set_plane_ba0(plane, paddr + offset0);
 	_dispc_set_plane_ba1(plane, paddr + offset1);
 
@@ -2428,10 +2527,14 @@ int dispc_setup_plane(enum omap_plane plane,
 		_dispc_set_plane_ba1_uv(plane, puv_addr + offset1);
 	}
 
-
 	_dispc_set_row_inc(plane, row_inc);
 	_dispc_set_pix_inc(plane, pix_inc);
 
+	if (same)
+		goto fifo;
+
+	_dispc_set_color_mode(plane, color_mode);
+
 	DSSDBG("%d,%d %d*%dx%d*%d -> %dx%d\n", pos_x, pos_y, width, x_decim,
 			height, y_decim, out_width, out_height);
 
@@ -2454,14 +2557,21 @@ int dispc_setup_plane(enum omap_plane plane,
 	_dispc_set_pre_mult_alpha(plane, pre_mult_alpha);
 	_dispc_setup_global_alpha(plane, global_alpha);
 
-	if (cpu_is_omap44xx()) {
-		fifo_low = dispc_calculate_threshold(plane, paddr + offset0,
-				   puv_addr + offset0, width, height,
-				   row_inc, pix_inc);
-		fifo_high = dispc_get_plane_fifo_size(plane) - 1;
-		dispc_setup_plane_fifo(plane, fifo_low, fifo_high);
+fifo:
+	if (cpu_is_omap44xx() &&
+	    (!same || ((paddr + offset0) ^ st->ba0) & DISPC_FIFO_BA_MASK ||
+	     ((puv_addr + offset0) ^ st->uv0) & DISPC_FIFO_BA_MASK)) {
+		st->fifo_sa = dispc_calculate_threshold(plane,
+				   paddr + offset0, puv_addr + offset0,
+				   width, height, row_inc, pix_inc);
+		dispc_plane_set_fifo(plane);
+		st->ba0 = paddr + offset0;
+		st->uv0 = puv_addr + offset0;
 	}
 
+	st->geom = geom;
+	st->valid = true;
+
 	return 0;
 }
 
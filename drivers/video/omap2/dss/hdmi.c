@@ -30,6 +30,7 @@
 #include <linux/mutex.h>
 #include <linux/delay.h>
 #include <linux/string.h>
+#include <linux/jiffies.h>
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
 #include <linux/pm_runtime.h>
@@ -66,6 +67,23 @@ static struct pm_qos_request_list pm_qos_handle;
 #define HDMI_DEFAULT_REGN 15
 #define HDMI_DEFAULT_REGM2 1
 
+/* sinks remembered across hotplug, e.g. the dock and the lapdock */
+#define HDMI_SINK_CACHE_SIZE			4
+
+/*
+ * EDID and the mode last set on a sink.  A sink is recognized by its base
+ * EDID block, looked up by the block checksum, so that a replug costs a
+ * single DDC block read instead of the full EDID.
+ */
+struct hdmi_sink {
+	u8 edid[HDMI_EDID_MAX_LENGTH];
+	bool valid;
+	bool has_mode;
+	bool can_do_hdmi;
+	struct fb_videomode mode;
+	unsigned long last_used;
+};
+
 static struct {
 	struct mutex lock;
 	struct omap_display_platform_data *pdata;
@@ -98,6 +116,10 @@ static struct {
 	void (*hdmi_start_frame_cb)(void);
 	void (*hdmi_irq_cb)(int);
 	bool (*hdmi_power_on_cb)(void);
+
+	struct hdmi_sink sinks[HDMI_SINK_CACHE_SIZE];
+	struct hdmi_sink *sink;		/* attached sink, if known */
+	bool cached_mode;		/* enabled in the sink's cached mode */
 } hdmi;
 
 static const u8 edid_header[8] = {0x0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x0};
@@ -266,6 +288,78 @@ void hdmi_get_monspecs(struct fb_monspecs *specs)
 	specs->modedb_len = j;
 }
 
+/* one DDC block read, HDMI must be powered */
+static struct hdmi_sink *hdmi_lookup_sink(void)
+{
+	u8 block0[EDID_DESCRIPTOR_BLOCK1_ADDRESS];
+	int i;
+
+	if (read_ti_4xxx_edid(&hdmi.hdmi_data, block0, sizeof(block0)) ||
+	    memcmp(block0, edid_header, sizeof(edid_header)))
+		return NULL;
+
+	for (i = 0; i < HDMI_SINK_CACHE_SIZE; i++) {
+		struct hdmi_sink *sink = &hdmi.sinks[i];
+
+		if (sink->valid && sink->edid[0x7f] == block0[0x7f] &&
+		    !memcmp(sink->edid, block0, sizeof(block0))) {
+			sink->last_used = jiffies;
+			return sink;
+		}
+	}
+
+	return NULL;
+}
+
+/* replaces the least recently seen sink */
+static struct hdmi_sink *hdmi_store_sink(const u8 *edid)
+{
+	struct hdmi_sink *sink = &hdmi.sinks[0];
+	int i;
+
+	for (i = 1; i < HDMI_SINK_CACHE_SIZE && sink->valid; i++)
+		if (!hdmi.sinks[i].valid ||
+		    time_before(hdmi.sinks[i].last_used, sink->last_used))
+			sink = &hdmi.sinks[i];
+
+	memcpy(sink->edid, edid, HDMI_EDID_MAX_LENGTH);
+	sink->valid = true;
+	sink->has_mode = false;
+	sink->last_used = jiffies;
+	return sink;
+}
+
+/*
+ * Replug of a known sink: take the EDID from the cache and, if a mode was
+ * set on it before, power up straight into that mode rather than into VGA
+ * and waiting for userspace to pick it again.
+ */
+static void hdmi_restore_sink(void)
+{
+	struct fb_videomode vm;
+
+	hdmi.sink = hdmi_lookup_sink();
+	if (!hdmi.sink)
+		return;
+
+	memcpy(hdmi.edid, hdmi.sink->edid, HDMI_EDID_MAX_LENGTH);
+	hdmi.edid_set = true;
+	pr_info("hdmi: known sink, using cached EDID\n");
+
+	if (!hdmi.sink->has_mode)
+		return;
+
+	vm = hdmi.sink->mode;
+	if (!hdmi_set_timings(&vm, false))
+		return;
+
+	hdmi.custom_set = 1;
+	hdmi.code = hdmi.cfg.cm.code;
+	hdmi.mode = hdmi.cfg.cm.mode;
+	hdmi.can_do_hdmi = hdmi.sink->can_do_hdmi;
+	hdmi.cached_mode = true;
+}
+
 u8 *hdmi_read_edid(struct omap_video_timings *dp)
 {
 	int ret = 0, i;
@@ -273,6 +367,13 @@ u8 *hdmi_read_edid(struct omap_video_timings *dp)
 	if (hdmi.edid_set)
 		return hdmi.edid;
 
+	hdmi.sink = hdmi_lookup_sink();
+	if (hdmi.sink) {
+		memcpy(hdmi.edid, hdmi.sink->edid, HDMI_EDID_MAX_LENGTH);
+		hdmi.edid_set = true;
+		return hdmi.edid;
+	}
+
 	memset(hdmi.edid, 0, HDMI_EDID_MAX_LENGTH);
 
 	ret = read_ti_4xxx_edid(&hdmi.hdmi_data, hdmi.edid,
@@ -297,6 +398,7 @@ u8 *hdmi_read_edid(struct omap_video_timings *dp)
 		return NULL;
 
 	hdmi.edid_set = true;
+	hdmi.sink = hdmi_store_sink(hdmi.edid);
 	return hdmi.edid;
 }
 
@@ -637,6 +739,15 @@ int omapdss_hdmi_display_set_mode(struct omap_dss_device *dssdev,
 {
 	int r1, r2;
 	DSSINFO("Enter omapdss_hdmi_display_set_mode\n");
+
+	/* userspace picking the mode we already came up in on replug */
+	if (hdmi.cached_mode) {
+		hdmi.cached_mode = false;
+		if (hdmi.enabled && hdmi_set_timings(vm, true) &&
+		    relaxed_fb_mode_is_equal(vm, &hdmi.cfg.timings))
+			return 0;
+	}
+
 	/* turn the hdmi off and on to get new timings to use */
 	hdmi.set_mode = true;
 	dssdev->driver->disable(dssdev);
@@ -646,6 +757,11 @@ int omapdss_hdmi_display_set_mode(struct omap_dss_device *dssdev,
 	hdmi.code = hdmi.cfg.cm.code;
 	hdmi.mode = hdmi.cfg.cm.mode;
 	r2 = dssdev->driver->enable(dssdev);
+	if (!r1 && !r2 && hdmi.sink) {
+		hdmi.sink->mode = *vm;
+		hdmi.sink->has_mode = true;
+		hdmi.sink->can_do_hdmi = hdmi.can_do_hdmi;
+	}
 	return r1 ? : r2;
 }
 
@@ -702,7 +818,16 @@ int omapdss_hdmi_display_enable(struct omap_dss_device *dssdev)
 		goto err3;
 	}
 
+	/* hold the power across the cache lookup and the power on */
+	r = hdmi_runtime_get();
+	if (r)
+		goto err4;
+
+	if (!hdmi.custom_set)
+		hdmi_restore_sink();
+
 	r = hdmi_power_on(dssdev);
+	hdmi_runtime_put();
 	if (r) {
 		DSSERR("failed to power on device\n");
 		goto err4;
@@ -745,6 +870,7 @@ void omapdss_hdmi_display_disable(struct omap_dss_device *dssdev)
 			/* clear EDID and mode on disable only */
 			hdmi.edid_set = false;
 			hdmi.custom_set = 0;
+			hdmi.cached_mode = false;
 			pr_info("hdmi: clearing EDID info\n");
 		}
 	regulator_disable(hdmi.hdmi_reg);
@@ -30,6 +30,7 @@
 #include <linux/jiffies.h>
 #include <linux/ratelimit.h>
 #include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #include <video/omapdss.h>
 #include <plat/cpu.h>
@@ -616,6 +617,9 @@ struct manager_cache_data {
 	bool cpr_enable;
 	struct omap_dss_cpr_coefs cpr_coefs;
 	bool skip_vm_init;
+
+	/* last GO, or update start on manual update displays */
+	ktime_t go_time;
 };
 
 static struct {
@@ -1279,10 +1283,12 @@ static int configure_dispc(void)
 		 * always be turned off after frame, and new settings will be
 		 * taken in to use at next update */
 		if (!mc->manual_upd_display){
-			if (mc->skip_vm_init)
+			if (mc->skip_vm_init) {
 				mc->skip_vm_init = false;
-			else
+			} else {
 				dispc_go(i);
+				mc->go_time = ktime_get();
+			}
 		}
 	}
 
@@ -1544,6 +1550,7 @@ void dss_start_update(struct omap_dss_device *dssdev)
 	mgr = dssdev->manager;
 
 	spin_lock_irqsave(&dss_cache.lock, flags);
+	dss_cache.manager_cache[mgr->id].go_time = ktime_get();
 	for (i = 0; i < num_ovls; ++i) {
 		oc = &dss_cache.overlay_cache[i];
 		if (oc->channel != mgr->id)
@@ -2017,6 +2024,52 @@ done:
 	return r;
 }
 
+/*
+ * Time the configuration that was last programmed got its GO.  Meant for
+ * the completion callbacks, which run with the cache locked.
+ */
+static ktime_t omap_dss_mgr_get_go_time(struct omap_overlay_manager *mgr)
+{
+	return dss_cache.manager_cache[mgr->id].go_time;
+}
+
+/*
+ * Switch the FIFO thresholds of the manager's planes between low power
+ * and latency safe fetching.  This goes straight to the shadow registers
+ * without going through the cache, so that the callbacks of the
+ * composition on screen are left alone.
+ */
+static int omap_dss_mgr_set_lp_fetch(struct omap_overlay_manager *mgr,
+				     bool enable)
+{
+	unsigned long flags;
+	int r;
+
+	r = dispc_runtime_get();
+	if (r)
+		return r;
+
+	spin_lock_irqsave(&dss_cache.lock, flags);
+
+	if (!mgr->device || mgr->device->state != OMAP_DSS_DISPLAY_ACTIVE) {
+		r = -ENODEV;
+		goto done;
+	}
+
+	dispc_set_lp_fetch(mgr->id, enable);
+
+	/* a pending GO takes the new thresholds along */
+	if (!dss_cache.manager_cache[mgr->id].manual_upd_display &&
+	    !dispc_go_busy(mgr->id))
+		dispc_go(mgr->id);
+done:
+	spin_unlock_irqrestore(&dss_cache.lock, flags);
+
+	dispc_runtime_put();
+
+	return r;
+}
+
 #ifdef CONFIG_DEBUG_FS
 static void seq_print_cb(struct seq_file *s, struct omapdss_ovl_cb *cb)
 {
@@ -2214,6 +2267,8 @@ int dss_init_overlay_managers(struct platform_device *pdev)
 		mgr->wait_for_go = &dss_mgr_wait_for_go;
 		mgr->wait_for_vsync = &dss_mgr_wait_for_vsync;
 		mgr->blank = &omap_dss_mgr_blank;
+		mgr->set_lp_fetch = &omap_dss_mgr_set_lp_fetch;
+		mgr->get_go_time = &omap_dss_mgr_get_go_time;
 		mgr->dump_cb = &seq_print_cbs;
 		mgr->ignore_sync = 0;
 
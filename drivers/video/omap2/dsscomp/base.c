@@ -177,7 +177,7 @@ int crop_to_rect(union rect *crop, union rect *win, union rect *vis,
 
 int set_dss_ovl_info(struct dss2_ovl_info *oi)
 {
-	struct omap_overlay_info info;
+	struct omap_overlay_info info, old;
 	struct omap_overlay *ovl;
 	struct dss2_ovl_cfg *cfg;
 	union rect crop, win, vis;
@@ -191,6 +191,7 @@ int set_dss_ovl_info(struct dss2_ovl_info *oi)
 
 	/* just in case there are new fields, we get the current info */
 	ovl->get_overlay_info(ovl, &info);
+	old = info;
 
 	info.enabled = cfg->enabled;
 	if (!cfg->enabled)
@@ -351,6 +352,10 @@ done:
 		info.color_mode, info.zorder, info.global_alpha,
 		info.pre_mult_alpha);
 #endif
+	/* leave unchanged overlays out of the next apply */
+	if (!memcmp(&info, &old, sizeof(info)))
+		return 0;
+
 	/* set overlay info */
 	return ovl->set_overlay_info(ovl, &info);
 }
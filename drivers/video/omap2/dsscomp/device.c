@@ -603,6 +603,10 @@ static int dsscomp_probe(struct platform_device *pdev)
 #ifdef CONFIG_DSSCOMP_DEBUG_LOG
 		debugfs_create_file("log", S_IRUGO,
 			cdev->dbgfs, dsscomp_dbg_events, &dsscomp_debug_fops);
+#endif
+#ifdef CONFIG_DSSCOMP_FRAME_STATS
+		debugfs_create_file("frames", S_IRUGO,
+			cdev->dbgfs, dsscomp_dbg_frames, &dsscomp_debug_fops);
 #endif
 	}
 
@@ -25,6 +25,8 @@
 #include <linux/miscdevice.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 #ifdef CONFIG_DSSCOMP_DEBUG_LOG
 #include <linux/hrtimer.h>
 #endif
@@ -115,6 +117,17 @@ struct dsscomp_data {
 	void *extra_cb_data;
 	bool must_apply;	/* whether composition must be applied */
 
+	/* completion callbacks, set from the DISPC interrupt */
+	struct work_struct cb_work;
+	u32 cb_status;		/* statuses not yet handled by cb_work */
+	bool fenced;		/* counted in its manager's apply fence */
+
+#ifdef CONFIG_DSSCOMP_FRAME_STATS
+	struct {
+		ktime_t submit, apply, applied, go, latched, displayed;
+	} times;
+#endif
+
 #ifdef CONFIG_DEBUG_FS
 	struct list_head dbg_q;
 	u32 dbg_used;
@@ -172,6 +185,7 @@ const char *dsscomp_get_color_name(enum omap_color_mode m);
 
 void dsscomp_dbg_comps(struct seq_file *s);
 void dsscomp_dbg_gralloc(struct seq_file *s);
+void dsscomp_dbg_frames(struct seq_file *s);
 
 #define log_state_str(s) (\
 	(s) == DSSCOMP_STATE_ACTIVE		? "ACTIVE"	: \
@@ -26,12 +26,35 @@ static DEFINE_MUTEX(mtx);
 static struct semaphore free_slots_sem =
 				__SEMAPHORE_INITIALIZER(free_slots_sem, 0);
 
+#define GRALLOC_MAP_CACHE_SIZE	8
+
+/*
+ * Non-TILER buffers kept mapped into TILER 1D between frames.  Surfaces
+ * cycle through the same few buffers, so a layer whose page list matches
+ * a cached mapping is scanned out from it without pinning anything.  A
+ * page list identifies the memory, not the buffer: a mapping left over
+ * from a freed buffer is only used again for the very same pages.
+ * Mappings are only recycled once no queued composition uses them.
+ */
+static struct gralloc_map {
+	struct list_head q;		/* most recently used first */
+	tiler_blk_handle blk;
+	u32 phys;
+	u32 area;			/* pages reserved */
+	u32 num_pg;			/* pages pinned */
+	u32 *pages;
+	int refs;			/* compositions using it, under mtx */
+} maps[GRALLOC_MAP_CACHE_SIZE];
+static LIST_HEAD(map_lru);
+static u32 map_pages;			/* TILER 1D reserved by the cache */
+
 /* gralloc composition sync object */
 struct dsscomp_gralloc_t {
 	void (*cb_fn)(void *, int);
 	void *cb_arg;
 	struct list_head q;
 	struct list_head slots;
+	u32 map_mask;			/* cached mappings used */
 	atomic_t refs;
 	bool early_callback;
 	bool programmed;
@@ -70,6 +93,88 @@ void dsscomp_flip_queue_length_invalidate(void)
 
 static u32 ovl_use_mask[MAX_MANAGERS];
 
+/*
+ * Layers of the last frame queued to each manager.  Manually updated
+ * panels are only sent the region of the layers that changed: buffers
+ * are not drawn to once queued, so a layer with the same buffer and
+ * configuration shows the same pixels.  Buffers are identified before
+ * their TILER 1D mapping, which moves every frame.
+ */
+struct gralloc_frame {
+	bool valid;
+	struct dss2_mgr_info mgr;
+	u32 ovl_mask;				/* enabled overlays */
+	struct dss2_ovl_cfg cfg[MAX_OVERLAYS];
+	u32 src[MAX_OVERLAYS];
+};
+
+static struct gralloc_frame last_frame[MAX_MANAGERS];
+static struct gralloc_frame next_frame[MAX_MANAGERS];
+
+static void rect_union(struct dss2_rect_t *u, const struct dss2_rect_t *r)
+{
+	s32 x2, y2;
+
+	if (!r->w || !r->h)
+		return;
+	if (!u->w || !u->h) {
+		*u = *r;
+		return;
+	}
+
+	x2 = max(u->x + (s32) u->w, r->x + (s32) r->w);
+	y2 = max(u->y + (s32) u->h, r->y + (s32) r->h);
+	u->x = min(u->x, r->x);
+	u->y = min(u->y, r->y);
+	u->w = x2 - u->x;
+	u->h = y2 - u->y;
+}
+
+/* update region of the next frame, w == 0 for the full screen */
+static struct dss2_rect_t gralloc_damage(u32 ch, struct omap_dss_device *dev)
+{
+	struct gralloc_frame *o = last_frame + ch, *n = next_frame + ch;
+	struct dss2_rect_t win = { .w = 0 };
+	u32 mask = o->ovl_mask | n->ovl_mask;
+	s32 x2, y2;
+	int i;
+
+	if (!o->valid || !n->valid || !dev ||
+	    memcmp(&o->mgr, &n->mgr, sizeof(o->mgr)))
+		goto full;
+
+	for (i = 0; i < MAX_OVERLAYS; i++) {
+		bool was = o->ovl_mask & (1 << i), is = n->ovl_mask & (1 << i);
+
+		if (!(mask & (1 << i)))
+			continue;
+		if (was && is && o->src[i] == n->src[i] &&
+		    !memcmp(o->cfg + i, n->cfg + i, sizeof(n->cfg[i])))
+			continue;
+		if (was)
+			rect_union(&win, &o->cfg[i].win);
+		if (is)
+			rect_union(&win, &n->cfg[i].win);
+	}
+
+	/* nothing changed: a refresh was asked for */
+	if (!win.w || !win.h)
+		goto full;
+
+	x2 = min(win.x + (s32) win.w, (s32) dev->panel.timings.x_res);
+	y2 = min(win.y + (s32) win.h, (s32) dev->panel.timings.y_res);
+	win.x = max(win.x, 0);
+	win.y = max(win.y, 0);
+	if (x2 <= win.x || y2 <= win.y)
+		goto full;
+	win.w = x2 - win.x;
+	win.h = y2 - win.y;
+	return win;
+full:
+	win.x = win.y = win.w = win.h = 0;
+	return win;
+}
+
 static void unpin_tiler_blocks(struct list_head *slots)
 {
 	struct tiler1d_slot *slot;
@@ -84,6 +189,87 @@ static void unpin_tiler_blocks(struct list_head *slots)
 	list_splice_init(slots, &free_slots);
 }
 
+static void gralloc_map_free(struct gralloc_map *m)
+{
+	if (m->num_pg)
+		tiler_unpin_block(m->blk);
+	if (m->blk)
+		tiler_free_block_area(m->blk);
+	vfree(m->pages);
+	map_pages -= m->area;
+	m->blk = NULL;
+	m->pages = NULL;
+	m->area = m->num_pg = 0;
+}
+
+/* Locking: mtx */
+static struct gralloc_map *gralloc_map_get(u32 *pages, u32 num_pg)
+{
+	/* the cache is given one slot's worth of TILER 1D */
+	u32 budget = tiler1d_slot_size(cdev) >> PAGE_SHIFT;
+	struct gralloc_map *m, *victim = NULL;
+
+	list_for_each_entry(m, &map_lru, q) {
+		if (m->num_pg == num_pg && m->pages[0] == pages[0] &&
+		    !memcmp(m->pages, pages, num_pg * sizeof(*pages)))
+			goto found;
+		if (!m->refs)
+			victim = m;
+	}
+
+	/* recycle the least recently used idle mapping */
+	m = victim;
+	if (!m)
+		return NULL;
+
+	if (m->area < num_pg) {
+		gralloc_map_free(m);
+		list_for_each_entry_reverse(victim, &map_lru, q) {
+			if (map_pages + num_pg <= budget)
+				break;
+			if (!victim->refs)
+				gralloc_map_free(victim);
+		}
+		if (map_pages + num_pg > budget)
+			return NULL;
+
+		m->pages = vmalloc(num_pg * sizeof(*pages));
+		if (!m->pages)
+			return NULL;
+		m->blk = tiler_alloc_block_area(TILFMT_PAGE,
+				num_pg << PAGE_SHIFT, 1, &m->phys, NULL);
+		if (IS_ERR_OR_NULL(m->blk)) {
+			m->blk = NULL;
+			gralloc_map_free(m);
+			return NULL;
+		}
+		m->area = num_pg;
+		map_pages += num_pg;
+	} else if (m->num_pg) {
+		tiler_unpin_block(m->blk);
+	}
+
+	memcpy(m->pages, pages, num_pg * sizeof(*pages));
+	m->num_pg = 0;
+	if (tiler_pin_block(m->blk, m->pages, num_pg))
+		return NULL;
+	m->num_pg = num_pg;
+found:
+	list_move(&m->q, &map_lru);
+	return m;
+}
+
+/* Locking: mtx */
+static void gralloc_map_put(u32 mask)
+{
+	while (mask) {
+		int i = __ffs(mask);
+
+		maps[i].refs--;
+		mask &= ~(1 << i);
+	}
+}
+
 static void dsscomp_gralloc_cb(void *data, int status)
 {
 	struct dsscomp_gralloc_t *gsync = data, *gsync_;
@@ -95,8 +281,10 @@ static void dsscomp_gralloc_cb(void *data, int status)
 		gsync->programmed = true;
 
 	if (status & DSS_COMPLETION_RELEASED) {
-		if (atomic_dec_and_test(&gsync->refs))
+		if (atomic_dec_and_test(&gsync->refs)) {
 			unpin_tiler_blocks(&gsync->slots);
+			gralloc_map_put(gsync->map_mask);
+		}
 
 		log_event(0, 0, gsync, "--refs=%d on %s",
 				atomic_read(&gsync->refs),
@@ -191,6 +379,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	u32 ms = dsscomp_debug_log_timestamp();
 #endif
 	u32 channels[ARRAY_SIZE(d->mgrs)], ch;
+	u32 srcs[ARRAY_SIZE(d->ovls)];
 	int skip;
 	struct dsscomp_gralloc_t *gsync;
 	struct dss2_rect_t win = { .w = 0 };
@@ -239,8 +428,14 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	memset(comp, 0, sizeof(comp));
 	memset(ovl_new_use_mask, 0, sizeof(ovl_new_use_mask));
 
-	if (skip)
+	memset(next_frame, 0, sizeof(next_frame));
+	memset(srcs, 0, sizeof(srcs));
+
+	if (skip) {
+		/* the panel will need a full update afterwards */
+		memset(last_frame, 0, sizeof(last_frame));
 		goto skip_comp;
+	}
 
 	d->mode = DSSCOMP_SETUP_DISPLAY;
 
@@ -267,6 +462,9 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 		/* swap red & blue if requested */
 		if (d->mgrs[i].swap_rb)
 			swap_rb_in_mgr_info(d->mgrs + i);
+
+		next_frame[ch].valid = true;
+		next_frame[ch].mgr = d->mgrs[i];
 	}
 
 	/* create dsscomp objects for set managers (including active ones) */
@@ -312,6 +510,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 		struct dss2_ovl_info *oi = d->ovls + i;
 		u32 mgr_ix = oi->cfg.mgr_ix;
 		u32 size;
+		u32 src = oi->ba;
 
 		/* verify manager index */
 		if (mgr_ix >= d->num_mgrs) {
@@ -339,6 +538,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 
 			oi->ba = d->ovls[j].ba;
 			oi->uv = d->ovls[j].uv;
+			src = srcs[j];
 			goto skip_map1d;
 		} else if (oi->addressing == OMAP_DSS_BUFADDR_FB) {
 			/* get fb */
@@ -366,6 +566,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 
 			oi->ba += fbi->fix.smem_start;
 			oi->uv += fbi_uv->fix.smem_start;
+			src = oi->ba;
 			goto skip_map1d;
 		}
 
@@ -375,6 +576,30 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 		if (!pas[i] || !oi->cfg.enabled)
 			goto skip_map1d;
 
+		size = oi->cfg.stride * oi->cfg.height;
+		if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
+			size += size >> 2;
+		size = DIV_ROUND_UP(size, PAGE_SIZE);
+
+		/* reuse the mapping of a buffer shown before */
+		if (size <= pas[i]->num_pg) {
+			struct gralloc_map *m;
+
+			mutex_lock(&mtx);
+			m = gralloc_map_get(pas[i]->mem, size);
+			if (m && !(gsync->map_mask & (1 << (m - maps)))) {
+				gsync->map_mask |= 1 << (m - maps);
+				m->refs++;
+			}
+			mutex_unlock(&mtx);
+
+			if (m) {
+				src = pas[i]->mem[0] + (oi->ba & ~PAGE_MASK);
+				oi->ba = m->phys + (oi->ba & ~PAGE_MASK);
+				goto skip_map1d;
+			}
+		}
+
 		if (!slot) {
 			/* If no callback function supplied, then do not wait
 			 * for empty slots.  This allows disabling of vsync
@@ -397,11 +622,6 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 			mutex_unlock(&mtx);
 		}
 
-		size = oi->cfg.stride * oi->cfg.height;
-		if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
-			size += size >> 2;
-		size = DIV_ROUND_UP(size, PAGE_SIZE);
-
 		if (slot_used + size > slot->size) {
 			dev_err(DEV(cdev), "tiler slot not big enough for frame %d + %d > %d",
 				slot_used, size, slot->size);
@@ -409,6 +629,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 		}
 
 		/* "map" into TILER 1D - will happen after loop */
+		src = pas[i]->mem[0] + (oi->ba & ~PAGE_MASK);
 		oi->ba = slot->phys + (slot_used << PAGE_SHIFT) +
 			(oi->ba & ~PAGE_MASK);
 		memcpy(slot->page_map + slot_used, pas[i]->mem,
@@ -419,16 +640,23 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 skip_buffer:
 		oi->cfg.enabled = false;
 skip_map1d:
+		srcs[i] = src;
 
 		if (oi->cfg.enabled)
 			ovl_new_use_mask[ch] |= 1 << oi->cfg.ix;
 
 		r = dsscomp_set_ovl(comp[ch], oi);
-		if (r)
+		if (r) {
 			dev_err(DEV(cdev), "failed to set ovl%d (%d)\n",
 								oi->cfg.ix, r);
-		else
+		} else {
 			ovl_set_mask |= 1 << oi->cfg.ix;
+			if (oi->cfg.enabled && oi->cfg.ix < MAX_OVERLAYS) {
+				next_frame[ch].ovl_mask |= 1 << oi->cfg.ix;
+				next_frame[ch].cfg[oi->cfg.ix] = oi->cfg;
+				next_frame[ch].src[oi->cfg.ix] = src;
+			}
+		}
 	}
 
 	if (slot && slot_used) {
@@ -464,11 +692,17 @@ skip_map1d:
 		log_event(0, ms, gsync, "++refs=%d for [%p]",
 				atomic_read(&gsync->refs), (u32) comp[ch]);
 
+		/* only send what changed to manually updated panels */
+		comp[ch]->frm.win = gralloc_damage(ch, cdev->mgrs[ch]->device);
+
 		r = dsscomp_delayed_apply(comp[ch]);
-		if (r)
+		if (r) {
 			dev_err(DEV(cdev), "failed to apply comp (%d)\n", r);
-		else
+			next_frame[ch].valid = false;
+		} else {
 			ovl_use_mask[ch] = ovl_new_use_mask[ch];
+		}
+		last_frame[ch] = next_frame[ch];
 	}
 skip_comp:
 	/* release sync object ref - this completes unapplied compositions */
@@ -601,6 +835,10 @@ void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 #endif
 	}
 
+	if (list_empty(&map_lru))
+		for (i = 0; i < GRALLOC_MAP_CACHE_SIZE; i++)
+			list_add_tail(&maps[i].q, &map_lru);
+
 	if (!free_slots.next) {
 		INIT_LIST_HEAD(&free_slots);
 		for (i = 0; i < NUM_ANDROID_TILER1D_SLOTS; i++) {
@@ -635,6 +873,7 @@ void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 void dsscomp_gralloc_exit(void)
 {
 	struct tiler1d_slot *slot;
+	int i;
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	unregister_early_suspend(&early_suspend_info);
@@ -645,4 +884,10 @@ void dsscomp_gralloc_exit(void)
 		tiler_free_block_area(slot->slot);
 	}
 	INIT_LIST_HEAD(&free_slots);
+
+	mutex_lock(&mtx);
+	for (i = 0; i < GRALLOC_MAP_CACHE_SIZE; i++)
+		gralloc_map_free(maps + i);
+	INIT_LIST_HEAD(&map_lru);
+	mutex_unlock(&mtx);
 }
@@ -32,6 +32,9 @@
 #include <linux/debugfs.h>
 
 #include "dsscomp.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/dsscomp.h>
 /* queue state */
 
 static DEFINE_MUTEX(mtx);
@@ -48,8 +51,115 @@ static struct {
 	u32 ovl_mask;		/* overlays used on this display */
 	struct maskref ovl_qmask;		/* overlays queued to this display */
 	bool blanking;
+
+	/* apply fence: compositions applied but not yet programmed */
+	u32 inflight;
+	wait_queue_head_t fence_wq;
+
+	/* fetch policy */
+	bool lp_fetch;			/* low power fetch selected */
+	unsigned long last_apply;	/* jiffies of the last composition */
+	struct delayed_work lp_work;
 } mgrq[MAX_MANAGERS];
 
+/*
+ * Compositions of video overlays only, and any screen that stayed static
+ * for lp_fetch_ms, are fetched in low power mode; 0 always keeps the
+ * latency safe FIFO thresholds.
+ */
+static unsigned int lp_fetch_ms = 100;
+module_param(lp_fetch_ms, uint, 0644);
+
+/*
+ * One composition in the shadow registers waiting for GO, one in the DSS
+ * cache that the vsync interrupt programs as soon as GO clears.
+ */
+#define DSSCOMP_FENCE_DEPTH	2
+#define DSSCOMP_FENCE_TIMEOUT	msecs_to_jiffies(100)
+
+static DEFINE_SPINLOCK(cb_lock);	/* cb_status, fenced and inflight */
+
+#ifdef CONFIG_DSSCOMP_FRAME_STATS
+/* pipeline timing of a released frame, stages in us after submission */
+struct dsscomp_frame {
+	u32 sync_id;
+	s64 submit_us;
+	u32 apply, applied, go, latched, displayed;	/* 0: did not happen */
+};
+
+/* per display, protected by mtx */
+static struct {
+	struct dsscomp_frame frames[64];
+	u32 ix;
+	u32 period_us;
+	u32 late_apply;		/* apply started a frame after submission */
+	u32 slow_setup;		/* setup took more than half a frame */
+	u32 late_go;		/* latched more than 2 frames after submission */
+	u32 overrun;		/* update took more than a frame */
+	u32 dropped;		/* released without being displayed */
+} frame_stats[MAX_MANAGERS];
+
+static inline void frame_stamp(ktime_t *t)
+{
+	*t = ktime_get();
+}
+
+static u32 frame_stage_us(dsscomp_t comp, ktime_t t)
+{
+	s64 us;
+
+	if (!t.tv64)
+		return 0;
+	us = ktime_us_delta(t, comp->times.submit);
+	return us > 0 ? us : 1;
+}
+
+/* Locking: mtx */
+static void dsscomp_frame_record(dsscomp_t comp)
+{
+	typeof(frame_stats[0]) *st = &frame_stats[comp->ix];
+	struct dsscomp_frame *f = &st->frames[st->ix];
+	u32 period = st->period_us ? : 16667;
+
+	if (comp->blank || !comp->times.submit.tv64)
+		return;
+
+	f->sync_id = comp->frm.sync_id;
+	f->submit_us = ktime_to_us(comp->times.submit);
+	f->apply = frame_stage_us(comp, comp->times.apply);
+	f->applied = frame_stage_us(comp, comp->times.applied);
+	f->go = frame_stage_us(comp, comp->times.go);
+	f->latched = frame_stage_us(comp, comp->times.latched);
+	f->displayed = frame_stage_us(comp, comp->times.displayed);
+	st->ix = (st->ix + 1) % ARRAY_SIZE(st->frames);
+
+	if (f->apply > period)
+		st->late_apply++;
+	if (f->applied && f->applied - f->apply > period / 2)
+		st->slow_setup++;
+	if (f->latched > 2 * period)
+		st->late_go++;
+	if (f->displayed && f->latched && f->displayed - f->latched > period)
+		st->overrun++;
+	if (!f->displayed)
+		st->dropped++;
+}
+
+static u32 dsscomp_frame_period_us(struct omap_dss_device *dssdev)
+{
+	struct omap_video_timings *t = &dssdev->panel.timings;
+	u64 us = (u64) (t->x_res + t->hfp + t->hsw + t->hbp) *
+			(t->y_res + t->vfp + t->vsw + t->vbp) * 1000;
+
+	if (!t->pixel_clock)
+		return 0;
+	do_div(us, t->pixel_clock);
+	return us;
+}
+#define DO_IF_FRAME_STATS(cmd) do { cmd; } while (0)
+#else
+#define DO_IF_FRAME_STATS(cmd) do { } while (0)
+#endif
 static struct workqueue_struct *cb_wkq;		/* callback work queue */
 static struct dsscomp_dev *cdev;
 
@@ -77,6 +187,9 @@ static inline void __log_state(dsscomp_t c, void *fn, u32 ev)
 }
 #define log_state(c, fn, ev) DO_IF_DEBUG_FS(__log_state(c, fn, ev))
 
+static void dsscomp_mgr_delayed_cb(struct work_struct *work);
+static void dsscomp_lp_work(struct work_struct *work);
+
 static inline void maskref_incbit(struct maskref *om, u32 ix)
 {
 	om->refs[ix]++;
@@ -111,6 +224,8 @@ int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 	ZERO(mgrq);
 	for (i = 0; i < cdev->num_mgrs; i++) {
 		struct omap_overlay_manager *mgr;
+		init_waitqueue_head(&mgrq[i].fence_wq);
+		INIT_DELAYED_WORK(&mgrq[i].lp_work, dsscomp_lp_work);
 		mgrq[i].apply_workq = create_singlethread_workqueue("dsscomp_apply");
 		if (!mgrq[i].apply_workq)
 			goto error;
@@ -181,6 +296,7 @@ dsscomp_t dsscomp_new(struct omap_overlay_manager *mgr)
 	comp->frm.sync_id = 0;
 	comp->frm.mgr.ix = display_ix;
 	comp->state = DSSCOMP_STATE_ACTIVE;
+	INIT_WORK(&comp->cb_work, dsscomp_mgr_delayed_cb);
 
 	DO_IF_DEBUG_FS({
 		__log_state(comp, dsscomp_new, 0);
@@ -369,23 +485,16 @@ void dsscomp_drop(dsscomp_t comp)
 }
 EXPORT_SYMBOL(dsscomp_drop);
 
-struct dsscomp_cb_work {
-	struct work_struct work;
-	struct dsscomp_data *comp;
-	int status;
-};
-
-static void dsscomp_mgr_delayed_cb(struct work_struct *work)
+/*
+ * Handle one completion status of a composition.  Returns true if the
+ * composition was released.
+ *
+ * Locking: mtx
+ */
+static bool dsscomp_mgr_complete(dsscomp_t comp, int status)
 {
-	struct dsscomp_cb_work *wk = container_of(work, typeof(*wk), work);
-	struct dsscomp_data *comp = wk->comp;
-	int status = wk->status;
 	u32 ix;
 
-	kfree(work);
-
-	mutex_lock(&mtx);
-
 	BUG_ON(comp->state == DSSCOMP_STATE_ACTIVE);
 	ix = comp->ix;
 
@@ -424,40 +533,178 @@ static void dsscomp_mgr_delayed_cb(struct work_struct *work)
 		log_event(20 * comp->ix + 20, 0, comp, "%pf on %s",
 				(u32) dsscomp_mgr_delayed_cb,
 				(u32) log_status_str(status));
+		DO_IF_FRAME_STATS(dsscomp_frame_record(comp));
 		dsscomp_drop(comp);
+		return true;
 	}
+	return false;
+}
+
+/* statuses accumulate in cb_status, so handle them in their DSS order */
+static void dsscomp_mgr_delayed_cb(struct work_struct *work)
+{
+	struct dsscomp_data *comp = container_of(work, typeof(*comp), cb_work);
+	unsigned long flags;
+	u32 status;
+
+	spin_lock_irqsave(&cb_lock, flags);
+	status = comp->cb_status;
+	comp->cb_status = 0;
+	spin_unlock_irqrestore(&cb_lock, flags);
+
+	mutex_lock(&mtx);
+	if ((status & DSS_COMPLETION_PROGRAMMED) &&
+	    dsscomp_mgr_complete(comp, DSS_COMPLETION_PROGRAMMED))
+		goto done;
+	if ((status & DSS_COMPLETION_DISPLAYED) &&
+	    dsscomp_mgr_complete(comp, DSS_COMPLETION_DISPLAYED))
+		goto done;
+	if (status & DSS_COMPLETION_RELEASED)
+		dsscomp_mgr_complete(comp, status & DSS_COMPLETION_RELEASED);
+done:
 	mutex_unlock(&mtx);
 }
 
+/*
+ * Called by DSS, mostly from the DISPC vsync interrupt.  The apply fence
+ * is signalled right here so that the next composition can be put in the
+ * DSS cache before the following vsync; the bookkeeping that needs mtx
+ * is left to cb_work.
+ */
 static u32 dsscomp_mgr_callback(void *data, int id, int status)
 {
 	struct dsscomp_data *comp = data;
+	unsigned long flags;
 	u32 mask = ~0;
 
+	trace_dsscomp_status(comp->frm.mgr.ix, comp->frm.sync_id, status);
+
 	if (status == DSS_COMPLETION_PROGRAMMED && comp->blank)
 		mask = 0;
 
+#ifdef CONFIG_DSSCOMP_FRAME_STATS
+	if (status == DSS_COMPLETION_PROGRAMMED) {
+		struct omap_overlay_manager *mgr = cdev->mgrs[comp->ix];
+
+		frame_stamp(&comp->times.latched);
+		if (mgr && mgr->get_go_time)
+			comp->times.go = mgr->get_go_time(mgr);
+	} else if (status == DSS_COMPLETION_DISPLAYED &&
+		   !comp->times.displayed.tv64) {
+		frame_stamp(&comp->times.displayed);
+	}
+#endif
+
+	spin_lock_irqsave(&cb_lock, flags);
+	if (comp->fenced && (status == DSS_COMPLETION_PROGRAMMED ||
+			     (status & DSS_COMPLETION_RELEASED))) {
+		comp->fenced = false;
+		mgrq[comp->ix].inflight--;
+		wake_up(&mgrq[comp->ix].fence_wq);
+	}
+
 	if (status == DSS_COMPLETION_PROGRAMMED ||
 	    (status == DSS_COMPLETION_DISPLAYED &&
 	     comp->state != DSSCOMP_STATE_DISPLAYED) ||
 	    (status & DSS_COMPLETION_RELEASED)) {
-		struct dsscomp_cb_work *wk = kzalloc(sizeof(*wk), GFP_ATOMIC);
-		wk->comp = comp;
-		wk->status = status;
-		INIT_WORK(&wk->work, dsscomp_mgr_delayed_cb);
-		queue_work(cb_wkq, &wk->work);
+		comp->cb_status |= status;
+		queue_work(cb_wkq, &comp->cb_work);
 	}
+	spin_unlock_irqrestore(&cb_lock, flags);
 
 	/* get each callback only once */
 	return ~status & mask;
 }
 
+/*
+ * Wait for a free slot in the manager's pipeline.  Gives up after a
+ * while, e.g. if the display stopped, in which case the composition
+ * simply eclipses the one in the cache.
+ */
+static void dsscomp_fence_wait(dsscomp_t comp)
+{
+	u32 ix = comp->ix;
+	unsigned long flags;
+
+	wait_event_timeout(mgrq[ix].fence_wq,
+			   mgrq[ix].inflight < DSSCOMP_FENCE_DEPTH ||
+			   mgrq[ix].blanking, DSSCOMP_FENCE_TIMEOUT);
+
+	spin_lock_irqsave(&cb_lock, flags);
+	mgrq[ix].inflight++;
+	comp->fenced = true;
+	spin_unlock_irqrestore(&cb_lock, flags);
+}
+
 static inline bool dssdev_manually_updated(struct omap_dss_device *dev)
 {
 	return dev->caps & OMAP_DSS_DISPLAY_CAP_MANUAL_UPDATE &&
 		dev->driver->get_update_mode(dev) != OMAP_DSS_UPDATE_AUTO;
 }
 
+/* Locking: mtx */
+static void dsscomp_set_lp_fetch(struct omap_overlay_manager *mgr,
+				 bool enable)
+{
+	u32 ix = mgr->id;
+
+	if (!lp_fetch_ms)
+		enable = false;
+	if (mgrq[ix].lp_fetch == enable || !mgr->set_lp_fetch)
+		return;
+	if (!mgr->set_lp_fetch(mgr, enable))
+		mgrq[ix].lp_fetch = enable;
+}
+
+static void dsscomp_lp_work(struct work_struct *work)
+{
+	u32 ix = container_of(work, typeof(mgrq[0]), lp_work.work) - mgrq;
+	struct omap_overlay_manager *mgr = cdev->mgrs[ix];
+
+	mutex_lock(&mtx);
+	/* no new composition for a while: the screen is static */
+	if (mgr && mgr->device && !mgrq[ix].blanking &&
+	    time_after_eq(jiffies, mgrq[ix].last_apply +
+			  msecs_to_jiffies(lp_fetch_ms)))
+		dsscomp_set_lp_fetch(mgr, true);
+	mutex_unlock(&mtx);
+}
+
+/*
+ * Pick the fetch mode for a composition just applied: low power for
+ * video only, latency safe otherwise until the screen settles.
+ *
+ * Locking: mtx
+ */
+static void dsscomp_fetch_policy(dsscomp_t comp,
+				 struct omap_overlay_manager *mgr)
+{
+	bool video = false, other = false;
+	u32 oix, ix = mgr->id;
+
+	for (oix = 0; oix < comp->frm.num_ovls; oix++) {
+		struct dss2_ovl_cfg *cfg = &comp->ovls[oix].cfg;
+
+		if (!cfg->enabled)
+			continue;
+		if (cfg->color_mode & (OMAP_DSS_COLOR_NV12 |
+				       OMAP_DSS_COLOR_YUV2 |
+				       OMAP_DSS_COLOR_UYVY))
+			video = true;
+		else
+			other = true;
+	}
+
+	mgrq[ix].last_apply = jiffies;
+	dsscomp_set_lp_fetch(mgr, video && !other);
+
+	if (lp_fetch_ms && other) {
+		cancel_delayed_work(&mgrq[ix].lp_work);
+		queue_delayed_work(cb_wkq, &mgrq[ix].lp_work,
+				   msecs_to_jiffies(lp_fetch_ms));
+	}
+}
+
 /* apply composition */
 /* at this point the composition is not on any queue */
 static int dsscomp_apply(dsscomp_t comp)
@@ -480,6 +727,7 @@ static int dsscomp_apply(dsscomp_t comp)
 	};
 
 	BUG_ON(comp->state != DSSCOMP_STATE_APPLYING);
+	DO_IF_FRAME_STATS(frame_stamp(&comp->times.apply));
 
 	/* check if the display is valid and used */
 	r = -ENODEV;
@@ -497,6 +745,7 @@ static int dsscomp_apply(dsscomp_t comp)
 		goto done;
 
 	dump_comp_info(cdev, d, "apply");
+	trace_dsscomp_apply(display_ix, d->sync_id, d->num_ovls);
 
 	r = 0;
 	dmask = 0;
@@ -609,6 +858,14 @@ skip_ovl_set:
 	if (!d->win.h && !d->win.y)
 		d->win.h = dssdev->panel.timings.y_res - d->win.y;
 
+	/*
+	 * Auto-update panels are throttled by the fence, not by waiting for
+	 * the vsync here: the DSS vsync interrupt programs the shadow
+	 * registers and sets GO for a composition in its cache.
+	 */
+	if (cb_programmed && !dssdev_manually_updated(dssdev))
+		dsscomp_fence_wait(comp);
+
 	mutex_lock(&mtx);
 	if (mgrq[comp->ix].blanking) {
 		pr_info_ratelimited("ignoring apply mgr(%s) while blanking\n",
@@ -621,6 +878,13 @@ skip_ovl_set:
 		/* keep error if set_mgr_info failed */
 		if (!r && !cb_programmed)
 			r = -EINVAL;
+		if (!r && !dssdev_manually_updated(dssdev))
+			dsscomp_fetch_policy(comp, mgr);
+		DO_IF_FRAME_STATS({
+			frame_stamp(&comp->times.applied);
+			frame_stats[comp->ix].period_us =
+				dsscomp_frame_period_us(dssdev);
+		});
 	}
 	mutex_unlock(&mtx);
 
@@ -641,8 +905,9 @@ skip_ovl_set:
 	if (comp->must_apply && r)
 		mgr->blank(mgr, true);
 
-	if (!r && (d->mode & DSSCOMP_SETUP_MODE_DISPLAY)) {
-		if (dssdev_manually_updated(dssdev) && drv->update) {
+	if (!r && (d->mode & DSSCOMP_SETUP_MODE_DISPLAY) &&
+	    dssdev_manually_updated(dssdev)) {
+		if (drv->update) {
 			r = drv->update(dssdev, d->win.x,
 					d->win.y, d->win.w, d->win.h);
 			if (r) {
@@ -656,9 +921,6 @@ skip_ovl_set:
 				r = 0;
 			}
 		}
-		else
-			/* wait for sync to do smooth animations */
-			mgr->wait_for_vsync(mgr);
 	}
 
 done:
@@ -681,6 +943,7 @@ int dsscomp_state_notifier(struct notifier_block *nb,
 		if (state == OMAP_DSS_DISPLAY_DISABLED) {
 			mgr->blank(mgr, true);
 			mgrq[mgr->id].blanking = true;
+			wake_up(&mgrq[mgr->id].fence_wq);
 		} else if (state == OMAP_DSS_DISPLAY_ACTIVE) {
 			mgrq[mgr->id].blanking = false;
 		}
@@ -711,6 +974,7 @@ int dsscomp_delayed_apply(dsscomp_t comp)
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 	comp->state = DSSCOMP_STATE_APPLYING;
 	log_state(comp, dsscomp_delayed_apply, 0);
+	DO_IF_FRAME_STATS(frame_stamp(&comp->times.submit));
 
 	if (debug & DEBUG_PHASES)
 		dev_info(DEV(cdev), "[%p] applying\n", comp);
@@ -823,6 +1087,85 @@ void dsscomp_dbg_events(struct seq_file *s)
 #endif
 }
 
+void dsscomp_dbg_frames(struct seq_file *s)
+{
+#ifdef CONFIG_DSSCOMP_FRAME_STATS
+	u32 i, j;
+
+	mutex_lock(&mtx);
+	for (i = 0; i < cdev->num_mgrs; i++) {
+		typeof(frame_stats[0]) *st = &frame_stats[i];
+
+		seq_printf(s, "FRAMES on %s (period %uus)\n", cdev->mgrs[i]->name,
+			   st->period_us);
+		seq_printf(s, "late apply %u, slow setup %u, late go %u, "
+			   "overrun %u, dropped %u\n\n", st->late_apply,
+			   st->slow_setup, st->late_go, st->overrun,
+			   st->dropped);
+		seq_printf(s, "%8s %14s %8s %8s %8s %8s %8s\n", "sync_id",
+			   "submit(us)", "apply", "applied", "go", "latched",
+			   "displ'd");
+		for (j = 0; j < ARRAY_SIZE(st->frames); j++) {
+			struct dsscomp_frame *f = st->frames +
+				(st->ix + j) % ARRAY_SIZE(st->frames);
+
+			if (!f->submit_us)
+				continue;
+			seq_printf(s, "%8u %14lld %8u %8u %8u %8u %8u\n",
+				   f->sync_id, f->submit_us, f->apply,
+				   f->applied, f->go, f->latched,
+				   f->displayed);
+		}
+		seq_printf(s, "\n");
+	}
+	mutex_unlock(&mtx);
+#endif
+}
+
+/*
+ * Freeze every display on the frame it is currently showing, e.g.
+ * before kexec.  Further compositions are ignored, and all pipelines
+ * but GFX are turned off so that nothing is left fetching from
+ * TILER/ION buffers that are about to be reused.
+ *
+ * Never sleeps: returns -EBUSY if dsscomp is in use, and does not wait
+ * for the new configuration to be latched, which happens at the next
+ * VSYNC, long before the next kernel gets to reuse any buffer.
+ */
+int dsscomp_park(void)
+{
+	struct omap_overlay_info info;
+	u32 i;
+
+	if (!cdev)
+		return -ENODEV;
+
+	if (!mutex_trylock(&mtx))
+		return -EBUSY;
+	for (i = 0; i < cdev->num_mgrs; i++)
+		mgrq[i].blanking = true;
+
+	for (i = 0; i < cdev->num_ovls; i++) {
+		struct omap_overlay *ovl = cdev->ovls[i];
+
+		if (ovl->id == OMAP_DSS_GFX)
+			continue;
+		ovl->get_overlay_info(ovl, &info);
+		if (!info.enabled)
+			continue;
+		info.enabled = false;
+		ovl->set_overlay_info(ovl, &info);
+	}
+
+	for (i = 0; i < cdev->num_mgrs; i++)
+		if (cdev->mgrs[i]->device)
+			cdev->mgrs[i]->apply(cdev->mgrs[i]);
+	mutex_unlock(&mtx);
+
+	return 0;
+}
+EXPORT_SYMBOL(dsscomp_park);
+
 /*
  * ===========================================================================
  *		EXIT
@@ -832,6 +1175,8 @@ void dsscomp_queue_exit(void)
 {
 	if (cdev) {
 		int i;
+		for (i = 0; i < cdev->num_mgrs; i++)
+			cancel_delayed_work_sync(&mgrq[i].lp_work);
 		for (i = 0; i < cdev->num_displays; i++)
 			destroy_workqueue(mgrq[i].apply_workq);
 		destroy_workqueue(cb_wkq);
@@ -524,6 +524,12 @@ early_param("vram", omap_vram_early_vram);
 /*
  * Called from map_io. We need to call to this early enough so that we
  * can reserve the fixed SDRAM regions before VM could get hold of them.
+ *
+ * The region is removed from memory rather than just reserved: it is
+ * mapped write-combined by omapfb, and ARMv6+ must not also have it in
+ * the cacheable linear mapping.  This is also why free VRAM cannot be
+ * lent to the page allocator - its pages have no kernel mapping - so
+ * size the carveout to what the framebuffers need (see android-display).
  */
 void __init omap_vram_reserve_sdram_memblock(void)
 {
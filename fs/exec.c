@@ -958,6 +958,7 @@ static int de_thread(struct task_struct *tsk)
 
 		list_replace_rcu(&leader->tasks, &tsk->tasks);
 		list_replace_init(&leader->sibling, &tsk->sibling);
+		lowmem_adj_replace(leader, tsk);
 
 		tsk->group_leader = tsk;
 		leader->group_leader = tsk;
@@ -917,6 +917,8 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
 #define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Initialize uninitialized itables */
 
+#define EXT4_MOUNT2_FAST_FSYNC		0x00000001 /* fsync skips time-only commits */
+
 #define clear_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt &= \
 						~EXT4_MOUNT_##opt
 #define set_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt |= \
@@ -1171,6 +1173,9 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_async_discard;
+	unsigned int s_mb_discard_max_blocks;
+	unsigned int s_mb_discard_interval;	/* ms */
 	unsigned int s_max_writeback_mb_bump;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
@@ -1192,6 +1197,11 @@ struct ext4_sb_info {
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
 
+	/* committed frees waiting for their discard, under s_md_lock */
+	struct list_head s_discard_list;
+	struct delayed_work s_discard_work;
+	struct super_block *s_sb;
+
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
 
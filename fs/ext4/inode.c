@@ -5142,6 +5142,7 @@ static int ext4_do_update_inode(handle_t *handle,
 	struct ext4_inode_info *ei = EXT4_I(inode);
 	struct buffer_head *bh = iloc->bh;
 	int err = 0, rc, block;
+	int need_datasync = 0;
 
 	/* For fields not not tracking in the in-memory inode,
 	 * initialise them to zero for new inodes. */
@@ -5190,7 +5191,10 @@ static int ext4_do_update_inode(handle_t *handle,
 		raw_inode->i_file_acl_high =
 			cpu_to_le16(ei->i_file_acl >> 32);
 	raw_inode->i_file_acl_lo = cpu_to_le32(ei->i_file_acl);
-	ext4_isize_set(raw_inode, ei->i_disksize);
+	if (ei->i_disksize != ext4_isize(raw_inode)) {
+		ext4_isize_set(raw_inode, ei->i_disksize);
+		need_datasync = 1;
+	}
 	if (ei->i_disksize > 0x7fffffffULL) {
 		struct super_block *sb = inode->i_sb;
 		if (!EXT4_HAS_RO_COMPAT_FEATURE(sb,
@@ -5243,7 +5247,7 @@ static int ext4_do_update_inode(handle_t *handle,
 		err = rc;
 	ext4_clear_inode_state(inode, EXT4_STATE_NEW);
 
-	ext4_update_inode_fsync_trans(handle, inode, 0);
+	ext4_update_inode_fsync_trans(handle, inode, need_datasync);
 out_brelse:
 	brelse(bh);
 	ext4_std_error(inode->i_sb, err);
@@ -5770,14 +5774,29 @@ int ext4_mark_inode_dirty(handle_t *handle, struct inode *inode)
  */
 void ext4_dirty_inode(struct inode *inode, int flags)
 {
+	struct ext4_inode_info *ei = EXT4_I(inode);
 	handle_t *handle;
+	tid_t sync_tid, datasync_tid;
 
 	handle = ext4_journal_start(inode, 2);
 	if (IS_ERR(handle))
 		goto out;
 
+	sync_tid = ei->i_sync_tid;
+	datasync_tid = ei->i_datasync_tid;
+
 	ext4_mark_inode_dirty(handle, inode);
 
+	/*
+	 * I_DIRTY_SYNC alone comes from timestamp updates.  With fast_fsync
+	 * an fsync does not wait for the transaction that carries only
+	 * those: it is down to writing the data and one cache flush, and
+	 * the timestamps follow with the next commit.
+	 */
+	if (test_opt2(inode->i_sb, FAST_FSYNC) && flags == I_DIRTY_SYNC &&
+	    ei->i_datasync_tid == datasync_tid)
+		ei->i_sync_tid = sync_tid;
+
 	ext4_journal_stop(handle);
 out:
 	return;
@@ -24,6 +24,7 @@
 #include "mballoc.h"
 #include <linux/debugfs.h>
 #include <linux/slab.h>
+#include <linux/list_sort.h>
 #include <trace/events/ext4.h>
 
 /*
@@ -356,6 +357,8 @@ static void ext4_mb_generate_from_pa(struct super_block *sb, void *bitmap,
 static void ext4_mb_generate_from_freelist(struct super_block *sb, void *bitmap,
 						ext4_group_t group);
 static void release_blocks_on_commit(journal_t *journal, transaction_t *txn);
+static void ext4_mb_discard_work(struct work_struct *work);
+static int ext4_mb_run_discards(struct super_block *sb, unsigned int max);
 
 static inline void *mb_correct_addr_and_bit(int *bit, void *addr)
 {
@@ -2423,6 +2426,9 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	unsigned max;
 	int ret;
 
+	INIT_LIST_HEAD(&sbi->s_discard_list);
+	INIT_DELAYED_WORK(&sbi->s_discard_work, ext4_mb_discard_work);
+
 	i = (sb->s_blocksize_bits + 2) * sizeof(*sbi->s_mb_offsets);
 
 	sbi->s_mb_offsets = kmalloc(i, GFP_KERNEL);
@@ -2472,6 +2478,9 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_async_discard = MB_DEFAULT_ASYNC_DISCARD;
+	sbi->s_mb_discard_max_blocks = MB_DEFAULT_DISCARD_BLOCKS;
+	sbi->s_mb_discard_interval = MB_DEFAULT_DISCARD_INTERVAL;
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -2528,6 +2537,10 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct kmem_cache *cachep = get_groupinfo_cache(sb->s_blocksize_bits);
 
+	/* the journal is gone, nothing queues discards any more */
+	cancel_delayed_work_sync(&sbi->s_discard_work);
+	ext4_mb_run_discards(sb, 0);
+
 	if (sbi->s_group_info) {
 		for (i = 0; i < ngroups; i++) {
 			grinfo = ext4_get_group_info(sb, i);
@@ -2592,57 +2605,159 @@ static inline int ext4_issue_discard(struct super_block *sb,
 	return sb_issue_discard(sb, discard_block, count, GFP_NOFS, 0);
 }
 
+/* put the blocks of a committed free back in the buddy, frees entry */
+static void ext4_mb_release_free_data(struct super_block *sb,
+				      struct ext4_free_data *entry)
+{
+	struct ext4_buddy e4b;
+	struct ext4_group_info *db;
+	int err;
+
+	mb_debug(1, "gonna free %u blocks in group %u (0x%p):",
+		 entry->count, entry->group, entry);
+
+	err = ext4_mb_load_buddy(sb, entry->group, &e4b);
+	/* we expect to find existing buddy because it's pinned */
+	BUG_ON(err != 0);
+
+	db = e4b.bd_info;
+	ext4_lock_group(sb, entry->group);
+	/* Take it out of per group rb tree */
+	rb_erase(&entry->node, &(db->bb_free_root));
+	mb_free_blocks(NULL, &e4b, entry->start_blk, entry->count);
+
+	if (!db->bb_free_root.rb_node) {
+		/* No more items in the per group rb tree
+		 * balance refcounts from ext4_mb_free_metadata()
+		 */
+		page_cache_release(e4b.bd_buddy_page);
+		page_cache_release(e4b.bd_bitmap_page);
+	}
+	ext4_unlock_group(sb, entry->group);
+	kmem_cache_free(ext4_free_ext_cachep, entry);
+	ext4_mb_unload_buddy(&e4b);
+}
+
 /*
  * This function is called by the jbd2 layer once the commit has finished,
  * so we know we can free the blocks that were released with that commit.
+ *
+ * With async discard the extents are left pinned in the per group rb
+ * trees and ext4_mb_discard_work() frees them once discarded: a TRIM
+ * here stalls the commit, and the blocks can't be reused before it.
  */
 static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 {
 	struct super_block *sb = journal->j_private;
-	struct ext4_buddy e4b;
-	struct ext4_group_info *db;
-	int err, count = 0, count2 = 0;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int count = 0, count2 = 0;
 	struct ext4_free_data *entry;
 	struct list_head *l, *ltmp;
 
+	if (test_opt(sb, DISCARD) && sbi->s_mb_async_discard) {
+		if (list_empty(&txn->t_private_list))
+			return;
+		spin_lock(&sbi->s_md_lock);
+		list_splice_tail_init(&txn->t_private_list,
+				      &sbi->s_discard_list);
+		spin_unlock(&sbi->s_md_lock);
+		queue_delayed_work(system_long_wq, &sbi->s_discard_work,
+			msecs_to_jiffies(sbi->s_mb_discard_interval));
+		return;
+	}
+
 	list_for_each_safe(l, ltmp, &txn->t_private_list) {
 		entry = list_entry(l, struct ext4_free_data, list);
 
-		mb_debug(1, "gonna free %u blocks in group %u (0x%p):",
-			 entry->count, entry->group, entry);
-
 		if (test_opt(sb, DISCARD))
 			ext4_issue_discard(sb, entry->group,
 					   entry->start_blk, entry->count);
 
-		err = ext4_mb_load_buddy(sb, entry->group, &e4b);
-		/* we expect to find existing buddy because it's pinned */
-		BUG_ON(err != 0);
-
-		db = e4b.bd_info;
 		/* there are blocks to put in buddy to make them really free */
 		count += entry->count;
 		count2++;
-		ext4_lock_group(sb, entry->group);
-		/* Take it out of per group rb tree */
-		rb_erase(&entry->node, &(db->bb_free_root));
-		mb_free_blocks(NULL, &e4b, entry->start_blk, entry->count);
-
-		if (!db->bb_free_root.rb_node) {
-			/* No more items in the per group rb tree
-			 * balance refcounts from ext4_mb_free_metadata()
-			 */
-			page_cache_release(e4b.bd_buddy_page);
-			page_cache_release(e4b.bd_bitmap_page);
-		}
-		ext4_unlock_group(sb, entry->group);
-		kmem_cache_free(ext4_free_ext_cachep, entry);
-		ext4_mb_unload_buddy(&e4b);
+		ext4_mb_release_free_data(sb, entry);
 	}
 
 	mb_debug(1, "freed %u blocks in %u structures\n", count, count2);
 }
 
+static int ext4_free_data_cmp(void *priv, struct list_head *a,
+			      struct list_head *b)
+{
+	struct ext4_free_data *fa = list_entry(a, struct ext4_free_data, list);
+	struct ext4_free_data *fb = list_entry(b, struct ext4_free_data, list);
+
+	if (fa->group != fb->group)
+		return fa->group < fb->group ? -1 : 1;
+	return fa->start_blk - fb->start_blk;
+}
+
+/*
+ * Discard and free up to max blocks (all for 0) of the committed frees,
+ * adjacent extents in one go.  Returns the number of blocks freed.
+ */
+static int ext4_mb_run_discards(struct super_block *sb, unsigned int max)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_free_data *entry, *tmp;
+	ext4_group_t group = 0;
+	ext4_grpblk_t start = 0, count = 0;
+	unsigned int total = 0;
+	LIST_HEAD(batch);
+
+	spin_lock(&sbi->s_md_lock);
+	list_for_each_entry_safe(entry, tmp, &sbi->s_discard_list, list) {
+		if (max && total >= max)
+			break;
+		total += entry->count;
+		list_move_tail(&entry->list, &batch);
+	}
+	spin_unlock(&sbi->s_md_lock);
+
+	if (list_empty(&batch))
+		return 0;
+
+	list_sort(NULL, &batch, ext4_free_data_cmp);
+	list_for_each_entry(entry, &batch, list) {
+		if (count && entry->group == group &&
+		    entry->start_blk == start + count) {
+			count += entry->count;
+			continue;
+		}
+		if (count)
+			ext4_issue_discard(sb, group, start, count);
+		group = entry->group;
+		start = entry->start_blk;
+		count = entry->count;
+	}
+	ext4_issue_discard(sb, group, start, count);
+
+	list_for_each_entry_safe(entry, tmp, &batch, list)
+		ext4_mb_release_free_data(sb, entry);
+
+	mb_debug(1, "discarded %u blocks\n", total);
+	return total;
+}
+
+/* discards go when the disk is idle, a batch per interval */
+static void ext4_mb_discard_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(to_delayed_work(work),
+						struct ext4_sb_info,
+						s_discard_work);
+	struct super_block *sb = sbi->s_sb;
+
+	if (!part_in_flight(&sb->s_bdev->bd_disk->part0))
+		ext4_mb_run_discards(sb, sbi->s_mb_discard_max_blocks ? : 1);
+
+	spin_lock(&sbi->s_md_lock);
+	if (!list_empty(&sbi->s_discard_list))
+		queue_delayed_work(system_long_wq, &sbi->s_discard_work,
+			msecs_to_jiffies(sbi->s_mb_discard_interval));
+	spin_unlock(&sbi->s_md_lock);
+}
+
 #ifdef CONFIG_EXT4_DEBUG
 u8 mb_enable_debug __read_mostly;
 
@@ -4317,6 +4432,9 @@ repeat:
 		}
 	} else {
 		freed  = ext4_mb_discard_preallocations(sb, ac->ac_o_ex.fe_len);
+		/* committed frees still waiting for their discard */
+		if (!freed)
+			freed = ext4_mb_run_discards(sb, 0);
 		if (freed)
 			goto repeat;
 		*errp = -ENOSPC;
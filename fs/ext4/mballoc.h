@@ -94,6 +94,15 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * with the discard mount option, freed extents are discarded from a
+ * work when the device is idle, at most MB_DEFAULT_DISCARD_BLOCKS each
+ * MB_DEFAULT_DISCARD_INTERVAL ms
+ */
+#define MB_DEFAULT_ASYNC_DISCARD	1
+#define MB_DEFAULT_DISCARD_BLOCKS	8192
+#define MB_DEFAULT_DISCARD_INTERVAL	100
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
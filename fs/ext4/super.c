@@ -1102,6 +1102,9 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DISCARD) && !(def_mount_opts & EXT4_DEFM_DISCARD))
 		seq_puts(seq, ",discard");
 
+	if (test_opt2(sb, FAST_FSYNC))
+		seq_puts(seq, ",fast_fsync");
+
 	if (test_opt(sb, NOLOAD))
 		seq_puts(seq, ",norecovery");
 
@@ -1292,6 +1295,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_fast_fsync, Opt_nofast_fsync,
 };
 
 static const match_table_t tokens = {
@@ -1367,6 +1371,8 @@ static const match_table_t tokens = {
 	{Opt_init_itable, "init_itable=%u"},
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
+	{Opt_fast_fsync, "fast_fsync"},
+	{Opt_nofast_fsync, "nofast_fsync"},
 	{Opt_err, NULL},
 };
 
@@ -1837,6 +1843,12 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sb, DISCARD);
 			break;
+		case Opt_fast_fsync:
+			set_opt2(sb, FAST_FSYNC);
+			break;
+		case Opt_nofast_fsync:
+			clear_opt2(sb, FAST_FSYNC);
+			break;
 		case Opt_dioread_nolock:
 			set_opt(sb, DIOREAD_NOLOCK);
 			break;
@@ -2529,6 +2541,9 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_async_discard, s_mb_async_discard);
+EXT4_RW_ATTR_SBI_UI(mb_discard_max_blocks, s_mb_discard_max_blocks);
+EXT4_RW_ATTR_SBI_UI(mb_discard_interval_ms, s_mb_discard_interval);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2545,6 +2560,9 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_async_discard),
+	ATTR_LIST(mb_discard_max_blocks),
+	ATTR_LIST(mb_discard_interval_ms),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -3074,6 +3092,7 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 		goto out_free_orig;
 	}
 	sb->s_fs_info = sbi;
+	sbi->s_sb = sb;
 	sbi->s_mount_opt = 0;
 	sbi->s_resuid = EXT4_DEF_RESUID;
 	sbi->s_resgid = EXT4_DEF_RESGID;
@@ -7,6 +7,8 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/bitmap.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -452,6 +454,45 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/* make the free entry the new end of the chain, after prev_ent if any */
+static void fat_alloc_ent(struct super_block *sb, struct fat_entry *fatent,
+			  struct fat_entry *prev_ent,
+			  struct buffer_head **bhs, int *nr_bhs)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	int entry = fatent->entry;
+
+	ops->ent_put(fatent, FAT_ENT_EOF);
+	if (prev_ent->nr_bhs)
+		ops->ent_put(prev_ent, entry);
+
+	fat_collect_bhs(bhs, nr_bhs, fatent);
+
+	sbi->prev_free = entry;
+	if (sbi->free_clusters != -1)
+		sbi->free_clusters--;
+	if (sbi->free_bitmap)
+		__clear_bit(entry, sbi->free_bitmap);
+	sb->s_dirt = 1;
+}
+
+/* the first free cluster from entry on, wrapping around, or -1 */
+static int fat_find_free(struct msdos_sb_info *sbi, int entry)
+{
+	unsigned long nr;
+
+	if (entry < FAT_START_ENT || entry >= sbi->max_cluster)
+		entry = FAT_START_ENT;
+
+	nr = find_next_bit(sbi->free_bitmap, sbi->max_cluster, entry);
+	if (nr < sbi->max_cluster)
+		return nr;
+
+	nr = find_next_bit(sbi->free_bitmap, entry, FAT_START_ENT);
+	return nr < entry ? nr : -1;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -474,6 +515,34 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
+
+	if (sbi->free_bitmap_ready) {
+		int entry = sbi->prev_free + 1;
+
+		while ((entry = fat_find_free(sbi, entry)) >= 0) {
+			fatent_set_entry(&fatent, entry);
+			err = fat_ent_read_block(sb, &fatent);
+			if (err)
+				goto out;
+
+			if (ops->ent_get(&fatent) != FAT_ENT_FREE) {
+				/* should not happen, don't look at it again */
+				__clear_bit(entry, sbi->free_bitmap);
+				continue;
+			}
+
+			fat_alloc_ent(sb, &fatent, &prev_ent, bhs, &nr_bhs);
+			cluster[idx_clus] = entry;
+			idx_clus++;
+			if (idx_clus == nr_cluster)
+				goto out;
+
+			prev_ent = fatent;
+			entry++;
+		}
+		goto nospc;
+	}
+
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -489,16 +558,8 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 				int entry = fatent.entry;
 
 				/* make the cluster chain */
-				ops->ent_put(&fatent, FAT_ENT_EOF);
-				if (prev_ent.nr_bhs)
-					ops->ent_put(&prev_ent, entry);
-
-				fat_collect_bhs(bhs, &nr_bhs, &fatent);
-
-				sbi->prev_free = entry;
-				if (sbi->free_clusters != -1)
-					sbi->free_clusters--;
-				sb->s_dirt = 1;
+				fat_alloc_ent(sb, &fatent, &prev_ent,
+					      bhs, &nr_bhs);
 
 				cluster[idx_clus] = entry;
 				idx_clus++;
@@ -517,6 +578,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
@@ -589,6 +651,8 @@ int fat_free_clusters(struct inode *inode, int cluster)
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
 		}
+		if (sbi->free_bitmap)
+			__set_bit(fatent.entry, sbi->free_bitmap);
 
 		if (nr_bhs + fatent.nr_bhs > MAX_BUF_PER_PAGE) {
 			if (sb->s_flags & MS_SYNCHRONOUS) {
@@ -647,6 +711,10 @@ int fat_count_free_clusters(struct super_block *sb)
 	unsigned long reada_blocks, reada_mask, cur_block;
 	int err = 0, free;
 
+	/* the background scan counts them too, don't do it twice */
+	if (sbi->free_bitmap)
+		flush_work(&sbi->free_scan_work);
+
 	lock_fat(sbi);
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
@@ -683,3 +751,90 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+/*
+ * Build the free cluster bitmap in the background after mount, one FAT
+ * block at a time under fat_lock.  Allocation and freeing keep the bits
+ * of every cluster they touch up to date, scanned yet or not, so once the
+ * scan is through the bitmap can be searched instead of the FAT, and it
+ * gives the free count as well.
+ */
+static void fat_free_scan(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi = container_of(work, struct msdos_sb_info,
+						 free_scan_work);
+	struct super_block *sb = sbi->fat_inode->i_sb;
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, reada_mask, cur_block;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster) {
+		if (ACCESS_ONCE(sbi->free_scan_abort))
+			goto out;
+
+		/* readahead of fat blocks */
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		lock_fat(sbi);
+		if (fat_ent_read_block(sb, &fatent)) {
+			unlock_fat(sbi);
+			goto out;
+		}
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE)
+				__set_bit(fatent.entry, sbi->free_bitmap);
+			else
+				__clear_bit(fatent.entry, sbi->free_bitmap);
+		} while (fat_ent_next(sbi, &fatent));
+		unlock_fat(sbi);
+
+		cond_resched();
+	}
+
+	lock_fat(sbi);
+	sbi->free_clusters = bitmap_weight(sbi->free_bitmap, sbi->max_cluster);
+	sbi->free_clus_valid = 1;
+	sbi->free_bitmap_ready = 1;
+	sb->s_dirt = 1;
+	unlock_fat(sbi);
+out:
+	fatent_brelse(&fatent);
+}
+
+void fat_free_bitmap_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	/* without it we simply keep searching the FAT */
+	sbi->free_bitmap = vzalloc(BITS_TO_LONGS(sbi->max_cluster) *
+				   sizeof(unsigned long));
+	if (!sbi->free_bitmap)
+		return;
+
+	INIT_WORK(&sbi->free_scan_work, fat_free_scan);
+	queue_work(system_long_wq, &sbi->free_scan_work);
+}
+
+void fat_free_bitmap_destroy(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	if (!sbi->free_bitmap)
+		return;
+
+	sbi->free_scan_abort = 1;
+	cancel_work_sync(&sbi->free_scan_work);
+	vfree(sbi->free_bitmap);
+	sbi->free_bitmap = NULL;
+	sbi->free_bitmap_ready = 0;
+}
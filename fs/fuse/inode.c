@@ -47,6 +47,12 @@ MODULE_PARM_DESC(max_user_congthresh,
  "Global limit for the maximum congestion threshold an "
  "unprivileged user can set");
 
+static bool big_writes = 1;
+module_param(big_writes, bool, 0644);
+MODULE_PARM_DESC(big_writes,
+ "Send writes of up to max_write bytes even to filesystems that did "
+ "not ask for FUSE_BIG_WRITES");
+
 #define FUSE_SUPER_MAGIC 0x65735546
 
 #define FUSE_DEFAULT_BLKSIZE 512
@@ -829,6 +835,13 @@ static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 		fc->minor = arg->minor;
 		fc->max_write = arg->minor < 5 ? 4096 : arg->max_write;
 		fc->max_write = max_t(unsigned, 4096, fc->max_write);
+		/*
+		 * The flag only works around old kernels ignoring max_write:
+		 * the filesystem said it takes that much, e.g. 128KB for
+		 * libfuse, so don't split its writes in single pages.
+		 */
+		if (big_writes && fc->max_write > PAGE_CACHE_SIZE)
+			fc->big_writes = 1;
 		fc->conn_init = 1;
 	}
 	fc->blocked = 0;
@@ -0,0 +1,136 @@
+/*
+ * Persistent Storage - function tracer.
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/compiler.h>
+#include <linux/irqflags.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/atomic.h>
+#include <linux/ftrace.h>
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/mutex.h>
+#include <linux/pstore.h>
+#include <linux/uaccess.h>
+
+#include "internal.h"
+
+/* the backend's write_buf is traced as well, don't trace ourselves */
+static DEFINE_PER_CPU(int, pstore_ftrace_busy);
+
+static void notrace pstore_ftrace_call(unsigned long ip,
+				       unsigned long parent_ip)
+{
+	struct pstore_ftrace_record rec;
+	unsigned long flags;
+	int *busy;
+
+	if (unlikely(oops_in_progress))
+		return;
+
+	raw_local_irq_save(flags);
+
+	busy = &__get_cpu_var(pstore_ftrace_busy);
+	if (!*busy) {
+		(*busy)++;
+		rec.ip = ip;
+		rec.parent_ip = parent_ip;
+		rec.cpu = raw_smp_processor_id();
+		psinfo->write_buf(PSTORE_TYPE_FTRACE, (const char *)&rec,
+				  sizeof(rec));
+		(*busy)--;
+	}
+
+	raw_local_irq_restore(flags);
+}
+
+static struct ftrace_ops pstore_ftrace_ops __read_mostly = {
+	.func	= pstore_ftrace_call,
+};
+
+static DEFINE_MUTEX(pstore_ftrace_lock);
+static bool pstore_ftrace_enabled;
+
+static ssize_t pstore_ftrace_knob_write(struct file *f, const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	u8 on;
+	ssize_t ret;
+
+	ret = kstrtou8_from_user(buf, count, 2, &on);
+	if (ret)
+		return ret;
+
+	mutex_lock(&pstore_ftrace_lock);
+
+	if (!on == !pstore_ftrace_enabled)
+		goto out;
+
+	if (on)
+		ret = register_ftrace_function(&pstore_ftrace_ops);
+	else
+		ret = unregister_ftrace_function(&pstore_ftrace_ops);
+	if (ret) {
+		pr_err("%s: unable to %sregister ftrace ops: %zd\n",
+		       __func__, on ? "" : "un", ret);
+		goto err;
+	}
+
+	pstore_ftrace_enabled = on;
+out:
+	ret = count;
+err:
+	mutex_unlock(&pstore_ftrace_lock);
+
+	return ret;
+}
+
+static ssize_t pstore_ftrace_knob_read(struct file *f, char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	char val[] = { '0' + pstore_ftrace_enabled, '\n' };
+
+	return simple_read_from_buffer(buf, count, ppos, val, sizeof(val));
+}
+
+static const struct file_operations pstore_knob_fops = {
+	.read	= pstore_ftrace_knob_read,
+	.write	= pstore_ftrace_knob_write,
+	.llseek	= default_llseek,
+};
+
+void pstore_register_ftrace(void)
+{
+	struct dentry *dir;
+	struct dentry *file;
+
+	if (!psinfo->write_buf)
+		return;
+
+	dir = debugfs_create_dir("pstore", NULL);
+	if (IS_ERR_OR_NULL(dir)) {
+		pr_err("%s: unable to create pstore directory\n", __func__);
+		return;
+	}
+
+	file = debugfs_create_file("record_ftrace", 0600, dir, NULL,
+				   &pstore_knob_fops);
+	if (IS_ERR_OR_NULL(file)) {
+		pr_err("%s: unable to create record_ftrace file\n", __func__);
+		debugfs_remove(dir);
+	}
+}
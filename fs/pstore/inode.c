@@ -31,6 +31,7 @@
 #include <linux/sched.h>
 #include <linux/magic.h>
 #include <linux/pstore.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 
@@ -41,13 +42,67 @@
 struct pstore_private {
 	u64	id;
 	int	(*erase)(u64);
+	enum pstore_type_id type;
 	ssize_t	size;
 	char	data[];
 };
 
+/* ftrace records are kept binary and only turned into text when read */
+#define FTRACE_REC_SIZE	sizeof(struct pstore_ftrace_record)
+
+static void *pstore_ftrace_seq_start(struct seq_file *s, loff_t *pos)
+{
+	struct pstore_private *ps = s->private;
+	/* a wrapped ring may start with the tail of a record */
+	size_t off = ps->size % FTRACE_REC_SIZE + *pos * FTRACE_REC_SIZE;
+
+	if (off + FTRACE_REC_SIZE > ps->size)
+		return NULL;
+	return ps->data + off;
+}
+
+static void *pstore_ftrace_seq_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	(*pos)++;
+	return pstore_ftrace_seq_start(s, pos);
+}
+
+static void pstore_ftrace_seq_stop(struct seq_file *s, void *v)
+{
+}
+
+static int pstore_ftrace_seq_show(struct seq_file *s, void *v)
+{
+	struct pstore_ftrace_record rec;
+
+	memcpy(&rec, v, sizeof(rec));
+	seq_printf(s, "%u %08lx  %08lx  %pf <- %pF\n", rec.cpu,
+		   rec.ip, rec.parent_ip, (void *)rec.ip,
+		   (void *)rec.parent_ip);
+	return 0;
+}
+
+static const struct seq_operations pstore_ftrace_seq_ops = {
+	.start	= pstore_ftrace_seq_start,
+	.next	= pstore_ftrace_seq_next,
+	.stop	= pstore_ftrace_seq_stop,
+	.show	= pstore_ftrace_seq_show,
+};
+
 static int pstore_file_open(struct inode *inode, struct file *file)
 {
-	file->private_data = inode->i_private;
+	struct pstore_private *ps = inode->i_private;
+	int err;
+
+	if (ps->type != PSTORE_TYPE_FTRACE) {
+		file->private_data = ps;
+		return 0;
+	}
+
+	err = seq_open(file, &pstore_ftrace_seq_ops);
+	if (err)
+		return err;
+	((struct seq_file *)file->private_data)->private = ps;
 	return 0;
 }
 
@@ -59,10 +114,27 @@ static ssize_t pstore_file_read(struct file *file, char __user *userbuf,
 	return simple_read_from_buffer(userbuf, count, ppos, ps->data, ps->size);
 }
 
+static int pstore_file_release(struct inode *inode, struct file *file)
+{
+	struct pstore_private *ps = inode->i_private;
+
+	if (ps->type == PSTORE_TYPE_FTRACE)
+		return seq_release(inode, file);
+	return 0;
+}
+
 static const struct file_operations pstore_file_operations = {
 	.open	= pstore_file_open,
 	.read	= pstore_file_read,
 	.llseek	= default_llseek,
+	.release = pstore_file_release,
+};
+
+static const struct file_operations pstore_ftrace_file_operations = {
+	.open	= pstore_file_open,
+	.read	= seq_read,
+	.llseek	= seq_lseek,
+	.release = pstore_file_release,
 };
 
 /*
@@ -194,6 +266,9 @@ int pstore_mkfile(enum pstore_type_id type, char *psname, u64 id,
 		goto fail_alloc;
 	private->id = id;
 	private->erase = erase;
+	private->type = type;
+	if (type == PSTORE_TYPE_FTRACE)
+		inode->i_fop = &pstore_ftrace_file_operations;
 
 	switch (type) {
 	case PSTORE_TYPE_DMESG:
@@ -202,6 +277,12 @@ int pstore_mkfile(enum pstore_type_id type, char *psname, u64 id,
 	case PSTORE_TYPE_MCE:
 		sprintf(name, "mce-%s-%lld", psname, id);
 		break;
+	case PSTORE_TYPE_CONSOLE:
+		sprintf(name, "console-%s-%lld", psname, id);
+		break;
+	case PSTORE_TYPE_FTRACE:
+		sprintf(name, "ftrace-%s-%lld", psname, id);
+		break;
 	case PSTORE_TYPE_UNKNOWN:
 		sprintf(name, "unknown-%s-%lld", psname, id);
 		break;
@@ -301,9 +382,22 @@ static struct file_system_type pstore_fs_type = {
 	.kill_sb	= pstore_kill_sb,
 };
 
+static struct kobject *pstore_kobj;
+
 static int __init init_pstore_fs(void)
 {
-	return register_filesystem(&pstore_fs_type);
+	int err;
+
+	/* a place to mount us: /sys/fs/pstore */
+	pstore_kobj = kobject_create_and_add("pstore", fs_kobj);
+	if (!pstore_kobj)
+		return -ENOMEM;
+
+	err = register_filesystem(&pstore_fs_type);
+	if (err < 0)
+		kobject_put(pstore_kobj);
+
+	return err;
 }
 module_init(init_pstore_fs)
 
@@ -1,3 +1,17 @@
+struct pstore_ftrace_record {
+	unsigned long	ip;
+	unsigned long	parent_ip;
+	unsigned int	cpu;
+};
+
+#ifdef CONFIG_PSTORE_FTRACE
+extern void	pstore_register_ftrace(void);
+#else
+static inline void pstore_register_ftrace(void) {}
+#endif
+
+extern struct pstore_info *psinfo;
+
 extern void	pstore_set_kmsg_bytes(int);
 extern void	pstore_get_records(void);
 extern int	pstore_mkfile(enum pstore_type_id, char *psname, u64 id,
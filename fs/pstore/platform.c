@@ -35,7 +35,7 @@
  * calls to pstore_register()
  */
 static DEFINE_SPINLOCK(pstore_lock);
-static struct pstore_info *psinfo;
+struct pstore_info *psinfo;
 
 /* How much of the console log to snapshot */
 static unsigned long kmsg_bytes = 10240;
@@ -140,6 +140,7 @@ int pstore_register(struct pstore_info *psi)
 		pstore_get_records();
 
 	kmsg_dump_register(&pstore_dumper);
+	pstore_register_ftrace();
 
 	return 0;
 }
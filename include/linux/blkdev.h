@@ -123,9 +123,12 @@ struct request {
 	struct gendisk *rq_disk;
 	struct hd_struct *part;
 	unsigned long start_time;
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_LATENCY_HIST
+	unsigned int dispatch_bytes;	/* size when first passed to hardware */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -260,6 +263,34 @@ struct queue_limits {
 	unsigned char		discard_zeroes_data;
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * Latencies of fs requests: allocation to first dispatch (queue) and
+ * dispatch to completion (service), per direction and size class.
+ * Bucket 0 counts those below 1 << BLK_LAT_HIST_SHIFT us, each next one
+ * covers twice the range, the last one everything above.
+ */
+#define BLK_LAT_HIST_BUCKETS	14
+#define BLK_LAT_HIST_SHIFT	7
+
+enum {
+	BLK_LAT_QUEUE,
+	BLK_LAT_SERVICE,
+	BLK_LAT_NR,
+};
+
+enum {
+	BLK_LAT_SIZE_4K,	/* up to 4KB */
+	BLK_LAT_SIZE_64K,	/* up to 64KB */
+	BLK_LAT_SIZE_LARGE,
+	BLK_LAT_SIZE_NR,
+};
+
+struct blk_latency_hist {
+	unsigned long count[BLK_LAT_NR][2][BLK_LAT_SIZE_NR][BLK_LAT_HIST_BUCKETS];
+};
+#endif
+
 struct request_queue
 {
 	/*
@@ -383,6 +414,10 @@ struct request_queue
 	/* Throttle data */
 	struct throtl_data *td;
 #endif
+#ifdef CONFIG_BLK_LATENCY_HIST
+	/* protected by queue_lock */
+	struct blk_latency_hist lat_hist;
+#endif
 };
 
 #define QUEUE_FLAG_QUEUED	1	/* uses generic tag queueing */
@@ -1134,7 +1169,7 @@ static inline void put_dev_sector(Sector p)
 struct work_struct;
 int kblockd_schedule_work(struct request_queue *q, struct work_struct *work);
 
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 /*
  * This should not be using sched_clock(). A real patch is in progress
  * to fix this up, until that is in place we need to disable preemption
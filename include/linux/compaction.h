@@ -16,6 +16,9 @@ extern int sysctl_compact_memory;
 extern int sysctl_compaction_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
 extern int sysctl_extfrag_threshold;
+extern int sysctl_compact_proactive_order;
+extern int sysctl_compact_proactive_target;
+extern int sysctl_compact_proactive_secs;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
 
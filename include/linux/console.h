@@ -110,6 +110,7 @@ int con_debug_leave(void);
 #define CON_BOOT	(8)
 #define CON_ANYTIME	(16) /* Safe to call when cpu is offline */
 #define CON_BRL		(32) /* Used for a braille device */
+#define CON_FAST	(64) /* Cheap to write, stays synchronous with printk.async */
 
 struct console {
 	char	name[16];
@@ -130,6 +130,17 @@ struct cpufreq_freqs {
 	unsigned int old;
 	unsigned int new;
 	u8 flags;		/* flags of cpufreq_driver, see below. */
+	/*
+	 * Transition timing in us, valid at CPUFREQ_POSTCHANGE.  The core
+	 * fills in the time from the governor's cpufreq_mark_decision() to
+	 * PRECHANGE and from PRECHANGE to POSTCHANGE; drivers that know
+	 * it may report how much of the latter went to voltage scaling
+	 * and to the clock switch.  0 if unknown.
+	 */
+	unsigned int decision_us;
+	unsigned int trans_us;
+	unsigned int volt_us;
+	unsigned int clk_us;
 };
 
 
@@ -253,6 +264,7 @@ int cpufreq_unregister_driver(struct cpufreq_driver *driver_data);
 
 
 void cpufreq_notify_transition(struct cpufreq_freqs *freqs, unsigned int state);
+void cpufreq_mark_decision(struct cpufreq_policy *policy);
 
 
 static inline void cpufreq_verify_within_limits(struct cpufreq_policy *policy, unsigned int min, unsigned int max)
@@ -366,6 +378,23 @@ extern struct cpufreq_governor cpufreq_gov_hotplug;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_hotplug)
 #endif
 
+/* cpufreq_stats: per-UID time in state, see cpufreq-stats.txt */
+struct task_struct;
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+struct cpufreq_uid_stats;
+extern struct cpufreq_uid_stats *cpufreq_uid_stats_get(uid_t uid);
+extern void cpufreq_uid_task_switch(struct task_struct *next);
+#else
+static inline void cpufreq_uid_task_switch(struct task_struct *next) { }
+#endif
+
+/* hotplug governor: online the auxiliary CPU ahead of a boost */
+#ifdef CONFIG_CPU_FREQ_GOV_HOTPLUG
+extern void cpufreq_hotplug_boost(void);
+#else
+static inline void cpufreq_hotplug_boost(void) { }
+#endif
+
 
 /*********************************************************************
  *                     FREQUENCY TABLE HELPERS                       *
@@ -0,0 +1,28 @@
+#ifndef _LINUX_FILE_PREFETCH_H
+#define _LINUX_FILE_PREFETCH_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_FILE_PREFETCH
+extern bool file_prefetch_tracing;
+extern void __file_prefetch_record(struct file *file, pgoff_t index,
+				   unsigned long nr);
+
+/*
+ * Called on page cache misses: while a trace is running, remember that
+ * nr pages of file from index were needed.
+ */
+static inline void file_prefetch_record(struct file *file, pgoff_t index,
+					unsigned long nr)
+{
+	if (unlikely(file_prefetch_tracing))
+		__file_prefetch_record(file, index, nr);
+}
+#else
+static inline void file_prefetch_record(struct file *file, pgoff_t index,
+					unsigned long nr)
+{
+}
+#endif
+
+#endif /* _LINUX_FILE_PREFETCH_H */
@@ -827,6 +827,7 @@ struct input_keymap_entry {
 #define MSC_GESTURE		0x02
 #define MSC_RAW			0x03
 #define MSC_SCAN		0x04
+#define MSC_TIMESTAMP		0x05
 #define MSC_MAX			0x07
 #define MSC_CNT			(MSC_MAX+1)
 
@@ -1134,6 +1135,7 @@ struct ff_effect {
 
 #include <linux/device.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/timer.h>
 #include <linux/mod_devicetable.h>
 
@@ -1214,6 +1216,8 @@ struct ff_effect {
  * @going_away: marks devices that are in a middle of unregistering and
  *	causes input_open_device*() fail with -ENODEV.
  * @sync: set to %true when there were no new events since last EV_SYN
+ * @timestamp: when the events of the current packet happened, as set by
+ *	input_set_timestamp(); cleared by the next SYN_REPORT
  * @dev: driver model's view of this device
  * @h_list: list of input handles associated with the device. When
  *	accessing the list dev->mutex must be held
@@ -1283,6 +1287,8 @@ struct input_dev {
 
 	bool sync;
 
+	ktime_t timestamp;
+
 	struct device dev;
 
 	struct list_head	h_list;
@@ -1511,6 +1517,20 @@ static inline void input_mt_sync(struct input_dev *dev)
 
 void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code);
 
+/**
+ * input_set_timestamp - tell handlers when the current packet happened
+ * @dev: the input device used by the driver
+ * @timestamp: ktime_get() at the interrupt that produced the events
+ *
+ * Handlers stamp the events up to and including the next input_sync()
+ * with @timestamp instead of the time they are delivered, so consumers
+ * see when the hardware reported them.
+ */
+static inline void input_set_timestamp(struct input_dev *dev, ktime_t timestamp)
+{
+	dev->timestamp = timestamp;
+}
+
 /**
  * input_set_events_per_packet - tell handlers about the driver event rate
  * @dev: the input device used by the driver
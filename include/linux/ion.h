@@ -42,6 +42,15 @@ enum ion_heap_type {
 #define ION_HEAP_SYSTEM_CONTIG_MASK	(1 << ION_HEAP_TYPE_SYSTEM_CONTIG)
 #define ION_HEAP_CARVEOUT_MASK		(1 << ION_HEAP_TYPE_CARVEOUT)
 
+/*
+ * Allocation hints, passed in the flags along with the heap mask.  They
+ * sit above any heap id and heaps that do not know them ignore them.
+ * ION_FLAG_LONG_LIVED: the buffer is kept for a long time (a display or
+ * camera pool rather than a per frame buffer); carveout heaps place such
+ * buffers apart from short lived ones.
+ */
+#define ION_FLAG_LONG_LIVED		(1U << 31)
+
 #ifdef __KERNEL__
 struct ion_device;
 struct ion_heap;
@@ -100,6 +100,8 @@ struct kimage {
 #define KEXEC_TYPE_DEFAULT 0
 #define KEXEC_TYPE_CRASH   1
 	unsigned int preserve_context : 1;
+	/* All segments live in kexec_prestage_res, loaded in place */
+	unsigned int prestaged : 1;
 
 #ifdef ARCH_HAS_KIMAGE_ARCH
 	struct kimage_arch arch;
@@ -198,6 +200,7 @@ extern struct kimage *kexec_crash_image;
 /* Location of a reserved region to hold the crash kernel.
  */
 extern struct resource crashk_res;
+extern struct resource kexec_prestage_res;
 typedef u32 note_buf_t[KEXEC_NOTE_BYTES/4];
 extern note_buf_t __percpu *crash_notes;
 extern u32 vmcoreinfo_note[VMCOREINFO_NOTE_SIZE/4];
@@ -216,4 +219,30 @@ struct task_struct;
 static inline void crash_kexec(struct pt_regs *regs) { }
 static inline int kexec_should_crash(struct task_struct *p) { return 0; }
 #endif /* CONFIG_KEXEC */
+
+/*
+ * Points of the kexec reboot path, in order.  The ones up to
+ * KEXEC_TL_RELOCATE are stamped by the old kernel and handed over.
+ */
+enum kexec_timeline_event {
+	KEXEC_TL_KEXEC,			/* kernel_kexec() entered */
+	KEXEC_TL_SHUTDOWN,		/* notifiers and device shutdown done */
+	KEXEC_TL_MACHINE_SHUTDOWN,	/* machine_shutdown() done */
+	KEXEC_TL_RELOCATE,		/* jumping to relocate_new_kernel */
+	KEXEC_TL_DECOMPRESS,		/* decompressor entered */
+	KEXEC_TL_SETUP_ARCH,		/* setup_arch() done */
+	KEXEC_TL_EARLY_INITCALL,	/* initcalls started */
+	KEXEC_TL_LATE_INITCALL,		/* initcalls done */
+	KEXEC_TL_NR,
+};
+
+#ifdef CONFIG_KEXEC_TIMELINE
+extern u32 (*kexec_timeline_clock)(void);
+extern void kexec_timeline_stamp(enum kexec_timeline_event event);
+extern void kexec_timeline_record(enum kexec_timeline_event event, u32 stamp);
+#else
+static inline void kexec_timeline_stamp(enum kexec_timeline_event event) { }
+static inline void kexec_timeline_record(enum kexec_timeline_event event,
+					 u32 stamp) { }
+#endif
 #endif /* LINUX_KEXEC_H */
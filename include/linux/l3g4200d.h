@@ -29,6 +29,9 @@
 #define L3G4200D_IOCTL_GET_DELAY	_IOR(L3G4200D_IOCTL_BASE, 1, int)
 #define L3G4200D_IOCTL_SET_ENABLE	_IOW(L3G4200D_IOCTL_BASE, 2, int)
 #define L3G4200D_IOCTL_GET_ENABLE	_IOR(L3G4200D_IOCTL_BASE, 3, int)
+/* max report latency in ms, samples are batched in the FIFO up to that */
+#define L3G4200D_IOCTL_SET_LATENCY	_IOW(L3G4200D_IOCTL_BASE, 4, int)
+#define L3G4200D_IOCTL_GET_LATENCY	_IOR(L3G4200D_IOCTL_BASE, 5, int)
 
 #ifdef __KERNEL__
 
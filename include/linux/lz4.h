@@ -0,0 +1,52 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+/*
+ *  LZ4 Public Kernel Interface
+ *
+ *  LZ4 is a byte oriented LZ77 coder with no entropy stage, designed
+ *  by Yann Collet: http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#define LZ4_MEM_COMPRESS	(4096 * sizeof(unsigned int))
+
+/*
+ * lz4_compressbound()
+ * Provides the maximum size that LZ4 may output in a "worst case" scenario
+ * (input data not compressible)
+ */
+#define lz4_compressbound(isize)	((isize) + ((isize) / 255) + 16)
+
+/*
+ * lz4_compress()
+ *	src     : source address of the original data
+ *	src_len : size of the original data
+ *	dst	: output buffer address of the compressed data,
+ *		  must be at least lz4_compressbound(src_len) bytes
+ *	dst_len : is the output size, which is returned after compress done
+ *	workmem : address of the working memory,
+ *		  this requires 'workmem' of size LZ4_MEM_COMPRESS
+ *	return  : Success if return 0
+ */
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/*
+ * lz4_decompress()
+ *	src     : source address of the compressed data
+ *	src_len : is the input size, the whole block has to be given
+ *	dst	: output buffer address of the decompressed data
+ *	dst_len : is the size of the destination buffer on input, and the
+ *		  decompressed size on output
+ *	return  : Success if return 0
+ *
+ * Never writes outside the output buffer nor reads outside the input,
+ * so it is safe against malicious data packets.
+ */
+int lz4_decompress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len);
+
+#endif
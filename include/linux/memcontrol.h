@@ -152,6 +152,10 @@ static inline void mem_cgroup_dec_page_stat(struct page *page,
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 						gfp_t gfp_mask,
 						unsigned long *total_scanned);
+unsigned long mem_cgroup_priority_reclaim(struct zone *zone, gfp_t gfp_mask,
+					  bool noswap,
+					  unsigned long nr_to_reclaim,
+					  unsigned long *total_scanned);
 u64 mem_cgroup_get_limit(struct mem_cgroup *mem);
 
 void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx);
@@ -357,6 +361,15 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return 0;
 }
 
+static inline
+unsigned long mem_cgroup_priority_reclaim(struct zone *zone, gfp_t gfp_mask,
+					  bool noswap,
+					  unsigned long nr_to_reclaim,
+					  unsigned long *total_scanned)
+{
+	return 0;
+}
+
 static inline
 u64 mem_cgroup_get_limit(struct mem_cgroup *mem)
 {
@@ -1288,6 +1288,15 @@ static inline void pgtable_page_dtor(struct page *page)
 extern void free_area_init(unsigned long * zones_size);
 extern void free_area_init_node(int nid, unsigned long * zones_size,
 		unsigned long zone_start_pfn, unsigned long *zholes_size);
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+extern bool deferred_free_range(unsigned long start_pfn, unsigned long end_pfn);
+#else
+static inline bool deferred_free_range(unsigned long start_pfn,
+				       unsigned long end_pfn)
+{
+	return false;
+}
+#endif
 #ifdef CONFIG_ARCH_POPULATES_NODE_MAP
 /*
  * With CONFIG_ARCH_POPULATES_NODE_MAP set, an architecture may initialise its
@@ -106,6 +106,8 @@ enum zone_stat_item {
 	NR_SHMEM,		/* shmem pages (included tmpfs/GEM pages) */
 	NR_DIRTIED,		/* page dirtyings since bootup */
 	NR_WRITTEN,		/* page writings since bootup */
+	WORKINGSET_REFAULT,	/* evicted file pages faulting back in */
+	WORKINGSET_ACTIVATE,	/* of which activated on refault */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -176,6 +178,15 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/*
+	 * A few blocks of each order up to PAGE_ALLOC_COSTLY_ORDER are
+	 * kept too, indexed by order - 1. high_order_high is the limit in
+	 * pages for each order, counts are in blocks.
+	 */
+	int high_order_high;
+	int high_order_count[PAGE_ALLOC_COSTLY_ORDER];
+	struct list_head high_order_lists[PAGE_ALLOC_COSTLY_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
@@ -352,6 +363,9 @@ struct zone {
 	/* Zone statistics */
 	atomic_long_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
 
+	/* Evictions and activations, the clock of mm/workingset.c */
+	atomic_long_t		inactive_age;
+
 	/*
 	 * The target ratio of ACTIVE_ANON to INACTIVE_ANON pages on
 	 * this zone's LRU.  Maintained by the pageout code.
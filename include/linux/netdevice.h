@@ -1352,6 +1352,11 @@ struct net_device {
 	int group;
 	/* last jiffy time packcket is send or received over this device */
 	unsigned long last_packet_time;
+	/* TCP buffer profile {default, max} for connections routed over
+	 * this device, zero to use the tcp_rmem/tcp_wmem sysctls
+	 */
+	int tcp_rmem[2];
+	int tcp_wmem[2];
 };
 #define to_net_dev(d) container_of(d, struct net_device, dev)
 
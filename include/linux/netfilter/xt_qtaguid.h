@@ -3,6 +3,8 @@
 
 /* For now we just replace the xt_owner.
  * FIXME: make iptables aware of qtaguid. */
+#include <linux/if.h>
+#include <linux/types.h>
 #include <linux/netfilter/xt_owner.h>
 
 #define XT_QTAGUID_UID    XT_OWNER_UID
@@ -10,4 +12,54 @@
 #define XT_QTAGUID_SOCKET XT_OWNER_SOCKET
 #define xt_qtaguid_match_info xt_owner_match_info
 
+/*
+ * Generic netlink access to the stats in /proc/net/xt_qtaguid/stats.
+ *
+ * A QTAGUID_CMD_GET_STATS dump returns one QTAGUID_ATTR_STATS_RECORD per
+ * {iface, tag, counter set}, and QTAGUID_ATTR_GENERATION in every
+ * message.  The request may carry QTAGUID_ATTR_UID, to only get that
+ * uid's stats, and QTAGUID_ATTR_GENERATION, to only get the stats that
+ * changed since the dump which returned that generation.
+ */
+#define QTAGUID_GENL_NAME	"qtaguid"
+#define QTAGUID_GENL_VERSION	1
+
+enum {
+	QTAGUID_CMD_UNSPEC,
+	QTAGUID_CMD_GET_STATS,
+	__QTAGUID_CMD_MAX,
+};
+#define QTAGUID_CMD_MAX (__QTAGUID_CMD_MAX - 1)
+
+enum {
+	QTAGUID_ATTR_UNSPEC,
+	QTAGUID_ATTR_UID,		/* u32 */
+	QTAGUID_ATTR_GENERATION,	/* u32 */
+	QTAGUID_ATTR_STATS_RECORD,	/* struct qtaguid_stats_record */
+	__QTAGUID_ATTR_MAX,
+};
+#define QTAGUID_ATTR_MAX (__QTAGUID_ATTR_MAX - 1)
+
+/* Indexes of qtaguid_stats_record.rx/tx */
+enum {
+	QTAGUID_PROTO_TCP,
+	QTAGUID_PROTO_UDP,
+	QTAGUID_PROTO_OTHER,
+	QTAGUID_PROTO_MAX,
+};
+
+struct qtaguid_byte_packets {
+	__u64 bytes;
+	__u64 packets;
+};
+
+struct qtaguid_stats_record {
+	char iface[IFNAMSIZ];
+	__u64 acct_tag;		/* as acct_tag_hex in the proc stats */
+	__u32 uid;
+	__u32 cnt_set;
+	struct qtaguid_byte_packets rx[QTAGUID_PROTO_MAX];
+	struct qtaguid_byte_packets tx[QTAGUID_PROTO_MAX];
+};
+
 #endif /* _XT_QTAGUID_MATCH_H */
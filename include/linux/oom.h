@@ -70,6 +70,21 @@ extern unsigned long badness(struct task_struct *p, struct mem_cgroup *mem,
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_BUCKETS
+/* keep the lowmemorykiller's per-oom_adj lists of thread group leaders */
+extern void lowmem_adj_add(struct task_struct *p);
+extern void lowmem_adj_del(struct task_struct *p);
+extern void lowmem_adj_replace(struct task_struct *old,
+			       struct task_struct *new);
+extern void lowmem_adj_update(struct task_struct *p);
+#else
+static inline void lowmem_adj_add(struct task_struct *p) { }
+static inline void lowmem_adj_del(struct task_struct *p) { }
+static inline void lowmem_adj_replace(struct task_struct *old,
+				      struct task_struct *new) { }
+static inline void lowmem_adj_update(struct task_struct *p) { }
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
@@ -26,6 +26,8 @@
 enum pstore_type_id {
 	PSTORE_TYPE_DMESG	= 0,
 	PSTORE_TYPE_MCE		= 1,
+	PSTORE_TYPE_CONSOLE	= 2,
+	PSTORE_TYPE_FTRACE	= 3,
 	PSTORE_TYPE_UNKNOWN	= 255
 };
 
@@ -40,6 +42,9 @@ struct pstore_info {
 	ssize_t		(*read)(u64 *id, enum pstore_type_id *type,
 			struct timespec *time);
 	u64		(*write)(enum pstore_type_id type, size_t size);
+	/* optional, for writers that cannot take buf_mutex */
+	int		(*write_buf)(enum pstore_type_id type, const char *buf,
+			size_t size);
 	int		(*erase)(u64 id);
 };
 
@@ -78,6 +78,23 @@ struct mdm6600_ctrl_platform_data {
 	struct platform_device *mapphone_bpwake_device;
 };
 
+struct notifier_block;
+#ifdef CONFIG_MACH_MAPPHONE
+/* BP -> AP wake trigger edges, see board-mapphone-bpwake.c */
+extern int mapphone_bpwake_register_notifier(struct notifier_block *nb);
+extern int mapphone_bpwake_unregister_notifier(struct notifier_block *nb);
+#else
+static inline int mapphone_bpwake_register_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int
+mapphone_bpwake_unregister_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+#endif
+
 #endif /* __KERNEL__ */
 
 #endif /* __LINUX_RADIO_MDM6600_H__ */
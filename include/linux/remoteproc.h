@@ -39,6 +39,8 @@
 #include <linux/notifier.h>
 #include <linux/pm_qos_params.h>
 
+struct firmware;
+
 /* Must match the BIOS version embeded in the BIOS firmware image */
 #define RPROC_BIOS_VERSION	2
 
@@ -212,6 +214,9 @@ enum rproc_event {
 
 #define RPROC_MAX_NAME	100
 
+/* idle gaps remembered to size the autosuspend delay */
+#define RPROC_IDLE_GAPS	8
+
 /*
  * struct rproc - a physical remote processor device
  *
@@ -247,6 +252,11 @@ enum rproc_event {
  * @secure_mode: flag to dictate whether to enable secure loading
  * @secure_ok: restart status flag to be looked up upon the event's completion
  * @secure_reset: flag to uninstall the firewalls
+ * @fw: image kept from the last successful load, for the next start
+ * @last_busy: jiffies of the last rproc_last_busy() call
+ * @idle_gaps: recent idle gaps in ms, used to size the autosuspend delay
+ * @cur_delay: autosuspend delay currently programmed, in ms
+ * @stream_active: userspace asked to keep the processor up
  */
 struct rproc {
 	struct list_head next;
@@ -277,6 +287,12 @@ struct rproc {
 	bool force_suspend;
 	bool need_resume;
 	struct mutex pm_lock;
+	unsigned long last_busy;
+	unsigned idle_gaps[RPROC_IDLE_GAPS];
+	int idle_gap_ptr;
+	int idle_gap_cnt;
+	unsigned cur_delay;
+	bool stream_active;
 #endif
 	struct pm_qos_request_list *qos_request;
 	void *secure_ttb;
@@ -288,11 +304,13 @@ struct rproc {
 	bool halt_on_crash;
 	char *header;
 	int header_len;
+	const struct firmware *fw;
 };
 
 int rproc_set_secure(const char *, bool);
 struct rproc *rproc_get(const char *);
 void rproc_put(struct rproc *);
+void rproc_stop_all(void);
 int rproc_event_register(struct rproc *, struct notifier_block *);
 int rproc_event_unregister(struct rproc *, struct notifier_block *);
 int rproc_register(struct device *, const char *, const struct rproc_ops *,
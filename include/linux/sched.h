@@ -137,6 +137,8 @@ extern int nr_threads;
 DECLARE_PER_CPU(unsigned long, process_counts);
 extern int nr_processes(void);
 extern unsigned long nr_running(void);
+extern u64 sched_get_nr_running_sum(int cpu, u64 *stamp);
+extern bool sched_pack_tasks_enabled(void);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
@@ -727,6 +729,9 @@ struct user_struct {
 #ifdef CONFIG_PERF_EVENTS
 	atomic_long_t locked_vm;
 #endif
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+	struct cpufreq_uid_stats *cpufreq_stats;
+#endif
 };
 
 extern int uids_sysfs_init(void);
@@ -1289,6 +1294,9 @@ struct task_struct {
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
+#ifdef CONFIG_ANDROID_LMK_ADJ_BUCKETS
+	struct hlist_node lowmem_adj_node;	/* group leaders, by oom_adj */
+#endif
 
 	struct mm_struct *mm, *active_mm;
 #ifdef CONFIG_COMPAT_BRK
@@ -1868,6 +1876,11 @@ extern void do_set_cpus_allowed(struct task_struct *p,
 
 extern int set_cpus_allowed_ptr(struct task_struct *p,
 				const struct cpumask *new_mask);
+
+extern int sched_cpu_soft_offline(int cpu);
+extern void sched_cpu_soft_online(int cpu);
+extern bool cpu_is_soft_offline(int cpu);
+extern unsigned int num_soft_offline_cpus(void);
 #else
 static inline void do_set_cpus_allowed(struct task_struct *p,
 				      const struct cpumask *new_mask)
@@ -1880,6 +1893,22 @@ static inline int set_cpus_allowed_ptr(struct task_struct *p,
 		return -EINVAL;
 	return 0;
 }
+
+static inline int sched_cpu_soft_offline(int cpu)
+{
+	return -EBUSY;
+}
+static inline void sched_cpu_soft_online(int cpu)
+{
+}
+static inline bool cpu_is_soft_offline(int cpu)
+{
+	return false;
+}
+static inline unsigned int num_soft_offline_cpus(void)
+{
+	return 0;
+}
 #endif
 
 #ifndef CONFIG_CPUMASK_OFFSTACK
@@ -1989,6 +2018,7 @@ extern enum sched_tunable_scaling sysctl_sched_tunable_scaling;
 extern unsigned int sysctl_sched_migration_cost;
 extern unsigned int sysctl_sched_nr_migrate;
 extern unsigned int sysctl_sched_time_avg;
+extern unsigned int sysctl_sched_pack_util;
 extern unsigned int sysctl_timer_migration;
 extern unsigned int sysctl_sched_shares_window;
 
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA
+ */
+
+#ifndef __SENSOR_HUB_H__
+#define __SENSOR_HUB_H__
+
+#include <linux/types.h>
+
+#define SENSOR_HUB_NAME		"sensor_hub"
+#define SENSOR_HUB_MAX_VALUES	4
+
+enum sensor_hub_type {
+	SENSOR_HUB_TYPE_ACCEL = 1,
+	SENSOR_HUB_TYPE_GYRO,
+	SENSOR_HUB_TYPE_MAG,
+	SENSOR_HUB_TYPE_PROX,
+	SENSOR_HUB_TYPE_LIGHT,
+};
+
+/* One sample as read from /dev/sensor_hub */
+struct sensor_hub_event {
+	__u32 type;
+	__u32 count;		/* values used */
+	__s64 timestamp;	/* CLOCK_MONOTONIC, ns */
+	__s32 values[SENSOR_HUB_MAX_VALUES];
+};
+
+#ifdef __KERNEL__
+
+#include <linux/errno.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+
+struct sensor_hub_producer {
+	const char *name;
+	enum sensor_hub_type type;
+
+	/*
+	 * Optional, for polled sensors: called from the hub's tick in
+	 * process context, returns the number of values read or an error.
+	 * Interrupt driven sensors leave it NULL and use sensor_hub_push().
+	 */
+	int (*sample)(struct sensor_hub_producer *p, s32 *values);
+
+	/* Owned by the hub */
+	struct list_head node;
+	unsigned int interval_ms;
+	unsigned long next;
+};
+
+#ifdef CONFIG_SENSOR_HUB
+extern int sensor_hub_register(struct sensor_hub_producer *p);
+extern void sensor_hub_unregister(struct sensor_hub_producer *p);
+extern void sensor_hub_set_interval(struct sensor_hub_producer *p,
+				    unsigned int interval_ms);
+extern void sensor_hub_push(struct sensor_hub_producer *p, ktime_t stamp,
+			    const s32 *values, int count);
+#else
+static inline int sensor_hub_register(struct sensor_hub_producer *p)
+{
+	return -ENODEV;
+}
+
+static inline void sensor_hub_unregister(struct sensor_hub_producer *p)
+{
+}
+
+static inline void sensor_hub_set_interval(struct sensor_hub_producer *p,
+					   unsigned int interval_ms)
+{
+}
+
+static inline void sensor_hub_push(struct sensor_hub_producer *p,
+				   ktime_t stamp, const s32 *values, int count)
+{
+}
+#endif /* CONFIG_SENSOR_HUB */
+
+#endif /* __KERNEL__ */
+
+#endif /* __SENSOR_HUB_H__ */
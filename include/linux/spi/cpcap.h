@@ -755,6 +755,9 @@ struct cpcap_adc_request {
 
 	/* Used in case of sync requests */
 	struct completion completion;
+
+	/* Used internally to chain requests sharing one conversion */
+	struct cpcap_adc_request *next;
 };
 #endif
 
@@ -943,6 +946,13 @@ int cpcap_regacc_write(struct cpcap_device *cpcap, enum cpcap_reg reg,
 int cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
 		      unsigned short *value_ptr);
 
+int cpcap_regacc_write_batch(struct cpcap_device *cpcap,
+			     const struct cpcap_regacc *ops, int n);
+
+int cpcap_regacc_read_batch(struct cpcap_device *cpcap,
+			    const enum cpcap_reg *regs,
+			    unsigned short *values, int n);
+
 int cpcap_regacc_write_secondary(struct cpcap_device *cpcap, enum cpcap_reg reg,
 				 unsigned short value, unsigned short mask);
 
@@ -952,6 +962,8 @@ int cpcap_regacc_read_secondary(struct cpcap_device *cpcap, enum cpcap_reg reg,
 extern void cpcap_set_bit(enum cpcap_reg reg, unsigned short value,
 		      unsigned short mask);
 
+struct cpcap_device *cpcap_get_device(void);
+
 int cpcap_regacc_init(struct cpcap_device *cpcap);
 
 void cpcap_broadcast_key_event(struct cpcap_device *cpcap,
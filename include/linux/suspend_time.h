@@ -0,0 +1,22 @@
+#ifndef _LINUX_SUSPEND_TIME_H
+#define _LINUX_SUSPEND_TIME_H
+
+#include <linux/sched.h>	/* local_clock() */
+#include <linux/types.h>
+
+#ifdef CONFIG_SUSPEND_TIME
+/*
+ * Note that a suspend or resume step which began at start (local_clock())
+ * has just finished.  The slowest steps of each suspend cycle are kept in
+ * /sys/kernel/debug/suspend_steps; fmt is only expanded for those.
+ */
+extern void suspend_time_record(u64 start, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+#else
+static inline __attribute__((format(printf, 2, 3)))
+void suspend_time_record(u64 start, const char *fmt, ...)
+{
+}
+#endif
+
+#endif /* _LINUX_SUSPEND_TIME_H */
@@ -447,6 +447,10 @@ struct tcp_sock {
 		u32		  probe_seq_end;
 	} mtu_probe;
 
+/* Buffer autotuning ceilings from the route's device, 0: use the sysctls */
+	int	rcvbuf_max;
+	int	sndbuf_max;
+
 #ifdef CONFIG_TCP_MD5SIG
 /* TCP AF-Specific parts; only used by MD5 Signature support so far */
 	const struct tcp_sock_af_ops	*af_specific;
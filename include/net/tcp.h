@@ -415,6 +415,7 @@ extern int tcp_v4_do_rcv(struct sock *sk, struct sk_buff *skb);
 extern int tcp_v4_connect(struct sock *sk, struct sockaddr *uaddr,
 			  int addr_len);
 extern int tcp_connect(struct sock *sk);
+extern void tcp_init_dev_buffers(struct sock *sk, const struct dst_entry *dst);
 extern struct sk_buff * tcp_make_synack(struct sock *sk, struct dst_entry *dst,
 					struct request_sock *req,
 					struct request_values *rvp);
@@ -971,6 +972,17 @@ static inline int tcp_full_space(const struct sock *sk)
 	return tcp_win_from_space(sk->sk_rcvbuf); 
 }
 
+/* Upper bounds for receive and send buffer autotuning */
+static inline int tcp_rmem_max(const struct sock *sk)
+{
+	return tcp_sk(sk)->rcvbuf_max ? : sysctl_tcp_rmem[2];
+}
+
+static inline int tcp_wmem_max(const struct sock *sk)
+{
+	return tcp_sk(sk)->sndbuf_max ? : sysctl_tcp_wmem[2];
+}
+
 static inline void tcp_openreq_init(struct request_sock *req,
 				    struct tcp_options_received *rx_opt,
 				    struct sk_buff *skb)
@@ -0,0 +1,48 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM atmxt
+
+#if !defined(_TRACE_ATMXT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_ATMXT_H
+
+#include <linux/ktime.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(atmxt_irq,
+	TP_PROTO(int irq),
+	TP_ARGS(irq),
+
+	TP_STRUCT__entry(
+		__field(int, irq)
+	),
+
+	TP_fast_assign(
+		__entry->irq = irq;
+	),
+
+	TP_printk("irq=%d", __entry->irq)
+);
+
+/* at input_sync, the delay is only worked out when the event is on */
+TRACE_EVENT(atmxt_report,
+	TP_PROTO(int touches, ktime_t irq_time),
+	TP_ARGS(touches, irq_time),
+
+	TP_STRUCT__entry(
+		__field(int, touches)
+		__field(s64, delay_ns)
+	),
+
+	TP_fast_assign(
+		__entry->touches = touches;
+		__entry->delay_ns = ktime_to_ns(ktime_sub(ktime_get(),
+							  irq_time));
+	),
+
+	TP_printk("touches=%d delay=%lldns",
+		  __entry->touches, __entry->delay_ns)
+);
+
+#endif /* _TRACE_ATMXT_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
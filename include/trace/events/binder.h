@@ -0,0 +1,72 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(binder_transaction,
+	TP_PROTO(int reply, int debug_id, int from_pid, int from_tid,
+		 int to_pid, int to_tid, unsigned int code,
+		 unsigned int flags),
+	TP_ARGS(reply, debug_id, from_pid, from_tid, to_pid, to_tid, code,
+		flags),
+
+	TP_STRUCT__entry(
+		__field(int, reply)
+		__field(int, debug_id)
+		__field(int, from_pid)
+		__field(int, from_tid)
+		__field(int, to_pid)
+		__field(int, to_tid)
+		__field(unsigned int, code)
+		__field(unsigned int, flags)
+	),
+
+	TP_fast_assign(
+		__entry->reply = reply;
+		__entry->debug_id = debug_id;
+		__entry->from_pid = from_pid;
+		__entry->from_tid = from_tid;
+		__entry->to_pid = to_pid;
+		__entry->to_tid = to_tid;
+		__entry->code = code;
+		__entry->flags = flags;
+	),
+
+	TP_printk("transaction=%d reply=%d from %d:%d to %d:%d code=0x%x "
+		  "flags=0x%x",
+		  __entry->debug_id, __entry->reply,
+		  __entry->from_pid, __entry->from_tid,
+		  __entry->to_pid, __entry->to_tid,
+		  __entry->code, __entry->flags)
+);
+
+TRACE_EVENT(binder_transaction_received,
+	TP_PROTO(int reply, int debug_id, int pid, int tid),
+	TP_ARGS(reply, debug_id, pid, tid),
+
+	TP_STRUCT__entry(
+		__field(int, reply)
+		__field(int, debug_id)
+		__field(int, pid)
+		__field(int, tid)
+	),
+
+	TP_fast_assign(
+		__entry->reply = reply;
+		__entry->debug_id = debug_id;
+		__entry->pid = pid;
+		__entry->tid = tid;
+	),
+
+	TP_printk("transaction=%d reply=%d by %d:%d",
+		  __entry->debug_id, __entry->reply,
+		  __entry->pid, __entry->tid)
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,53 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dsscomp
+
+#if !defined(_TRACE_DSSCOMP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_DSSCOMP_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(dsscomp_apply,
+	TP_PROTO(u32 display, u32 sync_id, u32 num_ovls),
+	TP_ARGS(display, sync_id, num_ovls),
+
+	TP_STRUCT__entry(
+		__field(u32, display)
+		__field(u32, sync_id)
+		__field(u32, num_ovls)
+	),
+
+	TP_fast_assign(
+		__entry->display = display;
+		__entry->sync_id = sync_id;
+		__entry->num_ovls = num_ovls;
+	),
+
+	TP_printk("display=%u sync_id=%u ovls=%u",
+		  __entry->display, __entry->sync_id, __entry->num_ovls)
+);
+
+/* from the DISPC vsync interrupt */
+TRACE_EVENT(dsscomp_status,
+	TP_PROTO(u32 display, u32 sync_id, int status),
+	TP_ARGS(display, sync_id, status),
+
+	TP_STRUCT__entry(
+		__field(u32, display)
+		__field(u32, sync_id)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		__entry->display = display;
+		__entry->sync_id = sync_id;
+		__entry->status = status;
+	),
+
+	TP_printk("display=%u sync_id=%u status=0x%x",
+		  __entry->display, __entry->sync_id, __entry->status)
+);
+
+#endif /* _TRACE_DSSCOMP_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
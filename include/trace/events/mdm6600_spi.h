@@ -0,0 +1,52 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mdm6600_spi
+
+#if !defined(_TRACE_MDM6600_SPI_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MDM6600_SPI_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(mdm6600_spi_xfer_start,
+	TP_PROTO(int msg_id, unsigned int len, unsigned int data_len),
+	TP_ARGS(msg_id, len, data_len),
+
+	TP_STRUCT__entry(
+		__field(int, msg_id)
+		__field(unsigned int, len)
+		__field(unsigned int, data_len)
+	),
+
+	TP_fast_assign(
+		__entry->msg_id = msg_id;
+		__entry->len = len;
+		__entry->data_len = data_len;
+	),
+
+	TP_printk("msg=%d len=%u data=%u",
+		  __entry->msg_id, __entry->len, __entry->data_len)
+);
+
+TRACE_EVENT(mdm6600_spi_xfer_done,
+	TP_PROTO(int msg_id, int status, unsigned int actual_len),
+	TP_ARGS(msg_id, status, actual_len),
+
+	TP_STRUCT__entry(
+		__field(int, msg_id)
+		__field(int, status)
+		__field(unsigned int, actual_len)
+	),
+
+	TP_fast_assign(
+		__entry->msg_id = msg_id;
+		__entry->status = status;
+		__entry->actual_len = actual_len;
+	),
+
+	TP_printk("msg=%d status=%d actual=%u",
+		  __entry->msg_id, __entry->status, __entry->actual_len)
+);
+
+#endif /* _TRACE_MDM6600_SPI_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -48,6 +48,45 @@ DEFINE_EVENT(cpu, cpu_frequency,
 	TP_ARGS(frequency, cpu_id)
 );
 
+/* Breakdown of a frequency transition, see struct cpufreq_freqs */
+TRACE_EVENT(cpu_frequency_latency,
+
+	TP_PROTO(unsigned int cpu_id, unsigned int old, unsigned int new,
+		 unsigned int decision_us, unsigned int trans_us,
+		 unsigned int volt_us, unsigned int clk_us),
+
+	TP_ARGS(cpu_id, old, new, decision_us, trans_us, volt_us, clk_us),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	u32,		old		)
+		__field(	u32,		new		)
+		__field(	u32,		decision_us	)
+		__field(	u32,		trans_us	)
+		__field(	u32,		volt_us		)
+		__field(	u32,		clk_us		)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->old = old;
+		__entry->new = new;
+		__entry->decision_us = decision_us;
+		__entry->trans_us = trans_us;
+		__entry->volt_us = volt_us;
+		__entry->clk_us = clk_us;
+	),
+
+	TP_printk("cpu_id=%lu old=%lu new=%lu decision_us=%lu trans_us=%lu "
+		  "volt_us=%lu clk_us=%lu",
+		  (unsigned long)__entry->cpu_id, (unsigned long)__entry->old,
+		  (unsigned long)__entry->new,
+		  (unsigned long)__entry->decision_us,
+		  (unsigned long)__entry->trans_us,
+		  (unsigned long)__entry->volt_us,
+		  (unsigned long)__entry->clk_us)
+);
+
 TRACE_EVENT(machine_suspend,
 
 	TP_PROTO(unsigned int state),
@@ -234,6 +273,36 @@ DEFINE_EVENT(power_domain, power_domain_target,
 
 	TP_ARGS(name, state, cpu_id)
 );
+
+/*
+ * Time spent scaling a voltage domain and switching the clocks of its
+ * devices in one DVFS transition
+ */
+TRACE_EVENT(dvfs_scale,
+
+	TP_PROTO(const char *name, unsigned long volt, unsigned int volt_us,
+		 unsigned int clk_us),
+
+	TP_ARGS(name, volt, volt_us, clk_us),
+
+	TP_STRUCT__entry(
+		__string(       name,           name            )
+		__field(        u32,            volt            )
+		__field(        u32,            volt_us         )
+		__field(        u32,            clk_us          )
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->volt = volt;
+		__entry->volt_us = volt_us;
+		__entry->clk_us = clk_us;
+	),
+
+	TP_printk("%s volt=%lu volt_us=%lu clk_us=%lu", __get_str(name),
+		(unsigned long)__entry->volt, (unsigned long)__entry->volt_us,
+		(unsigned long)__entry->clk_us)
+);
 #endif /* _TRACE_POWER_H */
 
 /* This part must be outside protection */
@@ -56,6 +56,14 @@ struct mapphone_dsi_panel_data {
 	int max_backlight_level;
 	int (*set_backlight)(struct omap_dss_device *dssdev, int level);
 	int (*get_backlight)(struct omap_dss_device *dssdev);
+
+	/*
+	 * platform_enable split in two, so that the supplies can ramp while
+	 * the DSI link comes up: power_on enables the supplies and holds the
+	 * panel in reset, release_reset lets it out once the link is up.
+	 */
+	int (*power_on)(struct omap_dss_device *dssdev);
+	void (*release_reset)(struct omap_dss_device *dssdev);
 };
 
 /* for panel detection */
@@ -22,6 +22,7 @@
 #include <linux/kobject.h>
 #include <linux/device.h>
 #include <linux/fb.h>
+#include <linux/ktime.h>
 
 #define DISPC_IRQ_FRAMEDONE		(1 << 0)
 #define DISPC_IRQ_VSYNC			(1 << 1)
@@ -537,6 +538,8 @@ struct omap_overlay_manager {
 	int (*wait_for_go)(struct omap_overlay_manager *mgr);
 	int (*wait_for_vsync)(struct omap_overlay_manager *mgr);
 	int (*blank)(struct omap_overlay_manager *mgr, bool wait_for_vsync);
+	int (*set_lp_fetch)(struct omap_overlay_manager *mgr, bool enable);
+	ktime_t (*get_go_time)(struct omap_overlay_manager *mgr);
 	void (*dump_cb)(struct omap_overlay_manager *mgr, struct seq_file *s);
 
 	int (*enable)(struct omap_overlay_manager *mgr);
@@ -0,0 +1,143 @@
+/*
+ * cgroup_timer_slack.c - control group timer slack subsystem
+ *
+ * Sets the default timer slack of the tasks in a cgroup, so the timers
+ * of a whole class of tasks, typically the background apps, can be
+ * expired together with other wakeups instead of at their exact time.
+ *
+ * A task moved into a group gets the group's slack as its current and
+ * default slack; prctl(PR_SET_TIMERSLACK) still works on top of it and
+ * children inherit it through fork as usual.  A new group starts with
+ * the slack of its parent.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/capability.h>
+#include <linux/cgroup.h>
+#include <linux/cred.h>
+#include <linux/err.h>
+#include <linux/init_task.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state css;
+	unsigned long slack_ns;
+};
+
+struct cgroup_subsys timer_slack_subsys;
+
+static inline
+struct timer_slack_cgroup *cgroup_timer_slack(struct cgroup *cgrp)
+{
+	return container_of(cgroup_subsys_state(cgrp, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+static void timer_slack_set_task(struct task_struct *tsk,
+				 unsigned long slack_ns)
+{
+	task_lock(tsk);
+	tsk->timer_slack_ns = slack_ns;
+	tsk->default_timer_slack_ns = slack_ns;
+	task_unlock(tsk);
+}
+
+static struct cgroup_subsys_state *
+timer_slack_create(struct cgroup_subsys *ss, struct cgroup *cgrp)
+{
+	struct timer_slack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	if (cgrp->parent)
+		tslack->slack_ns = cgroup_timer_slack(cgrp->parent)->slack_ns;
+	else
+		tslack->slack_ns = init_task.default_timer_slack_ns;
+
+	return &tslack->css;
+}
+
+static void timer_slack_destroy(struct cgroup_subsys *ss, struct cgroup *cgrp)
+{
+	kfree(cgroup_timer_slack(cgrp));
+}
+
+/*
+ * Let a process holding CAP_SYS_NICE, such as the one sorting apps into
+ * foreground and background, move tasks it does not own.
+ */
+static int timer_slack_allow_attach(struct cgroup *cgrp,
+				    struct task_struct *tsk)
+{
+	const struct cred *cred = current_cred(), *tcred;
+
+	tcred = __task_cred(tsk);
+
+	if ((current != tsk) && !capable(CAP_SYS_NICE) &&
+	    cred->euid != tcred->uid && cred->euid != tcred->suid)
+		return -EACCES;
+
+	return 0;
+}
+
+static void timer_slack_attach_task(struct cgroup *cgrp,
+				    struct task_struct *tsk)
+{
+	timer_slack_set_task(tsk, cgroup_timer_slack(cgrp)->slack_ns);
+}
+
+static u64 timer_slack_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_timer_slack(cgrp)->slack_ns;
+}
+
+static int timer_slack_write(struct cgroup *cgrp, struct cftype *cft, u64 val)
+{
+	struct cgroup_iter it;
+	struct task_struct *tsk;
+
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	if (!cgroup_lock_live_group(cgrp))
+		return -ENODEV;
+
+	cgroup_timer_slack(cgrp)->slack_ns = val;
+
+	cgroup_iter_start(cgrp, &it);
+	while ((tsk = cgroup_iter_next(cgrp, &it)))
+		timer_slack_set_task(tsk, val);
+	cgroup_iter_end(cgrp, &it);
+
+	cgroup_unlock();
+	return 0;
+}
+
+static struct cftype files[] = {
+	{
+		.name = "slack_ns",
+		.read_u64 = timer_slack_read,
+		.write_u64 = timer_slack_write,
+	},
+};
+
+static int timer_slack_populate(struct cgroup_subsys *ss, struct cgroup *cgrp)
+{
+	return cgroup_add_files(cgrp, ss, files, ARRAY_SIZE(files));
+}
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.create		= timer_slack_create,
+	.destroy	= timer_slack_destroy,
+	.populate	= timer_slack_populate,
+	.subsys_id	= timer_slack_subsys_id,
+	.allow_attach	= timer_slack_allow_attach,
+	.attach_task	= timer_slack_attach_task,
+};
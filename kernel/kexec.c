@@ -58,6 +58,14 @@ struct resource crashk_res = {
 	.flags = IORESOURCE_BUSY | IORESOURCE_MEM
 };
 
+/* Location of the reserved area for pre-staged kexec images */
+struct resource kexec_prestage_res = {
+	.name  = "Kexec prestage",
+	.start = 0,
+	.end   = 0,
+	.flags = IORESOURCE_BUSY | IORESOURCE_MEM
+};
+
 int kexec_should_crash(struct task_struct *p)
 {
 	if (in_interrupt() || !p->pid || is_global_init(p) || panic_on_oops)
@@ -226,6 +234,26 @@ out:
 
 }
 
+static int kimage_is_prestaged(struct kimage *image)
+{
+	unsigned long i;
+
+	if (kexec_prestage_res.end == kexec_prestage_res.start)
+		return 0;
+
+	for (i = 0; i < image->nr_segments; i++) {
+		unsigned long mstart, mend;
+
+		mstart = image->segment[i].mem;
+		mend = mstart + image->segment[i].memsz - 1;
+		if ((mstart < kexec_prestage_res.start) ||
+		    (mend > kexec_prestage_res.end))
+			return 0;
+	}
+
+	return image->nr_segments != 0;
+}
+
 static int kimage_normal_alloc(struct kimage **rimage, unsigned long entry,
 				unsigned long nr_segments,
 				struct kexec_segment __user *segments)
@@ -241,6 +269,13 @@ static int kimage_normal_alloc(struct kimage **rimage, unsigned long entry,
 
 	*rimage = image;
 
+	/*
+	 * If every segment lands inside the reserved prestage area the
+	 * data can be copied straight to its final address at load time,
+	 * leaving nothing for relocate_new_kernel to shuffle.
+	 */
+	image->prestaged = kimage_is_prestaged(image);
+
 	/*
 	 * Find a location for the control code buffer, and add it
 	 * the vector of segments so that it's pages will also be
@@ -845,7 +880,8 @@ out:
 static int kimage_load_crash_segment(struct kimage *image,
 					struct kexec_segment *segment)
 {
-	/* For crash dumps kernels we simply copy the data from
+	/* For crash dumps kernels, and for images pre-staged in the
+	 * reserved prestage area, we simply copy the data from
 	 * user space to it's destination.
 	 * We do things a page at a time for the sake of kmap.
 	 */
@@ -904,7 +940,10 @@ static int kimage_load_segment(struct kimage *image,
 
 	switch (image->type) {
 	case KEXEC_TYPE_DEFAULT:
-		result = kimage_load_normal_segment(image, segment);
+		if (image->prestaged)
+			result = kimage_load_crash_segment(image, segment);
+		else
+			result = kimage_load_normal_segment(image, segment);
 		break;
 	case KEXEC_TYPE_CRASH:
 		result = kimage_load_crash_segment(image, segment);
@@ -1503,6 +1542,7 @@ int kernel_kexec(void)
 		error = -EINVAL;
 		goto Unlock;
 	}
+	kexec_timeline_stamp(KEXEC_TL_KEXEC);
 
 #ifdef CONFIG_KEXEC_JUMP
 	if (kexec_image->preserve_context) {
@@ -1538,8 +1578,10 @@ int kernel_kexec(void)
 #endif
 	{
 		kernel_restart_prepare(NULL);
+		kexec_timeline_stamp(KEXEC_TL_SHUTDOWN);
 		printk(KERN_EMERG "Starting new kernel\n");
 		machine_shutdown();
+		kexec_timeline_stamp(KEXEC_TL_MACHINE_SHUTDOWN);
 	}
 
 	machine_kexec(kexec_image);
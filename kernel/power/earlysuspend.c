@@ -13,10 +13,12 @@
  *
  */
 
+#include <linux/async.h>
 #include <linux/earlysuspend.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/suspend_time.h>
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
 
@@ -36,6 +38,7 @@ static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
 static DECLARE_WORK(late_resume_work, late_resume);
+static LIST_HEAD(late_resume_domain);
 static DEFINE_SPINLOCK(state_lock);
 enum {
 	SUSPEND_REQUESTED = 0x1,
@@ -70,11 +73,18 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+/* Walk back from pos over the handlers of the given level */
+#define for_each_handler_in_level(pos, lvl)				\
+	for (; &pos->link != &early_suspend_handlers &&			\
+	       pos->level == (lvl);					\
+	     pos = list_entry(pos->link.prev, struct early_suspend, link))
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	u64 start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -97,7 +107,10 @@ static void early_suspend(struct work_struct *work)
 		if (pos->suspend != NULL) {
 			if (debug_mask & DEBUG_VERBOSE)
 				pr_info("early_suspend: calling %pf\n", pos->suspend);
+			start = local_clock();
 			pos->suspend(pos);
+			suspend_time_record(start, "early_suspend %pf",
+					    pos->suspend);
 		}
 	}
 	mutex_unlock(&early_suspend_lock);
@@ -109,11 +122,29 @@ abort:
 	spin_unlock_irqrestore(&state_lock, irqflags);
 }
 
+static void late_resume_one(struct early_suspend *pos)
+{
+	u64 start;
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("late_resume: calling %pf\n", pos->resume);
+
+	start = local_clock();
+	pos->resume(pos);
+	suspend_time_record(start, "late_resume %pf", pos->resume);
+}
+
+static void late_resume_async(void *data, async_cookie_t cookie)
+{
+	late_resume_one(data);
+}
+
 static void late_resume(struct work_struct *work)
 {
-	struct early_suspend *pos;
+	struct early_suspend *pos, *first;
 	unsigned long irqflags;
 	int abort = 0;
+	int level;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -130,13 +161,29 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-		}
+	/*
+	 * One level at a time, highest first.  The async handlers of a level
+	 * are started before its synchronous ones so they overlap, and all
+	 * of them finish before the next level starts.
+	 */
+	first = list_entry(early_suspend_handlers.prev,
+			   struct early_suspend, link);
+	while (&first->link != &early_suspend_handlers) {
+		level = first->level;
+
+		pos = first;
+		for_each_handler_in_level(pos, level)
+			if (pos->resume != NULL && pos->resume_async)
+				async_schedule_domain(late_resume_async, pos,
+						      &late_resume_domain);
+
+		pos = first;
+		for_each_handler_in_level(pos, level)
+			if (pos->resume != NULL && !pos->resume_async)
+				late_resume_one(pos);
+
+		async_synchronize_full_domain(&late_resume_domain);
+		first = pos;
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
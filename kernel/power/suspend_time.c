@@ -18,13 +18,102 @@
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/sched.h>
 #include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/suspend.h>
+#include <linux/suspend_time.h>
 #include <linux/syscore_ops.h>
 #include <linux/time.h>
 
+#define SUSPEND_STEPS_TOP	8	/* slowest steps kept per cycle */
+#define SUSPEND_STEPS_CYCLES	16	/* cycles kept */
+
+struct suspend_step {
+	u64 ns;
+	char name[48];
+};
+
+struct suspend_cycle {
+	ktime_t end;
+	unsigned int count;
+	struct suspend_step top[SUSPEND_STEPS_TOP];
+};
+
 static struct timespec suspend_time_before;
 static unsigned int time_in_suspend_bins[32];
 
+/* cycles[cycle_head] is the one being recorded */
+static struct suspend_cycle cycles[SUSPEND_STEPS_CYCLES];
+static unsigned int cycle_head;
+static unsigned int cycles_done;
+static DEFINE_SPINLOCK(cycle_lock);
+
+void suspend_time_record(u64 start, const char *fmt, ...)
+{
+	u64 ns = local_clock() - start;
+	struct suspend_cycle *c;
+	struct suspend_step *step;
+	unsigned long flags;
+	unsigned int i;
+	va_list args;
+
+	spin_lock_irqsave(&cycle_lock, flags);
+	c = &cycles[cycle_head];
+	if (c->count < SUSPEND_STEPS_TOP) {
+		step = &c->top[c->count++];
+	} else {
+		step = &c->top[0];
+		for (i = 1; i < SUSPEND_STEPS_TOP; i++)
+			if (c->top[i].ns < step->ns)
+				step = &c->top[i];
+		if (ns <= step->ns)
+			goto out;
+	}
+	step->ns = ns;
+	va_start(args, fmt);
+	vsnprintf(step->name, sizeof(step->name), fmt, args);
+	va_end(args);
+out:
+	spin_unlock_irqrestore(&cycle_lock, flags);
+}
+
+static int suspend_step_cmp(const void *a, const void *b)
+{
+	const struct suspend_step *sa = a, *sb = b;
+
+	if (sa->ns == sb->ns)
+		return 0;
+	return sa->ns < sb->ns ? 1 : -1;
+}
+
+static int suspend_time_pm_notify(struct notifier_block *nb,
+				  unsigned long event, void *unused)
+{
+	struct suspend_cycle *c;
+	unsigned long flags;
+
+	if (event != PM_POST_SUSPEND)
+		return NOTIFY_DONE;
+
+	spin_lock_irqsave(&cycle_lock, flags);
+	c = &cycles[cycle_head];
+	c->end = ktime_get();
+	sort(c->top, c->count, sizeof(c->top[0]), suspend_step_cmp, NULL);
+	cycle_head = (cycle_head + 1) % SUSPEND_STEPS_CYCLES;
+	cycles[cycle_head].count = 0;
+	if (cycles_done < SUSPEND_STEPS_CYCLES - 1)
+		cycles_done++;
+	spin_unlock_irqrestore(&cycle_lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block suspend_time_pm_nb = {
+	.notifier_call = suspend_time_pm_notify,
+};
+
 #ifdef CONFIG_DEBUG_FS
 static int suspend_time_debug_show(struct seq_file *s, void *data)
 {
@@ -53,6 +142,41 @@ static const struct file_operations suspend_time_debug_fops = {
 	.release	= single_release,
 };
 
+static int suspend_steps_debug_show(struct seq_file *s, void *data)
+{
+	struct suspend_cycle *c;
+	unsigned int n, i, idx;
+
+	/* Newest cycle first; the sort at commit time ordered the steps */
+	spin_lock_irq(&cycle_lock);
+	for (n = 1; n <= cycles_done; n++) {
+		idx = (cycle_head + SUSPEND_STEPS_CYCLES - n) %
+			SUSPEND_STEPS_CYCLES;
+		c = &cycles[idx];
+		seq_printf(s, "cycle ending at %lld ms\n",
+			   ktime_to_ms(c->end));
+		for (i = 0; i < c->count; i++)
+			seq_printf(s, "  %8llu us  %s\n",
+				   div_u64(c->top[i].ns, NSEC_PER_USEC),
+				   c->top[i].name);
+	}
+	spin_unlock_irq(&cycle_lock);
+
+	return 0;
+}
+
+static int suspend_steps_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_steps_debug_show, NULL);
+}
+
+static const struct file_operations suspend_steps_debug_fops = {
+	.open		= suspend_steps_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init suspend_time_debug_init(void)
 {
 	struct dentry *d;
@@ -64,6 +188,13 @@ static int __init suspend_time_debug_init(void)
 		return -ENOMEM;
 	}
 
+	d = debugfs_create_file("suspend_steps", 0444, NULL, NULL,
+		&suspend_steps_debug_fops);
+	if (!d) {
+		pr_err("Failed to create suspend_steps debug file\n");
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -99,12 +230,14 @@ static struct syscore_ops suspend_time_syscore_ops = {
 static int suspend_time_syscore_init(void)
 {
 	register_syscore_ops(&suspend_time_syscore_ops);
+	register_pm_notifier(&suspend_time_pm_nb);
 
 	return 0;
 }
 
 static void suspend_time_syscore_exit(void)
 {
+	unregister_pm_notifier(&suspend_time_pm_nb);
 	unregister_syscore_ops(&suspend_time_syscore_ops);
 }
 module_init(suspend_time_syscore_init);
@@ -43,6 +43,8 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+/* Active locks with a timeout, soonest to expire first */
+static struct list_head active_timeout_locks[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -147,6 +149,9 @@ static void *wakelock_seq_start(struct seq_file *m, loff_t *pos)
 		list_for_each_entry(lock, &active_wake_locks[type], link)
 			if (n-- == 0)
 				goto found;
+		list_for_each_entry(lock, &active_timeout_locks[type], link)
+			if (n-- == 0)
+				goto found;
 	}
 	lock = NULL;
 found:
@@ -209,15 +214,14 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	}
 }
 
-static void update_sleep_wait_stats_locked(int done)
+static void update_sleep_wait_stats_list(struct list_head *head,
+					 ktime_t elapsed, int done)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
+	ktime_t etime, add;
 	int expired;
 
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
+	list_for_each_entry(lock, head, link) {
 		expired = get_expired_time(lock, &etime);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 			if (expired)
@@ -232,6 +236,18 @@ static void update_sleep_wait_stats_locked(int done)
 		else
 			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
 	}
+}
+
+static void update_sleep_wait_stats_locked(int done)
+{
+	ktime_t now, elapsed;
+
+	now = ktime_get();
+	elapsed = ktime_sub(now, last_sleep_time_update);
+	update_sleep_wait_stats_list(&active_wake_locks[WAKE_LOCK_SUSPEND],
+				     elapsed, done);
+	update_sleep_wait_stats_list(&active_timeout_locks[WAKE_LOCK_SUSPEND],
+				     elapsed, done);
 	last_sleep_time_update = now;
 }
 #endif
@@ -257,38 +273,58 @@ static void print_active_locks(int type)
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout > 0)
-				pr_info("active wake lock %s, time left %ld\n",
-					lock->name, timeout);
-			else if (print_expired)
-				pr_info("wake lock %s, expired\n", lock->name);
-		} else {
-			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
-		}
+		pr_info("active wake lock %s\n", lock->name);
+		if (!(debug_mask & DEBUG_EXPIRE))
+			print_expired = false;
+	}
+	list_for_each_entry(lock, &active_timeout_locks[type], link) {
+		long timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			pr_info("active wake lock %s, time left %ld\n",
+				lock->name, timeout);
+		else if (print_expired)
+			pr_info("wake lock %s, expired\n", lock->name);
 	}
 }
 
+/* Caller must acquire the list_lock spinlock */
+static void add_timeout_lock_locked(struct wake_lock *lock, int type)
+{
+	struct list_head *head = &active_timeout_locks[type];
+	struct wake_lock *pos;
+
+	/* A new timeout nearly always expires last, so search from the end */
+	list_for_each_entry_reverse(pos, head, link)
+		if (!time_before(lock->expires, pos->expires))
+			break;
+	list_add(&lock->link, &pos->link);
+}
+
+/*
+ * Returns -1 if a lock without timeout is held, else the time until the
+ * last timeout expires, 0 if nothing is held.  Expired locks sit at the
+ * front of the timeout list and the longest timeout at its end, so this
+ * only looks at the locks it expires.
+ */
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct list_head *head = &active_timeout_locks[type];
+	struct wake_lock *lock;
+	unsigned long now = jiffies;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	while (!list_empty(head)) {
+		lock = list_first_entry(head, struct wake_lock, link);
+		if ((long)(lock->expires - now) > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+	if (!list_empty(&active_wake_locks[type]))
+		return -1;
+	if (list_empty(head))
+		return 0;
+	lock = list_entry(head->prev, struct wake_lock, link);
+	return lock->expires - now;
 }
 
 long has_wake_lock(int type)
@@ -534,7 +570,7 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		add_timeout_lock_locked(lock, type);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
@@ -681,8 +717,10 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		INIT_LIST_HEAD(&active_timeout_locks[i]);
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
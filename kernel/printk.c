@@ -41,6 +41,8 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 
 #include <asm/uaccess.h>
 
@@ -102,7 +104,8 @@ EXPORT_SYMBOL_GPL(console_drivers);
 static int console_locked, console_suspended;
 
 /*
- * logbuf_lock protects log_buf, log_start, log_end, con_start and logged_chars
+ * logbuf_lock protects log_buf, log_start, log_end, con_start, slow_con_start
+ * and logged_chars
  * It is also used in interesting ways to provide interlocking in
  * console_unlock();.
  */
@@ -117,8 +120,36 @@ static DEFINE_SPINLOCK(logbuf_lock);
  */
 static unsigned log_start;	/* Index into log_buf: next char to be read by syslog() */
 static unsigned con_start;	/* Index into log_buf: next char to be sent to consoles */
+static unsigned slow_con_start;	/* Same, for the consoles without CON_FAST */
 static unsigned log_end;	/* Index into log_buf: most-recently-written-char + 1 */
 
+/*
+ * With printk.async set, printk() only writes to the CON_FAST consoles,
+ * such as the ram console.  The others, a UART draining at 115200 baud,
+ * are written by console_async_task in small chunks, except while an
+ * oops is in progress or the system is going down.
+ */
+#ifdef CONFIG_PRINTK_ASYNC
+static int printk_async = 1;
+#else
+static int printk_async;
+#endif
+module_param_named(async, printk_async, bool, S_IRUGO | S_IWUSR);
+
+#define SLOW_CONSOLE_CHUNK	128
+
+static struct task_struct *console_async_task;
+/* set with console_sem held: write the slow consoles in console_unlock() */
+static int console_flush_slow;
+/* which of the console groups call_console_drivers() writes to */
+static int console_slow_pass;
+
+static inline bool console_async(void)
+{
+	return printk_async && console_async_task && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
 /*
  * If exclusive_console is non-NULL then only this console is to be printed to.
  */
@@ -224,7 +255,7 @@ void __init setup_log_buf(int early)
 	new_log_buf_len = 0;
 	free = __LOG_BUF_LEN - log_end;
 
-	offset = start = min(con_start, log_start);
+	offset = start = min(min(con_start, slow_con_start), log_start);
 	dest_idx = 0;
 	while (start != log_end) {
 		unsigned log_idx_mask = start & (__LOG_BUF_LEN - 1);
@@ -235,6 +266,7 @@ void __init setup_log_buf(int early)
 	}
 	log_start -= offset;
 	con_start -= offset;
+	slow_con_start -= offset;
 	log_end -= offset;
 	spin_unlock_irqrestore(&logbuf_lock, flags);
 
@@ -567,6 +599,8 @@ static void __call_console_drivers(unsigned start, unsigned end)
 	for_each_console(con) {
 		if (exclusive_console && con != exclusive_console)
 			continue;
+		if (!(con->flags & CON_FAST) != console_slow_pass)
+			continue;
 		if ((con->flags & CON_ENABLED) && con->write &&
 				(cpu_online(smp_processor_id()) ||
 				(con->flags & CON_ANYTIME)))
@@ -678,7 +712,9 @@ static size_t log_prefix(const char *p, unsigned int *level, char *special)
 static void call_console_drivers(unsigned start, unsigned end)
 {
 	unsigned cur_index, start_print;
-	static int msg_level = -1;
+	/* per console group, a chunk may end in the middle of a line */
+	static int msg_levels[2] = { -1, -1 };
+	int msg_level = msg_levels[console_slow_pass];
 
 	BUG_ON(((int)(start - end)) > 0);
 
@@ -712,6 +748,7 @@ static void call_console_drivers(unsigned start, unsigned end)
 		}
 	}
 	_call_console_drivers(start_print, end, msg_level);
+	msg_levels[console_slow_pass] = msg_level;
 }
 
 #ifdef CONFIG_APANIC_MMC
@@ -736,6 +773,8 @@ static void emit_log_char(char c)
 		log_start = log_end - log_buf_len;
 	if (log_end - con_start > log_buf_len)
 		con_start = log_end - log_buf_len;
+	if (log_end - slow_con_start > log_buf_len)
+		slow_con_start = log_end - log_buf_len;
 	if (logged_chars < log_buf_len)
 		logged_chars++;
 #ifdef CONFIG_APANIC_MMC
@@ -1198,6 +1237,10 @@ void suspend_console(void)
 	if (!console_suspend_enabled)
 		return;
 	printk("Suspending console(s) (use no_console_suspend to debug)\n");
+	/* write out what the async console has not sent yet */
+	console_lock();
+	console_flush_slow = 1;
+	console_unlock();
 	console_lock();
 	console_suspended = 1;
 	up(&console_sem);
@@ -1210,6 +1253,9 @@ void resume_console(void)
 	down(&console_sem);
 	console_suspended = 0;
 	console_unlock();
+	/* pick up what was printed while suspended */
+	if (console_async_task)
+		wake_up_process(console_async_task);
 }
 
 /**
@@ -1283,13 +1329,21 @@ int is_console_locked(void)
 	return console_locked;
 }
 
+#define PRINTK_PENDING_WAKEUP	0x01
+#define PRINTK_PENDING_CONSOLE	0x02
+
 static DEFINE_PER_CPU(int, printk_pending);
 
 void printk_tick(void)
 {
-	if (__this_cpu_read(printk_pending)) {
+	int pending = __this_cpu_read(printk_pending);
+
+	if (pending) {
 		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_CONSOLE)
+			wake_up_process(console_async_task);
 	}
 }
 
@@ -1303,7 +1357,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
 }
 
 /**
@@ -1325,8 +1379,10 @@ void console_unlock(void)
 	unsigned long flags;
 	unsigned _con_start, _log_end;
 	unsigned wake_klogd = 0;
+	bool slow, wake_console = false;
 
 	if (console_suspended) {
+		console_flush_slow = 0;
 		up(&console_sem);
 		return;
 	}
@@ -1336,18 +1392,38 @@ void console_unlock(void)
 	for ( ; ; ) {
 		spin_lock_irqsave(&logbuf_lock, flags);
 		wake_klogd |= log_start - log_end;
-		if (con_start == log_end)
+		slow = console_flush_slow || exclusive_console ||
+			!console_async();
+		if (con_start != log_end) {
+			_con_start = con_start;
+			_log_end = log_end;
+			con_start = log_end;	/* Flush */
+			console_slow_pass = 0;
+		} else if (slow && slow_con_start != log_end) {
+			_con_start = slow_con_start;
+			_log_end = log_end;
+			/* only the async flush cares about latency */
+			if (console_flush_slow &&
+			    _log_end - _con_start > SLOW_CONSOLE_CHUNK)
+				_log_end = _con_start + SLOW_CONSOLE_CHUNK;
+			slow_con_start = _log_end;
+			console_slow_pass = 1;
+		} else {
+			/* left to console_async_task */
+			wake_console = slow_con_start != log_end;
 			break;			/* Nothing to print */
-		_con_start = con_start;
-		_log_end = log_end;
-		con_start = log_end;		/* Flush */
+		}
 		spin_unlock(&logbuf_lock);
 		stop_critical_timings();	/* don't trace print latency */
 		call_console_drivers(_con_start, _log_end);
 		start_critical_timings();
 		local_irq_restore(flags);
+
+		if (console_slow_pass && current == console_async_task)
+			cond_resched();
 	}
 	console_locked = 0;
+	console_flush_slow = 0;
 
 	/* Release the exclusive_console once it is used */
 	if (unlikely(exclusive_console))
@@ -1357,6 +1433,9 @@ void console_unlock(void)
 	spin_unlock_irqrestore(&logbuf_lock, flags);
 	if (wake_klogd)
 		wake_up_klogd();
+	/* printk() may be called with the runqueue locked, wake from the tick */
+	if (wake_console)
+		this_cpu_or(printk_pending, PRINTK_PENDING_CONSOLE);
 }
 EXPORT_SYMBOL(console_unlock);
 
@@ -1585,7 +1664,10 @@ void register_console(struct console *newcon)
 		 * for us.
 		 */
 		spin_lock_irqsave(&logbuf_lock, flags);
-		con_start = log_start;
+		if (newcon->flags & CON_FAST)
+			con_start = log_start;
+		else
+			slow_con_start = log_start;
 		spin_unlock_irqrestore(&logbuf_lock, flags);
 		/*
 		 * We're about to replay the log buffer.  Only do this to the
@@ -1677,6 +1759,46 @@ static int __init printk_late_init(void)
 }
 late_initcall(printk_late_init);
 
+static int console_async_thread(void *unused)
+{
+	set_user_nice(current, 10);
+	set_freezable();
+
+	for (;;) {
+		try_to_freeze();
+
+		/* resume_console() wakes us up */
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (slow_con_start == log_end || console_suspended)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		console_lock();
+		console_flush_slow = 1;
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init console_async_init(void)
+{
+	struct task_struct *task;
+
+	if (!printk_async)
+		return 0;
+
+	task = kthread_run(console_async_thread, NULL, "kconsoled");
+	if (IS_ERR(task)) {
+		pr_err("printk: no console thread, consoles stay synchronous\n");
+		return PTR_ERR(task);
+	}
+	console_async_task = task;
+
+	return 0;
+}
+core_initcall(console_async_init);
+
 #if defined CONFIG_PRINTK
 
 /*
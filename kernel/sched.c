@@ -72,6 +72,7 @@
 #include <linux/ftrace.h>
 #include <linux/slab.h>
 #include <linux/cpuacct.h>
+#include <linux/cpufreq.h>
 
 #include <asm/tlb.h>
 #include <asm/irq_regs.h>
@@ -257,6 +258,12 @@ struct task_group {
 	unsigned long shares;
 
 	atomic_t load_weight;
+
+	/*
+	 * Tasks of this group waking up preempt those of groups without it,
+	 * while no more than this many ns of vruntime ahead of them.
+	 */
+	u64 wakeup_boost;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -328,6 +335,8 @@ struct cfs_rq {
 	 * It is set to NULL otherwise (i.e when none are currently running).
 	 */
 	struct sched_entity *curr, *next, *last, *skip;
+	/* wakeup_boost of the task that set next, see check_preempt_wakeup() */
+	u64 next_boost;
 
 #ifdef	CONFIG_SCHED_DEBUG
 	unsigned int nr_spread_over;
@@ -474,6 +483,12 @@ struct rq {
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
+	/* nr_running integrated over rq->clock, see sched_get_nr_running_sum */
+	u64 nr_running_sum;
+	u64 nr_running_stamp;
+	/* time with nr_running > 0, up to nr_running_stamp */
+	u64 busy_sum;
+
 	struct cfs_rq cfs;
 	struct rt_rq rt;
 
@@ -1780,13 +1795,27 @@ static const struct sched_class rt_sched_class;
 
 #include "sched_stats.h"
 
+/* rq->clock is current for every enqueue and dequeue */
+static void update_nr_running_sum(struct rq *rq)
+{
+	if (rq->clock > rq->nr_running_stamp) {
+		rq->nr_running_sum += (rq->clock - rq->nr_running_stamp) *
+				      rq->nr_running;
+		if (rq->nr_running)
+			rq->busy_sum += rq->clock - rq->nr_running_stamp;
+	}
+	rq->nr_running_stamp = rq->clock;
+}
+
 static void inc_nr_running(struct rq *rq)
 {
+	update_nr_running_sum(rq);
 	rq->nr_running++;
 }
 
 static void dec_nr_running(struct rq *rq)
 {
+	update_nr_running_sum(rq);
 	rq->nr_running--;
 }
 
@@ -2027,6 +2056,17 @@ static void update_rq_clock_task(struct rq *rq, s64 delta)
 
 #endif /* CONFIG_IRQ_TIME_ACCOUNTING */
 
+#ifdef CONFIG_SMP
+/* online cpus given no work, see sched_cpu_soft_offline() */
+static DECLARE_BITMAP(cpu_soft_offline_bits, CONFIG_NR_CPUS) __read_mostly;
+#define cpu_soft_offline_mask	to_cpumask(cpu_soft_offline_bits)
+
+static inline bool cpu_soft_offline(int cpu)
+{
+	return unlikely(cpumask_test_cpu(cpu, cpu_soft_offline_mask));
+}
+#endif
+
 #include "sched_idletask.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
@@ -2402,6 +2442,21 @@ static int select_fallback_rq(int cpu, struct task_struct *p)
 	return dest_cpu;
 }
 
+/*
+ * Any allowed cpu that is not soft offline, or @cpu if the task is bound
+ * to soft offline cpus: they still run their own per-cpu work.
+ */
+static int select_soft_online_rq(struct task_struct *p, int cpu)
+{
+	int dest_cpu;
+
+	for_each_cpu_and(dest_cpu, &p->cpus_allowed, cpu_active_mask)
+		if (!cpu_soft_offline(dest_cpu))
+			return dest_cpu;
+
+	return cpu;
+}
+
 /*
  * The caller (fork, wakeup) owns p->pi_lock, ->cpus_allowed is stable.
  */
@@ -2424,6 +2479,9 @@ int select_task_rq(struct task_struct *p, int sd_flags, int wake_flags)
 		     !cpu_online(cpu)))
 		cpu = select_fallback_rq(task_cpu(p), p);
 
+	if (cpu_soft_offline(cpu))
+		cpu = select_soft_online_rq(p, cpu);
+
 	return cpu;
 }
 
@@ -3008,6 +3066,7 @@ prepare_task_switch(struct rq *rq, struct task_struct *prev,
 		    struct task_struct *next)
 {
 	sched_info_switch(prev, next);
+	cpufreq_uid_task_switch(next);
 	perf_event_task_sched_out(prev, next);
 	fire_sched_out_preempt_notifiers(prev, next);
 	prepare_lock_switch(rq, next);
@@ -3205,6 +3264,46 @@ unsigned long nr_running(void)
 	return sum;
 }
 
+/**
+ * sched_get_nr_running_sum - runqueue length of a cpu integrated over time
+ * @cpu: the cpu to sample
+ * @stamp: returns the time of the sample, in ns
+ *
+ * Returns the sum of nr_running over every ns up to @stamp.  The
+ * difference between two samples divided by the time between them is
+ * the average number of tasks running or waiting to run on @cpu, a
+ * measure of demand that, unlike idle time, goes beyond one.
+ */
+u64 sched_get_nr_running_sum(int cpu, u64 *stamp)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+	u64 sum;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	update_nr_running_sum(rq);
+	sum = rq->nr_running_sum;
+	*stamp = rq->nr_running_stamp;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return sum;
+}
+EXPORT_SYMBOL_GPL(sched_get_nr_running_sum);
+
+/**
+ * sched_pack_tasks_enabled - whether the PACK_TASKS feature is set
+ *
+ * With packing, the secondary cpus only get work when the first one
+ * is busy, and otherwise stay in deep idle: there is little to gain
+ * from taking them offline.
+ */
+bool sched_pack_tasks_enabled(void)
+{
+	return sched_feat(PACK_TASKS);
+}
+EXPORT_SYMBOL_GPL(sched_pack_tasks_enabled);
+
 unsigned long nr_uninterruptible(void)
 {
 	unsigned long i, sum = 0;
@@ -6135,6 +6234,125 @@ static int migration_cpu_stop(void *data)
 	return 0;
 }
 
+/*
+ * A soft offline cpu stays online, with its per-cpu threads, timers and
+ * bound users, but is given no other work so that it can stay in deep
+ * idle.  Unlike cpu_down() no notifier chain runs either way, and
+ * sched_cpu_soft_online() gets it back within a reschedule IPI.
+ */
+static DEFINE_MUTEX(soft_offline_mutex);
+
+/* Push one task queued on @cpu elsewhere, returns 0 once there is none */
+static int soft_offline_push_one(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	struct task_struct *g, *p, *found = NULL;
+	struct migration_arg arg;
+	int dest_cpu = cpu;
+
+	rcu_read_lock();
+	do_each_thread(g, p) {
+		if (!p->on_rq || task_cpu(p) != cpu || p == rq->idle ||
+		    p == rq->stop || (p->flags & PF_THREAD_BOUND))
+			continue;
+		dest_cpu = select_soft_online_rq(p, cpu);
+		if (dest_cpu != cpu) {
+			get_task_struct(p);
+			found = p;
+			goto out;
+		}
+	} while_each_thread(g, p);
+out:
+	rcu_read_unlock();
+
+	if (!found)
+		return 0;
+
+	arg.task = found;
+	arg.dest_cpu = dest_cpu;
+	stop_one_cpu(cpu, migration_cpu_stop, &arg);
+	put_task_struct(found);
+
+	return 1;
+}
+
+/**
+ * sched_cpu_soft_offline - stop giving work to a cpu, but keep it online
+ * @cpu: the cpu to park
+ *
+ * Tasks queued on @cpu are moved away, later wakeups and load balancing
+ * pick other cpus.  Tasks bound to @cpu keep running there.  Fails with
+ * -EBUSY if no other cpu would be left to run the work.  May sleep.
+ */
+int sched_cpu_soft_offline(int cpu)
+{
+	int i, ret = 0;
+
+	get_online_cpus();
+	mutex_lock(&soft_offline_mutex);
+
+	if (!cpu_active(cpu)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (cpu_soft_offline(cpu))
+		goto out;
+
+	for_each_cpu(i, cpu_active_mask)
+		if (i != cpu && !cpu_soft_offline(i))
+			break;
+	if (i >= nr_cpu_ids) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	cpumask_set_cpu(cpu, cpu_soft_offline_mask);
+	/* wakeups which raced with the update are pushed below */
+	synchronize_sched();
+
+	for (i = 0; i < nr_threads && soft_offline_push_one(cpu); i++)
+		;
+out:
+	mutex_unlock(&soft_offline_mutex);
+	put_online_cpus();
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sched_cpu_soft_offline);
+
+/**
+ * sched_cpu_soft_online - give work to a soft offline cpu again
+ * @cpu: the cpu to unpark
+ *
+ * Kicks @cpu out of idle so it pulls work at once.  Can be called from
+ * any context.
+ */
+void sched_cpu_soft_online(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+
+	if (!cpumask_test_and_clear_cpu(cpu, cpu_soft_offline_mask))
+		return;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	resched_task(cpu_curr(cpu));
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_soft_online);
+
+bool cpu_is_soft_offline(int cpu)
+{
+	return cpu_soft_offline(cpu);
+}
+EXPORT_SYMBOL_GPL(cpu_is_soft_offline);
+
+unsigned int num_soft_offline_cpus(void)
+{
+	return cpumask_weight(cpu_soft_offline_mask);
+}
+EXPORT_SYMBOL_GPL(num_soft_offline_cpus);
+
 #ifdef CONFIG_HOTPLUG_CPU
 
 /*
@@ -6504,6 +6722,8 @@ static int __cpuinit sched_cpu_inactive(struct notifier_block *nfb,
 	switch (action & ~CPU_TASKS_FROZEN) {
 	case CPU_DOWN_PREPARE:
 		set_cpu_active((long)hcpu, false);
+		/* not parked any more once it comes back */
+		cpumask_clear_cpu((long)hcpu, cpu_soft_offline_mask);
 		return NOTIFY_OK;
 	default:
 		return NOTIFY_DONE;
@@ -9012,6 +9232,21 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) scale_load_down(tg->shares);
 }
+
+static int cpu_wakeup_boost_write_u64(struct cgroup *cgrp,
+				      struct cftype *cftype, u64 boost_us)
+{
+	if (boost_us > USEC_PER_SEC)
+		return -EINVAL;
+
+	cgroup_tg(cgrp)->wakeup_boost = boost_us * NSEC_PER_USEC;
+	return 0;
+}
+
+static u64 cpu_wakeup_boost_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return div_u64(cgroup_tg(cgrp)->wakeup_boost, NSEC_PER_USEC);
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9045,6 +9280,11 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "wakeup_boost_us",
+		.read_u64 = cpu_wakeup_boost_read_u64,
+		.write_u64 = cpu_wakeup_boost_write_u64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -82,6 +82,13 @@ unsigned int normalized_sysctl_sched_wakeup_granularity = 1000000UL;
 
 const_debug unsigned int sysctl_sched_migration_cost = 500000UL;
 
+/*
+ * Busy percentage of the first cpu under which tasks are packed on it,
+ * when the PACK_TASKS feature is set.
+ * (default: 60%)
+ */
+const_debug unsigned int sysctl_sched_pack_util = 60;
+
 /*
  * The exponential sliding  window over which load is averaged for shares
  * distribution.
@@ -1017,9 +1024,10 @@ static void __clear_buddies_next(struct sched_entity *se)
 {
 	for_each_sched_entity(se) {
 		struct cfs_rq *cfs_rq = cfs_rq_of(se);
-		if (cfs_rq->next == se)
+		if (cfs_rq->next == se) {
 			cfs_rq->next = NULL;
-		else
+			cfs_rq->next_boost = 0;
+		} else
 			break;
 	}
 }
@@ -1165,6 +1173,17 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 static int
 wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se);
 
+/*
+ * A boosted wakeup may run ahead of curr by up to the boost, see
+ * check_preempt_wakeup().
+ */
+static inline int
+wakeup_boost_entity(struct sched_entity *curr, struct sched_entity *se,
+		    u64 boost)
+{
+	return boost && (s64)(se->vruntime - curr->vruntime) < (s64)boost;
+}
+
 /*
  * Pick the next process, keeping these things in mind, in this order:
  * 1) keep things fair between processes/task groups
@@ -1196,7 +1215,8 @@ static struct sched_entity *pick_next_entity(struct cfs_rq *cfs_rq)
 	/*
 	 * Someone really wants this to run. If it's not unfair, run it.
 	 */
-	if (cfs_rq->next && wakeup_preempt_entity(cfs_rq->next, left) < 1)
+	if (cfs_rq->next && (wakeup_preempt_entity(cfs_rq->next, left) < 1 ||
+	    wakeup_boost_entity(left, cfs_rq->next, cfs_rq->next_boost)))
 		se = cfs_rq->next;
 
 	clear_buddies(cfs_rq, se);
@@ -1675,6 +1695,85 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	return target;
 }
 
+/*
+ * Task packing (PACK_TASKS): while the first active cpu is busy less
+ * than sysctl_sched_pack_util percent of the time, wakeups and new tasks
+ * are placed on it and the other cpus do not pull work from it, so that
+ * they can stay in their deepest idle state.  Normal balancing resumes
+ * as soon as it gets busier than that; packing comes back once it is
+ * SCHED_PACK_HYSTERESIS points below again.
+ */
+#define SCHED_PACK_WINDOW	(20 * NSEC_PER_MSEC)
+#define SCHED_PACK_HYSTERESIS	10
+
+static DEFINE_RAW_SPINLOCK(sched_pack_lock);
+static int sched_pack_cpu = -1;
+static bool sched_pack_active;
+static u64 sched_pack_stamp;
+static u64 sched_pack_busy;
+
+/* Sample the busy time of the packing cpu once per window */
+static void sched_pack_update(void)
+{
+	int cpu = cpumask_first(cpu_active_mask);
+	struct rq *rq = cpu_rq(cpu);
+	unsigned int util = 100;
+	u64 now, busy;
+
+	now = cpu_clock(cpu);
+	if (cpu == sched_pack_cpu && now >= sched_pack_stamp &&
+	    now - sched_pack_stamp < SCHED_PACK_WINDOW)
+		return;
+
+	if (!raw_spin_trylock(&sched_pack_lock))
+		return;
+
+	/* unlocked read of a remote rq: a torn value only skews one window */
+	busy = rq->busy_sum;
+	if (rq->nr_running && now > rq->nr_running_stamp)
+		busy += now - rq->nr_running_stamp;
+
+	if (cpu != sched_pack_cpu) {
+		sched_pack_cpu = cpu;
+		sched_pack_active = false;
+	} else if (now > sched_pack_stamp && busy >= sched_pack_busy) {
+		util = min_t(u64, div64_u64((busy - sched_pack_busy) * 100,
+					    now - sched_pack_stamp), 100);
+		if (util > sysctl_sched_pack_util)
+			sched_pack_active = false;
+		else if (util + SCHED_PACK_HYSTERESIS <= sysctl_sched_pack_util)
+			sched_pack_active = true;
+	}
+	sched_pack_stamp = now;
+	sched_pack_busy = busy;
+
+	raw_spin_unlock(&sched_pack_lock);
+}
+
+/* Returns the cpu to pack @p on, or -1 to balance normally */
+static int sched_pack_target(struct task_struct *p)
+{
+	if (!sched_feat(PACK_TASKS))
+		return -1;
+
+	sched_pack_update();
+	if (!sched_pack_active ||
+	    !cpumask_test_cpu(sched_pack_cpu, &p->cpus_allowed))
+		return -1;
+
+	return sched_pack_cpu;
+}
+
+/* Whether @cpu should leave the packing cpu's work alone */
+static inline int sched_pack_no_pull(int cpu)
+{
+	if (!sched_feat(PACK_TASKS))
+		return 0;
+
+	sched_pack_update();
+	return sched_pack_active && cpu != sched_pack_cpu;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -1697,6 +1796,11 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	int want_sd = 1;
 	int sync = wake_flags & WF_SYNC;
 
+	new_cpu = sched_pack_target(p);
+	if (new_cpu >= 0)
+		return new_cpu;
+	new_cpu = cpu;
+
 	if (sd_flag & SD_BALANCE_WAKE) {
 		if (cpumask_test_cpu(cpu, &p->cpus_allowed))
 			want_affine = 1;
@@ -1869,8 +1973,34 @@ static void set_next_buddy(struct sched_entity *se)
 	if (entity_is_task(se) && unlikely(task_of(se)->policy == SCHED_IDLE))
 		return;
 
-	for_each_sched_entity(se)
+	for_each_sched_entity(se) {
 		cfs_rq_of(se)->next = se;
+		cfs_rq_of(se)->next_boost = 0;
+	}
+}
+
+/* Like set_next_buddy(), the task preempting under a wakeup boost */
+static void set_next_buddy_boost(struct sched_entity *se, u64 boost)
+{
+	for_each_sched_entity(se) {
+		cfs_rq_of(se)->next = se;
+		cfs_rq_of(se)->next_boost = boost;
+	}
+}
+
+/*
+ * The wakeup boost p has over curr: that of its task group, if the group
+ * of curr has none.
+ */
+static u64 wakeup_boost(struct task_struct *curr, struct task_struct *p)
+{
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	u64 boost = task_group(p)->wakeup_boost;
+
+	if (boost && !task_group(curr)->wakeup_boost)
+		return boost;
+#endif
+	return 0;
 }
 
 static void set_skip_buddy(struct sched_entity *se)
@@ -1889,6 +2019,7 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	struct cfs_rq *cfs_rq = task_cfs_rq(curr);
 	int scale = cfs_rq->nr_running >= sched_nr_latency;
 	int next_buddy_marked = 0;
+	u64 boost;
 
 	if (unlikely(se == pse))
 		return;
@@ -1934,6 +2065,18 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 		goto preempt;
 	}
 
+	/*
+	 * Latency sensitive groups, foreground apps for instance, get on
+	 * the CPU right away instead of waiting out the granularity, as
+	 * long as their lead in vruntime stays within the boost. The buddy
+	 * carries the boost so that pick_next_entity() honours it too.
+	 */
+	boost = wakeup_boost(curr, p);
+	if (wakeup_boost_entity(se, pse, boost)) {
+		set_next_buddy_boost(&p->se, boost);
+		goto preempt;
+	}
+
 	return;
 
 preempt:
@@ -3342,6 +3485,10 @@ static int load_balance(int this_cpu, struct rq *this_rq,
 	unsigned long flags;
 	struct cpumask *cpus = __get_cpu_var(load_balance_tmpmask);
 
+	/* keep the other cpus idle while tasks are packed */
+	if (sched_pack_no_pull(this_cpu))
+		return 0;
+
 	cpumask_copy(cpus, cpu_active_mask);
 
 	schedstat_inc(sd, lb_count[idle]);
@@ -3498,6 +3645,9 @@ static void idle_balance(int this_cpu, struct rq *this_rq)
 	if (this_rq->avg_idle < sysctl_sched_migration_cost)
 		return;
 
+	if (cpu_soft_offline(this_cpu))
+		return;
+
 	/*
 	 * Drop the rq->lock, but keep IRQ/preempt disabled.
 	 */
@@ -3895,6 +4045,10 @@ static void rebalance_domains(int cpu, enum cpu_idle_type idle)
 	int update_next_balance = 0;
 	int need_serialize;
 
+	/* a soft offline cpu pulls no work */
+	if (cpu_soft_offline(cpu))
+		return;
+
 	update_shares(cpu);
 
 	rcu_read_lock();
@@ -4021,6 +4175,10 @@ static inline int nohz_kick_needed(struct rq *rq, int cpu)
 	if (rq->idle_at_tick)
 		return 0;
 
+	/* no point in waking an idle cpu that may not pull anything */
+	if (sched_feat(PACK_TASKS) && sched_pack_active)
+		return 0;
+
 	first_pick_cpu = atomic_read(&nohz.first_pick_cpu);
 	second_pick_cpu = atomic_read(&nohz.second_pick_cpu);
 
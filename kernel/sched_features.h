@@ -72,3 +72,9 @@ SCHED_FEAT(NONIRQ_POWER, 1)
 SCHED_FEAT(TTWU_QUEUE, 1)
 
 SCHED_FEAT(FORCE_SD_OVERLAP, 0)
+
+/*
+ * Pack tasks on the first cpu while it is lightly loaded, so that the
+ * others stay idle, see sched_pack_update().
+ */
+SCHED_FEAT(PACK_TASKS, 0)
@@ -1249,6 +1249,11 @@ static int find_lowest_rq(struct task_struct *task)
 	if (!cpupri_find(&task_rq(task)->rd->cpupri, task, lowest_mask))
 		return -1; /* No targets found */
 
+	/* soft offline cpus take no work, see sched_cpu_soft_offline() */
+	cpumask_andnot(lowest_mask, lowest_mask, cpu_soft_offline_mask);
+	if (cpumask_empty(lowest_mask))
+		return -1;
+
 	/*
 	 * At this point we have built a mask of cpus representing the
 	 * lowest priority tasks in the system.  Now we want to elect
@@ -1480,6 +1485,10 @@ static int pull_rt_task(struct rq *this_rq)
 	if (likely(!rt_overloaded(this_rq)))
 		return 0;
 
+	/* a soft offline cpu pulls no work */
+	if (cpu_soft_offline(this_cpu))
+		return 0;
+
 	for_each_cpu(cpu, this_rq->rd->rto_mask) {
 		if (this_cpu == cpu)
 			continue;
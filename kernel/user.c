@@ -16,6 +16,7 @@
 #include <linux/interrupt.h>
 #include <linux/module.h>
 #include <linux/user_namespace.h>
+#include <linux/cpufreq.h>
 
 /*
  * userns count is 1 for root user, 1 for init_uts_ns,
@@ -152,6 +153,9 @@ struct user_struct *alloc_uid(struct user_namespace *ns, uid_t uid)
 
 		new->uid = uid;
 		atomic_set(&new->__count, 1);
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+		new->cpufreq_stats = cpufreq_uid_stats_get(uid);
+#endif
 
 		new->user_ns = get_user_ns(ns);
 
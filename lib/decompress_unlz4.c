@@ -0,0 +1,176 @@
+/*
+ * LZ4 decompressor for the Linux kernel, reading the legacy frame
+ * format written by "lz4 -l" (formerly "lz4c -l").
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifdef STATIC
+#define PREBOOT
+#include "lz4/lz4_decompress.c"
+#else
+#include <linux/decompress/unlz4.h>
+#endif
+
+#include <linux/types.h>
+#include <linux/lz4.h>
+#include <linux/decompress/mm.h>
+
+#include <linux/compiler.h>
+#include <asm/unaligned.h>
+
+/*
+ * The legacy format is the magic number followed by blocks, each of them
+ * a 32-bit little endian compressed size and the compressed data, which
+ * decompresses to 8MB except for the last block.  There is no end mark:
+ * the stream ends with the input, or at the 4-byte uncompressed size
+ * that the kernel build appends to it.
+ */
+#define LZ4_LEGACY_MAGIC	0x184c2102
+#define LZ4_LEGACY_BLOCK_SIZE	(8 << 20)
+
+STATIC inline int INIT unlz4(u8 *input, int in_len,
+				int (*fill) (void *, unsigned int),
+				int (*flush) (void *, unsigned int),
+				u8 *output, int *posp,
+				void (*error) (char *x))
+{
+	size_t max_src = lz4_compressbound(LZ4_LEGACY_BLOCK_SIZE);
+	size_t src_len, dst_len;
+	u8 *in_buf, *out_buf;
+	int size = in_len;
+	int skip;
+	int ret = -1;
+#ifdef PREBOOT
+	size_t out_len = get_unaligned_le32(input + in_len - 4);
+#endif
+
+	if (output) {
+		out_buf = output;
+	} else if (!flush) {
+		error("NULL output pointer and no flush function provided");
+		goto exit;
+	} else {
+		out_buf = large_malloc(LZ4_LEGACY_BLOCK_SIZE);
+		if (!out_buf) {
+			error("Could not allocate output buffer");
+			goto exit;
+		}
+	}
+
+	if (input && fill) {
+		error("Both input pointer and fill function provided, don't know what to do");
+		goto exit_1;
+	} else if (input) {
+		in_buf = input;
+	} else if (!fill) {
+		error("NULL input pointer and missing fill function");
+		goto exit_1;
+	} else {
+		in_buf = large_malloc(max_src);
+		if (!in_buf) {
+			error("Could not allocate input buffer");
+			goto exit_1;
+		}
+	}
+
+	if (posp)
+		*posp = 0;
+
+	if (fill)
+		size = fill(in_buf, 4);
+	if (size < 4 || get_unaligned_le32(in_buf) != LZ4_LEGACY_MAGIC) {
+		error("invalid header");
+		goto exit_2;
+	}
+	if (!fill) {
+		in_buf += 4;
+		size -= 4;
+	}
+	if (posp)
+		*posp += 4;
+
+	for (;;) {
+		if (fill) {
+			size = fill(in_buf, 4);
+			if (size < 4)
+				break;
+		}
+		/* a trailing size field, or nothing at all */
+		if (!fill && size <= 4) {
+			if (posp)
+				*posp += size;
+			break;
+		}
+
+		src_len = get_unaligned_le32(in_buf);
+		if (src_len == LZ4_LEGACY_MAGIC) {
+			/* concatenated streams */
+			if (!fill) {
+				in_buf += 4;
+				size -= 4;
+			}
+			if (posp)
+				*posp += 4;
+			continue;
+		}
+		if (!fill) {
+			in_buf += 4;
+			size -= 4;
+		}
+
+		if (src_len == 0 || src_len > max_src) {
+			error("file corrupted");
+			goto exit_2;
+		}
+		if (fill) {
+			size = fill(in_buf, src_len);
+			if (size < 0)
+				goto exit_2;
+		}
+		if ((size_t)size < src_len) {
+			error("file corrupted");
+			goto exit_2;
+		}
+
+		dst_len = LZ4_LEGACY_BLOCK_SIZE;
+#ifdef PREBOOT
+		/* the image is decompressed in place, don't run past its end */
+		if (dst_len > out_len)
+			dst_len = out_len;
+#endif
+		if (lz4_decompress(in_buf, src_len, out_buf, &dst_len)) {
+			error("Compressed data violation");
+			goto exit_2;
+		}
+#ifdef PREBOOT
+		out_len -= dst_len;
+#endif
+
+		if (flush && flush(out_buf, dst_len) != dst_len)
+			goto exit_2;
+		if (output)
+			out_buf += dst_len;
+		if (posp)
+			*posp += src_len + 4;
+
+		if (!fill) {
+			in_buf += src_len;
+			size -= src_len;
+		}
+	}
+
+	ret = 0;
+exit_2:
+	if (!input)
+		large_free(in_buf);
+exit_1:
+	if (!output)
+		large_free(out_buf);
+exit:
+	return ret;
+}
+
+#define decompress unlz4
@@ -214,3 +214,41 @@ void gen_pool_free(struct gen_pool *pool, unsigned long addr, size_t size)
 	read_unlock(&pool->lock);
 }
 EXPORT_SYMBOL(gen_pool_free);
+
+/**
+ * gen_pool_largest_free - size of the largest free block in the pool
+ * @pool: pool to look at
+ *
+ * Return the number of bytes the largest allocation that could currently
+ * succeed could have, which tells how fragmented the pool is.
+ */
+size_t gen_pool_largest_free(struct gen_pool *pool)
+{
+	struct list_head *_chunk;
+	struct gen_pool_chunk *chunk;
+	unsigned long flags;
+	int order = pool->min_alloc_order;
+	int start_bit, end_bit, next_bit;
+	size_t max = 0;
+
+	read_lock(&pool->lock);
+	list_for_each(_chunk, &pool->chunks) {
+		chunk = list_entry(_chunk, struct gen_pool_chunk, next_chunk);
+
+		end_bit = (chunk->end_addr - chunk->start_addr) >> order;
+
+		spin_lock_irqsave(&chunk->lock, flags);
+		start_bit = find_next_zero_bit(chunk->bits, end_bit, 0);
+		while (start_bit < end_bit) {
+			next_bit = find_next_bit(chunk->bits, end_bit, start_bit);
+			max = max_t(size_t, max, next_bit - start_bit);
+			start_bit = find_next_zero_bit(chunk->bits, end_bit,
+						       next_bit);
+		}
+		spin_unlock_irqrestore(&chunk->lock, flags);
+	}
+	read_unlock(&pool->lock);
+
+	return max << order;
+}
+EXPORT_SYMBOL(gen_pool_largest_free);
@@ -0,0 +1,148 @@
+/*
+ *  LZ4 Compressor for the Linux kernel
+ *
+ *  A single pass, greedy parser with a 4K entry hash table, compatible
+ *  with the "-c0/-c1" output of the reference lz4 tool.
+ *
+ *  LZ4 is designed by Yann Collet: http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <asm/unaligned.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(const u8 *p)
+{
+	return (A32(p) * 2654435761U) >> (32 - HASH_LOG);
+}
+
+static inline u8 *lz4_put_length(u8 *op, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		*op++ = 255;
+	*op++ = length;
+
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *table = wrkmem;
+	const u8 *ip = src;
+	const u8 *anchor = src;
+	const u8 * const iend = src + src_len;
+	const u8 * const mflimit = iend - MFLIMIT;
+	const u8 * const matchlimit = iend - LASTLITERALS;
+	u8 *op = dst;
+	u8 *token;
+	const u8 *ref;
+	size_t length;
+	u32 h;
+
+	memset(table, 0, LZ4_MEM_COMPRESS);
+
+	if (src_len < MINLENGTH)
+		goto last_literals;
+
+	table[lz4_hash(ip)] = 0;
+	ip++;
+
+	for (;;) {
+		unsigned int attempts = (1U << SKIPSTRENGTH) + 3;
+		const u8 *forward = ip;
+
+		/* find a match, skipping faster over incompressible data */
+		do {
+			ip = forward;
+			if (unlikely(ip > mflimit))
+				goto last_literals;
+			forward += attempts++ >> SKIPSTRENGTH;
+
+			h = lz4_hash(ip);
+			ref = src + table[h];
+			table[h] = ip - src;
+		} while (ref + MAX_DISTANCE < ip || A32(ref) != A32(ip));
+
+		/* extend it backwards */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* literal run */
+		length = ip - anchor;
+		token = op++;
+		if (length >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, length - RUN_MASK);
+		} else {
+			*token = length << ML_BITS;
+		}
+		memcpy(op, anchor, length);
+		op += length;
+
+next_match:
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+
+		length = ip - anchor;
+		if (length >= ML_MASK) {
+			*token += ML_MASK;
+			op = lz4_put_length(op, length - ML_MASK);
+		} else {
+			*token += length;
+		}
+
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+
+		table[lz4_hash(ip - 2)] = ip - 2 - src;
+
+		/* a match right away needs no literals */
+		h = lz4_hash(ip);
+		ref = src + table[h];
+		table[h] = ip - src;
+		if (ref + MAX_DISTANCE >= ip && A32(ref) == A32(ip)) {
+			token = op++;
+			*token = 0;
+			goto next_match;
+		}
+
+		ip++;
+	}
+
+last_literals:
+	length = iend - anchor;
+	if (length >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, length - RUN_MASK);
+	} else {
+		*op++ = length << ML_BITS;
+	}
+	memcpy(op, anchor, length);
+	op += length;
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
@@ -0,0 +1,147 @@
+/*
+ *  LZ4 Decompressor for the Linux kernel
+ *
+ *  LZ4 is designed by Yann Collet: http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+#include <asm/unaligned.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+/*
+ * Distance that a match with an offset below 8 is rewound to once its
+ * first 8 bytes have been copied one by one: the smallest multiple of the
+ * offset that lets the rest be copied 8 bytes at a time.
+ */
+static const u8 lz4_stride[8] = { 0, 8, 8, 9, 8, 10, 12, 14 };
+
+int lz4_decompress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len)
+{
+	const u8 *ip = src;
+	const u8 * const iend = ip + src_len;
+	u8 *op = dst;
+	u8 * const oend = op + *dst_len;
+	const u8 *ref;
+	u8 *cpy;
+	size_t length, offset;
+	unsigned int token, s;
+
+	for (;;) {
+		if (ip >= iend)
+			goto input_overrun;
+		token = *ip++;
+
+		/* literal run */
+		length = token >> ML_BITS;
+		if (length == RUN_MASK) {
+			do {
+				if (ip >= iend)
+					goto input_overrun;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+
+		if (length > (size_t)(iend - ip))
+			goto input_overrun;
+		if (length > (size_t)(oend - op))
+			goto output_overrun;
+
+		cpy = op + length;
+		if (cpy > oend - COPYLENGTH || ip + length > iend - COPYLENGTH) {
+			memcpy(op, ip, length);
+			ip += length;
+			op = cpy;
+			if (ip == iend)
+				break;	/* the last sequence has no match */
+		} else {
+			LZ4_WILDCOPY(op, ip, cpy);
+			ip -= op - cpy;
+			op = cpy;
+		}
+
+		/* match */
+		if (iend - ip < 2)
+			goto input_overrun;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			goto lookbehind_overrun;
+		ref = op - offset;
+
+		length = token & ML_MASK;
+		if (length == ML_MASK) {
+			do {
+				if (ip >= iend)
+					goto input_overrun;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+		length += MINMATCH;
+
+		if (length > (size_t)(oend - op))
+			goto output_overrun;
+
+		cpy = op + length;
+		if (cpy > oend - COPYLENGTH) {
+			while (op < cpy)
+				*op++ = *ref++;
+			continue;
+		}
+
+		if (unlikely(offset < 8)) {
+			op[0] = ref[0];
+			op[1] = ref[1];
+			op[2] = ref[2];
+			op[3] = ref[3];
+			op[4] = ref[4];
+			op[5] = ref[5];
+			op[6] = ref[6];
+			op[7] = ref[7];
+			op += 8;
+			ref = op - lz4_stride[offset];
+		} else {
+			LZ4_COPY8(op, ref);
+			op += 8;
+			ref += 8;
+		}
+		if (op < cpy)
+			LZ4_WILDCOPY(op, ref, cpy);
+		op = cpy;
+	}
+
+	*dst_len = op - dst;
+	return 0;
+
+input_overrun:
+	*dst_len = op - dst;
+	return -1;
+
+output_overrun:
+	*dst_len = op - dst;
+	return -2;
+
+lookbehind_overrun:
+	*dst_len = op - dst;
+	return -3;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ *  lz4defs.h -- format constants and copy helpers shared by the LZ4
+ *  compressor and decompressor
+ *
+ *  LZ4 is designed by Yann Collet: http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+/*
+ * A sequence is a token, the literal run, a 16-bit little endian match
+ * offset and the match length.  The token holds the literal run length in
+ * its high nibble and the match length minus MINMATCH in its low one; a
+ * nibble of 15 is continued by bytes of 255 and a final byte below 255.
+ * The last sequence of a block is literals only.
+ */
+#define MINMATCH	4
+
+#define COPYLENGTH	8
+#define LASTLITERALS	5
+#define MFLIMIT		(COPYLENGTH + MINMATCH)
+#define MINLENGTH	(MFLIMIT + 1)
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define MAX_DISTANCE	65535
+
+#define HASH_LOG	12
+#define SKIPSTRENGTH	6
+
+#define A32(p)		get_unaligned((const u32 *)(p))
+
+#define LZ4_COPY8(d, s)							\
+	do {								\
+		put_unaligned(A32(s), (u32 *)(d));			\
+		put_unaligned(A32((s) + 4), (u32 *)((d) + 4));		\
+	} while (0)
+
+/* may write up to 7 bytes past e */
+#define LZ4_WILDCOPY(d, s, e)						\
+	do {								\
+		LZ4_COPY8(d, s);					\
+		d += 8;							\
+		s += 8;							\
+	} while (d < e)
@@ -13,6 +13,7 @@
 
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/string.h>
 #include <linux/lzo.h>
 #include <asm/unaligned.h>
 #include "lzodefs.h"
@@ -93,9 +94,9 @@ match:
 				}
 				*op++ = tt;
 			}
-			do {
-				*op++ = *ii++;
-			} while (--t > 0);
+			memcpy(op, ii, t);
+			op += t;
+			ii += t;
 		}
 
 		ip += 3;
@@ -125,6 +126,14 @@ match:
 			end = in_end;
 			m = m_pos + M2_MAX_LEN + 1;
 
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+			while (end - ip >= 4 &&
+			       get_unaligned((const u32 *)m) ==
+			       get_unaligned((const u32 *)ip)) {
+				m += 4;
+				ip += 4;
+			}
+#endif
 			while (ip < end && *m == *ip) {
 				m++;
 				ip++;
@@ -207,9 +216,8 @@ int lzo1x_1_compress(const unsigned char *in, size_t in_len, unsigned char *out,
 
 			*op++ = tt;
 		}
-		do {
-			*op++ = *ii++;
-		} while (--t > 0);
+		memcpy(op, ii, t);
+		op += t;
 	}
 
 	*op++ = M4_MARKER | 1;
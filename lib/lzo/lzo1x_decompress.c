@@ -14,6 +14,7 @@
 #ifndef STATIC
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/string.h>
 #endif
 
 #include <asm/unaligned.h>
@@ -27,6 +28,22 @@
 #define COPY4(dst, src)	\
 		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
 
+/*
+ * Two word copies rather than one u64 access: with hardware unaligned
+ * access this is LDR/STR, where a 64-bit access could become LDRD/STRD
+ * which still trap on unaligned addresses.  Also fine for overlapping
+ * matches as long as the distance is at least 4.
+ */
+#define COPY8(dst, src)	\
+		do { COPY4(dst, src); COPY4((dst) + 4, (src) + 4); } while (0)
+
+/*
+ * Literal runs and non-overlapping matches from this length on go to
+ * memcpy(), which moves cache lines at a time and uses NEON where the
+ * architecture provides it.
+ */
+#define LZO_MEMCPY_MIN	64
+
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
 {
@@ -72,26 +89,27 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 		if (HAVE_IP(t + 4, ip_end, ip))
 			goto input_overrun;
 
-		COPY4(op, ip);
-		op += 4;
-		ip += 4;
-		if (--t > 0) {
+		t += 3;
+		if (t >= LZO_MEMCPY_MIN) {
+			memcpy(op, ip, t);
+			op += t;
+			ip += t;
+		} else {
+			while (t >= 8) {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+				t -= 8;
+			}
 			if (t >= 4) {
-				do {
-					COPY4(op, ip);
-					op += 4;
-					ip += 4;
-					t -= 4;
-				} while (t >= 4);
-				if (t > 0) {
-					do {
-						*op++ = *ip++;
-					} while (--t > 0);
-				}
-			} else {
-				do {
-					*op++ = *ip++;
-				} while (--t > 0);
+				COPY4(op, ip);
+				op += 4;
+				ip += 4;
+				t -= 4;
+			}
+			while (t > 0) {
+				*op++ = *ip++;
+				t--;
 			}
 		}
 
@@ -184,20 +202,30 @@ match:
 				goto output_overrun;
 
 			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
-				COPY4(op, m_pos);
-				op += 4;
-				m_pos += 4;
-				t -= 4 - (3 - 1);
+				t += 3 - 1;
+				if (t >= LZO_MEMCPY_MIN &&
+				    (size_t)(op - m_pos) >= t) {
+					/* source and destination do not overlap */
+					memcpy(op, m_pos, t);
+					op += t;
+					goto match_done;
+				}
 				do {
+					COPY8(op, m_pos);
+					op += 8;
+					m_pos += 8;
+					t -= 8;
+				} while (t >= 8);
+				if (t >= 4) {
 					COPY4(op, m_pos);
 					op += 4;
 					m_pos += 4;
 					t -= 4;
-				} while (t >= 4);
-				if (t > 0)
-					do {
-						*op++ = *m_pos++;
-					} while (--t > 0);
+				}
+				while (t > 0) {
+					*op++ = *m_pos++;
+					t--;
+				}
 			} else {
 copy_match:
 				*op++ = *m_pos++;
@@ -14,6 +14,12 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/sched.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -42,8 +48,23 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	unsigned long target;		/* proactive: free blocks wanted */
 };
 
+static bool kcompactd_should_back_off(void);
+
+/* number of free blocks of at least 'order', counted in that order */
+static unsigned long zone_free_blocks(struct zone *zone, unsigned int order)
+{
+	unsigned long nr = 0;
+	unsigned int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		nr += zone->free_area[o].nr_free << (o - order);
+	return nr;
+}
+
 static unsigned long release_freepages(struct list_head *freelist)
 {
 	struct page *page, *next;
@@ -471,6 +492,14 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	/* Proactive compactor: enough blocks free, or others need the cpu */
+	if (cc->target) {
+		if (zone_free_blocks(zone, cc->order) >= cc->target ||
+		    kcompactd_should_back_off())
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Compaction run is not finished if the watermark is not met */
 	watermark = low_wmark_pages(zone);
 	watermark += (1 << cc->order);
@@ -547,6 +576,9 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	int ret;
 
 	ret = compaction_suitable(zone, cc->order);
+	/* one free block is not enough for the proactive compactor */
+	if (ret == COMPACT_PARTIAL && cc->target)
+		ret = COMPACT_CONTINUE;
 	switch (ret) {
 	case COMPACT_PARTIAL:
 	case COMPACT_SKIPPED:
@@ -725,6 +757,123 @@ static int compact_nodes(void)
 	return COMPACT_COMPLETE;
 }
 
+/*
+ * Proactive compaction: a low priority thread per node keeps some free
+ * blocks of a high order around, so that atomic high-order allocations
+ * (network buffers, contiguous ION buffers) do not have to compact
+ * directly.  It only runs while the screen is off and nothing else
+ * wants the cpu.
+ */
+int sysctl_compact_proactive_order = 3;
+int sysctl_compact_proactive_target = 32;
+int sysctl_compact_proactive_secs = 30;
+
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static bool kcompactd_screen_on = true;
+
+static void kcompactd_early_suspend(struct early_suspend *h)
+{
+	kcompactd_screen_on = false;
+}
+
+static void kcompactd_late_resume(struct early_suspend *h)
+{
+	kcompactd_screen_on = true;
+}
+
+static struct early_suspend kcompactd_early_suspend_desc = {
+	.suspend = kcompactd_early_suspend,
+	.resume = kcompactd_late_resume,
+};
+#endif
+
+static bool kcompactd_should_back_off(void)
+{
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	if (kcompactd_screen_on)
+		return true;
+#endif
+	/* anything runnable besides us */
+	return nr_running() > 1;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = sysctl_compact_proactive_order,
+			.migratetype = MIGRATE_UNMOVABLE,
+			.zone = zone,
+			.sync = false,
+			.target = sysctl_compact_proactive_target,
+		};
+
+		if (!populated_zone(zone) ||
+		    zone_free_blocks(zone, cc.order) >= cc.target)
+			continue;
+
+		if (kcompactd_should_back_off() || kthread_should_stop())
+			return;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		lru_add_drain();
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+
+	set_user_nice(current, 19);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable_timeout(kcompactd_wait,
+				kthread_should_stop(),
+				sysctl_compact_proactive_secs * HZ);
+
+		if (!sysctl_compact_proactive_order ||
+		    !sysctl_compact_proactive_target ||
+		    kcompactd_should_back_off())
+			continue;
+
+		kcompactd_do_work(pgdat);
+	}
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *t;
+	int nid;
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&kcompactd_early_suspend_desc);
+#endif
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		t = kthread_run(kcompactd, NODE_DATA(nid), "kcompactd%d", nid);
+		if (IS_ERR(t))
+			printk(KERN_ERR "Failed to start kcompactd on node %d\n",
+				nid);
+	}
+	return 0;
+}
+module_init(kcompactd_init)
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
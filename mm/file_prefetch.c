@@ -0,0 +1,454 @@
+/*
+ * Recorded file prefetching
+ *
+ * Boot and the first launch of an application fault in the same pieces
+ * of the same files every time, one page fault at a time.  A trace
+ * records the page cache misses on regular files; when stopped it is
+ * saved, sorted by file in first-use order and by offset, with the
+ * ranges close to each other merged.  Replaying it issues the whole lot
+ * as large async readahead before anyone asks for the pages.
+ *
+ * Controlled from /sys/kernel/mm/prefetch, see
+ * Documentation/vm/file-prefetch.txt
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/file.h>
+#include <linux/path.h>
+#include <linux/dcache.h>
+#include <linux/hash.h>
+#include <linux/sort.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/uaccess.h>
+#include <linux/file_prefetch.h>
+
+#define PREFETCH_MAX_FILES	2048
+#define PREFETCH_MAX_RANGES	32768
+#define PREFETCH_HASH_BITS	8
+#define PREFETCH_MAX_PAGES	2048	/* one recorded range, 8MB */
+#define PREFETCH_GAP		16	/* pages read to merge two ranges */
+#define PREFETCH_MAX_TRACE	(1 << 20)	/* trace file size */
+
+struct prefetch_file {
+	struct path path;
+	struct inode *inode;
+	int next;		/* hash chain */
+	int last;		/* last range of this file */
+};
+
+struct prefetch_range {
+	int file;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+bool file_prefetch_tracing __read_mostly;
+
+/* the trace, under prefetch_lock */
+static DEFINE_SPINLOCK(prefetch_lock);
+static struct prefetch_file *files;
+static struct prefetch_range *ranges;
+static int nr_files, nr_ranges;
+static int hash[1 << PREFETCH_HASH_BITS];
+
+/* control, under prefetch_mutex */
+static DEFINE_MUTEX(prefetch_mutex);
+static char trace_path[256];
+static struct task_struct *replay_task;
+
+void __file_prefetch_record(struct file *file, pgoff_t index,
+			    unsigned long nr)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct prefetch_file *f;
+	struct prefetch_range *r;
+	int h, i;
+
+	if (!S_ISREG(inode->i_mode))
+		return;
+	nr = clamp_t(unsigned long, nr, 1, PREFETCH_MAX_PAGES);
+
+	spin_lock(&prefetch_lock);
+	if (!file_prefetch_tracing)
+		goto out;
+
+	h = hash_ptr(inode, PREFETCH_HASH_BITS);
+	for (i = hash[h]; i >= 0; i = files[i].next)
+		if (files[i].inode == inode)
+			break;
+	if (i < 0) {
+		if (nr_files == PREFETCH_MAX_FILES)
+			goto full;
+		i = nr_files++;
+		f = &files[i];
+		f->path = file->f_path;
+		path_get(&f->path);
+		f->inode = inode;
+		f->next = hash[h];
+		f->last = -1;
+		hash[h] = i;
+	}
+
+	f = &files[i];
+	if (f->last >= 0) {
+		r = &ranges[f->last];
+		if (index >= r->start && index <= r->start + r->nr) {
+			r->nr = max(r->nr, index + nr - r->start);
+			goto out;
+		}
+	}
+
+	if (nr_ranges == PREFETCH_MAX_RANGES)
+		goto full;
+	r = &ranges[nr_ranges];
+	r->file = i;
+	r->start = index;
+	r->nr = nr;
+	f->last = nr_ranges++;
+	goto out;
+
+full:
+	/* keep what we have, it is saved when the trace is stopped */
+	file_prefetch_tracing = false;
+out:
+	spin_unlock(&prefetch_lock);
+}
+
+/* drop the trace, tracing stopped */
+static void prefetch_reset(void)
+{
+	int i;
+
+	for (i = 0; i < nr_files; i++)
+		path_put(&files[i].path);
+	nr_files = 0;
+	nr_ranges = 0;
+	memset(hash, 0xff, sizeof(hash));
+}
+
+static int prefetch_start(void)
+{
+	if (!files) {
+		files = vmalloc(PREFETCH_MAX_FILES * sizeof(*files));
+		ranges = vmalloc(PREFETCH_MAX_RANGES * sizeof(*ranges));
+		if (!files || !ranges) {
+			vfree(files);
+			vfree(ranges);
+			files = NULL;
+			ranges = NULL;
+			return -ENOMEM;
+		}
+		nr_files = 0;
+	}
+
+	spin_lock(&prefetch_lock);
+	file_prefetch_tracing = false;
+	spin_unlock(&prefetch_lock);
+	prefetch_reset();
+
+	file_prefetch_tracing = true;
+	return 0;
+}
+
+static int prefetch_range_cmp(const void *a, const void *b)
+{
+	const struct prefetch_range *ra = a, *rb = b;
+
+	if (ra->file != rb->file)
+		return ra->file - rb->file;
+	if (ra->start != rb->start)
+		return ra->start < rb->start ? -1 : 1;
+	return 0;
+}
+
+static int prefetch_write(struct file *filp, const char *buf, size_t len)
+{
+	loff_t pos = filp->f_pos;
+	mm_segment_t old_fs = get_fs();
+	ssize_t ret;
+
+	set_fs(KERNEL_DS);
+	ret = vfs_write(filp, (const char __user *)buf, len, &pos);
+	set_fs(old_fs);
+	filp->f_pos = pos;
+
+	if (ret < 0)
+		return ret;
+	return ret == len ? 0 : -EIO;
+}
+
+/* stop the trace, sort and merge it and save it to trace_path */
+static int prefetch_stop(void)
+{
+	struct prefetch_range *r, *end;
+	struct file *filp;
+	char *buf, *name = NULL;
+	size_t len = 0;
+	int i, ret = 0, cur = -1;
+
+	spin_lock(&prefetch_lock);
+	file_prefetch_tracing = false;
+	spin_unlock(&prefetch_lock);
+
+	if (!files || !nr_ranges)
+		goto out_reset;
+	if (!trace_path[0]) {
+		ret = -EINVAL;
+		goto out_reset;
+	}
+
+	buf = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out_reset;
+	}
+
+	filp = filp_open(trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE,
+			 0600);
+	if (IS_ERR(filp)) {
+		ret = PTR_ERR(filp);
+		goto out_free;
+	}
+
+	sort(ranges, nr_ranges, sizeof(*ranges), prefetch_range_cmp, NULL);
+
+	end = ranges;
+	for (i = 1; i < nr_ranges; i++) {
+		r = &ranges[i];
+		if (r->file == end->file &&
+		    r->start <= end->start + end->nr + PREFETCH_GAP)
+			end->nr = max(end->nr, r->start + r->nr - end->start);
+		else
+			*++end = *r;
+	}
+
+	for (r = ranges; r <= end && !ret; r++) {
+		if (r->file != cur) {
+			cur = r->file;
+			name = d_path(&files[cur].path, buf + PAGE_SIZE,
+				      PAGE_SIZE);
+			/* the trace is line oriented */
+			if (IS_ERR(name) || strchr(name, '\n'))
+				name = NULL;
+		}
+		if (!name)
+			continue;
+
+		if (len + strlen(name) + 32 > PAGE_SIZE) {
+			ret = prefetch_write(filp, buf, len);
+			len = 0;
+		}
+		len += snprintf(buf + len, PAGE_SIZE - len, "%lu %lu %s\n",
+				r->start, r->nr, name);
+	}
+	if (!ret && len)
+		ret = prefetch_write(filp, buf, len);
+
+	if (!ret)
+		ret = vfs_fsync(filp, 0);
+	filp_close(filp, NULL);
+out_free:
+	kfree(buf);
+out_reset:
+	if (files)
+		prefetch_reset();
+	return ret;
+}
+
+static int prefetch_replay_thread(void *arg)
+{
+	char *path = arg;
+	struct file *trace, *filp = NULL;
+	char *buf, *line, *next, *name = NULL;
+	unsigned long start, nr;
+	loff_t size;
+	int n;
+
+	trace = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(trace))
+		goto out;
+
+	size = i_size_read(trace->f_mapping->host);
+	if (size <= 0 || size > PREFETCH_MAX_TRACE)
+		goto out_close;
+
+	buf = vmalloc(size + 1);
+	if (!buf)
+		goto out_close;
+	if (kernel_read(trace, 0, buf, size) != size)
+		goto out_free;
+	buf[size] = '\0';
+
+	/* "<start> <nr> <path>" per line, sorted by file */
+	for (line = buf; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		if (sscanf(line, "%lu %lu %n", &start, &nr, &n) != 2)
+			continue;
+
+		if (!name || strcmp(name, line + n)) {
+			name = line + n;
+			if (filp && !IS_ERR(filp))
+				fput(filp);
+			filp = filp_open(name, O_RDONLY | O_LARGEFILE, 0);
+		}
+		if (IS_ERR(filp))
+			continue;
+
+		force_page_cache_readahead(filp->f_mapping, filp, start,
+					   min_t(unsigned long, nr,
+						 PREFETCH_MAX_PAGES));
+	}
+	if (filp && !IS_ERR(filp))
+		fput(filp);
+
+out_free:
+	vfree(buf);
+out_close:
+	filp_close(trace, NULL);
+out:
+	kfree(path);
+	mutex_lock(&prefetch_mutex);
+	replay_task = NULL;
+	mutex_unlock(&prefetch_mutex);
+	return 0;
+}
+
+static int prefetch_replay(void)
+{
+	struct task_struct *task;
+	char *path;
+
+	if (replay_task)
+		return -EBUSY;
+	if (!trace_path[0])
+		return -EINVAL;
+
+	path = kstrdup(trace_path, GFP_KERNEL);
+	if (!path)
+		return -ENOMEM;
+
+	task = kthread_run(prefetch_replay_thread, path, "kprefetchd");
+	if (IS_ERR(task)) {
+		kfree(path);
+		return PTR_ERR(task);
+	}
+	replay_task = task;
+	return 0;
+}
+
+static ssize_t trace_file_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	mutex_lock(&prefetch_mutex);
+	ret = sprintf(buf, "%s\n", trace_path);
+	mutex_unlock(&prefetch_mutex);
+	return ret;
+}
+
+static ssize_t trace_file_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	size_t len = count;
+
+	if (len && buf[len - 1] == '\n')
+		len--;
+	if (len >= sizeof(trace_path))
+		return -ENAMETOOLONG;
+
+	mutex_lock(&prefetch_mutex);
+	memcpy(trace_path, buf, len);
+	trace_path[len] = '\0';
+	mutex_unlock(&prefetch_mutex);
+	return count;
+}
+
+static struct kobj_attribute trace_file_attr =
+	__ATTR(trace_file, 0644, trace_file_show, trace_file_store);
+
+static ssize_t trace_show(struct kobject *kobj, struct kobj_attribute *attr,
+			  char *buf)
+{
+	return sprintf(buf, "%u\n", file_prefetch_tracing);
+}
+
+/* 1 starts a new trace, 0 stops and saves it */
+static ssize_t trace_store(struct kobject *kobj, struct kobj_attribute *attr,
+			   const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > 1)
+		return -EINVAL;
+
+	mutex_lock(&prefetch_mutex);
+	err = val ? prefetch_start() : prefetch_stop();
+	mutex_unlock(&prefetch_mutex);
+
+	return err ? err : count;
+}
+
+static struct kobj_attribute trace_attr =
+	__ATTR(trace, 0644, trace_show, trace_store);
+
+static ssize_t replay_show(struct kobject *kobj, struct kobj_attribute *attr,
+			   char *buf)
+{
+	return sprintf(buf, "%u\n", replay_task != NULL);
+}
+
+/* any write replays the trace in trace_file, in the background */
+static ssize_t replay_store(struct kobject *kobj, struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	int err;
+
+	mutex_lock(&prefetch_mutex);
+	err = prefetch_replay();
+	mutex_unlock(&prefetch_mutex);
+
+	return err ? err : count;
+}
+
+static struct kobj_attribute replay_attr =
+	__ATTR(replay, 0644, replay_show, replay_store);
+
+static struct attribute *prefetch_attrs[] = {
+	&trace_file_attr.attr,
+	&trace_attr.attr,
+	&replay_attr.attr,
+	NULL,
+};
+
+static struct attribute_group prefetch_attr_group = {
+	.attrs = prefetch_attrs,
+	.name = "prefetch",
+};
+
+static int __init file_prefetch_init(void)
+{
+	int err;
+
+	memset(hash, 0xff, sizeof(hash));
+
+	err = sysfs_create_group(mm_kobj, &prefetch_attr_group);
+	if (err)
+		printk(KERN_ERR "prefetch: register sysfs failed\n");
+	return err;
+}
+module_init(file_prefetch_init)
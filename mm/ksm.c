@@ -36,6 +36,9 @@
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#include <linux/input.h>
+#include <linux/earlysuspend.h>
+#include <linux/power_supply.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -198,6 +201,87 @@ static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
 static DEFINE_MUTEX(ksm_thread_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
 
+#ifdef CONFIG_KSM_IDLE_SCAN
+/* Scan only on otherwise idle CPUs, away from input and screen off time */
+static unsigned int ksm_idle_only;
+
+/* Milliseconds after the last input event before ksmd scans again */
+static unsigned int ksm_input_holdoff_millisecs = 2000;
+
+static unsigned long ksm_last_input = INITIAL_JIFFIES;
+static bool ksm_screen_off;
+static struct task_struct *ksmd_task;
+
+/* jiffies left until ksmd may scan again after input, 0 if it may now */
+static long ksm_idle_holdoff(void)
+{
+	long left;
+
+	if (!ksm_idle_only)
+		return 0;
+
+	left = ksm_last_input + msecs_to_jiffies(ksm_input_holdoff_millisecs) -
+		jiffies;
+	return left > 0 ? left : 0;
+}
+
+/* with the screen off, scanning only wakes the CPU, unless on a charger */
+static bool ksm_idle_screen_gated(void)
+{
+	return ksm_idle_only && ksm_screen_off &&
+		power_supply_is_system_supplied() <= 0;
+}
+
+/*
+ * Nothing tells ksmd about a charger being plugged in, so while it is
+ * gated by the screen it looks again every so often.  The timer is
+ * deferrable: it does not wake an idle CPU, plugging in wakes it anyway.
+ */
+#define KSM_SUPPLY_POLL_SECS	30
+
+static void ksm_supply_poll(unsigned long data)
+{
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
+static struct timer_list ksm_supply_timer =
+	TIMER_DEFERRED_INITIALIZER(ksm_supply_poll, 0, 0);
+static bool ksm_supply_polling;
+
+/* before ksmd sleeps: look at the supplies again later if gated */
+static void ksm_idle_poll_supply(void)
+{
+	ksm_supply_polling = ksm_idle_screen_gated();
+	if (ksm_supply_polling)
+		mod_timer(&ksm_supply_timer,
+			  jiffies + KSM_SUPPLY_POLL_SECS * HZ);
+}
+
+static bool ksm_idle_poll_due(void)
+{
+	return ksm_supply_polling && !timer_pending(&ksm_supply_timer);
+}
+#else
+static inline long ksm_idle_holdoff(void)
+{
+	return 0;
+}
+
+static inline bool ksm_idle_screen_gated(void)
+{
+	return false;
+}
+
+static inline void ksm_idle_poll_supply(void)
+{
+}
+
+static inline bool ksm_idle_poll_due(void)
+{
+	return false;
+}
+#endif /* CONFIG_KSM_IDLE_SCAN */
+
 #define KSM_KMEM_CACHE(__struct, __flags) kmem_cache_create("ksm_"#__struct,\
 		sizeof(struct __struct), __alignof__(struct __struct),\
 		(__flags), NULL)
@@ -1413,6 +1497,9 @@ static void ksm_do_scan(unsigned int scan_npages)
 	struct page *uninitialized_var(page);
 
 	while (scan_npages-- && likely(!freezing(current))) {
+		/* back off as soon as the user touches the device */
+		if (ksm_idle_holdoff())
+			return;
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
@@ -1425,7 +1512,8 @@ static void ksm_do_scan(unsigned int scan_npages)
 
 static int ksmd_should_run(void)
 {
-	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
+	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list) &&
+		!ksm_idle_screen_gated();
 }
 
 static int ksm_scan_thread(void *nothing)
@@ -1442,11 +1530,14 @@ static int ksm_scan_thread(void *nothing)
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+			schedule_timeout_interruptible(max_t(long,
+				msecs_to_jiffies(ksm_thread_sleep_millisecs),
+				ksm_idle_holdoff()));
 		} else {
+			ksm_idle_poll_supply();
 			wait_event_freezable(ksm_thread_wait,
-				ksmd_should_run() || kthread_should_stop());
+				ksmd_should_run() || kthread_should_stop() ||
+				ksm_idle_poll_due());
 		}
 	}
 	return 0;
@@ -1515,6 +1606,15 @@ int __ksm_enter(struct mm_struct *mm)
 	 * want ksmd to waste time setting up and tearing down an rmap_list.
 	 */
 	list_add_tail(&mm_slot->mm_list, &ksm_scan.mm_slot->mm_list);
+#ifdef CONFIG_KSM_IDLE_SCAN
+	/*
+	 * On fork, mm is the child's and current the parent: the children
+	 * of a mergeable parent like the zygote, which do not exec, go to
+	 * the front of the next pass while idle time lasts.
+	 */
+	if (ksm_idle_only && mm != current->mm)
+		list_move(&mm_slot->mm_list, &ksm_mm_head.mm_list);
+#endif
 	spin_unlock(&ksm_mmlist_lock);
 
 	set_bit(MMF_VM_MERGEABLE, &mm->flags);
@@ -1959,6 +2059,67 @@ static ssize_t pages_volatile_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(pages_volatile);
 
+#ifdef CONFIG_KSM_IDLE_SCAN
+static ssize_t idle_only_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_idle_only);
+}
+
+static ssize_t idle_only_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	unsigned long idle_only;
+	int err;
+
+	err = strict_strtoul(buf, 10, &idle_only);
+	if (err || idle_only > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (ksm_idle_only != idle_only) {
+		ksm_idle_only = idle_only;
+		sched_setscheduler(ksmd_task,
+				   idle_only ? SCHED_IDLE : SCHED_NORMAL,
+				   &param);
+		if (!idle_only)
+			set_user_nice(ksmd_task, 5);
+	}
+	mutex_unlock(&ksm_thread_mutex);
+
+	wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(idle_only);
+
+static ssize_t input_holdoff_millisecs_show(struct kobject *kobj,
+					    struct kobj_attribute *attr,
+					    char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_input_holdoff_millisecs);
+}
+
+static ssize_t input_holdoff_millisecs_store(struct kobject *kobj,
+					     struct kobj_attribute *attr,
+					     const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX)
+		return -EINVAL;
+
+	ksm_input_holdoff_millisecs = msecs;
+
+	return count;
+}
+KSM_ATTR(input_holdoff_millisecs);
+#endif /* CONFIG_KSM_IDLE_SCAN */
+
 static ssize_t full_scans_show(struct kobject *kobj,
 			       struct kobj_attribute *attr, char *buf)
 {
@@ -1975,6 +2136,10 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+#ifdef CONFIG_KSM_IDLE_SCAN
+	&idle_only_attr.attr,
+	&input_holdoff_millisecs_attr.attr,
+#endif
 	NULL,
 };
 
@@ -1984,6 +2149,106 @@ static struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+#ifdef CONFIG_KSM_IDLE_SCAN
+static void ksm_input_event(struct input_handle *handle, unsigned int type,
+			    unsigned int code, int value)
+{
+	ksm_last_input = jiffies;
+}
+
+static int ksm_input_connect(struct input_handler *handler,
+			     struct input_dev *dev,
+			     const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "ksm";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void ksm_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id ksm_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	}, /* keys and buttons, touchscreens report BTN_TOUCH */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+	}, /* multi-touch touchscreens */
+	{ },
+};
+
+static struct input_handler ksm_input_handler = {
+	.event		= ksm_input_event,
+	.connect	= ksm_input_connect,
+	.disconnect	= ksm_input_disconnect,
+	.name		= "ksm",
+	.id_table	= ksm_input_ids,
+};
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void ksm_early_suspend(struct early_suspend *h)
+{
+	ksm_screen_off = true;
+}
+
+static void ksm_late_resume(struct early_suspend *h)
+{
+	ksm_screen_off = false;
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
+static struct early_suspend ksm_early_suspend_desc = {
+	.suspend	= ksm_early_suspend,
+	.resume		= ksm_late_resume,
+};
+#endif
+
+static void __init ksm_idle_init(struct task_struct *task)
+{
+	ksmd_task = task;
+	if (input_register_handler(&ksm_input_handler))
+		printk(KERN_WARNING "ksm: no input handler, "
+		       "idle_only will not see input\n");
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&ksm_early_suspend_desc);
+#endif
+}
+#else
+static inline void ksm_idle_init(struct task_struct *task)
+{
+}
+#endif /* CONFIG_KSM_IDLE_SCAN */
+
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
@@ -2012,6 +2277,8 @@ static int __init ksm_init(void)
 
 #endif /* CONFIG_SYSFS */
 
+	ksm_idle_init(ksm_thread);
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/*
 	 * Choose a high priority since the callback takes ksm_thread_mutex:
@@ -250,6 +250,8 @@ struct mem_cgroup {
 	atomic_t	refcnt;
 
 	unsigned int	swappiness;
+	/* reclaimed ahead of the global LRU under global pressure if > 0 */
+	unsigned int	reclaim_priority;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
@@ -329,6 +331,8 @@ static bool move_file(void)
  */
 #define	MEM_CGROUP_MAX_RECLAIM_LOOPS		(100)
 #define	MEM_CGROUP_MAX_SOFT_LIMIT_RECLAIM_LOOPS	(2)
+/* highest memory.reclaim_priority, 0 leaves a group to the global LRU */
+#define MEM_CGROUP_RECLAIM_PRIO_MAX	10
 
 enum charge_type {
 	MEM_CGROUP_CHARGE_TYPE_CACHE = 0,
@@ -3738,6 +3742,55 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return nr_reclaimed;
 }
 
+/*
+ * Global reclaim of a zone first goes after the memory cgroups that have
+ * a reclaim priority, highest priority first, and only falls back to the
+ * global LRU - and so to foreground groups - for what they cannot give.
+ */
+unsigned long mem_cgroup_priority_reclaim(struct zone *zone, gfp_t gfp_mask,
+					  bool noswap,
+					  unsigned long nr_to_reclaim,
+					  unsigned long *total_scanned)
+{
+	unsigned long nr_reclaimed = 0;
+	unsigned long levels = 0;
+	unsigned long reclaimed, nr_scanned;
+	struct mem_cgroup *iter;
+	int prio;
+
+	if (mem_cgroup_disabled())
+		return 0;
+
+	for_each_mem_cgroup_all(iter)
+		if (iter->reclaim_priority)
+			__set_bit(iter->reclaim_priority, &levels);
+
+	for (prio = MEM_CGROUP_RECLAIM_PRIO_MAX; prio > 0; prio--) {
+		bool more = true;
+
+		if (!test_bit(prio, &levels))
+			continue;
+		for_each_mem_cgroup_tree_cond(iter, NULL, more) {
+			if (iter->reclaim_priority != prio)
+				continue;
+			do {
+				nr_scanned = 0;
+				reclaimed = mem_cgroup_shrink_node_zone(iter,
+						gfp_mask, noswap,
+						get_swappiness(iter), zone,
+						&nr_scanned);
+				nr_reclaimed += reclaimed;
+				*total_scanned += nr_scanned;
+			} while (reclaimed && nr_reclaimed < nr_to_reclaim);
+			if (nr_reclaimed >= nr_to_reclaim)
+				more = false;
+		}
+		if (!more)
+			break;
+	}
+	return nr_reclaimed;
+}
+
 /*
  * This routine traverse page_cgroup in given list and drop them all.
  * *And* this routine doesn't reclaim page itself, just removes page_cgroup.
@@ -4365,6 +4418,26 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
+static u64 mem_cgroup_reclaim_priority_read(struct cgroup *cgrp,
+					    struct cftype *cft)
+{
+	return mem_cgroup_from_cont(cgrp)->reclaim_priority;
+}
+
+static int mem_cgroup_reclaim_priority_write(struct cgroup *cgrp,
+					     struct cftype *cft, u64 val)
+{
+	if (val > MEM_CGROUP_RECLAIM_PRIO_MAX)
+		return -EINVAL;
+
+	/* the root group holds everything else: it is the global LRU */
+	if (cgrp->parent == NULL)
+		return -EINVAL;
+
+	mem_cgroup_from_cont(cgrp)->reclaim_priority = val;
+	return 0;
+}
+
 static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
 {
 	struct mem_cgroup_threshold_ary *t;
@@ -4765,6 +4838,11 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "reclaim_priority",
+		.read_u64 = mem_cgroup_reclaim_priority_read,
+		.write_u64 = mem_cgroup_reclaim_priority_write,
+	},
 	{
 		.name = "move_charge_at_immigrate",
 		.read_u64 = mem_cgroup_move_charge_read,
@@ -5043,8 +5121,10 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	mem->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&mem->oom_notify);
 
-	if (parent)
+	if (parent) {
 		mem->swappiness = get_swappiness(parent);
+		mem->reclaim_priority = parent->reclaim_priority;
+	}
 	atomic_set(&mem->refcnt, 1);
 	mem->move_charge_at_immigrate = 0;
 	mutex_init(&mem->thresholds_lock);
@@ -57,6 +57,7 @@
 #include <linux/ftrace_event.h>
 #include <linux/memcontrol.h>
 #include <linux/prefetch.h>
+#include <linux/kthread.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -148,6 +149,7 @@ int pageblock_order __read_mostly;
 #endif
 
 static void __free_pages_ok(struct page *page, unsigned int order);
+static bool wait_for_deferred_memmap(enum zone_type high_zoneidx);
 
 /*
  * results with 256, 32 in the lowmem_reserve sysctl:
@@ -651,6 +653,86 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/* Pages of each order from 1 to PAGE_ALLOC_COSTLY_ORDER a CPU may keep */
+#define PCP_HIGH_ORDER_PAGES	32
+
+/*
+ * Frees count blocks of the given order from the per-cpu lists back to
+ * the buddy allocator. Only a handful are kept, so unlike
+ * free_pcppages_bulk() there is no balancing between migrate types.
+ */
+static void free_pcppages_high_order_bulk(struct zone *zone,
+		unsigned int order, int count, struct per_cpu_pages *pcp)
+{
+	struct list_head *lists = pcp->high_order_lists[order - 1];
+	int migratetype;
+	int freed = 0;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++) {
+		struct list_head *list = &lists[migratetype];
+
+		while (freed < count && !list_empty(list)) {
+			struct page *page;
+
+			page = list_entry(list->prev, struct page, lru);
+			list_del(&page->lru);
+			__free_one_page(page, zone, order, page_private(page));
+			trace_mm_page_pcpu_drain(page, order,
+						 page_private(page));
+			freed++;
+		}
+	}
+	pcp->high_order_count[order - 1] -= freed;
+	__mod_zone_page_state(zone, NR_FREE_PAGES, freed << order);
+	spin_unlock(&zone->lock);
+}
+
+static void free_pcppages_high_orders(struct zone *zone,
+					struct per_cpu_pages *pcp)
+{
+	unsigned int order;
+
+	for (order = 1; order <= PAGE_ALLOC_COSTLY_ORDER; order++)
+		if (pcp->high_order_count[order - 1])
+			free_pcppages_high_order_bulk(zone, order,
+				pcp->high_order_count[order - 1], pcp);
+}
+
+/*
+ * Frees a block of order 1 to PAGE_ALLOC_COSTLY_ORDER to the per-cpu
+ * lists, with interrupts disabled. Returns false if the block should go
+ * to the buddy allocator instead.
+ */
+static bool free_pcp_high_order(struct zone *zone, struct page *page,
+				unsigned int order, int migratetype)
+{
+	struct per_cpu_pages *pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	int high = pcp->high_order_high >> order;
+
+	/* Same treatment of migrate types as free_hot_cold_page() */
+	if (!high || migratetype == MIGRATE_ISOLATE)
+		return false;
+
+	/* Cached blocks must look like freshly split ones */
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return true;
+
+	set_page_private(page, migratetype);
+	if (migratetype >= MIGRATE_PCPTYPES)
+		migratetype = MIGRATE_MOVABLE;
+
+	list_add(&page->lru, &pcp->high_order_lists[order - 1][migratetype]);
+	if (++pcp->high_order_count[order - 1] >= high)
+		free_pcppages_high_order_bulk(zone, order, max(high / 2, 1),
+					      pcp);
+	return true;
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -693,16 +775,19 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
 	int wasMlocked = __TestClearPageMlocked(page);
+	int migratetype;
 
 	if (!free_pages_prepare(page, order))
 		return;
 
+	migratetype = get_pageblock_migratetype(page);
 	local_irq_save(flags);
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	if (order > PAGE_ALLOC_COSTLY_ORDER ||
+	    !free_pcp_high_order(page_zone(page), page, order, migratetype))
+		free_one_page(page_zone(page), page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -1116,6 +1201,7 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		free_pcppages_high_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1297,6 +1383,41 @@ int split_free_page(struct page *page)
 	return 1 << order;
 }
 
+/*
+ * Takes a block of order 1 to PAGE_ALLOC_COSTLY_ORDER off the per-cpu
+ * lists, refilling them from the buddy allocator if needed. Called with
+ * interrupts disabled, returns NULL if nothing is cached or could be.
+ */
+static struct page *rmqueue_pcp_high_order(struct zone *zone,
+			unsigned int order, int migratetype, int cold)
+{
+	struct per_cpu_pages *pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	int high = pcp->high_order_high >> order;
+	struct list_head *list;
+	struct page *page;
+
+	if (!high)
+		return NULL;
+
+	list = &pcp->high_order_lists[order - 1][migratetype];
+	if (list_empty(list)) {
+		pcp->high_order_count[order - 1] += rmqueue_bulk(zone, order,
+					max(high / 2, 1), list,
+					migratetype, cold);
+		if (unlikely(list_empty(list)))
+			return NULL;
+	}
+
+	if (cold)
+		page = list_entry(list->prev, struct page, lru);
+	else
+		page = list_entry(list->next, struct page, lru);
+
+	list_del(&page->lru);
+	pcp->high_order_count[order - 1]--;
+	return page;
+}
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1348,12 +1469,20 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
+		local_irq_save(flags);
+		page = NULL;
+		if (order <= PAGE_ALLOC_COSTLY_ORDER)
+			page = rmqueue_pcp_high_order(zone, order,
+						      migratetype, cold);
+		if (!page) {
+			spin_lock(&zone->lock);
+			page = __rmqueue(zone, order, migratetype);
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_page_state(zone, NR_FREE_PAGES,
+					      -(1 << order));
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -2205,6 +2334,10 @@ rebalance:
 	if (page)
 		goto got_pg;
 
+	/* Highmem may still be on its way */
+	if (!did_some_progress && wait_for_deferred_memmap(high_zoneidx))
+		goto restart;
+
 	/*
 	 * If we failed to make any progress reclaiming, then we are
 	 * running out of options and have to consider going OOM
@@ -3473,6 +3606,243 @@ static void setup_zone_migrate_reserve(struct zone *zone)
 	}
 }
 
+static void __meminit __init_single_page(struct page *page, unsigned long pfn,
+					unsigned long zone, int nid)
+{
+	set_page_links(page, zone, nid, pfn);
+	mminit_verify_page_links(page, zone, nid, pfn);
+	init_page_count(page);
+	reset_page_mapcount(page);
+	SetPageReserved(page);
+	INIT_LIST_HEAD(&page->lru);
+#ifdef WANT_PAGE_VIRTUAL
+	/* The shift won't overflow because ZONE_NORMAL is below 4G. */
+	if (!is_highmem_idx(zone))
+		set_page_address(page, __va(pfn << PAGE_SHIFT));
+#endif
+}
+
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/*
+ * Highmem is only handed out once userspace runs, so its struct pages
+ * are not initialised on the boot CPU.  free_area_init() leaves them
+ * zeroed, the architecture queues the highmem it would have freed with
+ * deferred_free_range(), and once the secondary CPUs are up one thread
+ * per CPU initialises and frees a slice of the zone.  Until then a zeroed
+ * struct page is neither PageBuddy nor in the zone, so nothing merges
+ * with it or scans it.
+ */
+#define MAX_DEFERRED_RANGES	8
+
+static bool deferred_memmap_enabled __meminitdata = true;
+static struct zone *deferred_zone __meminitdata;
+static struct {
+	unsigned long start_pfn;
+	unsigned long end_pfn;
+} deferred_ranges[MAX_DEFERRED_RANGES] __initdata;
+static int nr_deferred_ranges __initdata;
+
+static unsigned long deferred_chunk __initdata;
+static atomic_t deferred_threads __initdata;
+static ktime_t deferred_start __initdata;
+static DEFINE_SPINLOCK(deferred_lock);
+static DECLARE_COMPLETION(deferred_done);
+static bool deferred_pending;
+
+static int __init no_deferred_memmap(char *str)
+{
+	deferred_memmap_enabled = false;
+	return 0;
+}
+early_param("nodeferred_memmap", no_deferred_memmap);
+
+static bool __meminit defer_memmap_init(struct zone *zone,
+		unsigned long start_pfn, unsigned long end_pfn)
+{
+	if (!deferred_memmap_enabled || !is_highmem(zone))
+		return false;
+
+	/* hotplugged or second highmem zone: initialise it as usual */
+	if (deferred_zone || start_pfn != zone->zone_start_pfn)
+		return false;
+
+	deferred_zone = zone;
+	return true;
+}
+
+/**
+ * deferred_free_range - free a range of highmem once its memmap is set up
+ * @start_pfn: first page frame
+ * @end_pfn: page frame after the last
+ *
+ * Returns false if the range is not in the deferred zone, or too many
+ * ranges are queued already; the caller has to free it right away then.
+ */
+bool __init deferred_free_range(unsigned long start_pfn, unsigned long end_pfn)
+{
+	struct zone *zone = deferred_zone;
+
+	if (!zone || nr_deferred_ranges == MAX_DEFERRED_RANGES)
+		return false;
+	if (start_pfn < zone->zone_start_pfn ||
+	    end_pfn > zone->zone_start_pfn + zone->spanned_pages)
+		return false;
+
+	deferred_ranges[nr_deferred_ranges].start_pfn = start_pfn;
+	deferred_ranges[nr_deferred_ranges].end_pfn = end_pfn;
+	nr_deferred_ranges++;
+	return true;
+}
+
+static void __init deferred_init_pages(struct zone *zone,
+		unsigned long start_pfn, unsigned long end_pfn)
+{
+	unsigned long pfn, flags;
+	int nid = zone_to_nid(zone);
+	unsigned long zid = zone_idx(zone);
+
+	for (pfn = start_pfn; pfn < end_pfn; pfn++) {
+		struct page *page;
+
+		if (!pfn_valid(pfn))
+			continue;
+
+		page = pfn_to_page(pfn);
+		__init_single_page(page, pfn, zid, nid);
+
+		/* the bitmap word is shared with the allocator's blocks */
+		if (!(pfn & (pageblock_nr_pages - 1))) {
+			spin_lock_irqsave(&zone->lock, flags);
+			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+			spin_unlock_irqrestore(&zone->lock, flags);
+		}
+	}
+}
+
+static unsigned long __init deferred_free_pages(unsigned long start_pfn,
+		unsigned long end_pfn)
+{
+	unsigned long nr_pages = 0;
+	int i;
+
+	for (i = 0; i < nr_deferred_ranges; i++) {
+		unsigned long pfn = max(start_pfn, deferred_ranges[i].start_pfn);
+		unsigned long end = min(end_pfn, deferred_ranges[i].end_pfn);
+
+		for (; pfn < end; pfn++) {
+			struct page *page = pfn_to_page(pfn);
+
+			ClearPageReserved(page);
+			init_page_count(page);
+			__free_page(page);
+			nr_pages++;
+		}
+		cond_resched();
+	}
+
+	return nr_pages;
+}
+
+static int __init deferred_init_memmap(void *data)
+{
+	struct zone *zone = deferred_zone;
+	unsigned long start_pfn = (unsigned long)data;
+	unsigned long end_pfn = zone->zone_start_pfn + zone->spanned_pages;
+	unsigned long nr_pages;
+
+	end_pfn = min(end_pfn, start_pfn + deferred_chunk);
+
+	deferred_init_pages(zone, start_pfn, end_pfn);
+	nr_pages = deferred_free_pages(start_pfn, end_pfn);
+
+	spin_lock(&deferred_lock);
+	totalhigh_pages += nr_pages;
+	totalram_pages += nr_pages;
+	spin_unlock(&deferred_lock);
+
+	if (atomic_dec_and_test(&deferred_threads)) {
+		/* the migrate reserve was sized against a zone with no blocks */
+		setup_per_zone_wmarks();
+		pr_info("deferred memmap: %luK highmem ready in %lld us\n",
+			totalhigh_pages << (PAGE_SHIFT - 10),
+			ktime_to_us(ktime_sub(ktime_get(), deferred_start)));
+		deferred_pending = false;
+		complete_all(&deferred_done);
+	}
+
+	return 0;
+}
+
+static int __init deferred_memmap_start(void)
+{
+	struct zone *zone = deferred_zone;
+	unsigned long pfn, end_pfn;
+	int cpu;
+
+	if (!zone) {
+		complete_all(&deferred_done);
+		return 0;
+	}
+
+	end_pfn = zone->zone_start_pfn + zone->spanned_pages;
+	deferred_chunk = ALIGN(DIV_ROUND_UP(zone->spanned_pages,
+				num_online_cpus()), pageblock_nr_pages);
+
+	deferred_start = ktime_get();
+	deferred_pending = true;
+	atomic_set(&deferred_threads,
+		   DIV_ROUND_UP(zone->spanned_pages, deferred_chunk));
+
+	pfn = zone->zone_start_pfn;
+	for_each_online_cpu(cpu) {
+		struct task_struct *t;
+
+		if (pfn >= end_pfn)
+			break;
+
+		t = kthread_create(deferred_init_memmap, (void *)pfn,
+				   "pgdatinit/%d", cpu);
+		if (IS_ERR(t)) {
+			deferred_init_memmap((void *)pfn);
+		} else {
+			kthread_bind(t, cpu);
+			wake_up_process(t);
+		}
+		pfn += deferred_chunk;
+	}
+
+	return 0;
+}
+core_initcall(deferred_memmap_start);
+
+/* init memory goes away after this, and the threads live in it */
+static int __init deferred_memmap_wait(void)
+{
+	wait_for_completion(&deferred_done);
+	return 0;
+}
+late_initcall_sync(deferred_memmap_wait);
+
+/*
+ * An allocation that may use highmem and found nothing to reclaim waits
+ * for the deferred pages rather than going OOM.  Returns true if it had
+ * to wait.
+ */
+static bool wait_for_deferred_memmap(enum zone_type high_zoneidx)
+{
+	if (!deferred_pending || high_zoneidx < ZONE_HIGHMEM)
+		return false;
+
+	wait_for_completion(&deferred_done);
+	return true;
+}
+#else
+static inline bool wait_for_deferred_memmap(enum zone_type high_zoneidx)
+{
+	return false;
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
 /*
  * Initially all pages are reserved - free ones are freed
  * up by free_all_bootmem() once the early boot process is
@@ -3490,6 +3860,10 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		highest_memmap_pfn = end_pfn - 1;
 
 	z = &NODE_DATA(nid)->node_zones[zone];
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	if (context == MEMMAP_EARLY && defer_memmap_init(z, start_pfn, end_pfn))
+		return;
+#endif
 	for (pfn = start_pfn; pfn < end_pfn; pfn++) {
 		/*
 		 * There can be holes in boot-time mem_map[]s
@@ -3503,11 +3877,7 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 				continue;
 		}
 		page = pfn_to_page(pfn);
-		set_page_links(page, zone, nid, pfn);
-		mminit_verify_page_links(page, zone, nid, pfn);
-		init_page_count(page);
-		reset_page_mapcount(page);
-		SetPageReserved(page);
+		__init_single_page(page, pfn, zone, nid);
 		/*
 		 * Mark the block movable so that blocks are reserved for
 		 * movable at startup. This will force kernel allocations
@@ -3526,13 +3896,6 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		    && (pfn < z->zone_start_pfn + z->spanned_pages)
 		    && !(pfn & (pageblock_nr_pages - 1)))
 			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-
-		INIT_LIST_HEAD(&page->lru);
-#ifdef WANT_PAGE_VIRTUAL
-		/* The shift won't overflow because ZONE_NORMAL is below 4G. */
-		if (!is_highmem_idx(zone))
-			set_page_address(page, __va(pfn << PAGE_SHIFT));
-#endif
 	}
 }
 
@@ -3604,6 +3967,7 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
 	int migratetype;
+	int order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3613,6 +3977,13 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+
+	/* nothing is cached in the boot pagesets */
+	pcp->high_order_high = batch ? PCP_HIGH_ORDER_PAGES : 0;
+	for (order = 0; order < PAGE_ALLOC_COSTLY_ORDER; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pcp->high_order_lists[order][migratetype]);
 }
 
 /*
@@ -3720,6 +4091,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcppages_high_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
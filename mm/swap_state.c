@@ -266,8 +266,11 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page))
+			swap_readahead_account(entry, 1);
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -275,16 +278,20 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 /* 
  * Locate a page of swap in physical memory, reserving swap cache space
- * and reading the disk if it is not already cached.
+ * and reading the disk if it is not already cached.  *allocated tells
+ * whether a read had to be started.
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*allocated = false;
+
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -335,6 +342,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -352,6 +360,14 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, &allocated);
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -365,6 +381,9 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * (1 << page_cluster) entries in the swap area. This method is chosen
  * because it doesn't cost us any seek time.  We also make sure to queue
  * the 'original' request together with the readahead ones...
+ * The window is chosen per swap device by valid_swaphandles(); pages
+ * read ahead are marked PG_readahead so that lookup_swap_cache() can
+ * tell the device how many of them were actually wanted.
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -388,11 +407,18 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 */
 	nr_pages = valid_swaphandles(entry, &offset);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		swp_entry_t ra_entry = swp_entry(swp_type(entry), offset);
+		bool allocated;
+
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(ra_entry, gfp_mask, vma, addr,
+						&allocated);
 		if (!page)
 			break;
+		if (allocated && offset != swp_offset(entry)) {
+			SetPageReadahead(page);
+			swap_readahead_account(ra_entry, 0);
+		}
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
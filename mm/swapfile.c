@@ -2111,6 +2111,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 		if (blk_queue_nonrot(bdev_get_queue(p->bdev))) {
 			p->flags |= SWP_SOLIDSTATE;
 			p->cluster_next = 1 + (random32() % p->highest_bit);
+			p->ra_order = page_cluster;
+			p->ra_issued = p->ra_hits = p->ra_idle = 0;
 		}
 		if (discard_swap(p) == 0 && (swap_flags & SWAP_FLAG_DISCARD))
 			p->flags |= SWP_DISCARDABLE;
@@ -2296,6 +2298,63 @@ int swapcache_prepare(swp_entry_t entry)
 	return __swap_duplicate(entry, SWAP_HAS_CACHE);
 }
 
+/*
+ * Swapin readahead: rotating devices read around the faulting slot in
+ * blocks of 1 << page_cluster, since the extra pages cost no seek.  On
+ * solid state devices the window is further bounded by the device's
+ * read_ahead_kb, so memory backed devices such as zram can turn it off,
+ * and it adapts: once SWAP_RA_SAMPLE pages have been read ahead it
+ * shrinks if few of them were used by a later fault and grows back if
+ * most were.
+ */
+#define SWAP_RA_SAMPLE	64
+#define SWAP_RA_LOW	25	/* percent of readahead pages used */
+#define SWAP_RA_HIGH	75
+
+/* Called with swap_lock held */
+static int swap_readahead_order(struct swap_info_struct *si)
+{
+	unsigned long ra_pages;
+	unsigned int max;
+
+	if (!(si->flags & SWP_SOLIDSTATE) || !si->bdev)
+		return page_cluster;
+
+	ra_pages = bdev_get_queue(si->bdev)->backing_dev_info.ra_pages;
+	max = ra_pages ? min_t(unsigned int, page_cluster, ilog2(ra_pages)) : 0;
+
+	if (si->ra_issued >= SWAP_RA_SAMPLE) {
+		unsigned int used = si->ra_hits * 100 / si->ra_issued;
+
+		if (used < SWAP_RA_LOW && si->ra_order)
+			si->ra_order--;
+		else if (used > SWAP_RA_HIGH)
+			si->ra_order++;
+		si->ra_issued = si->ra_hits = 0;
+	} else if (!si->ra_order && ++si->ra_idle >= SWAP_RA_SAMPLE) {
+		/* nothing gets sampled without a window: probe now and then */
+		si->ra_order = 1;
+		si->ra_idle = 0;
+	}
+	si->ra_order = min(si->ra_order, max);
+	return si->ra_order;
+}
+
+/*
+ * Account a swap cache page read ahead for entry (hit == 0), or found
+ * by a fault before it was otherwise used (hit == 1).  Lockless: losing
+ * an update only skews one sample.
+ */
+void swap_readahead_account(swp_entry_t entry, int hit)
+{
+	struct swap_info_struct *si = swap_info[swp_type(entry)];
+
+	if (hit)
+		si->ra_hits++;
+	else
+		si->ra_issued++;
+}
+
 /*
  * swap_lock prevents swap_map being freed. Don't grab an extra
  * reference on the swaphandle, it doesn't matter if it becomes unused.
@@ -2303,22 +2362,25 @@ int swapcache_prepare(swp_entry_t entry)
 int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
 {
 	struct swap_info_struct *si;
-	int our_page_cluster = page_cluster;
+	int our_page_cluster;
 	pgoff_t target, toff;
 	pgoff_t base, end;
 	int nr_pages = 0;
 
-	if (!our_page_cluster)	/* no readahead */
+	si = swap_info[swp_type(entry)];
+	spin_lock(&swap_lock);
+	our_page_cluster = swap_readahead_order(si);
+	if (!our_page_cluster) {	/* no readahead */
+		spin_unlock(&swap_lock);
 		return 0;
+	}
 
-	si = swap_info[swp_type(entry)];
 	target = swp_offset(entry);
 	base = (target >> our_page_cluster) << our_page_cluster;
 	end = base + (1 << our_page_cluster);
 	if (!base)		/* first page is swap header */
 		base++;
 
-	spin_lock(&swap_lock);
 	if (end > si->max)	/* don't go beyond end of map */
 		end = si->max;
 
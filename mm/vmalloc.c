@@ -560,9 +560,15 @@ static unsigned long lazy_max_pages(void)
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
+/* Largest span a purge flushes by range rather than flushing all TLBs */
+#define VMAP_PURGE_RANGE_MAX	(2048UL * PAGE_SIZE)
+
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
 
+/* for the per-CPU area caches */
+static void purge_vmap_caches_allcpus(void);
+
 /*
  * called before a call to iounmap() if the caller wants vm_area_struct's
  * immediately freed.
@@ -602,8 +608,10 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	} else
 		spin_lock(&purge_lock);
 
-	if (sync)
+	if (sync) {
 		purge_fragmented_blocks_allcpus();
+		purge_vmap_caches_allcpus();
+	}
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(va, &vmap_area_list, list) {
@@ -623,8 +631,17 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	if (nr)
 		atomic_sub(nr, &vmap_lazy_nr);
 
-	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+	/*
+	 * The freed areas can be spread all over vmalloc space, and a range
+	 * flush costs an operation per page of the span on most
+	 * architectures. Past a point, flushing everything is cheaper.
+	 */
+	if (nr || force_flush) {
+		if (*end - *start > VMAP_PURGE_RANGE_MAX)
+			flush_tlb_all();
+		else
+			flush_tlb_kernel_range(*start, *end);
+	}
 
 	if (nr) {
 		spin_lock(&vmap_area_lock);
@@ -699,15 +716,6 @@ static struct vmap_area *find_vmap_area(unsigned long addr)
 	return va;
 }
 
-static void free_unmap_vmap_area_addr(unsigned long addr)
-{
-	struct vmap_area *va;
-
-	va = find_vmap_area(addr);
-	BUG_ON(!va);
-	free_unmap_vmap_area(va);
-}
-
 
 /*** Per cpu kva allocator ***/
 
@@ -1008,6 +1016,121 @@ static void vb_free(const void *addr, unsigned long size)
 		spin_unlock(&vb->lock);
 }
 
+/*** Per cpu cache of large vm_map_ram areas ***/
+
+/*
+ * Mappings too large for the vmap blocks, ION buffers mapped for the
+ * kernel in particular, tend to come and go at a few sizes. Each one
+ * freed lazily adds to vmap_lazy_nr and so to the frequency of global
+ * purges. Instead a few unmapped areas are kept per CPU and handed out
+ * again for the same size, flushing the TLB for just that area.
+ */
+#define VMAP_CACHE_NR		4
+#define VMAP_CACHE_MAX_PAGES	2048	/* 8MB with 4K pages */
+
+struct vmap_area_cache {
+	spinlock_t lock;
+	int nr;
+	unsigned long pages;
+	/* oldest first */
+	struct vmap_area *va[VMAP_CACHE_NR];
+};
+
+static DEFINE_PER_CPU(struct vmap_area_cache, vmap_area_cache);
+
+static struct vmap_area *vmap_cache_get(unsigned long size)
+{
+	struct vmap_area_cache *cache;
+	struct vmap_area *va = NULL;
+	int i;
+
+	cache = &get_cpu_var(vmap_area_cache);
+	spin_lock(&cache->lock);
+	for (i = cache->nr - 1; i >= 0; i--) {
+		if (cache->va[i]->va_end - cache->va[i]->va_start != size)
+			continue;
+		va = cache->va[i];
+		cache->nr--;
+		memmove(&cache->va[i], &cache->va[i + 1],
+			(cache->nr - i) * sizeof(va));
+		cache->pages -= size >> PAGE_SHIFT;
+		break;
+	}
+	spin_unlock(&cache->lock);
+	put_cpu_var(vmap_area_cache);
+
+	/* Any CPU may still hold translations from the last use */
+	if (va)
+		flush_tlb_kernel_range(va->va_start, va->va_end);
+
+	return va;
+}
+
+/*
+ * Takes an area that has been unmapped but not flushed from the TLBs,
+ * making room by lazily freeing the oldest ones.
+ */
+static void vmap_cache_put(struct vmap_area *va)
+{
+	unsigned long pages = (va->va_end - va->va_start) >> PAGE_SHIFT;
+	struct vmap_area *evict[VMAP_CACHE_NR];
+	struct vmap_area_cache *cache;
+	int nr_evict = 0;
+	int i;
+
+	if (pages > VMAP_CACHE_MAX_PAGES) {
+		free_vmap_area_noflush(va);
+		return;
+	}
+
+	cache = &get_cpu_var(vmap_area_cache);
+	spin_lock(&cache->lock);
+	while (cache->nr == VMAP_CACHE_NR ||
+	       cache->pages + pages > VMAP_CACHE_MAX_PAGES) {
+		evict[nr_evict] = cache->va[0];
+		cache->pages -= (evict[nr_evict]->va_end -
+				 evict[nr_evict]->va_start) >> PAGE_SHIFT;
+		cache->nr--;
+		memmove(&cache->va[0], &cache->va[1],
+			cache->nr * sizeof(va));
+		nr_evict++;
+	}
+	cache->va[cache->nr++] = va;
+	cache->pages += pages;
+	spin_unlock(&cache->lock);
+	put_cpu_var(vmap_area_cache);
+
+	for (i = 0; i < nr_evict; i++)
+		free_vmap_area_noflush(evict[i]);
+}
+
+/*
+ * Hands the cached areas to the purge in progress, which then flushes
+ * them along with the rest. Called with purge_lock held, so the areas
+ * are only marked as the lazy free would, without trying to purge.
+ */
+static void purge_vmap_caches_allcpus(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_area_cache *cache = &per_cpu(vmap_area_cache, cpu);
+		int i;
+
+		spin_lock(&cache->lock);
+		for (i = 0; i < cache->nr; i++) {
+			struct vmap_area *va = cache->va[i];
+
+			va->flags |= VM_LAZY_FREE;
+			atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT,
+				   &vmap_lazy_nr);
+		}
+		cache->nr = 0;
+		cache->pages = 0;
+		spin_unlock(&cache->lock);
+	}
+}
+
 /**
  * vm_unmap_aliases - unmap outstanding lazy aliases in the vmap layer
  *
@@ -1086,10 +1209,16 @@ void vm_unmap_ram(const void *mem, unsigned int count)
 	debug_check_no_locks_freed(mem, size);
 	vmap_debug_free_range(addr, addr+size);
 
-	if (likely(count <= VMAP_MAX_ALLOC))
+	if (likely(count <= VMAP_MAX_ALLOC)) {
 		vb_free(mem, size);
-	else
-		free_unmap_vmap_area_addr(addr);
+	} else {
+		struct vmap_area *va = find_vmap_area(addr);
+
+		BUG_ON(!va);
+		flush_cache_vunmap(va->va_start, va->va_end);
+		unmap_vmap_area(va);
+		vmap_cache_put(va);
+	}
 }
 EXPORT_SYMBOL(vm_unmap_ram);
 
@@ -1115,8 +1244,10 @@ void *vm_map_ram(struct page **pages, unsigned int count, int node, pgprot_t pro
 		addr = (unsigned long)mem;
 	} else {
 		struct vmap_area *va;
-		va = alloc_vmap_area(size, PAGE_SIZE,
-				VMALLOC_START, VMALLOC_END, node, GFP_KERNEL);
+		va = vmap_cache_get(size);
+		if (!va)
+			va = alloc_vmap_area(size, PAGE_SIZE, VMALLOC_START,
+					     VMALLOC_END, node, GFP_KERNEL);
 		if (IS_ERR(va))
 			return NULL;
 
@@ -1169,6 +1300,8 @@ void __init vmalloc_init(void)
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
 		INIT_LIST_HEAD(&vbq->free);
+
+		spin_lock_init(&per_cpu(vmap_area_cache, i).lock);
 	}
 
 	/* Import existing vmlist entries. */
@@ -530,6 +530,8 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 
 		freepage = mapping->a_ops->freepage;
 
+		if (page_is_file_cache(page))
+			workingset_eviction(mapping, page);
 		__delete_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -1940,6 +1942,27 @@ static void shrink_zone(int priority, struct zone *zone,
 	unsigned long nr_reclaimed, nr_scanned;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
 
+	/*
+	 * Under global pressure, take what we can from the background
+	 * memory cgroups before the global LRU puts pressure on the
+	 * foreground ones.  The target grows as the priority drops.
+	 */
+	if (scanning_global_lru(sc)) {
+		unsigned long target;
+
+		target = max_t(unsigned long, SWAP_CLUSTER_MAX,
+			       zone_reclaimable_pages(zone) >> priority);
+		target = min(target, nr_to_reclaim);
+		nr_scanned = 0;
+		nr_reclaimed = mem_cgroup_priority_reclaim(zone, sc->gfp_mask,
+						!sc->may_swap, target,
+						&nr_scanned);
+		sc->nr_reclaimed += nr_reclaimed;
+		sc->nr_scanned += nr_scanned;
+		if (nr_reclaimed >= target)
+			return;
+	}
+
 restart:
 	nr_reclaimed = 0;
 	nr_scanned = sc->nr_scanned;
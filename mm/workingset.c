@@ -0,0 +1,173 @@
+/*
+ * linux/mm/workingset.c
+ *
+ * Workingset detection for the file LRU.
+ *
+ * A file page that is reclaimed from the inactive list and faults back
+ * in soon after could have stayed resident had the inactive list been
+ * a little larger.  To notice that, reclaim leaves a shadow entry for
+ * each evicted page, stamped with a per-zone clock that ticks on every
+ * eviction and activation.  When the page is added to the page cache
+ * again, the number of ticks since its eviction - the refault distance -
+ * is the minimum number of extra inactive slots it would have needed.
+ * If that is no more than the zone's active file pages, the page is
+ * put straight on the active list to compete with them.
+ *
+ * The shadow entries live in a lossy hash table rather than in the
+ * page cache radix tree, so that no page cache walker has to learn
+ * about them: a colliding eviction simply overwrites an older entry
+ * and a truncated mapping leaves stale ones behind, which at worst
+ * costs one missed or one spurious activation.
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/init.h>
+
+/*
+ * Shadow entry layout: hash tag, eviction clock, node and zone index.
+ * An empty slot reads as zero.
+ */
+#define SHADOW_ZONE_BITS	8
+#define SHADOW_EVICT_SHIFT	SHADOW_ZONE_BITS
+#define SHADOW_EVICT_MASK	0xffffffffUL
+#define SHADOW_TAG_SHIFT	40
+#define SHADOW_TAG_MASK		0xffffffU
+
+#define SHADOW_MIN_ENTRIES	1024UL
+#define SHADOW_MAX_ENTRIES	(1UL << 20)
+
+static atomic64_t *shadow_table;
+static unsigned int shadow_shift;
+
+static u32 workingset_hash(struct address_space *mapping, pgoff_t index)
+{
+	return jhash_2words((u32)(unsigned long)mapping, (u32)index, 0);
+}
+
+static atomic64_t *workingset_slot(u32 hash)
+{
+	return &shadow_table[hash >> (32 - shadow_shift)];
+}
+
+static u64 pack_shadow(u32 hash, struct zone *zone, unsigned long eviction)
+{
+	u64 zoneid = (zone_to_nid(zone) << ZONES_SHIFT) | zone_idx(zone);
+
+	return (u64)(hash & SHADOW_TAG_MASK) << SHADOW_TAG_SHIFT |
+	       (u64)(eviction & SHADOW_EVICT_MASK) << SHADOW_EVICT_SHIFT |
+	       zoneid;
+}
+
+static struct zone *unpack_shadow(u64 shadow, unsigned long *eviction)
+{
+	unsigned int zoneid = shadow & ((1 << SHADOW_ZONE_BITS) - 1);
+	int nid = zoneid >> ZONES_SHIFT;
+
+	*eviction = (shadow >> SHADOW_EVICT_SHIFT) & SHADOW_EVICT_MASK;
+	return &NODE_DATA(nid)->node_zones[zoneid & ((1 << ZONES_SHIFT) - 1)];
+}
+
+/**
+ * workingset_eviction - note the eviction of a file page
+ * @mapping: address space the page was mapped to
+ * @page: the page being evicted
+ *
+ * Called from reclaim with the page locked, just before it is removed
+ * from @mapping.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+	u32 hash;
+
+	if (!shadow_table)
+		return;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	hash = workingset_hash(mapping, page->index);
+	atomic64_set(workingset_slot(hash), pack_shadow(hash, zone, eviction));
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @mapping: address space the page is being added to
+ * @index: the page's offset in @mapping
+ *
+ * Consumes the shadow entry of the page, if any, and returns true if
+ * the page should be activated: its refault distance fits within the
+ * active file list of the zone it was evicted from.
+ */
+bool workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	unsigned long eviction, distance;
+	struct zone *zone;
+	atomic64_t *slot;
+	u64 shadow;
+	u32 hash;
+
+	if (!shadow_table)
+		return false;
+
+	hash = workingset_hash(mapping, index);
+	slot = workingset_slot(hash);
+	shadow = atomic64_read(slot);
+	if (!shadow || (shadow >> SHADOW_TAG_SHIFT) != (hash & SHADOW_TAG_MASK))
+		return false;
+	if (atomic64_cmpxchg(slot, shadow, 0) != shadow)
+		return false;
+
+	zone = unpack_shadow(shadow, &eviction);
+	distance = (atomic_long_read(&zone->inactive_age) - eviction) &
+		   SHADOW_EVICT_MASK;
+
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+	if (distance > zone_page_state(zone, NR_ACTIVE_FILE))
+		return false;
+
+	inc_zone_state(zone, WORKINGSET_ACTIVATE);
+	return true;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ *
+ * Activations shrink the inactive list just as evictions do, so they
+ * advance the zone's clock too.
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+static int __init workingset_init(void)
+{
+	unsigned long entries;
+	atomic64_t *table;
+
+	BUILD_BUG_ON(NODES_SHIFT + ZONES_SHIFT > SHADOW_ZONE_BITS);
+
+	/* one shadow slot per four pages of memory */
+	entries = clamp(totalram_pages >> 2, SHADOW_MIN_ENTRIES,
+			SHADOW_MAX_ENTRIES);
+	entries = rounddown_pow_of_two(entries);
+
+	table = vzalloc(entries * sizeof(atomic64_t));
+	if (!table) {
+		pr_warning("workingset: no memory for %lu shadow entries\n",
+			   entries);
+		return -ENOMEM;
+	}
+	shadow_shift = ilog2(entries);
+	smp_wmb();
+	shadow_table = table;
+	return 0;
+}
+module_init(workingset_init);
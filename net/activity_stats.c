@@ -14,6 +14,8 @@
  * Author: Mike Chan (mike@android.com)
  */
 
+#include <linux/atomic.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
 #include <linux/suspend.h>
 #include <net/net_namespace.h>
@@ -27,22 +29,24 @@
  */
 #define BUCKET_MAX 10
 
-/* Track network activity frequency */
-static unsigned long activity_stats[BUCKET_MAX];
-static ktime_t last_transmit;
+/*
+ * Track network activity frequency.  The counters are per CPU and only
+ * added up when read.  last_transmit is read for every packet but only
+ * written when a new period of activity starts, and whichever CPU moves
+ * it on counts that period, so each one is counted once.
+ */
+static DEFINE_PER_CPU(unsigned long [BUCKET_MAX], activity_stats);
+static atomic64_t last_transmit = ATOMIC64_INIT(0);
 static ktime_t suspend_time;
-static DEFINE_SPINLOCK(activity_lock);
 
 void activity_stats_update(void)
 {
 	int i;
-	unsigned long flags;
-	ktime_t now;
-	s64 delta;
+	s64 now, last, delta;
 
-	spin_lock_irqsave(&activity_lock, flags);
-	now = ktime_get();
-	delta = ktime_to_ns(ktime_sub(now, last_transmit));
+	now = ktime_to_ns(ktime_get());
+	last = atomic64_read(&last_transmit);
+	delta = now - last;
 
 	for (i = BUCKET_MAX - 1; i >= 0; i--) {
 		/*
@@ -52,11 +56,10 @@ void activity_stats_update(void)
 		if (delta < (1000000000ULL << i))
 			continue;
 
-		activity_stats[i]++;
-		last_transmit = now;
+		if (atomic64_cmpxchg(&last_transmit, last, now) == last)
+			this_cpu_inc(activity_stats[i]);
 		break;
 	}
-	spin_unlock_irqrestore(&activity_lock, flags);
 }
 
 static int activity_stats_read_proc(char *page, char **start, off_t off,
@@ -75,7 +78,12 @@ static int activity_stats_read_proc(char *page, char **start, off_t off,
 	p += len;
 
 	for (i = 0; i < BUCKET_MAX; i++) {
-		len = snprintf(p, count, "%15d %lu\n", 1 << i, activity_stats[i]);
+		unsigned long sum = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu)
+			sum += per_cpu(activity_stats, cpu)[i];
+		len = snprintf(p, count, "%15d %lu\n", 1 << i, sum);
 		count -= len;
 		p += len;
 	}
@@ -94,7 +102,7 @@ static int activity_stats_notifier(struct notifier_block *nb,
 
 		case PM_POST_SUSPEND:
 			suspend_time = ktime_sub(ktime_get_real(), suspend_time);
-			last_transmit = ktime_sub(last_transmit, suspend_time);
+			atomic64_sub(ktime_to_ns(suspend_time), &last_transmit);
 	}
 
 	return 0;
@@ -322,6 +322,63 @@ static ssize_t show_packet_inactive_time(struct device *dev,
 	return ret;
 }
 
+/* TCP buffer profile: "default max" in bytes, "0 0" to use the sysctls */
+static ssize_t show_tcp_mem(const int *mem, char *buf)
+{
+	return sprintf(buf, "%d %d\n", mem[0], mem[1]);
+}
+
+static ssize_t store_tcp_mem(struct device *dev, int *mem,
+			     const char *buf, size_t len)
+{
+	struct net_device *netdev = to_net_dev(dev);
+	int def, max;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (sscanf(buf, "%d %d", &def, &max) != 2)
+		return -EINVAL;
+	if (def < 0 || max < 0 || !def != !max || def > max)
+		return -EINVAL;
+
+	if (!rtnl_trylock())
+		return restart_syscall();
+	if (dev_isalive(netdev)) {
+		mem[0] = def;
+		mem[1] = max;
+	}
+	rtnl_unlock();
+
+	return len;
+}
+
+static ssize_t show_tcp_rmem(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	return show_tcp_mem(to_net_dev(dev)->tcp_rmem, buf);
+}
+
+static ssize_t store_tcp_rmem(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t len)
+{
+	return store_tcp_mem(dev, to_net_dev(dev)->tcp_rmem, buf, len);
+}
+
+static ssize_t show_tcp_wmem(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	return show_tcp_mem(to_net_dev(dev)->tcp_wmem, buf);
+}
+
+static ssize_t store_tcp_wmem(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t len)
+{
+	return store_tcp_mem(dev, to_net_dev(dev)->tcp_wmem, buf, len);
+}
+
 static struct device_attribute net_class_attributes[] = {
 	__ATTR(addr_assign_type, S_IRUGO, show_addr_assign_type, NULL),
 	__ATTR(addr_len, S_IRUGO, show_addr_len, NULL),
@@ -345,6 +402,8 @@ static struct device_attribute net_class_attributes[] = {
 	       store_tx_queue_len),
 	__ATTR(netdev_group, S_IRUGO | S_IWUSR, show_group, store_group),
 	__ATTR(packet_inactive_time, S_IRUGO, show_packet_inactive_time, NULL),
+	__ATTR(tcp_rmem, S_IRUGO | S_IWUSR, show_tcp_rmem, store_tcp_rmem),
+	__ATTR(tcp_wmem, S_IRUGO | S_IWUSR, show_tcp_wmem, store_tcp_wmem),
 	{}
 };
 
@@ -2537,6 +2537,34 @@ struct sk_buff *tcp_make_synack(struct sock *sk, struct dst_entry *dst,
 }
 EXPORT_SYMBOL(tcp_make_synack);
 
+/* Apply the buffer profile of the device the connection is routed over.
+ * Called once the route is known, at connect and when a child socket is
+ * created for an accepted connection.  Sizes locked with SO_RCVBUF or
+ * SO_SNDBUF are left alone, but the autotuning ceilings still apply.
+ */
+void tcp_init_dev_buffers(struct sock *sk, const struct dst_entry *dst)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	const struct net_device *dev = dst->dev;
+	int rmem_def = 0, rmem_max = 0, wmem_def = 0, wmem_max = 0;
+
+	if (dev) {
+		rmem_def = ACCESS_ONCE(dev->tcp_rmem[0]);
+		rmem_max = ACCESS_ONCE(dev->tcp_rmem[1]);
+		wmem_def = ACCESS_ONCE(dev->tcp_wmem[0]);
+		wmem_max = ACCESS_ONCE(dev->tcp_wmem[1]);
+	}
+
+	tp->rcvbuf_max = rmem_max;
+	tp->sndbuf_max = wmem_max;
+
+	if (rmem_def && !(sk->sk_userlocks & SOCK_RCVBUF_LOCK))
+		sk->sk_rcvbuf = min(rmem_def, tcp_rmem_max(sk));
+	if (wmem_def && !(sk->sk_userlocks & SOCK_SNDBUF_LOCK))
+		sk->sk_sndbuf = min(wmem_def, tcp_wmem_max(sk));
+}
+EXPORT_SYMBOL(tcp_init_dev_buffers);
+
 /* Do all connect socket setups that can be done AF independent. */
 static void tcp_connect_init(struct sock *sk)
 {
@@ -2569,6 +2597,7 @@ static void tcp_connect_init(struct sock *sk)
 		tp->advmss = tp->rx_opt.user_mss;
 
 	tcp_initialize_rcv_mss(sk);
+	tcp_init_dev_buffers(sk, dst);
 
 	/* limit the window selection if the user enforce a smaller rx buffer */
 	if (sk->sk_userlocks & SOCK_RCVBUF_LOCK &&
@@ -205,6 +205,9 @@ struct ieee80211_rx_data {
 	int queue;
 	u32 tkip_iv32;
 	u16 tkip_iv16;
+
+	/* deliver data frames to the stack through GRO on this */
+	struct napi_struct *napi;
 };
 
 struct beacon_data {
@@ -979,6 +982,8 @@ struct ieee80211_local {
 	struct net_device napi_dev;
 
 	struct napi_struct napi;
+	/* CPU running the driver's napi_poll, or -1 */
+	int napi_poll_cpu;
 };
 
 static inline struct ieee80211_sub_if_data *
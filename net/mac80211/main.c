@@ -470,8 +470,13 @@ static int ieee80211_napi_poll(struct napi_struct *napi, int budget)
 {
 	struct ieee80211_local *local =
 		container_of(napi, struct ieee80211_local, napi);
+	int work_done;
 
-	return local->ops->napi_poll(&local->hw, budget);
+	local->napi_poll_cpu = smp_processor_id();
+	work_done = local->ops->napi_poll(&local->hw, budget);
+	local->napi_poll_cpu = -1;
+
+	return work_done;
 }
 
 void ieee80211_napi_schedule(struct ieee80211_hw *hw)
@@ -673,6 +678,7 @@ struct ieee80211_hw *ieee80211_alloc_hw(size_t priv_data_len,
 
 	/* init dummy netdev for use w/ NAPI */
 	init_dummy_netdev(&local->napi_dev);
+	local->napi_poll_cpu = -1;
 
 	ieee80211_led_names(local);
 
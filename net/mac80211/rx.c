@@ -1734,7 +1734,20 @@ ieee80211_deliver_skb(struct ieee80211_rx_data *rx)
 			/* deliver to local stack */
 			skb->protocol = eth_type_trans(skb, dev);
 			memset(skb->cb, 0, sizeof(skb->cb));
-			netif_receive_skb(skb);
+			if (rx->napi) {
+				/*
+				 * GRO only merges TCP segments with a known
+				 * checksum, sum them here instead of later
+				 * in the copy to user space.
+				 */
+				if (skb->ip_summed == CHECKSUM_NONE) {
+					skb->csum = skb_checksum(skb, 0,
+								 skb->len, 0);
+					skb->ip_summed = CHECKSUM_COMPLETE;
+				}
+				napi_gro_receive(rx->napi, skb);
+			} else
+				netif_receive_skb(skb);
 		}
 	}
 
@@ -2758,6 +2771,10 @@ static void __ieee80211_rx_handle_packet(struct ieee80211_hw *hw,
 	rx.skb = skb;
 	rx.local = local;
 
+	/* called from the driver's NAPI poll */
+	if (local->napi_poll_cpu == smp_processor_id())
+		rx.napi = &local->napi;
+
 	if (ieee80211_is_data(fc) || ieee80211_is_mgmt(fc))
 		local->dot11ReceivedFragmentCount++;
 
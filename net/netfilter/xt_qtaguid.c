@@ -15,13 +15,16 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
+#include <linux/percpu.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
+#include <net/genetlink.h>
 #include <net/sock.h>
 #include <net/tcp.h>
 #include <net/udp.h>
@@ -146,6 +149,10 @@ static struct proc_dir_entry *iface_stat_all_procfile;
  *   iface_stat_list_lock
  *     struct iface_stat->tag_stat_list_lock
  *
+ * qtaguid_nl_dump_stats()
+ *   iface_stat_list_lock
+ *     struct iface_stat->tag_stat_list_lock
+ *
  * qtudev_open()
  *   uid_tag_data_tree_lock
  *
@@ -178,15 +185,14 @@ static struct proc_dir_entry *iface_stat_all_procfile;
  * qtaguid_mt()
  *   account_for_uid()
  *     if_tag_stat_update()
+ *       struct iface_stat->tag_stat_list_lock
+ *         (per cpu sock_tag_cache hit: tag_stat_update())
  *       get_sock_stat()
  *         sock_tag_list_lock
+ *       get_active_counter_set()
+ *         tag_counter_set_list_lock
  *       struct iface_stat->tag_stat_list_lock
  *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
  *
  *
  * qtaguid_ctrl_parse()
@@ -224,6 +230,24 @@ static struct rb_root uid_tag_data_tree = RB_ROOT;
 static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
 
 static struct rb_root proc_qtu_data_tree = RB_ROOT;
+
+/*
+ * Per cpu cache of what if_tag_stat_update() resolved for a socket.
+ * Any tagging, untagging, counter set change or tag_stat removal bumps
+ * sock_tag_cache_gen, which invalidates all the entries.  Removing a
+ * tag_stat bumps it under the iface's tag_stat_list_lock, so a cached
+ * tag_stat is safe to use under that lock while the generation matches.
+ */
+static DEFINE_PER_CPU(struct sock_tag_cache [SOCK_TAG_CACHE_SIZE],
+		      sock_tag_cache);
+static atomic_t sock_tag_cache_gen = ATOMIC_INIT(0);
+
+/*
+ * Bumped by each netlink stats dump.  Every tag_stat records the value
+ * at its last update, so a dump can skip what didn't change since an
+ * earlier one.
+ */
+static atomic_t qtu_stats_gen = ATOMIC_INIT(1);
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
@@ -276,6 +300,11 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+static inline void sock_tag_cache_invalidate(void)
+{
+	atomic_inc(&sock_tag_cache_gen);
+}
+
 static struct tag_node *tag_node_tree_search(struct rb_root *root, tag_t tag)
 {
 	struct rb_node *node = root->rb_node;
@@ -1216,20 +1245,22 @@ static void iface_stat_update(struct net_device *net_dev, bool stash_only)
 	spin_unlock_bh(&iface_stat_list_lock);
 }
 
-static void tag_stat_update(struct tag_stat *tag_entry,
+static void tag_stat_update(struct tag_stat *tag_entry, int active_set,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
-	int active_set;
-	active_set = get_active_counter_set(tag_entry->tn.tag);
 	MT_DEBUG("qtaguid: tag_stat_update(tag=0x%llx (uid=%u) set=%d "
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
 	data_counters_update(&tag_entry->counters, active_set, direction,
 			     proto, bytes);
-	if (tag_entry->parent_counters)
+	tag_entry->gen = atomic_read(&qtu_stats_gen);
+	if (tag_entry->parent_counters) {
 		data_counters_update(tag_entry->parent_counters, active_set,
 				     direction, proto, bytes);
+		container_of(tag_entry->parent_counters, struct tag_stat,
+			     counters)->gen = tag_entry->gen;
+	}
 }
 
 /*
@@ -1266,6 +1297,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat;
+	struct sock_tag_cache *cache;
+	unsigned int gen;
+	int active_set;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
@@ -1282,6 +1316,24 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
 		 ifname, iface_entry);
 
+	/*
+	 * Same socket, uid and iface as last time on this cpu: bill the
+	 * same tag_stat, without the global lookups.  The per cpu entry
+	 * is only touched with BHs disabled.
+	 */
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	cache = &__get_cpu_var(sock_tag_cache)[
+		hash_ptr((void *)sk, SOCK_TAG_CACHE_BITS)];
+	gen = atomic_read(&sock_tag_cache_gen);
+	if (cache->tag_stat && cache->gen == gen && cache->sk == sk &&
+	    cache->uid == uid && cache->iface == iface_entry) {
+		tag_stat_update(cache->tag_stat, cache->active_set,
+				direction, proto, bytes);
+		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+		return;
+	}
+	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+
 	/*
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
@@ -1296,6 +1348,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		tag = combine_atag_with_uid(acct_tag, uid);
 		uid_tag = make_tag_from_uid(uid);
 	}
+	active_set = get_active_counter_set(tag);
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
@@ -1309,9 +1362,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
-		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
+		tag_stat_update(tag_stat_entry, active_set, direction, proto,
+				bytes);
+		goto cache;
 	}
 
 	/* Loop over tag list under this interface for {0,uid_tag} */
@@ -1333,7 +1386,19 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		new_tag_stat = create_if_tag_stat(iface_entry, tag);
 		new_tag_stat->parent_counters = uid_tag_counters;
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
+	tag_stat_update(new_tag_stat, active_set, direction, proto, bytes);
+	tag_stat_entry = new_tag_stat;
+
+cache:
+	/* gen was read before the lookups, any change since is a miss */
+	cache = &__get_cpu_var(sock_tag_cache)[
+		hash_ptr((void *)sk, SOCK_TAG_CACHE_BITS)];
+	cache->sk = sk;
+	cache->uid = uid;
+	cache->iface = iface_entry;
+	cache->tag_stat = tag_stat_entry;
+	cache->active_set = active_set;
+	cache->gen = gen;
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 }
 
@@ -1914,6 +1979,7 @@ static int ctrl_cmd_delete(const char *input)
 
 		if (!acct_tag || st_entry->tag == tag) {
 			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			sock_tag_cache_invalidate();
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -1947,6 +2013,7 @@ static int ctrl_cmd_delete(const char *input)
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
 		kfree(tcs_entry);
+		sock_tag_cache_invalidate();
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -1977,6 +2044,7 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
+				sock_tag_cache_invalidate();
 				kfree(ts_entry);
 			}
 		}
@@ -2065,6 +2133,7 @@ static int ctrl_cmd_counter_set(const char *input)
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
 	tcs->active_set = counter_set;
+	sock_tag_cache_invalidate();
 	spin_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
@@ -2159,6 +2228,7 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
 		sock_tag_entry->tag = full_tag;
+		sock_tag_cache_invalidate();
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2198,6 +2268,7 @@ static int ctrl_cmd_tag(const char *input)
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		sock_tag_cache_invalidate();
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2262,6 +2333,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * so it can do whatever it wants to it.
 	 */
 	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	sock_tag_cache_invalidate();
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2539,6 +2611,149 @@ static int qtaguid_stats_proc_read(char *page, char **num_items_returned,
 	return ppi.outp - page;
 }
 
+/*------------------------------------------*/
+static struct genl_family qtaguid_genl_family = {
+	.id = GENL_ID_GENERATE,
+	.name = QTAGUID_GENL_NAME,
+	.version = QTAGUID_GENL_VERSION,
+	.maxattr = QTAGUID_ATTR_MAX,
+};
+
+static const struct nla_policy qtaguid_genl_policy[QTAGUID_ATTR_MAX + 1] = {
+	[QTAGUID_ATTR_UID] = { .type = NLA_U32 },
+	[QTAGUID_ATTR_GENERATION] = { .type = NLA_U32 },
+};
+
+static int qtaguid_nl_put_record(struct sk_buff *skb,
+				 struct iface_stat *iface_entry,
+				 struct tag_stat *ts_entry, int cnt_set)
+{
+	struct qtaguid_stats_record rec;
+	struct data_counters *cnts = &ts_entry->counters;
+	int proto;
+
+	memset(&rec, 0, sizeof(rec));
+	strlcpy(rec.iface, iface_entry->ifname, sizeof(rec.iface));
+	rec.acct_tag = get_atag_from_tag(ts_entry->tn.tag);
+	rec.uid = get_uid_from_tag(ts_entry->tn.tag);
+	rec.cnt_set = cnt_set;
+	for (proto = 0; proto < IFS_MAX_PROTOS; proto++) {
+		rec.rx[proto].bytes = cnts->bpc[cnt_set][IFS_RX][proto].bytes;
+		rec.rx[proto].packets =
+			cnts->bpc[cnt_set][IFS_RX][proto].packets;
+		rec.tx[proto].bytes = cnts->bpc[cnt_set][IFS_TX][proto].bytes;
+		rec.tx[proto].packets =
+			cnts->bpc[cnt_set][IFS_TX][proto].packets;
+	}
+
+	return nla_put(skb, QTAGUID_ATTR_STATS_RECORD, sizeof(rec), &rec);
+}
+
+/*
+ * Dump state in cb->args: [0] iface and [1] tag_stat to resume at,
+ * [2] counter set within it, [3] the dump's generation, [4] done.
+ * As with the proc file, stats of other uids need the privilege.
+ */
+static int qtaguid_nl_dump_stats(struct sk_buff *skb,
+				 struct netlink_callback *cb)
+{
+	struct nlattr *attrs[QTAGUID_ATTR_MAX + 1];
+	struct iface_stat *iface_entry;
+	struct tag_stat *ts_entry;
+	struct rb_node *node;
+	bool filter_uid = false;
+	uid_t uid = 0;
+	unsigned int since = 0;
+	long iface_idx, ts_idx;
+	int cnt_set, err;
+	void *hdr;
+
+	if (unlikely(module_passive) || cb->args[4])
+		return 0;
+
+	err = nlmsg_parse(cb->nlh, GENL_HDRLEN + qtaguid_genl_family.hdrsize,
+			  attrs, QTAGUID_ATTR_MAX, qtaguid_genl_policy);
+	if (err < 0)
+		return err;
+	if (attrs[QTAGUID_ATTR_UID]) {
+		filter_uid = true;
+		uid = nla_get_u32(attrs[QTAGUID_ATTR_UID]);
+	}
+	if (attrs[QTAGUID_ATTR_GENERATION])
+		since = nla_get_u32(attrs[QTAGUID_ATTR_GENERATION]);
+
+	/* later updates get the new generation, and the next dump them */
+	if (!cb->args[3])
+		cb->args[3] = atomic_inc_return(&qtu_stats_gen);
+
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).pid, cb->nlh->nlmsg_seq,
+			  &qtaguid_genl_family, NLM_F_MULTI,
+			  QTAGUID_CMD_GET_STATS);
+	if (!hdr)
+		return -EMSGSIZE;
+	if (nla_put_u32(skb, QTAGUID_ATTR_GENERATION, cb->args[3])) {
+		genlmsg_cancel(skb, hdr);
+		return -EMSGSIZE;
+	}
+
+	iface_idx = 0;
+	spin_lock_bh(&iface_stat_list_lock);
+	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+		if (iface_idx++ < cb->args[0])
+			continue;
+		ts_idx = 0;
+		spin_lock_bh(&iface_entry->tag_stat_list_lock);
+		for (node = rb_first(&iface_entry->tag_stat_tree);
+		     node;
+		     node = rb_next(node), ts_idx++) {
+			uid_t stat_uid;
+
+			if (ts_idx < cb->args[1])
+				continue;
+			ts_entry = rb_entry(node, struct tag_stat, tn.node);
+			stat_uid = get_uid_from_tag(ts_entry->tn.tag);
+			cnt_set = cb->args[2];
+			cb->args[2] = 0;
+
+			if (filter_uid && stat_uid != uid)
+				continue;
+			if (since && (int)(ts_entry->gen - since) < 0)
+				continue;
+			if (!can_read_other_uid_stats(stat_uid))
+				continue;
+
+			for (; cnt_set < IFS_MAX_COUNTER_SETS; cnt_set++) {
+				if (!qtaguid_nl_put_record(skb, iface_entry,
+							   ts_entry, cnt_set))
+					continue;
+				/* message full, resume here */
+				cb->args[0] = iface_idx - 1;
+				cb->args[1] = ts_idx;
+				cb->args[2] = cnt_set;
+				spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+				spin_unlock_bh(&iface_stat_list_lock);
+				goto out;
+			}
+		}
+		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+		cb->args[1] = 0;
+	}
+	spin_unlock_bh(&iface_stat_list_lock);
+	cb->args[4] = 1;
+
+out:
+	genlmsg_end(skb, hdr);
+	return skb->len;
+}
+
+static struct genl_ops qtaguid_genl_ops[] = {
+	{
+		.cmd = QTAGUID_CMD_GET_STATS,
+		.policy = qtaguid_genl_policy,
+		.dumpit = qtaguid_nl_dump_stats,
+	},
+};
+
 /*------------------------------------------*/
 static int qtudev_open(struct inode *inode, struct file *file)
 {
@@ -2657,6 +2872,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
 		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		sock_tag_cache_invalidate();
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -2764,7 +2980,10 @@ static int __init qtaguid_mt_init(void)
 	if (qtaguid_proc_register(&xt_qtaguid_procdir)
 	    || iface_stat_init(xt_qtaguid_procdir)
 	    || xt_register_match(&qtaguid_mt_reg)
-	    || misc_register(&qtu_device))
+	    || misc_register(&qtu_device)
+	    || genl_register_family_with_ops(&qtaguid_genl_family,
+					     qtaguid_genl_ops,
+					     ARRAY_SIZE(qtaguid_genl_ops)))
 		return -1;
 	return 0;
 }
@@ -162,7 +162,7 @@ enum ifs_tx_rx {
 	IFS_MAX_DIRECTIONS
 };
 
-/* For now, TCP, UDP, the rest */
+/* For now, TCP, UDP, the rest.  Same order as QTAGUID_PROTO_*. */
 enum ifs_proto {
 	IFS_TCP,
 	IFS_UDP,
@@ -193,6 +193,8 @@ struct tag_stat {
 	 * matching parent uid_tag.
 	 */
 	struct data_counters *parent_counters;
+	/* qtu_stats_gen at the last update, for the netlink dumps */
+	unsigned int gen;
 };
 
 struct iface_stat {
@@ -275,6 +277,23 @@ struct qtaguid_event_counts {
 	atomic64_t match_no_sk_file;
 };
 
+/*
+ * What if_tag_stat_update() last resolved for a socket on a cpu: the
+ * tag_stat to bill on the iface, and the tag's active counter set.
+ * Only valid while gen matches sock_tag_cache_gen.
+ */
+#define SOCK_TAG_CACHE_BITS 4
+#define SOCK_TAG_CACHE_SIZE (1 << SOCK_TAG_CACHE_BITS)
+
+struct sock_tag_cache {
+	const struct sock *sk;  /* Only used as a number, never dereferenced */
+	uid_t uid;
+	struct iface_stat *iface;
+	struct tag_stat *tag_stat;
+	int active_set;
+	unsigned int gen;
+};
+
 /* Track the set active_set for the given tag. */
 struct tag_counter_set {
 	struct tag_node tn;
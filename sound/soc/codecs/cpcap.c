@@ -699,6 +699,40 @@ static int cpcap_audio_reg_write(struct snd_soc_codec *codec,
 	}
 }
 
+/*
+ * write several cpcap audio registers, as {register, value} pairs, in one
+ * spi transaction; the cache is updated as by cpcap_audio_reg_write
+ */
+static int cpcap_audio_reg_write_batch(struct snd_soc_codec *codec,
+				       const unsigned short (*regs)[2], int n)
+{
+	struct cpcap_regacc ops[CPCAP_AUDIO_REG_NUM];
+	struct cpcap_audio_state *state = snd_soc_codec_get_drvdata(codec);
+	unsigned short *cache = codec->reg_cache;
+	int i;
+
+	if (!state || !state->cpcap || !cache || n > CPCAP_AUDIO_REG_NUM)
+		return -EIO;
+
+	for (i = 0; i < n; i++) {
+		if (regs[i][0] >= CPCAP_AUDIO_REG_NUM)
+			return -EIO;
+		ops[i].reg = CPCAP_AUDIO_INDEX_REG(regs[i][0]);
+		ops[i].value = regs[i][1];
+		ops[i].mask = cpcap_audio_reg_mask[regs[i][0]];
+	}
+
+	if (cpcap_regacc_write_batch(state->cpcap, ops, n)) {
+		printk(KERN_ERR "%s: failed to write %d registers\n",
+			__func__, n);
+		return -EIO;
+	}
+
+	for (i = 0; i < n; i++)
+		cache[regs[i][0]] = regs[i][1] & cpcap_audio_reg_mask[regs[i][0]];
+	return 0;
+}
+
 static void cpcap_audio_register_dump(struct snd_soc_codec *codec)
 {
 	unsigned short *cache;
@@ -1390,6 +1424,10 @@ static int snd_soc_put_cpcap_dai_mode(struct snd_kcontrol *kcontrol,
 
 void cpcap_audio_init(struct snd_soc_codec *codec)
 {
+	unsigned short init[][2] = {
+		{1, 0}, {2, 0}, {3, 0}, {4, 4}, {5, 0}, {6, 0x0400},
+		{7, 0}, {9, 0}, {10, 0}, {11, 0}, {13, 0},
+	};
 	int i;
 	struct cpcap_device *cpcap;
 	unsigned short *cache = codec->reg_cache;
@@ -1402,17 +1440,8 @@ void cpcap_audio_init(struct snd_soc_codec *codec)
 	cpcap = state->cpcap;
 	for (i = 0; i < CPCAP_AUDIO_REG_NUM; i++)
 		cpcap_audio_reg_read(codec, i);
-	cpcap_audio_reg_write(codec, 1, 0);
-	cpcap_audio_reg_write(codec, 2, 0);
-	cpcap_audio_reg_write(codec, 3, 0);
-	cpcap_audio_reg_write(codec, 4, 4);
-	cpcap_audio_reg_write(codec, 5, 0);
-	cpcap_audio_reg_write(codec, 6, 0x0400);
-	cpcap_audio_reg_write(codec, 7, 0);
-	cpcap_audio_reg_write(codec, 9, 0);
-	cpcap_audio_reg_write(codec, 10, 0);
-	cpcap_audio_reg_write(codec, 11, 0);
-	cpcap_audio_reg_write(codec, 13, cache[13] | CPCAP_BIT_A2_FREE_RUN);
+	init[ARRAY_SIZE(init) - 1][1] = cache[13] | CPCAP_BIT_A2_FREE_RUN;
+	cpcap_audio_reg_write_batch(codec, init, ARRAY_SIZE(init));
 
 	/* This is not an audio register, go through cpcap api directly */
 	cpcap_regacc_write(cpcap, CPCAP_REG_GPIO4,
@@ -1530,6 +1559,9 @@ aok:
 static void cpcap_mm_shutdown(struct snd_pcm_substream *substream,
 			     struct snd_soc_dai *dai)
 {
+	static const unsigned short stdac_off[][2] = {
+		{3, 0}, {4, 4}, {10, 0},
+	};
 	struct snd_soc_codec *codec = dai->codec;
 	struct cpcap_audio_state *state = snd_soc_codec_get_drvdata(codec);
 
@@ -1543,9 +1575,8 @@ static void cpcap_mm_shutdown(struct snd_pcm_substream *substream,
 
 	state->stdac_strm_cnt--;
 	if (state->stdac_strm_cnt == 0) {
-		cpcap_audio_reg_write(codec, 3, 0);
-		cpcap_audio_reg_write(codec, 4, 4);
-		cpcap_audio_reg_write(codec, 10, 0);
+		cpcap_audio_reg_write_batch(codec, stdac_off,
+					    ARRAY_SIZE(stdac_off));
 		if (state->codec_strm_cnt == 0) {
 			if (emu_analog_antipop == 0) {
 				cpcap_audio_reg_write(codec, 7, 0);
@@ -123,6 +123,11 @@ struct omap_abe {
 	u32 irq_dbg_read_ptr;
 
 	struct omap_abe_dbg dbg;
+
+	/* memories as left by a full reload, replayed after further OFF */
+	u32 *fw_image;
+	u32 *fw_image_src;
+	u32 fw_image_size[4];		/* DMEM, CMEM, SMEM, PMEM */
 };
 
 extern struct omap_abe *abe;
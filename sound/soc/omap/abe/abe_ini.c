@@ -61,6 +61,7 @@
 #include <linux/init.h>
 #include <linux/err.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 
 #include "abe_dbg.h"
 #include "abe.h"
@@ -209,11 +210,98 @@ int omap_abe_load_fw(struct omap_abe *abe, u32 *firmware)
 }
 EXPORT_SYMBOL(omap_abe_load_fw);
 
+/**
+ * omap_abe_save_fw_image - Keep a copy of the freshly reloaded memories
+ * @abe: Pointer on abe handle
+ * @firmware: firmware the memories were loaded from
+ *
+ * The copy covers what the firmware image loads in each memory, which
+ * includes the scheduler table and the gains set by omap_abe_reload_fw.
+ */
+static void omap_abe_save_fw_image(struct omap_abe *abe, u32 *firmware)
+{
+	u32 *fw_ptr = firmware + 1;
+	u32 *ptr;
+	size_t total;
+	int bank;
+
+	abe->fw_image_size[OMAP_ABE_PMEM] = *fw_ptr++;
+	abe->fw_image_size[OMAP_ABE_CMEM] = *fw_ptr++;
+	abe->fw_image_size[OMAP_ABE_DMEM] = *fw_ptr++;
+	abe->fw_image_size[OMAP_ABE_SMEM] = *fw_ptr++;
+
+	for (total = 0, bank = 0; bank < OMAP_ABE_AESS; bank++)
+		total += abe->fw_image_size[bank];
+
+	abe->fw_image = vmalloc(total);
+	if (abe->fw_image == NULL)
+		return;
+
+	for (ptr = abe->fw_image, bank = 0; bank < OMAP_ABE_AESS; bank++) {
+		omap_abe_mem_read(abe, bank, 0, ptr, abe->fw_image_size[bank]);
+		ptr += abe->fw_image_size[bank] >> 2;
+	}
+
+	abe->fw_image_src = firmware;
+}
+
+/**
+ * omap_abe_free_fw_image - Drop the memories saved at reload
+ * @abe: Pointer on abe handle
+ */
+void omap_abe_free_fw_image(struct omap_abe *abe)
+{
+	vfree(abe->fw_image);
+	abe->fw_image = NULL;
+	abe->fw_image_src = NULL;
+}
+
+/**
+ * omap_abe_restore_fw_image - Put back the memories saved at reload
+ * @abe: Pointer on abe handle
+ * @firmware: firmware being reloaded
+ *
+ * Returns 0 if the memories were restored, an error if the copy is
+ * missing or was taken from another firmware.
+ */
+static int omap_abe_restore_fw_image(struct omap_abe *abe, u32 *firmware)
+{
+	u32 *fw_ptr = firmware + 1;
+	u32 *ptr;
+	int bank;
+
+	if (abe->fw_image == NULL)
+		return -ENOENT;
+
+	if (abe->fw_image_src != firmware ||
+	    abe->fw_image_size[OMAP_ABE_PMEM] != fw_ptr[0] ||
+	    abe->fw_image_size[OMAP_ABE_CMEM] != fw_ptr[1] ||
+	    abe->fw_image_size[OMAP_ABE_DMEM] != fw_ptr[2] ||
+	    abe->fw_image_size[OMAP_ABE_SMEM] != fw_ptr[3]) {
+		omap_abe_free_fw_image(abe);
+		return -EINVAL;
+	}
+
+	for (ptr = abe->fw_image, bank = 0; bank < OMAP_ABE_AESS; bank++) {
+		omap_abe_mem_write(abe, bank, 0, ptr, abe->fw_image_size[bank]);
+		ptr += abe->fw_image_size[bank] >> 2;
+	}
+
+	return 0;
+}
+
 /**
  * abe_reload_fw - Reload ABE Firmware after OFF mode
  */
 int omap_abe_reload_fw(struct omap_abe *abe, u32 *firmware)
 {
+	if (omap_abe_restore_fw_image(abe, firmware) == 0) {
+		abe->warm_boot = 1;
+		omap_abe_dbg_reset(&abe->dbg);
+		abe->irq_dbg_read_ptr = 0;
+		return 0;
+	}
+
 	abe->warm_boot = 0;
 	abe_load_fw_param(firmware);
 	omap_abe_build_scheduler_table(abe);
@@ -226,6 +314,8 @@ int omap_abe_reload_fw(struct omap_abe *abe, u32 *firmware)
 	omap_abe_write_gain(abe, GAINS_SPLIT, GAIN_0dB,
 			    RAMP_2MS, GAIN_RIGHT_OFFSET);
 
+	omap_abe_save_fw_image(abe, firmware);
+
 	return 0;
 }
 EXPORT_SYMBOL(omap_abe_reload_fw);
@@ -99,6 +99,7 @@ int omap_abe_connect_debug_trace(struct omap_abe *abe,
 int omap_abe_reset_hal(struct omap_abe *abe);
 int omap_abe_load_fw(struct omap_abe *abe, u32 *firmware);
 int omap_abe_reload_fw(struct omap_abe *abe, u32 *firmware);
+void omap_abe_free_fw_image(struct omap_abe *abe);
 u32* omap_abe_get_default_fw(struct omap_abe *abe);
 int omap_abe_wakeup(struct omap_abe *abe);
 int omap_abe_irq_processing(struct omap_abe *abe);
@@ -234,6 +235,16 @@ u32 abe_reload_fw(u32 *firmware)
 }
 EXPORT_SYMBOL(abe_reload_fw);
 
+/**
+ * abe_free_fw_image - Free the memory image kept by abe_reload_fw
+ *
+ */
+void abe_free_fw_image(void)
+{
+	omap_abe_free_fw_image(abe);
+}
+EXPORT_SYMBOL(abe_free_fw_image);
+
 u32* abe_get_default_fw(void)
 {
 	return omap_abe_get_default_fw(abe);
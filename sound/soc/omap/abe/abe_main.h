@@ -620,6 +620,7 @@ void abe_init_mem(void __iomem **_io_base);
 u32 abe_reset_hal(void);
 int abe_load_fw(u32 *firmware);
 int abe_reload_fw(u32 *firmware);
+void abe_free_fw_image(void);
 u32 *abe_get_default_fw(void);
 u32 abe_wakeup(void);
 u32 abe_irq_processing(void);
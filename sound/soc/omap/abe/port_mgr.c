@@ -142,6 +142,69 @@ int omap_abe_port_is_enabled(struct abe *abe, struct omap_abe_port *port)
 }
 EXPORT_SYMBOL(omap_abe_port_is_enabled);
 
+/*
+ * omap_abe_port_get_enabled - get the enabled ABE logical ports
+ *
+ * @abe -  ABE.
+ * @rates - if not NULL, filled with the sample rate of each enabled port,
+ *          indexed by logical ID (OMAP_ABE_MAX_PORT_ID + 1 entries).
+ *
+ * Returns a mask of enabled logical port IDs.
+ */
+u32 omap_abe_port_get_enabled(struct abe *abe, unsigned int *rates)
+{
+	struct omap_abe_port *p;
+	unsigned long flags;
+	u32 enabled = 0;
+
+	spin_lock_irqsave(&abe->lock, flags);
+	list_for_each_entry(p, &abe->ports, list) {
+		if (p->state != PORT_ENABLED)
+			continue;
+		enabled |= 1 << p->logical_id;
+		if (rates)
+			rates[p->logical_id] = p->rate;
+	}
+	spin_unlock_irqrestore(&abe->lock, flags);
+	return enabled;
+}
+EXPORT_SYMBOL(omap_abe_port_get_enabled);
+
+/*
+ * omap_abe_port_set_event - set the port start/stop callback
+ *
+ * @abe -  ABE.
+ * @port_event - called after a logical port is enabled or disabled, with
+ *               the ABE lock released but possibly in atomic context.
+ * @data - passed to port_event.
+ */
+void omap_abe_port_set_event(struct abe *abe, void (*port_event)(void *),
+		void *data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&abe->lock, flags);
+	abe->port_event = port_event;
+	abe->port_event_data = data;
+	spin_unlock_irqrestore(&abe->lock, flags);
+}
+EXPORT_SYMBOL(omap_abe_port_set_event);
+
+static void port_notify(struct abe *abe)
+{
+	void (*port_event)(void *);
+	void *data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&abe->lock, flags);
+	port_event = abe->port_event;
+	data = abe->port_event_data;
+	spin_unlock_irqrestore(&abe->lock, flags);
+
+	if (port_event)
+		port_event(data);
+}
+
 /*
  * omap_abe_port_enable - enable ABE logical port
  *
@@ -173,6 +236,8 @@ int omap_abe_port_enable(struct abe *abe, struct omap_abe_port *port)
 	port->state = PORT_ENABLED;
 	port->users++;
 	spin_unlock_irqrestore(&abe->lock, flags);
+
+	port_notify(abe);
 	return ret;
 }
 EXPORT_SYMBOL(omap_abe_port_enable);
@@ -214,6 +279,8 @@ int omap_abe_port_disable(struct abe *abe, struct omap_abe_port *port)
 	port->state = PORT_DISABLED;
 	port->users--;
 	spin_unlock_irqrestore(&abe->lock, flags);
+
+	port_notify(abe);
 	return ret;
 }
 EXPORT_SYMBOL(omap_abe_port_disable);
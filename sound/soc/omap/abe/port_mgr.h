@@ -62,6 +62,9 @@ struct omap_abe_port {
 	/* logical port ref count */
 	int users;
 
+	/* sample rate of the stream last configured on this port, 0 if unset */
+	unsigned int rate;
+
 	struct list_head list;
 	struct abe *abe;
 
@@ -81,6 +84,9 @@ struct abe {
 	/* spinlock */
 	spinlock_t lock;
 
+	/* called, possibly in atomic context, whenever a port starts or stops */
+	void (*port_event)(void *data);
+	void *port_event_data;
 
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *debugfs_root;
@@ -92,6 +98,9 @@ void omap_abe_port_close(struct abe *abe, struct omap_abe_port *port);
 int omap_abe_port_enable(struct abe *abe, struct omap_abe_port *port);
 int omap_abe_port_disable(struct abe *abe, struct omap_abe_port *port);
 int omap_abe_port_is_enabled(struct abe *abe, struct omap_abe_port *port);
+u32 omap_abe_port_get_enabled(struct abe *abe, unsigned int *rates);
+void omap_abe_port_set_event(struct abe *abe, void (*port_event)(void *),
+		void *data);
 struct abe *omap_abe_port_mgr_get(void);
 void omap_abe_port_mgr_put(struct abe *abe);
 
@@ -496,6 +496,18 @@ struct snd_soc_dsp_link fe_lp_media = {
 	.trigger = {
 		SND_SOC_DSP_TRIGGER_BESPOKE, SND_SOC_DSP_TRIGGER_BESPOKE},
 };
+
+struct snd_soc_dsp_link fe_deep_media = {
+	.playback	= true,
+	.trigger = {
+		SND_SOC_DSP_TRIGGER_BESPOKE, SND_SOC_DSP_TRIGGER_BESPOKE},
+};
+
+struct snd_soc_dsp_link fe_ll_media = {
+	.playback	= true,
+	.trigger = {
+		SND_SOC_DSP_TRIGGER_BESPOKE, SND_SOC_DSP_TRIGGER_BESPOKE},
+};
 #endif /*ENABLE_ABE*/
 
 /* Digital audio interface glue - connects codec <--> CPU */
@@ -624,6 +636,28 @@ static struct snd_soc_dai_link motsnd_dai[] = {
 	.be_id = OMAP_ABE_DAI_MM_FM,
 	.ignore_suspend = 1,
 },
+/* last, so the PCM device numbers of the links above don't change */
+{
+	.name = "Multimedia Deep",
+	.stream_name = "Multimedia Deep",
+
+	/* ABE components - MM_DL fed by sDMA from an SDRAM buffer */
+	.cpu_dai_name = "MultiMedia1",
+	.platform_name = "omap-pcm-audio-deep",
+	.dynamic = 1,
+	.dsp_link = &fe_deep_media,
+	.ignore_suspend = 1,
+},
+{
+	.name = "Multimedia LL",
+	.stream_name = "Multimedia LL",
+
+	/* ABE components - MM_DL with 1-2ms periods */
+	.cpu_dai_name = "MultiMedia1",
+	.platform_name = "omap-pcm-audio-ll",
+	.dynamic = 1,
+	.dsp_link = &fe_ll_media,
+},
 #endif
 };
 
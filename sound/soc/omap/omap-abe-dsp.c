@@ -150,6 +150,10 @@ struct abe_data {
 	struct list_head opp_req;
 	int opp_req_count;
 
+	/* port manager, OPP is re-evaluated when its ports start or stop */
+	struct abe *port_mgr;
+	struct work_struct opp_work;
+
 	u16 router[16];
 
 	struct snd_pcm_substream *ping_pong_substream;
@@ -2029,27 +2033,86 @@ err_scale:
 	return ret;
 }
 
+/*
+ * OPP needed by each running ABE logical port, mirroring the levels of
+ * the matching AIF widgets.  PDM_UL1 is started by McPDM along with
+ * PDM_DL1 for every PDM stream, so capture processing is left to the
+ * ROUTE_UL muxes.
+ */
+static const int abe_port_opp[OMAP_ABE_MAX_PORT_ID + 1] = {
+	[OMAP_ABE_BE_PORT_DMIC0]	= 50,
+	[OMAP_ABE_BE_PORT_DMIC1]	= 50,
+	[OMAP_ABE_BE_PORT_DMIC2]	= 50,
+	[OMAP_ABE_BE_PORT_PDM_DL1]	= 25,
+	[OMAP_ABE_BE_PORT_PDM_DL2]	= 100,
+	[OMAP_ABE_BE_PORT_PDM_VIB]	= 100,
+	[OMAP_ABE_BE_PORT_PDM_UL1]	= 25,
+	[OMAP_ABE_BE_PORT_BT_VX_DL]	= 50,
+	[OMAP_ABE_BE_PORT_BT_VX_UL]	= 50,
+	[OMAP_ABE_BE_PORT_MM_EXT_UL]	= 50,
+	[OMAP_ABE_BE_PORT_MM_EXT_DL]	= 25,
+	[OMAP_ABE_FE_PORT_MM_DL1]	= 25,
+	[OMAP_ABE_FE_PORT_MM_UL1]	= 100,
+	[OMAP_ABE_FE_PORT_MM_UL2]	= 50,
+	[OMAP_ABE_FE_PORT_VX_DL]	= 50,
+	[OMAP_ABE_FE_PORT_VX_UL]	= 50,
+	[OMAP_ABE_FE_PORT_VIB]		= 100,
+	[OMAP_ABE_FE_PORT_TONES]	= 25,
+};
+
+static int aess_get_port_opp(struct abe_data *abe)
+{
+	unsigned int rates[OMAP_ABE_MAX_PORT_ID + 1];
+	u32 enabled;
+	int i, opp = 25;
+
+	enabled = omap_abe_port_get_enabled(abe->port_mgr, rates);
+
+	for (i = 0; i <= OMAP_ABE_MAX_PORT_ID; i++) {
+		if (!(enabled & (1 << i)))
+			continue;
+
+		opp = max(opp, abe_port_opp[i]);
+
+		/* 44.1kHz playback goes through the ASRC to the 48kHz engine */
+		if ((i == OMAP_ABE_FE_PORT_MM_DL1 ||
+		     i == OMAP_ABE_FE_PORT_TONES) && rates[i] % 8000)
+			opp = max(opp, 50);
+	}
+
+	return opp;
+}
+
 static int aess_set_runtime_opp_level(struct abe_data *abe)
 {
-	int i, req_opp, opp = 0;
+	int i, req_opp, port_opp, opp = 0;
 
 	mutex_lock(&abe->opp_mutex);
 
-	/* now calculate OPP level based upon DAPM widget status */
+	/*
+	 * Calculate OPP level based upon the DAPM processing widgets.  AIF
+	 * widgets are powered as soon as a path is routed and stay up for
+	 * the pmdown time, the ports actually running are counted instead.
+	 */
 	for (i = 0; i < ABE_NUM_WIDGETS; i++) {
+		if (ABE_WIDGET(i) <= W_AIF_DMIC2)
+			continue;
 		if (abe->widget_opp[ABE_WIDGET(i)]) {
 			dev_dbg(abe->dev, "OPP: id %d = %d%%\n", i,
 					abe->widget_opp[ABE_WIDGET(i)] * 25);
 			opp |= abe->widget_opp[ABE_WIDGET(i)];
 		}
 	}
-	opp = (1 << (fls(opp) - 1)) * 25;
+	opp = opp ? (1 << (fls(opp) - 1)) * 25 : 25;
+
+	port_opp = aess_get_port_opp(abe);
+	dev_dbg(abe->dev, "OPP: ports = %d%%\n", port_opp);
 
 	/* opps requested outside ABE DSP driver (e.g. McPDM) */
 	req_opp = abe_get_opp_req(abe);
 
 	pm_runtime_get_sync(abe->dev);
-	abe_set_opp_mode(abe, max(opp, req_opp));
+	abe_set_opp_mode(abe, max3(opp, port_opp, req_opp));
 	pm_runtime_put_sync(abe->dev);
 
 	mutex_unlock(&abe->opp_mutex);
@@ -2375,6 +2438,24 @@ static struct snd_pcm_ops omap_aess_pcm_ops = {
 	.mmap		= aess_mmap,
 };
 
+static void aess_opp_work(struct work_struct *work)
+{
+	struct abe_data *abe = container_of(work, struct abe_data, opp_work);
+
+	mutex_lock(&abe->mutex);
+	if (abe->active)
+		aess_set_runtime_opp_level(abe);
+	mutex_unlock(&abe->mutex);
+}
+
+/* ports are started and stopped from trigger, scale from process context */
+static void aess_port_event(void *data)
+{
+	struct abe_data *abe = data;
+
+	schedule_work(&abe->opp_work);
+}
+
 static int aess_stream_event(struct snd_soc_dapm_context *dapm)
 {
 	struct snd_soc_platform *platform = dapm->platform;
@@ -2740,6 +2821,8 @@ static int abe_probe(struct snd_soc_platform *platform)
 	pm_runtime_put_sync(abe->dev);
 	abe_add_widgets(platform);
 
+	omap_abe_port_set_event(abe->port_mgr, aess_port_event, abe);
+
 #if defined(CONFIG_SND_OMAP_SOC_ABE_DSP_MODULE)
 	release_firmware(fw);
 #endif
@@ -2768,6 +2851,9 @@ static int abe_remove(struct snd_soc_platform *platform)
 	struct abe_data *abe = snd_soc_platform_get_drvdata(platform);
 	int i;
 
+	omap_abe_port_set_event(abe->port_mgr, NULL, NULL);
+	cancel_work_sync(&abe->opp_work);
+
 	free_irq(abe->irq, (void *)abe);
 
 	for (i = 0; i < abe->hdr.num_equ; i++)
@@ -2775,6 +2861,7 @@ static int abe_remove(struct snd_soc_platform *platform)
 
 	kfree(abe->equ[0]);
 	kfree(abe->equ_texts);
+	abe_free_fw_image();
 	kfree(abe->firmware);
 
 	pm_runtime_disable(abe->dev);
@@ -2838,6 +2925,13 @@ static int __devinit abe_engine_probe(struct platform_device *pdev)
 	mutex_init(&abe->opp_req_mutex);
 	INIT_LIST_HEAD(&abe->opp_req);
 	abe->opp_req_count = 0;
+	INIT_WORK(&abe->opp_work, aess_opp_work);
+
+	abe->port_mgr = omap_abe_port_mgr_get();
+	if (abe->port_mgr == NULL) {
+		ret = -ENOMEM;
+		goto err;
+	}
 
 	ret = snd_soc_register_platform(abe->dev,
 			&omap_aess_platform);
@@ -2861,6 +2955,7 @@ static int __devexit abe_engine_remove(struct platform_device *pdev)
 
 	abe_cleanup_debugfs(abe);
 	snd_soc_unregister_platform(&pdev->dev);
+	omap_abe_port_mgr_put(abe->port_mgr);
 	for (i = 0; i < 5; i++)
 		iounmap(abe->io_base[i]);
 	kfree(abe);
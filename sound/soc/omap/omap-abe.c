@@ -995,6 +995,7 @@ static int omap_abe_dai_hw_params(struct snd_pcm_substream *substream,
 			abe_connect_cbpr_dmareq_port(MM_DL_PORT, &format, ABE_CBPR0_IDX,
 					&dma_sink);
 			abe_read_port_address(MM_DL_PORT, &dma_params);
+			abe_priv->port[OMAP_ABE_FE_PORT_MM_DL1]->rate = format.f;
 		} else {
 			abe_connect_cbpr_dmareq_port(MM_UL_PORT, &format,  ABE_CBPR3_IDX,
 					&dma_sink);
@@ -1029,6 +1030,7 @@ static int omap_abe_dai_hw_params(struct snd_pcm_substream *substream,
 			abe_connect_cbpr_dmareq_port(TONES_DL_PORT, &format, ABE_CBPR5_IDX,
 					&dma_sink);
 			abe_read_port_address(TONES_DL_PORT, &dma_params);
+			abe_priv->port[OMAP_ABE_FE_PORT_TONES]->rate = format.f;
 		} else
 			return -EINVAL;
         break;
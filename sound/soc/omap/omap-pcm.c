@@ -48,11 +48,53 @@ static const struct snd_pcm_hardware omap_pcm_hardware = {
 	.buffer_bytes_max	= 128 * 1024,
 };
 
+/*
+ * Deep buffer variant for non-interactive playback: the buffer lives in
+ * SDRAM and is drained by sDMA, so with periods of up to ~1.3s (48kHz
+ * S16 stereo) the MPU can stay in deep idle between refills.
+ */
+static const struct snd_pcm_hardware omap_pcm_hardware_deep = {
+	.info			= SNDRV_PCM_INFO_MMAP |
+				  SNDRV_PCM_INFO_MMAP_VALID |
+				  SNDRV_PCM_INFO_INTERLEAVED |
+				  SNDRV_PCM_INFO_PAUSE |
+				  SNDRV_PCM_INFO_RESUME |
+				  SNDRV_PCM_INFO_NO_PERIOD_WAKEUP,
+	.formats		= SNDRV_PCM_FMTBIT_S16_LE |
+				  SNDRV_PCM_FMTBIT_S32_LE,
+	.period_bytes_min	= 16 * 1024,
+	.period_bytes_max	= 256 * 1024,
+	.periods_min		= 2,
+	.periods_max		= 32,
+	.buffer_bytes_max	= 512 * 1024,
+};
+
+/*
+ * Low latency variant for interactive playback: 1-2ms periods (48kHz
+ * stereo) and a buffer of a few periods, refilled by a high priority
+ * DMA channel.
+ */
+static const struct snd_pcm_hardware omap_pcm_hardware_ll = {
+	.info			= SNDRV_PCM_INFO_MMAP |
+				  SNDRV_PCM_INFO_MMAP_VALID |
+				  SNDRV_PCM_INFO_INTERLEAVED |
+				  SNDRV_PCM_INFO_PAUSE |
+				  SNDRV_PCM_INFO_RESUME,
+	.formats		= SNDRV_PCM_FMTBIT_S16_LE |
+				  SNDRV_PCM_FMTBIT_S32_LE,
+	.period_bytes_min	= 192,
+	.period_bytes_max	= 768,
+	.periods_min		= 2,
+	.periods_max		= 8,
+	.buffer_bytes_max	= 8 * 768,
+};
+
 struct omap_runtime_data {
 	spinlock_t			lock;
 	struct omap_pcm_dma_data	*dma_data;
 	int				dma_ch;
 	int				period_index;
+	bool				high_prio;
 };
 
 static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
@@ -162,6 +204,11 @@ static int omap_pcm_prepare(struct snd_pcm_substream *substream)
 		return 0;
 
 	memset(&dma_params, 0, sizeof(dma_params));
+	if (prtd->high_prio) {
+		/* don't let other channels' bursts delay the refill */
+		dma_params.read_prio		= DMA_CH_PRIO_HIGH;
+		dma_params.write_prio		= DMA_CH_PRIO_HIGH;
+	}
 	dma_params.data_type			= dma_data->data_type;
 	dma_params.trigger			= dma_data->dma_req;
 	dma_params.sync_mode			= dma_data->sync_mode;
@@ -283,10 +330,17 @@ static snd_pcm_uframes_t omap_pcm_pointer(struct snd_pcm_substream *substream)
 static int omap_pcm_open(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	const struct snd_pcm_hardware *hw =
+			snd_soc_platform_get_drvdata(rtd->platform);
 	struct omap_runtime_data *prtd;
 	int ret;
 
-	snd_soc_set_runtime_hwparams(substream, &omap_pcm_hardware);
+	/* the deep buffer and low latency variants are for playback only */
+	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+		hw = &omap_pcm_hardware;
+
+	snd_soc_set_runtime_hwparams(substream, hw);
 
 	/* Ensure that buffer size is a multiple of period size */
 	ret = snd_pcm_hw_constraint_integer(runtime,
@@ -309,6 +363,7 @@ static int omap_pcm_open(struct snd_pcm_substream *substream)
 		goto out;
 	}
 	spin_lock_init(&prtd->lock);
+	prtd->high_prio = hw == &omap_pcm_hardware_ll;
 	runtime->private_data = prtd;
 
 out:
@@ -349,11 +404,10 @@ static struct snd_pcm_ops omap_pcm_ops = {
 static u64 omap_pcm_dmamask = DMA_BIT_MASK(64);
 
 static int omap_pcm_preallocate_dma_buffer(struct snd_pcm *pcm,
-	int stream)
+	int stream, size_t size)
 {
 	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
-	size_t size = omap_pcm_hardware.buffer_bytes_max;
 
 	buf->dev.type = SNDRV_DMA_TYPE_DEV;
 	buf->dev.dev = pcm->card->dev;
@@ -392,6 +446,8 @@ static int omap_pcm_new(struct snd_soc_pcm_runtime *rtd)
 {
 	struct snd_card *card = rtd->card->snd_card;
 	struct snd_pcm *pcm = rtd->pcm;
+	const struct snd_pcm_hardware *hw =
+			snd_soc_platform_get_drvdata(rtd->platform);
 	int ret = 0;
 
 	if (!card->dev->dma_mask)
@@ -401,14 +457,15 @@ static int omap_pcm_new(struct snd_soc_pcm_runtime *rtd)
 
 	if (pcm->streams[SNDRV_PCM_STREAM_PLAYBACK].substream) {
 		ret = omap_pcm_preallocate_dma_buffer(pcm,
-			SNDRV_PCM_STREAM_PLAYBACK);
+			SNDRV_PCM_STREAM_PLAYBACK, hw->buffer_bytes_max);
 		if (ret)
 			goto out;
 	}
 
 	if (pcm->streams[SNDRV_PCM_STREAM_CAPTURE].substream) {
 		ret = omap_pcm_preallocate_dma_buffer(pcm,
-			SNDRV_PCM_STREAM_CAPTURE);
+			SNDRV_PCM_STREAM_CAPTURE,
+			omap_pcm_hardware.buffer_bytes_max);
 		if (ret)
 			goto out;
 	}
@@ -425,6 +482,9 @@ static struct snd_soc_platform_driver omap_soc_platform = {
 
 static __devinit int omap_pcm_probe(struct platform_device *pdev)
 {
+	const struct platform_device_id *id = platform_get_device_id(pdev);
+
+	platform_set_drvdata(pdev, (void *)id->driver_data);
 	return snd_soc_register_platform(&pdev->dev,
 			&omap_soc_platform);
 }
@@ -435,12 +495,21 @@ static int __devexit omap_pcm_remove(struct platform_device *pdev)
 	return 0;
 }
 
+static const struct platform_device_id omap_pcm_ids[] = {
+	{ "omap-pcm-audio", (kernel_ulong_t)&omap_pcm_hardware },
+	{ "omap-pcm-audio-deep", (kernel_ulong_t)&omap_pcm_hardware_deep },
+	{ "omap-pcm-audio-ll", (kernel_ulong_t)&omap_pcm_hardware_ll },
+	{ },
+};
+MODULE_DEVICE_TABLE(platform, omap_pcm_ids);
+
 static struct platform_driver omap_pcm_driver = {
 	.driver = {
 			.name = "omap-pcm-audio",
 			.owner = THIS_MODULE,
 	},
 
+	.id_table = omap_pcm_ids,
 	.probe = omap_pcm_probe,
 	.remove = __devexit_p(omap_pcm_remove),
 };
@@ -0,0 +1,265 @@
+/*
+ * android-bench.c -- load generator for the Android kernel interfaces
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Runs binder, logger, ION and ashmem workloads and prints one CSV line
+ * per operation, payload size and thread count:
+ *
+ *   bench,op,size,threads,count,min_ns,median_ns,p99_ns,max_ns,ops_per_s,mb_per_s
+ *
+ * The latencies are per operation, the rates are over the wall time of
+ * the whole run, all threads together.  Lines starting with '#' are
+ * comments: the kernel the numbers were taken on and per bench notes.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "android-bench.h"
+
+static const struct {
+	const char *name;
+	int (*run)(const struct bench_opts *o);
+} benches[] = {
+	{ "binder", bench_binder },
+	{ "logger", bench_logger },
+	{ "ion", bench_ion },
+	{ "ashmem", bench_ashmem },
+};
+
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void samples_init(struct samples *s, unsigned int max)
+{
+	s->n = 0;
+	s->max = max;
+	s->ns = malloc(max * sizeof(*s->ns));
+	if (!s->ns) {
+		perror("malloc");
+		exit(1);
+	}
+}
+
+void samples_add(struct samples *s, uint64_t ns)
+{
+	if (s->n < s->max)
+		s->ns[s->n++] = ns;
+}
+
+void samples_merge(struct samples *dst, const struct samples *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < src->n; i++)
+		samples_add(dst, src->ns[i]);
+}
+
+void samples_free(struct samples *s)
+{
+	free(s->ns);
+	s->ns = NULL;
+	s->n = s->max = 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+void report(const char *bench, const char *op, size_t size,
+	    unsigned int threads, struct samples *s, uint64_t wall_ns,
+	    uint64_t bytes)
+{
+	unsigned int n = s->n, p99;
+	double secs = wall_ns ? wall_ns / 1e9 : 1e-9;
+
+	if (!n) {
+		printf("%s,%s,%zu,%u,0,,,,,,\n", bench, op, size, threads);
+		return;
+	}
+
+	qsort(s->ns, n, sizeof(*s->ns), cmp_u64);
+	p99 = n * 99 / 100;
+	if (p99 >= n)
+		p99 = n - 1;
+
+	printf("%s,%s,%zu,%u,%u,%llu,%llu,%llu,%llu,%.0f,%.2f\n",
+	       bench, op, size, threads, n,
+	       (unsigned long long)s->ns[0],
+	       (unsigned long long)s->ns[n / 2],
+	       (unsigned long long)s->ns[p99],
+	       (unsigned long long)s->ns[n - 1],
+	       n / secs, bytes / secs / (1024 * 1024));
+	fflush(stdout);
+}
+
+void warn_errno(const char *fmt, ...)
+{
+	int err = errno;
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, ": %s\n", strerror(err));
+}
+
+int bench_sizes(const struct bench_opts *o, const size_t *defaults,
+		int ndefaults, const size_t **sizes)
+{
+	if (o->nsizes) {
+		*sizes = o->sizes;
+		return o->nsizes;
+	}
+
+	*sizes = defaults;
+	return ndefaults;
+}
+
+/* comma separated numbers, sizes may have a k or m suffix */
+static int parse_list(const char *arg, unsigned long *list, int allow_zero)
+{
+	char *end;
+	int n = 0;
+
+	do {
+		unsigned long v = strtoul(arg, &end, 0);
+
+		if (end == arg || (!v && !allow_zero) || n == MAX_LIST)
+			return -1;
+		if (*end == 'k' || *end == 'K')
+			v <<= 10, end++;
+		else if (*end == 'm' || *end == 'M')
+			v <<= 20, end++;
+
+		list[n++] = v;
+		arg = end + 1;
+	} while (*end == ',');
+
+	return *end ? -1 : n;
+}
+
+static void usage(const char *prog)
+{
+	int i;
+
+	fprintf(stderr,
+		"usage: %s [options] [bench...]\n"
+		"  -n iterations  operations per thread and run (10000)\n"
+		"  -t list        thread counts, comma separated (1,2,4)\n"
+		"  -s list        payload sizes, k and m suffixes allowed\n"
+		"  -m mb          ashmem memory pressure, 0 for none\n"
+		"                 (half of MemTotal)\n"
+		"  -l path        logger device (/dev/log/main)\n"
+		"benches:", prog);
+	for (i = 0; i < ARRAY_SIZE(benches); i++)
+		fprintf(stderr, " %s", benches[i].name);
+	fprintf(stderr, " (all of them)\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_opts o = {
+		.iterations = 10000,
+		.threads = { 1, 2, 4 },
+		.nthreads = 3,
+		.pressure_mb = -1,
+		.log_path = "/dev/log/main",
+	};
+	unsigned long list[MAX_LIST];
+	struct utsname uts;
+	int i, j, opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "n:t:s:m:l:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			o.iterations = strtoul(optarg, NULL, 0);
+			if (!o.iterations)
+				usage(argv[0]);
+			break;
+		case 't':
+			o.nthreads = parse_list(optarg, list, 0);
+			if (o.nthreads < 0)
+				usage(argv[0]);
+			for (i = 0; i < o.nthreads; i++)
+				o.threads[i] = list[i];
+			break;
+		case 's':
+			o.nsizes = parse_list(optarg, list, 1);
+			if (o.nsizes < 0)
+				usage(argv[0]);
+			for (i = 0; i < o.nsizes; i++)
+				o.sizes[i] = list[i];
+			break;
+		case 'm':
+			o.pressure_mb = strtol(optarg, NULL, 0);
+			break;
+		case 'l':
+			o.log_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	for (j = optind; j < argc; j++) {
+		for (i = 0; i < ARRAY_SIZE(benches); i++)
+			if (!strcmp(argv[j], benches[i].name))
+				break;
+		if (i == ARRAY_SIZE(benches))
+			usage(argv[0]);
+	}
+
+	if (!uname(&uts))
+		printf("# kernel %s %s %s\n", uts.release, uts.version,
+		       uts.machine);
+	printf("bench,op,size,threads,count,min_ns,median_ns,p99_ns,max_ns,"
+	       "ops_per_s,mb_per_s\n");
+	fflush(stdout);
+
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		int selected = optind == argc;
+
+		for (j = optind; j < argc; j++)
+			if (!strcmp(argv[j], benches[i].name))
+				selected = 1;
+		if (!selected)
+			continue;
+
+		switch (benches[i].run(&o)) {
+		case 0:
+			break;
+		case 1:
+			printf("# %s: skipped, not supported\n",
+			       benches[i].name);
+			break;
+		default:
+			printf("# %s: failed\n", benches[i].name);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,63 @@
+/*
+ * android-bench.h -- load generator for the Android kernel interfaces
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef ANDROID_BENCH_H
+#define ANDROID_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define MAX_LIST	16
+
+struct bench_opts {
+	unsigned int iterations;	/* per thread */
+	unsigned int threads[MAX_LIST];
+	int nthreads;
+	size_t sizes[MAX_LIST];		/* none given: each bench's own */
+	int nsizes;
+	long pressure_mb;		/* -1: half of MemTotal */
+	const char *log_path;
+};
+
+/* per operation latencies of one run */
+struct samples {
+	uint64_t *ns;
+	unsigned int n, max;
+};
+
+uint64_t now_ns(void);
+
+void samples_init(struct samples *s, unsigned int max);
+void samples_add(struct samples *s, uint64_t ns);
+void samples_merge(struct samples *dst, const struct samples *src);
+void samples_free(struct samples *s);
+
+/* one CSV line, see android-bench.c for the columns; sorts @s */
+void report(const char *bench, const char *op, size_t size,
+	    unsigned int threads, struct samples *s, uint64_t wall_ns,
+	    uint64_t bytes);
+
+void warn_errno(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+
+/*
+ * The sizes to sweep: the ones given with -s, else @defaults.
+ */
+int bench_sizes(const struct bench_opts *o, const size_t *defaults,
+		int ndefaults, const size_t **sizes);
+
+/* each returns 0, 1 if the interface is missing, or -1 on failure */
+int bench_binder(const struct bench_opts *o);
+int bench_logger(const struct bench_opts *o);
+int bench_ion(const struct bench_opts *o);
+int bench_ashmem(const struct bench_opts *o);
+
+#endif /* ANDROID_BENCH_H */
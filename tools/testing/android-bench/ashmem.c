@@ -0,0 +1,226 @@
+/*
+ * ashmem.c -- ashmem pin and unpin latency under memory pressure
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Keeps half of a set of mapped ashmem regions unpinned at any time, like
+ * a cache of decoded images: every iteration unpins one region and pins
+ * the one unpinned longest ago.  Meanwhile a child process cycles through
+ * -m megabytes of anonymous memory so that reclaim runs and the ashmem
+ * shrinker purges unpinned regions.  Regions found purged when pinned are
+ * counted and faulted back in, outside of the timed part.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <linux/types.h>
+#include "../../../include/linux/ashmem.h"
+#include "android-bench.h"
+
+#define ASHMEM_DEV	"/dev/ashmem"
+#define NR_REGIONS	32
+
+struct region {
+	int fd;
+	char *map;
+};
+
+static const size_t default_sizes[] = { 4096, 65536, 1024 * 1024 };
+
+static long default_pressure_mb(void)
+{
+	char line[128];
+	long kb = 0;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "MemTotal: %ld kB", &kb) == 1)
+			break;
+	fclose(f);
+
+	return kb / 1024 / 2;
+}
+
+/* never returns: touches @mb of memory, gives it back, again */
+static void pressure_loop(long mb)
+{
+	size_t len = (size_t)mb << 20, off;
+	char *p;
+
+	for (;;) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			sleep(1);
+			continue;
+		}
+		for (off = 0; off < len; off += 4096)
+			p[off] = 1;
+		munmap(p, len);
+	}
+}
+
+static void touch(char *p, size_t len)
+{
+	size_t off;
+
+	for (off = 0; off < len; off += 4096)
+		p[off] = 1;
+}
+
+static int region_create(struct region *r, size_t size)
+{
+	r->fd = open(ASHMEM_DEV, O_RDWR);
+	if (r->fd < 0)
+		return -1;
+
+	if (ioctl(r->fd, ASHMEM_SET_NAME, "android-bench") < 0 ||
+	    ioctl(r->fd, ASHMEM_SET_SIZE, size) < 0)
+		goto err;
+
+	r->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		      r->fd, 0);
+	if (r->map == MAP_FAILED)
+		goto err;
+
+	touch(r->map, size);
+	return 0;
+
+err:
+	close(r->fd);
+	return -1;
+}
+
+static int region_ioctl(struct region *r, int cmd, size_t size)
+{
+	struct ashmem_pin pin = { .offset = 0, .len = size };
+
+	return ioctl(r->fd, cmd, &pin);
+}
+
+static int run_size(const struct bench_opts *o, size_t size, long mb)
+{
+	struct region regions[NR_REGIONS];
+	struct samples pin, unpin;
+	unsigned int i, purged = 0;
+	uint64_t start, t, wall;
+	pid_t pressure = 0;
+	int n, ret = 0;
+
+	size = (size + 4095) & ~(size_t)4095;
+	if (!size)
+		size = 4096;
+
+	for (n = 0; n < NR_REGIONS; n++) {
+		if (region_create(&regions[n], size) < 0) {
+			warn_errno("ashmem: create %zu bytes", size);
+			ret = -1;
+			goto out;
+		}
+	}
+
+	/* the oldest half starts out unpinned */
+	for (i = 0; i < NR_REGIONS / 2; i++)
+		region_ioctl(&regions[i], ASHMEM_UNPIN, size);
+
+	if (mb > 0) {
+		pressure = fork();
+		if (!pressure)
+			pressure_loop(mb);
+	}
+
+	samples_init(&pin, o->iterations);
+	samples_init(&unpin, o->iterations);
+
+	start = now_ns();
+	for (i = 0; i < o->iterations; i++) {
+		struct region *old = &regions[i % NR_REGIONS];
+		struct region *new = &regions[(i + NR_REGIONS / 2) %
+					      NR_REGIONS];
+		int r;
+
+		t = now_ns();
+		r = region_ioctl(new, ASHMEM_UNPIN, size);
+		samples_add(&unpin, now_ns() - t);
+		if (r < 0)
+			break;
+
+		t = now_ns();
+		r = region_ioctl(old, ASHMEM_PIN, size);
+		samples_add(&pin, now_ns() - t);
+		if (r < 0)
+			break;
+
+		if (r == ASHMEM_WAS_PURGED) {
+			purged++;
+			touch(old->map, size);
+		}
+	}
+	wall = now_ns() - start;
+
+	if (i < o->iterations) {
+		warn_errno("ashmem: pin/unpin");
+		ret = -1;
+	}
+
+	if (pressure > 0) {
+		kill(pressure, SIGKILL);
+		waitpid(pressure, NULL, 0);
+	}
+
+	printf("# ashmem: %zu bytes, %ld MB pressure: %u of %u pins purged\n",
+	       size, mb, purged, pin.n);
+	report("ashmem", "unpin", size, 1, &unpin, wall,
+	       (uint64_t)unpin.n * size);
+	report("ashmem", "pin", size, 1, &pin, wall, (uint64_t)pin.n * size);
+
+	samples_free(&pin);
+	samples_free(&unpin);
+out:
+	while (n-- > 0) {
+		munmap(regions[n].map, size);
+		close(regions[n].fd);
+	}
+	return ret;
+}
+
+int bench_ashmem(const struct bench_opts *o)
+{
+	const size_t *sizes;
+	long mb = o->pressure_mb;
+	int nsizes, j;
+
+	if (access(ASHMEM_DEV, R_OK | W_OK))
+		return 1;
+
+	if (mb < 0)
+		mb = default_pressure_mb();
+
+	nsizes = bench_sizes(o, default_sizes, ARRAY_SIZE(default_sizes),
+			     &sizes);
+
+	for (j = 0; j < nsizes; j++)
+		if (run_size(o, sizes[j], mb))
+			return -1;
+
+	return 0;
+}
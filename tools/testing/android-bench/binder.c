@@ -0,0 +1,544 @@
+/*
+ * binder.c -- binder transaction latency and throughput
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * A forked server process answers every transaction with an empty reply
+ * from as many looper threads as the largest thread count asked for.
+ * The clients are threads of the main process, each doing synchronous
+ * transactions of the payload size back to back, so size 0 with one
+ * thread is the ping-pong latency.
+ *
+ * The server makes itself the context manager when it can.  When the
+ * servicemanager already is, the server registers with it and the
+ * clients look it up, which needs root.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../../../drivers/staging/android/binder.h"
+#include "android-bench.h"
+
+#define BINDER_DEV		"/dev/binder"
+#define BINDER_MAP_SIZE		(1024 * 1024 - 2 * 4096)	/* as libbinder */
+
+#define PING_TRANSACTION	1
+#define SVC_MGR_CHECK_SERVICE	2
+#define SVC_MGR_ADD_SERVICE	3
+#define SVC_MGR_NAME		"android.os.IServiceManager"
+
+struct binder_state {
+	int fd;
+	void *map;
+};
+
+/* per thread: commands to write with the next BINDER_WRITE_READ */
+struct binder_io {
+	struct binder_state *bs;
+	uint8_t out[256];
+	size_t out_len;
+	uint8_t in[256];
+};
+
+struct client_arg {
+	struct binder_state *bs;
+	uint32_t handle;
+	size_t size;
+	unsigned int iterations;
+	struct samples samples;
+	int err;
+};
+
+static const size_t default_sizes[] = { 0, 256, 4096, 65536 };
+
+static int binder_open(struct binder_state *bs)
+{
+	struct binder_version vers;
+
+	bs->fd = open(BINDER_DEV, O_RDWR);
+	if (bs->fd < 0)
+		return -1;
+
+	if (ioctl(bs->fd, BINDER_VERSION, &vers) < 0 ||
+	    vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder: protocol version mismatch\n");
+		close(bs->fd);
+		errno = EPROTO;
+		return -1;
+	}
+
+	bs->map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE,
+		       bs->fd, 0);
+	if (bs->map == MAP_FAILED) {
+		close(bs->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void binder_close(struct binder_state *bs)
+{
+	munmap(bs->map, BINDER_MAP_SIZE);
+	close(bs->fd);
+}
+
+static void io_put(struct binder_io *io, const void *data, size_t len)
+{
+	if (io->out_len + len > sizeof(io->out)) {
+		fprintf(stderr, "binder: command buffer overflow\n");
+		abort();
+	}
+	memcpy(io->out + io->out_len, data, len);
+	io->out_len += len;
+}
+
+static void io_put_cmd(struct binder_io *io, uint32_t cmd, const void *arg)
+{
+	io_put(io, &cmd, sizeof(cmd));
+	if (arg)
+		io_put(io, arg, _IOC_SIZE(cmd));
+}
+
+static void io_put_free(struct binder_io *io, const void *buffer)
+{
+	uint32_t cmd = BC_FREE_BUFFER;
+
+	io_put(io, &cmd, sizeof(cmd));
+	io_put(io, &buffer, sizeof(buffer));
+}
+
+/*
+ * Writes the pending commands, then, if @read, waits for what the driver
+ * has for this thread.  Returns the number of bytes read into io->in.
+ */
+static ssize_t io_write_read(struct binder_io *io, int read)
+{
+	struct binder_write_read bwr = {
+		.write_size = io->out_len,
+		.write_buffer = (unsigned long)io->out,
+		.read_size = read ? sizeof(io->in) : 0,
+		.read_buffer = (unsigned long)io->in,
+	};
+
+	while (ioctl(io->bs->fd, BINDER_WRITE_READ, &bwr) < 0) {
+		if (errno != EINTR)
+			return -1;
+		/* whatever was consumed must not be written again */
+		bwr.write_buffer += bwr.write_consumed;
+		bwr.write_size -= bwr.write_consumed;
+		bwr.write_consumed = 0;
+	}
+
+	io->out_len = 0;
+	return bwr.read_consumed;
+}
+
+/*
+ * Walks the returned commands, acknowledging reference requests on our
+ * nodes.  Stops at the first transaction or reply, which is copied to
+ * @tr, and returns its command; 0 if there was none.
+ */
+static int io_parse(struct binder_io *io, size_t len, size_t *pos,
+		    struct binder_transaction_data *tr)
+{
+	while (*pos + sizeof(uint32_t) <= len) {
+		uint32_t cmd;
+		uint8_t *arg;
+
+		memcpy(&cmd, io->in + *pos, sizeof(cmd));
+		arg = io->in + *pos + sizeof(cmd);
+		*pos += sizeof(cmd) + _IOC_SIZE(cmd);
+
+		switch (cmd) {
+		case BR_INCREFS:
+			io_put_cmd(io, BC_INCREFS_DONE, arg);
+			break;
+		case BR_ACQUIRE:
+			io_put_cmd(io, BC_ACQUIRE_DONE, arg);
+			break;
+		case BR_TRANSACTION:
+		case BR_REPLY:
+			memcpy(tr, arg, sizeof(*tr));
+			return cmd;
+		case BR_DEAD_REPLY:
+		case BR_FAILED_REPLY:
+		case BR_ERROR:
+			return -1;
+		default:
+			/* BR_NOOP, BR_TRANSACTION_COMPLETE, ... */
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * A synchronous transaction.  The reply buffer is left in @reply for the
+ * caller to free with io_put_free(), which then goes out with the next
+ * transaction as libbinder does.
+ */
+static int binder_call(struct binder_io *io, uint32_t handle, uint32_t code,
+		       const void *data, size_t size, const size_t *offsets,
+		       size_t noffsets, struct binder_transaction_data *reply)
+{
+	struct binder_transaction_data tr = {
+		.target.handle = handle,
+		.code = code,
+		.flags = TF_ACCEPT_FDS,
+		.data_size = size,
+		.offsets_size = noffsets * sizeof(size_t),
+		.data.ptr.buffer = data,
+		.data.ptr.offsets = offsets,
+	};
+
+	io_put_cmd(io, BC_TRANSACTION, &tr);
+
+	for (;;) {
+		ssize_t len = io_write_read(io, 1);
+		size_t pos = 0;
+		int cmd;
+
+		if (len < 0)
+			return -1;
+
+		while ((cmd = io_parse(io, len, &pos, reply)) != 0) {
+			if (cmd == BR_REPLY && !(reply->flags & TF_STATUS_CODE))
+				return 0;
+			if (cmd == BR_REPLY) {
+				io_put_free(io, reply->data.ptr.buffer);
+				errno = EREMOTEIO;
+				return -1;
+			}
+			if (cmd < 0) {
+				errno = EPIPE;
+				return -1;
+			}
+			/* nobody should be calling a client thread */
+			io_put_free(io, reply->data.ptr.buffer);
+		}
+	}
+}
+
+/* a String16 as Parcel::writeString16() lays it out */
+static size_t put_string16(uint8_t *p, const char *s)
+{
+	int32_t len = strlen(s);
+	uint16_t *d = (uint16_t *)(p + sizeof(len));
+	int i;
+
+	memcpy(p, &len, sizeof(len));
+	for (i = 0; i <= len; i++)
+		d[i] = (unsigned char)s[i];
+
+	return sizeof(len) + (((len + 1) * 2 + 3) & ~3);
+}
+
+static size_t put_svcmgr_header(uint8_t *p, const char *name)
+{
+	int32_t strict_policy = 0;
+	size_t len = sizeof(strict_policy);
+
+	memcpy(p, &strict_policy, sizeof(strict_policy));
+	len += put_string16(p + len, SVC_MGR_NAME);
+	len += put_string16(p + len, name);
+
+	return len;
+}
+
+static int svcmgr_add(struct binder_io *io, const char *name, void *node)
+{
+	struct binder_transaction_data reply;
+	struct flat_binder_object obj = {
+		.type = BINDER_TYPE_BINDER,
+		.flags = 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS,
+		.binder = node,
+	};
+	uint32_t data[128];
+	size_t len, offset;
+	int32_t status;
+
+	len = put_svcmgr_header((uint8_t *)data, name);
+	offset = len;
+	memcpy((uint8_t *)data + len, &obj, sizeof(obj));
+	len += sizeof(obj);
+
+	if (binder_call(io, 0, SVC_MGR_ADD_SERVICE, data, len, &offset, 1,
+			&reply) < 0)
+		return -1;
+
+	status = reply.data_size >= sizeof(status) ?
+		*(const int32_t *)reply.data.ptr.buffer : -1;
+	io_put_free(io, reply.data.ptr.buffer);
+
+	if (status) {
+		errno = EPERM;
+		return -1;
+	}
+	return 0;
+}
+
+static int svcmgr_check(struct binder_io *io, const char *name,
+			uint32_t *handle)
+{
+	struct binder_transaction_data reply;
+	const struct flat_binder_object *obj;
+	uint32_t data[64];
+	size_t len;
+	int ret = -1;
+
+	len = put_svcmgr_header((uint8_t *)data, name);
+	if (binder_call(io, 0, SVC_MGR_CHECK_SERVICE, data, len, NULL, 0,
+			&reply) < 0)
+		return -1;
+
+	obj = reply.data.ptr.buffer;
+	if (reply.data_size >= sizeof(*obj) &&
+	    obj->type == BINDER_TYPE_HANDLE) {
+		*handle = obj->handle;
+		/* the reference dies with the reply buffer otherwise */
+		io_put_cmd(io, BC_ACQUIRE, handle);
+		ret = 0;
+	} else {
+		errno = ENOENT;
+	}
+	io_put_free(io, reply.data.ptr.buffer);
+
+	return ret;
+}
+
+static void *server_loop(void *arg)
+{
+	struct binder_io io = { .bs = arg };
+	struct binder_transaction_data tr, reply = { .flags = 0 };
+
+	io_put_cmd(&io, BC_ENTER_LOOPER, NULL);
+
+	for (;;) {
+		ssize_t len = io_write_read(&io, 1);
+		size_t pos = 0;
+		int cmd;
+
+		if (len < 0)
+			break;
+
+		while ((cmd = io_parse(&io, len, &pos, &tr)) != 0) {
+			if (cmd != BR_TRANSACTION)
+				continue;
+			io_put_free(&io, tr.data.ptr.buffer);
+			if (!(tr.flags & TF_ONE_WAY))
+				io_put_cmd(&io, BC_REPLY, &reply);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Child process: registers, reports how through @ready, then serves
+ * until killed.
+ */
+static void server_main(int ready, unsigned int threads, const char *name)
+{
+	static int node;
+	struct binder_state bs;
+	struct binder_io io = { .bs = &bs };
+	size_t max_threads = 0;
+	pthread_t tid;
+	char mode;
+	unsigned int i;
+
+	if (binder_open(&bs) < 0) {
+		warn_errno("binder: open server");
+		exit(1);
+	}
+	ioctl(bs.fd, BINDER_SET_MAX_THREADS, &max_threads);
+
+	if (!ioctl(bs.fd, BINDER_SET_CONTEXT_MGR, 0)) {
+		mode = 'c';
+	} else if (!svcmgr_add(&io, name, &node)) {
+		mode = 's';
+	} else {
+		warn_errno("binder: register %s", name);
+		exit(1);
+	}
+
+	if (write(ready, &mode, 1) != 1)
+		exit(1);
+	close(ready);
+
+	for (i = 1; i < threads; i++)
+		pthread_create(&tid, NULL, server_loop, &bs);
+	/* the acks for the references servicemanager took, the reply buffer */
+	if (io.out_len)
+		io_write_read(&io, 0);
+	server_loop(&bs);
+	exit(0);
+}
+
+static void *client_loop(void *arg)
+{
+	struct client_arg *c = arg;
+	struct binder_io io = { .bs = c->bs };
+	struct binder_transaction_data reply;
+	void *payload;
+	unsigned int i;
+
+	payload = calloc(1, c->size ? c->size : 1);
+	if (!payload) {
+		c->err = ENOMEM;
+		return NULL;
+	}
+
+	for (i = 0; i < c->iterations; i++) {
+		uint64_t start = now_ns();
+
+		if (binder_call(&io, c->handle, PING_TRANSACTION, payload,
+				c->size, NULL, 0, &reply) < 0) {
+			c->err = errno;
+			break;
+		}
+		samples_add(&c->samples, now_ns() - start);
+		io_put_free(&io, reply.data.ptr.buffer);
+	}
+
+	/* the last reply buffer */
+	if (io.out_len)
+		io_write_read(&io, 0);
+
+	free(payload);
+	return NULL;
+}
+
+static int run_clients(const struct bench_opts *o, struct binder_state *bs,
+		       uint32_t handle, size_t size, unsigned int threads)
+{
+	struct client_arg *c;
+	pthread_t *tids;
+	struct samples all;
+	uint64_t start, wall;
+	unsigned int i;
+	int ret = 0;
+
+	c = calloc(threads, sizeof(*c));
+	tids = calloc(threads, sizeof(*tids));
+	if (!c || !tids)
+		return -1;
+
+	samples_init(&all, o->iterations * threads);
+	start = now_ns();
+	for (i = 0; i < threads; i++) {
+		c[i].bs = bs;
+		c[i].handle = handle;
+		c[i].size = size;
+		c[i].iterations = o->iterations;
+		samples_init(&c[i].samples, o->iterations);
+		pthread_create(&tids[i], NULL, client_loop, &c[i]);
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(tids[i], NULL);
+		samples_merge(&all, &c[i].samples);
+		samples_free(&c[i].samples);
+		if (c[i].err) {
+			errno = c[i].err;
+			warn_errno("binder: transaction of %zu bytes", size);
+			ret = -1;
+		}
+	}
+	wall = now_ns() - start;
+
+	report("binder", "transact", size, threads, &all, wall,
+	       (uint64_t)all.n * size);
+
+	samples_free(&all);
+	free(tids);
+	free(c);
+	return ret;
+}
+
+int bench_binder(const struct bench_opts *o)
+{
+	struct binder_state bs;
+	struct binder_io io = { .bs = &bs };
+	const size_t *sizes;
+	unsigned int max_threads = 1;
+	uint32_t handle = 0;
+	int nsizes, pipefd[2];
+	int i, j, ret = 0;
+	char name[32], mode;
+	pid_t server;
+
+	if (access(BINDER_DEV, R_OK | W_OK))
+		return 1;
+
+	nsizes = bench_sizes(o, default_sizes, ARRAY_SIZE(default_sizes),
+			     &sizes);
+	for (i = 0; i < o->nthreads; i++)
+		if (o->threads[i] > max_threads)
+			max_threads = o->threads[i];
+
+	snprintf(name, sizeof(name), "android-bench.%d", getpid());
+	if (pipe(pipefd) < 0)
+		return -1;
+
+	server = fork();
+	if (server < 0)
+		return -1;
+	if (!server) {
+		close(pipefd[0]);
+		server_main(pipefd[1], max_threads, name);
+	}
+	close(pipefd[1]);
+
+	if (read(pipefd[0], &mode, 1) != 1) {
+		fprintf(stderr, "binder: server failed to start\n");
+		ret = -1;
+		goto out_kill;
+	}
+	close(pipefd[0]);
+
+	if (binder_open(&bs) < 0) {
+		warn_errno("binder: open client");
+		ret = -1;
+		goto out_kill;
+	}
+
+	if (mode == 's' && svcmgr_check(&io, name, &handle) < 0) {
+		warn_errno("binder: look up %s", name);
+		ret = -1;
+		goto out_close;
+	}
+	printf("# binder: server is %s\n", mode == 'c' ?
+	       "the context manager" : "registered with servicemanager");
+
+	for (i = 0; i < o->nthreads && !ret; i++)
+		for (j = 0; j < nsizes && !ret; j++)
+			ret = run_clients(o, &bs, handle, sizes[j],
+					  o->threads[i]);
+
+out_close:
+	binder_close(&bs);
+out_kill:
+	kill(server, SIGKILL);
+	waitpid(server, NULL, 0);
+	return ret;
+}
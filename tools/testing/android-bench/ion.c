@@ -0,0 +1,184 @@
+/*
+ * ion.c -- ION allocation, mapping and free latency per heap
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Every iteration allocates a buffer, maps it and touches each page the
+ * way a gralloc client does, then unmaps and frees it; the three steps
+ * are reported separately.  The TILER heap is allocated through the
+ * OMAP custom ioctl, in page mode so the size means the same as for the
+ * other heaps.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#include <linux/types.h>
+typedef __u32 u32;			/* for omap_ion.h */
+
+#include "../../../include/linux/ion.h"
+#include "../../../include/linux/omap_ion.h"
+#include "android-bench.h"
+
+#define ION_DEV		"/dev/ion"
+
+struct ion_heap_desc {
+	const char *name;
+	unsigned int mask;		/* 0: the OMAP TILER ioctl */
+};
+
+static const struct ion_heap_desc heaps[] = {
+	{ "system", 1 << OMAP_ION_HEAP_SYSTEM },
+	{ "secure_input", 1 << OMAP_ION_HEAP_SECURE_INPUT },
+	{ "tiler", 0 },
+};
+
+static const size_t default_sizes[] = { 4096, 65536, 1024 * 1024 };
+
+static int ion_alloc_one(int fd, const struct ion_heap_desc *heap,
+			 size_t size, struct ion_handle **handle)
+{
+	struct omap_ion_tiler_alloc_data tiler = {
+		.w = size,
+		.h = 1,
+		.fmt = TILER_PIXEL_FMT_PAGE,
+	};
+	struct ion_allocation_data alloc = {
+		.len = size,
+		.align = 4096,
+		.flags = heap->mask,
+	};
+	struct ion_custom_data custom = {
+		.cmd = OMAP_ION_TILER_ALLOC,
+		.arg = (unsigned long)&tiler,
+	};
+
+	if (!heap->mask) {
+		if (ioctl(fd, ION_IOC_CUSTOM, &custom) < 0)
+			return -1;
+		*handle = tiler.handle;
+		return 0;
+	}
+
+	if (ioctl(fd, ION_IOC_ALLOC, &alloc) < 0)
+		return -1;
+	*handle = alloc.handle;
+	return 0;
+}
+
+static int ion_map_one(int fd, struct ion_handle *handle, size_t size)
+{
+	struct ion_fd_data data = { .handle = handle };
+	volatile char *p;
+	size_t off;
+
+	if (ioctl(fd, ION_IOC_MAP, &data) < 0)
+		return -1;
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, data.fd, 0);
+	if (p == MAP_FAILED) {
+		close(data.fd);
+		return -1;
+	}
+
+	for (off = 0; off < size; off += 4096)
+		p[off] = 0;
+
+	munmap((void *)p, size);
+	close(data.fd);
+	return 0;
+}
+
+static int run_heap(const struct bench_opts *o, int fd,
+		    const struct ion_heap_desc *heap, size_t size)
+{
+	struct samples alloc, map, release;
+	struct ion_handle_data data;
+	uint64_t start, t, wall;
+	unsigned int i;
+	char op[32];
+	int ret = 0;
+
+	samples_init(&alloc, o->iterations);
+	samples_init(&map, o->iterations);
+	samples_init(&release, o->iterations);
+
+	start = now_ns();
+	for (i = 0; i < o->iterations; i++) {
+		t = now_ns();
+		if (ion_alloc_one(fd, heap, size, &data.handle) < 0) {
+			/* a heap this board does not have, or too small */
+			if (!i)
+				printf("# ion: %s: %zu bytes: %s\n", heap->name,
+				       size, strerror(errno));
+			else
+				ret = -1;
+			break;
+		}
+		samples_add(&alloc, now_ns() - t);
+
+		t = now_ns();
+		if (ion_map_one(fd, data.handle, size) < 0) {
+			warn_errno("ion: map %s", heap->name);
+			ret = -1;
+		}
+		samples_add(&map, now_ns() - t);
+
+		t = now_ns();
+		ioctl(fd, ION_IOC_FREE, &data);
+		samples_add(&release, now_ns() - t);
+
+		if (ret)
+			break;
+	}
+	wall = now_ns() - start;
+
+	if (alloc.n) {
+		snprintf(op, sizeof(op), "%s_alloc", heap->name);
+		report("ion", op, size, 1, &alloc, wall,
+		       (uint64_t)alloc.n * size);
+		snprintf(op, sizeof(op), "%s_map", heap->name);
+		report("ion", op, size, 1, &map, wall, (uint64_t)map.n * size);
+		snprintf(op, sizeof(op), "%s_free", heap->name);
+		report("ion", op, size, 1, &release, wall,
+		       (uint64_t)release.n * size);
+	}
+
+	samples_free(&alloc);
+	samples_free(&map);
+	samples_free(&release);
+	return ret;
+}
+
+int bench_ion(const struct bench_opts *o)
+{
+	const size_t *sizes;
+	int fd, nsizes, i, j, ret = 0;
+
+	fd = open(ION_DEV, O_RDWR);
+	if (fd < 0)
+		return 1;
+
+	nsizes = bench_sizes(o, default_sizes, ARRAY_SIZE(default_sizes),
+			     &sizes);
+
+	for (i = 0; i < ARRAY_SIZE(heaps) && !ret; i++)
+		for (j = 0; j < nsizes && !ret; j++)
+			ret = run_heap(o, fd, &heaps[i], sizes[j]);
+
+	close(fd);
+	return ret;
+}
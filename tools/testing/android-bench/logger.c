@@ -0,0 +1,193 @@
+/*
+ * logger.c -- logger write and read throughput
+ *
+ * Copyright (C) 2011 Motorola Mobility, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * N writer threads each do the three part writev liblog does for every
+ * line, then one reader drains the log the way logcat -d does.  The
+ * read rate is over the whole ring, whatever else was logged included.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "../../../drivers/staging/android/logger.h"
+#include "android-bench.h"
+
+#define LOG_TAG		"android-bench"
+#define LOG_PRIO_INFO	4
+#define LOG_READ_MAX	(5 * 1024)	/* LOGGER_ENTRY_MAX_LEN */
+
+struct writer_arg {
+	const char *path;
+	size_t size;
+	unsigned int iterations;
+	struct samples samples;
+	int err;
+};
+
+static const size_t default_sizes[] = { 64, 512, 4000 };
+
+static void *writer_loop(void *arg)
+{
+	struct writer_arg *w = arg;
+	unsigned char prio = LOG_PRIO_INFO;
+	struct iovec vec[3];
+	char *msg;
+	unsigned int i;
+	int fd;
+
+	fd = open(w->path, O_WRONLY);
+	msg = malloc(w->size);
+	if (fd < 0 || !msg) {
+		w->err = fd < 0 ? errno : ENOMEM;
+		goto out;
+	}
+	memset(msg, 'x', w->size - 1);
+	msg[w->size - 1] = '\0';
+
+	vec[0].iov_base = &prio;
+	vec[0].iov_len = 1;
+	vec[1].iov_base = LOG_TAG;
+	vec[1].iov_len = sizeof(LOG_TAG);
+	vec[2].iov_base = msg;
+	vec[2].iov_len = w->size;
+
+	for (i = 0; i < w->iterations; i++) {
+		uint64_t start = now_ns();
+
+		if (writev(fd, vec, 3) < 0) {
+			w->err = errno;
+			break;
+		}
+		samples_add(&w->samples, now_ns() - start);
+	}
+
+out:
+	free(msg);
+	if (fd >= 0)
+		close(fd);
+	return NULL;
+}
+
+static int run_writers(const struct bench_opts *o, size_t size,
+		       unsigned int threads)
+{
+	struct writer_arg *w;
+	pthread_t *tids;
+	struct samples all;
+	uint64_t start, wall;
+	unsigned int i;
+	int ret = 0;
+
+	w = calloc(threads, sizeof(*w));
+	tids = calloc(threads, sizeof(*tids));
+	if (!w || !tids)
+		return -1;
+
+	samples_init(&all, o->iterations * threads);
+	start = now_ns();
+	for (i = 0; i < threads; i++) {
+		w[i].path = o->log_path;
+		w[i].size = size;
+		w[i].iterations = o->iterations;
+		samples_init(&w[i].samples, o->iterations);
+		pthread_create(&tids[i], NULL, writer_loop, &w[i]);
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(tids[i], NULL);
+		samples_merge(&all, &w[i].samples);
+		samples_free(&w[i].samples);
+		if (w[i].err) {
+			errno = w[i].err;
+			warn_errno("logger: write %s", o->log_path);
+			ret = -1;
+		}
+	}
+	wall = now_ns() - start;
+
+	report("logger", "write", size, threads, &all, wall,
+	       (uint64_t)all.n * (1 + sizeof(LOG_TAG) + size));
+
+	samples_free(&all);
+	free(tids);
+	free(w);
+	return ret;
+}
+
+static int run_reader(const struct bench_opts *o, size_t size)
+{
+	struct samples s;
+	uint64_t start, wall, bytes = 0;
+	char *buf;
+	int fd;
+
+	fd = open(o->log_path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		warn_errno("logger: read %s", o->log_path);
+		return -1;
+	}
+
+	buf = malloc(LOG_READ_MAX);
+	/* a 256k ring holds at most this many of the smallest entries */
+	samples_init(&s, 256 * 1024 / sizeof(struct user_logger_entry_compat));
+
+	start = now_ns();
+	for (;;) {
+		uint64_t t = now_ns();
+		ssize_t len = read(fd, buf, LOG_READ_MAX);
+
+		if (len <= 0)
+			break;
+		samples_add(&s, now_ns() - t);
+		bytes += len;
+	}
+	wall = now_ns() - start;
+
+	report("logger", "read", size, 1, &s, wall, bytes);
+
+	samples_free(&s);
+	free(buf);
+	close(fd);
+	return 0;
+}
+
+int bench_logger(const struct bench_opts *o)
+{
+	const size_t *sizes;
+	int nsizes, i, j;
+
+	if (access(o->log_path, W_OK))
+		return 1;
+
+	nsizes = bench_sizes(o, default_sizes, ARRAY_SIZE(default_sizes),
+			     &sizes);
+
+	for (j = 0; j < nsizes; j++) {
+		size_t size = sizes[j] ? sizes[j] : 1;
+
+		if (size + 1 + sizeof(LOG_TAG) > LOGGER_ENTRY_MAX_PAYLOAD)
+			size = LOGGER_ENTRY_MAX_PAYLOAD - 1 - sizeof(LOG_TAG);
+
+		for (i = 0; i < o->nthreads; i++)
+			if (run_writers(o, size, o->threads[i]))
+				return -1;
+		if (run_reader(o, size))
+			return -1;
+	}
+
+	return 0;
+}